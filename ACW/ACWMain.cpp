@@ -1,16 +1,108 @@
 ﻿#include "pch.h"
 #include "ACWMain.h"
 #include "Common\DirectXHelper.h"
+#include "InputKeys.h"
+#include "Content\Profiler.h"
+#include <cstdarg>
+#include <fstream>
+#include <string>
 
 using namespace ACW;
 using namespace Windows::Foundation;
 using namespace Windows::System::Threading;
 using namespace Concurrency;
 
+namespace
+{
+	std::wstring Format(const wchar_t* format, ...)
+	{
+		wchar_t line[256];
+		va_list arguments;
+		va_start(arguments, format);
+		vswprintf_s(line, _countof(line), format, arguments);
+		va_end(arguments);
+		return line;
+	}
+
+	// GPU time of the coral passes at the rate they are being lit at, or of its impostor
+	std::wstring CoralLine(const Sample3DSceneRenderer& scene)
+	{
+		const CoralPassTimings& coral = scene.GetCoralPassTimings();
+		if (scene.IsDrawingCoralImpostor())
+		{
+			return Format(L"Coral impostor: %.3f ms, baked in %.0f ms", coral.impostorMilliseconds, scene.GetCoralImpostorBakeMilliseconds());
+		}
+		return Format(L"Coral 1/%d: prepass %.2f march %.2f shade %.2f resolve %.2f ms", static_cast<int>(scene.GetCoralShadingRate()),
+			coral.prepassMilliseconds, coral.marchMilliseconds, coral.shadeMilliseconds, coral.resolveMilliseconds);
+	}
+
+	std::wstring PlantLine(const PlantStats& plants)
+	{
+		return Format(L"Plants: %u of %u drawn, %u thinned at load, %u species textures built in %.1f ms",
+			plants.visibleCount, plants.instanceCount, plants.culledCount, PlantInstances::SpeciesCount, plants.atlasMilliseconds);
+	}
+
+	std::wstring CoralMeshLine(const CoralMeshStats& meshes)
+	{
+		return Format(L"Coral meshes: %u variants of %u triangles grown in %.1f ms each, %u placed, %u triangles drawn",
+			meshes.variantCount, meshes.variantTriangles, meshes.variantMilliseconds, meshes.instanceCount, meshes.trianglesDrawn);
+	}
+
+	std::wstring CoralVertexLine(const CoralMeshStats& meshes)
+	{
+		return Format(L"Coral mesh vertices: %u KB (%u KB as floats), ACMR %.2f to %.2f, optimised in %.1f ms each",
+			meshes.vertexBytes / 1024, meshes.floatVertexBytes / 1024, meshes.acmrBefore, meshes.acmrAfter, meshes.optimizeMilliseconds);
+	}
+
+	std::wstring CoralClusterLine(const Meshlets::CullStats& clusters, float cullMilliseconds)
+	{
+		return Format(L"Coral clusters: %u of %u drawn, %u off screen, %u facing away, culled in %.2f ms",
+			clusters.meshletCount - clusters.frustumCulled - clusters.backfaceCulled, clusters.meshletCount,
+			clusters.frustumCulled, clusters.backfaceCulled, cullMilliseconds);
+	}
+
+	std::wstring FrameGraphLine(const FrameGraph::CompileStats& graph, const FrameGraph::ExecuteStats& execute)
+	{
+		return Format(L"Frame graph: %u of %u passes run, %u targets in %u textures, %u target binds",
+			graph.passCount - graph.culledPasses, graph.passCount, graph.transientResources, graph.textures, execute.targetBinds);
+	}
+
+	std::wstring StateBindLine(const StateFilter::BindStats& binds)
+	{
+		return Format(L"State binds: %u issued, %u redundant dropped", binds.Issued(), binds.Skipped());
+	}
+
+	std::wstring StateObjectLine(const StateCache::CacheStats& states)
+	{
+		return Format(L"State objects: %u made, %u requests found in cache", states.Misses(), states.Hits());
+	}
+
+	std::wstring ConstantLine(const ConstantRing::FrameStats& constants)
+	{
+		return Format(L"Constants: %u bytes written in %u of %u blocks", constants.bytesUploaded, constants.blocksUploaded, constants.blockCount);
+	}
+
+	// How the passes were recorded
+	std::wstring RecordingLine(const Sample3DSceneRenderer& scene)
+	{
+		if (!scene.IsRecordingDeferred())
+		{
+			return L"Recording: immediate context";
+		}
+		const CommandRecording::RecordStats& recording = scene.GetRecordStats();
+		return Format(L"Recording: %u passes on %u threads in %.2f ms, run in %.2f ms, %s command lists",
+			recording.jobs, recording.threads, recording.recordMilliseconds, recording.executeMilliseconds,
+			scene.HasDriverCommandLists() ? L"driver" : L"runtime");
+	}
+}
+
 // Loads and initializes application assets when the application is loaded.
 ACWMain::ACWMain(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
-	m_deviceResources(deviceResources)
+	m_deviceResources(deviceResources),
+	mTraceKeyDown(false)
 {
+	Profiler::SetThreadName("Main");
+
 	// Register to be notified if the Device is lost or recreated
 	m_deviceResources->RegisterDeviceNotify(this);
 
@@ -35,11 +127,34 @@ void ACWMain::CreateWindowSizeDependentResources()
 // Updates the application state once per frame.
 void ACWMain::Update(const std::vector<bool>& pInput)
 {
+	Profiler::BeginFrame();
+	Profiler::Scope profile("ACWMain::Update");
+
+	//Write the profiler's trace on P
+	if (pInput[InputWriteTrace] && !mTraceKeyDown)
+	{
+		WriteTrace();
+	}
+	mTraceKeyDown = pInput[InputWriteTrace];
+
 	// Update scene objects.
 	m_timer.Tick([&]()
 	{
 		m_sceneRenderer->Update(m_timer, pInput);
-		m_fpsTextRenderer->Update(m_timer);
+
+		//One line of the overlay for each subsystem, under the frame rate
+		const Sample3DSceneRenderer& scene = *m_sceneRenderer;
+		std::wstring detail = CoralLine(scene);
+		detail += L"\n" + PlantLine(scene.GetPlantStats());
+		detail += L"\n" + CoralMeshLine(scene.GetCoralMeshStats());
+		detail += L"\n" + CoralVertexLine(scene.GetCoralMeshStats());
+		detail += L"\n" + CoralClusterLine(scene.GetCoralClusterStats(), scene.GetCoralClusterCullMilliseconds());
+		detail += L"\n" + FrameGraphLine(scene.GetFrameGraphStats(), scene.GetFrameGraphExecuteStats());
+		detail += L"\n" + StateBindLine(scene.GetStateBindStats());
+		detail += L"\n" + StateObjectLine(scene.GetStateCacheStats());
+		detail += L"\n" + ConstantLine(scene.GetConstantStats());
+		detail += L"\n" + RecordingLine(scene);
+		m_fpsTextRenderer->Update(m_timer, detail);
 	});
 }
 
@@ -53,6 +168,8 @@ bool ACWMain::Render()
 		return false;
 	}
 
+	Profiler::Scope profile("ACWMain::Render");
+
 	auto context = m_deviceResources->GetD3DDeviceContext();
 
 	// Reset the viewport to target the whole screen.
@@ -74,6 +191,13 @@ bool ACWMain::Render()
 	return true;
 }
 
+void ACWMain::WriteTrace()
+{
+	std::wstring path = std::wstring(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data()) + L"\\trace.json";
+	std::ofstream out(path);
+	Profiler::WriteChromeTrace(Profiler::Collect(), out);
+}
+
 // Notifies renderers that device resources need to be released.
 void ACWMain::OnDeviceLost()
 {
@@ -18,6 +18,9 @@ namespace ACW
 		void Update(const std::vector<bool>& pInput);
 		bool Render();
 
+		// Writes what the profiler holds, the last few seconds of frames, to trace.json in the app's local folder.
+		void WriteTrace();
+
 		// IDeviceNotify
 		virtual void OnDeviceLost();
 		virtual void OnDeviceRestored();
@@ -31,5 +34,7 @@ namespace ACW
 
 		// Rendering loop timer.
 		DX::StepTimer m_timer;
+
+		bool mTraceKeyDown;
 	};
 }
\ No newline at end of file
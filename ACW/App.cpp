@@ -1,6 +1,8 @@
 ﻿#include "pch.h"
 #include "App.h"
+#include "InputKeys.h"
 
+#include "Content\Profiler.h"
 #include <ppltasks.h>
 
 using namespace ACW;
@@ -52,7 +54,7 @@ void App::Initialize(CoreApplicationView^ applicationView)
 	// At this point we have access to the device. 
 	// We can create the device-dependent resources.
 	m_deviceResources = std::make_shared<DX::DeviceResources>();
-	mInput.resize(10);
+	mInput.resize(InputKeyCount);
 }
 
 // Called when the CoreWindow object is created (or re-created).
@@ -109,6 +111,7 @@ void App::Run()
 
 			if (m_main->Render())
 			{
+				Profiler::Scope profile("Present");
 				m_deviceResources->Present();
 			}
 		}
@@ -186,43 +189,59 @@ void ACW::App::OnKeyPressed(Windows::UI::Core::CoreWindow ^ sender, Windows::UI:
 
 	if (key == VirtualKey::W)
 	{
-		mInput[0] = true;
+		mInput[InputForward] = true;
 	}
 	if (key == VirtualKey::A)
 	{
-		mInput[1] = true;
+		mInput[InputLeft] = true;
 	}
 	if (key == VirtualKey::S)
 	{
-		mInput[2] = true;
+		mInput[InputBack] = true;
 	}
 	if (key == VirtualKey::D)
 	{
-		mInput[3] = true;
+		mInput[InputRight] = true;
 	}
 	if (key == VirtualKey::Space)
 	{
-		mInput[4] = true;
+		mInput[InputUp] = true;
 	}
 	if (key == VirtualKey::Control)
 	{
-		mInput[5] = true;
+		mInput[InputDown] = true;
 	}
 	if (key == VirtualKey::Q)
 	{
-		mInput[6] = true;
+		mInput[InputTurnLeft] = true;
 	}
 	if (key == VirtualKey::E)
 	{
-		mInput[7] = true;
+		mInput[InputTurnRight] = true;
 	}
 	if (key == VirtualKey::LeftButton)
 	{
-		mInput[8] = true;
+		mInput[InputLeftButton] = true;
 	}
 	if (key == VirtualKey::RightButton)
 	{
-		mInput[9] = true;
+		mInput[InputRightButton] = true;
+	}
+	if (key == VirtualKey::R)
+	{
+		mInput[InputRaymarchResolution] = true;
+	}
+	if (key == VirtualKey::T)
+	{
+		mInput[InputCoralShadingRate] = true;
+	}
+	if (key == VirtualKey::Y)
+	{
+		mInput[InputRecordDeferred] = true;
+	}
+	if (key == VirtualKey::P)
+	{
+		mInput[InputWriteTrace] = true;
 	}
 }
 
@@ -233,43 +252,59 @@ void ACW::App::OnKeyReleased(Windows::UI::Core::CoreWindow ^ sender, Windows::UI
 
 	if (key == VirtualKey::W)
 	{
-		mInput[0] = false;
+		mInput[InputForward] = false;
 	}
 	if (key == VirtualKey::A)
 	{
-		mInput[1] = false;
+		mInput[InputLeft] = false;
 	}
 	if (key == VirtualKey::S)
 	{
-		mInput[2] = false;
+		mInput[InputBack] = false;
 	}
 	if (key == VirtualKey::D)
 	{
-		mInput[3] = false;
+		mInput[InputRight] = false;
 	}
 	if (key == VirtualKey::Space)
 	{
-		mInput[4] = false;
+		mInput[InputUp] = false;
 	}
 	if (key == VirtualKey::Control)
 	{
-		mInput[5] = false;
+		mInput[InputDown] = false;
 	}
 	if (key == VirtualKey::Q)
 	{
-		mInput[6] = false;
+		mInput[InputTurnLeft] = false;
 	}
 	if (key == VirtualKey::E)
 	{
-		mInput[7] = false;
+		mInput[InputTurnRight] = false;
 	}
 	if (key == VirtualKey::LeftButton)
 	{
-		mInput[8] = false;
+		mInput[InputLeftButton] = false;
 	}
 	if (key == VirtualKey::RightButton)
 	{
-		mInput[9] = false;
+		mInput[InputRightButton] = false;
+	}
+	if (key == VirtualKey::R)
+	{
+		mInput[InputRaymarchResolution] = false;
+	}
+	if (key == VirtualKey::T)
+	{
+		mInput[InputCoralShadingRate] = false;
+	}
+	if (key == VirtualKey::Y)
+	{
+		mInput[InputRecordDeferred] = false;
+	}
+	if (key == VirtualKey::P)
+	{
+		mInput[InputWriteTrace] = false;
 	}
 }
 
@@ -33,6 +33,46 @@ namespace DX
 		});
 	}
 
+	// Reads a file the app saved to its local folder, empty when there is no such file.
+	inline Concurrency::task<std::vector<byte>> ReadLocalDataAsync(const std::wstring& filename)
+	{
+		using namespace Windows::Storage;
+		using namespace Concurrency;
+
+		auto folder = ApplicationData::Current->LocalFolder;
+
+		return create_task(folder->TryGetItemAsync(ref new Platform::String(filename.c_str()))).then([] (IStorageItem^ item) -> task<std::vector<byte>>
+		{
+			if (item == nullptr)
+			{
+				return task_from_result(std::vector<byte>());
+			}
+
+			return create_task(FileIO::ReadBufferAsync(safe_cast<StorageFile^>(item))).then([] (Streams::IBuffer^ fileBuffer) -> std::vector<byte>
+			{
+				std::vector<byte> returnBuffer;
+				returnBuffer.resize(fileBuffer->Length);
+				Streams::DataReader::FromBuffer(fileBuffer)->ReadBytes(Platform::ArrayReference<byte>(returnBuffer.data(), fileBuffer->Length));
+				return returnBuffer;
+			});
+		});
+	}
+
+	// Saves data to a file in the app's local folder, replacing any file of the same name.
+	inline Concurrency::task<void> WriteLocalDataAsync(const std::wstring& filename, const std::vector<byte>& data)
+	{
+		using namespace Windows::Storage;
+		using namespace Concurrency;
+
+		auto folder = ApplicationData::Current->LocalFolder;
+		auto fileData = std::make_shared<std::vector<byte>>(data);
+
+		return create_task(folder->CreateFileAsync(ref new Platform::String(filename.c_str()), CreationCollisionOption::ReplaceExisting)).then([fileData] (StorageFile^ file)
+		{
+			return FileIO::WriteBytesAsync(file, Platform::ArrayReference<byte>(fileData->data(), static_cast<unsigned int>(fileData->size())));
+		});
+	}
+
 	// Converts a length in device-independent pixels (DIPs) to a length in physical pixels.
 	inline float ConvertDipsToPixels(float dips, float dpi)
 	{
@@ -0,0 +1,102 @@
+﻿#include "pch.h"
+#include "CommandRecording.h"
+
+using namespace ACW;
+using namespace ACW::CommandRecording;
+
+TraceRecorder::TraceRecorder(int threadCount) :
+	mRecording(std::max(threadCount, 1))
+{
+}
+
+void TraceRecorder::BeginFrame(int jobCount)
+{
+	executed.clear();
+	jobThreads.assign(jobCount, -1);
+	mLists.resize(jobCount);
+	for (std::vector<uint32_t>& recording : mRecording)
+	{
+		recording.clear();
+	}
+}
+
+void TraceRecorder::EndJob(int job, int thread)
+{
+	mLists[job].swap(mRecording[thread]);
+	mRecording[thread].clear();
+	jobThreads[job] = thread;
+}
+
+void TraceRecorder::ExecuteJob(int job)
+{
+	executed.insert(executed.end(), mLists[job].begin(), mLists[job].end());
+	mLists[job].clear();
+}
+
+namespace
+{
+	// Work of about the size of setting up and recording one draw
+	uint32_t RecordDraw(uint32_t command)
+	{
+		uint32_t hash = command;
+		for (int i = 0; i < 256; i++)
+		{
+			hash = (hash ^ (hash >> 15)) * 2246822519u;
+		}
+		return hash;
+	}
+
+	double RecordFrame(TraceRecorder& recorder, WorkerThreads::Pool& workers, int jobs, int drawsPerJob, RecordStats* stats)
+	{
+		std::atomic<uint32_t> sink(0);
+		*stats = RecordJobs(recorder, workers, jobs, [&](int job, int thread)
+		{
+			uint32_t hashes = 0;
+			for (int draw = 0; draw < drawsPerJob; draw++)
+			{
+				uint32_t command = static_cast<uint32_t>(job * drawsPerJob + draw);
+				hashes += RecordDraw(command);
+				recorder.Command(thread, command);
+			}
+			sink += hashes;
+		});
+		return stats->recordMilliseconds;
+	}
+}
+
+RecordingBenchmark CommandRecording::RunRecordingBenchmark(int jobs, int drawsPerJob, int threads, int frames)
+{
+	RecordingBenchmark result = {};
+	result.jobs = jobs;
+	result.threads = threads;
+	result.frames = frames > 0 ? frames : 1;
+
+	TraceRecorder serial(1);
+	TraceRecorder parallel(threads);
+	WorkerThreads::Pool workers(threads);
+	for (int frame = 0; frame < result.frames; frame++)
+	{
+		RecordStats stats;
+		result.serialMilliseconds += RecordFrame(serial, workers, jobs, drawsPerJob, &stats);
+		result.parallelMilliseconds += RecordFrame(parallel, workers, jobs, drawsPerJob, &stats);
+		result.executeMilliseconds += stats.executeMilliseconds;
+
+		if (parallel.executed == serial.executed)
+		{
+			result.orderedFrames++;
+		}
+		for (int thread : parallel.jobThreads)
+		{
+			if (thread != parallel.jobThreads[0])
+			{
+				result.sharedFrames++;
+				break;
+			}
+		}
+	}
+
+	result.serialMilliseconds /= result.frames;
+	result.parallelMilliseconds /= result.frames;
+	result.executeMilliseconds /= result.frames;
+	return result;
+}
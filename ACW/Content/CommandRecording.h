@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include "WorkerThreads.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Jobs recorded on worker threads, each into a command list of its own, and played back in job order on the
+	// calling thread once all of them are recorded. Each thread takes the next job nobody has taken, so how jobs
+	// fall on threads changes from frame to frame but the order they are played back in never does. Where they
+	// are recorded to is up to the Recorder: deferred contexts for the renderer, nothing at all, or lists of
+	// numbers that show the order work reached the immediate context in, without a GPU.
+	namespace CommandRecording
+	{
+		class Recorder
+		{
+		public:
+			virtual ~Recorder() {}
+
+			// Threads jobs can be recorded on at once, each with its own context.
+			virtual int ThreadCount() const = 0;
+
+			// Before any job of a frame is recorded.
+			virtual void BeginFrame(int jobCount) { (void)jobCount; }
+
+			// Around each job, on the thread recording it.
+			virtual void BeginJob(int job, int thread) { (void)job; (void)thread; }
+			virtual void EndJob(int job, int thread) = 0;
+
+			// Plays a recorded job back, on the calling thread, in job order.
+			virtual void ExecuteJob(int job) = 0;
+		};
+
+		struct RecordStats
+		{
+			uint32_t jobs;
+			uint32_t threads;
+			double recordMilliseconds;
+			double executeMilliseconds;
+		};
+
+		// Records jobCount jobs on the threads of workers, calling record(job, thread) for each, then plays them back
+		// in order.
+		template <class Record>
+		RecordStats RecordJobs(Recorder& recorder, WorkerThreads::Pool& workers, int jobCount, const Record& record)
+		{
+			RecordStats stats = {};
+			stats.jobs = static_cast<uint32_t>(jobCount);
+			stats.threads = static_cast<uint32_t>(std::max(std::min(recorder.ThreadCount(), jobCount), 1));
+
+			auto start = std::chrono::steady_clock::now();
+			recorder.BeginFrame(jobCount);
+			std::atomic<int> next(0);
+			workers.Run(static_cast<int>(stats.threads), [&](int thread)
+			{
+				for (int job = next++; job < jobCount; job = next++)
+				{
+					recorder.BeginJob(job, thread);
+					record(job, thread);
+					recorder.EndJob(job, thread);
+				}
+			});
+
+			auto recorded = std::chrono::steady_clock::now();
+			for (int job = 0; job < jobCount; job++)
+			{
+				recorder.ExecuteJob(job);
+			}
+
+			stats.recordMilliseconds = std::chrono::duration<double, std::milli>(recorded - start).count();
+			stats.executeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recorded).count();
+			return stats;
+		}
+
+		// Records nothing, so jobs draw straight into whatever they were given, on the calling thread in order.
+		class NullRecorder : public Recorder
+		{
+		public:
+			int ThreadCount() const override { return 1; }
+			void EndJob(int, int) override {}
+			void ExecuteJob(int) override {}
+		};
+
+		// Records the numbers jobs give it as their commands, and plays them back into one list as the immediate
+		// context would run them, noting the thread each job was recorded on.
+		class TraceRecorder : public Recorder
+		{
+		public:
+			explicit TraceRecorder(int threadCount);
+
+			int ThreadCount() const override { return static_cast<int>(mRecording.size()); }
+			void BeginFrame(int jobCount) override;
+			void EndJob(int job, int thread) override;
+			void ExecuteJob(int job) override;
+
+			// Called by a job on the thread recording it.
+			void Command(int thread, uint32_t command) { mRecording[thread].push_back(command); }
+
+			std::vector<uint32_t> executed;
+			std::vector<int> jobThreads;
+
+		private:
+			std::vector<std::vector<uint32_t>> mRecording;
+			std::vector<std::vector<uint32_t>> mLists;
+		};
+
+		struct RecordingBenchmark
+		{
+			int jobs;
+			int threads;
+
+			// A frame recorded on one thread, and on threads threads.
+			double serialMilliseconds;
+			double parallelMilliseconds;
+			double executeMilliseconds;
+
+			// Frames whose commands were played back in the order one thread records them, which should be all of them,
+			// and those where more than one thread took a job.
+			int orderedFrames;
+			int sharedFrames;
+			int frames;
+		};
+
+		// jobs jobs of drawsPerJob commands each, each command standing in for the CPU cost of recording a draw.
+		RecordingBenchmark RunRecordingBenchmark(int jobs, int drawsPerJob, int threads, int frames);
+	}
+}
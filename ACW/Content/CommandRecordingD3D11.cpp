@@ -0,0 +1,56 @@
+﻿#include "pch.h"
+#include "CommandRecordingD3D11.h"
+
+#include "..\Common\DirectXHelper.h"
+
+using namespace ACW;
+using namespace ACW::CommandRecording;
+
+D3D11Recorder::D3D11Recorder(const std::shared_ptr<DX::DeviceResources>& deviceResources, int threadCount) :
+	m_deviceResources(deviceResources),
+	mContexts(std::max(threadCount, 1)),
+	mDriverCommandLists(false)
+{
+}
+
+void D3D11Recorder::CreateContexts()
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+	for (Microsoft::WRL::ComPtr<ID3D11DeviceContext3>& context : mContexts)
+	{
+		DX::ThrowIfFailed(
+			device->CreateDeferredContext3(0, context.ReleaseAndGetAddressOf())
+		);
+	}
+
+	D3D11_FEATURE_DATA_THREADING threading = {};
+	mDriverCommandLists = SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading))) &&
+		threading.DriverCommandLists;
+}
+
+void D3D11Recorder::ReleaseContexts()
+{
+	mLists.clear();
+	for (Microsoft::WRL::ComPtr<ID3D11DeviceContext3>& context : mContexts)
+	{
+		context.Reset();
+	}
+}
+
+void D3D11Recorder::BeginFrame(int jobCount)
+{
+	mLists.resize(jobCount);
+}
+
+void D3D11Recorder::EndJob(int job, int thread)
+{
+	DX::ThrowIfFailed(
+		mContexts[thread]->FinishCommandList(FALSE, mLists[job].ReleaseAndGetAddressOf())
+	);
+}
+
+void D3D11Recorder::ExecuteJob(int job)
+{
+	m_deviceResources->GetD3DDeviceContext()->ExecuteCommandList(mLists[job].Get(), FALSE);
+	mLists[job].Reset();
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include "..\Common\DeviceResources.h"
+#include "CommandRecording.h"
+#include <vector>
+
+namespace ACW
+{
+	namespace CommandRecording
+	{
+		// Records each job on its thread's deferred context into a command list, played back on the immediate context.
+		// Command lists start with nothing bound, and leave nothing bound on the immediate context after them.
+		class D3D11Recorder : public Recorder
+		{
+		public:
+			D3D11Recorder(const std::shared_ptr<DX::DeviceResources>& deviceResources, int threadCount);
+
+			void CreateContexts();
+			void ReleaseContexts();
+
+			ID3D11DeviceContext3* Context(int thread) const { return mContexts[thread].Get(); }
+
+			// Whether the driver records command lists itself, rather than the runtime recording them for it.
+			bool DriverCommandLists() const { return mDriverCommandLists; }
+
+			int ThreadCount() const override { return static_cast<int>(mContexts.size()); }
+			void BeginFrame(int jobCount) override;
+			void EndJob(int job, int thread) override;
+			void ExecuteJob(int job) override;
+
+		private:
+			std::shared_ptr<DX::DeviceResources> m_deviceResources;
+			std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext3>> mContexts;
+			std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> mLists;
+			bool mDriverCommandLists;
+		};
+	}
+}
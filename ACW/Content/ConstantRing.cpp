@@ -0,0 +1,185 @@
+﻿#include "pch.h"
+#include "ConstantRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ACW;
+using namespace ACW::ConstantRing;
+
+namespace
+{
+	uint32_t Align(uint32_t size)
+	{
+		return (size + BlockAlignment - 1) / BlockAlignment * BlockAlignment;
+	}
+}
+
+Ring::Ring(uint32_t capacity, bool noOverwrite) :
+	mCapacity(capacity / BlockAlignment * BlockAlignment),
+	mHead(0),
+	mNoOverwrite(noOverwrite),
+	mValid(false),
+	mStats()
+{
+}
+
+int Ring::AddBlock(uint32_t size)
+{
+	Block block;
+	block.data.assign(size, 0);
+	block.alignedSize = Align(size);
+	block.offset = 0;
+	block.dirty = true;
+	mBlocks.push_back(block);
+	mCapacity = std::max(mCapacity, TotalSize());
+	mValid = false;
+	return static_cast<int>(mBlocks.size()) - 1;
+}
+
+uint32_t Ring::TotalSize() const
+{
+	uint32_t total = 0;
+	for (const Block& block : mBlocks)
+	{
+		total += block.alignedSize;
+	}
+	return total;
+}
+
+void Ring::Set(int block, const void* data)
+{
+	Block& target = mBlocks[block];
+	if (std::memcmp(target.data.data(), data, target.data.size()) != 0)
+	{
+		std::memcpy(target.data.data(), data, target.data.size());
+		target.dirty = true;
+	}
+}
+
+void Ring::Invalidate()
+{
+	mValid = false;
+}
+
+const std::vector<Placement>& Ring::Place()
+{
+	mPlacements.clear();
+	mStats = FrameStats();
+	mStats.blockCount = static_cast<uint32_t>(mBlocks.size());
+
+	uint32_t dirtyBytes = 0;
+	bool anyDirty = false;
+	for (const Block& block : mBlocks)
+	{
+		if (block.dirty)
+		{
+			dirtyBytes += block.alignedSize;
+			anyDirty = true;
+		}
+	}
+
+	if (!anyDirty && mValid)
+	{
+		return mPlacements;
+	}
+
+	// Discarding leaves nothing in the buffer, so every block is written again
+	if (!mValid || !mNoOverwrite || mHead + dirtyBytes > mCapacity)
+	{
+		mStats.discarded = true;
+		mHead = 0;
+		for (Block& block : mBlocks)
+		{
+			block.dirty = true;
+		}
+	}
+
+	for (int i = 0; i < static_cast<int>(mBlocks.size()); i++)
+	{
+		Block& block = mBlocks[i];
+		if (!block.dirty)
+		{
+			continue;
+		}
+
+		block.offset = mHead;
+		block.dirty = false;
+		mHead += block.alignedSize;
+		mPlacements.push_back({ i, block.offset });
+		mStats.bytesUploaded += static_cast<uint32_t>(block.data.size());
+		mStats.blocksUploaded++;
+	}
+
+	mValid = true;
+	return mPlacements;
+}
+
+namespace
+{
+	// The layouts of ShaderStructures.h, by size
+	static const uint32_t CameraSize = 432;
+	static const uint32_t LightSize = 32;
+	static const uint32_t TimeSize = 16;
+	static const uint32_t UpsampleSize = 16;
+}
+
+RingBenchmark ConstantRing::RunRingBenchmark(int frames, uint32_t capacity)
+{
+	RingBenchmark result = {};
+	result.frames = frames > 0 ? frames : 1;
+	result.bytesPerFrameBefore = CameraSize + LightSize + TimeSize + UpsampleSize;
+
+	Ring ring(capacity);
+	int camera = ring.AddBlock(CameraSize);
+	int light = ring.AddBlock(LightSize);
+	int time = ring.AddBlock(TimeSize);
+	int upsample = ring.AddBlock(UpsampleSize);
+
+	std::vector<uint8_t> cameraData(CameraSize, 0);
+	std::vector<uint8_t> lightData(LightSize, 1);
+	std::vector<uint8_t> upsampleData(UpsampleSize, 2);
+
+	// Bytes written since the last discard, as the GPU may still read them
+	std::vector<bool> written(ring.Capacity(), false);
+	uint64_t bytes = 0;
+	for (int frame = 0; frame < result.frames; frame++)
+	{
+		if (frame % 4 == 0)
+		{
+			cameraData[frame / 4 % CameraSize]++;
+		}
+		float seconds = frame / 60.0f;
+		uint8_t timeData[TimeSize] = {};
+		std::memcpy(timeData, &seconds, sizeof(seconds));
+
+		ring.Set(camera, cameraData.data());
+		ring.Set(light, lightData.data());
+		ring.Set(time, timeData);
+		ring.Set(upsample, upsampleData.data());
+
+		const std::vector<Placement>& placements = ring.Place();
+		if (ring.GetStats().discarded)
+		{
+			result.discards++;
+			written.assign(written.size(), false);
+		}
+
+		for (const Placement& placement : placements)
+		{
+			for (uint32_t i = 0; i < ring.ConstantCount(placement.block) * ConstantSize; i++)
+			{
+				if (written[placement.offset + i])
+				{
+					result.overwrites++;
+					break;
+				}
+				written[placement.offset + i] = true;
+			}
+		}
+		bytes += ring.GetStats().bytesUploaded;
+	}
+
+	result.bytesPerFrame = static_cast<double>(bytes) / result.frames;
+	return result;
+}
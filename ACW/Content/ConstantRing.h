@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// The frame's constant buffers as blocks of one dynamic buffer. Each frame the blocks whose contents changed
+	// are written after those of earlier frames, mapped without overwriting anything the GPU may still be reading,
+	// and bound at their new offsets, while unchanged blocks stay bound where they were. When the changed blocks
+	// no longer fit before the end, the buffer is discarded, which hands back fresh memory with nothing in it,
+	// so every block is written again from the front. Ring works out where blocks go without a device, and
+	// D3D11Ring does the mapping and binding.
+	namespace ConstantRing
+	{
+		// Offsets given to the *SetConstantBuffers1 calls are counted in 16 byte constants, and must be multiples of 16 of them.
+		static const uint32_t ConstantSize = 16;
+		static const uint32_t BlockAlignment = 256;
+
+		// A block written this frame, at offset bytes into the buffer.
+		struct Placement
+		{
+			int block;
+			uint32_t offset;
+		};
+
+		struct FrameStats
+		{
+			// Bytes of block contents written this frame, the blocks written and the blocks there are.
+			uint32_t bytesUploaded;
+			uint32_t blocksUploaded;
+			uint32_t blockCount;
+			bool discarded;
+		};
+
+		class Ring
+		{
+		public:
+			// noOverwrite is false on devices that cannot map constant buffers without overwriting, where any
+			// frame with a changed block discards and writes them all.
+			explicit Ring(uint32_t capacity, bool noOverwrite = true);
+
+			// The capacity grows to hold every block at once if it does not already.
+			int AddBlock(uint32_t size);
+
+			// Copies in the block's contents for this frame. It is only written if they differ from what it last held.
+			void Set(int block, const void* data);
+
+			// Forgets what the buffer holds, as when it is made again, so every block is written the next frame.
+			void Invalidate();
+			void SetNoOverwrite(bool noOverwrite) { mNoOverwrite = noOverwrite; }
+
+			// Places the blocks that changed since the last frame, once a frame before anything is drawn.
+			const std::vector<Placement>& Place();
+
+			const void* Data(int block) const { return mBlocks[block].data.data(); }
+			uint32_t Size(int block) const { return static_cast<uint32_t>(mBlocks[block].data.size()); }
+			uint32_t Offset(int block) const { return mBlocks[block].offset; }
+			uint32_t FirstConstant(int block) const { return mBlocks[block].offset / ConstantSize; }
+			uint32_t ConstantCount(int block) const { return mBlocks[block].alignedSize / ConstantSize; }
+			int BlockCount() const { return static_cast<int>(mBlocks.size()); }
+
+			uint32_t Capacity() const { return mCapacity; }
+			const FrameStats& GetStats() const { return mStats; }
+
+		private:
+			struct Block
+			{
+				std::vector<uint8_t> data;
+				uint32_t alignedSize;
+				uint32_t offset;
+				bool dirty;
+			};
+
+			uint32_t TotalSize() const;
+
+			std::vector<Block> mBlocks;
+			std::vector<Placement> mPlacements;
+			uint32_t mCapacity;
+			uint32_t mHead;
+			bool mNoOverwrite;
+			bool mValid;
+			FrameStats mStats;
+		};
+
+		struct RingBenchmark
+		{
+			int frames;
+
+			// Bytes written each frame when every buffer was updated whole, and with the ring.
+			uint32_t bytesPerFrameBefore;
+			double bytesPerFrame;
+			uint32_t discards;
+
+			// Writes made without discarding over bytes written since the last discard, which should be none.
+			uint32_t overwrites;
+		};
+
+		// The renderer's camera, light, time and upsample buffers over frames frames, the camera moving one frame
+		// in four, time every frame and the light never, checking where each block is placed.
+		RingBenchmark RunRingBenchmark(int frames, uint32_t capacity);
+	}
+}
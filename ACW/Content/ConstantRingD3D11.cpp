@@ -0,0 +1,97 @@
+﻿#include "pch.h"
+#include "ConstantRingD3D11.h"
+
+#include "..\Common\DirectXHelper.h"
+
+using namespace ACW;
+using namespace ACW::ConstantRing;
+
+D3D11Ring::D3D11Ring(const std::shared_ptr<DX::DeviceResources>& deviceResources, uint32_t capacity) :
+	m_deviceResources(deviceResources),
+	mRing(capacity)
+{
+}
+
+int D3D11Ring::AddBlock(UINT slot, unsigned int stages, uint32_t size)
+{
+	mBindings.push_back({ slot, stages });
+	return mRing.AddBlock(size);
+}
+
+void D3D11Ring::CreateBuffer()
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+
+	// Without this the device can only map constant buffers by discarding them
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	bool noOverwrite = SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.MapNoOverwriteOnDynamicConstantBuffer;
+	mRing.SetNoOverwrite(noOverwrite);
+
+	CD3D11_BUFFER_DESC bufferDesc(mRing.Capacity(), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(
+		device->CreateBuffer(&bufferDesc, nullptr, mBuffer.ReleaseAndGetAddressOf())
+	);
+	mRing.Invalidate();
+}
+
+void D3D11Ring::ReleaseBuffer()
+{
+	mBuffer.Reset();
+	mRing.Invalidate();
+}
+
+void D3D11Ring::Upload(ID3D11DeviceContext1* context)
+{
+	const std::vector<Placement>& placements = mRing.Place();
+	if (placements.empty())
+	{
+		return;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(
+		context->Map(mBuffer.Get(), 0, mRing.GetStats().discarded ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)
+	);
+	for (const Placement& placement : placements)
+	{
+		memcpy(static_cast<uint8_t*>(mapped.pData) + placement.offset, mRing.Data(placement.block), mRing.Size(placement.block));
+	}
+	context->Unmap(mBuffer.Get(), 0);
+
+	for (const Placement& placement : placements)
+	{
+		BindBlock(context, placement.block);
+	}
+}
+
+void D3D11Ring::Bind(ID3D11DeviceContext1* context) const
+{
+	for (int block = 0; block < mRing.BlockCount(); block++)
+	{
+		BindBlock(context, block);
+	}
+}
+
+void D3D11Ring::BindBlock(ID3D11DeviceContext1* context, int block) const
+{
+	const Binding& binding = mBindings[block];
+	UINT first = mRing.FirstConstant(block);
+	UINT count = mRing.ConstantCount(block);
+	if (binding.stages & VertexStage)
+	{
+		context->VSSetConstantBuffers1(binding.slot, 1, mBuffer.GetAddressOf(), &first, &count);
+	}
+	if (binding.stages & PixelStage)
+	{
+		context->PSSetConstantBuffers1(binding.slot, 1, mBuffer.GetAddressOf(), &first, &count);
+	}
+	if (binding.stages & GeometryStage)
+	{
+		context->GSSetConstantBuffers1(binding.slot, 1, mBuffer.GetAddressOf(), &first, &count);
+	}
+	if (binding.stages & DomainStage)
+	{
+		context->DSSetConstantBuffers1(binding.slot, 1, mBuffer.GetAddressOf(), &first, &count);
+	}
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "..\Common\DeviceResources.h"
+#include "ConstantRing.h"
+#include <vector>
+
+namespace ACW
+{
+	namespace ConstantRing
+	{
+		// Shader stages a block is bound to.
+		enum Stage
+		{
+			VertexStage = 1,
+			PixelStage = 2,
+			GeometryStage = 4,
+			DomainStage = 8
+		};
+
+		// The ring's buffer on the Direct3D device, binding each block to its slot in its stages wherever it is written.
+		class D3D11Ring
+		{
+		public:
+			D3D11Ring(const std::shared_ptr<DX::DeviceResources>& deviceResources, uint32_t capacity);
+
+			// Blocks are added once, before the buffer is made.
+			int AddBlock(UINT slot, unsigned int stages, uint32_t size);
+			void Set(int block, const void* data) { mRing.Set(block, data); }
+
+			void CreateBuffer();
+			void ReleaseBuffer();
+
+			// Writes the blocks that changed and binds them, once a frame before anything is drawn.
+			void Upload(ID3D11DeviceContext1* context);
+
+			// Binds every block where it was last written, on a context that has none bound, as a deferred context starts.
+			void Bind(ID3D11DeviceContext1* context) const;
+
+			const FrameStats& GetStats() const { return mRing.GetStats(); }
+
+		private:
+			struct Binding
+			{
+				UINT slot;
+				unsigned int stages;
+			};
+
+			void BindBlock(ID3D11DeviceContext1* context, int block) const;
+
+			std::shared_ptr<DX::DeviceResources> m_deviceResources;
+			Microsoft::WRL::ComPtr<ID3D11Buffer> mBuffer;
+			Ring mRing;
+			std::vector<Binding> mBindings;
+		};
+	}
+}
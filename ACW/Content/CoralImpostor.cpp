@@ -0,0 +1,312 @@
+﻿#include "pch.h"
+#include "CoralImpostor.h"
+#include "WorkerThreads.h"
+
+#include <atomic>
+#include <chrono>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::CoralImpostor;
+
+namespace
+{
+	// How far out along its direction each frame's rays start, well clear of the bounding sphere
+	const float BakeDistance = 4.0f;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	uint32_t PackUnorm(const float4& c)
+	{
+		uint32_t r = static_cast<uint32_t>(saturate(c.x) * 255.0f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(saturate(c.y) * 255.0f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(saturate(c.z) * 255.0f + 0.5f);
+		uint32_t a = static_cast<uint32_t>(saturate(c.w) * 255.0f + 0.5f);
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	void Accumulate(float4& sum, const float4& v, float weight)
+	{
+		sum.x += v.x * weight;
+		sum.y += v.y * weight;
+		sum.z += v.z * weight;
+		sum.w += v.w * weight;
+	}
+
+	// frameUV in CoralImpostor.hlsli: where the eye ray meets a frame's plane, pushed offset along
+	// the frame's direction, as an atlas uv
+	float2 FrameUV(const Settings& settings, const float2& frame, const float3& ro, const float3& rd, float offset)
+	{
+		float3 d = FrameDirection(settings, frame.x, frame.y);
+		float3 right, up;
+		FrameBasis(d, right, up);
+		float t = dot(settings.centre + d * offset - ro, d) / dot(rd, d);
+		float3 q = ro + rd * t - settings.centre;
+		float2 local = float2(dot(q, right), -dot(q, up)) / settings.radius * 0.5f + float2(0.5f);
+
+		// Keep bilinear filtering inside the frame
+		float edge = 0.5f / settings.frameSize;
+		local = float2(clamp(local.x, edge, 1.0f - edge), clamp(local.y, edge, 1.0f - edge));
+		return (frame + local) / static_cast<float>(settings.framesPerSide);
+	}
+
+	void BakeFrame(const Settings& settings, int frameX, int frameY, PlantAtlas::TextureArray& atlas)
+	{
+		float3 d = FrameDirection(settings, static_cast<float>(frameX), static_cast<float>(frameY));
+		float3 right, up;
+		FrameBasis(d, right, up);
+
+		ImplicitCoralReference::MarchSettings march = ImplicitCoralReference::DefaultMarchSettings();
+		uint32_t* colour = &atlas.texels[atlas.offsets[ColourLayer]];
+		uint32_t* normalDepth = &atlas.texels[atlas.offsets[NormalDepthLayer]];
+
+		for (int y = 0; y < settings.frameSize; y++)
+		{
+			for (int x = 0; x < settings.frameSize; x++)
+			{
+				float u = (x + 0.5f) / settings.frameSize * 2.0f - 1.0f;
+				float v = 1.0f - (y + 0.5f) / settings.frameSize * 2.0f;
+				float3 ro = settings.centre + (right * u + up * v) * settings.radius + d * BakeDistance;
+				// iBox in MarchInterval divides by each component of the ray, keep the axis aligned frames finite
+				float3 rd = -d;
+				rd.x = std::fabs(rd.x) < 1e-6f ? 1e-6f : rd.x;
+				rd.z = std::fabs(rd.z) < 1e-6f ? 1e-6f : rd.z;
+
+				size_t texel = static_cast<size_t>(frameY * settings.frameSize + y) * atlas.width + frameX * settings.frameSize + x;
+				ImplicitCoralReference::MarchResult hit = ImplicitCoralReference::CastRay(ro, rd, 0.0f, march);
+				if (hit.material < 0.0f)
+				{
+					colour[texel] = 0;
+					normalDepth[texel] = 0;
+					continue;
+				}
+
+				// Lit as seen from this direction, without the fog the eye's own distance adds at run time
+				float3 pos = ro + rd * hit.t;
+				float3 lit = ImplicitCoralReference::Shade(pos, rd, 0.0f, hit.material);
+				float3 normal = ImplicitCoralReference::CalcNormal(pos);
+				float offset = dot(pos - settings.centre, d) / settings.radius;
+
+				colour[texel] = PackUnorm(float4(lit, 1.0f));
+				normalDepth[texel] = PackUnorm(float4(normal * 0.5f + 0.5f, offset * 0.5f + 0.5f));
+			}
+		}
+	}
+}
+
+Settings CoralImpostor::DefaultSettings()
+{
+	// The sphere ImplicitCoral.sdf places the coral in, with room for its lattice
+	Settings settings;
+	settings.centre = float3(-2.0f, -3.75f, -1.0f);
+	settings.radius = 0.3f;
+	settings.framesPerSide = 8;
+	settings.frameSize = 64;
+	settings.minDistance = 6.0f;
+	return settings;
+}
+
+float3 CoralImpostor::HemiOctToDir(const float2& o)
+{
+	float2 p = float2(o.x + o.y, o.x - o.y) * 0.5f;
+	return normalize(float3(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y));
+}
+
+float2 CoralImpostor::DirToHemiOct(float3 d)
+{
+	d.y = std::max(d.y, 0.0f);
+	float2 p = d.xz() / std::max(std::fabs(d.x) + d.y + std::fabs(d.z), 1e-6f);
+	return float2(p.x + p.y, p.x - p.y);
+}
+
+float3 CoralImpostor::FrameDirection(const Settings& settings, float frameX, float frameY)
+{
+	return HemiOctToDir(float2(frameX, frameY) / static_cast<float>(settings.framesPerSide - 1) * 2.0f - float2(1.0f));
+}
+
+void CoralImpostor::FrameBasis(const float3& d, float3& right, float3& up)
+{
+	float3 helper = d.y > 0.999f ? float3(0.0f, 0.0f, 1.0f) : float3(0.0f, 1.0f, 0.0f);
+	right = normalize(cross(d, helper));
+	up = cross(right, d);
+}
+
+bool CoralImpostor::UseImpostor(const Settings& settings, const float3& eye)
+{
+	// The coral canvas sits at z = 1, the eye has to stay in front of the whole quad for it to project
+	return length(eye - settings.centre) > settings.minDistance && eye.y >= settings.centre.y &&
+		eye.z < settings.centre.z - settings.radius;
+}
+
+PlantAtlas::TextureArray CoralImpostor::Bake(const Settings& settings, int threadCount)
+{
+	PlantAtlas::TextureArray atlas;
+	atlas.width = static_cast<uint32_t>(settings.framesPerSide * settings.frameSize);
+	atlas.height = atlas.width;
+	atlas.layerCount = 2;
+	atlas.mipCount = 1;
+	size_t layerSize = static_cast<size_t>(atlas.width) * atlas.height;
+	atlas.texels.resize(layerSize * atlas.layerCount);
+	atlas.offsets.push_back(0);
+	atlas.offsets.push_back(layerSize);
+
+	// Frames vary a lot in how much coral they see, so threads take the next one as they finish
+	int frameCount = settings.framesPerSide * settings.framesPerSide;
+	std::atomic<int> nextFrame(0);
+	WorkerThreads::Run(WorkerThreads::CountFor(frameCount, 1, threadCount), [&](int)
+	{
+		for (int frame = nextFrame++; frame < frameCount; frame = nextFrame++)
+		{
+			BakeFrame(settings, frame % settings.framesPerSide, frame / settings.framesPerSide, atlas);
+		}
+	});
+	return atlas;
+}
+
+std::vector<uint8_t> CoralImpostor::BakePack(const Settings& settings, int threadCount)
+{
+	return PlantAtlas::WriteDds(Bake(settings, threadCount));
+}
+
+float4 CoralImpostor::Sample(const Settings& settings, const PlantAtlas::TextureArray& atlas, const float3& ro, const float3& rd, float& depth)
+{
+	// The four frames around the eye's direction, weighted by how close each is
+	float lastFrame = static_cast<float>(settings.framesPerSide - 1);
+	float3 toEye = normalize(ro - settings.centre);
+	float2 grid = (DirToHemiOct(toEye) * 0.5f + float2(0.5f)) * lastFrame;
+	float2 base = float2(std::min(std::floor(grid.x), lastFrame - 1.0f), std::min(std::floor(grid.y), lastFrame - 1.0f));
+	float2 w = grid - base;
+
+	float4 colour;
+	float4 normalDepth;
+	for (int i = 0; i < 4; i++)
+	{
+		float2 corner = float2(static_cast<float>(i & 1), static_cast<float>(i >> 1));
+		float weight = (corner.x > 0.0f ? w.x : 1.0f - w.x) * (corner.y > 0.0f ? w.y : 1.0f - w.y);
+
+		// One step of parallax: find the baked depth where the ray crosses the frame's plane, then read
+		// the frame where the ray crosses that depth instead, so the views line up before blending
+		float2 uv = FrameUV(settings, base + corner, ro, rd, 0.0f);
+		float coverage = PlantAtlas::Sample(atlas, ColourLayer, uv, 0.0f).w;
+		if (coverage > 0.0f)
+		{
+			float planeDepth = PlantAtlas::Sample(atlas, NormalDepthLayer, uv, 0.0f).w / coverage;
+			uv = FrameUV(settings, base + corner, ro, rd, (planeDepth * 2.0f - 1.0f) * settings.radius);
+		}
+		Accumulate(colour, PlantAtlas::Sample(atlas, ColourLayer, uv, 0.0f), weight);
+		Accumulate(normalDepth, PlantAtlas::Sample(atlas, NormalDepthLayer, uv, 0.0f), weight);
+	}
+
+	if (colour.w < 0.5f)
+	{
+		depth = 0.0f;
+		return float4();
+	}
+
+	// The baked depth puts the surface on a plane facing the eye, the ray meets it there
+	float offset = (normalDepth.w / colour.w * 2.0f - 1.0f) * settings.radius;
+	depth = dot(settings.centre + toEye * offset - ro, toEye) / dot(rd, toEye);
+	if (depth > MaxDistance)
+	{
+		depth = 0.0f;
+		return float4();
+	}
+
+	float3 col = colour.xyz() / colour.w;
+	col = lerp(col, float3(0.8f, 0.9f, 1.0f), 1.0f - std::exp(-0.0002f * depth * depth * depth));
+	return float4(col, colour.w);
+}
+
+BakeBenchmark CoralImpostor::RunBakeBenchmark(const Settings& settings, int threadCount)
+{
+	BakeBenchmark result = {};
+	result.frameCount = settings.framesPerSide * settings.framesPerSide;
+	result.threadCount = WorkerThreads::CountFor(result.frameCount, 1, threadCount);
+
+	auto start = std::chrono::steady_clock::now();
+	PlantAtlas::TextureArray atlas = Bake(settings, threadCount);
+	result.bakeMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<uint8_t> pack = PlantAtlas::WriteDds(atlas);
+	result.packMilliseconds = MillisecondsSince(start);
+	result.packBytes = pack.size();
+
+	for (size_t i = 0; i < atlas.offsets[NormalDepthLayer]; i++)
+	{
+		result.coveredTexels += (atlas.texels[i] >> 24) != 0 ? 1 : 0;
+	}
+	return result;
+}
+
+InstanceBenchmark CoralImpostor::RunInstanceBenchmark(const Settings& settings, const PlantAtlas::TextureArray& atlas, const ImplicitCoralReference::Camera& camera, float distance)
+{
+	InstanceBenchmark result = {};
+	result.distance = distance;
+
+	// Seen from the same direction as the default eye, at the given distance
+	ImplicitCoralReference::Camera view = camera;
+	view.eye = settings.centre + normalize(camera.eye - settings.centre) * distance;
+
+	// Only the pixels whose rays pass through the bounding sphere belong to this instance
+	std::vector<float3> rays;
+	for (int y = 0; y < view.height; y++)
+	{
+		for (int x = 0; x < view.width; x++)
+		{
+			float3 rd = ImplicitCoralReference::EyeRay(view, x + 0.5f, y + 0.5f);
+			float3 oc = view.eye - settings.centre;
+			float b = dot(oc, rd);
+			if (b * b - dot(oc, oc) + settings.radius * settings.radius > 0.0f)
+			{
+				rays.push_back(rd);
+			}
+		}
+	}
+	result.pixelCount = static_cast<int>(rays.size());
+
+	std::vector<float4> marched(rays.size());
+	ImplicitCoralReference::MarchSettings march = ImplicitCoralReference::DefaultMarchSettings();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		ImplicitCoralReference::MarchResult hit = ImplicitCoralReference::CastRay(view.eye, rays[i], 0.0f, march);
+		if (hit.material >= 0.0f)
+		{
+			marched[i] = float4(ImplicitCoralReference::Shade(view.eye, rays[i], hit.t, hit.material), 1.0f);
+		}
+	}
+	result.marchMicroseconds = MillisecondsSince(start) * 1000.0;
+
+	std::vector<float4> impostor(rays.size());
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		float depth;
+		impostor[i] = Sample(settings, atlas, view.eye, rays[i], depth);
+	}
+	result.impostorMicroseconds = MillisecondsSince(start) * 1000.0;
+
+	double errorSum = 0.0;
+	int bothCovered = 0;
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		bool marchHit = marched[i].w > 0.0f;
+		bool impostorHit = impostor[i].w > 0.0f;
+		result.marchCovered += marchHit ? 1 : 0;
+		result.impostorCovered += impostorHit ? 1 : 0;
+		if (marchHit && impostorHit)
+		{
+			float3 diff = abs(marched[i].xyz() - impostor[i].xyz());
+			float error = std::max(diff.x, std::max(diff.y, diff.z));
+			errorSum += error;
+			result.maxColourError = std::max(result.maxColourError, error);
+			bothCovered++;
+		}
+	}
+	result.meanColourError = bothCovered > 0 ? static_cast<float>(errorSum / bothCovered) : 0.0f;
+	return result;
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include "ImplicitCoralReference.h"
+#include "PlantAtlas.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Octahedral impostor of the implicit coral for when it is too far away to be worth marching.
+	// A grid of orthographic views over the upper hemisphere is baked on the CPU with the reference
+	// march and lighting: colour with coverage in one layer, normal and depth in the other. At run
+	// time CoralImpostorPixel.hlsl blends the four views nearest the eye on a single quad.
+	namespace CoralImpostor
+	{
+		using ShaderMath::float2;
+		using ShaderMath::float3;
+		using ShaderMath::float4;
+
+		// Layers of the pack, as CoralImpostorPixel samples them.
+		static const uint32_t ColourLayer = 0;
+		static const uint32_t NormalDepthLayer = 1;
+
+		// Must match the far end of MarchInterval, the march draws nothing beyond it.
+		static const float MaxDistance = 20.0f;
+
+		// Bumped whenever the coral or the bake changes, so an older cached pack is not loaded.
+		static const int PackVersion = 1;
+
+		// Must match the constants in CoralImpostor.hlsli.
+		struct Settings
+		{
+			float3 centre;
+			float radius;
+			int framesPerSide;
+			int frameSize;
+			// Closer than this, or below the centre, the coral is marched instead.
+			float minDistance;
+		};
+
+		struct BakeBenchmark
+		{
+			int frameCount;
+			int threadCount;
+			double bakeMilliseconds;
+			double packMilliseconds;
+			size_t packBytes;
+			int coveredTexels;
+		};
+
+		// One distant view of the coral drawn both ways, over the pixels its bounding sphere covers.
+		// Colour errors are against the march, where both cover the pixel.
+		struct InstanceBenchmark
+		{
+			float distance;
+			int pixelCount;
+			int marchCovered;
+			int impostorCovered;
+			double marchMicroseconds;
+			double impostorMicroseconds;
+			float meanColourError;
+			float maxColourError;
+		};
+
+		Settings DefaultSettings();
+
+		// Direction from the centre for a point of the hemi-octahedron in [-1, 1] on each axis, and back.
+		float3 HemiOctToDir(const float2& o);
+		float2 DirToHemiOct(float3 d);
+
+		// Direction from the centre the view in column x, row y of the grid was baked from.
+		float3 FrameDirection(const Settings& settings, float frameX, float frameY);
+
+		// Right and up of the plane a frame looking back along d was baked on.
+		void FrameBasis(const float3& d, float3& right, float3& up);
+
+		// Whether the coral should be drawn as the impostor from eye.
+		bool UseImpostor(const Settings& settings, const float3& eye);
+
+		// Bakes every frame, a frame per thread at a time. Layers are premultiplied by coverage.
+		PlantAtlas::TextureArray Bake(const Settings& settings, int threadCount);
+
+		// Bake and PlantAtlas::WriteDds in one.
+		std::vector<uint8_t> BakePack(const Settings& settings, int threadCount);
+
+		// What CoralImpostorPixel draws for the eye ray ro, rd: colour and coverage, and in depth the
+		// distance along the ray to the surface. Coverage is zero where the ray misses.
+		float4 Sample(const Settings& settings, const PlantAtlas::TextureArray& atlas, const float3& ro, const float3& rd, float& depth);
+
+		BakeBenchmark RunBakeBenchmark(const Settings& settings, int threadCount);
+
+		// The impostor against CastRay and Shade for the view from the default camera's height at distance.
+		InstanceBenchmark RunInstanceBenchmark(const Settings& settings, const PlantAtlas::TextureArray& atlas, const ImplicitCoralReference::Camera& camera, float distance);
+	}
+}
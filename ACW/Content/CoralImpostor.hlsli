@@ -0,0 +1,57 @@
+// Octahedral impostor of the implicit coral, shared by CoralImpostorVertex.hlsl and CoralImpostorPixel.hlsl
+// and ported line for line in CoralImpostor.cpp. The atlas is a grid of IMPOSTOR_FRAMES x IMPOSTOR_FRAMES
+// orthographic views over the upper hemisphere, colour and coverage in layer 0, normal and depth in layer 1.
+
+// Must match CoralImpostor::DefaultSettings() and CoralImpostor::MaxDistance.
+static const float3 IMPOSTOR_CENTRE = float3(-2.0, -3.75, -1.0);
+static const float IMPOSTOR_RADIUS = 0.3;
+static const float IMPOSTOR_FRAMES = 8.0;
+static const float IMPOSTOR_FRAME_SIZE = 64.0;
+static const float IMPOSTOR_MAX_DISTANCE = 20.0;
+
+// The canvas the coral passes build their eye rays from.
+static const float IMPOSTOR_ZOOM = 10.0;
+static const float IMPOSTOR_NEAR_PLANE = 1.0;
+
+// Direction from the centre for a point of the hemi-octahedron in [-1, 1] on each axis
+float3 hemiOctToDir(float2 o)
+{
+	float2 p = float2(o.x + o.y, o.x - o.y) * 0.5;
+	return normalize(float3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y));
+}
+
+float2 dirToHemiOct(float3 d)
+{
+	d.y = max(d.y, 0.0);
+	float2 p = d.xz / max(abs(d.x) + d.y + abs(d.z), 1e-6);
+	return float2(p.x + p.y, p.x - p.y);
+}
+
+float3 frameDirection(float2 frame)
+{
+	return hemiOctToDir(frame / (IMPOSTOR_FRAMES - 1.0) * 2.0 - 1.0);
+}
+
+// Right and up of the plane a frame looking back along d was baked on
+void frameBasis(float3 d, out float3 right, out float3 up)
+{
+	float3 helper = d.y > 0.999 ? float3(0.0, 0.0, 1.0) : float3(0.0, 1.0, 0.0);
+	right = normalize(cross(d, helper));
+	up = cross(right, d);
+}
+
+// Where the eye ray meets a frame's plane, pushed offset along the frame's direction, as an atlas uv
+float2 frameUV(float2 frame, float3 ro, float3 rd, float offset)
+{
+	float3 d = frameDirection(frame);
+	float3 right, up;
+	frameBasis(d, right, up);
+	float t = dot(IMPOSTOR_CENTRE + d * offset - ro, d) / dot(rd, d);
+	float3 q = ro + rd * t - IMPOSTOR_CENTRE;
+	float2 local = float2(dot(q, right), -dot(q, up)) / IMPOSTOR_RADIUS * 0.5 + 0.5;
+
+	// Keep bilinear filtering inside the frame
+	float edge = 0.5 / IMPOSTOR_FRAME_SIZE;
+	local = clamp(local, edge, 1.0 - edge);
+	return (frame + local) / IMPOSTOR_FRAMES;
+}
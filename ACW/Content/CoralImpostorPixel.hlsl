@@ -0,0 +1,87 @@
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer modelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 eye;
+	float4 lookAt;
+	float4 upDir;
+};
+
+#include "CoralImpostor.hlsli"
+
+// Colour in layer 0 and normal and depth in layer 1, both premultiplied by coverage, baked by CoralImpostor.
+Texture2DArray impostorAtlas : register(t0);
+SamplerState impostorSampler : register(s0);
+
+struct VS_Canvas
+{
+	float4 position : SV_POSITION;
+	float2 canvasXY : TEXCOORD0;
+};
+
+struct PixelShaderOutput
+{
+	float4 colour : SV_TARGET;
+	float depth : SV_DEPTH;
+};
+
+PixelShaderOutput main(VS_Canvas input)
+{
+	float3 ro = eye.xyz;
+	float3 pixelPos = float3(IMPOSTOR_ZOOM * input.canvasXY, IMPOSTOR_NEAR_PLANE);
+	float3 rd = normalize(pixelPos - ro);
+
+	// The four frames around the eye's direction, weighted by how close each is
+	float lastFrame = IMPOSTOR_FRAMES - 1.0;
+	float3 toEye = normalize(ro - IMPOSTOR_CENTRE);
+	float2 grid = (dirToHemiOct(toEye) * 0.5 + 0.5) * lastFrame;
+	float2 base = min(floor(grid), lastFrame - 1.0);
+	float2 w = grid - base;
+
+	float4 colour = float4(0.0, 0.0, 0.0, 0.0);
+	float4 normalDepth = float4(0.0, 0.0, 0.0, 0.0);
+	[unroll]
+	for (int i = 0; i < 4; i++)
+	{
+		float2 corner = float2(i & 1, i >> 1);
+		float weight = (corner.x > 0.0 ? w.x : 1.0 - w.x) * (corner.y > 0.0 ? w.y : 1.0 - w.y);
+
+		// One step of parallax: find the baked depth where the ray crosses the frame's plane, then read
+		// the frame where the ray crosses that depth instead, so the views line up before blending
+		float2 uv = frameUV(base + corner, ro, rd, 0.0);
+		float coverage = impostorAtlas.SampleLevel(impostorSampler, float3(uv, 0.0), 0.0).a;
+		if (coverage > 0.0)
+		{
+			float planeDepth = impostorAtlas.SampleLevel(impostorSampler, float3(uv, 1.0), 0.0).a / coverage;
+			uv = frameUV(base + corner, ro, rd, (planeDepth * 2.0 - 1.0) * IMPOSTOR_RADIUS);
+		}
+		colour += impostorAtlas.SampleLevel(impostorSampler, float3(uv, 0.0), 0.0) * weight;
+		normalDepth += impostorAtlas.SampleLevel(impostorSampler, float3(uv, 1.0), 0.0) * weight;
+	}
+
+	if (colour.a < 0.5)
+	{
+		discard;
+	}
+
+	// The baked depth puts the surface on a plane facing the eye, the ray meets it there
+	float offset = (normalDepth.a / colour.a * 2.0 - 1.0) * IMPOSTOR_RADIUS;
+	float t = dot(IMPOSTOR_CENTRE + toEye * offset - ro, toEye) / dot(rd, toEye);
+	if (t > IMPOSTOR_MAX_DISTANCE)
+	{
+		discard;
+	}
+
+	float3 col = colour.rgb / colour.a;
+	col = lerp(col, float3(0.8, 0.9, 1.0), 1.0 - exp(-0.0002 * t * t * t));
+
+	float3 pos = ro + t * rd;
+	float4 depthPos = mul(mul(float4(pos, 1), view), projection);
+
+	PixelShaderOutput output;
+	output.colour = float4(col, 1.0);
+	output.depth = depthPos.z / depthPos.w;
+	return output;
+}
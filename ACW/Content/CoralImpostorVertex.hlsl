@@ -0,0 +1,43 @@
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer modelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 eye;
+	float4 lookAt;
+	float4 upDir;
+};
+
+#include "CoralImpostor.hlsli"
+
+struct VS_Canvas
+{
+	float4 position : SV_POSITION;
+	float2 canvasXY : TEXCOORD0;
+};
+
+// One quad per impostor, drawn as a four vertex strip with no vertex buffer. It faces the eye from
+// the front of the bounding sphere and is projected onto the same canvas the coral is marched on,
+// so the pixel shader can rebuild the marched eye ray from canvasXY.
+VS_Canvas main(uint vertexID : SV_VertexID)
+{
+	float2 corner = float2((vertexID & 1) ? 1.0 : -1.0, (vertexID & 2) ? -1.0 : 1.0);
+
+	float3 toEye = normalize(eye.xyz - IMPOSTOR_CENTRE);
+	float3 right, up;
+	frameBasis(toEye, right, up);
+	float3 worldPos = IMPOSTOR_CENTRE + (toEye + right * corner.x + up * corner.y) * IMPOSTOR_RADIUS;
+
+	// Where the ray from the eye through the corner crosses the canvas
+	float s = (IMPOSTOR_NEAR_PLANE - eye.z) / (worldPos.z - eye.z);
+	float2 canvas = (eye.xy + (worldPos.xy - eye.xy) * s) / IMPOSTOR_ZOOM;
+
+	// Calculate the aspect ratio
+	float aspectRatio = projection._m11 / projection._m00;
+
+	VS_Canvas output;
+	output.canvasXY = canvas;
+	output.position = float4(canvas / float2(aspectRatio, 1.0), 0.0, 1.0);
+	return output;
+}
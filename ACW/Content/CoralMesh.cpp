@@ -0,0 +1,523 @@
+﻿#include "pch.h"
+#include "CoralMesh.h"
+#include "PlantInstances.h"
+#include "WorkerThreads.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::CoralMesh;
+
+namespace
+{
+	const float TwoPi = 6.28318530718f;
+
+	// Growth stops after this many steps even if nodes are still being added
+	const int MaxGrowthSteps = 1000;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	class Random
+	{
+	public:
+		// Consecutive seeds are hashed apart, xorshift alone keeps them close for the first few numbers
+		explicit Random(uint32_t seed)
+		{
+			uint32_t h = seed * 0x9e3779b9u + 0x7f4a7c15u;
+			h ^= h >> 16;
+			h *= 0x85ebca6bu;
+			h ^= h >> 13;
+			h *= 0xc2b2ae35u;
+			h ^= h >> 16;
+			mState = h ? h : 1u;
+		}
+
+		// Uniform in [0, 1)
+		float Next()
+		{
+			mState ^= mState << 13;
+			mState ^= mState >> 17;
+			mState ^= mState << 5;
+			return static_cast<float>(mState >> 8) / 16777216.0f;
+		}
+
+		float Range(float lo, float hi)
+		{
+			return lo + (hi - lo) * Next();
+		}
+
+	private:
+		uint32_t mState;
+	};
+
+	// Branch nodes bucketed in cells influenceRadius wide, as linked lists through next, so an
+	// attraction point only looks at the 3x3x3 cells around it for the nearest node.
+	struct NodeGrid
+	{
+		float3 origin;
+		float inverseCellSize;
+		int size[3];
+		std::vector<int> head;
+		std::vector<int> next;
+
+		NodeGrid(const float3& minCorner, const float3& maxCorner, float cellSize) :
+			origin(minCorner), inverseCellSize(1.0f / cellSize)
+		{
+			float3 extent = maxCorner - minCorner;
+			size[0] = static_cast<int>(extent.x * inverseCellSize) + 1;
+			size[1] = static_cast<int>(extent.y * inverseCellSize) + 1;
+			size[2] = static_cast<int>(extent.z * inverseCellSize) + 1;
+			head.assign(static_cast<size_t>(size[0]) * size[1] * size[2], -1);
+		}
+
+		int Cell(float v, float o, int axis) const
+		{
+			int c = static_cast<int>((v - o) * inverseCellSize);
+			return std::min(std::max(c, 0), size[axis] - 1);
+		}
+
+		void Insert(const float3& p, int node)
+		{
+			int cell = (Cell(p.z, origin.z, 2) * size[1] + Cell(p.y, origin.y, 1)) * size[0] + Cell(p.x, origin.x, 0);
+			next.resize(std::max(next.size(), static_cast<size_t>(node) + 1), -1);
+			next[node] = head[cell];
+			head[cell] = node;
+		}
+
+		// Nearest node to p closer than radius, -1 if there is none
+		int Nearest(const std::vector<float3>& nodes, const float3& p, float radius, float& distance) const
+		{
+			int cx = Cell(p.x, origin.x, 0);
+			int cy = Cell(p.y, origin.y, 1);
+			int cz = Cell(p.z, origin.z, 2);
+
+			int nearest = -1;
+			float best = radius * radius;
+			for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, size[2] - 1); z++)
+			{
+				for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, size[1] - 1); y++)
+				{
+					for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, size[0] - 1); x++)
+					{
+						for (int node = head[(z * size[1] + y) * size[0] + x]; node >= 0; node = next[node])
+						{
+							float3 d = nodes[node] - p;
+							float d2 = dot(d, d);
+							if (d2 < best)
+							{
+								best = d2;
+								nearest = node;
+							}
+						}
+					}
+				}
+			}
+			distance = std::sqrt(best);
+			return nearest;
+		}
+	};
+
+	// Any unit vector at right angles to t
+	float3 Perpendicular(const float3& t)
+	{
+		float3 helper = std::fabs(t.x) < 0.9f ? float3(1.0f, 0.0f, 0.0f) : float3(0.0f, 0.0f, 1.0f);
+		return normalize(cross(helper, t));
+	}
+
+	// A ring of sides vertices round centre in the plane of normal and binormal, facing outwards
+	uint16_t AddRing(Mesh& mesh, const float3& centre, const float3& normal, const float3& binormal, float radius, int sides)
+	{
+		uint16_t first = static_cast<uint16_t>(mesh.vertices.size());
+		for (int k = 0; k < sides; k++)
+		{
+			float angle = TwoPi * k / sides;
+			float3 radial = normal * std::cos(angle) + binormal * std::sin(angle);
+			mesh.vertices.push_back({ centre + radial * radius, radial });
+		}
+		return first;
+	}
+
+	// Quads between two rings, wound clockwise seen from outside
+	void AddTube(Mesh& mesh, uint16_t lower, uint16_t upper, int sides)
+	{
+		for (int k = 0; k < sides; k++)
+		{
+			uint16_t k1 = static_cast<uint16_t>((k + 1) % sides);
+			uint16_t a = static_cast<uint16_t>(lower + k);
+			uint16_t b = static_cast<uint16_t>(lower + k1);
+			uint16_t c = static_cast<uint16_t>(upper + k);
+			uint16_t d = static_cast<uint16_t>(upper + k1);
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, b, d, c });
+		}
+	}
+}
+
+GrowthSettings CoralMesh::DefaultSettings()
+{
+	GrowthSettings settings;
+	settings.attractorCount = 300;
+	settings.crownRadius = 0.6f;
+	settings.crownHeight = 0.8f;
+	settings.trunkHeight = 0.15f;
+	settings.influenceRadius = 0.3f;
+	settings.killRadius = 0.06f;
+	settings.segmentLength = 0.03f;
+	// Keeps the vertex count of a variant within 16 bit indices: maxNodes * (2 * ringSides + 1) < 65536
+	settings.maxNodes = 2000;
+	settings.tipRadius = 0.008f;
+	settings.ringSides = 6;
+	settings.ringSpacing = 3;
+	return settings;
+}
+
+Mesh CoralMesh::Generate(const GrowthSettings& settings, uint32_t seed, int* nodeCount)
+{
+	Random random(seed);
+
+	// Each seed gets its own crown proportions as well as its own points
+	float crownRadius = settings.crownRadius * random.Range(0.7f, 1.3f);
+	float crownHeight = settings.crownHeight * random.Range(0.7f, 1.3f);
+	float trunkHeight = settings.trunkHeight * random.Range(0.5f, 1.5f);
+
+	std::vector<float3> attractors;
+	attractors.reserve(settings.attractorCount);
+	while (static_cast<int>(attractors.size()) < settings.attractorCount)
+	{
+		// One call per statement, argument order would leave the components up to the compiler
+		float3 p;
+		p.x = random.Range(-1.0f, 1.0f);
+		p.y = random.Next();
+		p.z = random.Range(-1.0f, 1.0f);
+		if (dot(p, p) <= 1.0f)
+		{
+			attractors.push_back(float3(p.x * crownRadius, trunkHeight + p.y * crownHeight, p.z * crownRadius));
+		}
+	}
+
+	float margin = settings.influenceRadius;
+	NodeGrid grid(float3(-crownRadius - margin, -margin, -crownRadius - margin),
+		float3(crownRadius + margin, trunkHeight + crownHeight + margin, crownRadius + margin), settings.influenceRadius);
+
+	std::vector<float3> nodes;
+	std::vector<int> parents;
+	nodes.push_back(float3(0.0f, 0.0f, 0.0f));
+	parents.push_back(-1);
+	grid.Insert(nodes[0], 0);
+
+	// The trunk grows straight up until the crown starts pulling on it
+	float distance;
+	for (;;)
+	{
+		bool reached = false;
+		for (const float3& a : attractors)
+		{
+			reached = reached || length(a - nodes.back()) < settings.influenceRadius;
+		}
+		if (reached || nodes.back().y > trunkHeight + crownHeight)
+		{
+			break;
+		}
+		nodes.push_back(nodes.back() + float3(0.0f, settings.segmentLength, 0.0f));
+		parents.push_back(static_cast<int>(nodes.size()) - 2);
+		grid.Insert(nodes.back(), static_cast<int>(nodes.size()) - 1);
+	}
+
+	std::vector<float3> pull;
+	std::vector<int> pulledBy;
+	std::vector<int> lastChild(nodes.size(), -1);
+	for (int step = 0; step < MaxGrowthSteps && !attractors.empty(); step++)
+	{
+		pull.assign(nodes.size(), float3());
+		pulledBy.assign(nodes.size(), 0);
+
+		// Each point pulls only its nearest node, and is dropped once a node reaches it
+		for (size_t i = 0; i < attractors.size();)
+		{
+			int nearest = grid.Nearest(nodes, attractors[i], settings.influenceRadius, distance);
+			if (nearest >= 0 && distance < settings.killRadius)
+			{
+				attractors[i] = attractors.back();
+				attractors.pop_back();
+				continue;
+			}
+			if (nearest >= 0)
+			{
+				pull[nearest] += (attractors[i] - nodes[nearest]) / std::max(distance, 1e-6f);
+				pulledBy[nearest]++;
+			}
+			i++;
+		}
+
+		size_t grownFrom = nodes.size();
+		for (size_t n = 0; n < grownFrom && static_cast<int>(nodes.size()) < settings.maxNodes; n++)
+		{
+			// Points pulling from opposite sides cancel out and leave the node where it is
+			if (pulledBy[n] == 0 || length(pull[n]) < 1e-3f)
+			{
+				continue;
+			}
+
+			// A node still pulled the same way as last time would only grow the same child again
+			float3 grown = nodes[n] + normalize(pull[n]) * settings.segmentLength;
+			if (lastChild[n] >= 0 && length(grown - nodes[lastChild[n]]) < 0.1f * settings.segmentLength)
+			{
+				continue;
+			}
+
+			lastChild[n] = static_cast<int>(nodes.size());
+			nodes.push_back(grown);
+			parents.push_back(static_cast<int>(n));
+			grid.Insert(nodes.back(), static_cast<int>(nodes.size()) - 1);
+		}
+
+		lastChild.resize(nodes.size(), -1);
+		if (nodes.size() == grownFrom)
+		{
+			break;
+		}
+	}
+
+	// Parents always come before their children, so one backwards pass adds up the cross sections
+	int count = static_cast<int>(nodes.size());
+	std::vector<int> childCount(count, 0);
+	for (int i = 1; i < count; i++)
+	{
+		childCount[parents[i]]++;
+	}
+
+	std::vector<float> area(count, 0.0f);
+	for (int i = count - 1; i >= 0; i--)
+	{
+		if (childCount[i] == 0)
+		{
+			area[i] = settings.tipRadius * settings.tipRadius;
+		}
+		if (parents[i] >= 0)
+		{
+			area[parents[i]] += area[i];
+		}
+	}
+
+	// Frames carried up from the root by parallel transport, so rings along a branch do not twist
+	std::vector<float3> tangents(count);
+	std::vector<float3> normals(count);
+	tangents[0] = float3(0.0f, 1.0f, 0.0f);
+	normals[0] = float3(1.0f, 0.0f, 0.0f);
+	for (int i = 1; i < count; i++)
+	{
+		float3 t = normalize(nodes[i] - nodes[parents[i]]);
+		float3 n = normals[parents[i]] - t * dot(normals[parents[i]], t);
+		tangents[i] = t;
+		normals[i] = length(n) > 1e-4f ? normalize(n) : Perpendicular(t);
+	}
+
+	// Rings go at the root, tips, either side of a fork and every ringSpacing nodes between
+	Mesh mesh;
+	int sides = settings.ringSides;
+	std::vector<int> ring(count, -1);
+	std::vector<int> ringAncestor(count, -1);
+	std::vector<int> sinceRing(count, 0);
+	for (int i = 0; i < count; i++)
+	{
+		int parent = parents[i];
+		if (parent >= 0)
+		{
+			ringAncestor[i] = ring[parent] >= 0 ? parent : ringAncestor[parent];
+			sinceRing[i] = sinceRing[parent] + 1;
+		}
+
+		bool ringed = parent < 0 || childCount[i] != 1 || childCount[parent] != 1 || sinceRing[i] >= settings.ringSpacing;
+		if (!ringed)
+		{
+			continue;
+		}
+
+		float radius = std::sqrt(area[i]);
+		float3 binormal = cross(tangents[i], normals[i]);
+		ring[i] = AddRing(mesh, nodes[i], normals[i], binormal, radius, sides);
+		sinceRing[i] = 0;
+
+		if (parent >= 0)
+		{
+			// A branch leaving a fork starts from a ring of its own size, not the fork's
+			int lower = ring[ringAncestor[i]];
+			if (childCount[ringAncestor[i]] > 1)
+			{
+				lower = AddRing(mesh, nodes[ringAncestor[i]], normals[i], binormal, radius, sides);
+			}
+			AddTube(mesh, static_cast<uint16_t>(lower), static_cast<uint16_t>(ring[i]), sides);
+		}
+
+		// Close each tip with a fan round a point one radius further on
+		if (childCount[i] == 0)
+		{
+			uint16_t tip = static_cast<uint16_t>(mesh.vertices.size());
+			mesh.vertices.push_back({ nodes[i] + tangents[i] * radius, tangents[i] });
+			for (int k = 0; k < sides; k++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { static_cast<uint16_t>(ring[i] + k), static_cast<uint16_t>(ring[i] + (k + 1) % sides), tip });
+			}
+		}
+	}
+
+	MeshOptimizer::Lod full = { 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f };
+	mesh.lods.assign(1, full);
+
+	if (nodeCount)
+	{
+		*nodeCount = count;
+	}
+	return mesh;
+}
+
+std::vector<Variant> CoralMesh::GenerateVariants(const GrowthSettings& settings, uint32_t firstSeed, int count, int threadCount)
+{
+	std::vector<Variant> variants(count);
+
+	// Variants differ a lot in size, so threads take the next seed as they finish
+	std::atomic<int> nextVariant(0);
+	WorkerThreads::Run(WorkerThreads::CountFor(count, 1, threadCount), [&](int)
+	{
+		for (int i = nextVariant++; i < count; i = nextVariant++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			Variant& variant = variants[i];
+			variant.seed = firstSeed + i;
+			variant.mesh = Generate(settings, variant.seed, &variant.nodeCount);
+			variant.milliseconds = MillisecondsSince(start);
+		}
+	});
+	return variants;
+}
+
+MeshOptimizer::Report CoralMesh::Optimize(Mesh& mesh, const MeshOptimizer::Settings& settings)
+{
+	std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+	std::vector<float3> positions(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		positions[i] = mesh.vertices[i].position;
+	}
+
+	// Simplifying only drops vertices, so every level still fits 16 bit indices
+	MeshOptimizer::Result result = MeshOptimizer::Optimize(indices, positions, sizeof(Vertex), settings);
+	mesh.vertices = MeshOptimizer::RemapVertices(mesh.vertices, result.remap, result.vertexCount);
+	mesh.indices.assign(result.indices.begin(), result.indices.end());
+	mesh.lods = result.lods;
+	return result.report;
+}
+
+void CoralMesh::OptimizeVariants(std::vector<Variant>& variants, const MeshOptimizer::Settings& settings, int threadCount)
+{
+	int count = static_cast<int>(variants.size());
+	std::atomic<int> nextVariant(0);
+	WorkerThreads::Run(WorkerThreads::CountFor(count, 1, threadCount), [&](int)
+	{
+		for (int i = nextVariant++; i < count; i = nextVariant++)
+		{
+			variants[i].optimization = Optimize(variants[i].mesh, settings);
+		}
+	});
+}
+
+std::vector<Meshlets::MeshletMesh> CoralMesh::BuildMeshlets(const Mesh& mesh)
+{
+	std::vector<float3> positions(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		positions[i] = mesh.vertices[i].position;
+	}
+
+	std::vector<Meshlets::MeshletMesh> meshlets;
+	for (const MeshOptimizer::Lod& lod : mesh.lods)
+	{
+		std::vector<uint32_t> indices(mesh.indices.begin() + lod.firstIndex, mesh.indices.begin() + lod.firstIndex + lod.indexCount);
+		meshlets.push_back(Meshlets::BuildMeshlets(indices, positions));
+	}
+	return meshlets;
+}
+
+void CoralMesh::BuildVariantMeshlets(std::vector<Variant>& variants, int threadCount)
+{
+	int count = static_cast<int>(variants.size());
+	std::atomic<int> nextVariant(0);
+	WorkerThreads::Run(WorkerThreads::CountFor(count, 1, threadCount), [&](int)
+	{
+		for (int i = nextVariant++; i < count; i = nextVariant++)
+		{
+			variants[i].meshlets = BuildMeshlets(variants[i].mesh);
+		}
+	});
+}
+
+std::vector<Instance> CoralMesh::PlaceOnSeabed(uint32_t variantCount, uint32_t seed)
+{
+	// A jittered grid in front of the camera, keeping only the points the water covers
+	const float spacing = 2.5f;
+	const float jitter = 0.9f;
+	const float depth = 0.1f;
+
+	Random random(seed);
+	std::vector<Instance> instances;
+	for (float z = -8.0f; z <= 28.0f; z += spacing)
+	{
+		for (float x = -18.0f; x <= 18.0f; x += spacing)
+		{
+			float px = x + random.Range(-jitter, jitter);
+			float pz = z + random.Range(-jitter, jitter);
+			float height = PlantInstances::FractalNoise(PlantInstances::float2(px, pz));
+
+			Instance instance;
+			instance.scale = random.Range(0.6f, 1.2f);
+			instance.angle = random.Range(0.0f, TwoPi);
+			instance.variant = static_cast<uint32_t>(random.Next() * variantCount) % variantCount;
+			if (height > PlantInstances::MinHeight - depth)
+			{
+				continue;
+			}
+
+			// Sunk a little so the base sits in the terrain on a slope
+			instance.position = float3(px, height - 0.02f, pz);
+			instances.push_back(instance);
+		}
+	}
+
+	std::stable_sort(instances.begin(), instances.end(), [](const Instance& a, const Instance& b) { return a.variant < b.variant; });
+	return instances;
+}
+
+GenerationBenchmark CoralMesh::RunGenerationBenchmark(const GrowthSettings& settings, int count, int threadCount)
+{
+	GenerationBenchmark result = {};
+	result.variantCount = count;
+	result.threadCount = WorkerThreads::CountFor(count, 1, threadCount);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Variant> variants = GenerateVariants(settings, 1u, count, threadCount);
+	result.wallMilliseconds = MillisecondsSince(start);
+
+	result.minTriangles = count > 0 ? static_cast<int>(variants[0].mesh.indices.size() / 3) : 0;
+	for (const Variant& variant : variants)
+	{
+		int triangles = static_cast<int>(variant.mesh.indices.size() / 3);
+		result.minTriangles = std::min(result.minTriangles, triangles);
+		result.maxTriangles = std::max(result.maxTriangles, triangles);
+		result.meanTriangles += triangles;
+		result.meanVertices += static_cast<double>(variant.mesh.vertices.size());
+		result.meanMilliseconds += variant.milliseconds;
+		result.maxMilliseconds = std::max(result.maxMilliseconds, variant.milliseconds);
+	}
+	if (count > 0)
+	{
+		result.meanTriangles /= count;
+		result.meanVertices /= count;
+		result.meanMilliseconds /= count;
+	}
+	return result;
+}
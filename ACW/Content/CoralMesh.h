@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "ShaderMath.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Branching coral meshes grown on the CPU at load by space colonisation. A cloud of attraction
+	// points fills the crown, and every step each point pulls the branch node nearest it one segment
+	// closer until the node reaches it. The branches are then skinned as tubes, thicker towards the
+	// base as each node carries the cross section of every branch above it. A seed gives one variant.
+	namespace CoralMesh
+	{
+		using ShaderMath::float3;
+
+		struct GrowthSettings
+		{
+			// Attraction points in the crown, an upper half ellipsoid above the trunk.
+			int attractorCount;
+			float crownRadius;
+			float crownHeight;
+			float trunkHeight;
+
+			// Points only pull nodes within influenceRadius, and are reached within killRadius.
+			float influenceRadius;
+			float killRadius;
+			float segmentLength;
+
+			// Growth stops at this many nodes whatever is left to reach.
+			int maxNodes;
+
+			// Tips are tipRadius thick, and a node's radius squared is the sum of its children's.
+			float tipRadius;
+			int ringSides;
+
+			// Straight runs only get a ring of vertices every ringSpacing nodes.
+			int ringSpacing;
+		};
+
+		// Laid out as the POSITION and NORMAL of the coral mesh input layout.
+		struct Vertex
+		{
+			float3 position;
+			float3 normal;
+		};
+
+		// Levels of detail index ranges of indices, a single level until the mesh is optimised.
+		struct Mesh
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint16_t> indices;
+			std::vector<MeshOptimizer::Lod> lods;
+		};
+
+		struct Variant
+		{
+			uint32_t seed;
+			Mesh mesh;
+			int nodeCount;
+			double milliseconds;
+			MeshOptimizer::Report optimization;
+
+			// The clusters of each level of detail, once built.
+			std::vector<Meshlets::MeshletMesh> meshlets;
+		};
+
+		// One coral on the sea bed, laid out as the per instance data of the coral mesh input layout.
+		struct Instance
+		{
+			float3 position;
+			float scale;
+			float angle;
+			uint32_t variant;
+		};
+
+		struct GenerationBenchmark
+		{
+			int variantCount;
+			int threadCount;
+
+			double wallMilliseconds;
+			double meanMilliseconds;
+			double maxMilliseconds;
+
+			int minTriangles;
+			int maxTriangles;
+			double meanTriangles;
+			double meanVertices;
+		};
+
+		GrowthSettings DefaultSettings();
+
+		Mesh Generate(const GrowthSettings& settings, uint32_t seed, int* nodeCount = nullptr);
+
+		// Variants for seeds firstSeed up to firstSeed + count - 1, in seed order. 0 threads uses one per hardware thread.
+		std::vector<Variant> GenerateVariants(const GrowthSettings& settings, uint32_t firstSeed, int count, int threadCount);
+
+		// Runs MeshOptimizer::Optimize on the mesh, reordering its vertices and indices and building its levels of detail.
+		MeshOptimizer::Report Optimize(Mesh& mesh, const MeshOptimizer::Settings& settings);
+
+		// Optimize on every variant, a variant per thread at a time.
+		void OptimizeVariants(std::vector<Variant>& variants, const MeshOptimizer::Settings& settings, int threadCount);
+
+		// Meshlets::BuildMeshlets on each level of detail of the mesh, numbering the vertices as the mesh does.
+		std::vector<Meshlets::MeshletMesh> BuildMeshlets(const Mesh& mesh);
+
+		// BuildMeshlets on every variant, a variant per thread at a time.
+		void BuildVariantMeshlets(std::vector<Variant>& variants, int threadCount);
+
+		// Spread over the sea bed below the water around the camera, grouped by variant for instanced draws.
+		std::vector<Instance> PlaceOnSeabed(uint32_t variantCount, uint32_t seed);
+
+		GenerationBenchmark RunGenerationBenchmark(const GrowthSettings& settings, int count, int threadCount);
+	}
+}
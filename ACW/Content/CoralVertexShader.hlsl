@@ -6,48 +6,57 @@ cbuffer modelViewProjectionConstantBuffer : register(b0)
     float4 eye;
     float4 lookAt;
     float4 upDir;
+    matrix viewProjection;
 };
 
+#include "VertexQuantization.hlsli"
+
+// Must match CoralMeshMaxVariants in ShaderStructures.h
+static const uint CoralMeshMaxVariants = 16;
+
+// Bounding box of each variant, its packed positions are normalised within it.
+cbuffer coralMeshBoundsConstantBuffer : register(b2)
+{
+    float4 boundsMinimum[CoralMeshMaxVariants];
+    float4 boundsExtent[CoralMeshMaxVariants];
+};
+
+// One packed vertex of a coral variant from CoralMesh, and the instance placing it on the sea bed.
 struct VertexInput
 {
-    float3 position : POSITION;
+    float4 position : POSITION;
+    float2 normal : NORMAL;
+    float3 instancePosition : INSTANCEPOSITION;
+    float scale : SCALE;
+    float angle : ANGLE;
+    uint variant : VARIANT;
 };
 
 struct VertexOutput
 {
     float4 position : SV_POSITION;
+    float3 normal : NORMAL;
+    float3 posWorld : TEXCOORD0;
+    float height : TEXCOORD1;
 };
 
-// Simple function to transform the cube into a star-like object
-float3 TransformToStar(float3 position)
-{
-    // Scale the cube along the Y-axis to make it thinner
-    position.y *= 0.5;
-
-    // Apply a sin function to create the star-like effect
-    float angle = atan2(position.z, position.x);
-    float radius = length(position.xz);
-    float starFactor = sin(radius * 10.0) * 0.5 + 0.5;
-
-    // Combine the original position with the modified position
-    position.x = cos(angle) * radius * starFactor;
-    position.z = sin(angle) * radius * starFactor;
-
-    return position;
-}
-
-// Simple shader to do vertex processing on the GPU.
 VertexOutput main(VertexInput input)
 {
     VertexOutput output;
-    input.position = float3(0, 2, 0);
-    float3 pos = input.position;
 
-    // Apply the transformation to the star-like shape
-    pos = TransformToStar(pos);
+    float3 position = DecodePosition(input.position.xyz, boundsMinimum[input.variant].xyz, boundsExtent[input.variant].xyz);
+    float3 unpacked = OctDecode(input.normal);
+
+    // Turn about the vertical, then scale and move onto the sea bed
+    float s, c;
+    sincos(input.angle, s, c);
+    float3 local = float3(c * position.x + s * position.z, position.y, c * position.z - s * position.x);
+    float3 normal = float3(c * unpacked.x + s * unpacked.z, unpacked.y, c * unpacked.z - s * unpacked.x);
 
-    // Output the final position in clip space
-    output.position = float4(pos, 1.0f);
+    output.posWorld = input.instancePosition + local * input.scale;
+    output.position = mul(float4(output.posWorld, 1.0f), viewProjection);
+    output.normal = normal;
+    output.height = position.y;
 
     return output;
 }
@@ -0,0 +1,699 @@
+﻿#include "pch.h"
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace ACW;
+using namespace ACW::FrameGraph;
+
+namespace
+{
+	double MicrosecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const char* FormatName(Format format)
+	{
+		switch (format)
+		{
+		case Format::Rgba8Unorm:
+			return "rgba8";
+		case Format::Rg32Float:
+			return "rg32f";
+		case Format::R32Float:
+			return "r32f";
+		case Format::Depth32Float:
+			return "d32f";
+		}
+		return "?";
+	}
+
+	std::string TextureName(uint32_t texture)
+	{
+		if (texture == NoTexture)
+		{
+			return "none";
+		}
+		if (texture & ImportedTexture)
+		{
+			return "imported" + std::to_string(texture & ~ImportedTexture);
+		}
+		return "t" + std::to_string(texture);
+	}
+
+	bool SameViewport(const Viewport& a, const Viewport& b)
+	{
+		return a.width == b.width && a.height == b.height;
+	}
+}
+
+void PassBuilder::Read(Resource resource)
+{
+	mPass.reads.push_back(resource);
+}
+
+void PassBuilder::Write(Resource resource)
+{
+	if (mPass.colourCount < MaxColourTargets)
+	{
+		mPass.clearColour[mPass.colourCount] = false;
+		mPass.colour[mPass.colourCount++] = resource;
+	}
+}
+
+void PassBuilder::Clear(Resource resource, const float colour[4])
+{
+	if (mPass.colourCount < MaxColourTargets)
+	{
+		int slot = mPass.colourCount;
+		Write(resource);
+		mPass.clearColour[slot] = true;
+		std::copy(colour, colour + 4, mPass.clearColours[slot]);
+	}
+}
+
+void PassBuilder::WriteDepth(Resource resource)
+{
+	mPass.depth = resource;
+	mPass.clearDepth = false;
+}
+
+void PassBuilder::ClearDepth(Resource resource, float depth)
+{
+	mPass.depth = resource;
+	mPass.clearDepth = true;
+	mPass.clearDepthValue = depth;
+}
+
+void PassBuilder::SetViewport(float width, float height)
+{
+	mPass.viewport.width = width;
+	mPass.viewport.height = height;
+}
+
+void PassBuilder::KeepAlive()
+{
+	mPass.keepAlive = true;
+}
+
+uint32_t PassContext::Texture(Resource resource) const
+{
+	return mGraph.mResources[resource].texture;
+}
+
+Graph::Graph() :
+	mCompileStats(),
+	mExecuteStats()
+{
+}
+
+void Graph::Reset()
+{
+	mPasses.clear();
+	mResources.clear();
+	mCulled.clear();
+	mOrder.clear();
+}
+
+Resource Graph::Import(const char* name, const TextureDesc& desc, uint32_t texture)
+{
+	mResources.push_back({ name, desc, true, ImportedTexture | texture, -1, -1 });
+	return static_cast<Resource>(mResources.size() - 1);
+}
+
+Resource Graph::Create(const char* name, const TextureDesc& desc)
+{
+	mResources.push_back({ name, desc, false, NoTexture, -1, -1 });
+	return static_cast<Resource>(mResources.size() - 1);
+}
+
+void Graph::AddPass(const char* name, const std::function<void(PassBuilder&)>& setup, const std::function<void(const PassContext&)>& execute)
+{
+	mPasses.emplace_back();
+	Pass& pass = mPasses.back();
+	pass.name = name;
+	pass.colourCount = 0;
+	pass.depth = NoResource;
+	pass.clearDepth = false;
+	pass.clearDepthValue = 1.0f;
+	pass.viewport = { 0.0f, 0.0f };
+	pass.keepAlive = false;
+	pass.execute = execute;
+
+	PassBuilder builder(pass);
+	setup(builder);
+}
+
+Viewport Graph::PassViewport(const Pass& pass) const
+{
+	if (pass.viewport.width > 0.0f && pass.viewport.height > 0.0f)
+	{
+		return pass.viewport;
+	}
+	if (pass.colourCount == 0 && pass.depth == NoResource)
+	{
+		return pass.viewport;
+	}
+
+	const TextureDesc& desc = mResources[pass.colourCount > 0 ? pass.colour[0] : pass.depth].desc;
+	return { static_cast<float>(desc.width), static_cast<float>(desc.height) };
+}
+
+//Walks the passes back from the end of the frame with the imported textures, which are seen after it, as the
+//only live ones. A pass that writes nothing live is culled, otherwise what it reads becomes live, and what it
+//clears stops being, as nothing before it can be seen through the clear
+void Graph::Cull()
+{
+	mCulled.assign(mPasses.size(), false);
+
+	std::vector<bool> live(mResources.size(), false);
+	for (size_t r = 0; r < mResources.size(); r++)
+	{
+		live[r] = mResources[r].imported;
+	}
+
+	for (size_t i = mPasses.size(); i-- > 0;)
+	{
+		const Pass& pass = mPasses[i];
+		bool needed = pass.keepAlive;
+		for (int c = 0; c < pass.colourCount; c++)
+		{
+			needed = needed || live[pass.colour[c]];
+		}
+		if (pass.depth != NoResource)
+		{
+			needed = needed || live[pass.depth];
+		}
+
+		if (!needed)
+		{
+			mCulled[i] = true;
+			continue;
+		}
+
+		for (int c = 0; c < pass.colourCount; c++)
+		{
+			if (pass.clearColour[c])
+			{
+				live[pass.colour[c]] = false;
+			}
+		}
+		if (pass.depth != NoResource && pass.clearDepth)
+		{
+			live[pass.depth] = false;
+		}
+		for (Resource r : pass.reads)
+		{
+			live[r] = true;
+		}
+	}
+}
+
+//Orders the passes left after culling. A pass waits for the last pass to write anything it reads or writes,
+//and for every pass reading what it writes since then. Of the passes ready to run, one drawing into the same
+//targets as the last is taken first so the targets are not bound again, then one whose targets no waiting pass
+//draws into, so that those waiting can follow the others drawing there, then the first declared
+void Graph::Schedule()
+{
+	size_t passCount = mPasses.size();
+	std::vector<std::vector<int>> dependents(passCount);
+	std::vector<int> waiting(passCount, 0);
+	std::vector<int> lastWriter(mResources.size(), -1);
+	std::vector<std::vector<int>> readers(mResources.size());
+
+	auto depend = [&](int before, int after)
+	{
+		if (before >= 0 && before != after)
+		{
+			dependents[before].push_back(after);
+			waiting[after]++;
+		}
+	};
+	auto write = [&](int pass, Resource r)
+	{
+		depend(lastWriter[r], pass);
+		for (int reader : readers[r])
+		{
+			depend(reader, pass);
+		}
+		readers[r].clear();
+		lastWriter[r] = pass;
+	};
+
+	std::vector<int> ready;
+	for (int i = 0; i < static_cast<int>(passCount); i++)
+	{
+		if (mCulled[i])
+		{
+			continue;
+		}
+
+		const Pass& pass = mPasses[i];
+		for (Resource r : pass.reads)
+		{
+			depend(lastWriter[r], i);
+			readers[r].push_back(i);
+		}
+		for (int c = 0; c < pass.colourCount; c++)
+		{
+			write(i, pass.colour[c]);
+		}
+		if (pass.depth != NoResource)
+		{
+			write(i, pass.depth);
+		}
+	}
+
+	for (int i = 0; i < static_cast<int>(passCount); i++)
+	{
+		if (!mCulled[i] && waiting[i] == 0)
+		{
+			ready.push_back(i);
+		}
+	}
+
+	auto sameTargets = [&](const Pass& a, const Pass& b)
+	{
+		if (a.colourCount != b.colourCount || a.depth != b.depth || !std::equal(a.colour, a.colour + a.colourCount, b.colour))
+		{
+			return false;
+		}
+		return SameViewport(PassViewport(a), PassViewport(b));
+	};
+
+	auto rank = [&](int pass)
+	{
+		if (!mOrder.empty() && sameTargets(mPasses[pass], mPasses[mOrder.back()]))
+		{
+			return 0;
+		}
+		for (size_t q = 0; q < passCount; q++)
+		{
+			if (!mCulled[q] && waiting[q] > 0 && sameTargets(mPasses[pass], mPasses[q]))
+			{
+				return 2;
+			}
+		}
+		return 1;
+	};
+
+	mOrder.clear();
+	while (!ready.empty())
+	{
+		size_t pick = 0;
+		int pickRank = rank(ready[0]);
+		for (size_t j = 1; j < ready.size(); j++)
+		{
+			int jRank = rank(ready[j]);
+			if (jRank < pickRank || (jRank == pickRank && ready[j] < ready[pick]))
+			{
+				pick = j;
+				pickRank = jRank;
+			}
+		}
+
+		int pass = ready[pick];
+		ready.erase(ready.begin() + pick);
+		mOrder.push_back(pass);
+		for (int after : dependents[pass])
+		{
+			if (--waiting[after] == 0)
+			{
+				ready.push_back(after);
+			}
+		}
+	}
+}
+
+//Gives each resource the graph makes, from the first to be used, a pooled texture of the same size and format
+//that is free by then, making one when none is. Pooled textures not used for PoolFrames frames are released
+void Graph::PlaceTextures(Backend& backend)
+{
+	for (PooledTexture& texture : mPool)
+	{
+		texture.usedThisFrame = false;
+		texture.availableAfter = -1;
+	}
+
+	std::vector<Resource> transients;
+	for (Resource r = 0; r < mResources.size(); r++)
+	{
+		if (!mResources[r].imported && mResources[r].firstUse >= 0)
+		{
+			transients.push_back(r);
+		}
+	}
+	std::stable_sort(transients.begin(), transients.end(), [&](Resource a, Resource b)
+	{
+		return mResources[a].firstUse < mResources[b].firstUse;
+	});
+
+	for (Resource r : transients)
+	{
+		ResourceInfo& resource = mResources[r];
+		size_t chosen = mPool.size();
+		size_t empty = mPool.size();
+		for (size_t t = 0; t < mPool.size() && chosen == mPool.size(); t++)
+		{
+			if (mPool[t].exists && mPool[t].desc == resource.desc && mPool[t].availableAfter < resource.firstUse)
+			{
+				chosen = t;
+			}
+			else if (!mPool[t].exists && empty == mPool.size())
+			{
+				empty = t;
+			}
+		}
+
+		if (chosen == mPool.size())
+		{
+			if (empty == mPool.size())
+			{
+				mPool.emplace_back();
+			}
+			chosen = empty;
+			mPool[chosen].desc = resource.desc;
+			mPool[chosen].exists = true;
+			backend.CreateTexture(static_cast<uint32_t>(chosen), resource.desc);
+			mCompileStats.texturesCreated++;
+		}
+
+		PooledTexture& texture = mPool[chosen];
+		if (!texture.usedThisFrame)
+		{
+			mCompileStats.textures++;
+		}
+		texture.usedThisFrame = true;
+		texture.availableAfter = resource.lastUse;
+		texture.unusedFrames = 0;
+		resource.texture = static_cast<uint32_t>(chosen);
+	}
+
+	for (size_t t = 0; t < mPool.size(); t++)
+	{
+		PooledTexture& texture = mPool[t];
+		if (texture.exists && !texture.usedThisFrame && ++texture.unusedFrames > PoolFrames)
+		{
+			backend.ReleaseTexture(static_cast<uint32_t>(t));
+			texture.exists = false;
+			mCompileStats.texturesReleased++;
+		}
+	}
+}
+
+void Graph::Compile(Backend& backend)
+{
+	mCompileStats = CompileStats();
+	mCompileStats.passCount = static_cast<uint32_t>(mPasses.size());
+
+	Cull();
+	Schedule();
+
+	int declared = 0;
+	for (size_t k = 0; k < mOrder.size(); k++)
+	{
+		while (mCulled[declared])
+		{
+			declared++;
+		}
+		mCompileStats.reorderedPasses += mOrder[k] != declared ? 1 : 0;
+		declared++;
+
+		const Pass& pass = mPasses[mOrder[k]];
+		auto use = [&](Resource r)
+		{
+			ResourceInfo& resource = mResources[r];
+			resource.firstUse = resource.firstUse < 0 ? static_cast<int>(k) : resource.firstUse;
+			resource.lastUse = static_cast<int>(k);
+		};
+		for (Resource r : pass.reads)
+		{
+			use(r);
+		}
+		for (int c = 0; c < pass.colourCount; c++)
+		{
+			use(pass.colour[c]);
+		}
+		if (pass.depth != NoResource)
+		{
+			use(pass.depth);
+		}
+	}
+	mCompileStats.culledPasses = static_cast<uint32_t>(mPasses.size() - mOrder.size());
+
+	for (const ResourceInfo& resource : mResources)
+	{
+		mCompileStats.transientResources += !resource.imported && resource.firstUse >= 0 ? 1 : 0;
+	}
+
+	PlaceTextures(backend);
+}
+
+void Graph::Execute(Backend& backend)
+{
+	mExecuteStats = ExecuteStats();
+
+	//Nothing is known to be bound when the frame starts, as whatever ran between frames may have bound its own
+	Bound bound = { {}, -1, NoTexture, { -1.0f, -1.0f } };
+	PassContext context(*this, 0);
+	for (int p : mOrder)
+	{
+		RunPass(p, backend, context, bound, mExecuteStats);
+	}
+}
+
+void Graph::ExecutePass(int position, Backend& backend, int thread, ExecuteStats& stats) const
+{
+	Bound bound = { {}, -1, NoTexture, { -1.0f, -1.0f } };
+	RunPass(mOrder[position], backend, PassContext(*this, thread), bound, stats);
+}
+
+void Graph::RunPass(int p, Backend& backend, const PassContext& context, Bound& bound, ExecuteStats& stats) const
+{
+	const Pass& pass = mPasses[p];
+	if (pass.colourCount > 0 || pass.depth != NoResource)
+	{
+		uint32_t colour[MaxColourTargets];
+		for (int c = 0; c < pass.colourCount; c++)
+		{
+			colour[c] = mResources[pass.colour[c]].texture;
+		}
+		uint32_t depth = pass.depth == NoResource ? NoTexture : mResources[pass.depth].texture;
+
+		if (pass.colourCount != bound.colourCount || depth != bound.depth || !std::equal(colour, colour + pass.colourCount, bound.colour))
+		{
+			backend.SetTargets(colour, pass.colourCount, depth);
+			std::copy(colour, colour + pass.colourCount, bound.colour);
+			bound.colourCount = pass.colourCount;
+			bound.depth = depth;
+			stats.targetBinds++;
+		}
+
+		Viewport viewport = PassViewport(pass);
+		if (!SameViewport(viewport, bound.viewport))
+		{
+			backend.SetViewport(viewport);
+			bound.viewport = viewport;
+			stats.viewportSets++;
+		}
+
+		for (int c = 0; c < pass.colourCount; c++)
+		{
+			if (pass.clearColour[c])
+			{
+				backend.ClearColour(colour[c], pass.clearColours[c]);
+				stats.clears++;
+			}
+		}
+		if (pass.depth != NoResource && pass.clearDepth)
+		{
+			backend.ClearDepth(depth, pass.clearDepthValue);
+			stats.clears++;
+		}
+	}
+
+	backend.BeginPass(pass.name);
+	if (pass.execute)
+	{
+		pass.execute(context);
+	}
+	backend.EndPass();
+	stats.passCount++;
+}
+
+void Graph::ReleaseTextures(Backend& backend)
+{
+	for (size_t t = 0; t < mPool.size(); t++)
+	{
+		if (mPool[t].exists)
+		{
+			backend.ReleaseTexture(static_cast<uint32_t>(t));
+		}
+	}
+	mPool.clear();
+	for (ResourceInfo& resource : mResources)
+	{
+		resource.texture = resource.imported ? resource.texture : NoTexture;
+	}
+}
+
+std::vector<std::string> Graph::GetOrder() const
+{
+	std::vector<std::string> names;
+	for (int p : mOrder)
+	{
+		names.push_back(mPasses[p].name);
+	}
+	return names;
+}
+
+void RecordingBackend::CreateTexture(uint32_t texture, const TextureDesc& desc)
+{
+	liveTextures++;
+	if (recording)
+	{
+		commands.push_back("create " + TextureName(texture) + " " + std::to_string(desc.width) + "x" + std::to_string(desc.height) + " " + FormatName(desc.format));
+	}
+}
+
+void RecordingBackend::ReleaseTexture(uint32_t texture)
+{
+	liveTextures--;
+	if (recording)
+	{
+		commands.push_back("release " + TextureName(texture));
+	}
+}
+
+void RecordingBackend::SetTargets(const uint32_t* colour, int colourCount, uint32_t depth)
+{
+	targetBinds++;
+	if (recording)
+	{
+		std::string command = "targets";
+		for (int c = 0; c < colourCount; c++)
+		{
+			command += " " + TextureName(colour[c]);
+		}
+		commands.push_back(command + " depth " + TextureName(depth));
+	}
+}
+
+void RecordingBackend::SetViewport(const Viewport& viewport)
+{
+	viewportSets++;
+	if (recording)
+	{
+		commands.push_back("viewport " + std::to_string(static_cast<int>(viewport.width)) + "x" + std::to_string(static_cast<int>(viewport.height)));
+	}
+}
+
+void RecordingBackend::ClearColour(uint32_t texture, const float colour[4])
+{
+	(void)colour;
+	clears++;
+	if (recording)
+	{
+		commands.push_back("clear " + TextureName(texture));
+	}
+}
+
+void RecordingBackend::ClearDepth(uint32_t texture, float depth)
+{
+	(void)depth;
+	clears++;
+	if (recording)
+	{
+		commands.push_back("clear depth " + TextureName(texture));
+	}
+}
+
+void RecordingBackend::BeginPass(const char* name)
+{
+	if (recording)
+	{
+		commands.push_back(std::string("pass ") + name);
+	}
+}
+
+namespace
+{
+	void DeclareBenchmarkFrame(Graph& graph, int postPasses, int& executed)
+	{
+		const uint32_t width = 1280;
+		const uint32_t height = 720;
+		const float black[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		const float noHit[4] = { -1.0f, -1.0f, 0.0f, 0.0f };
+		auto run = [&executed](const PassContext&) { executed++; };
+
+		graph.Reset();
+		Resource backBuffer = graph.Import("Back buffer", { width, height, Format::Rgba8Unorm }, 0);
+		Resource depth = graph.Import("Depth", { width, height, Format::Depth32Float }, 1);
+		Resource raymarchColour = graph.Create("Raymarch colour", { width / 2, height / 2, Format::Rgba8Unorm });
+		Resource raymarchDepth = graph.Create("Raymarch depth", { width / 2, height / 2, Format::Depth32Float });
+		Resource cone = graph.Create("Cone prepass", { width / 16, height / 16, Format::R32Float });
+		Resource hit = graph.Create("Coral hits", { width / 2, height / 2, Format::Rg32Float });
+		Resource shaded = graph.Create("Coral shaded", { width / 4, height / 4, Format::Rgba8Unorm });
+		Resource scene = postPasses > 0 ? graph.Create("Scene colour", { width, height, Format::Rgba8Unorm }) : backBuffer;
+
+		auto sceneTargets = [&](PassBuilder& pass) { pass.Write(scene); pass.WriteDepth(depth); };
+		graph.AddPass("Coral meshes", sceneTargets, run);
+		graph.AddPass("Bubbles", [&](PassBuilder& pass) { pass.Clear(raymarchColour, black); pass.ClearDepth(raymarchDepth, 1.0f); }, run);
+		graph.AddPass("Cone prepass", [&](PassBuilder& pass) { pass.Clear(cone, black); }, run);
+		graph.AddPass("Coral march", [&](PassBuilder& pass) { pass.Read(cone); pass.Clear(hit, noHit); }, run);
+		graph.AddPass("Coral shade", [&](PassBuilder& pass) { pass.Read(hit); pass.Clear(shaded, black); }, run);
+		graph.AddPass("Coral resolve", [&](PassBuilder& pass) { pass.Read(hit); pass.Read(shaded); pass.Write(raymarchColour); pass.WriteDepth(raymarchDepth); }, run);
+		graph.AddPass("Debug coral hits", [&](PassBuilder& pass) { pass.Read(hit); pass.Clear(graph.Create("Debug view", { width / 2, height / 2, Format::Rgba8Unorm }), black); }, run);
+		graph.AddPass("Raymarch upsample", [&](PassBuilder& pass) { pass.Read(raymarchColour); pass.Read(raymarchDepth); sceneTargets(pass); }, run);
+		graph.AddPass("Terrain", sceneTargets, run);
+		graph.AddPass("Water", sceneTargets, run);
+		graph.AddPass("Plants", sceneTargets, run);
+		graph.AddPass("Underwater", sceneTargets, run);
+
+		Resource last = scene;
+		for (int i = 0; i < postPasses; i++)
+		{
+			Resource next = i + 1 < postPasses ? graph.Create("Post", { width, height, Format::Rgba8Unorm }) : backBuffer;
+			graph.AddPass("Post", [&](PassBuilder& pass) { pass.Read(last); pass.Write(next); }, run);
+			last = next;
+		}
+	}
+}
+
+GraphBenchmark FrameGraph::RunGraphBenchmark(int postPasses, int iterations)
+{
+	GraphBenchmark result = {};
+	result.iterations = std::max(iterations, 1);
+
+	Graph graph;
+	RecordingBackend backend;
+	backend.recording = false;
+	int executed = 0;
+
+	DeclareBenchmarkFrame(graph, postPasses, executed);
+	graph.Compile(backend);
+	graph.Execute(backend);
+
+	double compile = 0.0;
+	double execute = 0.0;
+	for (int i = 0; i < result.iterations; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		DeclareBenchmarkFrame(graph, postPasses, executed);
+		graph.Compile(backend);
+		compile += MicrosecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		graph.Execute(backend);
+		execute += MicrosecondsSince(start);
+	}
+
+	result.compile = graph.GetCompileStats();
+	result.execute = graph.GetExecuteStats();
+	result.compileMicroseconds = compile / result.iterations;
+	result.executeMicroseconds = execute / result.iterations;
+	result.liveTextures = backend.liveTextures;
+	return result;
+}
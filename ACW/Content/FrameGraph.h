@@ -0,0 +1,294 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ACW
+{
+	// The passes of a frame declared with the textures they read and render into, then compiled before any
+	// of them run. Passes whose output nothing reads are dropped, passes that do not depend on each other
+	// are reordered so those drawing into the same targets run together, and textures that only live for
+	// part of the frame share the same texture with others of the same size and format whose lifetimes do
+	// not overlap. Running the compiled frame binds each pass's targets and viewport, skipping binds that
+	// would repeat the last, clears what the pass asked to be cleared and calls the pass. Textures are made
+	// by a Backend, a Direct3D one for the renderer and a recording one that runs anywhere.
+	namespace FrameGraph
+	{
+		enum class Format
+		{
+			Rgba8Unorm,
+			Rg32Float,
+			R32Float,
+			// Depth that can also be read as a single float, as the raymarch upsample does.
+			Depth32Float
+		};
+
+		struct TextureDesc
+		{
+			uint32_t width;
+			uint32_t height;
+			Format format;
+		};
+
+		inline bool operator==(const TextureDesc& a, const TextureDesc& b) { return a.width == b.width && a.height == b.height && a.format == b.format; }
+		inline bool operator!=(const TextureDesc& a, const TextureDesc& b) { return !(a == b); }
+
+		// A texture declared for the frame being built.
+		typedef uint32_t Resource;
+		static const Resource NoResource = ~0u;
+
+		// Textures handed to the backend are numbered from 0 for those the graph makes, and from
+		// ImportedTexture up by the number the backend knows them by for those made outside it.
+		static const uint32_t ImportedTexture = 0x80000000u;
+		static const uint32_t NoTexture = ~0u;
+
+		static const int MaxColourTargets = 4;
+
+		// Compiled frames a texture may go unused before it is released.
+		static const int PoolFrames = 8;
+
+		struct Viewport
+		{
+			float width;
+			float height;
+		};
+
+		class Backend
+		{
+		public:
+			virtual ~Backend() {}
+
+			virtual void CreateTexture(uint32_t texture, const TextureDesc& desc) = 0;
+			virtual void ReleaseTexture(uint32_t texture) = 0;
+
+			// depth is NoTexture when the pass has none.
+			virtual void SetTargets(const uint32_t* colour, int colourCount, uint32_t depth) = 0;
+			virtual void SetViewport(const Viewport& viewport) = 0;
+			virtual void ClearColour(uint32_t texture, const float colour[4]) = 0;
+			virtual void ClearDepth(uint32_t texture, float depth) = 0;
+
+			// Around each pass, for backends that time or label them.
+			virtual void BeginPass(const char* name) { (void)name; }
+			virtual void EndPass() {}
+		};
+
+		class Graph;
+		class PassContext;
+
+		struct Pass
+		{
+			const char* name;
+			std::vector<Resource> reads;
+			Resource colour[MaxColourTargets];
+			int colourCount;
+			Resource depth;
+
+			// Which targets are cleared and to what, colour targets by slot.
+			bool clearColour[MaxColourTargets];
+			float clearColours[MaxColourTargets][4];
+			bool clearDepth;
+			float clearDepthValue;
+
+			Viewport viewport;
+			bool keepAlive;
+			std::function<void(const PassContext&)> execute;
+		};
+
+		// Declares what a pass reads and renders into, while the pass is added.
+		class PassBuilder
+		{
+		public:
+			// Sampled by the pass.
+			void Read(Resource resource);
+
+			// Colour targets, bound in the order they are written, optionally cleared before the pass.
+			void Write(Resource resource);
+			void Clear(Resource resource, const float colour[4]);
+
+			void WriteDepth(Resource resource);
+			void ClearDepth(Resource resource, float depth);
+
+			// A viewport other than the size of the first target, for passes drawing part of it.
+			void SetViewport(float width, float height);
+
+			// The pass does work outside the graph, so it runs whether or not anything reads its targets.
+			void KeepAlive();
+
+		private:
+			friend class Graph;
+			explicit PassBuilder(Pass& pass) : mPass(pass) {}
+			Pass& mPass;
+		};
+
+		// Given to a pass as it runs, to find the textures behind its resources.
+		class PassContext
+		{
+		public:
+			uint32_t Texture(Resource resource) const;
+
+			// The thread the pass was handed to by ExecutePass, 0 when the whole frame is run by Execute.
+			int Thread() const { return mThread; }
+
+		private:
+			friend class Graph;
+			PassContext(const Graph& graph, int thread) : mGraph(graph), mThread(thread) {}
+			const Graph& mGraph;
+			int mThread;
+		};
+
+		struct CompileStats
+		{
+			uint32_t passCount;
+			uint32_t culledPasses;
+			// Passes run somewhere other than where they were declared.
+			uint32_t reorderedPasses;
+
+			// Resources the graph makes, and the textures they share this frame.
+			uint32_t transientResources;
+			uint32_t textures;
+			uint32_t texturesCreated;
+			uint32_t texturesReleased;
+		};
+
+		struct ExecuteStats
+		{
+			uint32_t passCount;
+			uint32_t targetBinds;
+			uint32_t viewportSets;
+			uint32_t clears;
+		};
+
+		inline ExecuteStats& operator+=(ExecuteStats& a, const ExecuteStats& b)
+		{
+			a.passCount += b.passCount;
+			a.targetBinds += b.targetBinds;
+			a.viewportSets += b.viewportSets;
+			a.clears += b.clears;
+			return a;
+		}
+
+		class Graph
+		{
+		public:
+			Graph();
+
+			// Starts declaring a new frame, keeping the textures made for earlier ones.
+			void Reset();
+
+			Resource Import(const char* name, const TextureDesc& desc, uint32_t texture);
+			Resource Create(const char* name, const TextureDesc& desc);
+			const TextureDesc& GetDesc(Resource resource) const { return mResources[resource].desc; }
+
+			void AddPass(const char* name, const std::function<void(PassBuilder&)>& setup, const std::function<void(const PassContext&)>& execute);
+
+			// Culls, orders and places the declared passes and resources, making and releasing textures on the backend.
+			void Compile(Backend& backend);
+			void Execute(Backend& backend);
+
+			// Runs one compiled pass, the position-th to run, binding everything it needs as if nothing were bound, so
+			// passes can be run on separate contexts and threads at once. Each thread counts into its own stats.
+			int GetRunCount() const { return static_cast<int>(mOrder.size()); }
+			void ExecutePass(int position, Backend& backend, int thread, ExecuteStats& stats) const;
+
+			// Every texture made by the graph released, as when the device is lost.
+			void ReleaseTextures(Backend& backend);
+
+			const CompileStats& GetCompileStats() const { return mCompileStats; }
+			const ExecuteStats& GetExecuteStats() const { return mExecuteStats; }
+
+			// Names of the compiled passes in the order they run.
+			std::vector<std::string> GetOrder() const;
+
+		private:
+			friend class PassContext;
+
+			struct ResourceInfo
+			{
+				const char* name;
+				TextureDesc desc;
+				bool imported;
+				uint32_t texture;
+				int firstUse;
+				int lastUse;
+			};
+
+			// A texture the graph made, free from the pass after availableAfter this frame.
+			struct PooledTexture
+			{
+				TextureDesc desc;
+				bool exists;
+				bool usedThisFrame;
+				int availableAfter;
+				int unusedFrames;
+			};
+
+			// What the last pass run left bound.
+			struct Bound
+			{
+				uint32_t colour[MaxColourTargets];
+				int colourCount;
+				uint32_t depth;
+				Viewport viewport;
+			};
+
+			// The pass's viewport, or the size of its first target when it did not set one.
+			Viewport PassViewport(const Pass& pass) const;
+			// Binds and clears the pass's targets, skipping binds of what bound already holds, and runs it.
+			void RunPass(int p, Backend& backend, const PassContext& context, Bound& bound, ExecuteStats& stats) const;
+			void Cull();
+			void Schedule();
+			void PlaceTextures(Backend& backend);
+
+			std::vector<Pass> mPasses;
+			std::vector<ResourceInfo> mResources;
+			std::vector<PooledTexture> mPool;
+			std::vector<bool> mCulled;
+			std::vector<int> mOrder;
+			CompileStats mCompileStats;
+			ExecuteStats mExecuteStats;
+		};
+
+		// Writes a line for every call a compiled frame makes, and counts them, without a GPU.
+		class RecordingBackend : public Backend
+		{
+		public:
+			RecordingBackend() : recording(true), liveTextures(0), targetBinds(0), viewportSets(0), clears(0) {}
+
+			void CreateTexture(uint32_t texture, const TextureDesc& desc) override;
+			void ReleaseTexture(uint32_t texture) override;
+			void SetTargets(const uint32_t* colour, int colourCount, uint32_t depth) override;
+			void SetViewport(const Viewport& viewport) override;
+			void ClearColour(uint32_t texture, const float colour[4]) override;
+			void ClearDepth(uint32_t texture, float depth) override;
+			void BeginPass(const char* name) override;
+
+			// Lines are only written while recording, the counts always are.
+			bool recording;
+			std::vector<std::string> commands;
+			int liveTextures;
+			uint32_t targetBinds;
+			uint32_t viewportSets;
+			uint32_t clears;
+		};
+
+		struct GraphBenchmark
+		{
+			int iterations;
+			CompileStats compile;
+			ExecuteStats execute;
+
+			// Time to declare and compile a frame, and to run it on the recording backend.
+			double compileMicroseconds;
+			double executeMicroseconds;
+
+			// Textures the recording backend held at the end, which the pool should keep at compile.textures.
+			int liveTextures;
+		};
+
+		// The renderer's frame at half resolution and half shading rate followed by postPasses full screen
+		// passes, each reading the last one's output, and a debug view nothing reads.
+		GraphBenchmark RunGraphBenchmark(int postPasses, int iterations);
+	}
+}
@@ -0,0 +1,169 @@
+﻿#include "pch.h"
+#include "FrameGraphD3D11.h"
+
+#include "..\Common\DirectXHelper.h"
+
+using namespace ACW;
+using namespace ACW::FrameGraph;
+using namespace Microsoft::WRL;
+
+namespace
+{
+	DXGI_FORMAT TextureFormat(Format format)
+	{
+		switch (format)
+		{
+		case Format::Rg32Float:
+			return DXGI_FORMAT_R32G32_FLOAT;
+		case Format::R32Float:
+			return DXGI_FORMAT_R32_FLOAT;
+		case Format::Depth32Float:
+			// Typeless so it can be both depth tested against and read
+			return DXGI_FORMAT_R32_TYPELESS;
+		default:
+			return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+}
+
+D3D11Backend::D3D11Backend(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources)
+{
+}
+
+void D3D11Backend::CreateTexture(uint32_t texture, const TextureDesc& desc)
+{
+	if (texture >= mTextures.size())
+	{
+		mTextures.resize(texture + 1);
+	}
+
+	bool depth = desc.format == Format::Depth32Float;
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = TextureFormat(desc.format);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = (depth ? D3D11_BIND_DEPTH_STENCIL : D3D11_BIND_RENDER_TARGET) | D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	Texture& target = mTextures[texture];
+	DX::ThrowIfFailed(
+		device->CreateTexture2D(&textureDesc, nullptr, target.texture.ReleaseAndGetAddressOf())
+	);
+
+	if (depth)
+	{
+		CD3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc(D3D11_DSV_DIMENSION_TEXTURE2D, DXGI_FORMAT_D32_FLOAT);
+		DX::ThrowIfFailed(
+			device->CreateDepthStencilView(target.texture.Get(), &dsvDesc, target.depthView.ReleaseAndGetAddressOf())
+		);
+
+		CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc(D3D11_SRV_DIMENSION_TEXTURE2D, DXGI_FORMAT_R32_FLOAT);
+		DX::ThrowIfFailed(
+			device->CreateShaderResourceView(target.texture.Get(), &srvDesc, target.resourceView.ReleaseAndGetAddressOf())
+		);
+		target.targetView.Reset();
+		return;
+	}
+
+	DX::ThrowIfFailed(
+		device->CreateRenderTargetView(target.texture.Get(), nullptr, target.targetView.ReleaseAndGetAddressOf())
+	);
+
+	DX::ThrowIfFailed(
+		device->CreateShaderResourceView(target.texture.Get(), nullptr, target.resourceView.ReleaseAndGetAddressOf())
+	);
+	target.depthView.Reset();
+}
+
+void D3D11Backend::ReleaseTexture(uint32_t texture)
+{
+	mTextures[texture] = Texture();
+}
+
+ID3D11RenderTargetView* D3D11Backend::TargetView(uint32_t texture) const
+{
+	if (texture == (ImportedTexture | BackBuffer))
+	{
+		return m_deviceResources->GetBackBufferRenderTargetView();
+	}
+	return mTextures[texture].targetView.Get();
+}
+
+ID3D11DepthStencilView* D3D11Backend::DepthView(uint32_t texture) const
+{
+	if (texture == NoTexture)
+	{
+		return nullptr;
+	}
+	if (texture == (ImportedTexture | DepthBuffer))
+	{
+		return m_deviceResources->GetDepthStencilView();
+	}
+	return mTextures[texture].depthView.Get();
+}
+
+void D3D11Backend::SetTargets(const uint32_t* colour, int colourCount, uint32_t depth)
+{
+	SetTargets(m_deviceResources->GetD3DDeviceContext(), colour, colourCount, depth);
+}
+
+void D3D11Backend::SetViewport(const Viewport& viewport)
+{
+	SetViewport(m_deviceResources->GetD3DDeviceContext(), viewport);
+}
+
+void D3D11Backend::ClearColour(uint32_t texture, const float colour[4])
+{
+	ClearColour(m_deviceResources->GetD3DDeviceContext(), texture, colour);
+}
+
+void D3D11Backend::ClearDepth(uint32_t texture, float depth)
+{
+	ClearDepth(m_deviceResources->GetD3DDeviceContext(), texture, depth);
+}
+
+void D3D11Backend::EndPass()
+{
+	EndPass(m_deviceResources->GetD3DDeviceContext());
+}
+
+void D3D11Backend::SetTargets(ID3D11DeviceContext* context, const uint32_t* colour, int colourCount, uint32_t depth) const
+{
+	ID3D11RenderTargetView* targets[MaxColourTargets];
+	for (int c = 0; c < colourCount; c++)
+	{
+		targets[c] = TargetView(colour[c]);
+	}
+	context->OMSetRenderTargets(colourCount, colourCount > 0 ? targets : nullptr, DepthView(depth));
+}
+
+void D3D11Backend::SetViewport(ID3D11DeviceContext* context, const Viewport& viewport) const
+{
+	CD3D11_VIEWPORT d3dViewport(0.0f, 0.0f, viewport.width, viewport.height);
+	context->RSSetViewports(1, &d3dViewport);
+}
+
+void D3D11Backend::ClearColour(ID3D11DeviceContext* context, uint32_t texture, const float colour[4]) const
+{
+	context->ClearRenderTargetView(TargetView(texture), colour);
+}
+
+void D3D11Backend::ClearDepth(ID3D11DeviceContext* context, uint32_t texture, float depth) const
+{
+	context->ClearDepthStencilView(DepthView(texture), D3D11_CLEAR_DEPTH, depth, 0);
+}
+
+void D3D11Backend::EndPass(ID3D11DeviceContext* context) const
+{
+	ID3D11ShaderResourceView* const nullResources[ReadSlots] = {};
+	context->PSSetShaderResources(0, ReadSlots, nullResources);
+}
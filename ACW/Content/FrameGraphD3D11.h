@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "..\Common\DeviceResources.h"
+#include "FrameGraph.h"
+#include <vector>
+
+namespace ACW
+{
+	namespace FrameGraph
+	{
+		// Makes the graph's textures on the Direct3D device, each with the views its format can be rendered into
+		// and read through, and binds them. The back buffer and the depth buffer of the device resources are
+		// imported as BackBuffer and DepthBuffer.
+		class D3D11Backend : public Backend
+		{
+		public:
+			static const uint32_t BackBuffer = 0;
+			static const uint32_t DepthBuffer = 1;
+
+			// Shader resource slots unbound after each pass, so a texture it read can be rendered into by the next.
+			static const UINT ReadSlots = 4;
+
+			D3D11Backend(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+			void CreateTexture(uint32_t texture, const TextureDesc& desc) override;
+			void ReleaseTexture(uint32_t texture) override;
+			void SetTargets(const uint32_t* colour, int colourCount, uint32_t depth) override;
+			void SetViewport(const Viewport& viewport) override;
+			void ClearColour(uint32_t texture, const float colour[4]) override;
+			void ClearDepth(uint32_t texture, float depth) override;
+			void EndPass() override;
+
+			ID3D11ShaderResourceView* ShaderResource(uint32_t texture) const { return mTextures[texture].resourceView.Get(); }
+
+			// The binds above made on another context, as for passes recorded on a deferred context.
+			void SetTargets(ID3D11DeviceContext* context, const uint32_t* colour, int colourCount, uint32_t depth) const;
+			void SetViewport(ID3D11DeviceContext* context, const Viewport& viewport) const;
+			void ClearColour(ID3D11DeviceContext* context, uint32_t texture, const float colour[4]) const;
+			void ClearDepth(ID3D11DeviceContext* context, uint32_t texture, float depth) const;
+			void EndPass(ID3D11DeviceContext* context) const;
+
+		private:
+			struct Texture
+			{
+				Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+				Microsoft::WRL::ComPtr<ID3D11RenderTargetView> targetView;
+				Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthView;
+				Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> resourceView;
+			};
+
+			ID3D11RenderTargetView* TargetView(uint32_t texture) const;
+			ID3D11DepthStencilView* DepthView(uint32_t texture) const;
+
+			std::shared_ptr<DX::DeviceResources> m_deviceResources;
+			std::vector<Texture> mTextures;
+		};
+
+		// Binds the targets of passes run on another context with the textures of the backend that made them.
+		// Textures are only made and released while compiling, by that backend, so those calls do nothing here.
+		class D3D11ContextBackend : public Backend
+		{
+		public:
+			D3D11ContextBackend(const D3D11Backend& textures, ID3D11DeviceContext* context) : mTextures(textures), mContext(context) {}
+
+			void CreateTexture(uint32_t, const TextureDesc&) override {}
+			void ReleaseTexture(uint32_t) override {}
+			void SetTargets(const uint32_t* colour, int colourCount, uint32_t depth) override { mTextures.SetTargets(mContext, colour, colourCount, depth); }
+			void SetViewport(const Viewport& viewport) override { mTextures.SetViewport(mContext, viewport); }
+			void ClearColour(uint32_t texture, const float colour[4]) override { mTextures.ClearColour(mContext, texture, colour); }
+			void ClearDepth(uint32_t texture, float depth) override { mTextures.ClearDepth(mContext, texture, depth); }
+			void EndPass() override { mTextures.EndPass(mContext); }
+
+		private:
+			const D3D11Backend& mTextures;
+			ID3D11DeviceContext* mContext;
+		};
+	}
+}
\ No newline at end of file
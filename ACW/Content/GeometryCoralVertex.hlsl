@@ -9,50 +9,58 @@ cbuffer modelViewProjectionConstantBuffer : register(b0)
 	float4 upDir;
 };
 
+cbuffer timeConstantBuffer : register(b1)
+{
+	float time;
+	float3 padding;
+}
+
+// One instance per plant, scattered and filtered on the CPU by PlantScatter::Scatter.
 struct VertexShaderInput
 {
 	float3 pos : POSITION;
+	uint species : SPECIES;
+	uint vertexID : SV_VertexID;
 };
 
-struct GeometryShaderInput
+struct PixelShaderInput
 {
 	float4 position : SV_POSITION;
+	float2 uv : TEXCOORD0;
+	nointerpolation uint species : TEXCOORD1;
 };
 
-float Hash(float2 grid)
+// Corners of the billboard in triangle strip order
+static const float3 QuadPos[4] =
 {
-    float h = dot(grid, float2(127.1, 311.7));
-    return frac(sin(h) * 43758.5453123);
-}
+	float3(-1, 1, 0),
+	float3(-1, -1, 0),
+	float3(1, 1, 0),
+	float3(1, -1, 0),
+};
 
-float Noise(float2 p)
+// Expands each instance into a camera facing quad, four vertices drawn as a strip.
+PixelShaderInput main(VertexShaderInput input)
 {
-    float2 grid = floor(p);
-    float2 f = frac(p);
-    float2 uv = f * f * (3.0 - 2.0 * f);
+	PixelShaderInput output;
 
-    float n1 = lerp(Hash(grid + float2(0.0, 0.0)), Hash(grid + float2(1.0, 0.0)), uv.x);
-    float n2 = lerp(Hash(grid + float2(0.0, 1.0)), Hash(grid + float2(1.0, 1.0)), uv.x);
-    return lerp(n1, n2, uv.y);
-}
+	float3 corner = QuadPos[input.vertexID];
 
-float fractalNoise(float2 xy)
-{
-    float w = 0.7;
-    float f = 0.0;
-    for (int i = 0; i < 4; i++)
-    {
-        f += Noise(xy) * w;
-        w *= 0.5;
-        xy *= 2.7;
-    }
-    return f;
-}
+	// Transform the plant position by the view matrix
+	float4 vPos = mul(float4(input.pos, 1.0), view);
 
-GeometryShaderInput main(VertexShaderInput input)
-{
-    GeometryShaderInput output;
-    output.position = float4(input.pos, 1);
-    output.position.y = fractalNoise(output.position.xz) + 0.2;
-    return output;
+	// Define the size of the quad
+	float quadSize = 0.5;
+
+	// The top of the plant sways
+	output.position = vPos + float4(quadSize * corner, 0.0);
+	if (corner.y > 0.0)
+	{
+		output.position.z += sin(time) * 0.2;
+	}
+	output.position = mul(output.position, projection);
+	output.uv = ((corner.xy * -1) + float2(1, 1)) / 2;
+	output.species = input.species;
+
+	return output;
 }
@@ -0,0 +1,59 @@
+static float nearPlane = 1.0;
+
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer modelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 eye;
+	float4 lookAt;
+	float4 upDir;
+};
+
+struct VS_QUAD
+{
+	float4 position : SV_POSITION;
+	float2 canvasXY : TEXCOORD0;
+};
+
+#include "ImplicitCoralMap.hlsli"
+
+// Marches a cone that encloses every eye ray of one tile and returns the distance
+// along the tile's centre ray that none of those rays can hit the coral before.
+float coneMarch(in float3 ro, in float3 rd, in float coneRatio)
+{
+	float2 interval = marchInterval(ro, rd);
+	float t = interval.x;
+
+	for (int i = 0; i < 64 && t < interval.y; i++)
+	{
+		float coneRadius = coneRatio * t;
+		float h = safeDistance(map(ro + rd * t).x);
+		if (h < coneRadius)
+		{
+			break;
+		}
+
+		// Only the part of the empty sphere outside the cone is free for every ray in the tile
+		t += h - coneRadius;
+	}
+
+	return t;
+}
+
+// Rendered into a target CONE_TILE_SIZE times smaller than the back buffer, so each
+// pixel is the centre of one full resolution tile.
+float main(VS_QUAD input) : SV_TARGET
+{
+	float zoom = 10.0;
+	float2 xy = zoom * input.canvasXY;
+	float3 pixelPos = float3(xy, nearPlane);
+
+	// Neighbouring low resolution pixels are one tile apart, so half their spacing is the tile extent
+	float tileExtent = length(0.5 * (abs(ddx(pixelPos)) + abs(ddy(pixelPos))));
+	float canvasDistance = length(pixelPos - eye.xyz);
+	float coneRatio = tileExtent / (canvasDistance - tileExtent);
+
+	return coneMarch(eye.xyz, normalize(pixelPos - eye.xyz), coneRatio);
+}
@@ -0,0 +1,46 @@
+// Signed distance description of the implicit coral, shared by every pass that marches it.
+
+// Width and height, in full resolution pixels, of one cone prepass tile.
+#define CONE_TILE_SIZE 8
+
+// Over-relaxation of the march steps, 1 marches by the plain safe distance.
+#define MARCH_RELAXATION 1.6
+
+// A ray hits when the distance is below this fraction of the distance along it.
+#define MARCH_HIT_THRESHOLD 0.00001
+
+// map() and its Lipschitz bounds are generated from ImplicitCoral.sdf by Tools/SdfCompiler.py.
+#include "ImplicitCoralScene.hlsli"
+
+// Lower bound on the distance to the surface from a point where map() returned d.
+float safeDistance(float d)
+{
+	// Within reach of the lattice the whole field's bound applies, further out only the smooth part's
+	return max(d / sceneLipschitz, (d - 2.0 * scenePerturbation) / sceneSmoothLipschitz);
+}
+
+float2 iBox(in float3 ro, in float3 rd, in float3 rad)
+{
+	float3 invRd = 1.0 / rd;
+	float3 n = invRd * ro;
+	float3 k = abs(invRd) * rad;
+
+	float3 t1 = -n - k;
+	float3 t2 = -n + k;
+
+	return float2(max(min(t1.x, t2.x), max(min(t1.y, t2.y), min(t1.z, t2.z))),
+		min(max(t1.x, t2.x), max(max(t1.y, t2.y), t2.z)));
+}
+
+// Clips the march interval of a ray against the bounds of the coral.
+float2 marchInterval(in float3 ro, in float3 rd)
+{
+	float tmin = 1.0;
+	float tmax = 20.0;
+
+	float2 tb = iBox(ro, rd, float3(1000, 1000, 1000));
+	tmin = max(tb.x, tmin);
+	tmax = min(tb.y, tmax);
+
+	return float2(tmin, tmax);
+}
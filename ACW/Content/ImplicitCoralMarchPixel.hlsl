@@ -0,0 +1,89 @@
+static float nearPlane = 1.0;
+
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer modelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 eye;
+	float4 lookAt;
+	float4 upDir;
+};
+
+struct VS_QUAD
+{
+	float4 position : SV_POSITION;
+	float2 canvasXY : TEXCOORD0;
+};
+
+#include "ImplicitCoralMap.hlsli"
+
+// Conservative per tile start distances written by ImplicitCoralConePrepass.
+Texture2D<float> coneStartDistance : register(t0);
+
+float2 castRay(in float3 ro, in float3 rd, in float tstart)
+{
+	float2 res = float2(-1.0, -1.0);
+
+	// raymarch primitives, skipping the empty space the cone prepass proved
+	float2 interval = marchInterval(ro, rd);
+	float tmin = max(interval.x, tstart);
+	float tmax = interval.y;
+
+	float omega = MARCH_RELAXATION;
+	float previousRadius = 0.0;
+	float stepLength = 0.0;
+
+	float t = tmin;
+	for (int i = 0; i < 170 && t < tmax; i++)
+	{
+		float2 h = map(ro + rd * t);
+		float radius = safeDistance(abs(h.x));
+
+		// the last two unbounding spheres do not overlap, so the relaxed step may have
+		// jumped the surface: go back to where a plain step would have landed
+		if (omega > 1.0 && radius + previousRadius < stepLength)
+		{
+			t -= stepLength - stepLength / omega;
+			omega = 1.0;
+			previousRadius = 0.0;
+			stepLength = 0.0;
+			continue;
+		}
+
+		if (abs(h.x) < (MARCH_HIT_THRESHOLD * t))
+		{
+			res = float2(t, h.y);
+			break;
+		}
+
+		// only relax forward steps, and never out of the interval
+		stepLength = (h.x < 0.0) ? -radius : radius * omega;
+		if (t + stepLength >= tmax)
+		{
+			stepLength = (h.x < 0.0) ? -radius : radius;
+		}
+
+		previousRadius = radius;
+		t += stepLength;
+	}
+
+	return res;
+}
+
+// First pass of the coral: marches every pixel and writes the hit distance and material
+// into the hit buffer, (-1, -1) for a miss. Lighting is left to ImplicitCoralPixel.
+float2 main(VS_QUAD input) : SV_TARGET
+{
+	float zoom = 10.0;
+	float2 xy = zoom * input.canvasXY;
+	float3 pixelPos = float3(xy, nearPlane);
+
+	float3 ro = eye.xyz;
+	float3 rd = normalize(pixelPos - eye.xyz);
+
+	float tstart = coneStartDistance.Load(int3(input.position.xy / CONE_TILE_SIZE, 0));
+
+	return castRay(ro, rd, tstart);
+}
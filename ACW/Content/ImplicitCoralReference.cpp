@@ -0,0 +1,800 @@
+﻿#include "pch.h"
+#include "ImplicitCoralReference.h"
+#include "ImplicitCoralScene.h"
+#include "SdfDual.h"
+#include "SdfInterpreter.h"
+
+#include <chrono>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+
+namespace
+{
+	const float NearPlane = 1.0f;
+	const float Zoom = 10.0f;
+	const float3 CoralCentre(-2.0f, -3.75f, -1.0f);
+	const float CoralCameraDistance = 6.0f;
+	const float CoralCameraZoom = 0.4f;
+	const float MaxHeight = 0.8f;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Normalised gradient of the scene in double precision, by central differences
+	float3 ReferenceNormal(const float3& pos)
+	{
+		const double e = 1e-6;
+		double gradient[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			double p[3] = { pos.x, pos.y, pos.z };
+			double q[3] = { pos.x, pos.y, pos.z };
+			p[axis] += e;
+			q[axis] -= e;
+
+			double dp, dq, material;
+			ImplicitCoralScene::Map(Sdf::Vec3<double>(p[0], p[1], p[2]), dp, material);
+			ImplicitCoralScene::Map(Sdf::Vec3<double>(q[0], q[1], q[2]), dq, material);
+			gradient[axis] = (dp - dq) / (2.0 * e);
+		}
+
+		double length = std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+		return float3(static_cast<float>(gradient[0] / length), static_cast<float>(gradient[1] / length), static_cast<float>(gradient[2] / length));
+	}
+
+	float AngleInDegrees(const float3& a, const float3& b)
+	{
+		return std::acos(ShaderMath::clamp(dot(a, b), -1.0f, 1.0f)) * (180.0f / 3.14159265f);
+	}
+
+	float2 iBox(const float3& ro, const float3& rd, const float3& rad)
+	{
+		float3 invRd = 1.0f / rd;
+		float3 n = invRd * ro;
+		float3 k = abs(invRd) * rad;
+
+		float3 t1 = -n - k;
+		float3 t2 = -n + k;
+
+		return float2(std::max(std::min(t1.x, t2.x), std::max(std::min(t1.y, t2.y), std::min(t1.z, t2.z))),
+			std::min(std::max(t1.x, t2.x), std::max(std::max(t1.y, t2.y), t2.z)));
+	}
+
+	float CalcSoftshadow(const float3& ro, const float3& rd, float mint, float tmax)
+	{
+		// bounding volume
+		float tp = (MaxHeight - ro.y) / rd.y;
+		tmax = (tp > 0.0f) ? std::min(tmax, tp) : tmax;
+
+		float res = 1.0f;
+		float t = mint;
+		for (int i = 0; i < 16; i++)
+		{
+			float h = ImplicitCoralReference::Map(ro + rd * t).x;
+			res = std::min(res, 8.0f * h / t);
+			t += ShaderMath::clamp(h, 0.02f, 0.10f);
+		}
+		return ShaderMath::clamp(res, 0.0f, 1.0f);
+	}
+
+	float CalcAO(const float3& pos, const float3& nor)
+	{
+		float occ = 0.0f;
+		float sca = 1.0f;
+		for (int i = 0; i < 5; i++)
+		{
+			float hr = 0.01f + 0.03f * static_cast<float>(i);
+			float3 aopos = nor * hr + pos;
+			float dd = ImplicitCoralReference::Map(aopos).x;
+			occ += (hr - dd) * sca;
+			sca *= 0.95f;
+		}
+		return ShaderMath::clamp(1.0f - 3.0f * occ, 0.0f, 1.0f) * (0.5f + 0.5f * nor.y);
+	}
+
+	// fwidth has no CPU equivalent, so the filter kernel is the constant part only. The coral
+	// material never reaches this, it is only used below material 1.5.
+	float CheckersGradBox(const float2& p)
+	{
+		float2 w = float2(0.001f);
+		float ix = 1.0f - 2.0f * std::fabs(frac(p.x - 0.5f * w.x) - 0.5f);
+		float iy = 1.0f - 2.0f * std::fabs(frac(p.y - 0.5f * w.y) - 0.5f);
+		return 0.25f * ix * iy;
+	}
+
+	// What an 8 bit UNORM target stores for a colour
+	float3 QuantiseColour(const float3& c)
+	{
+		return float3(std::floor(c.x * 255.0f + 0.5f) / 255.0f, std::floor(c.y * 255.0f + 0.5f) / 255.0f, std::floor(c.z * 255.0f + 0.5f) / 255.0f);
+	}
+}
+
+ImplicitCoralReference::MarchSettings ImplicitCoralReference::DefaultMarchSettings()
+{
+	MarchSettings settings;
+	settings.relaxation = DefaultRelaxation;
+	settings.hitThreshold = DefaultHitThreshold;
+	settings.lipschitzSteps = true;
+	return settings;
+}
+
+ImplicitCoralReference::MarchSettings ImplicitCoralReference::OriginalMarchSettings()
+{
+	MarchSettings settings;
+	settings.relaxation = 1.0f;
+	settings.hitThreshold = DefaultHitThreshold;
+	settings.lipschitzSteps = false;
+	return settings;
+}
+
+ImplicitCoralReference::Camera ImplicitCoralReference::DefaultCamera(int width, int height)
+{
+	Camera camera;
+	camera.eye = float3(0.0f, 5.0f, -10.0f);
+	camera.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+	camera.zoom = Zoom;
+	camera.width = width;
+	camera.height = height;
+	return camera;
+}
+
+ImplicitCoralReference::Camera ImplicitCoralReference::CoralCamera(int width, int height)
+{
+	// The canvas stays where the shaders put it, so the eye sits on the line from its centre through the coral
+	// and the canvas is narrowed around the coral instead of turning the view
+	Camera camera = DefaultCamera(width, height);
+	camera.eye = CoralCentre + normalize(CoralCentre - float3(0.0f, 0.0f, NearPlane)) * CoralCameraDistance;
+	camera.zoom = CoralCameraZoom;
+	return camera;
+}
+
+float2 ImplicitCoralReference::Map(const float3& inPos)
+{
+	float2 res;
+	ImplicitCoralScene::Map(Sdf::Vec3<float>(inPos.x, inPos.y, inPos.z), res.x, res.y);
+	return res;
+}
+
+float2 ImplicitCoralReference::MarchInterval(const float3& ro, const float3& rd)
+{
+	float tmin = 1.0f;
+	float tmax = 20.0f;
+
+	float2 tb = iBox(ro, rd, float3(1000.0f));
+	tmin = std::max(tb.x, tmin);
+	tmax = std::min(tb.y, tmax);
+
+	return float2(tmin, tmax);
+}
+
+float ImplicitCoralReference::SafeDistance(float distance)
+{
+	// Within reach of the lattice the whole field's bound applies, further out only the smooth part's
+	return std::max(distance / ImplicitCoralScene::Lipschitz,
+		(distance - 2.0f * ImplicitCoralScene::Perturbation) / ImplicitCoralScene::SmoothLipschitz);
+}
+
+float3 ImplicitCoralReference::CalcNormal(const float3& pos)
+{
+	Sdf::Dual distance, material;
+	ImplicitCoralScene::Map(Sdf::MakeDualPoint(pos.x, pos.y, pos.z), distance, material);
+	return normalize(float3(distance.gradient.x, distance.gradient.y, distance.gradient.z));
+}
+
+float3 ImplicitCoralReference::CalcNormalFiniteDifference(const float3& pos)
+{
+	const float e = 0.5773f * 0.0005f;
+	float3 exyy = float3(e, -e, -e);
+	float3 eyyx = float3(-e, -e, e);
+	float3 eyxy = float3(-e, e, -e);
+	float3 exxx = float3(e, e, e);
+
+	return normalize(exyy * Map(pos + exyy).x + eyyx * Map(pos + eyyx).x + eyxy * Map(pos + eyxy).x + exxx * Map(pos + exxx).x);
+}
+
+float3 ImplicitCoralReference::Shade(const float3& ro, const float3& rd, float t, float m)
+{
+	float3 pos = ro + t * rd;
+	float3 nor = (m < 1.5f) ? float3(0.0f, 1.0f, 0.0f) : CalcNormal(pos);
+	float3 ref = reflect(rd, nor);
+
+	// material
+	float3 diffuseColor = 0.45f + 0.35f * sin(float3(0.05f, 0.08f, 0.10f) * (m - 1.0f));
+	if (m < 1.5f)
+	{
+		float f = CheckersGradBox(5.0f * pos.xz());
+		diffuseColor = 0.3f + f * float3(0.1f, 0.1f, 0.1f);
+	}
+
+	// lighting
+	float occ = CalcAO(pos, nor);
+	float3 lightDir = normalize(float3(-10.0f, 100.0f, -10.0f));
+	float3 halfVec = normalize(lightDir - rd);
+	float ambient = ShaderMath::clamp(0.5f + 0.5f * nor.y, 0.0f, 1.0f);
+	float diffuse = ShaderMath::clamp(dot(nor, lightDir), 0.0f, 1.0f);
+	float backface = ShaderMath::clamp(dot(nor, normalize(float3(-lightDir.x, 0.0f, -lightDir.z))), 0.0f, 1.0f) * ShaderMath::clamp(1.0f - pos.y, 0.0f, 1.0f);
+	float fresnel = std::pow(ShaderMath::clamp(1.0f + dot(nor, rd), 0.0f, 1.0f), 2.0f);
+
+	diffuse *= CalcSoftshadow(pos, lightDir, 0.02f, 2.5f);
+	fresnel *= CalcSoftshadow(pos, ref, 0.02f, 2.5f);
+
+	float specular = std::pow(ShaderMath::clamp(dot(nor, halfVec), 0.0f, 1.0f), 16.0f) *
+		diffuse * (0.04f + 0.96f * std::pow(ShaderMath::clamp(1.0f + dot(halfVec, rd), 0.0f, 1.0f), 5.0f));
+
+	float3 lighting = float3(0.0f, 0.0f, 0.0f);
+	lighting += 1.30f * diffuse * float3(1.00f, 0.80f, 0.55f);
+	lighting += 0.30f * ambient * float3(0.40f, 0.60f, 1.00f) * occ;
+	lighting += 0.40f * fresnel * float3(0.40f, 0.60f, 1.00f) * occ;
+	lighting += 0.50f * backface * float3(0.25f, 0.25f, 0.25f) * occ;
+	lighting += 0.25f * fresnel * float3(1.00f, 1.00f, 1.00f) * occ;
+	float3 col = diffuseColor * lighting;
+	col += 9.00f * specular * float3(1.00f, 0.90f, 0.70f);
+
+	col = lerp(col, float3(0.8f, 0.9f, 1.0f), 1.0f - std::exp(-0.0002f * t * t * t));
+
+	return ShaderMath::clamp(col, 0.0f, 1.0f);
+}
+
+ImplicitCoralReference::MarchResult ImplicitCoralReference::CastRay(const float3& ro, const float3& rd, float tstart, const MarchSettings& settings, int* relaxationFailures)
+{
+	MarchResult res = { -1.0f, -1.0f, 0 };
+
+	float2 interval = MarchInterval(ro, rd);
+	float tmin = std::max(interval.x, tstart);
+	float tmax = interval.y;
+
+	float omega = settings.relaxation;
+	float previousRadius = 0.0f;
+	float stepLength = 0.0f;
+
+	float t = tmin;
+	for (int i = 0; i < MaxMarchSteps && t < tmax; i++)
+	{
+		res.steps++;
+		float2 h = Map(ro + rd * t);
+		float radius = settings.lipschitzSteps ? SafeDistance(std::fabs(h.x)) : std::fabs(h.x);
+
+		// The unbounding spheres of the last two points do not overlap, so the relaxed step may have
+		// jumped the surface. Go back to where a plain step would have landed and stop relaxing.
+		if (omega > 1.0f && radius + previousRadius < stepLength)
+		{
+			t -= stepLength - stepLength / omega;
+			omega = 1.0f;
+			previousRadius = 0.0f;
+			stepLength = 0.0f;
+			if (relaxationFailures)
+			{
+				(*relaxationFailures)++;
+			}
+			continue;
+		}
+
+		if (std::fabs(h.x) < (settings.hitThreshold * t))
+		{
+			res.t = t;
+			res.material = h.y;
+			break;
+		}
+
+		// Only relax forward steps, and never out of the interval where nothing would check them
+		stepLength = (h.x < 0.0f) ? -radius : radius * omega;
+		if (t + stepLength >= tmax)
+		{
+			stepLength = (h.x < 0.0f) ? -radius : radius;
+		}
+
+		previousRadius = radius;
+		t += stepLength;
+	}
+
+	return res;
+}
+
+float ImplicitCoralReference::ConeMarch(const float3& ro, const float3& rd, float coneRatio, int& steps)
+{
+	float2 interval = MarchInterval(ro, rd);
+	float t = interval.x;
+
+	steps = 0;
+	for (int i = 0; i < MaxConeSteps && t < interval.y; i++)
+	{
+		steps++;
+		float coneRadius = coneRatio * t;
+		float h = SafeDistance(Map(ro + rd * t).x);
+		if (h < coneRadius)
+		{
+			break;
+		}
+
+		t += h - coneRadius;
+	}
+
+	return t;
+}
+
+float3 ImplicitCoralReference::CanvasPosition(const Camera& camera, float pixelX, float pixelY)
+{
+	// The vertex shader stretches the canvas to [-aspect, aspect] x [-1, 1] across the viewport
+	float canvasX = (pixelX / camera.width * 2.0f - 1.0f) * camera.aspectRatio;
+	float canvasY = 1.0f - pixelY / camera.height * 2.0f;
+	return float3(camera.zoom * canvasX, camera.zoom * canvasY, NearPlane);
+}
+
+float3 ImplicitCoralReference::EyeRay(const Camera& camera, float pixelX, float pixelY)
+{
+	return normalize(CanvasPosition(camera, pixelX, pixelY) - camera.eye);
+}
+
+ImplicitCoralReference::ConePrepassTarget ImplicitCoralReference::ConePrepass(const Camera& camera)
+{
+	ConePrepassTarget target;
+	target.width = (camera.width + ConeTileSize - 1) / ConeTileSize;
+	target.height = (camera.height + ConeTileSize - 1) / ConeTileSize;
+	target.startDistance.assign(static_cast<size_t>(target.width) * target.height, 0.0f);
+	target.steps = 0;
+
+	// Equivalent of the ddx/ddy tile spacing in the shader
+	float3 tileStep = CanvasPosition(camera, ConeTileSize, ConeTileSize) - CanvasPosition(camera, 0.0f, 0.0f);
+	float tileExtent = length(0.5f * abs(tileStep));
+
+	for (int y = 0; y < target.height; y++)
+	{
+		for (int x = 0; x < target.width; x++)
+		{
+			float centreX = (x + 0.5f) * ConeTileSize;
+			float centreY = (y + 0.5f) * ConeTileSize;
+
+			// Partial tiles at the edge are not rasterised and keep the cleared distance
+			if (centreX >= camera.width || centreY >= camera.height)
+			{
+				continue;
+			}
+
+			float3 pixelPos = CanvasPosition(camera, centreX, centreY);
+			float canvasDistance = length(pixelPos - camera.eye);
+			float coneRatio = tileExtent / (canvasDistance - tileExtent);
+
+			int steps;
+			target.startDistance[y * target.width + x] = ConeMarch(camera.eye, normalize(pixelPos - camera.eye), coneRatio, steps);
+			target.steps += steps;
+		}
+	}
+
+	return target;
+}
+
+std::vector<ImplicitCoralReference::MarchResult> ImplicitCoralReference::MarchImage(const Camera& camera, const ConePrepassTarget* prepass, const MarchSettings& settings)
+{
+	std::vector<MarchResult> image(static_cast<size_t>(camera.width) * camera.height);
+
+	for (int y = 0; y < camera.height; y++)
+	{
+		for (int x = 0; x < camera.width; x++)
+		{
+			float tstart = 0.0f;
+			if (prepass)
+			{
+				tstart = prepass->startDistance[(y / ConeTileSize) * prepass->width + x / ConeTileSize];
+			}
+
+			float3 rd = EyeRay(camera, x + 0.5f, y + 0.5f);
+			image[y * camera.width + x] = CastRay(camera.eye, rd, tstart, settings);
+		}
+	}
+
+	return image;
+}
+
+ImplicitCoralReference::HitBuffer ImplicitCoralReference::MarchHitBuffer(const Camera& camera, const ConePrepassTarget* prepass, const MarchSettings& settings)
+{
+	std::vector<MarchResult> marched = MarchImage(camera, prepass, settings);
+
+	HitBuffer hitBuffer;
+	hitBuffer.width = camera.width;
+	hitBuffer.height = camera.height;
+	hitBuffer.hits.resize(marched.size());
+	for (size_t i = 0; i < marched.size(); i++)
+	{
+		hitBuffer.hits[i] = float2(marched[i].t, marched[i].material);
+	}
+
+	return hitBuffer;
+}
+
+ImplicitCoralReference::ShadedImage ImplicitCoralReference::ShadeHitBuffer(const Camera& camera, const HitBuffer& hitBuffer, int shadingRate)
+{
+	// Only whole blocks are shaded, like the floor of the viewport the GPU shades into
+	ShadedImage image;
+	image.width = std::max(hitBuffer.width / shadingRate, 1);
+	image.height = std::max(hitBuffer.height / shadingRate, 1);
+	image.colour.assign(static_cast<size_t>(image.width) * image.height, float3(0.0f));
+	image.covered.assign(image.colour.size(), false);
+
+	for (int by = 0; by < image.height; by++)
+	{
+		for (int bx = 0; bx < image.width; bx++)
+		{
+			// Nearest hit of the block, the first one found on ties
+			int hitX = -1;
+			int hitY = -1;
+			float2 hit(-1.0f, -1.0f);
+			for (int y = by * shadingRate; y < (by + 1) * shadingRate && y < hitBuffer.height; y++)
+			{
+				for (int x = bx * shadingRate; x < (bx + 1) * shadingRate && x < hitBuffer.width; x++)
+				{
+					const float2& candidate = hitBuffer.hits[y * hitBuffer.width + x];
+					if (candidate.y > -0.5f && (hit.y < -0.5f || candidate.x < hit.x))
+					{
+						hit = candidate;
+						hitX = x;
+						hitY = y;
+					}
+				}
+			}
+
+			if (hit.y < -0.5f)
+			{
+				continue;
+			}
+
+			float3 rd = EyeRay(camera, hitX + 0.5f, hitY + 0.5f);
+			float3 colour = Shade(camera.eye, rd, hit.x, hit.y);
+
+			size_t index = static_cast<size_t>(by) * image.width + bx;
+			image.colour[index] = shadingRate > 1 ? QuantiseColour(colour) : colour;
+			image.covered[index] = true;
+		}
+	}
+
+	return image;
+}
+
+ImplicitCoralReference::ShadedImage ImplicitCoralReference::ResolveShadedBlocks(const HitBuffer& hitBuffer, const ShadedImage& blocks, int shadingRate)
+{
+	ShadedImage image;
+	image.width = hitBuffer.width;
+	image.height = hitBuffer.height;
+	image.colour.assign(hitBuffer.hits.size(), float3(0.0f));
+	image.covered.assign(hitBuffer.hits.size(), false);
+
+	for (int y = 0; y < image.height; y++)
+	{
+		for (int x = 0; x < image.width; x++)
+		{
+			size_t index = static_cast<size_t>(y) * image.width + x;
+			if (hitBuffer.hits[index].y < -0.5f)
+			{
+				continue;
+			}
+
+			// Partial blocks on the right and bottom edges take the colour of the last whole block
+			int bx = std::min(x / shadingRate, blocks.width - 1);
+			int by = std::min(y / shadingRate, blocks.height - 1);
+			image.colour[index] = blocks.colour[by * blocks.width + bx];
+			image.covered[index] = true;
+		}
+	}
+
+	return image;
+}
+
+ImplicitCoralReference::ShadedImage ImplicitCoralReference::ShadeImage(const Camera& camera, const ConePrepassTarget* prepass, const MarchSettings& settings)
+{
+	ShadedImage image;
+	image.width = camera.width;
+	image.height = camera.height;
+	image.colour.assign(static_cast<size_t>(camera.width) * camera.height, float3(0.0f));
+	image.covered.assign(image.colour.size(), false);
+
+	for (int y = 0; y < camera.height; y++)
+	{
+		for (int x = 0; x < camera.width; x++)
+		{
+			float tstart = 0.0f;
+			if (prepass)
+			{
+				tstart = prepass->startDistance[(y / ConeTileSize) * prepass->width + x / ConeTileSize];
+			}
+
+			float3 rd = EyeRay(camera, x + 0.5f, y + 0.5f);
+			MarchResult res = CastRay(camera.eye, rd, tstart, settings);
+			if (res.material > -0.5f)
+			{
+				image.colour[y * camera.width + x] = Shade(camera.eye, rd, res.t, res.material);
+				image.covered[y * camera.width + x] = true;
+			}
+		}
+	}
+
+	return image;
+}
+
+ImplicitCoralReference::ConeMarchBenchmark ImplicitCoralReference::RunConeMarchBenchmark(const Camera& camera)
+{
+	ConeMarchBenchmark result = {};
+	result.pixelCount = camera.width * camera.height;
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<MarchResult> baseline = MarchImage(camera, nullptr, DefaultMarchSettings());
+	result.baselineMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	ConePrepassTarget prepass = ConePrepass(camera);
+	result.prepassMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<MarchResult> marched = MarchImage(camera, &prepass, DefaultMarchSettings());
+	result.marchMilliseconds = MillisecondsSince(start);
+
+	result.tileCount = prepass.width * prepass.height;
+	result.prepassSteps = prepass.steps;
+
+	for (size_t i = 0; i < baseline.size(); i++)
+	{
+		const MarchResult& a = baseline[i];
+		const MarchResult& b = marched[i];
+
+		result.baselineSteps += a.steps;
+		result.baselineMaxSteps = std::max(result.baselineMaxSteps, a.steps);
+		result.marchSteps += b.steps;
+		result.marchMaxSteps = std::max(result.marchMaxSteps, b.steps);
+
+		bool hitA = a.material > -0.5f;
+		bool hitB = b.material > -0.5f;
+		result.baselineHits += hitA ? 1 : 0;
+		result.marchHits += hitB ? 1 : 0;
+
+		if (hitA != hitB)
+		{
+			result.mismatchedHits++;
+		}
+		else if (hitA)
+		{
+			result.maxHitDistanceError = std::max(result.maxHitDistanceError, std::fabs(a.t - b.t));
+		}
+	}
+
+	return result;
+}
+
+ImplicitCoralReference::RelaxedMarchBenchmark ImplicitCoralReference::RunRelaxedMarchBenchmark(const Camera& camera, const MarchSettings& settings, float tolerance)
+{
+	RelaxedMarchBenchmark result = {};
+	result.pixelCount = camera.width * camera.height;
+
+	const int bucketWidth = MaxMarchSteps / StepHistogramBuckets;
+	MarchSettings original = OriginalMarchSettings();
+
+	for (int y = 0; y < camera.height; y++)
+	{
+		for (int x = 0; x < camera.width; x++)
+		{
+			float3 rd = EyeRay(camera, x + 0.5f, y + 0.5f);
+			MarchResult a = CastRay(camera.eye, rd, 0.0f, original);
+			MarchResult b = CastRay(camera.eye, rd, 0.0f, settings, &result.relaxationFailures);
+
+			result.baselineSteps += a.steps;
+			result.baselineHistogram[std::min(a.steps / bucketWidth, StepHistogramBuckets - 1)]++;
+			result.relaxedSteps += b.steps;
+			result.relaxedHistogram[std::min(b.steps / bucketWidth, StepHistogramBuckets - 1)]++;
+
+			bool hitA = a.material > -0.5f;
+			bool hitB = b.material > -0.5f;
+			result.baselineHits += hitA ? 1 : 0;
+			result.relaxedHits += hitB ? 1 : 0;
+
+			if (hitA != hitB || (hitA && std::fabs(a.t - b.t) > tolerance))
+			{
+				result.mismatchedHits++;
+			}
+			else if (hitA && a.material != b.material)
+			{
+				result.mismatchedMaterials++;
+			}
+
+			if (hitA && hitB)
+			{
+				result.maxHitDistanceError = std::max(result.maxHitDistanceError, std::fabs(a.t - b.t));
+			}
+		}
+	}
+
+	return result;
+}
+
+ImplicitCoralReference::NormalBenchmark ImplicitCoralReference::RunNormalBenchmark(const Camera& camera, int iterations)
+{
+	NormalBenchmark result = {};
+
+	std::vector<float3> hits;
+	std::vector<MarchResult> image = MarchImage(camera, nullptr, DefaultMarchSettings());
+	for (int y = 0; y < camera.height; y++)
+	{
+		for (int x = 0; x < camera.width; x++)
+		{
+			const MarchResult& res = image[y * camera.width + x];
+			if (res.material > -0.5f)
+			{
+				hits.push_back(camera.eye + EyeRay(camera, x + 0.5f, y + 0.5f) * res.t);
+			}
+		}
+	}
+	result.hitCount = static_cast<int>(hits.size());
+
+	std::vector<float3> finiteDifference(hits.size());
+	std::vector<float3> dual(hits.size());
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (size_t j = 0; j < hits.size(); j++)
+		{
+			finiteDifference[j] = CalcNormalFiniteDifference(hits[j]);
+		}
+	}
+	result.finiteDifferenceMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (size_t j = 0; j < hits.size(); j++)
+		{
+			dual[j] = CalcNormal(hits[j]);
+		}
+	}
+	result.dualMilliseconds = MillisecondsSince(start);
+
+	for (size_t j = 0; j < hits.size(); j++)
+	{
+		float3 reference = ReferenceNormal(hits[j]);
+		float finiteDifferenceError = AngleInDegrees(finiteDifference[j], reference);
+		float dualError = AngleInDegrees(dual[j], reference);
+
+		result.finiteDifferenceMeanError += finiteDifferenceError;
+		result.finiteDifferenceMaxError = std::max(result.finiteDifferenceMaxError, finiteDifferenceError);
+		result.dualMeanError += dualError;
+		result.dualMaxError = std::max(result.dualMaxError, dualError);
+	}
+
+	if (!hits.empty())
+	{
+		result.finiteDifferenceMeanError /= hits.size();
+		result.dualMeanError /= hits.size();
+	}
+
+	return result;
+}
+
+ImplicitCoralReference::DeferredShadingBenchmark ImplicitCoralReference::RunDeferredShadingBenchmark(const Camera& camera, int shadingRate)
+{
+	DeferredShadingBenchmark result = {};
+	result.pixelCount = camera.width * camera.height;
+
+	// Both paths start from the same prepass, it is not part of what is being compared
+	ConePrepassTarget prepass = ConePrepass(camera);
+
+	auto start = std::chrono::steady_clock::now();
+	ShadedImage singlePass = ShadeImage(camera, &prepass, DefaultMarchSettings());
+	result.singlePassMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	HitBuffer hitBuffer = MarchHitBuffer(camera, &prepass, DefaultMarchSettings());
+	result.marchMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	ShadedImage deferred = ShadeHitBuffer(camera, hitBuffer, shadingRate);
+	result.shadeMilliseconds = MillisecondsSince(start);
+
+	for (bool covered : deferred.covered)
+	{
+		result.shadedCount += covered ? 1 : 0;
+	}
+
+	if (shadingRate > 1)
+	{
+		start = std::chrono::steady_clock::now();
+		deferred = ResolveShadedBlocks(hitBuffer, deferred, shadingRate);
+		result.resolveMilliseconds = MillisecondsSince(start);
+	}
+
+	double totalError = 0.0;
+	for (size_t i = 0; i < singlePass.colour.size(); i++)
+	{
+		result.hitCount += deferred.covered[i] ? 1 : 0;
+
+		if (singlePass.covered[i] != deferred.covered[i])
+		{
+			result.mismatchedCoverage++;
+			continue;
+		}
+
+		const float3& a = singlePass.colour[i];
+		const float3& b = deferred.colour[i];
+		float error = std::max(std::fabs(a.x - b.x), std::max(std::fabs(a.y - b.y), std::fabs(a.z - b.z)));
+		if (error > 0.0f)
+		{
+			result.mismatchedPixels++;
+		}
+		result.maxColourError = std::max(result.maxColourError, error);
+		totalError += error;
+	}
+
+	if (result.hitCount > 0)
+	{
+		result.meanColourError = static_cast<float>(totalError / result.hitCount);
+	}
+
+	return result;
+}
+
+ImplicitCoralReference::SdfEvaluationBenchmark ImplicitCoralReference::RunSdfEvaluationBenchmark(const std::string& source, int pointCount)
+{
+	SdfEvaluationBenchmark result = {};
+	result.pointCount = pointCount - pointCount % Sdf::BatchSize;
+
+	SdfInterpreter::Scene scene = SdfInterpreter::Parse(source);
+	result.nodeCount = static_cast<int>(scene.nodes.size());
+
+	// Points spread through the bounds the coral is marched in
+	std::vector<float> px(result.pointCount), py(result.pointCount), pz(result.pointCount);
+	unsigned int seed = 1;
+	auto random = [&seed](float lo, float hi)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return lo + (hi - lo) * static_cast<float>(seed >> 8) / 16777216.0f;
+	};
+	for (int i = 0; i < result.pointCount; i++)
+	{
+		px[i] = random(-4.0f, 0.0f);
+		py[i] = random(-5.0f, -2.5f);
+		pz[i] = random(-2.0f, 0.0f);
+	}
+
+	std::vector<float> interpreted(result.pointCount), compiled(result.pointCount), batched(result.pointCount);
+	float material;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < result.pointCount; i++)
+	{
+		SdfInterpreter::Evaluate(scene, Sdf::Vec3<float>(px[i], py[i], pz[i]), interpreted[i], material);
+	}
+	result.interpretedMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < result.pointCount; i++)
+	{
+		ImplicitCoralScene::Map(Sdf::Vec3<float>(px[i], py[i], pz[i]), compiled[i], material);
+	}
+	result.compiledMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < result.pointCount; i += Sdf::BatchSize)
+	{
+		Sdf::Vec3<Sdf::FloatBatch> p;
+		for (int j = 0; j < Sdf::BatchSize; j++)
+		{
+			p.x.lane[j] = px[i + j];
+			p.y.lane[j] = py[i + j];
+			p.z.lane[j] = pz[i + j];
+		}
+
+		Sdf::FloatBatch d, m;
+		ImplicitCoralScene::Map(p, d, m);
+		for (int j = 0; j < Sdf::BatchSize; j++)
+		{
+			batched[i + j] = d.lane[j];
+		}
+	}
+	result.batchedMilliseconds = MillisecondsSince(start);
+
+	for (int i = 0; i < result.pointCount; i++)
+	{
+		result.maxCompiledError = std::max(result.maxCompiledError, std::fabs(compiled[i] - interpreted[i]));
+		result.maxBatchedError = std::max(result.maxBatchedError, std::fabs(batched[i] - interpreted[i]));
+	}
+
+	return result;
+}
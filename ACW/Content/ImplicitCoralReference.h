@@ -0,0 +1,235 @@
+﻿#pragma once
+
+#include "ShaderMath.h"
+#include <string>
+#include <vector>
+
+namespace ACW
+{
+	// CPU reference of the implicit coral passes (ImplicitCoralConePrepass.hlsl, ImplicitCoralMarchPixel.hlsl,
+	// ImplicitCoralPixel.hlsl and ImplicitCoralResolvePixel.hlsl).
+	// Used to check shader changes against the original march and to count the work they save.
+	namespace ImplicitCoralReference
+	{
+		using ShaderMath::float2;
+		using ShaderMath::float3;
+
+		// Must match CONE_TILE_SIZE in ImplicitCoralMap.hlsli.
+		static const int ConeTileSize = 8;
+
+		// Iteration limits of castRay and coneMarch.
+		static const int MaxMarchSteps = 170;
+		static const int MaxConeSteps = 64;
+
+		// Must match MARCH_RELAXATION and MARCH_HIT_THRESHOLD in ImplicitCoralMap.hlsli.
+		static const float DefaultRelaxation = 1.6f;
+		static const float DefaultHitThreshold = 0.00001f;
+
+		// Buckets of the step count histograms, each MaxMarchSteps / StepHistogramBuckets steps wide.
+		static const int StepHistogramBuckets = 17;
+
+		// How castRay advances along a ray. The original march steps by the raw distance without relaxation.
+		struct MarchSettings
+		{
+			float relaxation;
+			float hitThreshold;
+			bool lipschitzSteps;
+		};
+
+		// The canvas the coral shaders build their eye rays from. zoom is the half height of the canvas, which the
+		// shaders fix at 10.
+		struct Camera
+		{
+			float3 eye;
+			float aspectRatio;
+			float zoom;
+			int width;
+			int height;
+		};
+
+		// Outcome of marching a single ray. material is negative when the ray missed.
+		struct MarchResult
+		{
+			float t;
+			float material;
+			int steps;
+		};
+
+		// Start distances written by the cone prepass, one per tile.
+		struct ConePrepassTarget
+		{
+			int width;
+			int height;
+			std::vector<float> startDistance;
+			long long steps;
+		};
+
+		// Step counts and timings of the full resolution march with and without the cone prepass.
+		struct ConeMarchBenchmark
+		{
+			int pixelCount;
+			int tileCount;
+
+			long long baselineSteps;
+			int baselineMaxSteps;
+			int baselineHits;
+			double baselineMilliseconds;
+
+			long long prepassSteps;
+			long long marchSteps;
+			int marchMaxSteps;
+			int marchHits;
+			double prepassMilliseconds;
+			double marchMilliseconds;
+
+			int mismatchedHits;
+			float maxHitDistanceError;
+		};
+
+		// Step counts of the original march against the relaxed, Lipschitz bounded one.
+		struct RelaxedMarchBenchmark
+		{
+			int pixelCount;
+
+			long long baselineSteps;
+			int baselineHits;
+			int baselineHistogram[StepHistogramBuckets];
+
+			long long relaxedSteps;
+			int relaxedHits;
+			int relaxedHistogram[StepHistogramBuckets];
+			int relaxationFailures;
+
+			int mismatchedHits;
+			int mismatchedMaterials;
+			float maxHitDistanceError;
+		};
+
+		// Normals at every hit of the image from the four map() tetrahedron the shader used before and from
+		// one forward mode evaluation. Errors are angles in degrees against double precision central differences.
+		struct NormalBenchmark
+		{
+			int hitCount;
+
+			double finiteDifferenceMilliseconds;
+			float finiteDifferenceMeanError;
+			float finiteDifferenceMaxError;
+
+			double dualMilliseconds;
+			float dualMeanError;
+			float dualMaxError;
+		};
+
+		// Hit distance and material of every marched pixel, as ImplicitCoralMarchPixel writes them.
+		// material is negative where the ray missed.
+		struct HitBuffer
+		{
+			int width;
+			int height;
+			std::vector<float2> hits;
+		};
+
+		// Colour of every pixel the coral covers, as the shade and resolve passes leave the raymarch target.
+		struct ShadedImage
+		{
+			int width;
+			int height;
+			std::vector<float3> colour;
+			std::vector<bool> covered;
+		};
+
+		// The march and lighting in one pass, as ImplicitCoralPixel did them, against the separate march,
+		// shade and resolve passes. Colour errors are against the single pass image.
+		struct DeferredShadingBenchmark
+		{
+			int pixelCount;
+			int hitCount;
+			int shadedCount;
+
+			double singlePassMilliseconds;
+			double marchMilliseconds;
+			double shadeMilliseconds;
+			double resolveMilliseconds;
+
+			int mismatchedCoverage;
+			int mismatchedPixels;
+			float maxColourError;
+			float meanColourError;
+		};
+
+		// Cost of evaluating a .sdf scene through SdfInterpreter, the generated ImplicitCoralScene::Map
+		// one point at a time, and the same code on Sdf::FloatBatch. Errors are against the interpreter.
+		struct SdfEvaluationBenchmark
+		{
+			int pointCount;
+			int nodeCount;
+
+			double interpretedMilliseconds;
+			double compiledMilliseconds;
+			double batchedMilliseconds;
+
+			float maxCompiledError;
+			float maxBatchedError;
+		};
+
+		// The renderer's starting view, and a view that fills most of the image with the coral for the benchmarks
+		// that measure the march and shading of coral pixels.
+		Camera DefaultCamera(int width, int height);
+		Camera CoralCamera(int width, int height);
+
+		MarchSettings DefaultMarchSettings();
+		MarchSettings OriginalMarchSettings();
+
+		float2 Map(const float3& pos);
+		float2 MarchInterval(const float3& ro, const float3& rd);
+
+		// Lower bound on the distance to the surface from a point where Map returned distance.
+		float SafeDistance(float distance);
+
+		// Surface normal of calcNormal in ImplicitCoralPixel.hlsl, and the tetrahedron of finite differences it replaced.
+		float3 CalcNormal(const float3& pos);
+		float3 CalcNormalFiniteDifference(const float3& pos);
+
+		// Colour of shade() in ImplicitCoralShading.hlsli for a hit at distance t along the ray.
+		float3 Shade(const float3& ro, const float3& rd, float t, float material);
+
+		// relaxationFailures, when not null, is incremented for every over-relaxed step that had to be taken back.
+		MarchResult CastRay(const float3& ro, const float3& rd, float tstart, const MarchSettings& settings, int* relaxationFailures = nullptr);
+		float ConeMarch(const float3& ro, const float3& rd, float coneRatio, int& steps);
+
+		// Point on the canvas (and the normalised eye ray through it) for a position in back buffer pixels.
+		float3 CanvasPosition(const Camera& camera, float pixelX, float pixelY);
+		float3 EyeRay(const Camera& camera, float pixelX, float pixelY);
+
+		ConePrepassTarget ConePrepass(const Camera& camera);
+
+		// Marches every back buffer pixel, starting from the prepass distances when prepass is not null.
+		std::vector<MarchResult> MarchImage(const Camera& camera, const ConePrepassTarget* prepass, const MarchSettings& settings);
+
+		HitBuffer MarchHitBuffer(const Camera& camera, const ConePrepassTarget* prepass, const MarchSettings& settings);
+
+		// The shade pass, lighting the nearest hit in each shadingRate square block. Above a rate of 1 the
+		// result is one pixel per whole block, stored at 8 bits per channel like the shaded target on the GPU.
+		ShadedImage ShadeHitBuffer(const Camera& camera, const HitBuffer& hitBuffer, int shadingRate);
+
+		// The resolve pass, spreading the colour of each block over the pixels of it that hit.
+		ShadedImage ResolveShadedBlocks(const HitBuffer& hitBuffer, const ShadedImage& blocks, int shadingRate);
+
+		// Marches and lights every pixel in one go, the way ImplicitCoralPixel did before the hit buffer.
+		ShadedImage ShadeImage(const Camera& camera, const ConePrepassTarget* prepass, const MarchSettings& settings);
+
+		ConeMarchBenchmark RunConeMarchBenchmark(const Camera& camera);
+
+		// Hits are compared against the original march, within tolerance of the hit distance.
+		RelaxedMarchBenchmark RunRelaxedMarchBenchmark(const Camera& camera, const MarchSettings& settings, float tolerance);
+
+		// Every normal is computed iterations times for the timings.
+		NormalBenchmark RunNormalBenchmark(const Camera& camera, int iterations);
+
+		// A shading rate of 1 must reproduce the single pass image exactly.
+		DeferredShadingBenchmark RunDeferredShadingBenchmark(const Camera& camera, int shadingRate);
+
+		// source is the text of ImplicitCoral.sdf, pointCount is rounded down to whole batches.
+		SdfEvaluationBenchmark RunSdfEvaluationBenchmark(const std::string& source, int pointCount);
+	}
+}
@@ -0,0 +1,66 @@
+static float nearPlane = 1.0;
+
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer modelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 eye;
+	float4 lookAt;
+	float4 upDir;
+};
+
+// Reduced resolution raymarch settings, shadingRate is how many hit buffer pixels one shaded pixel covers on each axis.
+cbuffer upsampleConstantBuffer : register(b2)
+{
+	float resolutionScale;
+	float shadingRate;
+	float2 padding;
+};
+
+struct VS_QUAD
+{
+	float4 position : SV_POSITION;
+	float2 canvasXY : TEXCOORD0;
+};
+
+struct PixelShaderOutput
+{
+	float4 colour : SV_TARGET;
+	float depth : SV_DEPTH;
+};
+
+// Hit distance and material written by ImplicitCoralMarchPixel.
+Texture2D<float2> hitBuffer : register(t0);
+
+// Colour of each block of the hit buffer, lit by ImplicitCoralPixel at the reduced shading rate.
+Texture2D<float4> shadedBlocks : register(t1);
+
+// Runs at hit buffer resolution when the coral is shaded at a reduced rate. Coverage and depth
+// come from each pixel's own hit so silhouettes stay sharp, the colour from its block.
+PixelShaderOutput main(VS_QUAD input)
+{
+	int2 pixel = int2(input.position.xy);
+	float2 hit = hitBuffer.Load(int3(pixel, 0));
+	if (hit.y < -0.5)
+	{
+		discard;
+	}
+
+	// Partial blocks on the right and bottom edges take the colour of the last whole block
+	uint blocksWidth, blocksHeight;
+	shadedBlocks.GetDimensions(blocksWidth, blocksHeight);
+	int2 block = min(pixel / (int)shadingRate, int2(blocksWidth, blocksHeight) - 1);
+
+	float zoom = 10.0;
+	float3 pixelPos = float3(zoom * input.canvasXY, nearPlane);
+	float3 pos = eye.xyz + hit.x * normalize(pixelPos - eye.xyz);
+	float4 depthPos = mul(mul(float4(pos, 1), view), projection);
+
+	PixelShaderOutput output;
+	output.colour = shadedBlocks.Load(int3(block, 0));
+	output.depth = depthPos.z / depthPos.w;
+
+	return output;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+// Generated by Tools/SdfCompiler.py from ImplicitCoral.sdf. Do not edit.
+
+#include "SdfExpression.h"
+
+namespace ACW
+{
+	namespace ImplicitCoralScene
+	{
+		// Folded expression for the whole scene.
+		inline constexpr auto CreateExpression()
+		{
+			return Sdf::MakeMaterial(
+				65.0f,
+				Sdf::MakeTranslate(
+					0.0f,
+					-4.0f,
+					0.0f,
+					Sdf::MakeAdd(
+						Sdf::MakeDistanceScale(
+							0.5f,
+							Sdf::MakeTranslate(
+								-2.0f,
+								0.25f,
+								-1.0f,
+								Sdf::MakeSphere(0.2f))),
+						Sdf::MakeSinLattice(45.0f, 0.03f))));
+		}
+
+		typedef decltype(CreateExpression()) Expression;
+
+		// Lipschitz bound of Map, and of its smooth part once the terms bounded by
+		// +-Perturbation are taken out.
+		static const float Lipschitz = 1.85f;
+		static const float SmoothLipschitz = 0.5f;
+		static const float Perturbation = 0.03f;
+
+		// Distance and material at p, for a single point (T = float) or a batch (T = Sdf::FloatBatch).
+		template <class T>
+		inline void Map(const Sdf::Vec3<T>& p, T& distance, T& material)
+		{
+			static constexpr Expression expression = CreateExpression();
+			expression.Evaluate(p, distance, material);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+// Generated by Tools/SdfCompiler.py from ImplicitCoral.sdf. Do not edit.
+
+#include "SdfDual.hlsli"
+
+// Lipschitz bound of map(), and of its smooth part once the terms bounded by
+// +-scenePerturbation are taken out.
+static const float sceneLipschitz = 1.85;
+static const float sceneSmoothLipschitz = 0.5;
+static const float scenePerturbation = 0.03;
+
+// Distance (x) and material (y) of the scene at inPos.
+float2 map(in float3 inPos)
+{
+	float3 p0 = inPos - float3(0.0, -4.0, 0.0);
+	float3 p1 = p0 - float3(-2.0, 0.25, -1.0);
+	float d2 = length(p1) - 0.2;
+	float d3 = 0.5 * d2;
+	float d4 = 0.03 * (sin(45.0 * p0.x) * sin(45.0 * p0.y) * sin(45.0 * p0.z));
+	float d5 = d3 + d4;
+	return float2(d5, 65.0);
+}
+
+// Distance of the scene at inPos with its gradient, from one forward mode evaluation.
+Dual mapDual(in float3 inPos)
+{
+	Dual n0 = dual(inPos.x, float3(1.0, 0.0, 0.0));
+	Dual n1 = dual(inPos.y, float3(0.0, 1.0, 0.0));
+	Dual n2 = dual(inPos.z, float3(0.0, 0.0, 1.0));
+	Dual n3 = dualOffset(n1, 4.0);
+	Dual n4 = dualOffset(n0, 2.0);
+	Dual n5 = dualOffset(n3, -0.25);
+	Dual n6 = dualOffset(n2, 1.0);
+	Dual n7 = dualOffset(dualLength(n4, n5, n6), -0.2);
+	Dual n8 = dualScale(n7, 0.5);
+	Dual n9 = dualSin(dualScale(n0, 45.0));
+	Dual n10 = dualSin(dualScale(n3, 45.0));
+	Dual n11 = dualSin(dualScale(n2, 45.0));
+	Dual n12 = dualScale(dualMul(dualMul(n9, n10), n11), 0.03);
+	Dual n13 = dualAdd(n8, n12);
+	return n13;
+}
@@ -0,0 +1,97 @@
+// Lighting of the implicit coral for the shade pass, ported line for line in ImplicitCoralReference.
+// Needs ImplicitCoralMap.hlsli for map() and mapDual().
+
+static const float maxHei = 0.8;
+
+float calcSoftshadow(in float3 ro, in float3 rd, in float mint, in float tmax)
+{
+	// bounding volume
+	float tp = (maxHei - ro.y) / rd.y;
+	tmax = (tp > 0.0) ? min(tmax, tp) : tmax;
+
+	float res = 1.0;
+	float t = mint;
+	for (int i = 0; i < 16; i++)
+	{
+		float h = map(ro + rd * t).x;
+		res = min(res, 8.0 * h / t);
+		t += clamp(h, 0.02, 0.10);
+	}
+	return clamp(res, 0.0, 1.0);
+}
+
+// The gradient of the distance field from a single forward mode evaluation of the scene,
+// in place of four extra map() calls for a tetrahedron of finite differences.
+float3 calcNormal(in float3 pos)
+{
+	return normalize(mapDual(pos).g);
+}
+
+float calcAO(in float3 pos, in float3 nor)
+{
+	float occ = 0.0;
+	float sca = 1.0;
+	for (int i = 0; i < 5; i++) // Removed 'ZERO' constant, using direct '0' instead
+	{
+		float hr = 0.01 + 0.03 * float(i); // Simplified the calculation
+		float3 aopos = nor * hr + pos;
+		float dd = map(aopos).x;
+		occ += (hr - dd) * sca; // Removed unnecessary negation
+		sca *= 0.95;
+	}
+	return clamp(1.0 - 3.0 * occ, 0.0, 1.0) * (0.5 + 0.5 * nor.y);
+}
+
+float checkersGradBox(in float2 p)
+{
+	// filter kernel
+	float2 w = fwidth(p) + 0.001;
+	// analytical integral (box filter)
+	float2 i = 1.0 - 2.0 * abs(frac(p - 0.5 * w) - 0.5); // Simplified the calculation
+	// xor pattern
+	return 0.25 * i.x * i.y; // Simplified the expression
+}
+
+// Colour of the hit at distance t along the ray with material m.
+float3 shade(in float3 ro, in float3 rd, in float t, in float m)
+{
+	float3 pos = ro + t * rd;
+	float3 nor = (m < 1.5) ? float3(0.0, 1.0, 0.0) : calcNormal(pos);
+	float3 ref = reflect(rd, nor);
+
+	// material
+	float3 diffuseColor = 0.45 + 0.35 * sin(float3(0.05, 0.08, 0.10) * (m - 1.0));
+	if (m < 1.5)
+	{
+		float f = checkersGradBox(5.0 * pos.xz);
+		diffuseColor = 0.3 + f * float3(0.1, 0.1, 0.1);
+	}
+
+	// lighting
+	float occ = calcAO(pos, nor);
+	float3 lightDir = normalize(float3(-10, 100, -10));
+	float3 halfVec = normalize(lightDir - rd);
+	float ambient = clamp(0.5 + 0.5 * nor.y, 0.0, 1.0);
+	float diffuse = clamp(dot(nor, lightDir), 0.0, 1.0);
+	float backface = clamp(dot(nor, normalize(float3(-lightDir.x, 0.0, -lightDir.z))), 0.0, 1.0) * clamp(1.0 - pos.y, 0.0, 1.0);
+	float fresnel = pow(clamp(1.0 + dot(nor, rd), 0.0, 1.0), 2.0);
+
+	diffuse *= calcSoftshadow(pos, lightDir, 0.02, 2.5);
+	fresnel *= calcSoftshadow(pos, ref, 0.02, 2.5);
+
+	float specular = pow(clamp(dot(nor, halfVec), 0.0, 1.0), 16.0) *
+		diffuse * (0.04 + 0.96 * pow(clamp(1.0 + dot(halfVec, rd), 0.0, 1.0), 5.0));
+
+	float3 lighting = float3(0.0, 0.0, 0.0);
+	lighting += 1.30 * diffuse * float3(1.00, 0.80, 0.55);
+	lighting += 0.30 * ambient * float3(0.40, 0.60, 1.00) * occ;
+	lighting += 0.40 * fresnel * float3(0.40, 0.60, 1.00) * occ;
+	lighting += 0.50 * backface * float3(0.25, 0.25, 0.25) * occ;
+	lighting += 0.25 * fresnel * float3(1.00, 1.00, 1.00) * occ;
+	float3 col = diffuseColor * lighting;
+	col += 9.00 * specular * float3(1.00, 0.90, 0.70);
+
+	col = lerp(col, float3(0.8, 0.9, 1.0), 1.0 - exp(-0.0002 * t * t * t));
+
+	return float3(clamp(col, 0.0, 1.0));
+}
@@ -0,0 +1,806 @@
+﻿#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <unordered_map>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::MeshOptimizer;
+
+namespace
+{
+	// Largest LRU the vertex cache optimisation scores against
+	const int MaxScoredCacheSize = 64;
+
+	// Vertex fetch cache lines, and how many of them the fetch simulator keeps
+	const uint32_t FetchLineSize = 64;
+	const int FetchCacheLines = 64;
+
+	// Soft overdraw clusters are never split smaller than this
+	const uint32_t MinClusterTriangles = 16;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	float Axis(const float3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	float3 TriangleNormal(const float3& a, const float3& b, const float3& c)
+	{
+		return cross(b - a, c - a);
+	}
+
+	// Forsyth's score of a vertex at position in an LRU cache of cacheSize with live triangles left to draw
+	float VertexScore(int position, uint32_t live, int cacheSize)
+	{
+		if (live == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (position >= 0 && position < 3)
+		{
+			// The last triangle's vertices score the same, so its winding does not decide the next one
+			score = 0.75f;
+		}
+		else if (position >= 3)
+		{
+			score = std::pow(1.0f - static_cast<float>(position - 3) / (cacheSize - 3), 1.5f);
+		}
+		return score + 2.0f / std::sqrt(static_cast<float>(live));
+	}
+
+	// FIFO cache of the vertices of a triangle list, kept as the time each vertex last went in so that
+	// nothing has to be moved: a vertex is cached while fewer than cacheSize misses have come since
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, int cacheSize) :
+			mStamps(vertexCount, 0), mTime(static_cast<uint32_t>(cacheSize) + 1), mCacheSize(static_cast<uint32_t>(cacheSize))
+		{
+		}
+
+		// True on a miss, which puts the vertex in
+		bool Touch(uint32_t vertex)
+		{
+			if (mTime - mStamps[vertex] > mCacheSize)
+			{
+				mStamps[vertex] = mTime++;
+				return true;
+			}
+			return false;
+		}
+
+		void Flush()
+		{
+			mTime += mCacheSize + 1;
+		}
+
+	private:
+		std::vector<uint32_t> mStamps;
+		uint32_t mTime;
+		uint32_t mCacheSize;
+	};
+
+	// Error quadric of the planes around a vertex, weighted by the areas of the triangles they came from
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0), weight(0) {}
+
+		void AddPlane(const float3& n, float d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		// Mean distance squared of p from the planes
+		double Error(const float3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+		}
+	};
+
+	// Triangles round each vertex, as a compressed list the triangles of vertex v fill from offsets[v]
+	struct Adjacency
+	{
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+
+		Adjacency(const std::vector<uint32_t>& indices, size_t vertexCount) :
+			counts(vertexCount, 0), offsets(vertexCount + 1, 0), triangles(indices.size())
+		{
+			for (uint32_t index : indices)
+			{
+				counts[index]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				offsets[v + 1] = offsets[v] + counts[v];
+			}
+
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+	};
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+	}
+
+	// Triangles using each edge of the list, either way round
+	void CountEdgeUses(const std::vector<uint32_t>& indices, std::unordered_map<uint64_t, int>& uses)
+	{
+		uses.clear();
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uses[EdgeKey(indices[t + k], indices[t + (k + 1) % 3])]++;
+			}
+		}
+	}
+
+	// Triangles [first, last) of indices split where the cache was cold, then again within those where the
+	// misses so far stay under threshold times the whole cluster's, each cluster starting on a cold cache
+	std::vector<uint32_t> ClusterStarts(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize, float threshold)
+	{
+		uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		std::vector<uint32_t> hard;
+		FifoCache cache(vertexCount, cacheSize);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			int misses = cache.Touch(indices[t * 3 + 0]) + cache.Touch(indices[t * 3 + 1]) + cache.Touch(indices[t * 3 + 2]);
+			if (t == 0 || misses == 3)
+			{
+				hard.push_back(t);
+			}
+		}
+		hard.push_back(triangleCount);
+
+		std::vector<uint32_t> starts;
+		for (size_t h = 0; h + 1 < hard.size(); h++)
+		{
+			uint32_t first = hard[h];
+			uint32_t last = hard[h + 1];
+
+			cache.Flush();
+			uint32_t clusterMisses = 0;
+			for (uint32_t t = first; t < last; t++)
+			{
+				clusterMisses += cache.Touch(indices[t * 3 + 0]) + cache.Touch(indices[t * 3 + 1]) + cache.Touch(indices[t * 3 + 2]);
+			}
+			float clusterAcmr = static_cast<float>(clusterMisses) / (last - first);
+
+			cache.Flush();
+			starts.push_back(first);
+			uint32_t misses = 0;
+			uint32_t start = first;
+			for (uint32_t t = first; t < last; t++)
+			{
+				misses += cache.Touch(indices[t * 3 + 0]) + cache.Touch(indices[t * 3 + 1]) + cache.Touch(indices[t * 3 + 2]);
+				uint32_t size = t + 1 - start;
+				if (t + 1 < last && size >= MinClusterTriangles && misses <= threshold * clusterAcmr * size)
+				{
+					start = t + 1;
+					starts.push_back(start);
+					misses = 0;
+					cache.Flush();
+				}
+			}
+		}
+		starts.push_back(triangleCount);
+		return starts;
+	}
+}
+
+Settings MeshOptimizer::DefaultSettings()
+{
+	Settings settings;
+	settings.cacheSize = DefaultCacheSize;
+	settings.reduceOverdraw = false;
+	settings.overdrawThreshold = 1.05f;
+	settings.lodCount = 4;
+	settings.lodRatio = 0.5f;
+	settings.lodMaxError = 0.02f;
+	return settings;
+}
+
+VertexCacheStats MeshOptimizer::SimulateVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+	VertexCacheStats stats = {};
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	uint32_t usedCount = 0;
+	for (uint32_t index : indices)
+	{
+		stats.vertexTransforms += cache.Touch(index);
+		if (!used[index])
+		{
+			used[index] = true;
+			usedCount++;
+		}
+	}
+
+	stats.acmr = indices.empty() ? 0.0f : static_cast<float>(stats.vertexTransforms) / (indices.size() / 3);
+	stats.atvr = usedCount == 0 ? 0.0f : static_cast<float>(stats.vertexTransforms) / usedCount;
+	return stats;
+}
+
+VertexFetchStats MeshOptimizer::SimulateVertexFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize, int cacheSize)
+{
+	VertexFetchStats stats = {};
+	size_t lineCount = (vertexCount * vertexSize + FetchLineSize - 1) / FetchLineSize;
+	FifoCache vertexCache(vertexCount, cacheSize);
+	FifoCache lineCache(lineCount, FetchCacheLines);
+	std::vector<bool> used(vertexCount, false);
+	uint32_t usedCount = 0;
+	for (uint32_t index : indices)
+	{
+		if (!used[index])
+		{
+			used[index] = true;
+			usedCount++;
+		}
+
+		// Only vertices the post transform cache misses are read
+		if (!vertexCache.Touch(index))
+		{
+			continue;
+		}
+
+		size_t firstLine = index * vertexSize / FetchLineSize;
+		size_t lastLine = ((index + 1) * vertexSize - 1) / FetchLineSize;
+		for (size_t line = firstLine; line <= lastLine; line++)
+		{
+			stats.bytesFetched += lineCache.Touch(static_cast<uint32_t>(line)) ? FetchLineSize : 0;
+		}
+	}
+
+	stats.overfetch = usedCount == 0 ? 0.0f : static_cast<float>(stats.bytesFetched) / (usedCount * vertexSize);
+	return stats;
+}
+
+OverdrawStats MeshOptimizer::SimulateOverdraw(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, int resolution)
+{
+	OverdrawStats stats = {};
+	if (indices.empty())
+	{
+		return stats;
+	}
+
+	float3 minCorner = positions[indices[0]];
+	float3 maxCorner = minCorner;
+	for (uint32_t index : indices)
+	{
+		minCorner = float3(std::min(minCorner.x, positions[index].x), std::min(minCorner.y, positions[index].y), std::min(minCorner.z, positions[index].z));
+		maxCorner = float3(std::max(maxCorner.x, positions[index].x), std::max(maxCorner.y, positions[index].y), std::max(maxCorner.z, positions[index].z));
+	}
+	float3 extent = maxCorner - minCorner;
+	float scale = (resolution - 1) / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+
+	std::vector<float> depth(static_cast<size_t>(resolution) * resolution);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int u = (axis + 1) % 3;
+		int w = (axis + 2) % 3;
+		for (float sign = -1.0f; sign <= 1.0f; sign += 2.0f)
+		{
+			// Looking along sign times the axis, depth grows away from the eye
+			std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				const float3& a = positions[indices[t + 0]];
+				const float3& b = positions[indices[t + 1]];
+				const float3& c = positions[indices[t + 2]];
+				if (sign * Axis(TriangleNormal(a, b, c), axis) >= 0.0f)
+				{
+					continue;
+				}
+
+				float x[3], y[3], z[3];
+				const float3* corners[3] = { &a, &b, &c };
+				for (int k = 0; k < 3; k++)
+				{
+					x[k] = (Axis(*corners[k], u) - Axis(minCorner, u)) * scale;
+					y[k] = (Axis(*corners[k], w) - Axis(minCorner, w)) * scale;
+					z[k] = sign * Axis(*corners[k], axis);
+				}
+
+				float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+				if (std::fabs(area) < 1e-12f)
+				{
+					continue;
+				}
+
+				int x0 = std::max(static_cast<int>(std::floor(std::min(std::min(x[0], x[1]), x[2]))), 0);
+				int x1 = std::min(static_cast<int>(std::ceil(std::max(std::max(x[0], x[1]), x[2]))), resolution - 1);
+				int y0 = std::max(static_cast<int>(std::floor(std::min(std::min(y[0], y[1]), y[2]))), 0);
+				int y1 = std::min(static_cast<int>(std::ceil(std::max(std::max(y[0], y[1]), y[2]))), resolution - 1);
+				for (int py = y0; py <= y1; py++)
+				{
+					for (int px = x0; px <= x1; px++)
+					{
+						// Barycentrics of the pixel centre, the same sign as area inside either winding
+						float cx = px + 0.5f;
+						float cy = py + 0.5f;
+						float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) / area;
+						float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) / area;
+						float w2 = 1.0f - w0 - w1;
+						if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						{
+							continue;
+						}
+
+						float d = w0 * z[0] + w1 * z[1] + w2 * z[2];
+						float& stored = depth[static_cast<size_t>(py) * resolution + px];
+						if (d < stored)
+						{
+							stats.pixelsCovered += stored == std::numeric_limits<float>::max();
+							stats.pixelsShaded++;
+							stored = d;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered == 0 ? 0.0f : static_cast<float>(stats.pixelsShaded) / stats.pixelsCovered;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+	cacheSize = std::min(std::max(cacheSize, 4), MaxScoredCacheSize);
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Live triangles of each vertex are kept at the front of its adjacency list
+	Adjacency adjacency(indices, vertexCount);
+	std::vector<uint32_t>& live = adjacency.counts;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = VertexScore(-1, live[v], cacheSize);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	int best = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[best])
+		{
+			best = static_cast<int>(t);
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	size_t cursor = 0;
+	while (result.size() < indices.size())
+	{
+		// Nothing in the cache has a triangle left, so carry on from the first one not drawn yet
+		if (best < 0)
+		{
+			while (emitted[cursor])
+			{
+				cursor++;
+			}
+			best = static_cast<int>(cursor);
+		}
+
+		const uint32_t* triangle = &indices[best * 3];
+		emitted[best] = true;
+		nextCache.assign(triangle, triangle + 3);
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = triangle[k];
+			result.push_back(v);
+
+			uint32_t* list = &adjacency.triangles[adjacency.offsets[v]];
+			for (uint32_t i = 0; i < live[v]; i++)
+			{
+				if (list[i] == static_cast<uint32_t>(best))
+				{
+					std::swap(list[i], list[live[v] - 1]);
+					live[v]--;
+					break;
+				}
+			}
+		}
+
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				nextCache.push_back(v);
+			}
+		}
+
+		// Vertices pushed off the end leave the cache and score as such
+		for (size_t i = 0; i < nextCache.size(); i++)
+		{
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < static_cast<size_t>(cacheSize) ? static_cast<int>(i) : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], live[v], cacheSize);
+		}
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t v : nextCache)
+		{
+			const uint32_t* list = &adjacency.triangles[adjacency.offsets[v]];
+			for (uint32_t i = 0; i < live[v]; i++)
+			{
+				uint32_t t = list[i];
+				triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = static_cast<int>(t);
+				}
+			}
+		}
+
+		nextCache.resize(std::min(nextCache.size(), static_cast<size_t>(cacheSize)));
+		cache.swap(nextCache);
+	}
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float3>& positions, int cacheSize, float threshold)
+{
+	std::vector<uint32_t> starts = ClusterStarts(indices, positions.size(), cacheSize, threshold);
+	size_t clusterCount = starts.size() - 1;
+	if (clusterCount < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid and summed normal of each cluster, and of the whole mesh
+	std::vector<float3> centroids(clusterCount);
+	std::vector<float3> normals(clusterCount);
+	float3 meshCentroid;
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float clusterArea = 0.0f;
+		for (uint32_t t = starts[c]; t < starts[c + 1]; t++)
+		{
+			const float3& a = positions[indices[t * 3 + 0]];
+			const float3& b = positions[indices[t * 3 + 1]];
+			const float3& d = positions[indices[t * 3 + 2]];
+			float3 normal = TriangleNormal(a, b, d);
+			float area = length(normal);
+			centroids[c] += (a + b + d) * (area / 3.0f);
+			normals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += clusterArea;
+		centroids[c] = clusterArea > 0.0f ? centroids[c] / clusterArea : positions[indices[starts[c] * 3]];
+	}
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : meshCentroid;
+
+	// Clusters further out along the way they face cover the ones behind them, so go first
+	std::vector<float> keys(clusterCount);
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float normalLength = length(normals[c]);
+		keys[c] = normalLength > 0.0f ? dot(centroids[c] - meshCentroid, normals[c] / normalLength) : 0.0f;
+		order[c] = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : order)
+	{
+		result.insert(result.end(), indices.begin() + starts[c] * 3, indices.begin() + starts[c + 1] * 3);
+	}
+	indices.swap(result);
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t& usedVertexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, ~0u);
+	usedVertexCount = 0;
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == ~0u)
+		{
+			remap[index] = usedVertexCount++;
+		}
+		index = remap[index];
+	}
+	return remap;
+}
+
+std::vector<uint32_t> MeshOptimizer::Simplify(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, size_t targetIndexCount, float targetError, float& error)
+{
+	error = 0.0f;
+	size_t vertexCount = positions.size();
+	std::vector<uint32_t> result(indices);
+
+	// Planes of every triangle, and of every open edge at right angles to its triangle so that a border
+	// keeps its shape as it is simplified
+	std::vector<Quadric> quadrics(vertexCount);
+	std::unordered_map<uint64_t, int> edgeUses;
+	CountEdgeUses(result, edgeUses);
+	for (size_t t = 0; t + 2 < result.size(); t += 3)
+	{
+		const float3& a = positions[result[t + 0]];
+		float3 normal = TriangleNormal(a, positions[result[t + 1]], positions[result[t + 2]]);
+		float area = length(normal);
+		if (area == 0.0f)
+		{
+			continue;
+		}
+
+		normal = normal / area;
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[result[t + k]].AddPlane(normal, -dot(normal, a), area);
+
+			uint32_t v0 = result[t + k];
+			uint32_t v1 = result[t + (k + 1) % 3];
+			if (edgeUses[EdgeKey(v0, v1)] == 1)
+			{
+				float3 edge = positions[v1] - positions[v0];
+				float3 side = normalize(cross(edge, normal));
+				float weight = dot(edge, edge);
+				quadrics[v0].AddPlane(side, -dot(side, positions[v0]), weight);
+				quadrics[v1].AddPlane(side, -dot(side, positions[v0]), weight);
+			}
+		}
+	}
+
+	struct Collapse
+	{
+		double cost;
+		uint32_t from;
+		uint32_t to;
+	};
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<int> openEdges(vertexCount);
+	double maxCost = static_cast<double>(targetError) * targetError;
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+		size_t targetTriangles = targetIndexCount / 3;
+		Adjacency adjacency(result, vertexCount);
+
+		// A vertex on two open edges may only slide along them, any other vertex on an open edge or on
+		// an edge shared by more than two triangles stays put
+		CountEdgeUses(result, edgeUses);
+		std::fill(openEdges.begin(), openEdges.end(), 0);
+		for (const auto& edge : edgeUses)
+		{
+			int uses = edge.second == 1 ? 1 : (edge.second == 2 ? 0 : 3);
+			openEdges[static_cast<uint32_t>(edge.first >> 32)] += uses;
+			openEdges[static_cast<uint32_t>(edge.first)] += uses;
+		}
+
+		// Every half edge is a candidate to collapse its first vertex into its second, open edges either way
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 6; k++)
+			{
+				uint32_t from = result[t * 3 + k % 3];
+				uint32_t to = result[t * 3 + (k + 1) % 3];
+				bool open = edgeUses[EdgeKey(from, to)] == 1;
+				if (k >= 3)
+				{
+					std::swap(from, to);
+					if (!open)
+					{
+						continue;
+					}
+				}
+				if (openEdges[from] != 0 && (openEdges[from] != 2 || !open))
+				{
+					continue;
+				}
+
+				Quadric q = quadrics[from];
+				q.Add(quadrics[to]);
+				double cost = q.Error(positions[to]);
+				if (cost <= maxCost)
+				{
+					collapses.push_back({ cost, from, to });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// Each vertex moves at most once a pass, so the flip tests below see the triangles as they are
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = static_cast<uint32_t>(v);
+		}
+		std::fill(touched.begin(), touched.end(), false);
+		size_t removed = 0;
+		size_t made = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (triangleCount - removed <= targetTriangles)
+			{
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			// Triangles that would turn over once from sits on to rule the collapse out
+			uint32_t first = adjacency.offsets[collapse.from];
+			uint32_t last = adjacency.offsets[collapse.from + 1];
+			size_t shared = 0;
+			bool flips = false;
+			for (uint32_t i = first; i < last && !flips; i++)
+			{
+				const uint32_t* triangle = &result[adjacency.triangles[i] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					shared++;
+					continue;
+				}
+
+				float3 corners[3];
+				float3 moved[3];
+				for (int k = 0; k < 3; k++)
+				{
+					corners[k] = positions[triangle[k]];
+					moved[k] = positions[triangle[k] == collapse.from ? collapse.to : triangle[k]];
+				}
+				float3 before = TriangleNormal(corners[0], corners[1], corners[2]);
+				float3 after = TriangleNormal(moved[0], moved[1], moved[2]);
+				flips = dot(before, after) < 0.1f * length(before) * length(after) || length(after) == 0.0f;
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			for (uint32_t i = first; i < last; i++)
+			{
+				const uint32_t* triangle = &result[adjacency.triangles[i] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+			error = std::max(error, static_cast<float>(std::sqrt(collapse.cost)));
+			removed += shared;
+			made++;
+		}
+
+		if (made == 0)
+		{
+			break;
+		}
+
+		size_t kept = 0;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t a = remap[result[t * 3 + 0]];
+			uint32_t b = remap[result[t * 3 + 1]];
+			uint32_t c = remap[result[t * 3 + 2]];
+			if (a != b && b != c && c != a)
+			{
+				result[kept++] = a;
+				result[kept++] = b;
+				result[kept++] = c;
+			}
+		}
+		result.resize(kept);
+	}
+
+	return result;
+}
+
+Result MeshOptimizer::Optimize(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, size_t vertexSize, const Settings& settings)
+{
+	const int overdrawResolution = 128;
+
+	Result result;
+	result.report.cacheBefore = SimulateVertexCache(indices, positions.size(), settings.cacheSize);
+	result.report.fetchBefore = SimulateVertexFetch(indices, positions.size(), vertexSize, settings.cacheSize);
+	result.report.overdrawBefore = SimulateOverdraw(indices, positions, overdrawResolution);
+
+	// Only the optimisation is timed, not the simulators
+	auto start = std::chrono::steady_clock::now();
+
+	// Each level is simplified from the one before, so their errors add up, and each may only reach
+	// its share of lodMaxError so that the first level does not spend all of it
+	std::vector<std::vector<uint32_t>> levels(1, indices);
+	std::vector<float> errors(1, 0.0f);
+	for (int level = 1; level < settings.lodCount; level++)
+	{
+		const std::vector<uint32_t>& previous = levels.back();
+		size_t target = static_cast<size_t>(previous.size() / 3 * settings.lodRatio) * 3;
+		float budget = settings.lodMaxError * level / (settings.lodCount - 1) - errors.back();
+		float levelError;
+		std::vector<uint32_t> simplified = Simplify(previous, positions, target, budget, levelError);
+		if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+		{
+			break;
+		}
+		levels.push_back(simplified);
+		errors.push_back(errors.back() + levelError);
+	}
+
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		OptimizeVertexCache(levels[level], positions.size(), settings.cacheSize);
+		if (settings.reduceOverdraw)
+		{
+			OptimizeOverdraw(levels[level], positions, settings.cacheSize, settings.overdrawThreshold);
+		}
+
+		Lod lod;
+		lod.firstIndex = static_cast<uint32_t>(result.indices.size());
+		lod.indexCount = static_cast<uint32_t>(levels[level].size());
+		lod.error = errors[level];
+		result.lods.push_back(lod);
+		result.indices.insert(result.indices.end(), levels[level].begin(), levels[level].end());
+	}
+
+	// The full detail level comes first, so its vertices are the ones packed closest
+	result.remap = OptimizeVertexFetch(result.indices, positions.size(), result.vertexCount);
+	result.report.milliseconds = MillisecondsSince(start);
+
+	std::vector<uint32_t> full(result.indices.begin(), result.indices.begin() + result.lods[0].indexCount);
+	std::vector<float3> remapped = RemapVertices(positions, result.remap, result.vertexCount);
+	result.report.cacheAfter = SimulateVertexCache(full, result.vertexCount, settings.cacheSize);
+	result.report.fetchAfter = SimulateVertexFetch(full, result.vertexCount, vertexSize, settings.cacheSize);
+	result.report.overdrawAfter = SimulateOverdraw(full, remapped, overdrawResolution);
+	return result;
+}
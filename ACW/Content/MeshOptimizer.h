@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include "ShaderMath.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Post process for triangle lists built on the CPU, run before their vertex and index buffers are
+	// created. Indices are reordered for the post transform vertex cache (Forsyth's linear speed method),
+	// optionally regrouped so triangles facing out of the mesh are drawn first to cut overdraw (Sander et
+	// al.'s clustering), and the vertices are then put in the order the indices first use them. A chain of
+	// lower detail index lists over the same vertices is built by quadric error edge collapse. Simulators
+	// of the vertex cache, the vertex fetch and overdraw measure each step.
+	namespace MeshOptimizer
+	{
+		using ShaderMath::float3;
+
+		// Entries in the simulated FIFO post transform cache, about what current hardware keeps.
+		static const int DefaultCacheSize = 16;
+
+		struct VertexCacheStats
+		{
+			uint32_t vertexTransforms;
+			// Vertices transformed per triangle, 0.5 at best on a regular grid, 3 at worst.
+			float acmr;
+			// Vertices transformed per vertex used, 1 at best.
+			float atvr;
+		};
+
+		struct VertexFetchStats
+		{
+			uint32_t bytesFetched;
+			// Bytes read from the vertex buffer for each byte used, 1 at best.
+			float overfetch;
+		};
+
+		struct OverdrawStats
+		{
+			uint32_t pixelsCovered;
+			uint32_t pixelsShaded;
+			// Pixels shaded for each pixel covered, 1 at best.
+			float overdraw;
+		};
+
+		// A range of the index list holding one level of detail, and how far at most its surface is from the full mesh.
+		struct Lod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+
+		struct Settings
+		{
+			int cacheSize;
+
+			// Clusters are only split where their vertex cache misses stay within this factor of the whole cluster's.
+			bool reduceOverdraw;
+			float overdrawThreshold;
+
+			// Each level aims for lodRatio of the one before's triangles, and stops at lodMaxError in object units.
+			int lodCount;
+			float lodRatio;
+			float lodMaxError;
+		};
+
+		// The full detail level measured before and after, on the same simulators.
+		struct Report
+		{
+			VertexCacheStats cacheBefore;
+			VertexCacheStats cacheAfter;
+			VertexFetchStats fetchBefore;
+			VertexFetchStats fetchAfter;
+			OverdrawStats overdrawBefore;
+			OverdrawStats overdrawAfter;
+			double milliseconds;
+		};
+
+		struct Result
+		{
+			// Every level one after the other, over the remapped vertices.
+			std::vector<uint32_t> indices;
+			std::vector<Lod> lods;
+
+			// New place of each old vertex, ~0u for those no triangle uses, and how many are left.
+			std::vector<uint32_t> remap;
+			uint32_t vertexCount;
+
+			Report report;
+		};
+
+		Settings DefaultSettings();
+
+		VertexCacheStats SimulateVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize);
+
+		// Each cache miss reads the cache lines its vertex spans, lines are kept in a small FIFO of their own.
+		VertexFetchStats SimulateVertexFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize, int cacheSize);
+
+		// Front faces rasterised in order with a depth test from the six axis directions at resolution square.
+		OverdrawStats SimulateOverdraw(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, int resolution);
+
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize);
+
+		// Expects indices already in vertex cache order, and keeps each cluster's order within it.
+		void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float3>& positions, int cacheSize, float threshold);
+
+		// Rewrites indices to number the vertices in the order they are first used and returns the remap.
+		std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t& usedVertexCount);
+
+		// Collapses edges into one of their own vertices until targetIndexCount is met or the next collapse
+		// would move the surface further than targetError. Open edges are kept. Sets error to the largest
+		// collapse made.
+		std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, size_t targetIndexCount, float targetError, float& error);
+
+		// All of the above in the order they are meant to run in. vertexSize is the stride of the vertex buffer
+		// the indices will be drawn with, for the fetch simulator.
+		Result Optimize(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, size_t vertexSize, const Settings& settings);
+
+		// The vertices in their new order, for the remap Optimize returned.
+		template<typename VertexType>
+		std::vector<VertexType> RemapVertices(const std::vector<VertexType>& vertices, const std::vector<uint32_t>& remap, uint32_t vertexCount)
+		{
+			std::vector<VertexType> result(vertexCount);
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				if (remap[i] != ~0u)
+				{
+					result[remap[i]] = vertices[i];
+				}
+			}
+			return result;
+		}
+	}
+}
@@ -0,0 +1,716 @@
+﻿#include "pch.h"
+#include "Meshlets.h"
+
+#include <atomic>
+#include <chrono>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::Meshlets;
+
+namespace
+{
+	const uint8_t NotInMeshlet = 0xff;
+
+	// Cells along the longest side of the grid the builder finds nearby triangles with
+	const int GridCells = 12;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Ritter's sphere: the widest pair of the extreme points on each axis, grown to take in any point outside
+	void BoundingSphere(const std::vector<float3>& points, float3& center, float& radius)
+	{
+		center = float3(0.0f);
+		radius = 0.0f;
+		if (points.empty())
+		{
+			return;
+		}
+
+		size_t lowest[3] = { 0, 0, 0 };
+		size_t highest[3] = { 0, 0, 0 };
+		for (size_t i = 1; i < points.size(); i++)
+		{
+			const float* p = &points[i].x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				lowest[axis] = p[axis] < (&points[lowest[axis]].x)[axis] ? i : lowest[axis];
+				highest[axis] = p[axis] > (&points[highest[axis]].x)[axis] ? i : highest[axis];
+			}
+		}
+
+		float widest = -1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float3 d = points[highest[axis]] - points[lowest[axis]];
+			if (dot(d, d) > widest)
+			{
+				widest = dot(d, d);
+				center = (points[highest[axis]] + points[lowest[axis]]) * 0.5f;
+				radius = std::sqrt(widest) * 0.5f;
+			}
+		}
+
+		for (const float3& p : points)
+		{
+			float distance = length(p - center);
+			if (distance > radius)
+			{
+				// Move the centre towards p just far enough to keep the far side of the sphere where it was
+				float grown = (radius + distance) * 0.5f;
+				center += (p - center) * ((grown - radius) / distance);
+				radius = grown;
+			}
+		}
+	}
+
+	// Narrowest cone round the mean of the triangle normals, or one that can never face away
+	void NormalCone(const std::vector<float3>& normals, float3& axis, float& cutoff)
+	{
+		float3 sum(0.0f);
+		for (const float3& n : normals)
+		{
+			sum += n;
+		}
+		axis = float3(0.0f, 1.0f, 0.0f);
+		cutoff = 1.0f;
+		if (dot(sum, sum) < 1e-12f)
+		{
+			return;
+		}
+		axis = normalize(sum);
+
+		float minDot = 1.0f;
+		for (const float3& n : normals)
+		{
+			// Degenerate triangles have no normal and face nowhere
+			if (dot(n, n) > 0.0f)
+			{
+				minDot = std::min(minDot, dot(n, axis));
+			}
+		}
+
+		// Past about 84 degrees the cone would hardly ever be culled, and the test loses precision
+		if (minDot > 0.1f)
+		{
+			cutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+
+	// Builder state for the cluster being grown
+	struct Builder
+	{
+		const std::vector<uint32_t>& indices;
+		const std::vector<float3>& positions;
+		std::vector<float3> normals;
+		std::vector<float3> centroids;
+
+		// Triangles using each vertex, the triangles of vertex v being triangles[first[v]] to triangles[first[v + 1]]
+		std::vector<uint32_t> first;
+		std::vector<uint32_t> triangles;
+
+		// Triangles by the grid cell their centroid is in, the same way round
+		float3 gridMinimum;
+		float cellSize;
+		int gridSize[3];
+		std::vector<uint32_t> cellFirst;
+		std::vector<uint32_t> cellTriangles;
+
+		std::vector<bool> used;
+		std::vector<uint8_t> local;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		float3 normalSum;
+		float3 centroidSum;
+
+		Builder(const std::vector<uint32_t>& indices, const std::vector<float3>& positions) :
+			indices(indices),
+			positions(positions),
+			normalSum(0.0f),
+			centroidSum(0.0f)
+		{
+			size_t triangleCount = indices.size() / 3;
+			normals.resize(triangleCount);
+			centroids.resize(triangleCount);
+			first.assign(positions.size() + 1, 0);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				const float3& a = positions[indices[t * 3 + 0]];
+				const float3& b = positions[indices[t * 3 + 1]];
+				const float3& c = positions[indices[t * 3 + 2]];
+
+				// Clockwise seen from the front in a left handed frame
+				float3 n = cross(b - a, c - a);
+				float area = length(n);
+				normals[t] = area > 0.0f ? n / area : float3(0.0f);
+				centroids[t] = (a + b + c) / 3.0f;
+
+				for (int k = 0; k < 3; k++)
+				{
+					first[indices[t * 3 + k] + 1]++;
+				}
+			}
+			for (size_t v = 0; v < positions.size(); v++)
+			{
+				first[v + 1] += first[v];
+			}
+
+			std::vector<uint32_t> next(first.begin(), first.end() - 1);
+			triangles.resize(indices.size());
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					triangles[next[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+				}
+			}
+
+			// Cells about the size of a cluster, so the search round one stays close to it
+			float3 gridMaximum = triangleCount > 0 ? centroids[0] : float3(0.0f);
+			gridMinimum = gridMaximum;
+			for (const float3& c : centroids)
+			{
+				gridMinimum = float3(std::min(gridMinimum.x, c.x), std::min(gridMinimum.y, c.y), std::min(gridMinimum.z, c.z));
+				gridMaximum = float3(std::max(gridMaximum.x, c.x), std::max(gridMaximum.y, c.y), std::max(gridMaximum.z, c.z));
+			}
+			float3 extent = gridMaximum - gridMinimum;
+			cellSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) / GridCells;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				gridSize[axis] = std::min(static_cast<int>((&extent.x)[axis] / cellSize) + 1, GridCells);
+			}
+
+			std::vector<uint32_t> cells(triangleCount);
+			cellFirst.assign(gridSize[0] * gridSize[1] * gridSize[2] + 1, 0);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				int cell[3];
+				Cell(centroids[t], cell);
+				cells[t] = (cell[2] * gridSize[1] + cell[1]) * gridSize[0] + cell[0];
+				cellFirst[cells[t] + 1]++;
+			}
+			for (size_t c = 1; c < cellFirst.size(); c++)
+			{
+				cellFirst[c] += cellFirst[c - 1];
+			}
+			next.assign(cellFirst.begin(), cellFirst.end() - 1);
+			cellTriangles.resize(triangleCount);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				cellTriangles[next[cells[t]]++] = static_cast<uint32_t>(t);
+			}
+
+			used.assign(triangleCount, false);
+			local.assign(positions.size(), NotInMeshlet);
+		}
+
+		void Cell(const float3& p, int cell[3]) const
+		{
+			float3 d = (p - gridMinimum) / cellSize;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				cell[axis] = std::max(std::min(static_cast<int>((&d.x)[axis]), gridSize[axis] - 1), 0);
+			}
+		}
+
+		int NewVertices(uint32_t t) const
+		{
+			int count = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				count += local[indices[t * 3 + k]] == NotInMeshlet ? 1 : 0;
+			}
+			return count;
+		}
+
+		void Add(uint32_t t)
+		{
+			used[t] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[t * 3 + k];
+				if (local[v] == NotInMeshlet)
+				{
+					local[v] = static_cast<uint8_t>(meshletVertices.size());
+					meshletVertices.push_back(v);
+					for (uint32_t i = first[v]; i < first[v + 1]; i++)
+					{
+						if (!used[triangles[i]])
+						{
+							candidates.push_back(triangles[i]);
+						}
+					}
+				}
+				meshletTriangles.push_back(local[v]);
+			}
+			normalSum += normals[t];
+			centroidSum += centroids[t];
+		}
+
+		// Neighbour adding the fewest vertices, facing closest to the cluster, or ~0u when none fits
+		uint32_t BestNeighbour(int maxVertices, float coneWeight, float minConeDot)
+		{
+			float3 axis = dot(normalSum, normalSum) > 0.0f ? normalize(normalSum) : float3(0.0f);
+			uint32_t best = ~0u;
+			float bestScore = 0.0f;
+			size_t kept = 0;
+			for (uint32_t t : candidates)
+			{
+				if (used[t])
+				{
+					continue;
+				}
+				candidates[kept++] = t;
+
+				int added = NewVertices(t);
+				if (static_cast<int>(meshletVertices.size()) + added > maxVertices || dot(normals[t], axis) < minConeDot)
+				{
+					continue;
+				}
+				float score = added + coneWeight * (1.0f - dot(normals[t], axis));
+				if (best == ~0u || score < bestScore)
+				{
+					best = t;
+					bestScore = score;
+				}
+			}
+			candidates.resize(kept);
+			return best;
+		}
+
+		// Unused triangle closest to the middle of the cluster in the grid cells round it, for meshes in
+		// separate pieces, or ~0u when none there fits
+		uint32_t Nearest(int maxVertices, float minConeDot) const
+		{
+			float3 middle = centroidSum / static_cast<float>(meshletTriangles.size() / 3);
+			float3 axis = normalize(normalSum);
+			int cell[3];
+			Cell(middle, cell);
+
+			uint32_t best = ~0u;
+			float bestDistance = 0.0f;
+			for (int z = std::max(cell[2] - 1, 0); z <= std::min(cell[2] + 1, gridSize[2] - 1); z++)
+			{
+				for (int y = std::max(cell[1] - 1, 0); y <= std::min(cell[1] + 1, gridSize[1] - 1); y++)
+				{
+					for (int x = std::max(cell[0] - 1, 0); x <= std::min(cell[0] + 1, gridSize[0] - 1); x++)
+					{
+						int index = (z * gridSize[1] + y) * gridSize[0] + x;
+						for (uint32_t i = cellFirst[index]; i < cellFirst[index + 1]; i++)
+						{
+							uint32_t t = cellTriangles[i];
+							if (used[t] || static_cast<int>(meshletVertices.size()) + NewVertices(t) > maxVertices || dot(normals[t], axis) < minConeDot)
+							{
+								continue;
+							}
+							float3 d = centroids[t] - middle;
+							if (best == ~0u || dot(d, d) < bestDistance)
+							{
+								best = t;
+								bestDistance = dot(d, d);
+							}
+						}
+					}
+				}
+			}
+			return best;
+		}
+
+		void Flush(MeshletMesh& mesh)
+		{
+			Meshlet meshlet;
+			meshlet.vertexOffset = static_cast<uint32_t>(mesh.vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(mesh.triangles.size());
+			meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size() / 3);
+
+			std::vector<float3> points(meshletVertices.size());
+			for (size_t i = 0; i < meshletVertices.size(); i++)
+			{
+				points[i] = positions[meshletVertices[i]];
+				local[meshletVertices[i]] = NotInMeshlet;
+			}
+			BoundingSphere(points, meshlet.center, meshlet.radius);
+
+			std::vector<float3> faceNormals(meshlet.triangleCount);
+			for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+			{
+				const uint8_t* corner = &meshletTriangles[t * 3];
+				const float3& a = points[corner[0]];
+				const float3& b = points[corner[1]];
+				const float3& c = points[corner[2]];
+				float3 n = cross(b - a, c - a);
+				float area = length(n);
+				faceNormals[t] = area > 0.0f ? n / area : float3(0.0f);
+			}
+			NormalCone(faceNormals, meshlet.coneAxis, meshlet.coneCutoff);
+
+			mesh.meshlets.push_back(meshlet);
+			mesh.vertices.insert(mesh.vertices.end(), meshletVertices.begin(), meshletVertices.end());
+			mesh.triangles.insert(mesh.triangles.end(), meshletTriangles.begin(), meshletTriangles.end());
+			meshletVertices.clear();
+			meshletTriangles.clear();
+			candidates.clear();
+			normalSum = float3(0.0f);
+			centroidSum = float3(0.0f);
+		}
+	};
+
+	// A view frustum plane and the eye brought into a placement's own frame, where the clusters' bounds are
+	struct LocalView
+	{
+		PlantCulling::Plane planes[6];
+		float3 eye;
+	};
+
+	LocalView ToPlacement(const CullView& view, const Placement& placement)
+	{
+		// Inverse of the vertex shader's turn: x = c x' - s z', z = s x' + c z'
+		float s = std::sin(placement.angle);
+		float c = std::cos(placement.angle);
+		float inverseScale = 1.0f / placement.scale;
+
+		LocalView local;
+		for (int i = 0; i < 6; i++)
+		{
+			const PlantCulling::Plane& plane = view.frustum.planes[i];
+			float3 normal(plane.a, plane.b, plane.c);
+			local.planes[i].a = c * plane.a - s * plane.c;
+			local.planes[i].b = plane.b;
+			local.planes[i].c = s * plane.a + c * plane.c;
+			local.planes[i].d = (dot(normal, placement.position) + plane.d) * inverseScale;
+		}
+
+		float3 d = (view.eye - placement.position) * inverseScale;
+		local.eye = float3(c * d.x - s * d.z, d.y, s * d.x + c * d.z);
+		return local;
+	}
+
+	bool SphereInside(const LocalView& view, const float3& center, float radius)
+	{
+		bool inside = true;
+		for (const PlantCulling::Plane& plane : view.planes)
+		{
+			inside &= plane.a * center.x + plane.b * center.y + plane.c * center.z + plane.d >= -radius;
+		}
+		return inside;
+	}
+
+	// Every triangle faces away when the eye is behind the cone's back face widened by the sphere
+	bool FacesAway(const LocalView& view, const Meshlet& meshlet)
+	{
+		float3 d = meshlet.center - view.eye;
+		return dot(d, meshlet.coneAxis) >= meshlet.coneCutoff * length(d) + meshlet.radius;
+	}
+
+	// Visible clusters of a placement written to visible, returning how many
+	uint32_t CullPlacement(const MeshletMesh& mesh, const Placement& placement, const CullView& view, uint32_t* visible, CullStats& stats)
+	{
+		uint32_t meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		stats.meshletCount += meshletCount;
+		LocalView local = ToPlacement(view, placement);
+		if (!SphereInside(local, mesh.center, mesh.radius))
+		{
+			stats.frustumCulled += meshletCount;
+			return 0;
+		}
+
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < meshletCount; i++)
+		{
+			const Meshlet& meshlet = mesh.meshlets[i];
+			if (!SphereInside(local, meshlet.center, meshlet.radius))
+			{
+				stats.frustumCulled++;
+			}
+			else if (FacesAway(local, meshlet))
+			{
+				stats.backfaceCulled++;
+			}
+			else
+			{
+				visible[count++] = i;
+			}
+		}
+		return count;
+	}
+
+	uint32_t WriteIndices(const MeshletMesh& mesh, const uint32_t* visible, uint32_t visibleCount, uint16_t* output)
+	{
+		uint32_t written = 0;
+		for (uint32_t i = 0; i < visibleCount; i++)
+		{
+			const Meshlet& meshlet = mesh.meshlets[visible[i]];
+			const uint32_t* vertices = &mesh.vertices[meshlet.vertexOffset];
+			const uint8_t* triangles = &mesh.triangles[meshlet.triangleOffset];
+			for (uint32_t k = 0; k < meshlet.triangleCount * 3; k++)
+			{
+				output[written++] = static_cast<uint16_t>(vertices[triangles[k]]);
+			}
+		}
+		return written;
+	}
+
+	// Row major look at and perspective matrices matching XMMatrixLookAtLH and XMMatrixPerspectiveFovLH
+	void LookAtPerspective(const float3& eye, const float3& at, float fovAngleY, float aspectRatio, float nearZ, float farZ, float result[16])
+	{
+		float3 zAxis = normalize(at - eye);
+		float3 xAxis = normalize(cross(float3(0.0f, 1.0f, 0.0f), zAxis));
+		float3 yAxis = cross(zAxis, xAxis);
+		float view[16] =
+		{
+			xAxis.x, yAxis.x, zAxis.x, 0.0f,
+			xAxis.y, yAxis.y, zAxis.y, 0.0f,
+			xAxis.z, yAxis.z, zAxis.z, 0.0f,
+			-dot(xAxis, eye), -dot(yAxis, eye), -dot(zAxis, eye), 1.0f,
+		};
+
+		float yScale = 1.0f / std::tan(0.5f * fovAngleY);
+		float range = farZ / (farZ - nearZ);
+		float projection[16] =
+		{
+			yScale / aspectRatio, 0.0f, 0.0f, 0.0f,
+			0.0f, yScale, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * nearZ, 0.0f,
+		};
+
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += view[row * 4 + k] * projection[k * 4 + column];
+				}
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+}
+
+MeshletMesh Meshlets::BuildMeshlets(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, int maxVertices, int maxTriangles, float coneWeight, float maxConeAngle)
+{
+	float minConeDot = std::cos(maxConeAngle);
+
+	MeshletMesh mesh;
+	BoundingSphere(positions, mesh.center, mesh.radius);
+
+	Builder builder(indices, positions);
+	size_t triangleCount = indices.size() / 3;
+	size_t start = 0;
+	while (true)
+	{
+		// Triangles before start are all in clusters already
+		while (start < triangleCount && builder.used[start])
+		{
+			start++;
+		}
+		if (start == triangleCount)
+		{
+			break;
+		}
+
+		builder.Add(static_cast<uint32_t>(start));
+		while (static_cast<int>(builder.meshletTriangles.size() / 3) < maxTriangles)
+		{
+			uint32_t next = builder.BestNeighbour(maxVertices, coneWeight, minConeDot);
+			if (next == ~0u)
+			{
+				next = builder.Nearest(maxVertices, minConeDot);
+			}
+			if (next == ~0u)
+			{
+				break;
+			}
+			builder.Add(next);
+		}
+		builder.Flush(mesh);
+	}
+
+	return mesh;
+}
+
+size_t Meshlets::MaxIndexCount(const std::vector<MeshletMesh>& meshes, const Placement* placements, size_t placementCount)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < placementCount; i++)
+	{
+		count += meshes[placements[i].mesh].triangles.size();
+	}
+	return count;
+}
+
+uint32_t Meshlets::Cull(const std::vector<MeshletMesh>& meshes, const Placement* placements, size_t placementCount, const CullView& view, uint16_t* output, DrawRange* ranges, CullScratch& scratch, CullStats& stats, WorkerThreads::Pool& workers, int threadCount)
+{
+	stats = CullStats();
+	threadCount = WorkerThreads::CountFor(placementCount, MinPlacementsPerThread, threadCount);
+
+	// Each placement has room in visible for every one of its clusters
+	scratch.firstVisible.resize(placementCount);
+	scratch.visibleCounts.resize(placementCount);
+	size_t room = 0;
+	for (size_t i = 0; i < placementCount; i++)
+	{
+		scratch.firstVisible[i] = static_cast<uint32_t>(room);
+		room += meshes[placements[i].mesh].meshlets.size();
+	}
+	if (scratch.visible.size() < room)
+	{
+		scratch.visible.resize(room);
+	}
+	scratch.threads.assign(threadCount, CullStats());
+
+	// Placements are handed out one at a time, their meshes can differ a lot in size
+	std::atomic<size_t> next(0);
+	workers.Run(threadCount, [&](int thread)
+	{
+		CullStats& local = scratch.threads[thread];
+		for (size_t i = next++; i < placementCount; i = next++)
+		{
+			scratch.visibleCounts[i] = CullPlacement(meshes[placements[i].mesh], placements[i], view, &scratch.visible[scratch.firstVisible[i]], local);
+		}
+	});
+
+	uint32_t indexCount = 0;
+	for (size_t i = 0; i < placementCount; i++)
+	{
+		const MeshletMesh& mesh = meshes[placements[i].mesh];
+		const uint32_t* visible = &scratch.visible[scratch.firstVisible[i]];
+		uint32_t count = 0;
+		for (uint32_t k = 0; k < scratch.visibleCounts[i]; k++)
+		{
+			count += mesh.meshlets[visible[k]].triangleCount * 3;
+		}
+		ranges[i].firstIndex = indexCount;
+		ranges[i].indexCount = count;
+		indexCount += count;
+	}
+
+	next = 0;
+	workers.Run(threadCount, [&](int)
+	{
+		for (size_t i = next++; i < placementCount; i = next++)
+		{
+			WriteIndices(meshes[placements[i].mesh], &scratch.visible[scratch.firstVisible[i]], scratch.visibleCounts[i], output + ranges[i].firstIndex);
+		}
+	});
+
+	for (const CullStats& local : scratch.threads)
+	{
+		stats.meshletCount += local.meshletCount;
+		stats.frustumCulled += local.frustumCulled;
+		stats.backfaceCulled += local.backfaceCulled;
+	}
+	stats.triangleCount = static_cast<uint32_t>(MaxIndexCount(meshes, placements, placementCount) / 3);
+	stats.trianglesKept = indexCount / 3;
+	return indexCount;
+}
+
+CullBenchmark Meshlets::RunCullBenchmark(const std::vector<std::vector<uint32_t>>& indices, const std::vector<std::vector<float3>>& positions, uint32_t placementCount, int threadCount, int iterations)
+{
+	CullBenchmark result = {};
+	result.placementCount = placementCount;
+	result.threadCount = WorkerThreads::Resolve(threadCount);
+
+	std::vector<MeshletMesh> meshes;
+	size_t meshletCount = 0;
+	size_t meshletVertices = 0;
+	size_t meshletTriangles = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		meshes.push_back(BuildMeshlets(indices[i], positions[i]));
+		meshletCount += meshes.back().meshlets.size();
+		meshletVertices += meshes.back().vertices.size();
+		meshletTriangles += meshes.back().triangles.size() / 3;
+	}
+	result.buildMilliseconds = MillisecondsSince(start) / std::max<size_t>(indices.size(), 1);
+	result.meanVertices = static_cast<float>(meshletVertices) / std::max<size_t>(meshletCount, 1);
+	result.meanTriangles = static_cast<float>(meshletTriangles) / std::max<size_t>(meshletCount, 1);
+
+	// A dense field of meshes a metre apart either side of the camera and up to 40 metres ahead of it
+	std::vector<Placement> placements(placementCount);
+	unsigned int seed = 1;
+	auto random = [&seed](float lo, float hi)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return lo + (hi - lo) * static_cast<float>(seed >> 8) / 16777216.0f;
+	};
+	uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(placementCount)));
+	for (uint32_t i = 0; i < placementCount; i++)
+	{
+		Placement& placement = placements[i];
+		float x = (static_cast<float>(i % columns) / columns - 0.5f) * 40.0f;
+		float z = static_cast<float>(i / columns) / columns * 40.0f - 5.0f;
+		placement.position = float3(x + random(-0.4f, 0.4f), 0.0f, z + random(-0.4f, 0.4f));
+		placement.scale = random(0.6f, 1.2f);
+		placement.angle = random(0.0f, 6.2831853f);
+		placement.mesh = static_cast<uint32_t>(random(0.0f, 1.0f) * meshes.size()) % meshes.size();
+	}
+
+	float viewProjection[16];
+	LookAtPerspective(float3(0.0f, 1.5f, -8.0f), float3(0.0f, 0.0f, 4.0f), 70.0f * 3.14159265f / 180.0f, 16.0f / 9.0f, 0.01f, 1000.0f, viewProjection);
+	CullView view;
+	view.frustum = PlantCulling::ExtractFrustum(viewProjection);
+	view.eye = float3(0.0f, 1.5f, -8.0f);
+
+	std::vector<uint16_t> expected(MaxIndexCount(meshes, placements.data(), placementCount));
+	std::vector<uint16_t> output(expected.size());
+	std::vector<DrawRange> expectedRanges(placementCount), ranges(placementCount);
+	CullScratch scratch;
+
+	// Every cluster of every placement written, what drawing the meshes whole would cost to compact
+	std::vector<uint32_t> all;
+	start = std::chrono::steady_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		uint16_t* write = output.data();
+		for (const Placement& placement : placements)
+		{
+			const MeshletMesh& mesh = meshes[placement.mesh];
+			all.resize(mesh.meshlets.size());
+			for (uint32_t i = 0; i < all.size(); i++)
+			{
+				all[i] = i;
+			}
+			write += WriteIndices(mesh, all.data(), static_cast<uint32_t>(all.size()), write);
+		}
+	}
+	result.copyMilliseconds = MillisecondsSince(start) / iterations;
+
+	WorkerThreads::Pool workers(threadCount);
+	Cull(meshes, placements.data(), placementCount, view, expected.data(), expectedRanges.data(), scratch, result.stats, workers, 1);
+	start = std::chrono::steady_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		Cull(meshes, placements.data(), placementCount, view, expected.data(), expectedRanges.data(), scratch, result.stats, workers, 1);
+	}
+	result.cullMilliseconds = MillisecondsSince(start) / iterations;
+
+	CullStats stats;
+	start = std::chrono::steady_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		Cull(meshes, placements.data(), placementCount, view, output.data(), ranges.data(), scratch, stats, workers, threadCount);
+	}
+	result.threadedMilliseconds = MillisecondsSince(start) / iterations;
+
+	for (uint32_t i = 0; i < placementCount; i++)
+	{
+		const DrawRange& a = expectedRanges[i];
+		const DrawRange& b = ranges[i];
+		if (a.firstIndex != b.firstIndex || a.indexCount != b.indexCount ||
+			!std::equal(expected.begin() + a.firstIndex, expected.begin() + a.firstIndex + a.indexCount, output.begin() + b.firstIndex))
+		{
+			result.mismatches++;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,144 @@
+﻿#pragma once
+
+#include "PlantCulling.h"
+#include "ShaderMath.h"
+#include "WorkerThreads.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Triangle lists split into small clusters of neighbouring triangles, each with a bounding sphere and
+	// a cone bounding the directions its triangles face. Every frame the clusters of each placed mesh are
+	// tested against the view frustum and rejected when every triangle in them faces away from the eye,
+	// and the triangles of those left are written to one index buffer, a range per placed mesh.
+	namespace Meshlets
+	{
+		using ShaderMath::float3;
+		using PlantCulling::Frustum;
+
+		// Limits of a cluster, as mesh shader hardware prefers them. 124 keeps a cluster's triangles a whole number of words.
+		static const int MaxVertices = 64;
+		static const int MaxTriangles = 124;
+
+		// How much the builder favours triangles facing the way the cluster does over ones that add fewer
+		// vertices, and the furthest a triangle may face from the cluster, here 45 degrees. Thin meshes such
+		// as the coral's tubes face every way within a few triangles, and without the limit every cluster
+		// would fill with vertices long before its cone was narrow enough to ever face away.
+		static const float DefaultConeWeight = 0.25f;
+		static const float DefaultMaxConeAngle = 0.785f;
+
+		// Below this many placements per thread the work is not worth handing out.
+		static const uint32_t MinPlacementsPerThread = 32;
+
+		struct Meshlet
+		{
+			// The cluster's vertices are vertices[vertexOffset] onwards, its triangles three bytes each from
+			// triangles[triangleOffset], each byte a place in the cluster's vertices.
+			uint32_t vertexOffset;
+			uint32_t triangleOffset;
+			uint32_t vertexCount;
+			uint32_t triangleCount;
+
+			float3 center;
+			float radius;
+
+			// Every triangle faces within the cone round coneAxis, coneCutoff is the sine of the angle between
+			// its edge and the axis. 1 when the cone is too wide for the cluster to ever face away.
+			float3 coneAxis;
+			float coneCutoff;
+		};
+
+		struct MeshletMesh
+		{
+			std::vector<Meshlet> meshlets;
+			// Mesh vertex of each place in each cluster's vertices.
+			std::vector<uint32_t> vertices;
+			std::vector<uint8_t> triangles;
+
+			// Sphere round the whole mesh, so a placement off screen skips its clusters.
+			float3 center;
+			float radius;
+		};
+
+		// A mesh turned about the vertical by angle, scaled and moved to position, as the coral vertex shader does.
+		struct Placement
+		{
+			float3 position;
+			float scale;
+			float angle;
+			uint32_t mesh;
+		};
+
+		struct CullView
+		{
+			Frustum frustum;
+			float3 eye;
+		};
+
+		// The indices written for a placement.
+		struct DrawRange
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+
+		struct CullStats
+		{
+			uint32_t meshletCount;
+			uint32_t frustumCulled;
+			uint32_t backfaceCulled;
+			uint32_t triangleCount;
+			uint32_t trianglesKept;
+		};
+
+		// Kept between frames so culling does not allocate.
+		struct CullScratch
+		{
+			std::vector<uint32_t> visible;
+			std::vector<uint32_t> firstVisible;
+			std::vector<uint32_t> visibleCounts;
+			std::vector<CullStats> threads;
+		};
+
+		struct CullBenchmark
+		{
+			uint32_t placementCount;
+			int threadCount;
+
+			// Mean time to build the clusters of a mesh, and the mean triangles and vertices per cluster.
+			double buildMilliseconds;
+			float meanTriangles;
+			float meanVertices;
+
+			CullStats stats;
+
+			// Time to write every triangle of every placement with no culling, and to cull and write the rest,
+			// on one thread and on threadCount threads.
+			double copyMilliseconds;
+			double cullMilliseconds;
+			double threadedMilliseconds;
+
+			// Placements whose indices differ between one thread and several, should be 0.
+			uint32_t mismatches;
+		};
+
+		// Grows each cluster from the first triangle not yet in one, adding the neighbouring triangle that
+		// adds the fewest vertices, then the nearest one close by when no neighbour fits, until it is full or
+		// nothing near faces within maxConeAngle of it. Front faces are wound clockwise, as Direct3D draws
+		// them by default.
+		MeshletMesh BuildMeshlets(const std::vector<uint32_t>& indices, const std::vector<float3>& positions, int maxVertices = MaxVertices, int maxTriangles = MaxTriangles, float coneWeight = DefaultConeWeight, float maxConeAngle = DefaultMaxConeAngle);
+
+		// Room the output of Cull needs at most for these placements.
+		size_t MaxIndexCount(const std::vector<MeshletMesh>& meshes, const Placement* placements, size_t placementCount);
+
+		// Writes the indices of the visible clusters of each placement, as uint16_t mesh vertex numbers,
+		// to output and their range to ranges, and returns the indices written. output is written front to
+		// back so it can be a mapped dynamic buffer. The work is split threadCount ways over the threads of
+		// workers, threadCount 0 splitting it one way per hardware thread.
+		uint32_t Cull(const std::vector<MeshletMesh>& meshes, const Placement* placements, size_t placementCount, const CullView& view, uint16_t* output, DrawRange* ranges, CullScratch& scratch, CullStats& stats, WorkerThreads::Pool& workers, int threadCount);
+
+		// placementCount copies of meshes laid out densely round the scene's starting camera, averaged over iterations runs.
+		CullBenchmark RunCullBenchmark(const std::vector<std::vector<uint32_t>>& indices, const std::vector<std::vector<float3>>& positions, uint32_t placementCount, int threadCount, int iterations);
+	}
+}
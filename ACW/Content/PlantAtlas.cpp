@@ -0,0 +1,626 @@
+﻿#include "pch.h"
+#include "PlantAtlas.h"
+#include "PlantInstances.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::PlantAtlas;
+
+namespace
+{
+	const uint32_t DdsMagic = 0x20534444;
+	const uint32_t FourCCDxt5 = 0x35545844;
+	const uint32_t FourCCDx10 = 0x30315844;
+	const uint32_t DxgiFormatR8G8B8A8Unorm = 28;
+	const size_t DdsHeaderSize = 4 + 124;
+	const size_t Dx10HeaderSize = 20;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	uint32_t Read32(const uint8_t* data)
+	{
+		return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+	}
+
+	void Write32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 24));
+	}
+
+	uint32_t Pack(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	uint32_t Channel(uint32_t pixel, int channel)
+	{
+		return (pixel >> (channel * 8)) & 0xff;
+	}
+
+	uint32_t ToByte(float v)
+	{
+		// Through int, which converts in SIMD where unsigned does not
+		return static_cast<uint32_t>(static_cast<int>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f));
+	}
+
+	// One 4x4 DXT5 block: eight alpha levels from two endpoints, then four colours from two 565 endpoints
+	void DecodeDxt5Block(const uint8_t* block, uint32_t colours[16])
+	{
+		uint32_t alpha[8];
+		alpha[0] = block[0];
+		alpha[1] = block[1];
+		if (alpha[0] > alpha[1])
+		{
+			for (int i = 1; i < 7; i++)
+			{
+				alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+			}
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+			{
+				alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+			}
+			alpha[6] = 0;
+			alpha[7] = 255;
+		}
+
+		uint64_t alphaBits = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			alphaBits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+		}
+
+		uint32_t endpoints[2] = { static_cast<uint32_t>(block[8] | (block[9] << 8)), static_cast<uint32_t>(block[10] | (block[11] << 8)) };
+		uint32_t rgb[4][3];
+		for (int e = 0; e < 2; e++)
+		{
+			rgb[e][0] = ((endpoints[e] >> 11) & 31) * 255 / 31;
+			rgb[e][1] = ((endpoints[e] >> 5) & 63) * 255 / 63;
+			rgb[e][2] = (endpoints[e] & 31) * 255 / 31;
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			rgb[2][c] = (2 * rgb[0][c] + rgb[1][c]) / 3;
+			rgb[3][c] = (rgb[0][c] + 2 * rgb[1][c]) / 3;
+		}
+
+		uint32_t colourBits = Read32(block + 12);
+		for (int i = 0; i < 16; i++)
+		{
+			const uint32_t* c = rgb[(colourBits >> (2 * i)) & 3];
+			colours[i] = Pack(c[0], c[1], c[2], alpha[(alphaBits >> (3 * i)) & 7]);
+		}
+	}
+
+	// One channel of a mip level, premultiplied by alpha
+	typedef std::vector<float> Plane;
+
+	// Premultiplied planes of count packed pixels
+	void SplitPixels(const uint32_t* pixels, size_t count, float* r, float* g, float* b, float* a)
+	{
+		const float toFloat = 1.0f / 255.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			int pixel = static_cast<int>(pixels[i] >> 8);
+			float alpha = static_cast<float>(pixel >> 16) * toFloat;
+			r[i] = static_cast<float>(static_cast<int>(pixels[i] & 0xff)) * toFloat * alpha;
+			g[i] = static_cast<float>(pixel & 0xff) * toFloat * alpha;
+			b[i] = static_cast<float>((pixel >> 8) & 0xff) * toFloat * alpha;
+			a[i] = alpha;
+		}
+	}
+
+	// 2x2 box filter of a pair of rows of one plane. A plain loop the compiler vectorises.
+	void DownsampleRow(const float* row0, const float* row1, uint32_t stepX, float* out, uint32_t width)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			out[x] = 0.25f * (row0[2 * x] + row0[2 * x + stepX] + row1[2 * x] + row1[2 * x + stepX]);
+		}
+	}
+
+	// Back from premultiplied planes to straight alpha RGBA8
+	void StorePlanes(const Plane planes[4], size_t count, uint32_t* out)
+	{
+		const float* r = planes[0].data();
+		const float* g = planes[1].data();
+		const float* b = planes[2].data();
+		const float* a = planes[3].data();
+		for (size_t i = 0; i < count; i++)
+		{
+			float scale = a[i] > 0.0f ? 1.0f / a[i] : 0.0f;
+			out[i] = Pack(ToByte(r[i] * scale), ToByte(g[i] * scale), ToByte(b[i] * scale), ToByte(a[i]));
+		}
+	}
+
+	uint32_t MipCount(uint32_t width, uint32_t height)
+	{
+		uint32_t count = 1;
+		while (width > 1 || height > 1)
+		{
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			count++;
+		}
+		return count;
+	}
+
+	// The same alpha weighted filter a texel at a time on the packed pixels
+	void ScalarMips(const Image& image, std::vector<uint32_t>& out)
+	{
+		uint32_t width = image.width;
+		uint32_t height = image.height;
+		std::vector<uint32_t> level = image.pixels;
+		out = level;
+		while (width > 1 || height > 1)
+		{
+			uint32_t nextWidth = std::max(width / 2, 1u);
+			uint32_t nextHeight = std::max(height / 2, 1u);
+			std::vector<uint32_t> next(static_cast<size_t>(nextWidth) * nextHeight);
+			for (uint32_t y = 0; y < nextHeight; y++)
+			{
+				for (uint32_t x = 0; x < nextWidth; x++)
+				{
+					uint32_t taps[4] =
+					{
+						level[(2 * y) * width + 2 * x],
+						level[(2 * y) * width + std::min(2 * x + 1, width - 1)],
+						level[std::min(2 * y + 1, height - 1) * width + 2 * x],
+						level[std::min(2 * y + 1, height - 1) * width + std::min(2 * x + 1, width - 1)],
+					};
+					float sum[4] = {};
+					for (uint32_t tap : taps)
+					{
+						float a = Channel(tap, 3) / 255.0f;
+						for (int c = 0; c < 3; c++)
+						{
+							sum[c] += Channel(tap, c) / 255.0f * a;
+						}
+						sum[3] += a;
+					}
+					float a = 0.25f * sum[3];
+					float scale = sum[3] > 0.0f ? 1.0f / sum[3] : 0.0f;
+					next[y * nextWidth + x] = Pack(ToByte(sum[0] * scale), ToByte(sum[1] * scale), ToByte(sum[2] * scale), ToByte(a));
+				}
+			}
+			out.insert(out.end(), next.begin(), next.end());
+			level.swap(next);
+			width = nextWidth;
+			height = nextHeight;
+		}
+	}
+
+	float4 Fetch(const TextureArray& textureArray, uint32_t layer, uint32_t mip, int x, int y)
+	{
+		uint32_t width = std::max(textureArray.width >> mip, 1u);
+		uint32_t height = std::max(textureArray.height >> mip, 1u);
+		x &= width - 1;
+		y &= height - 1;
+		uint32_t texel = textureArray.texels[textureArray.offsets[layer * textureArray.mipCount + mip] + static_cast<size_t>(y) * width + x];
+		return float4(Channel(texel, 0) / 255.0f, Channel(texel, 1) / 255.0f, Channel(texel, 2) / 255.0f, Channel(texel, 3) / 255.0f);
+	}
+
+	float4 Lerp(const float4& a, const float4& b, float t)
+	{
+		return float4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+	}
+
+	float4 SampleBilinear(const TextureArray& textureArray, uint32_t layer, uint32_t mip, const float2& uv)
+	{
+		float u = uv.x * std::max(textureArray.width >> mip, 1u) - 0.5f;
+		float v = uv.y * std::max(textureArray.height >> mip, 1u) - 0.5f;
+		float x0 = std::floor(u);
+		float y0 = std::floor(v);
+		int x = static_cast<int>(x0);
+		int y = static_cast<int>(y0);
+		float4 top = Lerp(Fetch(textureArray, layer, mip, x, y), Fetch(textureArray, layer, mip, x + 1, y), u - x0);
+		float4 bottom = Lerp(Fetch(textureArray, layer, mip, x, y + 1), Fetch(textureArray, layer, mip, x + 1, y + 1), u - x0);
+		return Lerp(top, bottom, v - y0);
+	}
+}
+
+std::vector<Species> PlantAtlas::DefaultSpecies()
+{
+	// The grass sprite as drawn before, then red, yellow and purple weed made from it
+	Species species[PlantInstances::SpeciesCount] =
+	{
+		{ false, float3(1.0f, 1.0f, 1.0f), false },
+		{ true, float3(1.7f, 0.6f, 0.5f), true },
+		{ true, float3(1.5f, 1.3f, 0.4f), false },
+		{ true, float3(1.1f, 0.6f, 1.6f), true },
+	};
+	return std::vector<Species>(species, species + PlantInstances::SpeciesCount);
+}
+
+Image PlantAtlas::DecodeDds(const uint8_t* data, size_t size)
+{
+	if (size < DdsHeaderSize || Read32(data) != DdsMagic || Read32(data + 4) != 124)
+	{
+		throw std::invalid_argument("not a DDS file");
+	}
+
+	Image image;
+	image.height = Read32(data + 12);
+	image.width = Read32(data + 16);
+	image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+
+	uint32_t formatFlags = Read32(data + 80);
+	uint32_t fourCC = Read32(data + 84);
+	const uint8_t* pixels = data + DdsHeaderSize;
+
+	if ((formatFlags & 0x4) && fourCC == FourCCDxt5)
+	{
+		uint32_t blocksX = (image.width + 3) / 4;
+		uint32_t blocksY = (image.height + 3) / 4;
+		if (size < DdsHeaderSize + static_cast<size_t>(blocksX) * blocksY * 16)
+		{
+			throw std::invalid_argument("DDS file is truncated");
+		}
+
+		uint32_t colours[16];
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				DecodeDxt5Block(pixels + (static_cast<size_t>(by) * blocksX + bx) * 16, colours);
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					uint32_t x = bx * 4 + i % 4;
+					uint32_t y = by * 4 + i / 4;
+					if (x < image.width && y < image.height)
+					{
+						image.pixels[static_cast<size_t>(y) * image.width + x] = colours[i];
+					}
+				}
+			}
+		}
+		return image;
+	}
+
+	// Uncompressed, either a legacy 32 bit format with channel masks or R8G8B8A8 in a DX10 header
+	uint32_t masks[4] = { 0xff, 0xff00, 0xff0000, 0xff000000 };
+	if ((formatFlags & 0x4) && fourCC == FourCCDx10)
+	{
+		if (size < DdsHeaderSize + Dx10HeaderSize || Read32(pixels) != DxgiFormatR8G8B8A8Unorm)
+		{
+			throw std::invalid_argument("unsupported DX10 DDS format");
+		}
+		pixels += Dx10HeaderSize;
+	}
+	else if ((formatFlags & 0x40) && Read32(data + 88) == 32)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			masks[c] = Read32(data + 92 + 4 * c);
+		}
+	}
+	else
+	{
+		throw std::invalid_argument("unsupported DDS format");
+	}
+
+	if (static_cast<size_t>(pixels - data) + image.pixels.size() * 4 > size)
+	{
+		throw std::invalid_argument("DDS file is truncated");
+	}
+
+	for (size_t i = 0; i < image.pixels.size(); i++)
+	{
+		uint32_t pixel = Read32(pixels + i * 4);
+		uint32_t channels[4];
+		for (int c = 0; c < 4; c++)
+		{
+			uint32_t mask = masks[c];
+			if (mask == 0)
+			{
+				channels[c] = c == 3 ? 255 : 0;
+				continue;
+			}
+			uint32_t shift = 0;
+			while (((mask >> shift) & 1) == 0)
+			{
+				shift++;
+			}
+			channels[c] = ((pixel & mask) >> shift) * 255 / (mask >> shift);
+		}
+		image.pixels[i] = Pack(channels[0], channels[1], channels[2], channels[3]);
+	}
+	return image;
+}
+
+Image PlantAtlas::MakeSpecies(const Image& source, const Species& species)
+{
+	Image image = source;
+	for (uint32_t y = 0; y < image.height; y++)
+	{
+		for (uint32_t x = 0; x < image.width; x++)
+		{
+			uint32_t pixel = source.pixels[static_cast<size_t>(y) * source.width + (species.mirror ? source.width - 1 - x : x)];
+			if (species.recolour)
+			{
+				float luminance = (0.299f * Channel(pixel, 0) + 0.587f * Channel(pixel, 1) + 0.114f * Channel(pixel, 2)) / 255.0f;
+				pixel = Pack(ToByte(luminance * species.tint.x), ToByte(luminance * species.tint.y), ToByte(luminance * species.tint.z), Channel(pixel, 3));
+			}
+			image.pixels[static_cast<size_t>(y) * image.width + x] = pixel;
+		}
+	}
+	return image;
+}
+
+TextureArray PlantAtlas::Build(const std::vector<Image>& layers)
+{
+	if (layers.empty())
+	{
+		throw std::invalid_argument("no layers to build");
+	}
+
+	TextureArray textureArray;
+	textureArray.width = layers[0].width;
+	textureArray.height = layers[0].height;
+	textureArray.layerCount = static_cast<uint32_t>(layers.size());
+	textureArray.mipCount = MipCount(textureArray.width, textureArray.height);
+	if ((textureArray.width & (textureArray.width - 1)) != 0 || (textureArray.height & (textureArray.height - 1)) != 0)
+	{
+		throw std::invalid_argument("layers must be a power of two in size");
+	}
+
+	size_t texelsPerLayer = 0;
+	for (uint32_t mip = 0; mip < textureArray.mipCount; mip++)
+	{
+		texelsPerLayer += static_cast<size_t>(std::max(textureArray.width >> mip, 1u)) * std::max(textureArray.height >> mip, 1u);
+	}
+	textureArray.texels.resize(texelsPerLayer * layers.size());
+
+	Plane planes[4], next[4];
+	for (uint32_t layer = 0; layer < textureArray.layerCount; layer++)
+	{
+		const Image& image = layers[layer];
+		if (image.width != textureArray.width || image.height != textureArray.height)
+		{
+			throw std::invalid_argument("layers must all be the same size");
+		}
+
+		size_t offset = texelsPerLayer * layer;
+		uint32_t width = textureArray.width;
+		uint32_t height = textureArray.height;
+		for (uint32_t mip = 0; mip < textureArray.mipCount; mip++)
+		{
+			textureArray.offsets.push_back(offset);
+			if (mip == 0)
+			{
+				std::copy(image.pixels.begin(), image.pixels.end(), textureArray.texels.begin() + offset);
+				offset += image.pixels.size();
+				continue;
+			}
+
+			// Filtering is done on planes of premultiplied channels, so each channel goes through the same loop
+			uint32_t nextWidth = std::max(width / 2, 1u);
+			uint32_t nextHeight = std::max(height / 2, 1u);
+			uint32_t stepX = width > 1 ? 1 : 0;
+			uint32_t stepY = height > 1 ? 1 : 0;
+			for (int c = 0; c < 4; c++)
+			{
+				next[c].resize(static_cast<size_t>(nextWidth) * nextHeight);
+			}
+
+			if (mip == 1)
+			{
+				// The top level is split a pair of rows at a time, which stays in cache
+				for (Plane& row : planes)
+				{
+					row.resize(2 * static_cast<size_t>(width));
+				}
+				for (uint32_t y = 0; y < nextHeight; y++)
+				{
+					for (uint32_t r = 0; r < 2; r++)
+					{
+						const uint32_t* pixels = &image.pixels[static_cast<size_t>(2 * y + r * stepY) * width];
+						SplitPixels(pixels, width, &planes[0][r * width], &planes[1][r * width], &planes[2][r * width], &planes[3][r * width]);
+					}
+					for (int c = 0; c < 4; c++)
+					{
+						DownsampleRow(&planes[c][0], &planes[c][width], stepX, &next[c][static_cast<size_t>(y) * nextWidth], nextWidth);
+					}
+				}
+			}
+			else
+			{
+				for (uint32_t y = 0; y < nextHeight; y++)
+				{
+					for (int c = 0; c < 4; c++)
+					{
+						const float* row0 = &planes[c][static_cast<size_t>(2 * y) * width];
+						const float* row1 = &planes[c][static_cast<size_t>(2 * y + stepY) * width];
+						DownsampleRow(row0, row1, stepX, &next[c][static_cast<size_t>(y) * nextWidth], nextWidth);
+					}
+				}
+			}
+
+			for (int c = 0; c < 4; c++)
+			{
+				planes[c].swap(next[c]);
+			}
+			width = nextWidth;
+			height = nextHeight;
+			StorePlanes(planes, static_cast<size_t>(width) * height, &textureArray.texels[offset]);
+			offset += static_cast<size_t>(width) * height;
+		}
+	}
+
+	return textureArray;
+}
+
+std::vector<uint8_t> PlantAtlas::WriteDds(const TextureArray& textureArray)
+{
+	std::vector<uint8_t> out;
+	out.reserve(DdsHeaderSize + Dx10HeaderSize + textureArray.texels.size() * 4);
+
+	Write32(out, DdsMagic);
+	Write32(out, 124);
+	// Caps, height, width, pitch, pixel format and mip count are set
+	Write32(out, 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000);
+	Write32(out, textureArray.height);
+	Write32(out, textureArray.width);
+	Write32(out, textureArray.width * 4);
+	Write32(out, 0);
+	Write32(out, textureArray.mipCount);
+	for (int i = 0; i < 11; i++)
+	{
+		Write32(out, 0);
+	}
+
+	// Pixel format: the DX10 header that follows says what it is
+	Write32(out, 32);
+	Write32(out, 0x4);
+	Write32(out, FourCCDx10);
+	for (int i = 0; i < 5; i++)
+	{
+		Write32(out, 0);
+	}
+
+	// Texture, complex and mipmapped
+	Write32(out, 0x1000 | 0x8 | 0x400000);
+	for (int i = 0; i < 4; i++)
+	{
+		Write32(out, 0);
+	}
+
+	// DX10 header: format, a 2D texture, no flags, the array size and straight alpha
+	Write32(out, DxgiFormatR8G8B8A8Unorm);
+	Write32(out, 3);
+	Write32(out, 0);
+	Write32(out, textureArray.layerCount);
+	Write32(out, 1);
+
+	// Texels are already in file order, and every platform the app targets is little endian
+	size_t headerSize = out.size();
+	out.resize(headerSize + textureArray.texels.size() * 4);
+	std::memcpy(&out[headerSize], textureArray.texels.data(), textureArray.texels.size() * 4);
+	return out;
+}
+
+std::vector<uint8_t> PlantAtlas::BuildSpeciesPack(const uint8_t* sourceDds, size_t size)
+{
+	Image source = DecodeDds(sourceDds, size);
+	std::vector<Image> layers;
+	for (const Species& species : DefaultSpecies())
+	{
+		layers.push_back(MakeSpecies(source, species));
+	}
+	return WriteDds(Build(layers));
+}
+
+float4 PlantAtlas::Sample(const TextureArray& textureArray, uint32_t layer, const float2& uv, float lod)
+{
+	float maxLod = static_cast<float>(textureArray.mipCount - 1);
+	lod = lod < 0.0f ? 0.0f : (lod > maxLod ? maxLod : lod);
+	uint32_t mip = static_cast<uint32_t>(lod);
+	float4 fine = SampleBilinear(textureArray, layer, mip, uv);
+	if (mip + 1 >= textureArray.mipCount)
+	{
+		return fine;
+	}
+	return Lerp(fine, SampleBilinear(textureArray, layer, mip + 1, uv), lod - mip);
+}
+
+AtlasBenchmark PlantAtlas::RunAtlasBenchmark(const uint8_t* sourceDds, size_t size, int iterations)
+{
+	AtlasBenchmark result = {};
+
+	Image source;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		source = DecodeDds(sourceDds, size);
+	}
+	result.decodeMilliseconds = MillisecondsSince(start) / iterations;
+
+	std::vector<Species> species = DefaultSpecies();
+	std::vector<Image> layers;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		layers.clear();
+		for (const Species& s : species)
+		{
+			layers.push_back(MakeSpecies(source, s));
+		}
+	}
+	result.speciesMilliseconds = MillisecondsSince(start) / iterations;
+
+	TextureArray textureArray;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		textureArray = Build(layers);
+	}
+	result.mipMilliseconds = MillisecondsSince(start) / iterations;
+
+	// Fresh output each time, as Build has
+	std::vector<std::vector<uint32_t>> scalar;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		scalar.assign(layers.size(), std::vector<uint32_t>());
+		for (size_t layer = 0; layer < layers.size(); layer++)
+		{
+			ScalarMips(layers[layer], scalar[layer]);
+		}
+	}
+	result.scalarMipMilliseconds = MillisecondsSince(start) / iterations;
+
+	size_t texelsPerLayer = textureArray.texels.size() / textureArray.layerCount;
+	for (size_t layer = 0; layer < layers.size(); layer++)
+	{
+		for (size_t i = 0; i < texelsPerLayer; i++)
+		{
+			// Compared premultiplied, the colour of a nearly transparent texel does not show
+			uint32_t a = textureArray.texels[layer * texelsPerLayer + i];
+			uint32_t b = scalar[layer][i];
+			for (int c = 0; c < 4; c++)
+			{
+				int premultipliedA = static_cast<int>(c == 3 ? Channel(a, c) : Channel(a, c) * Channel(a, 3) / 255);
+				int premultipliedB = static_cast<int>(c == 3 ? Channel(b, c) : Channel(b, c) * Channel(b, 3) / 255);
+				result.maxMipDifference = std::max(result.maxMipDifference, std::abs(premultipliedA - premultipliedB));
+			}
+		}
+	}
+
+	std::vector<uint8_t> pack;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		pack = WriteDds(textureArray);
+	}
+	result.writeMilliseconds = MillisecondsSince(start) / iterations;
+	result.packBytes = pack.size();
+
+	// Trilinear samples spread over every layer and the first few mips
+	const int sampleCount = 1 << 20;
+	float checksum = 0.0f;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < sampleCount; i++)
+	{
+		float2 uv(frac(i * 0.7548777f), frac(i * 0.5698403f));
+		checksum += Sample(textureArray, i % textureArray.layerCount, uv, (i % 64) / 16.0f).w;
+	}
+	result.nanosecondsPerSample = MillisecondsSince(start) * 1.0e6 / sampleCount;
+	result.nanosecondsPerSample += checksum < 0.0f ? 1.0 : 0.0;
+
+	result.layerCount = textureArray.layerCount;
+	result.size = textureArray.width;
+	result.mipCount = textureArray.mipCount;
+	return result;
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "ShaderMath.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Builds the plant texture array at load: one layer per species, each with a full mip chain filtered
+	// on the CPU, packed into a single DDS that CreateDDSTextureFromMemory loads. Plants pick their layer
+	// per instance, so every species draws from one texture binding.
+	namespace PlantAtlas
+	{
+		using ShaderMath::float2;
+		using ShaderMath::float3;
+		using ShaderMath::float4;
+
+		// RGBA8 pixels, red in the lowest byte as DXGI_FORMAT_R8G8B8A8_UNORM lays them out.
+		struct Image
+		{
+			uint32_t width;
+			uint32_t height;
+			std::vector<uint32_t> pixels;
+		};
+
+		// Layers of the same size, each followed by its mips, in the order a DDS file stores them.
+		struct TextureArray
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t layerCount;
+			uint32_t mipCount;
+			std::vector<uint32_t> texels;
+			// Where each mip of each layer starts in texels, layer * mipCount + mip.
+			std::vector<size_t> offsets;
+		};
+
+		// How a species is made from the source sprite.
+		struct Species
+		{
+			// Recoloured species keep the sprite's shading and take their hue from tint.
+			bool recolour;
+			float3 tint;
+			bool mirror;
+		};
+
+		// Layer i of the array is made with DefaultSpecies()[i], PlantInstances::SpeciesCount of them.
+		std::vector<Species> DefaultSpecies();
+
+		// Top level of a DXT5, uncompressed 32 bit or R8G8B8A8 DX10 DDS file. Throws std::invalid_argument
+		// for anything else.
+		Image DecodeDds(const uint8_t* data, size_t size);
+
+		Image MakeSpecies(const Image& source, const Species& species);
+
+		// Mips down to 1x1 with an alpha weighted 2x2 box filter, so transparent texels do not darken
+		// the edges of the sprite. Layers must share a power of two size.
+		TextureArray Build(const std::vector<Image>& layers);
+
+		// The array as a DDS file with the DX10 header.
+		std::vector<uint8_t> WriteDds(const TextureArray& textureArray);
+
+		// DecodeDds, a layer per species, Build and WriteDds in one.
+		std::vector<uint8_t> BuildSpeciesPack(const uint8_t* sourceDds, size_t size);
+
+		// Trilinear, wrapping sample as the plant sampler takes it.
+		float4 Sample(const TextureArray& textureArray, uint32_t layer, const float2& uv, float lod);
+
+		struct AtlasBenchmark
+		{
+			uint32_t layerCount;
+			uint32_t size;
+			uint32_t mipCount;
+
+			double decodeMilliseconds;
+			double speciesMilliseconds;
+			// Build on planar floats, and the same filter a texel at a time on RGBA8 for comparison.
+			double mipMilliseconds;
+			double scalarMipMilliseconds;
+			double writeMilliseconds;
+			size_t packBytes;
+
+			double nanosecondsPerSample;
+			// Largest difference of a channel between the two filters, in 8 bit steps.
+			int maxMipDifference;
+		};
+
+		AtlasBenchmark RunAtlasBenchmark(const uint8_t* sourceDds, size_t size, int iterations);
+	}
+}
@@ -0,0 +1,353 @@
+﻿#include "pch.h"
+#include "PlantCulling.h"
+
+#include <chrono>
+#include <cstring>
+
+// ARM builds test one instance at a time
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PLANT_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::PlantCulling;
+
+namespace
+{
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	Plane NormalisePlane(float a, float b, float c, float d)
+	{
+		float scale = 1.0f / std::sqrt(a * a + b * b + c * c);
+		Plane plane = { a * scale, b * scale, c * scale, d * scale };
+		return plane;
+	}
+
+#if defined(PLANT_CULLING_SSE2)
+	// a * x + b * y + c * z + d for four instances, added in the same order as the scalar test
+	__m128 PlaneDistance(const Plane& plane, __m128 x, __m128 y, __m128 z)
+	{
+		__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.a), x), _mm_mul_ps(_mm_set1_ps(plane.b), y));
+		distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.c), z));
+		return _mm_add_ps(distance, _mm_set1_ps(plane.d));
+	}
+#endif
+
+	// Flags which of count instances from first are visible, 1 or 0 per instance. Every test is done for
+	// every lane with no early out, four lanes at a time where SSE2 is there and one at a time for the rest.
+	void TestBlock(const InstancePositions& positions, size_t first, int count, const CullView& view, uint8_t* visible)
+	{
+		const float* x = &positions.x[first];
+		const float* y = &positions.y[first];
+		const float* z = &positions.z[first];
+		const Plane* planes = view.frustum.planes;
+		const float margin = -view.boundingRadius;
+		const float maxDistanceSquared = view.maxDistance * view.maxDistance;
+
+		int i = 0;
+#if defined(PLANT_CULLING_SSE2)
+		const __m128 marginLanes = _mm_set1_ps(margin);
+		const __m128 maxDistanceLanes = _mm_set1_ps(maxDistanceSquared);
+		const __m128 eyeX = _mm_set1_ps(view.eye.x);
+		const __m128 eyeY = _mm_set1_ps(view.eye.y);
+		const __m128 eyeZ = _mm_set1_ps(view.eye.z);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 px = _mm_loadu_ps(x + i);
+			__m128 py = _mm_loadu_ps(y + i);
+			__m128 pz = _mm_loadu_ps(z + i);
+
+			__m128 inside = _mm_cmpge_ps(PlaneDistance(planes[0], px, py, pz), marginLanes);
+			for (int plane = 1; plane < 6; plane++)
+			{
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(PlaneDistance(planes[plane], px, py, pz), marginLanes));
+			}
+
+			__m128 dx = _mm_sub_ps(px, eyeX);
+			__m128 dy = _mm_sub_ps(py, eyeY);
+			__m128 dz = _mm_sub_ps(pz, eyeZ);
+			__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			inside = _mm_and_ps(inside, _mm_cmple_ps(distanceSquared, maxDistanceLanes));
+
+			int mask = _mm_movemask_ps(inside);
+			visible[i] = static_cast<uint8_t>(mask & 1);
+			visible[i + 1] = static_cast<uint8_t>((mask >> 1) & 1);
+			visible[i + 2] = static_cast<uint8_t>((mask >> 2) & 1);
+			visible[i + 3] = static_cast<uint8_t>((mask >> 3) & 1);
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			float px = x[i];
+			float py = y[i];
+			float pz = z[i];
+
+			bool inside = planes[0].a * px + planes[0].b * py + planes[0].c * pz + planes[0].d >= margin;
+			inside &= planes[1].a * px + planes[1].b * py + planes[1].c * pz + planes[1].d >= margin;
+			inside &= planes[2].a * px + planes[2].b * py + planes[2].c * pz + planes[2].d >= margin;
+			inside &= planes[3].a * px + planes[3].b * py + planes[3].c * pz + planes[3].d >= margin;
+			inside &= planes[4].a * px + planes[4].b * py + planes[4].c * pz + planes[4].d >= margin;
+			inside &= planes[5].a * px + planes[5].b * py + planes[5].c * pz + planes[5].d >= margin;
+
+			float dx = px - view.eye.x;
+			float dy = py - view.eye.y;
+			float dz = pz - view.eye.z;
+			inside &= dx * dx + dy * dy + dz * dz <= maxDistanceSquared;
+
+			visible[i] = inside ? 1 : 0;
+		}
+	}
+
+	// Culls instances [first, last) into output, which must have room for all of them
+	uint32_t CullRange(const InstancePositions& positions, size_t first, size_t last, const CullView& view, PlantInstance* output)
+	{
+		uint8_t visible[BlockSize];
+		uint32_t count = 0;
+
+		for (size_t block = first; block < last; block += BlockSize)
+		{
+			int blockCount = static_cast<int>(std::min<size_t>(BlockSize, last - block));
+			TestBlock(positions, block, blockCount, view, visible);
+
+			// Branch free compaction, each instance is written and kept only if visible
+			for (int i = 0; i < blockCount; i++)
+			{
+				output[count].position = float3(positions.x[block + i], positions.y[block + i], positions.z[block + i]);
+				output[count].species = positions.species[block + i];
+				count += visible[i];
+			}
+		}
+
+		return count;
+	}
+
+	// The obvious loop: one instance at a time, leaving as soon as a test fails
+	uint32_t CullScalar(const std::vector<PlantInstance>& instances, const CullView& view, PlantInstance* output)
+	{
+		uint32_t count = 0;
+		float maxDistanceSquared = view.maxDistance * view.maxDistance;
+		for (const PlantInstance& instance : instances)
+		{
+			const float3& p = instance.position;
+			float3 d = p - view.eye;
+			if (dot(d, d) > maxDistanceSquared)
+			{
+				continue;
+			}
+
+			bool inside = true;
+			for (const Plane& plane : view.frustum.planes)
+			{
+				if (plane.a * p.x + plane.b * p.y + plane.c * p.z + plane.d < -view.boundingRadius)
+				{
+					inside = false;
+					break;
+				}
+			}
+
+			if (inside)
+			{
+				output[count++] = instance;
+			}
+		}
+		return count;
+	}
+
+	// Row major look at and perspective matrices matching XMMatrixLookAtLH and XMMatrixPerspectiveFovLH
+	void LookAtPerspective(const float3& eye, const float3& at, float fovAngleY, float aspectRatio, float nearZ, float farZ, float result[16])
+	{
+		float3 zAxis = normalize(at - eye);
+		float3 xAxis = normalize(cross(float3(0.0f, 1.0f, 0.0f), zAxis));
+		float3 yAxis = cross(zAxis, xAxis);
+
+		float view[16] =
+		{
+			xAxis.x, yAxis.x, zAxis.x, 0.0f,
+			xAxis.y, yAxis.y, zAxis.y, 0.0f,
+			xAxis.z, yAxis.z, zAxis.z, 0.0f,
+			-dot(xAxis, eye), -dot(yAxis, eye), -dot(zAxis, eye), 1.0f,
+		};
+
+		float yScale = 1.0f / std::tan(0.5f * fovAngleY);
+		float range = farZ / (farZ - nearZ);
+		float projection[16] =
+		{
+			yScale / aspectRatio, 0.0f, 0.0f, 0.0f,
+			0.0f, yScale, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * nearZ, 0.0f,
+		};
+
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += view[row * 4 + k] * projection[k * 4 + column];
+				}
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+}
+
+InstancePositions PlantCulling::SplitPositions(const std::vector<PlantInstance>& instances)
+{
+	InstancePositions positions;
+	positions.x.resize(instances.size());
+	positions.y.resize(instances.size());
+	positions.z.resize(instances.size());
+	positions.species.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		positions.x[i] = instances[i].position.x;
+		positions.y[i] = instances[i].position.y;
+		positions.z[i] = instances[i].position.z;
+		positions.species[i] = instances[i].species;
+	}
+	return positions;
+}
+
+Frustum PlantCulling::ExtractFrustum(const float viewProjection[16])
+{
+	// Column j of the matrix gives clip coordinate j of a point
+	const float* m = viewProjection;
+	Frustum frustum;
+	frustum.planes[0] = NormalisePlane(m[3] + m[0], m[7] + m[4], m[11] + m[8], m[15] + m[12]);
+	frustum.planes[1] = NormalisePlane(m[3] - m[0], m[7] - m[4], m[11] - m[8], m[15] - m[12]);
+	frustum.planes[2] = NormalisePlane(m[3] + m[1], m[7] + m[5], m[11] + m[9], m[15] + m[13]);
+	frustum.planes[3] = NormalisePlane(m[3] - m[1], m[7] - m[5], m[11] - m[9], m[15] - m[13]);
+	frustum.planes[4] = NormalisePlane(m[2], m[6], m[10], m[14]);
+	frustum.planes[5] = NormalisePlane(m[3] - m[2], m[7] - m[6], m[11] - m[10], m[15] - m[14]);
+	return frustum;
+}
+
+uint32_t PlantCulling::Cull(const InstancePositions& positions, const CullView& view, PlantInstance* output, CullScratch& scratch, WorkerThreads::Pool& workers, int threadCount)
+{
+	size_t instanceCount = positions.x.size();
+
+	threadCount = WorkerThreads::CountFor(instanceCount, MinInstancesPerThread, threadCount);
+
+	// Whole blocks per thread so no block is split
+	size_t blocks = (instanceCount + BlockSize - 1) / BlockSize;
+	size_t blocksPerThread = (blocks + threadCount - 1) / threadCount;
+
+	if (scratch.threads.size() < static_cast<size_t>(threadCount))
+	{
+		scratch.threads.resize(threadCount);
+	}
+
+	std::vector<uint32_t> counts(threadCount);
+	workers.Run(threadCount, [&](int thread)
+	{
+		size_t first = std::min(thread * blocksPerThread * BlockSize, instanceCount);
+		size_t last = std::min(first + blocksPerThread * BlockSize, instanceCount);
+
+		std::vector<PlantInstance>& local = scratch.threads[thread];
+		if (local.size() < last - first)
+		{
+			local.resize(last - first);
+		}
+		counts[thread] = last > first ? CullRange(positions, first, last, view, local.data()) : 0;
+	});
+
+	// Each thread copies its survivors after those of the threads before it
+	std::vector<uint32_t> offsets(threadCount);
+	uint32_t visibleCount = 0;
+	for (int thread = 0; thread < threadCount; thread++)
+	{
+		offsets[thread] = visibleCount;
+		visibleCount += counts[thread];
+	}
+
+	workers.Run(threadCount, [&](int thread)
+	{
+		if (counts[thread] > 0)
+		{
+			std::memcpy(output + offsets[thread], scratch.threads[thread].data(), counts[thread] * sizeof(PlantInstance));
+		}
+	});
+
+	return visibleCount;
+}
+
+CullBenchmark PlantCulling::RunCullBenchmark(uint32_t instanceCount, int threadCount, int iterations)
+{
+	CullBenchmark result = {};
+	result.instanceCount = instanceCount;
+	result.threadCount = WorkerThreads::Resolve(threadCount);
+
+	// Plants spread over the terrain, seen from the scene's starting camera
+	std::vector<PlantInstance> instances(instanceCount);
+	unsigned int seed = 1;
+	auto random = [&seed](float lo, float hi)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return lo + (hi - lo) * static_cast<float>(seed >> 8) / 16777216.0f;
+	};
+	for (PlantInstance& instance : instances)
+	{
+		instance.position = float3(random(-50.0f, 50.0f), random(0.6f, 1.5f), random(-50.0f, 50.0f));
+		instance.species = PlantInstances::SpeciesAt(instance.position.x, instance.position.z);
+	}
+	InstancePositions positions = SplitPositions(instances);
+
+	float viewProjection[16];
+	LookAtPerspective(float3(0.0f, 5.0f, -10.0f), float3(0.0f, 5.0f, 1.0f), 70.0f * 3.14159265f / 180.0f, 16.0f / 9.0f, 0.01f, 1000.0f, viewProjection);
+
+	CullView view;
+	view.frustum = ExtractFrustum(viewProjection);
+	view.eye = float3(0.0f, 5.0f, -10.0f);
+	view.maxDistance = 40.0f;
+	view.boundingRadius = 1.0f;
+
+	std::vector<PlantInstance> expected(instanceCount), output(instanceCount);
+	CullScratch scratch;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		result.visibleCount = CullScalar(instances, view, expected.data());
+	}
+	result.scalarMilliseconds = MillisecondsSince(start) / iterations;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		CullRange(positions, 0, instanceCount, view, output.data());
+	}
+	result.blockMilliseconds = MillisecondsSince(start) / iterations;
+
+	// Warm the scratch buffers once so the timed runs do not allocate
+	WorkerThreads::Pool workers(threadCount);
+	Cull(positions, view, output.data(), scratch, workers, threadCount);
+	uint32_t threadedCount = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		threadedCount = Cull(positions, view, output.data(), scratch, workers, threadCount);
+	}
+	result.threadedMilliseconds = MillisecondsSince(start) / iterations;
+
+	result.mismatches = threadedCount > result.visibleCount ? threadedCount - result.visibleCount : result.visibleCount - threadedCount;
+	for (uint32_t i = 0; i < std::min(threadedCount, result.visibleCount); i++)
+	{
+		const float3& a = expected[i].position;
+		const float3& b = output[i].position;
+		if (a.x != b.x || a.y != b.y || a.z != b.z || expected[i].species != output[i].species)
+		{
+			result.mismatches++;
+		}
+	}
+
+	return result;
+}
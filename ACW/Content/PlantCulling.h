@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "PlantInstances.h"
+#include "WorkerThreads.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Per frame culling of plant instances against the view frustum and a distance cut off. Positions
+	// are kept as one array per axis and tested a block at a time, four to an SSE2 register, then the
+	// survivors are compacted into the instance buffer the plants are drawn from.
+	namespace PlantCulling
+	{
+		using ShaderMath::float3;
+		using PlantInstances::PlantInstance;
+
+		// Instances tested together, the unit work is split on between threads.
+		static const int BlockSize = 64;
+
+		// Below this many instances per thread the work is not worth handing out.
+		static const uint32_t MinInstancesPerThread = 1u << 16;
+
+		// ax + by + cz + d, positive on the inside.
+		struct Plane
+		{
+			float a, b, c, d;
+		};
+
+		struct Frustum
+		{
+			Plane planes[6];
+		};
+
+		struct CullView
+		{
+			Frustum frustum;
+			float3 eye;
+			float maxDistance;
+
+			// Radius of a sphere round each instance position that bounds what is drawn for it.
+			float boundingRadius;
+		};
+
+		// Instance positions split into one array per axis, and the species carried through to the output.
+		struct InstancePositions
+		{
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> z;
+			std::vector<uint32_t> species;
+		};
+
+		// Per thread output kept between frames so culling does not allocate.
+		struct CullScratch
+		{
+			std::vector<std::vector<PlantInstance>> threads;
+		};
+
+		struct CullBenchmark
+		{
+			uint32_t instanceCount;
+			uint32_t visibleCount;
+			int threadCount;
+
+			// One instance at a time from the array of structures, as a straightforward loop would.
+			double scalarMilliseconds;
+			// Blocks over the split positions on one thread, and across threadCount threads.
+			double blockMilliseconds;
+			double threadedMilliseconds;
+
+			// Instances whose result differs from the scalar loop, should be 0.
+			uint32_t mismatches;
+		};
+
+		InstancePositions SplitPositions(const std::vector<PlantInstance>& instances);
+
+		// Planes of the clip volume of a row vector (v * M) view projection matrix, z from 0 to 1 as in
+		// Direct3D. viewProjection is row major, as XMFLOAT4X4 stores it.
+		Frustum ExtractFrustum(const float viewProjection[16]);
+
+		// Writes the visible instances to output in their original order and returns how many there
+		// are. output needs room for every instance, it is written front to back in one pass so it can
+		// be a mapped dynamic buffer. The work is split threadCount ways over the threads of workers,
+		// threadCount 0 splitting it one way per hardware thread.
+		uint32_t Cull(const InstancePositions& positions, const CullView& view, PlantInstance* output, CullScratch& scratch, WorkerThreads::Pool& workers, int threadCount);
+
+		// Averages of iterations runs over instanceCount plants spread across the terrain.
+		CullBenchmark RunCullBenchmark(uint32_t instanceCount, int threadCount, int iterations);
+	}
+}
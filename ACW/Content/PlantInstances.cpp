@@ -0,0 +1,84 @@
+﻿#include "pch.h"
+#include "PlantInstances.h"
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+
+float PlantInstances::Hash(const float2& grid)
+{
+	float h = dot(grid, float2(127.1f, 311.7f));
+	return frac(std::sin(h) * 43758.5453123f);
+}
+
+float PlantInstances::Noise(const float2& p)
+{
+	float2 grid = floor(p);
+	float2 f = frac(p);
+	float2 uv = f * f * (float2(3.0f) - 2.0f * f);
+
+	float n1 = lerp(Hash(grid + float2(0.0f, 0.0f)), Hash(grid + float2(1.0f, 0.0f)), uv.x);
+	float n2 = lerp(Hash(grid + float2(0.0f, 1.0f)), Hash(grid + float2(1.0f, 1.0f)), uv.x);
+	return lerp(n1, n2, uv.y);
+}
+
+float PlantInstances::FractalNoise(float2 xy)
+{
+	float w = 0.7f;
+	float f = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		f += Noise(xy) * w;
+		w *= 0.5f;
+		xy *= 2.7f;
+	}
+	return f;
+}
+
+float PlantInstances::Noise(const float2& p, float2& gradient)
+{
+	float2 grid = floor(p);
+	float2 f = frac(p);
+	float2 uv = f * f * (float2(3.0f) - 2.0f * f);
+	float2 duv = 6.0f * f * (float2(1.0f) - f);
+
+	float a = Hash(grid + float2(0.0f, 0.0f));
+	float b = Hash(grid + float2(1.0f, 0.0f));
+	float c = Hash(grid + float2(0.0f, 1.0f));
+	float d = Hash(grid + float2(1.0f, 1.0f));
+
+	float corner = a - b - c + d;
+	gradient = float2(duv.x * ((b - a) + corner * uv.y), duv.y * ((c - a) + corner * uv.x));
+
+	// Same lerps as the value-only version so the heights match exactly
+	return lerp(lerp(a, b, uv.x), lerp(c, d, uv.x), uv.y);
+}
+
+float PlantInstances::FractalNoise(float2 xy, float2& gradient)
+{
+	float w = 0.7f;
+	float f = 0.0f;
+	float scale = 1.0f;
+	gradient = float2(0.0f, 0.0f);
+	for (int i = 0; i < 4; i++)
+	{
+		float2 g;
+		f += Noise(xy, g) * w;
+		gradient += g * (w * scale);
+		w *= 0.5f;
+		xy *= 2.7f;
+		scale *= 2.7f;
+	}
+	return f;
+}
+
+float PlantInstances::PlantHeight(float x, float z)
+{
+	return FractalNoise(float2(x, z)) + HeightOffset;
+}
+
+uint32_t PlantInstances::SpeciesAt(float x, float z)
+{
+	// Patches of 4 by 4 units share a species
+	uint32_t species = static_cast<uint32_t>(Hash(floor(float2(x, z) * 0.25f)) * SpeciesCount);
+	return species < SpeciesCount ? species : SpeciesCount - 1;
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include "ShaderMath.h"
+#include <cstdint>
+
+namespace ACW
+{
+	// Plant billboards placed once on the CPU at load (see PlantScatter). Each plant takes the height
+	// of the terrain noise GeometryCoralVertex.hlsl used to evaluate every frame.
+	namespace PlantInstances
+	{
+		using ShaderMath::float2;
+		using ShaderMath::float3;
+
+		// Added to the noise to give the height of a billboard's centre.
+		static const float HeightOffset = 0.2f;
+
+		// Plants at or below this height are under the water and never drawn.
+		static const float MinHeight = 0.6f;
+
+		// Sprites in the plant texture array, see PlantAtlas.
+		static const uint32_t SpeciesCount = 4;
+
+		// One per plant, laid out as the per instance POSITION and SPECIES of the plant input layout.
+		struct PlantInstance
+		{
+			float3 position;
+			uint32_t species;
+		};
+
+		float Hash(const float2& grid);
+		float Noise(const float2& p);
+		float FractalNoise(float2 xy);
+
+		// The same noise along with its analytic gradient, from the same four hashes per octave.
+		float Noise(const float2& p, float2& gradient);
+		float FractalNoise(float2 xy, float2& gradient);
+
+		// Height of the plant at a point on the terrain.
+		float PlantHeight(float x, float z);
+
+		// Species growing at a point, the same over patches a few units across.
+		uint32_t SpeciesAt(float x, float z);
+	}
+}
@@ -0,0 +1,401 @@
+﻿#include "pch.h"
+#include "PlantScatter.h"
+#include "WorkerThreads.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::PlantScatter;
+
+namespace
+{
+	const float TwoPi = 6.28318530718f;
+
+	// A cell holds the position of its one point, each axis quantised to 16 bits of the cell
+	const uint32_t EmptyCell = 0xffffffffu;
+	const float CellSteps = 65534.0f;
+	const float InverseCellSteps = 1.0f / CellSteps;
+
+	// Empty cells round the grid so the neighbourhood of an edge cell needs no bounds checks
+	const int GridBorder = 2;
+
+	// Cells that can hold a point within the radius of one in the centre cell, nearest first so a
+	// conflict is usually found in the first few. The corners of the 5x5 block are a whole radius away.
+	const int NeighbourCount = 21;
+	const int Neighbours[NeighbourCount][2] =
+	{
+		{ 0, 0 },
+		{ -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+		{ -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 },
+		{ -2, 0 }, { 2, 0 }, { 0, -2 }, { 0, 2 },
+		{ -2, -1 }, { 2, -1 }, { -2, 1 }, { 2, 1 }, { -1, -2 }, { 1, -2 }, { -1, 2 }, { 1, 2 },
+	};
+
+	// Candidates land this fraction outside the radius, just enough to clear the point they spread from
+	const float CandidateMargin = 1e-3f;
+
+	class Random
+	{
+	public:
+		explicit Random(uint32_t seed) : mState(seed ? seed : 1u) {}
+
+		// Uniform in [0, 1)
+		float Next()
+		{
+			mState ^= mState << 13;
+			mState ^= mState >> 17;
+			mState ^= mState << 5;
+			return static_cast<float>(mState >> 8) / 16777216.0f;
+		}
+
+	private:
+		uint32_t mState;
+	};
+
+	uint32_t HashTile(uint32_t seed, uint32_t tile)
+	{
+		uint32_t h = seed ^ (tile * 0x9e3779b9u);
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// Spatial hash over the scatter area. Cells are radius / sqrt(2) wide so a cell can hold at most one
+	// point, and the neighbours within the radius of a point are in the 5x5 cells around it.
+	struct Grid
+	{
+		float2 origin;
+		float cellSize;
+		float inverseCellSize;
+		int width;
+		int height;
+		int stride;
+		std::vector<uint32_t> cells;
+
+		size_t Index(int cx, int cz) const
+		{
+			return static_cast<size_t>(cz + GridBorder) * stride + cx + GridBorder;
+		}
+
+		float2 Decode(int cx, int cz, uint32_t packed) const
+		{
+			float fx = static_cast<float>(packed & 0xffffu) * InverseCellSteps;
+			float fz = static_cast<float>(packed >> 16) * InverseCellSteps;
+			return float2(origin.x + (cx + fx) * cellSize, origin.y + (cz + fz) * cellSize);
+		}
+	};
+
+	struct TileOutput
+	{
+		std::vector<PlantInstances::PlantInstance> instances;
+		uint32_t pointCount;
+		uint32_t heightRejected;
+		uint32_t slopeRejected;
+	};
+
+	class TileScatter
+	{
+	public:
+		TileScatter(const ScatterSettings& settings, Grid& grid, std::vector<float2>& active) :
+			mSettings(settings), mGrid(grid), mActive(active), mRandom(1u)
+		{
+			float step = TwoPi / static_cast<float>(settings.attempts);
+			mStepCos = std::cos(step);
+			mStepSin = std::sin(step);
+
+			for (int i = 0; i < NeighbourCount; i++)
+			{
+				mNeighbourOffsets[i] = Neighbours[i][1] * grid.stride + Neighbours[i][0];
+			}
+		}
+
+		void Run(int tx, int tz, uint32_t tileIndex, TileOutput& output)
+		{
+			mOutput = &output;
+			mRandom = Random(HashTile(mSettings.seed, tileIndex));
+
+			mCellMinX = tx * mSettings.tileCells;
+			mCellMinZ = tz * mSettings.tileCells;
+			mCellMaxX = std::min(mCellMinX + mSettings.tileCells, mGrid.width);
+			mCellMaxZ = std::min(mCellMinZ + mSettings.tileCells, mGrid.height);
+
+			float2 tileMin(mGrid.origin.x + mCellMinX * mGrid.cellSize, mGrid.origin.y + mCellMinZ * mGrid.cellSize);
+			float2 tileMax(std::min(mGrid.origin.x + mCellMaxX * mGrid.cellSize, mSettings.areaMax.x),
+				std::min(mGrid.origin.y + mCellMaxZ * mGrid.cellSize, mSettings.areaMax.y));
+
+			// Darts restart the spread in any gap the last one could not reach, such as
+			// pockets closed off by points of neighbouring tiles
+			for (int dart = 0; dart < mSettings.attempts; dart++)
+			{
+				float2 p(tileMin.x + (tileMax.x - tileMin.x) * mRandom.Next(), tileMin.y + (tileMax.y - tileMin.y) * mRandom.Next());
+				if (!TryPlace(p))
+				{
+					continue;
+				}
+
+				while (!mActive.empty())
+				{
+					size_t pick = static_cast<size_t>(mRandom.Next() * mActive.size());
+					float2 centre = mActive[pick];
+
+					// Walk round the circle by rotating the offset rather than calling sin and cos per candidate
+					float angle = TwoPi * mRandom.Next();
+					float2 offset = (mSettings.radius * (1.0f + CandidateMargin)) * float2(std::cos(angle), std::sin(angle));
+
+					bool placed = false;
+					for (int i = 0; i < mSettings.attempts && !placed; i++)
+					{
+						placed = TryPlace(centre + offset);
+						offset = float2(offset.x * mStepCos - offset.y * mStepSin, offset.x * mStepSin + offset.y * mStepCos);
+					}
+
+					if (!placed)
+					{
+						mActive[pick] = mActive.back();
+						mActive.pop_back();
+					}
+				}
+			}
+		}
+
+	private:
+		bool TryPlace(const float2& candidate)
+		{
+			if (candidate.x < mSettings.areaMin.x || candidate.y < mSettings.areaMin.y ||
+				candidate.x >= mSettings.areaMax.x || candidate.y >= mSettings.areaMax.y)
+			{
+				return false;
+			}
+
+			// Points outside the tile belong to its neighbours
+			float gx = (candidate.x - mGrid.origin.x) * mGrid.inverseCellSize;
+			float gz = (candidate.y - mGrid.origin.y) * mGrid.inverseCellSize;
+			int cx = static_cast<int>(gx);
+			int cz = static_cast<int>(gz);
+			if (cx < mCellMinX || cz < mCellMinZ || cx >= mCellMaxX || cz >= mCellMaxZ)
+			{
+				return false;
+			}
+
+			// A taken cell always conflicts, most candidates stop here
+			size_t index = mGrid.Index(cx, cz);
+			if (mGrid.cells[index] != EmptyCell)
+			{
+				return false;
+			}
+
+			// Quantise first so the spacing is checked on the position that is stored
+			uint32_t qx = static_cast<uint32_t>(std::min((gx - cx) * CellSteps + 0.5f, CellSteps));
+			uint32_t qz = static_cast<uint32_t>(std::min((gz - cz) * CellSteps + 0.5f, CellSteps));
+			uint32_t packed = qx | (qz << 16);
+			float2 p = mGrid.Decode(cx, cz, packed);
+
+			float radiusSquared = mSettings.radius * mSettings.radius;
+			for (int i = 1; i < NeighbourCount; i++)
+			{
+				uint32_t neighbour = mGrid.cells[index + mNeighbourOffsets[i]];
+				if (neighbour == EmptyCell)
+				{
+					continue;
+				}
+
+				float2 d = mGrid.Decode(cx + Neighbours[i][0], cz + Neighbours[i][1], neighbour) - p;
+				if (dot(d, d) < radiusSquared)
+				{
+					return false;
+				}
+			}
+
+			mGrid.cells[index] = packed;
+			mActive.push_back(p);
+			mOutput->pointCount++;
+
+			// Thinned points still hold their cell, so density falls off instead of packing the survivors closer
+			float2 gradient;
+			float y = PlantInstances::FractalNoise(p, gradient) + PlantInstances::HeightOffset;
+			if (y <= mSettings.minHeight || y >= mSettings.maxHeight)
+			{
+				mOutput->heightRejected++;
+				return true;
+			}
+
+			float slope = length(gradient);
+			float density = saturate((mSettings.maxSlope - slope) / (mSettings.maxSlope - mSettings.fullDensitySlope));
+			if (mRandom.Next() >= density)
+			{
+				mOutput->slopeRejected++;
+				return true;
+			}
+
+			PlantInstances::PlantInstance instance;
+			instance.position = float3(p.x, y, p.y);
+			instance.species = PlantInstances::SpeciesAt(p.x, p.y);
+			mOutput->instances.push_back(instance);
+			return true;
+		}
+
+		const ScatterSettings& mSettings;
+		Grid& mGrid;
+		std::vector<float2>& mActive;
+		TileOutput* mOutput;
+		Random mRandom;
+		float mStepCos;
+		float mStepSin;
+		ptrdiff_t mNeighbourOffsets[NeighbourCount];
+		int mCellMinX;
+		int mCellMinZ;
+		int mCellMaxX;
+		int mCellMaxZ;
+	};
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+ScatterSettings PlantScatter::DefaultSettings()
+{
+	ScatterSettings settings;
+	settings.areaMin = float2(-20.0f, -20.0f);
+	settings.areaMax = float2(20.0f, 20.0f);
+	settings.radius = 1.0f;
+	settings.minHeight = PlantInstances::MinHeight;
+	settings.maxHeight = 100.0f;
+	settings.fullDensitySlope = 1.5f;
+	settings.maxSlope = 3.5f;
+	settings.tileCells = 32;
+	settings.attempts = 16;
+	settings.seed = 1u;
+	settings.threadCount = 0;
+	return settings;
+}
+
+float PlantScatter::TerrainSlope(float x, float z)
+{
+	float2 gradient;
+	PlantInstances::FractalNoise(float2(x, z), gradient);
+	return length(gradient);
+}
+
+ScatterResult PlantScatter::Scatter(const ScatterSettings& settings)
+{
+	if (settings.radius <= 0.0f || settings.tileCells < 2)
+	{
+		throw std::invalid_argument("scatter needs a positive radius and tiles of at least 2 cells");
+	}
+
+	Grid grid;
+	grid.origin = settings.areaMin;
+	grid.cellSize = settings.radius / std::sqrt(2.0f);
+	grid.inverseCellSize = 1.0f / grid.cellSize;
+	grid.width = std::max(static_cast<int>(std::ceil((settings.areaMax.x - settings.areaMin.x) / grid.cellSize)), 1);
+	grid.height = std::max(static_cast<int>(std::ceil((settings.areaMax.y - settings.areaMin.y) / grid.cellSize)), 1);
+	grid.stride = grid.width + 2 * GridBorder;
+	grid.cells.assign(static_cast<size_t>(grid.stride) * (grid.height + 2 * GridBorder), EmptyCell);
+
+	int tilesX = (grid.width + settings.tileCells - 1) / settings.tileCells;
+	int tilesZ = (grid.height + settings.tileCells - 1) / settings.tileCells;
+	std::vector<TileOutput> tiles(static_cast<size_t>(tilesX) * tilesZ);
+
+	int threadCount = WorkerThreads::Resolve(settings.threadCount);
+	std::vector<std::vector<float2>> active(threadCount);
+
+	// Tiles of one checkerboard phase are a whole tile apart and never read or write each other's cells
+	for (int phase = 0; phase < 4; phase++)
+	{
+		std::vector<int> phaseTiles;
+		for (int tz = phase / 2; tz < tilesZ; tz += 2)
+		{
+			for (int tx = phase % 2; tx < tilesX; tx += 2)
+			{
+				phaseTiles.push_back(tz * tilesX + tx);
+			}
+		}
+
+		std::atomic<size_t> next(0);
+		WorkerThreads::Run(threadCount, [&](int thread)
+		{
+			TileScatter scatter(settings, grid, active[thread]);
+			for (size_t i = next++; i < phaseTiles.size(); i = next++)
+			{
+				int tile = phaseTiles[i];
+				scatter.Run(tile % tilesX, tile / tilesX, static_cast<uint32_t>(tile), tiles[tile]);
+			}
+		});
+	}
+
+	ScatterResult result;
+	result.pointCount = 0;
+	result.heightRejected = 0;
+	result.slopeRejected = 0;
+	result.tileCount = static_cast<uint32_t>(tiles.size());
+
+	size_t instanceCount = 0;
+	size_t peakBytes = grid.cells.size() * sizeof(uint32_t);
+	for (const TileOutput& tile : tiles)
+	{
+		instanceCount += tile.instances.size();
+		peakBytes += tile.instances.capacity() * sizeof(PlantInstances::PlantInstance);
+		result.pointCount += tile.pointCount;
+		result.heightRejected += tile.heightRejected;
+		result.slopeRejected += tile.slopeRejected;
+	}
+	for (const std::vector<float2>& scratch : active)
+	{
+		peakBytes += scratch.capacity() * sizeof(float2);
+	}
+
+	// Instances are counted and drawn with 32-bit values
+	if (instanceCount > 0xffffffffu)
+	{
+		throw std::length_error("scatter placed more than 2^32 - 1 plants");
+	}
+
+	result.instances.reserve(instanceCount);
+	for (TileOutput& tile : tiles)
+	{
+		result.instances.insert(result.instances.end(), tile.instances.begin(), tile.instances.end());
+		std::vector<PlantInstances::PlantInstance>().swap(tile.instances);
+	}
+	result.peakBytes = peakBytes + instanceCount * sizeof(PlantInstances::PlantInstance);
+
+	return result;
+}
+
+ScatterBenchmark PlantScatter::RunScatterBenchmark(uint32_t targetInstances, int threadCount)
+{
+	ScatterBenchmark result = {};
+	result.targetInstances = targetInstances;
+
+	// The whole terrain quad, at a radius from a small pilot run of the same rules
+	ScatterSettings settings = DefaultSettings();
+	settings.areaMin = float2(-50.0f, -50.0f);
+	settings.areaMax = float2(50.0f, 50.0f);
+	settings.threadCount = threadCount;
+
+	settings.radius = 0.25f;
+	ScatterResult pilot = Scatter(settings);
+	settings.radius *= std::sqrt(static_cast<float>(pilot.instances.size()) / static_cast<float>(targetInstances));
+
+	auto start = std::chrono::steady_clock::now();
+	ScatterResult scatter = Scatter(settings);
+	result.milliseconds = MillisecondsSince(start);
+
+	result.instanceCount = static_cast<uint32_t>(scatter.instances.size());
+	result.pointCount = scatter.pointCount;
+	result.radius = settings.radius;
+	result.threadCount = WorkerThreads::Resolve(settings.threadCount);
+	result.instancesPerSecond = result.instanceCount / (result.milliseconds / 1000.0);
+	result.retainedBytesPerInstance = static_cast<float>(sizeof(PlantInstances::PlantInstance));
+	result.peakBytesPerInstance = static_cast<float>(scatter.peakBytes) / std::max(result.instanceCount, 1u);
+
+	return result;
+}
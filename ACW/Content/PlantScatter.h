@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "PlantInstances.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Blue noise placement of plant instances over the terrain. Points are laid down by Poisson disk
+	// sampling, no two closer than the radius, in square tiles of a spatial hash grid. Tiles two apart
+	// never touch the same cells, so each of the four phases of the tile checkerboard runs in parallel.
+	// Height and slope rules then thin the points, which keeps the spacing wherever plants survive.
+	namespace PlantScatter
+	{
+		using ShaderMath::float2;
+
+		struct ScatterSettings
+		{
+			float2 areaMin;
+			float2 areaMax;
+
+			// No two plants are closer than this.
+			float radius;
+
+			// Plant heights outside (minHeight, maxHeight) are dropped, minHeight is the water.
+			float minHeight;
+			float maxHeight;
+
+			// Every point on terrain up to fullDensitySlope keeps its plant, none past maxSlope,
+			// with the chance falling linearly between.
+			float fullDensitySlope;
+			float maxSlope;
+
+			// Width of a tile in grid cells, at least 2 so that tiles of one phase are a radius apart.
+			int tileCells;
+
+			// Candidates tried around each point before it stops spreading, and darts thrown per tile.
+			// Candidates are evenly spaced round a circle just outside the radius from a random start,
+			// which packs closer than random ones and needs only one sin and cos per point tried.
+			int attempts;
+
+			uint32_t seed;
+
+			// 0 uses one thread per hardware thread.
+			int threadCount;
+		};
+
+		struct ScatterResult
+		{
+			std::vector<PlantInstances::PlantInstance> instances;
+
+			// Points the disk sampling placed, and how many the height and slope rules dropped.
+			uint32_t pointCount;
+			uint32_t heightRejected;
+			uint32_t slopeRejected;
+
+			uint32_t tileCount;
+
+			// Grid, tile buffers and output together at their largest.
+			size_t peakBytes;
+		};
+
+		// Placement and timings for roughly targetInstances plants over the whole terrain.
+		struct ScatterBenchmark
+		{
+			uint32_t targetInstances;
+			uint32_t instanceCount;
+			uint32_t pointCount;
+			float radius;
+			int threadCount;
+
+			double milliseconds;
+			double instancesPerSecond;
+
+			// Bytes kept per instance once placed, and at the peak of placement.
+			float retainedBytesPerInstance;
+			float peakBytesPerInstance;
+		};
+
+		// The plants of the scene, over the area the old integer grid covered.
+		ScatterSettings DefaultSettings();
+
+		// Rise over run of the terrain, from the analytic gradient of its noise.
+		float TerrainSlope(float x, float z);
+
+		ScatterResult Scatter(const ScatterSettings& settings);
+
+		ScatterBenchmark RunScatterBenchmark(uint32_t targetInstances, int threadCount);
+	}
+}
@@ -0,0 +1,244 @@
+﻿#include "pch.h"
+#include "PlantSorting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::PlantSorting;
+
+namespace
+{
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Largest key goes to the nearest instance so ascending keys are back to front
+	uint32_t DepthKey(const float3& position, const SortView& view, float keyScale)
+	{
+		float depth = dot(position - view.eye, view.forward);
+		float scaled = depth * keyScale;
+		scaled = scaled < 0.0f ? 0.0f : (scaled > static_cast<float>((1 << KeyBits) - 1) ? static_cast<float>((1 << KeyBits) - 1) : scaled);
+		return ((1u << KeyBits) - 1) - static_cast<uint32_t>(scaled);
+	}
+
+	// First and one past the last element of thread's share of count
+	void ThreadRange(uint32_t count, int threadCount, int thread, uint32_t& first, uint32_t& last)
+	{
+		uint64_t share = (static_cast<uint64_t>(count) + threadCount - 1) / threadCount;
+		first = static_cast<uint32_t>(std::min<uint64_t>(share * thread, count));
+		last = static_cast<uint32_t>(std::min<uint64_t>(share * (thread + 1), count));
+	}
+
+	// Turns per thread digit counts into where each thread writes each digit. Threads take their digits
+	// in thread order, which keeps the sort stable.
+	void CountsToOffsets(std::vector<uint32_t>& histograms, int threadCount)
+	{
+		uint32_t offset = 0;
+		for (int digit = 0; digit < DigitCount; digit++)
+		{
+			for (int thread = 0; thread < threadCount; thread++)
+			{
+				uint32_t& slot = histograms[thread * DigitCount + digit];
+				uint32_t digitCount = slot;
+				slot = offset;
+				offset += digitCount;
+			}
+		}
+	}
+
+	// Buckets this small are put in order by insertion rather than a counting pass of their own
+	const uint32_t InsertionSortLimit = 64;
+
+	// Orders count keys from one bucket on the low digit into destination, keeping the order of equal keys
+	void SortBucket(const SortKey* source, uint32_t count, SortKey* destination)
+	{
+		if (count <= InsertionSortLimit)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				SortKey key = source[i];
+				uint32_t j = i;
+				for (; j > 0 && destination[j - 1].key > key.key; j--)
+				{
+					destination[j] = destination[j - 1];
+				}
+				destination[j] = key;
+			}
+			return;
+		}
+
+		uint32_t offsets[DigitCount] = {};
+		for (uint32_t i = 0; i < count; i++)
+		{
+			offsets[source[i].key & (DigitCount - 1)]++;
+		}
+		uint32_t offset = 0;
+		for (uint32_t& slot : offsets)
+		{
+			uint32_t digitCount = slot;
+			slot = offset;
+			offset += digitCount;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			destination[offsets[source[i].key & (DigitCount - 1)]++] = source[i];
+		}
+	}
+}
+
+void PlantSorting::SortBackToFront(const PlantInstance* instances, uint32_t count, const SortView& view, PlantInstance* output, SortScratch& scratch, WorkerThreads::Pool& workers, int threadCount)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	threadCount = WorkerThreads::CountFor(count, MinInstancesPerThread, threadCount);
+	if (scratch.buckets.size() < count)
+	{
+		scratch.buckets.resize(count);
+	}
+	if (scratch.threads.size() < static_cast<size_t>(threadCount))
+	{
+		scratch.threads.resize(threadCount);
+	}
+	scratch.histograms.resize(static_cast<size_t>(threadCount) * DigitCount);
+
+	SortKey* buckets = scratch.buckets.data();
+	float keyScale = view.maxDepth > 0.0f ? static_cast<float>((1 << KeyBits) - 1) / view.maxDepth : 0.0f;
+
+	// Count the high digit of each thread's share of the instances
+	workers.Run(threadCount, [&](int thread)
+	{
+		uint32_t first, last;
+		ThreadRange(count, threadCount, thread, first, last);
+		uint32_t* counts = &scratch.histograms[thread * DigitCount];
+		std::fill(counts, counts + DigitCount, 0u);
+		for (uint32_t i = first; i < last; i++)
+		{
+			counts[DepthKey(instances[i].position, view, keyScale) >> DigitBits]++;
+		}
+	});
+
+	// Scatter the same shares into one bucket per high digit, each thread writing only to its own slots in each,
+	// so every bucket holds its instances in their original order. The key is cheaper to work out again than to
+	// write out and read back.
+	CountsToOffsets(scratch.histograms, threadCount);
+	workers.Run(threadCount, [&](int thread)
+	{
+		uint32_t first, last;
+		ThreadRange(count, threadCount, thread, first, last);
+		uint32_t* offsets = &scratch.histograms[thread * DigitCount];
+		for (uint32_t i = first; i < last; i++)
+		{
+			uint32_t key = DepthKey(instances[i].position, view, keyScale);
+			SortKey& bucketed = buckets[offsets[key >> DigitBits]++];
+			bucketed.key = key;
+			bucketed.instance = instances[i];
+		}
+	});
+
+	// The last thread's offsets were left at the end of each bucket
+	const uint32_t* bucketEnds = &scratch.histograms[(threadCount - 1) * DigitCount];
+
+	// Each thread takes the buckets starting in its share of the instances and orders each on the low digit into
+	// a buffer of its own, which stays in cache, then copies it out. No two threads touch the same bucket, and the
+	// output is written sequentially.
+	workers.Run(threadCount, [&](int thread)
+	{
+		uint32_t first, last;
+		ThreadRange(count, threadCount, thread, first, last);
+		std::vector<SortKey>& ordered = scratch.threads[thread];
+		uint32_t bucketStart = 0;
+		for (int digit = 0; digit < DigitCount; digit++)
+		{
+			uint32_t bucketEnd = bucketEnds[digit];
+			if (bucketStart >= first && bucketStart < last && bucketEnd > bucketStart)
+			{
+				uint32_t bucketCount = bucketEnd - bucketStart;
+				if (ordered.size() < bucketCount)
+				{
+					ordered.resize(bucketCount);
+				}
+				SortBucket(buckets + bucketStart, bucketCount, ordered.data());
+				for (uint32_t i = 0; i < bucketCount; i++)
+				{
+					output[bucketStart + i] = ordered[i].instance;
+				}
+			}
+			bucketStart = bucketEnd;
+		}
+	});
+}
+
+SortBenchmark PlantSorting::RunSortBenchmark(uint32_t instanceCount, int threadCount, int iterations)
+{
+	SortBenchmark result = {};
+	result.instanceCount = instanceCount;
+	result.threadCount = WorkerThreads::CountFor(instanceCount, MinInstancesPerThread, threadCount);
+
+	// Plants in front of a camera at the origin looking down z, as culling would leave them
+	std::vector<PlantInstance> instances(instanceCount);
+	unsigned int seed = 1;
+	auto random = [&seed](float lo, float hi)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return lo + (hi - lo) * static_cast<float>(seed >> 8) / 16777216.0f;
+	};
+	for (PlantInstance& instance : instances)
+	{
+		instance.position = float3(random(-20.0f, 20.0f), random(0.6f, 1.5f), random(0.0f, 40.0f));
+		instance.species = PlantInstances::SpeciesAt(instance.position.x, instance.position.z);
+	}
+
+	SortView view;
+	view.eye = float3(0.0f, 5.0f, 0.0f);
+	view.forward = float3(0.0f, 0.0f, 1.0f);
+	view.maxDepth = 41.0f;
+
+	std::vector<PlantInstance> expected, output(instanceCount);
+	SortScratch scratch;
+
+	auto depthOf = [&view](const PlantInstance& instance) { return dot(instance.position - view.eye, view.forward); };
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		expected = instances;
+		std::stable_sort(expected.begin(), expected.end(), [&](const PlantInstance& a, const PlantInstance& b) { return depthOf(a) > depthOf(b); });
+	}
+	result.comparisonMilliseconds = MillisecondsSince(start) / iterations;
+
+	// Warm the scratch buffers once so the timed runs do not allocate
+	WorkerThreads::Pool workers(threadCount);
+	SortBackToFront(instances.data(), instanceCount, view, output.data(), scratch, workers, 1);
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		SortBackToFront(instances.data(), instanceCount, view, output.data(), scratch, workers, 1);
+	}
+	result.radixMilliseconds = MillisecondsSince(start) / iterations;
+
+	SortBackToFront(instances.data(), instanceCount, view, output.data(), scratch, workers, threadCount);
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		SortBackToFront(instances.data(), instanceCount, view, output.data(), scratch, workers, threadCount);
+	}
+	result.threadedMilliseconds = MillisecondsSince(start) / iterations;
+
+	// Neighbours may only be out of depth order by less than one key step
+	float keyStep = view.maxDepth / static_cast<float>((1 << KeyBits) - 1);
+	for (uint32_t i = 1; i < instanceCount; i++)
+	{
+		if (depthOf(output[i]) > depthOf(output[i - 1]) + keyStep)
+		{
+			result.misordered++;
+		}
+	}
+
+	return result;
+}
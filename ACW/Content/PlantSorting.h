@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include "PlantInstances.h"
+#include "WorkerThreads.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Back to front ordering of the plant billboards for alpha blending. Each instance's view depth is
+	// quantised to a 16 bit key. A counting pass splits the instances into buckets on the high 8 bits,
+	// each thread counting and scattering its own share, then each bucket is put in order on the low 8
+	// bits by the thread that owns it, where it fits in cache. Split across threads for large counts.
+	namespace PlantSorting
+	{
+		using ShaderMath::float3;
+		using PlantInstances::PlantInstance;
+
+		static const int KeyBits = 16;
+		static const int DigitBits = 8;
+		static const int DigitCount = 1 << DigitBits;
+
+		// Below this many instances per thread the work is not worth handing out.
+		static const uint32_t MinInstancesPerThread = 1u << 15;
+
+		struct SortView
+		{
+			float3 eye;
+			// Unit view direction, depth is measured along it from the eye.
+			float3 forward;
+			// Depths from 0 to maxDepth get their own keys, anything further shares the furthest.
+			float maxDepth;
+		};
+
+		// An instance and its key, moved through the sort together so the output is not gathered from all over
+		// the input.
+		struct SortKey
+		{
+			uint32_t key;
+			PlantInstance instance;
+		};
+
+		// Buffers kept between frames so sorting does not allocate: the instances split into buckets on the high
+		// digit, the bucket each thread is ordering, and each thread's digit counts.
+		struct SortScratch
+		{
+			std::vector<SortKey> buckets;
+			std::vector<std::vector<SortKey>> threads;
+			std::vector<uint32_t> histograms;
+		};
+
+		struct SortBenchmark
+		{
+			uint32_t instanceCount;
+			int threadCount;
+
+			// std::stable_sort on the float depths, for comparison.
+			double comparisonMilliseconds;
+			double radixMilliseconds;
+			double threadedMilliseconds;
+
+			// Places where the order differs from the comparison sort by more than the key precision, should be 0.
+			uint32_t misordered;
+		};
+
+		// Writes the count instances to output furthest first. Instances with the same key keep their order.
+		// output is written front to back in one pass so it can be a mapped dynamic buffer. The work is split
+		// threadCount ways over the threads of workers, threadCount 0 splitting it one way per hardware thread.
+		void SortBackToFront(const PlantInstance* instances, uint32_t count, const SortView& view, PlantInstance* output, SortScratch& scratch, WorkerThreads::Pool& workers, int threadCount);
+
+		// Averages of iterations sorts of instanceCount plants spread over the view.
+		SortBenchmark RunSortBenchmark(uint32_t instanceCount, int threadCount, int iterations);
+	}
+}
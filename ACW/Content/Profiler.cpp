@@ -0,0 +1,287 @@
+﻿#include "pch.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+
+using namespace ACW;
+using namespace ACW::Profiler;
+
+namespace
+{
+	// An event as it lies in a ring. sequence is odd while the event is written, and even once it is, counting up
+	// with each event written to the slot, so a reader can tell an event it copied whole from one written over as it
+	// copied. Fields are atomics written relaxed so copying one as it changes is not a race.
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> begin;
+		std::atomic<uint64_t> end;
+		std::atomic<uint32_t> frame;
+		std::atomic<uint32_t> track;
+	};
+
+	struct ThreadRing
+	{
+		std::atomic<bool> owned;
+		std::atomic<const char*> name;
+		// Events ever written, the next going in slot head % RingCapacity.
+		std::atomic<uint64_t> head;
+		Slot slots[RingCapacity];
+	};
+
+	// Rings are made as threads first need them and never freed, so readers can hold onto them.
+	std::atomic<ThreadRing*> gRings[MaxThreads];
+	std::atomic<uint32_t> gFrame(0);
+
+	// Hands the calling thread's ring back when the thread exits.
+	struct RingOwner
+	{
+		ThreadRing* ring;
+		bool full;
+
+		RingOwner() : ring(nullptr), full(false) {}
+		~RingOwner()
+		{
+			if (ring)
+			{
+				ring->owned.store(false, std::memory_order_release);
+			}
+		}
+	};
+
+	thread_local RingOwner tOwner;
+
+	ThreadRing* TakeRing()
+	{
+		for (int i = 0; i < MaxThreads; i++)
+		{
+			ThreadRing* ring = gRings[i].load(std::memory_order_acquire);
+			if (!ring)
+			{
+				std::unique_ptr<ThreadRing> made(new ThreadRing());
+				made->owned.store(true, std::memory_order_relaxed);
+				made->name.store(nullptr, std::memory_order_relaxed);
+				made->head.store(0, std::memory_order_relaxed);
+				for (Slot& slot : made->slots)
+				{
+					slot.sequence.store(0, std::memory_order_relaxed);
+				}
+
+				if (gRings[i].compare_exchange_strong(ring, made.get(), std::memory_order_acq_rel))
+				{
+					return made.release();
+				}
+				// Another thread made this one first, and ring is now it
+			}
+
+			bool free = false;
+			if (ring->owned.compare_exchange_strong(free, true, std::memory_order_acquire))
+			{
+				return ring;
+			}
+		}
+		return nullptr;
+	}
+
+	ThreadRing* CallingThreadRing()
+	{
+		if (!tOwner.ring && !tOwner.full)
+		{
+			tOwner.ring = TakeRing();
+			tOwner.full = !tOwner.ring;
+		}
+		return tOwner.ring;
+	}
+
+	void WriteEvent(ThreadRing& ring, const char* name, uint64_t begin, uint64_t end, uint32_t frame, Track track)
+	{
+		uint64_t index = ring.head.load(std::memory_order_relaxed);
+		Slot& slot = ring.slots[index % RingCapacity];
+
+		slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.begin.store(begin, std::memory_order_relaxed);
+		slot.end.store(end, std::memory_order_relaxed);
+		slot.frame.store(frame, std::memory_order_relaxed);
+		slot.track.store(static_cast<uint32_t>(track), std::memory_order_relaxed);
+		slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+		ring.head.store(index + 1, std::memory_order_release);
+	}
+
+	// False when the slot no longer holds event index, or was written over while it was copied.
+	bool ReadEvent(const Slot& slot, uint64_t index, Event& event)
+	{
+		uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != 2 * index + 2)
+		{
+			return false;
+		}
+
+		event.name = slot.name.load(std::memory_order_relaxed);
+		event.beginNanoseconds = slot.begin.load(std::memory_order_relaxed);
+		event.endNanoseconds = slot.end.load(std::memory_order_relaxed);
+		event.frame = slot.frame.load(std::memory_order_relaxed);
+		event.track = static_cast<Track>(slot.track.load(std::memory_order_relaxed));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == sequence;
+	}
+
+	void WriteJsonString(std::ostream& out, const char* text)
+	{
+		out << '"';
+		for (const char* c = text ? text : ""; *c; c++)
+		{
+			unsigned char character = static_cast<unsigned char>(*c);
+			if (character == '"' || character == '\\')
+			{
+				out << '\\' << *c;
+			}
+			else if (character < 0x20)
+			{
+				static const char hex[] = "0123456789abcdef";
+				out << "\\u00" << hex[character >> 4] << hex[character & 15];
+			}
+			else
+			{
+				out << *c;
+			}
+		}
+		out << '"';
+	}
+
+	// Process ids of the trace.
+	const int CpuProcess = 1;
+	const int GpuProcess = 2;
+}
+
+void Profiler::BeginFrame()
+{
+	gFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t Profiler::CurrentFrame()
+{
+	return gFrame.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadRing* ring = CallingThreadRing();
+	if (ring)
+	{
+		ring->name.store(name, std::memory_order_release);
+	}
+}
+
+void Profiler::Record(const char* name, uint64_t beginNanoseconds, uint64_t endNanoseconds, uint32_t frame, Track track)
+{
+	ThreadRing* ring = CallingThreadRing();
+	if (ring)
+	{
+		WriteEvent(*ring, name, beginNanoseconds, endNanoseconds, frame, track);
+	}
+}
+
+void Profiler::RecordGpuFrame(uint32_t frame, uint64_t cpuStartNanoseconds, uint64_t frequency, uint64_t startTick, const GpuScope* scopes, int scopeCount)
+{
+	if (frequency == 0)
+	{
+		return;
+	}
+
+	// Whole seconds and the remainder apart, so ticks times a billion cannot overflow
+	auto toNanoseconds = [frequency, startTick](uint64_t tick)
+	{
+		uint64_t ticks = tick > startTick ? tick - startTick : 0;
+		return (ticks / frequency) * 1000000000ull + (ticks % frequency) * 1000000000ull / frequency;
+	};
+
+	for (int i = 0; i < scopeCount; i++)
+	{
+		Record(scopes[i].name, cpuStartNanoseconds + toNanoseconds(scopes[i].begin), cpuStartNanoseconds + toNanoseconds(scopes[i].end), frame, Track::Gpu);
+	}
+}
+
+Trace Profiler::Collect()
+{
+	Trace trace;
+	for (int i = 0; i < MaxThreads; i++)
+	{
+		// Rings are made in order, so the first missing one is the end
+		const ThreadRing* ring = gRings[i].load(std::memory_order_acquire);
+		if (!ring)
+		{
+			break;
+		}
+
+		const char* name = ring->name.load(std::memory_order_acquire);
+		trace.threadNames.push_back(name ? name : "");
+
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > static_cast<uint64_t>(RingCapacity) ? head - RingCapacity : 0;
+		for (uint64_t index = first; index < head; index++)
+		{
+			Event event;
+			if (ReadEvent(ring->slots[index % RingCapacity], index, event))
+			{
+				event.thread = static_cast<uint32_t>(i);
+				trace.events.push_back(event);
+			}
+		}
+	}
+	return trace;
+}
+
+void Profiler::WriteChromeTrace(const Trace& trace, std::ostream& out)
+{
+	uint64_t start = UINT64_MAX;
+	for (const Event& event : trace.events)
+	{
+		start = std::min(start, event.beginNanoseconds);
+	}
+
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << CpuProcess << ",\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << GpuProcess << ",\"args\":{\"name\":\"GPU\"}}";
+	for (size_t thread = 0; thread < trace.threadNames.size(); thread++)
+	{
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << CpuProcess << ",\"tid\":" << thread << ",\"args\":{\"name\":";
+		if (trace.threadNames[thread].empty())
+		{
+			out << "\"Thread " << thread << "\"";
+		}
+		else
+		{
+			WriteJsonString(out, trace.threadNames[thread].c_str());
+		}
+		out << "}}";
+	}
+
+	// GPU events all go on one track, whichever thread read them back
+	for (const Event& event : trace.events)
+	{
+		bool gpu = event.track == Track::Gpu;
+		out << ",\n{\"name\":";
+		WriteJsonString(out, event.name);
+		out << ",\"cat\":\"" << (gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":" << (gpu ? GpuProcess : CpuProcess)
+			<< ",\"tid\":" << (gpu ? 0 : event.thread)
+			<< ",\"ts\":" << (event.beginNanoseconds - start) / 1000.0
+			<< ",\"dur\":" << (std::max(event.endNanoseconds, event.beginNanoseconds) - event.beginNanoseconds) / 1000.0
+			<< ",\"args\":{\"frame\":" << event.frame << "}}";
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ACW
+{
+	// Scoped timing of the frame on the CPU and GPU, kept as events in a ring for each thread and written out in
+	// Chrome's trace event format, for chrome://tracing or Perfetto. A thread records into a ring of its own without
+	// locks, taking a free one the first time it records and keeping it until it exits. The frame's work runs on the
+	// long lived threads of a WorkerThreads::Pool, which hold their rings for as long as the pool lives; a ring is
+	// only handed back, for the next thread to take, when a thread does exit, such as one run by WorkerThreads::Run.
+	// Rings only ever have one writer and can be read while they are written, an event overwritten as it is copied
+	// being left out. GPU times come from a backend such as D3D11GpuTimer and are recorded on whichever thread reads
+	// them back; without one the trace holds the CPU alone, which is all there is on Linux.
+	namespace Profiler
+	{
+		// Events kept for each thread before the oldest are written over.
+		static const int RingCapacity = 4096;
+
+		// Threads recording at once. Events of any more are dropped.
+		static const int MaxThreads = 64;
+
+		enum class Track : uint32_t
+		{
+			Cpu,
+			Gpu
+		};
+
+		// Names are not copied, so must outlive the profiler, as string literals do.
+		struct Event
+		{
+			const char* name;
+			uint64_t beginNanoseconds;
+			uint64_t endNanoseconds;
+			uint32_t frame;
+			// The ring the event was recorded in.
+			uint32_t thread;
+			Track track;
+		};
+
+		// Nanoseconds on a monotonic clock, from an arbitrary start.
+		inline uint64_t Now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		// Counts the frames events are tagged with, once a frame before anything in it is timed.
+		void BeginFrame();
+		uint32_t CurrentFrame();
+
+		// Names the calling thread's ring in the trace, until another thread takes it.
+		void SetThreadName(const char* name);
+
+		// Records an event on the calling thread's ring.
+		void Record(const char* name, uint64_t beginNanoseconds, uint64_t endNanoseconds, uint32_t frame, Track track);
+
+		// A scope of a GPU frame, as two timestamps of a counter running at some frequency.
+		struct GpuScope
+		{
+			const char* name;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		// Records the scopes of a frame as GPU events. A GPU's clock has no fixed relation to the CPU's, so the frame's
+		// startTick is placed at cpuStartNanoseconds, when the CPU began submitting it: the events show how long each
+		// scope took and how they lie against each other, but not how far the GPU ran behind.
+		void RecordGpuFrame(uint32_t frame, uint64_t cpuStartNanoseconds, uint64_t frequency, uint64_t startTick, const GpuScope* scopes, int scopeCount);
+
+		// Times from its construction to its destruction on the CPU.
+		class Scope
+		{
+		public:
+			explicit Scope(const char* name) : mName(name), mFrame(CurrentFrame()), mBegin(Now()) {}
+			~Scope() { Record(mName, mBegin, Now(), mFrame, Track::Cpu); }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			const char* mName;
+			uint32_t mFrame;
+			uint64_t mBegin;
+		};
+
+		struct Trace
+		{
+			// Oldest first within each thread.
+			std::vector<Event> events;
+			// By ring, empty for those never named.
+			std::vector<std::string> threadNames;
+		};
+
+		// Copies what every ring holds. Safe while other threads record.
+		Trace Collect();
+
+		// The trace as Chrome trace event JSON, times in microseconds from its first event. CPU threads are one process
+		// and the GPU another.
+		void WriteChromeTrace(const Trace& trace, std::ostream& out);
+	}
+}
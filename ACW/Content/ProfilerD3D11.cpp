@@ -0,0 +1,185 @@
+﻿#include "pch.h"
+#include "ProfilerD3D11.h"
+
+#include "..\Common\DirectXHelper.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace ACW;
+using namespace ACW::Profiler;
+
+D3D11GpuTimer::D3D11GpuTimer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources),
+	mFrameCount(0),
+	mCreated(false),
+	mLastCount(0),
+	mLastTickMilliseconds(0.0f),
+	mReadCount(0)
+{
+	for (Frame& frame : mFrames)
+	{
+		frame.scopeCount.store(0);
+		frame.timedCount = 0;
+		frame.frame = 0;
+		frame.cpuStart = 0;
+		frame.issued = false;
+	}
+}
+
+void D3D11GpuTimer::CreateQueries()
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+	CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+	CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+
+	for (Frame& frame : mFrames)
+	{
+		DX::ThrowIfFailed(
+			device->CreateQuery(&disjointDesc, frame.disjoint.ReleaseAndGetAddressOf())
+		);
+		DX::ThrowIfFailed(
+			device->CreateQuery(&timestampDesc, frame.start.ReleaseAndGetAddressOf())
+		);
+		for (int i = 0; i < MaxScopes; i++)
+		{
+			DX::ThrowIfFailed(
+				device->CreateQuery(&timestampDesc, frame.begin[i].ReleaseAndGetAddressOf())
+			);
+			DX::ThrowIfFailed(
+				device->CreateQuery(&timestampDesc, frame.end[i].ReleaseAndGetAddressOf())
+			);
+		}
+		frame.issued = false;
+	}
+	mCreated = true;
+}
+
+void D3D11GpuTimer::ReleaseQueries()
+{
+	mCreated = false;
+	for (Frame& frame : mFrames)
+	{
+		frame.disjoint.Reset();
+		frame.start.Reset();
+		for (int i = 0; i < MaxScopes; i++)
+		{
+			frame.begin[i].Reset();
+			frame.end[i].Reset();
+		}
+		frame.issued = false;
+	}
+}
+
+void D3D11GpuTimer::BeginFrame(ID3D11DeviceContext* context)
+{
+	Frame& frame = mFrames[mFrameCount % FramesInFlight];
+	if (mCreated && frame.issued)
+	{
+		ReadFrame(context, frame);
+	}
+
+	frame.scopeCount.store(0, std::memory_order_relaxed);
+	frame.timedCount = 0;
+	frame.frame = CurrentFrame();
+	frame.cpuStart = Now();
+	frame.issued = false;
+	if (mCreated)
+	{
+		context->Begin(frame.disjoint.Get());
+		context->End(frame.start.Get());
+	}
+}
+
+void D3D11GpuTimer::EndFrame(ID3D11DeviceContext* context)
+{
+	Frame& frame = mFrames[mFrameCount % FramesInFlight];
+	if (mCreated)
+	{
+		context->End(frame.disjoint.Get());
+		frame.timedCount = std::min(frame.scopeCount.load(std::memory_order_relaxed), static_cast<int>(MaxScopes));
+		frame.issued = true;
+	}
+	mFrameCount++;
+}
+
+int D3D11GpuTimer::BeginScope(ID3D11DeviceContext* context, const char* name)
+{
+	if (!mCreated)
+	{
+		return -1;
+	}
+
+	Frame& frame = mFrames[mFrameCount % FramesInFlight];
+	int scope = frame.scopeCount.fetch_add(1, std::memory_order_relaxed);
+	if (scope >= MaxScopes)
+	{
+		return -1;
+	}
+
+	frame.names[scope] = name;
+	context->End(frame.begin[scope].Get());
+	return scope;
+}
+
+void D3D11GpuTimer::EndScope(ID3D11DeviceContext* context, int scope)
+{
+	if (scope < 0)
+	{
+		return;
+	}
+
+	context->End(mFrames[mFrameCount % FramesInFlight].end[scope].Get());
+}
+
+bool D3D11GpuTimer::GetLastMilliseconds(const char* name, float& milliseconds) const
+{
+	for (int i = 0; i < mLastCount; i++)
+	{
+		if (std::strcmp(mLastScopes[i].name, name) == 0)
+		{
+			milliseconds = static_cast<float>(mLastScopes[i].end - mLastScopes[i].begin) * mLastTickMilliseconds;
+			return true;
+		}
+	}
+
+	milliseconds = 0.0f;
+	return false;
+}
+
+// Records the frame's scopes if its results are in, without waiting for them
+void D3D11GpuTimer::ReadFrame(ID3D11DeviceContext* context, Frame& frame)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if (context->GetData(frame.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK || disjoint.Disjoint)
+	{
+		return;
+	}
+
+	UINT64 start;
+	if (context->GetData(frame.start.Get(), &start, sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+	{
+		return;
+	}
+
+	GpuScope scopes[MaxScopes];
+	for (int i = 0; i < frame.timedCount; i++)
+	{
+		UINT64 begin;
+		UINT64 end;
+		if (context->GetData(frame.begin[i].Get(), &begin, sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			context->GetData(frame.end[i].Get(), &end, sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			return;
+		}
+		scopes[i].name = frame.names[i];
+		scopes[i].begin = begin;
+		scopes[i].end = end;
+	}
+
+	RecordGpuFrame(frame.frame, frame.cpuStart, disjoint.Frequency, start, scopes, frame.timedCount);
+
+	std::copy(scopes, scopes + frame.timedCount, mLastScopes);
+	mLastCount = frame.timedCount;
+	mLastTickMilliseconds = 1000.0f / static_cast<float>(disjoint.Frequency);
+	mReadCount++;
+}
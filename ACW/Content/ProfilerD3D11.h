@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include "..\Common\DeviceResources.h"
+#include "Profiler.h"
+#include <atomic>
+
+namespace ACW
+{
+	namespace Profiler
+	{
+		// Times scopes on the GPU with timestamp queries, a set for each of FramesInFlight frames. A frame's results
+		// are read back when its queries come round to be issued again, FramesInFlight frames on, and recorded as GPU
+		// events. Results that are not ready by then, or were disjoint, are dropped rather than waited for.
+		class D3D11GpuTimer
+		{
+		public:
+			static const int FramesInFlight = 4;
+
+			// Scopes timed in a frame. Any more are only timed on the CPU.
+			static const int MaxScopes = 32;
+
+			explicit D3D11GpuTimer(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+			void CreateQueries();
+			void ReleaseQueries();
+
+			// On the immediate context, before and after everything the frame draws.
+			void BeginFrame(ID3D11DeviceContext* context);
+			void EndFrame(ID3D11DeviceContext* context);
+
+			// On the context the scope draws into, from any thread, between BeginFrame and EndFrame. BeginScope returns
+			// -1 when the frame has no queries left or there are none, which EndScope ignores.
+			int BeginScope(ID3D11DeviceContext* context, const char* name);
+			void EndScope(ID3D11DeviceContext* context, int scope);
+
+			// Frames read back so far, and the milliseconds the scope called name took in the last of them, false and 0
+			// when it had no such scope. For the thread calling BeginFrame, which is where frames are read back.
+			uint32_t GetReadCount() const { return mReadCount; }
+			bool GetLastMilliseconds(const char* name, float& milliseconds) const;
+
+		private:
+			struct Frame
+			{
+				Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+				Microsoft::WRL::ComPtr<ID3D11Query> start;
+				Microsoft::WRL::ComPtr<ID3D11Query> begin[MaxScopes];
+				Microsoft::WRL::ComPtr<ID3D11Query> end[MaxScopes];
+				const char* names[MaxScopes];
+				// Scopes begun, which may run past MaxScopes, and those given queries as EndFrame found them.
+				std::atomic<int> scopeCount;
+				int timedCount;
+				uint32_t frame;
+				uint64_t cpuStart;
+				bool issued;
+			};
+
+			void ReadFrame(ID3D11DeviceContext* context, Frame& frame);
+
+			std::shared_ptr<DX::DeviceResources> m_deviceResources;
+			Frame mFrames[FramesInFlight];
+			uint32_t mFrameCount;
+			bool mCreated;
+
+			// The scopes of the last frame read back.
+			GpuScope mLastScopes[MaxScopes];
+			int mLastCount;
+			float mLastTickMilliseconds;
+			uint32_t mReadCount;
+		};
+
+		// Times from its construction to its destruction on the CPU and, when timer is not null, on the GPU.
+		class D3D11Scope
+		{
+		public:
+			D3D11Scope(D3D11GpuTimer* timer, ID3D11DeviceContext* context, const char* name) :
+				mCpu(name), mTimer(timer), mContext(context), mScope(timer ? timer->BeginScope(context, name) : -1)
+			{
+			}
+
+			~D3D11Scope()
+			{
+				if (mTimer)
+				{
+					mTimer->EndScope(mContext, mScope);
+				}
+			}
+
+			D3D11Scope(const D3D11Scope&) = delete;
+			D3D11Scope& operator=(const D3D11Scope&) = delete;
+
+		private:
+			Scope mCpu;
+			D3D11GpuTimer* mTimer;
+			ID3D11DeviceContext* mContext;
+			int mScope;
+		};
+	}
+}
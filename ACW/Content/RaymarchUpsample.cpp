@@ -0,0 +1,96 @@
+﻿#include "pch.h"
+#include "RaymarchUpsample.h"
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+
+RaymarchUpsample::ColourDepthImage RaymarchUpsample::CreateImage(int width, int height)
+{
+	ColourDepthImage image;
+	image.width = width;
+	image.height = height;
+	image.colour.assign(static_cast<size_t>(width) * height, float4());
+	image.depth.assign(static_cast<size_t>(width) * height, 1.0f);
+	return image;
+}
+
+RaymarchUpsample::DepthProjection RaymarchUpsample::PerspectiveDepthProjection(float nearPlane, float farPlane)
+{
+	// Same terms as XMMatrixPerspectiveFovLH
+	DepthProjection projection;
+	projection.m22 = farPlane / (farPlane - nearPlane);
+	projection.m32 = -nearPlane * farPlane / (farPlane - nearPlane);
+	return projection;
+}
+
+float RaymarchUpsample::LinearDepth(const DepthProjection& projection, float depth)
+{
+	return projection.m32 / (depth - projection.m22);
+}
+
+RaymarchUpsample::ColourDepthImage RaymarchUpsample::Upsample(const ColourDepthImage& low, int width, int height, float resolutionScale, const DepthProjection& projection)
+{
+	static const int footprint[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+
+	ColourDepthImage high = CreateImage(width, height);
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			float lowX = (x + 0.5f) / resolutionScale - 0.5f;
+			float lowY = (y + 0.5f) / resolutionScale - 0.5f;
+			int baseX = static_cast<int>(std::floor(lowX));
+			int baseY = static_cast<int>(std::floor(lowY));
+			float fx = lowX - baseX;
+			float fy = lowY - baseY;
+
+			float4 colours[4];
+			float depths[4];
+			float bilinear[4];
+			float nearest = 1.0f;
+			float coverage = 0.0f;
+
+			for (int i = 0; i < 4; i++)
+			{
+				int texelX = std::min(std::max(baseX + footprint[i][0], 0), low.width - 1);
+				int texelY = std::min(std::max(baseY + footprint[i][1], 0), low.height - 1);
+				colours[i] = low.colour[texelY * low.width + texelX];
+				depths[i] = low.depth[texelY * low.width + texelX];
+				bilinear[i] = (footprint[i][0] ? fx : 1.0f - fx) * (footprint[i][1] ? fy : 1.0f - fy);
+
+				if (depths[i] < 1.0f)
+				{
+					nearest = std::min(nearest, depths[i]);
+					coverage += bilinear[i];
+				}
+			}
+
+			// Discarded in the shader
+			if (coverage < 0.5f)
+			{
+				continue;
+			}
+
+			float nearestLinear = LinearDepth(projection, nearest);
+			float3 colour;
+			float weightSum = 0.0f;
+
+			for (int j = 0; j < 4; j++)
+			{
+				if (depths[j] < 1.0f)
+				{
+					float difference = std::fabs(LinearDepth(projection, depths[j]) - nearestLinear) / nearestLinear;
+					float weight = bilinear[j] * saturate(1.0f - difference / DepthTolerance) + 1e-5f;
+					colour += weight * colours[j].xyz();
+					weightSum += weight;
+				}
+			}
+
+			high.colour[y * width + x] = float4(colour / weightSum, 1.0f);
+			high.depth[y * width + x] = nearest;
+		}
+	}
+
+	return high;
+}
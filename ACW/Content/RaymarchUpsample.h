@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "ShaderMath.h"
+#include <vector>
+
+namespace ACW
+{
+	// CPU reference of the depth-aware upsample in RaymarchUpsamplePixel.hlsl.
+	namespace RaymarchUpsample
+	{
+		// Relative view depth difference beyond which a sample is treated as a different surface.
+		static const float DepthTolerance = 0.05f;
+
+		// A colour target with its post projection depth. Pixels nothing was drawn to have depth 1.
+		struct ColourDepthImage
+		{
+			int width;
+			int height;
+			std::vector<ShaderMath::float4> colour;
+			std::vector<float> depth;
+		};
+
+		// The two projection terms needed to recover view depth from post projection depth.
+		struct DepthProjection
+		{
+			float m22;
+			float m32;
+		};
+
+		ColourDepthImage CreateImage(int width, int height);
+		DepthProjection PerspectiveDepthProjection(float nearPlane, float farPlane);
+		float LinearDepth(const DepthProjection& projection, float depth);
+
+		// Upsamples a target rendered at 1 / resolutionScale of width x height.
+		ColourDepthImage Upsample(const ColourDepthImage& low, int width, int height, float resolutionScale, const DepthProjection& projection);
+	}
+}
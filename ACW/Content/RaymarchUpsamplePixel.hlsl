@@ -0,0 +1,102 @@
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer modelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 eye;
+	float4 lookAt;
+	float4 upDir;
+};
+
+cbuffer upsampleConstantBuffer : register(b2)
+{
+	float resolutionScale;
+	float shadingRate;
+	float2 padding;
+};
+
+// Colour and depth written by the raymarch passes at reduced resolution.
+Texture2D<float4> raymarchColour : register(t0);
+Texture2D<float> raymarchDepth : register(t1);
+
+struct VS_QUAD
+{
+	float4 position : SV_POSITION;
+	float2 canvasXY : TEXCOORD0;
+};
+
+struct PixelShaderOutput
+{
+	float4 colour : SV_TARGET;
+	float depth : SV_DEPTH;
+};
+
+// Relative view depth difference beyond which a sample is treated as a different surface.
+static const float depthTolerance = 0.05;
+
+static const int2 footprint[4] = { int2(0, 0), int2(1, 0), int2(0, 1), int2(1, 1) };
+
+float linearDepth(float depth)
+{
+	return projection._m32 / (depth - projection._m22);
+}
+
+// Composites the reduced resolution raymarch targets into the back buffer. Coverage comes from
+// the bilinear footprint, colour only from the samples on the front-most surface of the footprint.
+PixelShaderOutput main(VS_QUAD input)
+{
+	PixelShaderOutput output;
+
+	uint2 size;
+	raymarchColour.GetDimensions(size.x, size.y);
+
+	float2 lowPos = input.position.xy / resolutionScale - 0.5;
+	int2 base = int2(floor(lowPos));
+	float2 f = lowPos - base;
+
+	float4 colours[4];
+	float depths[4];
+	float bilinear[4];
+	float nearest = 1.0;
+	float coverage = 0.0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		int2 texel = clamp(base + footprint[i], int2(0, 0), int2(size) - 1);
+		colours[i] = raymarchColour.Load(int3(texel, 0));
+		depths[i] = raymarchDepth.Load(int3(texel, 0));
+		bilinear[i] = (footprint[i].x ? f.x : 1.0 - f.x) * (footprint[i].y ? f.y : 1.0 - f.y);
+
+		if (depths[i] < 1.0)
+		{
+			nearest = min(nearest, depths[i]);
+			coverage += bilinear[i];
+		}
+	}
+
+	if (coverage < 0.5)
+	{
+		discard;
+	}
+
+	float nearestLinear = linearDepth(nearest);
+	float3 colour = float3(0.0, 0.0, 0.0);
+	float weightSum = 0.0;
+
+	for (int j = 0; j < 4; j++)
+	{
+		if (depths[j] < 1.0)
+		{
+			float difference = abs(linearDepth(depths[j]) - nearestLinear) / nearestLinear;
+			float weight = bilinear[j] * saturate(1.0 - difference / depthTolerance) + 1e-5;
+			colour += weight * colours[j].rgb;
+			weightSum += weight;
+		}
+	}
+
+	output.colour = float4(colour / weightSum, 1.0);
+	output.depth = nearest;
+
+	return output;
+}
@@ -1,11 +1,17 @@
 ﻿#include "pch.h"
 #include "Sample3DSceneRenderer.h"
+#include "PlantScatter.h"
+#include "PlantAtlas.h"
+#include "CoralImpostor.h"
+#include "VertexQuantization.h"
 
 #include "..\Common\DirectXHelper.h"
+#include "..\InputKeys.h"
 
 #include <d3d11.h>
 #include <DirectXMath.h>
 #include <wrl/client.h>
+#include <chrono>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -20,12 +26,54 @@ using namespace Windows::Foundation;
 /// <param name="deviceResources"></param>
 Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
 	m_loadingComplete(false),
+	mCameraDirty(true),
 	m_indexCount(0),
-	m_deviceResources(deviceResources)
+	mPlantInstanceCount(0),
+	mPlantVisibleCount(0),
+	mPlantCulledCount(0),
+	mPlantAtlasMilliseconds(0.0f),
+	mCoralVariantTriangles(0),
+	mCoralVariantMilliseconds(0.0f),
+	mCoralMeshInstanceCount(0),
+	mCoralAcmrBefore(0.0f),
+	mCoralAcmrAfter(0.0f),
+	mCoralOptimizeMilliseconds(0.0f),
+	mCoralClusterCullMilliseconds(0.0f),
+	mCoralVertexBytes(0),
+	mCoralFloatVertexBytes(0),
+	mCoralImpostorReady(false),
+	mDrawingCoralImpostor(false),
+	mCoralImpostorBakeMilliseconds(0.0f),
+	mDeviceGeneration(0),
+	mRaymarchResolution(RaymarchResolution::Full),
+	mRaymarchResolutionKeyDown(false),
+	mCoralShadingRate(CoralShadingRate::Full),
+	mCoralShadingRateKeyDown(false),
+	mRecordDeferred(false),
+	mRecordDeferredKeyDown(false),
+	mUnderwaterDepthState(nullptr),
+	m_deviceResources(deviceResources),
+	mFrameGraphBackend(deviceResources),
+	mStateCache(deviceResources),
+	mConstants(deviceResources, ConstantRingBytes),
+	mWorkers(0),
+	mRecorder(deviceResources, RecordingThreads),
+	mExecuteStats(),
+	mRecordStats(),
+	mGpuTimer(deviceResources),
+	mCoralPassTimings(),
+	mCoralTimingsRead(0)
 {
+	//Constant buffer blocks and the stages they are bound to
+	mCameraBlock = mConstants.AddBlock(0, ConstantRing::VertexStage | ConstantRing::PixelStage | ConstantRing::GeometryStage | ConstantRing::DomainStage, sizeof(ModelViewProjectionConstantBuffer));
+	mLightBlock = mConstants.AddBlock(1, ConstantRing::PixelStage, sizeof(LightConstantBuffer));
+	mTimeBlock = mConstants.AddBlock(1, ConstantRing::VertexStage | ConstantRing::GeometryStage | ConstantRing::DomainStage, sizeof(TimeConstantBuffer));
+	mUpsampleBlock = mConstants.AddBlock(2, ConstantRing::PixelStage, sizeof(UpsampleConstantBuffer));
+
 	CreateDeviceDependentResources();
 	CreateWindowSizeDependentResources();
 	mContext = m_deviceResources->GetD3DDeviceContext();
+	mStates.SetContext(mContext.Get());
 }
 
 /// <summary>
@@ -62,11 +110,17 @@ void Sample3DSceneRenderer::CreateWindowSizeDependentResources()
 	XMStoreFloat4(&m_constantBufferDataCamera.lookAt, at);
 	XMStoreFloat4(&m_constantBufferDataCamera.upDir, up);
 
+	//The scene is modelled in world space
+	XMStoreFloat4x4(&m_constantBufferDataCamera.fmodel, XMMatrixIdentity());
+	mCameraDirty = true;
+
 	//Set light pos and colour
 	DirectX::XMVECTOR lightPos = { -10, 100, -10, 1 };
 	DirectX::XMVECTOR lightColour = { .2, .3, 0.6, 1 };
 	XMStoreFloat4(&mConstantBufferDataLight.lightPos, lightPos);
 	XMStoreFloat4(&mConstantBufferDataLight.lightColour, lightColour);
+
+	UpdateRaymarchViewports();
 }
 
 
@@ -122,6 +176,90 @@ void Sample3DSceneRenderer::CreateUnderwaterRenderTarget()
 		m_deviceResources->GetD3DDevice()->CreateShaderResourceView(m_underwaterRenderTarget.Get(), &srvDesc, m_underwaterTextureSRV.GetAddressOf())
 	);
 }
+
+// Sizes the viewports of the raymarched passes for the back buffer, resolution and shading rate. The targets
+// behind them are declared to the frame graph each frame at these sizes.
+void Sample3DSceneRenderer::UpdateRaymarchViewports()
+{
+	// Must match CONE_TILE_SIZE in ImplicitCoralMap.hlsli
+	const float tileSize = 8.0f;
+
+	float scale = static_cast<float>(mRaymarchResolution);
+	float rate = static_cast<float>(mCoralShadingRate);
+	mConstantBufferDataUpsample.resolutionScale = scale;
+	mConstantBufferDataUpsample.shadingRate = rate;
+
+	// Exact fraction of the screen so low resolution pixel centres line up with the upsample
+	Size outputSize = m_deviceResources->GetOutputSize();
+	mRaymarchViewport = CD3D11_VIEWPORT(0.0f, 0.0f, outputSize.Width / scale, outputSize.Height / scale);
+
+	// Tiles are measured in pixels of the target the coral is marched into, and the viewport is the exact fraction
+	// of it so tile centres line up with the full resolution pixels. Partial tiles on the right and bottom edges
+	// are never rasterised and keep the cleared distance
+	mConePrepassViewport = CD3D11_VIEWPORT(0.0f, 0.0f, mRaymarchViewport.Width / tileSize, mRaymarchViewport.Height / tileSize);
+
+	// Exact fraction of the hit buffer so each block centre lines up with the pixels it covers
+	mCoralShadedViewport = CD3D11_VIEWPORT(0.0f, 0.0f, mRaymarchViewport.Width / rate, mRaymarchViewport.Height / rate);
+}
+
+// One deferred context for each worker thread passes are recorded on, with the filter in front of it
+void Sample3DSceneRenderer::CreateRecordingContexts()
+{
+	mRecorder.CreateContexts();
+	for (int thread = 0; thread < RecordingThreads; thread++)
+	{
+		mPassStates[thread].SetContext(mRecorder.Context(thread));
+	}
+}
+
+// Takes the coral passes' GPU times from the last frame the profiler read back, when there is a new one. A frame
+// that drew the impostor only has the impostor's time, and passes a frame did not run, such as the resolve at the
+// full rate, took none.
+void Sample3DSceneRenderer::ReadCoralPassTimings()
+{
+	uint32_t readCount = mGpuTimer.GetReadCount();
+	if (readCount == mCoralTimingsRead)
+	{
+		return;
+	}
+	mCoralTimingsRead = readCount;
+
+	float impostor;
+	if (mGpuTimer.GetLastMilliseconds("DrawCoralImpostor", impostor))
+	{
+		mCoralPassTimings.impostorMilliseconds = impostor;
+		return;
+	}
+
+	mGpuTimer.GetLastMilliseconds("DrawConePrepass", mCoralPassTimings.prepassMilliseconds);
+	mGpuTimer.GetLastMilliseconds("DrawCoralMarch", mCoralPassTimings.marchMilliseconds);
+	mGpuTimer.GetLastMilliseconds("DrawCoralShade", mCoralPassTimings.shadeMilliseconds);
+	mGpuTimer.GetLastMilliseconds("DrawCoralResolve", mCoralPassTimings.resolveMilliseconds);
+}
+
+// Switches the raymarched passes between full, half and quarter resolution
+void Sample3DSceneRenderer::SetRaymarchResolution(RaymarchResolution resolution)
+{
+	if (resolution == mRaymarchResolution)
+	{
+		return;
+	}
+
+	mRaymarchResolution = resolution;
+	UpdateRaymarchViewports();
+}
+
+// Switches the implicit coral between lighting every marched pixel and one in each 2x2 or 4x4 block
+void Sample3DSceneRenderer::SetCoralShadingRate(CoralShadingRate rate)
+{
+	if (rate == mCoralShadingRate)
+	{
+		return;
+	}
+
+	mCoralShadingRate = rate;
+	UpdateRaymarchViewports();
+}
 /// <summary>
 /// 
 /// </summary>
@@ -133,17 +271,17 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer, const std::vector
 	mConstantBufferDataTime.time = timer.GetTotalSeconds();
 
 	XMFLOAT3 translation(0, 0, 0);
-	if (pInput[0])
+	if (pInput[InputForward])
 		translation.z = 1.0f * dt;
-	if (pInput[1])
+	if (pInput[InputLeft])
 		translation.x = -1.0f * dt;
-	if (pInput[2])
+	if (pInput[InputBack])
 		translation.z = -1.0f * dt;
-	if (pInput[3])
+	if (pInput[InputRight])
 		translation.x = 1.0f * dt;
-	if (pInput[4])
+	if (pInput[InputUp])
 		translation.y = 1.0f * dt;
-	if (pInput[5])
+	if (pInput[InputDown])
 		translation.y = -1.0f * dt;
 
 	if (translation.x != 0 || translation.y != 0 || translation.z != 0)
@@ -160,11 +298,60 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer, const std::vector
 
 		XMMATRIX lookAt = XMMatrixLookAtLH(eyeVector, lookAtVector, up);
 		XMStoreFloat4x4(&m_constantBufferDataCamera.view, XMMatrixTranspose(lookAt));
+		mCameraDirty = true;
 	}
 
+	if (mCameraDirty)
+	{
+		UpdateDerivedMatrices();
+	}
+
+	//Cycle the raymarch resolution between full, half and quarter
+	if (pInput[InputRaymarchResolution] && !mRaymarchResolutionKeyDown)
+	{
+		switch (mRaymarchResolution)
+		{
+		case RaymarchResolution::Full:
+			SetRaymarchResolution(RaymarchResolution::Half);
+			break;
+		case RaymarchResolution::Half:
+			SetRaymarchResolution(RaymarchResolution::Quarter);
+			break;
+		default:
+			SetRaymarchResolution(RaymarchResolution::Full);
+			break;
+		}
+	}
+	mRaymarchResolutionKeyDown = pInput[InputRaymarchResolution];
+
+	//Cycle the coral shading rate on T
+	if (pInput[InputCoralShadingRate] && !mCoralShadingRateKeyDown)
+	{
+		switch (mCoralShadingRate)
+		{
+		case CoralShadingRate::Full:
+			SetCoralShadingRate(CoralShadingRate::Half);
+			break;
+		case CoralShadingRate::Half:
+			SetCoralShadingRate(CoralShadingRate::Quarter);
+			break;
+		default:
+			SetCoralShadingRate(CoralShadingRate::Full);
+			break;
+		}
+	}
+	mCoralShadingRateKeyDown = pInput[InputCoralShadingRate];
+
+	//Switch between drawing the passes on the immediate context and recording them on worker threads on Y
+	if (pInput[InputRecordDeferred] && !mRecordDeferredKeyDown)
+	{
+		SetRecordDeferred(!mRecordDeferred);
+	}
+	mRecordDeferredKeyDown = pInput[InputRecordDeferred];
+
 	//// Rotation
 	//const float rotationSpeed = 1.0f; // Adjust this value for the rotation speed
-	//if (pInput[6])
+	//if (pInput[InputTurnLeft])
 	//{
 	//	float yaw = rotationSpeed * dt; // Yaw rotation in radians
 	//	XMVECTOR eyeVector = XMLoadFloat4(&m_constantBufferDataCamera.eye);
@@ -181,7 +368,7 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer, const std::vector
 	//	XMStoreFloat4x4(&m_constantBufferDataCamera.view, XMMatrixTranspose(lookAt));
 	//}
 
-	//if (pInput[7])
+	//if (pInput[InputTurnRight])
 	//{
 	//	float yaw = -rotationSpeed * dt; // Yaw rotation in radians
 	//	XMVECTOR eyeVector = XMLoadFloat4(&m_constantBufferDataCamera.eye);
@@ -210,13 +397,82 @@ void Sample3DSceneRenderer::Render()
 	}
 
 
+	//Shaders and states are bound through the filters, which forget what the last frame left bound
+	mStates.BeginFrame();
+	for (StateFilter::FilteredContext<ID3D11DeviceContext3>& states : mPassStates)
+	{
+		states.BeginFrame();
+	}
+
 	//Update buffer data
 	UpdateBuffers();
 
+	//Pick each coral's level of detail for its distance and cull its clusters, and find the plants in view furthest first
+	UpdateCoralMeshInstances();
+	UpdatePlantInstances();
+
+	//Far enough away the coral is one impostor quad rather than a march over the whole screen, judged from where the
+	//camera is now rather than where it started
+	const XMFLOAT4& eyePosition = m_constantBufferDataCamera.eye;
+	mDrawingCoralImpostor = mCoralImpostorReady.load(std::memory_order_acquire) &&
+		CoralImpostor::UseImpostor(CoralImpostor::DefaultSettings(), CoralImpostor::float3(eyePosition.x, eyePosition.y, eyePosition.z));
+
+	//Looked up here rather than in the pass, as the cache is not shared between threads
+	mUnderwaterDepthState = UnderwaterDepthState();
+
+	//The frame graph culls and orders the passes, places the targets they share and binds them as each pass runs
+	DeclareFrame();
+	mFrameGraph.Compile(mFrameGraphBackend);
+	mGpuTimer.BeginFrame(mContext.Get());
+	ReadCoralPassTimings();
+
+	if (mRecordDeferred)
+	{
+		//Each pass is recorded into a command list of its own on a worker thread, starting with nothing bound but
+		//the constants, and the lists run on the immediate context in the order the graph put the passes in
+		for (FrameGraph::ExecuteStats& stats : mPassExecuteStats)
+		{
+			stats = FrameGraph::ExecuteStats();
+		}
+		mRecordStats = CommandRecording::RecordJobs(mRecorder, mWorkers, mFrameGraph.GetRunCount(), [this](int job, int thread)
+		{
+			DrawContext draw = PassDrawContext(thread);
+			draw.states.Invalidate();
+			mConstants.Bind(draw.context);
+
+			FrameGraph::D3D11ContextBackend backend(mFrameGraphBackend, draw.context);
+			mFrameGraph.ExecutePass(job, backend, thread, mPassExecuteStats[thread]);
+		});
+
+		mExecuteStats = FrameGraph::ExecuteStats();
+		for (const FrameGraph::ExecuteStats& stats : mPassExecuteStats)
+		{
+			mExecuteStats += stats;
+		}
+
+		//Command lists leave nothing bound on the immediate context
+		mStates.Invalidate();
+		mConstants.Bind(mContext.Get());
+	}
+	else
+	{
+		mRecordStats = CommandRecording::RecordStats();
+		mFrameGraph.Execute(mFrameGraphBackend);
+		mExecuteStats = mFrameGraph.GetExecuteStats();
+	}
+
+	mGpuTimer.EndFrame(mContext.Get());
+}
+
+// The buffers, shader stages and states every pass starts from, bound at the start of each pass whichever context
+// it draws into, so a pass sees the same state whether it follows the one before it on the immediate context or is
+// recorded on a deferred context of its own. The filter drops the binds already in place.
+void ACW::Sample3DSceneRenderer::BindPassState(DrawContext& draw)
+{
 	//Setup cube vertices and indices
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
-	mContext->IASetVertexBuffers(
+	draw.context->IASetVertexBuffers(
 		0,
 		1,
 		m_vertexBuffer.GetAddressOf(),
@@ -224,7 +480,7 @@ void Sample3DSceneRenderer::Render()
 		&offset
 	);
 
-	mContext->IASetIndexBuffer(
+	draw.context->IASetIndexBuffer(
 		m_indexBuffer.Get(),
 		DXGI_FORMAT_R16_UINT, 
 		0
@@ -232,144 +488,387 @@ void Sample3DSceneRenderer::Render()
 
 
 	//Set triangle list topology
-	mContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	//Set input layout
-	mContext->IASetInputLayout(m_inputLayout.Get());
+	draw.states.IASetInputLayout(m_inputLayout.Get());
 
 	//Set default rasteriser state
-	mContext->RSSetState(mDefaultRasteriser.Get());
+	draw.states.RSSetState(mDefaultRasteriser.Get());
 
 	//Set blend state
-	mContext->OMSetBlendState(mNoBlend.Get(), nullptr, 0xffffffff);
+	draw.states.OMSetBlendState(mNoBlend.Get(), nullptr, 0xffffffff);
 
 	//Set depth stencil
-	mContext->OMSetDepthStencilState(mDepthLessThanEqualAll.Get(), 0);
+	draw.states.OMSetDepthStencilState(mDepthLessThanEqualAll.Get(), 0);
+
+	//Only the terrain and water are tessellated, and nothing has a geometry shader
+	draw.states.GSSetShader(nullptr, nullptr, 0);
+	draw.states.HSSetShader(nullptr, nullptr, 0);
+	draw.states.DSSetShader(nullptr, nullptr, 0);
+
+	//The one sampler the passes that sample use
+	draw.states.PSSetSamplers(0, 1, mSampler.GetAddressOf());
+}
 
+// Where a pass run on thread draws: the immediate context, or the thread's deferred context when recording
+ACW::Sample3DSceneRenderer::DrawContext ACW::Sample3DSceneRenderer::PassDrawContext(int thread)
+{
+	if (mRecordDeferred)
+	{
+		DrawContext draw = { mRecorder.Context(thread), mPassStates[thread] };
+		return draw;
+	}
 
-	// Bind the underwater render target view
-	ID3D11RenderTargetView* const targets[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
-	mContext->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());
+	DrawContext draw = { mContext.Get(), mStates };
+	return draw;
+}
 
+// The context a pass run on thread draws into, with the state every pass starts from bound
+ACW::Sample3DSceneRenderer::DrawContext ACW::Sample3DSceneRenderer::BeginPass(int thread)
+{
+	DrawContext draw = PassDrawContext(thread);
+	BindPassState(draw);
+	return draw;
+}
 
-	DrawVertexCoral();
+// The binds of the immediate context and of every deferred context together
+PlantStats ACW::Sample3DSceneRenderer::GetPlantStats() const
+{
+	PlantStats stats;
+	stats.instanceCount = mPlantInstanceCount;
+	stats.visibleCount = mPlantVisibleCount;
+	stats.culledCount = mPlantCulledCount;
+	stats.atlasMilliseconds = mPlantAtlasMilliseconds;
+	return stats;
+}
 
-	//Draw ray casted effects
-	DrawReflectiveBubbles();
+CoralMeshStats ACW::Sample3DSceneRenderer::GetCoralMeshStats() const
+{
+	CoralMeshStats stats;
+	stats.variantCount = mCoralMeshFirstLod.empty() ? 0 : static_cast<uint32>(mCoralMeshFirstLod.size() - 1);
+	stats.variantTriangles = mCoralVariantTriangles;
+	stats.variantMilliseconds = mCoralVariantMilliseconds;
+	stats.instanceCount = mCoralMeshInstanceCount;
+	stats.acmrBefore = mCoralAcmrBefore;
+	stats.acmrAfter = mCoralAcmrAfter;
+	stats.optimizeMilliseconds = mCoralOptimizeMilliseconds;
+	stats.vertexBytes = mCoralVertexBytes;
+	stats.floatVertexBytes = mCoralFloatVertexBytes;
+	stats.trianglesDrawn = mCoralMeshCullStats.trianglesKept;
+	return stats;
+}
 
-	//DrawImplicitShapes();
-	DrawImplicitCoral();
-	//DrawFractals();
+StateFilter::BindStats ACW::Sample3DSceneRenderer::GetStateBindStats() const
+{
+	StateFilter::BindStats stats = mStates.GetStats();
+	for (const StateFilter::FilteredContext<ID3D11DeviceContext3>& states : mPassStates)
+	{
+		for (int bind = 0; bind < StateFilter::BindCount; bind++)
+		{
+			stats.issued[bind] += states.GetStats().issued[bind];
+			stats.skipped[bind] += states.GetStats().skipped[bind];
+		}
+	}
+	return stats;
+}
 
+// Declares the passes of the frame with the targets they draw into and read. At full resolution the raymarched
+// passes draw straight into the back buffer, otherwise into reduced resolution targets the upsample composites.
+void ACW::Sample3DSceneRenderer::DeclareFrame()
+{
+	using namespace FrameGraph;
 
+	const float clearColour[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	// A material of -1 marks a miss
+	const float clearHit[4] = { -1.0f, -1.0f, 0.0f, 0.0f };
 
-	//Set linelist topology and draw snakes
-	mContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP);
-	//DrawSnakes();
+	Size outputSize = m_deviceResources->GetOutputSize();
+	const TextureDesc screenDesc = { static_cast<uint32_t>(outputSize.Width), static_cast<uint32_t>(outputSize.Height), Format::Rgba8Unorm };
+	const uint32_t marchWidth = static_cast<uint32_t>(ceilf(mRaymarchViewport.Width));
+	const uint32_t marchHeight = static_cast<uint32_t>(ceilf(mRaymarchViewport.Height));
+	const bool reduced = mRaymarchResolution != RaymarchResolution::Full;
+
+	mFrameGraph.Reset();
+	Resource backBuffer = mFrameGraph.Import("Back buffer", screenDesc, D3D11Backend::BackBuffer);
+	Resource depth = mFrameGraph.Import("Depth", { screenDesc.width, screenDesc.height, Format::Depth32Float }, D3D11Backend::DepthBuffer);
+	Resource raymarchColour = reduced ? mFrameGraph.Create("Raymarch colour", { marchWidth, marchHeight, Format::Rgba8Unorm }) : backBuffer;
+	Resource raymarchDepth = reduced ? mFrameGraph.Create("Raymarch depth", { marchWidth, marchHeight, Format::Depth32Float }) : depth;
+
+	auto sceneTargets = [&](PassBuilder& pass)
+	{
+		pass.Write(backBuffer);
+		pass.WriteDepth(depth);
+	};
+	auto raymarchTargets = [&](PassBuilder& pass)
+	{
+		pass.Write(raymarchColour);
+		pass.WriteDepth(raymarchDepth);
+		pass.SetViewport(mRaymarchViewport.Width, mRaymarchViewport.Height);
+	};
 
-	//Set control point patchlist topology and draw terrain and water
-	mContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
-	DrawTerrain();
-	DrawWater();
+	mFrameGraph.AddPass("Coral meshes", sceneTargets, [this](const PassContext& context)
+	{
+		DrawContext draw = BeginPass(context.Thread());
+		DrawVertexCoral(draw);
+	});
 
-	//Set pointlist topology and draw plants
-	mContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
-	DrawGeometryCorals();
+	//The bubbles are the first raymarched pass, so clear the reduced resolution targets for them
+	mFrameGraph.AddPass("Bubbles",
+		[&](PassBuilder& pass)
+		{
+			if (reduced)
+			{
+				pass.Clear(raymarchColour, clearColour);
+				pass.ClearDepth(raymarchDepth, 1.0f);
+				pass.SetViewport(mRaymarchViewport.Width, mRaymarchViewport.Height);
+			}
+			else
+			{
+				raymarchTargets(pass);
+			}
+		},
+		[this](const PassContext& context)
+		{
+			DrawContext draw = BeginPass(context.Thread());
+			DrawReflectiveBubbles(draw);
+		});
 
+	if (mDrawingCoralImpostor)
+	{
+		mFrameGraph.AddPass("Coral impostor", raymarchTargets, [this](const PassContext& context)
+		{
+			DrawContext draw = BeginPass(context.Thread());
+			DrawCoralImpostor(draw);
+		});
+	}
+	else
+	{
+		Resource cone = mFrameGraph.Create("Cone prepass", { static_cast<uint32_t>(ceilf(mConePrepassViewport.Width)), static_cast<uint32_t>(ceilf(mConePrepassViewport.Height)), Format::R32Float });
+		Resource hit = mFrameGraph.Create("Coral hits", { marchWidth, marchHeight, Format::Rg32Float });
 
-	DrawUnderWaterEffect();
+		//A start distance of 0 leaves the full resolution march unchanged
+		mFrameGraph.AddPass("Coral cone prepass",
+			[&](PassBuilder& pass)
+			{
+				pass.Clear(cone, clearColour);
+				pass.SetViewport(mConePrepassViewport.Width, mConePrepassViewport.Height);
+			},
+			[this](const PassContext& context)
+			{
+				DrawContext draw = BeginPass(context.Thread());
+				DrawConePrepass(draw);
+			});
 
+		mFrameGraph.AddPass("Coral march",
+			[&](PassBuilder& pass)
+			{
+				pass.Read(cone);
+				pass.Clear(hit, clearHit);
+				pass.SetViewport(mRaymarchViewport.Width, mRaymarchViewport.Height);
+			},
+			[this, cone](const PassContext& context)
+			{
+				DrawContext draw = BeginPass(context.Thread());
+				DrawCoralMarch(draw, mFrameGraphBackend.ShaderResource(context.Texture(cone)));
+			});
 
+		if (mCoralShadingRate == CoralShadingRate::Full)
+		{
+			mFrameGraph.AddPass("Coral shade",
+				[&](PassBuilder& pass)
+				{
+					pass.Read(hit);
+					raymarchTargets(pass);
+				},
+				[this, hit](const PassContext& context)
+				{
+					DrawContext draw = BeginPass(context.Thread());
+					DrawCoralShade(draw, mFrameGraphBackend.ShaderResource(context.Texture(hit)));
+				});
+		}
+		else
+		{
+			//Only whole blocks get a texel, the resolve gives partial blocks on the edges the colour of their neighbour
+			TextureDesc shadedDesc = { static_cast<uint32_t>(mCoralShadedViewport.Width), static_cast<uint32_t>(mCoralShadedViewport.Height), Format::Rgba8Unorm };
+			shadedDesc.width = shadedDesc.width > 0 ? shadedDesc.width : 1;
+			shadedDesc.height = shadedDesc.height > 0 ? shadedDesc.height : 1;
+			Resource shaded = mFrameGraph.Create("Coral shaded", shadedDesc);
+
+			mFrameGraph.AddPass("Coral shade",
+				[&](PassBuilder& pass)
+				{
+					pass.Read(hit);
+					pass.Clear(shaded, clearColour);
+					pass.SetViewport(mCoralShadedViewport.Width, mCoralShadedViewport.Height);
+				},
+				[this, hit](const PassContext& context)
+				{
+					DrawContext draw = BeginPass(context.Thread());
+					DrawCoralShade(draw, mFrameGraphBackend.ShaderResource(context.Texture(hit)));
+				});
+
+			mFrameGraph.AddPass("Coral resolve",
+				[&](PassBuilder& pass)
+				{
+					pass.Read(hit);
+					pass.Read(shaded);
+					raymarchTargets(pass);
+				},
+				[this, hit, shaded](const PassContext& context)
+				{
+					DrawContext draw = BeginPass(context.Thread());
+					DrawCoralResolve(draw, mFrameGraphBackend.ShaderResource(context.Texture(hit)), mFrameGraphBackend.ShaderResource(context.Texture(shaded)));
+				});
+		}
+	}
 
-	// Step 3: Rendering to the Screen
-//	mContext->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());
-	// Render the entire scene again (with the underwater effect applied) to the back buffer
+	//Composite the reduced resolution raymarch into the back buffer
+	if (reduced)
+	{
+		mFrameGraph.AddPass("Raymarch upsample",
+			[&](PassBuilder& pass)
+			{
+				pass.Read(raymarchColour);
+				pass.Read(raymarchDepth);
+				sceneTargets(pass);
+			},
+			[this, raymarchColour, raymarchDepth](const PassContext& context)
+			{
+				DrawContext draw = BeginPass(context.Thread());
+				DrawRaymarchUpsample(draw, mFrameGraphBackend.ShaderResource(context.Texture(raymarchColour)), mFrameGraphBackend.ShaderResource(context.Texture(raymarchDepth)));
+			});
+	}
 
+	//Terrain and water are tessellated from control point patches
+	mFrameGraph.AddPass("Terrain", sceneTargets, [this](const PassContext& context)
+	{
+		DrawContext draw = BeginPass(context.Thread());
+		draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
+		DrawTerrain(draw);
+	});
+	mFrameGraph.AddPass("Water", sceneTargets, [this](const PassContext& context)
+	{
+		DrawContext draw = BeginPass(context.Thread());
+		draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
+		DrawWater(draw);
+	});
+
+	//One billboard per plant in view, as a triangle strip
+	mFrameGraph.AddPass("Plants", sceneTargets, [this](const PassContext& context)
+	{
+		DrawContext draw = BeginPass(context.Thread());
+		draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		DrawGeometryCorals(draw);
+	});
 
-	//m_deviceResources->Present();
+	mFrameGraph.AddPass("Underwater", sceneTargets, [this](const PassContext& context)
+	{
+		DrawContext draw = BeginPass(context.Thread());
+		DrawUnderWaterEffect(draw);
+	});
 }
 
 /// <summary>
 /// 
 /// </summary>
-void ACW::Sample3DSceneRenderer::DrawReflectiveBubbles()
+void ACW::Sample3DSceneRenderer::DrawReflectiveBubbles(DrawContext& draw)
 {
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawReflectiveBubbles");
+
 	// Attach our vertex shader.
-	mContext->VSSetShader(
+	draw.states.VSSetShader(
 		mVertexShaderSpheres.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our pixel shader.
-	mContext->PSSetShader(
+	draw.states.PSSetShader(
 		mPixelShaderSpheres.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our geometry shader.
-	mContext->GSSetShader(
+	draw.states.GSSetShader(
 		nullptr,
 		nullptr,
 		0
 	);
 
 	// Draw the objects.
-	mContext->DrawIndexed(
+	draw.context->DrawIndexed(
 		m_indexCount,
 		0,
 		0
 	);
 }
 
-void ACW::Sample3DSceneRenderer::DrawVertexCoral()
+void ACW::Sample3DSceneRenderer::DrawVertexCoral(DrawContext& draw)
 {
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawVertexCoral");
+
+	if (mCoralMeshCullStats.trianglesKept == 0)
+	{
+		return;
+	}
+
+	//Mesh vertices in slot 0 and the corals placed on the sea bed in slot 1
+	ID3D11Buffer* const buffers[2] = { mCoralMeshVertexBuffer.Get(), mCoralMeshInstanceBuffer.Get() };
+	const UINT strides[2] = { sizeof(VertexQuantization::PackedVertex), sizeof(CoralMesh::Instance) };
+	const UINT offsets[2] = { 0, 0 };
+	draw.context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	draw.context->IASetIndexBuffer(mCoralMeshClusterIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+	draw.states.IASetInputLayout(mCoralMeshInputLayout.Get());
+	draw.context->VSSetConstantBuffers(2, 1, mCoralMeshBoundsBuffer.GetAddressOf());
+
 	// Attach our vertex shader.
-	mContext->VSSetShader(
+	draw.states.VSSetShader(
 		m_vertexShaderVertexCoral.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our pixel shader.
-	mContext->PSSetShader(
+	draw.states.PSSetShader(
 		m_pixelShaderVertexCoral.Get(),
 		nullptr,
 		0
 	);
 
-	//Draw the objects.
-	mContext->DrawIndexed(
-		m_indexCount,
-		0,
-		0
-	);
+	//One draw per coral with anything left after culling, the start instance picks its placement
+	for (size_t i = 0; i < mCoralMeshRanges.size(); i++)
+	{
+		const Meshlets::DrawRange& range = mCoralMeshRanges[i];
+		if (range.indexCount > 0)
+		{
+			const CoralMeshLod& lod = mCoralMeshLods[mCoralMeshPlacements[i].mesh];
+			draw.context->DrawIndexedInstanced(range.indexCount, 1, range.firstIndex, lod.baseVertex, static_cast<UINT>(i));
+		}
+	}
+
+	//Put back the cube the full screen passes draw with
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
+	draw.context->IASetVertexBuffers(0, 1, m_vertexBuffer.GetAddressOf(), &stride, &offset);
+	draw.context->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+	draw.states.IASetInputLayout(m_inputLayout.Get());
 }
 
-void ACW::Sample3DSceneRenderer::DrawUnderWaterEffect()
+void ACW::Sample3DSceneRenderer::DrawUnderWaterEffect(DrawContext& draw)
 {
-	//// Step 2: Apply Underwater Effect
-	ID3D11DepthStencilState* prevDepthStencilState;
-	UINT prevStencilRef;
-	mContext->OMGetDepthStencilState(&prevDepthStencilState, &prevStencilRef);
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawUnderWaterEffect");
 
-	// Create a custom depth stencil state that disables depth testing
-	D3D11_DEPTH_STENCIL_DESC depthStencilDesc;
-	ZeroMemory(&depthStencilDesc, sizeof(depthStencilDesc));
-	depthStencilDesc.DepthEnable = FALSE; // Disable depth testing
-	depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO; // Disable depth writing
-	depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS; // You may need to change this based on your scene
-	// ... Set other parameters as needed ...
-	ID3D11DepthStencilState* underwaterDepthStencilState;
-	m_deviceResources->GetD3DDevice()->CreateDepthStencilState(&depthStencilDesc, &underwaterDepthStencilState);
-	mContext->OMSetDepthStencilState(underwaterDepthStencilState, 0);
+	//// Step 2: Apply Underwater Effect
+	//Depth testing off, found in the state cache rather than made again every frame
+	draw.states.OMSetDepthStencilState(mUnderwaterDepthState, 0);
 
-	ID3D11RenderTargetView* const targets[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
+	//The tint is blended over the scene, whether or not the plants pass before it bound the same blend
+	draw.states.OMSetBlendState(mAlphaBlend.Get(), nullptr, 0xffffffff);
 
-	mContext->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());// Disable the render target
-	mContext->IASetInputLayout(m_inputLayout.Get());
-	mContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	draw.states.IASetInputLayout(m_inputLayout.Get());
+	draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 
 
@@ -377,7 +876,7 @@ void ACW::Sample3DSceneRenderer::DrawUnderWaterEffect()
 	//Setup cube vertices and indices
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
-	mContext->IASetVertexBuffers(
+	draw.context->IASetVertexBuffers(
 		0,
 		1,
 		m_fullScreenQuadVertexBuffer.GetAddressOf(),
@@ -385,77 +884,228 @@ void ACW::Sample3DSceneRenderer::DrawUnderWaterEffect()
 		&offset
 	);
 
-	mContext->IASetIndexBuffer(
+	draw.context->IASetIndexBuffer(
 		m_fullScreenQuadIndexBuffer.Get(),
 		DXGI_FORMAT_R16_UINT,
 		0
 	);
 
-	// Set the underwater texture as the pixel shader resource
-	mContext->PSSetShaderResources(0, 1, mUnderwaterTexture.GetAddressOf());
-	mContext->PSSetSamplers(0, 1, mSampler.GetAddressOf());
+	// Samples the first layer of the plant texture array, the grass sprite
+	draw.context->PSSetShaderResources(0, 1, mPlantTexture.GetAddressOf());
+	draw.states.PSSetSamplers(0, 1, mSampler.GetAddressOf());
 
 	// Attach our vertex shader.
-	mContext->VSSetShader(
+	draw.states.VSSetShader(
 		mVertexShaderUnderwater.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our pixel shader.
-	mContext->PSSetShader(
+	draw.states.PSSetShader(
 		mPixelShaderUnderwater.Get(),
 		nullptr,
 		0
 	);
 
 	// Draw the objects.
-	mContext->DrawIndexed(
+	draw.context->DrawIndexed(
 		6,
 		0,
 		0
 	);
+}
+
+// Cone marches the implicit coral per tile at low resolution, into the start distances the march reads
+void ACW::Sample3DSceneRenderer::DrawConePrepass(DrawContext& draw)
+{
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawConePrepass");
+
+
+	// Attach our vertex shader.
+	draw.states.VSSetShader(
+		m_vertexShaderImplicitCoral.Get(),
+		nullptr,
+		0
+	);
+
+	// Attach the cone prepass pixel shader.
+	draw.states.PSSetShader(
+		mPixelShaderConePrepass.Get(),
+		nullptr,
+		0
+	);
+
+	draw.context->DrawIndexed(
+		m_indexCount,
+		0,
+		0
+	);
+
+}
+
+// Marches each pixel from its tile's start distance into the hit buffer
+void ACW::Sample3DSceneRenderer::DrawCoralMarch(DrawContext& draw, ID3D11ShaderResourceView* startDistances)
+{
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawCoralMarch");
+
+	draw.context->PSSetShaderResources(0, 1, &startDistances);
+
+	// Attach our vertex shader.
+	draw.states.VSSetShader(
+		m_vertexShaderImplicitCoral.Get(),
+		nullptr,
+		0
+	);
+
+	// Attach the march pixel shader.
+	draw.states.PSSetShader(
+		mPixelShaderCoralMarch.Get(),
+		nullptr,
+		0
+	);
+
+	draw.context->DrawIndexed(
+		m_indexCount,
+		0,
+		0
+	);
+
+}
+
+// Lights the hits, straight into the raymarch targets at the full rate or one per block into the shaded target
+void ACW::Sample3DSceneRenderer::DrawCoralShade(DrawContext& draw, ID3D11ShaderResourceView* hits)
+{
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawCoralShade");
+
+	draw.context->PSSetShaderResources(0, 1, &hits);
+
+	// Attach our vertex shader.
+	draw.states.VSSetShader(
+		m_vertexShaderImplicitCoral.Get(),
+		nullptr,
+		0
+	);
+
+	// Attach our pixel shader.
+	draw.states.PSSetShader(
+		m_pixelShaderImplicitCoral.Get(),
+		nullptr,
+		0
+	);
+
+	//Draw the objects.
+	draw.context->DrawIndexed(
+		m_indexCount,
+		0,
+		0
+	);
+
+}
+
+// Spreads the lit blocks back over the pixels they cover
+void ACW::Sample3DSceneRenderer::DrawCoralResolve(DrawContext& draw, ID3D11ShaderResourceView* hits, ID3D11ShaderResourceView* shaded)
+{
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawCoralResolve");
+
+	ID3D11ShaderResourceView* const resources[2] = { hits, shaded };
+	draw.context->PSSetShaderResources(0, 2, resources);
+
+	// Attach our vertex shader.
+	draw.states.VSSetShader(
+		m_vertexShaderImplicitCoral.Get(),
+		nullptr,
+		0
+	);
+
+	// Attach the resolve pixel shader.
+	draw.states.PSSetShader(
+		mPixelShaderCoralResolve.Get(),
+		nullptr,
+		0
+	);
+
+	draw.context->DrawIndexed(
+		m_indexCount,
+		0,
+		0
+	);
+
+}
+
+// Draws the coral as a single quad that blends the baked views nearest the eye, into the same
+// targets as the coral passes.
+void ACW::Sample3DSceneRenderer::DrawCoralImpostor(DrawContext& draw)
+{
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawCoralImpostor");
+
+
+	draw.context->PSSetShaderResources(0, 1, mCoralImpostorTexture.GetAddressOf());
+	draw.states.PSSetSamplers(0, 1, mSampler.GetAddressOf());
+
+	// Attach the impostor shaders.
+	draw.states.VSSetShader(
+		mVertexShaderCoralImpostor.Get(),
+		nullptr,
+		0
+	);
+
+	draw.states.PSSetShader(
+		mPixelShaderCoralImpostor.Get(),
+		nullptr,
+		0
+	);
+
+	//Four corners from the vertex id, no vertex buffer needed
+	draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	draw.context->Draw(4, 0);
+	draw.states.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	mContext->OMSetDepthStencilState(prevDepthStencilState, prevStencilRef);
 }
 
 /// <summary>
 /// 
 /// </summary>
-void ACW::Sample3DSceneRenderer::DrawImplicitCoral()
+void ACW::Sample3DSceneRenderer::DrawRaymarchUpsample(DrawContext& draw, ID3D11ShaderResourceView* colour, ID3D11ShaderResourceView* depth)
 {
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawRaymarchUpsample");
+
+	ID3D11ShaderResourceView* const resources[2] = { colour, depth };
+	draw.context->PSSetShaderResources(0, 2, resources);
+
 	// Attach our vertex shader.
-	mContext->VSSetShader(
+	draw.states.VSSetShader(
 		m_vertexShaderImplicitCoral.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our pixel shader.
-	mContext->PSSetShader(
-		m_pixelShaderImplicitCoral.Get(),
+	draw.states.PSSetShader(
+		mPixelShaderUpsample.Get(),
 		nullptr,
 		0
 	);
 
 	//Draw the objects.
-	mContext->DrawIndexed(
+	draw.context->DrawIndexed(
 		m_indexCount,
 		0,
 		0
 	);
 }
 
-
 /// <summary>
 /// 
 /// </summary>
-void ACW::Sample3DSceneRenderer::DrawTerrain()
+void ACW::Sample3DSceneRenderer::DrawTerrain(DrawContext& draw)
 {
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawTerrain");
+
 	//Setup cube vertices and indices
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
-	mContext->IASetVertexBuffers(
+	draw.context->IASetVertexBuffers(
 		0,
 		1,
 		m_vertexBuffer.GetAddressOf(),
@@ -463,125 +1113,240 @@ void ACW::Sample3DSceneRenderer::DrawTerrain()
 		&offset
 	);
 
-	mContext->IASetIndexBuffer(
+	draw.context->IASetIndexBuffer(
 		m_indexBuffer.Get(),
 		DXGI_FORMAT_R16_UINT,
 		0
 	);
 
-	// Attach our vertex shader.
-	mContext->VSSetShader(
-		mVertexShaderTerrain.Get(),
-		nullptr,
-		0
-	);
+	// Attach our vertex shader.
+	draw.states.VSSetShader(
+		mVertexShaderTerrain.Get(),
+		nullptr,
+		0
+	);
+
+	// Attach our pixel shader.
+	draw.states.PSSetShader(
+		mPixelShaderTerrain.Get(),
+		nullptr,
+		0
+	);
+
+	// Attach our geometry shader.
+	draw.states.GSSetShader(
+		nullptr,
+		nullptr,
+		0
+	);
+
+	//Attach our domain shader
+	draw.states.DSSetShader(
+		mDomainShaderTerrain.Get(),
+		nullptr,
+		0
+	);
+
+	//Attach our hull shader
+	draw.states.HSSetShader(
+		mHullShaderTerrain.Get(),
+		nullptr,
+		0
+	);
+
+	// Draw the objects.
+	draw.context->DrawIndexed(
+		m_indexCount,
+		0,
+		0
+	);
+}
+
+/// <summary>
+/// 
+/// </summary>
+// Recomputes the combined and inverse camera matrices so the shaders do not have to
+void ACW::Sample3DSceneRenderer::UpdateDerivedMatrices()
+{
+	// The matrices are stored transposed for the shaders
+	XMMATRIX model = XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferDataCamera.fmodel));
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferDataCamera.view));
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferDataCamera.projection));
+	XMMATRIX viewProjection = XMMatrixMultiply(view, projection);
+
+	XMStoreFloat4x4(&m_constantBufferDataCamera.viewProjection, XMMatrixTranspose(viewProjection));
+	XMStoreFloat4x4(&m_constantBufferDataCamera.inverseViewProjection, XMMatrixTranspose(XMMatrixInverse(nullptr, viewProjection)));
+	XMStoreFloat4x4(&m_constantBufferDataCamera.inverseModel, XMMatrixTranspose(XMMatrixInverse(nullptr, model)));
+	mCameraDirty = false;
+}
+
+// Writes the plants inside the view frustum and the cut off distance to the instance buffer, sorted
+// back to front so the alpha blended billboards composite in order
+void ACW::Sample3DSceneRenderer::UpdatePlantInstances()
+{
+	mPlantVisibleCount = 0;
+	if (mPlantInstanceCount == 0)
+	{
+		return;
+	}
+
+	// Half diagonal of the billboard in GeometryCoralVertex.hlsl plus how far its top sways
+	const float plantRadius = 0.91f;
+	const float plantDistance = 40.0f;
+
+	// The view projection is stored transposed for the shaders
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferDataCamera.viewProjection)));
+
+	PlantCulling::CullView cullView;
+	cullView.frustum = PlantCulling::ExtractFrustum(&viewProjection.m[0][0]);
+	cullView.eye = ShaderMath::float3(m_constantBufferDataCamera.eye.x, m_constantBufferDataCamera.eye.y, m_constantBufferDataCamera.eye.z);
+	cullView.maxDistance = plantDistance;
+	cullView.boundingRadius = plantRadius;
+
+	mPlantVisibleCount = PlantCulling::Cull(mPlantPositions, cullView, mPlantVisible.data(), mPlantCullScratch, mWorkers, 0);
+	if (mPlantVisibleCount == 0)
+	{
+		return;
+	}
+
+	// Depth is along the view's z axis, the third row of the transposed view matrix
+	const XMFLOAT4X4& view = m_constantBufferDataCamera.view;
+	PlantSorting::SortView sortView;
+	sortView.eye = cullView.eye;
+	sortView.forward = ShaderMath::float3(view._31, view._32, view._33);
+	sortView.maxDepth = plantDistance + plantRadius;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(
+		mContext->Map(mPlantInstanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)
+	);
+	PlantSorting::SortBackToFront(mPlantVisible.data(), mPlantVisibleCount, sortView, static_cast<PlantInstances::PlantInstance*>(mapped.pData), mPlantSortScratch, mWorkers, 0);
+	mContext->Unmap(mPlantInstanceBuffer.Get(), 0);
+}
+
+// Chooses the coarsest level of detail of each coral whose error stays under a pixel on screen, then culls the
+// clusters of that level and writes the indices of those left to the cluster index buffer, a range per coral
+void ACW::Sample3DSceneRenderer::UpdateCoralMeshInstances()
+{
+	mCoralMeshCullStats = Meshlets::CullStats();
+	if (mCoralMeshInstances.empty())
+	{
+		return;
+	}
+
+	const float maxPixelError = 1.0f;
+
+	// Pixels a unit long object covers one unit in front of the eye
+	const float pixelsPerUnit = m_constantBufferDataCamera.projection._22 * 0.5f * m_deviceResources->GetOutputSize().Height;
+	const ShaderMath::float3 eye(m_constantBufferDataCamera.eye.x, m_constantBufferDataCamera.eye.y, m_constantBufferDataCamera.eye.z);
 
-	// Attach our pixel shader.
-	mContext->PSSetShader(
-		mPixelShaderTerrain.Get(),
-		nullptr,
-		0
-	);
+	for (size_t i = 0; i < mCoralMeshInstances.size(); i++)
+	{
+		const CoralMesh::Instance& instance = mCoralMeshInstances[i];
+		float distance = std::max(ShaderMath::length(instance.position - eye), 0.1f);
+		float pixelsPerError = instance.scale * pixelsPerUnit / distance;
 
-	// Attach our geometry shader.
-	mContext->GSSetShader(
-		nullptr,
-		nullptr,
-		0
-	);
+		uint32 lod = mCoralMeshFirstLod[instance.variant];
+		while (lod + 1 < mCoralMeshFirstLod[instance.variant + 1] && mCoralMeshLods[lod + 1].error * pixelsPerError <= maxPixelError)
+		{
+			lod++;
+		}
+		mCoralMeshPlacements[i].mesh = lod;
+	}
 
-	//Attach our domain shader
-	mContext->DSSetShader(
-		mDomainShaderTerrain.Get(),
-		nullptr,
-		0
-	);
+	// The view projection is stored transposed for the shaders
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferDataCamera.viewProjection)));
 
-	//Attach our hull shader
-	mContext->HSSetShader(
-		mHullShaderTerrain.Get(),
-		nullptr,
-		0
-	);
+	Meshlets::CullView cullView;
+	cullView.frustum = PlantCulling::ExtractFrustum(&viewProjection.m[0][0]);
+	cullView.eye = eye;
 
-	// Draw the objects.
-	mContext->DrawIndexed(
-		m_indexCount,
-		0,
-		0
+	auto start = std::chrono::steady_clock::now();
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(
+		mContext->Map(mCoralMeshClusterIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)
 	);
+	Meshlets::Cull(mCoralMeshlets, mCoralMeshPlacements.data(), mCoralMeshPlacements.size(), cullView, static_cast<uint16_t*>(mapped.pData), mCoralMeshRanges.data(), mCoralMeshCullScratch, mCoralMeshCullStats, mWorkers, 0);
+	mContext->Unmap(mCoralMeshClusterIndexBuffer.Get(), 0);
+	mCoralClusterCullMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 /// <summary>
 /// 
 /// </summary>
-void ACW::Sample3DSceneRenderer::DrawGeometryCorals()
+void ACW::Sample3DSceneRenderer::DrawGeometryCorals(DrawContext& draw)
 {
-	// Each vertex is one instance of the Vertex struct.
-	UINT stride = sizeof(Vertex);
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawGeometryCorals");
+
+	if (mPlantVisibleCount == 0)
+	{
+		return;
+	}
+
+	// Each instance is one PlantInstance, the quad corners come from SV_VertexID.
+	UINT stride = sizeof(PlantInstances::PlantInstance);
 	UINT offset = 0;
-	mContext->IASetVertexBuffers(
+	draw.context->IASetVertexBuffers(
 		0,
 		1,
-		mPlantVertexBuffer.GetAddressOf(),
+		mPlantInstanceBuffer.GetAddressOf(),
 		&stride,
 		&offset
 	);
 
-	mContext->IASetIndexBuffer(
-		mPlantIndexBuffer.Get(),
-		DXGI_FORMAT_R16_UINT, // Each index is one 16-bit unsigned integer (short).
-		0
-	);
+	draw.states.IASetInputLayout(mPlantInputLayout.Get());
 
 	// Attach our vertex shader.
-	mContext->VSSetShader(
+	draw.states.VSSetShader(
 		mVertexShaderPlants.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our pixel shader.
-	mContext->PSSetShader(
+	draw.states.PSSetShader(
 		mPixelShaderPlants.Get(),
 		nullptr,
 		0
 	);
 
-	mContext->PSSetShaderResources(0, 1, mPlantTexture.GetAddressOf());
+	draw.context->PSSetShaderResources(0, 1, mPlantTexture.GetAddressOf());
 
-	mContext->PSSetSamplers(0, 1, mSampler.GetAddressOf());
+	draw.states.PSSetSamplers(0, 1, mSampler.GetAddressOf());
 
 	//Set depth stencil
-	mContext->OMSetDepthStencilState(mDepthLessThanEqual.Get(), 0);
+	draw.states.OMSetDepthStencilState(mDepthLessThanEqual.Get(), 0);
 
 	//Set blend state
-	mContext->OMSetBlendState(mAlphaBlend.Get(), 0, 0xffffffff);
+	draw.states.OMSetBlendState(mAlphaBlend.Get(), 0, 0xffffffff);
 
 	// Attach our geometry shader.
-	mContext->GSSetShader(
-		mGeometryShaderPlants.Get(),
+	draw.states.GSSetShader(
+		nullptr,
 		nullptr,
 		0
 	);
 
 	//Attach our domain shader
-	mContext->DSSetShader(
+	draw.states.DSSetShader(
 		nullptr,
 		nullptr,
 		0
 	);
 
 	//Attach our hull shader
-	mContext->HSSetShader(
+	draw.states.HSSetShader(
 		nullptr,
 		nullptr,
 		0
 	);
 
 	// Draw the objects.
-	mContext->DrawIndexed(
-		mPlantIndex,
+	draw.context->DrawInstanced(
+		4,
+		mPlantVisibleCount,
 		0,
 		0
 	);
@@ -591,38 +1356,40 @@ void ACW::Sample3DSceneRenderer::DrawGeometryCorals()
 /// <summary>
 /// 
 /// </summary>
-void ACW::Sample3DSceneRenderer::DrawWater()
+void ACW::Sample3DSceneRenderer::DrawWater(DrawContext& draw)
 {
+	Profiler::D3D11Scope profile(&mGpuTimer, draw.context, "DrawWater");
+
 	// Attach our vertex shader.
-	mContext->VSSetShader(
+	draw.states.VSSetShader(
 		mVertexShaderWater.Get(),
 		nullptr,
 		0
 	);
 
 	// Attach our pixel shader.
-	mContext->PSSetShader(
+	draw.states.PSSetShader(
 		mPixelShaderWater.Get(),
 		nullptr,
 		0
 	);
 
 	//Attach our domain shader
-	mContext->DSSetShader(
+	draw.states.DSSetShader(
 		mDomainShaderWater.Get(),
 		nullptr,
 		0
 	);
 
 	//Attach our hull shader
-	mContext->HSSetShader(
+	draw.states.HSSetShader(
 		mHullShaderWater.Get(),
 		nullptr,
 		0
 	);
 
 	// Draw the objects.
-	mContext->DrawIndexed(
+	draw.context->DrawIndexed(
 		m_indexCount,
 		0,
 		0
@@ -634,113 +1401,8 @@ void ACW::Sample3DSceneRenderer::DrawWater()
 /// </summary>
 void ACW::Sample3DSceneRenderer::CreateBuffers()
 {
-	//Constant buffer for camera data
-	CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	DX::ThrowIfFailed(
-		m_deviceResources->GetD3DDevice()->CreateBuffer(
-			&constantBufferDesc,
-			nullptr,
-			&m_constantBufferCamera
-		)
-	);
-
-	//Constant buffer for light data
-	constantBufferDesc = CD3D11_BUFFER_DESC(sizeof(LightConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	DX::ThrowIfFailed(
-		m_deviceResources->GetD3DDevice()->CreateBuffer(
-			&constantBufferDesc,
-			nullptr,
-			&mConstantBufferLight
-		)
-	);
-
-	//Constant buffer for time data
-	constantBufferDesc = CD3D11_BUFFER_DESC(sizeof(TimeConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	DX::ThrowIfFailed(
-		m_deviceResources->GetD3DDevice()->CreateBuffer(
-			&constantBufferDesc,
-			nullptr,
-			&mConstantBufferTime
-		)
-	);
-}
-
-/// <summary>
-/// 
-/// </summary>
-void ACW::Sample3DSceneRenderer::SetBuffers()
-{
-	//Camera buffer for vertex shader
-	mContext->VSSetConstantBuffers1(
-		0,
-		1,
-		m_constantBufferCamera.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Camera buffer for pixel shader
-	mContext->PSSetConstantBuffers1(
-		0,
-		1,
-		m_constantBufferCamera.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Camera buffer for geometry shader
-	mContext->GSSetConstantBuffers1(
-		0,
-		1,
-		m_constantBufferCamera.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Camera buffer for domain shader
-	mContext->DSSetConstantBuffers1(
-		0,
-		1,
-		m_constantBufferCamera.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Light buffer for pixel shader
-	mContext->PSSetConstantBuffers1(
-		1,
-		1,
-		mConstantBufferLight.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Time buffer for Vertex shader
-	mContext->VSSetConstantBuffers1(
-		1,
-		1,
-		mConstantBufferTime.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Time buffer for Geometry shader
-	mContext->GSSetConstantBuffers1(
-		1,
-		1,
-		mConstantBufferTime.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
-
-	//Time buffer for Domain shader
-	mContext->DSSetConstantBuffers1(
-		1,
-		1,
-		mConstantBufferTime.GetAddressOf(),
-		nullptr,
-		nullptr
-	);
+	//Camera, light, time and upsample constants share one dynamic buffer
+	mConstants.CreateBuffer();
 }
 
 /// <summary>
@@ -748,38 +1410,12 @@ void ACW::Sample3DSceneRenderer::SetBuffers()
 /// </summary>
 void ACW::Sample3DSceneRenderer::UpdateBuffers()
 {
-	//Update camera buffer
-	mContext->UpdateSubresource1(
-		m_constantBufferCamera.Get(),
-		0,
-		NULL,
-		&m_constantBufferDataCamera,
-		0,
-		0,
-		0
-	);
-
-	//Update light buffer
-	mContext->UpdateSubresource1(
-		mConstantBufferLight.Get(),
-		0,
-		NULL,
-		&mConstantBufferDataLight,
-		0,
-		0,
-		0
-	);
-
-	//Update time buffer
-	mContext->UpdateSubresource1(
-		mConstantBufferTime.Get(),
-		0,
-		NULL,
-		&mConstantBufferDataTime,
-		0,
-		0,
-		0
-	);
+	//Only the blocks whose data changed are written, and bound where they were written
+	mConstants.Set(mCameraBlock, &m_constantBufferDataCamera);
+	mConstants.Set(mLightBlock, &mConstantBufferDataLight);
+	mConstants.Set(mTimeBlock, &mConstantBufferDataTime);
+	mConstants.Set(mUpsampleBlock, &mConstantBufferDataUpsample);
+	mConstants.Upload(mContext.Get());
 }
 
 /// <summary>
@@ -799,11 +1435,11 @@ void ACW::Sample3DSceneRenderer::CreateBlendStates()
 	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
 	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
-	m_deviceResources->GetD3DDevice()->CreateBlendState(&blendDesc, mAlphaBlend.GetAddressOf());
+	mAlphaBlend = mStateCache.GetBlendState(blendDesc);
 
 	//Blend state for no blending
 	blendDesc.RenderTarget[0].BlendEnable = FALSE;
-	m_deviceResources->GetD3DDevice()->CreateBlendState(&blendDesc, mNoBlend.GetAddressOf());
+	mNoBlend = mStateCache.GetBlendState(blendDesc);
 }
 
 /// <summary>
@@ -818,7 +1454,7 @@ void ACW::Sample3DSceneRenderer::CreateDepthStencils()
 	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
 	dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
 
-	m_deviceResources->GetD3DDevice()->CreateDepthStencilState(&dsDesc, mDepthLessThanEqual.GetAddressOf());
+	mDepthLessThanEqual = mStateCache.GetDepthStencilState(dsDesc);
 
 	//Create depth stencil for depth blending
 	ZeroMemory(&dsDesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
@@ -826,7 +1462,24 @@ void ACW::Sample3DSceneRenderer::CreateDepthStencils()
 	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
 	dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
 
-	m_deviceResources->GetD3DDevice()->CreateDepthStencilState(&dsDesc, mDepthLessThanEqualAll.GetAddressOf());
+	mDepthLessThanEqualAll = mStateCache.GetDepthStencilState(dsDesc);
+
+	//Made now so the first underwater frame finds it
+	UnderwaterDepthState();
+}
+
+/// <summary>
+/// Depth testing and writing off, for the underwater effect drawn over the whole scene
+/// </summary>
+ID3D11DepthStencilState* ACW::Sample3DSceneRenderer::UnderwaterDepthState()
+{
+	D3D11_DEPTH_STENCIL_DESC dsDesc;
+	ZeroMemory(&dsDesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
+	dsDesc.DepthEnable = FALSE;
+	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
+
+	return mStateCache.GetDepthStencilState(dsDesc);
 }
 
 /// <summary>
@@ -837,12 +1490,12 @@ void ACW::Sample3DSceneRenderer::CreateRasteriserStates()
 	//Wireframe rasteriser
 	D3D11_RASTERIZER_DESC rasterizerDesc = CD3D11_RASTERIZER_DESC(D3D11_DEFAULT);
 	rasterizerDesc.FillMode = D3D11_FILL_WIREFRAME;
-	m_deviceResources->GetD3DDevice()->CreateRasterizerState(&rasterizerDesc, mWireframeRasteriser.GetAddressOf());
+	mWireframeRasteriser = mStateCache.GetRasterizerState(rasterizerDesc);
 
 	//Default rasteriser
 	rasterizerDesc = CD3D11_RASTERIZER_DESC(D3D11_DEFAULT);
 	rasterizerDesc.CullMode = D3D11_CULL_NONE;
-	m_deviceResources->GetD3DDevice()->CreateRasterizerState(&rasterizerDesc, mDefaultRasteriser.GetAddressOf());
+	mDefaultRasteriser = mStateCache.GetRasterizerState(rasterizerDesc);
 }
 
 /// <summary>
@@ -858,7 +1511,7 @@ void ACW::Sample3DSceneRenderer::CreateSamplerState()
 	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
 	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
 	sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-	m_deviceResources->GetD3DDevice()->CreateSamplerState(&sampDesc, mSampler.GetAddressOf());
+	mSampler = mStateCache.GetSamplerState(sampDesc);
 }
 
 /// <summary>
@@ -873,11 +1526,19 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 	CreateRasteriserStates();
 	CreateSamplerState();
 	CreateUnderwaterRenderTarget();
+	mGpuTimer.CreateQueries();
+	CreateRecordingContexts();
 
 	//Load shaders asynchronously
 	//Implicit primitives shaders
 	auto loadVSTaskPrimitives = DX::ReadDataAsync(L"ImplicitCoralVertex.cso");
 	auto loadPSTaskPrimitives = DX::ReadDataAsync(L"ImplicitCoralPixel.cso");
+	auto loadPSTaskConePrepass = DX::ReadDataAsync(L"ImplicitCoralConePrepass.cso");
+	auto loadPSTaskCoralMarch = DX::ReadDataAsync(L"ImplicitCoralMarchPixel.cso");
+	auto loadPSTaskCoralResolve = DX::ReadDataAsync(L"ImplicitCoralResolvePixel.cso");
+	auto loadVSTaskCoralImpostor = DX::ReadDataAsync(L"CoralImpostorVertex.cso");
+	auto loadPSTaskCoralImpostor = DX::ReadDataAsync(L"CoralImpostorPixel.cso");
+	auto loadPSTaskUpsample = DX::ReadDataAsync(L"RaymarchUpsamplePixel.cso");
 
 	auto loadVSTaskUnderwater = DX::ReadDataAsync(L"SampleVertexShader.cso");
 	auto loadPSTaskUnderwater = DX::ReadDataAsync(L"SamplePixelShader.cso");
@@ -904,7 +1565,6 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 	//Plants shaders
 	auto loadVSTaskPlants = DX::ReadDataAsync(L"GeometryCoralVertex.cso");
 	auto loadPSTaskPlants = DX::ReadDataAsync(L"GeometryCoralPixel.cso");
-	auto loadGSTaskPlants = DX::ReadDataAsync(L"GeometryCoralGeometry.cso");
 
 
 
@@ -951,6 +1611,126 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 		);
 	});
 
+	//After the cone prepass shader file is loaded, create the shader.
+	auto ConePrepassPSTask = loadPSTaskConePrepass.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreatePixelShader(
+				&fileData[0],
+				fileData.size(),
+				nullptr,
+				&mPixelShaderConePrepass
+			)
+		);
+	});
+
+	//After the coral march shader file is loaded, create the shader.
+	auto CoralMarchPSTask = loadPSTaskCoralMarch.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreatePixelShader(
+				&fileData[0],
+				fileData.size(),
+				nullptr,
+				&mPixelShaderCoralMarch
+			)
+		);
+	});
+
+	//After the coral resolve shader file is loaded, create the shader.
+	auto CoralResolvePSTask = loadPSTaskCoralResolve.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreatePixelShader(
+				&fileData[0],
+				fileData.size(),
+				nullptr,
+				&mPixelShaderCoralResolve
+			)
+		);
+	});
+
+	//After the coral impostor shader files are loaded, create the shaders.
+	auto CoralImpostorVSTask = loadVSTaskCoralImpostor.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateVertexShader(
+				&fileData[0],
+				fileData.size(),
+				nullptr,
+				&mVertexShaderCoralImpostor
+			)
+		);
+	});
+
+	auto CoralImpostorPSTask = loadPSTaskCoralImpostor.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreatePixelShader(
+				&fileData[0],
+				fileData.size(),
+				nullptr,
+				&mPixelShaderCoralImpostor
+			)
+		);
+	});
+
+	//Load the coral impostor a previous run saved, or bake it and save it for the next one. Loading does
+	//not wait for it, the coral is marched until it is ready, and goes on being marched if it fails
+	std::wstring impostorPack = L"CoralImpostor" + std::to_wstring(CoralImpostor::PackVersion) + L".dds";
+	uint32 generation = mDeviceGeneration;
+	DX::ReadLocalDataAsync(impostorPack).then([this, impostorPack](std::vector<byte> pack) {
+		if (pack.empty())
+		{
+			auto start = std::chrono::steady_clock::now();
+			pack = CoralImpostor::BakePack(CoralImpostor::DefaultSettings(), 0);
+			mCoralImpostorBakeMilliseconds.store(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			//A failed save only means baking again next run
+			DX::WriteLocalDataAsync(impostorPack, pack).then([](Concurrency::task<void> saved) {
+				try
+				{
+					saved.get();
+				}
+				catch (Platform::Exception^)
+				{
+				}
+			});
+		}
+
+		return pack;
+	}, Concurrency::task_continuation_context::use_arbitrary()).then([this, generation](Concurrency::task<std::vector<byte>> loaded) {
+		try
+		{
+			std::vector<byte> pack = loaded.get();
+			ComPtr<ID3D11ShaderResourceView> texture;
+			DX::ThrowIfFailed(
+				CreateDDSTextureFromMemory(m_deviceResources->GetD3DDevice(), &pack[0], pack.size(), nullptr, texture.GetAddressOf())
+			);
+
+			//Dropped if the device it was made on has been released since
+			std::lock_guard<std::mutex> lock(mCoralImpostorLock);
+			if (generation == mDeviceGeneration)
+			{
+				mCoralImpostorTexture = texture;
+				mCoralImpostorReady.store(true, std::memory_order_release);
+			}
+		}
+		catch (Platform::Exception^)
+		{
+		}
+		catch (const std::exception&)
+		{
+		}
+	}, Concurrency::task_continuation_context::use_arbitrary());
+
+	//After the upsample shader file is loaded, create the shader.
+	auto UpsamplePSTask = loadPSTaskUpsample.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreatePixelShader(
+				&fileData[0],
+				fileData.size(),
+				nullptr,
+				&mPixelShaderUpsample
+			)
+		);
+	});
+
 #pragma endregion
 
 #pragma region Terrain
@@ -1092,31 +1872,43 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 				&mVertexShaderPlants
 			)
 		);
-	});
 
-	//Load plant texture from file
-	auto hr = CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"grass.dds", nullptr, mPlantTexture.GetAddressOf());
+		//One position per plant instance
+		static const D3D11_INPUT_ELEMENT_DESC instanceDesc[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "SPECIES", 0, DXGI_FORMAT_R32_UINT, 0, 12, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
 
-	//After the pixel shader file is loaded, create the shader
-	auto PlantsPSTask = loadPSTaskPlants.then([this](const std::vector<byte>& fileData) {
 		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreatePixelShader(
+			m_deviceResources->GetD3DDevice()->CreateInputLayout(
+				instanceDesc,
+				ARRAYSIZE(instanceDesc),
 				&fileData[0],
 				fileData.size(),
-				nullptr,
-				&mPixelShaderPlants
+				&mPlantInputLayout
 			)
 		);
 	});
 
-	//After the geometry shader file is loaded, create the shader
-	auto PlantsGSTask = loadGSTaskPlants.then([this](const std::vector<byte>& fileData) {
+	//Build the plant texture array from the grass sprite, one layer per species, shared with the underwater pass
+	auto createPlantTextureTask = DX::ReadDataAsync(L"grass.dds").then([this](const std::vector<byte>& fileData) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<uint8_t> pack = PlantAtlas::BuildSpeciesPack(&fileData[0], fileData.size());
 		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateGeometryShader(
+			CreateDDSTextureFromMemory(m_deviceResources->GetD3DDevice(), &pack[0], pack.size(), nullptr, mPlantTexture.ReleaseAndGetAddressOf())
+		);
+		mPlantAtlasMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	});
+
+	//After the pixel shader file is loaded, create the shader
+	auto PlantsPSTask = loadPSTaskPlants.then([this](const std::vector<byte>& fileData) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreatePixelShader(
 				&fileData[0],
 				fileData.size(),
 				nullptr,
-				&mGeometryShaderPlants
+				&mPixelShaderPlants
 			)
 		);
 	});
@@ -1136,9 +1928,6 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 		);
 		});
 
-	//Load plant texture from file
-	auto loadUnderwaterTextureTask = CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"grass.dds", nullptr, mUnderwaterTexture.GetAddressOf());
-
 	//After the pixel shader file is loaded, create the shader
 	auto UnderWaterPSTask = loadPSTaskUnderwater.then([this](const std::vector<byte>& fileData) {
 		DX::ThrowIfFailed(
@@ -1166,6 +1955,28 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 				&m_vertexShaderVertexCoral
 			)
 		);
+
+		//Packed position and normal per vertex, then where each coral stands, its size, its turn about the vertical
+		//and the variant whose bounding box its positions are normalised within
+		static const D3D11_INPUT_ELEMENT_DESC coralDesc[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "INSTANCEPOSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "SCALE", 0, DXGI_FORMAT_R32_FLOAT, 1, 12, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "ANGLE", 0, DXGI_FORMAT_R32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "VARIANT", 0, DXGI_FORMAT_R32_UINT, 1, 20, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateInputLayout(
+				coralDesc,
+				ARRAYSIZE(coralDesc),
+				&fileData[0],
+				fileData.size(),
+				&mCoralMeshInputLayout
+			)
+		);
 		});
 
 	//After the pixel shader file is loaded, create the shader
@@ -1184,7 +1995,8 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 #pragma endregion
 
 	//Once the shaders using the cube vertices are loaded, load the cube vertices
-	auto createCubeTask = (ImplicitPrimitivesPSTask && ImplicitPrimitivesVSTask
+	auto createCubeTask = (ImplicitPrimitivesPSTask && ImplicitPrimitivesVSTask && ConePrepassPSTask && UpsamplePSTask
+		&& CoralMarchPSTask && CoralResolvePSTask && CoralImpostorVSTask && CoralImpostorPSTask
 		&& TerrainVSTask && TerrainPSTask && TerrainDSTask && TerrainHSTask
 		&& WaterVSTask && WaterPSTask && WaterDSTask && WaterHSTask
 		&& SpheresVSTask && SpheresPSTask && VertexCoralVSTask && VertexCoralPSTask).then([this]() {
@@ -1300,59 +2112,138 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 
 
 
-	//Once the shaders using the plant vertices are loaded, load the plant vertices
-	auto createPlantsTask = (PlantsVSTask && PlantsPSTask && PlantsGSTask).then([this]() {
+	//Once the plant shaders are loaded, scatter the plants and make room for all of them, the ones in view are written each frame
+	auto createPlantsTask = (PlantsVSTask && PlantsPSTask).then([this]() {
 
-		static std::vector<Vertex> plantVertices;
-		static std::vector<unsigned short> plantIndices;
+		//The height is evaluated once here instead of by every vertex each frame
+		PlantScatter::ScatterResult plants = PlantScatter::Scatter(PlantScatter::DefaultSettings());
+		mPlantInstanceCount = static_cast<uint32>(plants.instances.size());
+		mPlantCulledCount = plants.heightRejected + plants.slopeRejected;
 
-		for (int i = -20; i < 21; i++)
+		if (plants.instances.empty())
 		{
-			for (int j = -20; j < 21; j++)
-			{
-				plantVertices.emplace_back(Vertex{ XMFLOAT3(i, 0, j) });
-			}
+			return;
 		}
 
-		for (int i = 0; i < plantVertices.size(); i++)
-		{
-			plantIndices.push_back(i);
-		}
+		mPlantPositions = PlantCulling::SplitPositions(plants.instances);
+		mPlantVisible.resize(plants.instances.size());
 
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = &(plantVertices[0]);
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(Vertex) * plantVertices.size(), D3D11_BIND_VERTEX_BUFFER);
+		CD3D11_BUFFER_DESC instanceBufferDesc(sizeof(PlantInstances::PlantInstance) * plants.instances.size(), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
 		DX::ThrowIfFailed(
 			m_deviceResources->GetD3DDevice()->CreateBuffer(
-				&vertexBufferDesc,
-				&vertexBufferData,
-				&mPlantVertexBuffer
+				&instanceBufferDesc,
+				nullptr,
+				&mPlantInstanceBuffer
 			)
 		);
+	});
 
-		mPlantIndex = plantIndices.size();
 
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = &(plantIndices[0]);
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned short) * plantIndices.size(), D3D11_BIND_INDEX_BUFFER);
+
+	//Once the coral mesh shaders are loaded, grow the coral variants in parallel, optimise them, build their
+	//levels of detail and split each into clusters, and put every variant's vertices in a single buffer
+	auto createCoralMeshTask = (VertexCoralVSTask && VertexCoralPSTask).then([this]() {
+		const int variantCount = CoralMeshMaxVariants;
+		std::vector<CoralMesh::Variant> variants = CoralMesh::GenerateVariants(CoralMesh::DefaultSettings(), 1u, variantCount, 0);
+		CoralMesh::OptimizeVariants(variants, MeshOptimizer::DefaultSettings(), 0);
+		CoralMesh::BuildVariantMeshlets(variants, 0);
+		std::vector<CoralMesh::Instance> instances = CoralMesh::PlaceOnSeabed(variantCount, 1u);
+		mCoralMeshInstanceCount = static_cast<uint32>(instances.size());
+
+		std::vector<VertexQuantization::PackedVertex> vertices;
+		CoralMeshBoundsConstantBuffer bounds = {};
+		std::vector<CoralMeshLod> lods;
+		std::vector<Meshlets::MeshletMesh> meshlets;
+		std::vector<uint32> firstLod;
+		double milliseconds = 0.0;
+		double optimizeMilliseconds = 0.0;
+		double acmrBefore = 0.0;
+		double acmrAfter = 0.0;
+		uint32 triangles = 0;
+		for (int i = 0; i < variantCount; i++)
+		{
+			const CoralMesh::Mesh& mesh = variants[i].mesh;
+			firstLod.push_back(static_cast<uint32>(lods.size()));
+			for (const MeshOptimizer::Lod& level : mesh.lods)
+			{
+				CoralMeshLod lod;
+				lod.baseVertex = static_cast<int32>(vertices.size());
+				lod.error = level.error;
+				lods.push_back(lod);
+			}
+			meshlets.insert(meshlets.end(), variants[i].meshlets.begin(), variants[i].meshlets.end());
+			triangles += mesh.lods[0].indexCount / 3;
+
+			//Positions are normalised within the variant's own box, which the vertex shader looks up by the instance's variant
+			size_t firstVertex = vertices.size();
+			vertices.resize(firstVertex + mesh.vertices.size());
+			VertexQuantization::Bounds box = VertexQuantization::ComputeBounds(&mesh.vertices[0].position, sizeof(CoralMesh::Vertex), mesh.vertices.size());
+			VertexQuantization::EncodeBatch(&mesh.vertices[0].position, &mesh.vertices[0].normal, nullptr, sizeof(CoralMesh::Vertex), mesh.vertices.size(), box, &vertices[firstVertex]);
+			bounds.minimum[i] = XMFLOAT4(box.minimum.x, box.minimum.y, box.minimum.z, 0.0f);
+			bounds.extent[i] = XMFLOAT4(box.extent.x, box.extent.y, box.extent.z, 0.0f);
+
+			milliseconds += variants[i].milliseconds;
+			optimizeMilliseconds += variants[i].optimization.milliseconds;
+			acmrBefore += variants[i].optimization.cacheBefore.acmr;
+			acmrAfter += variants[i].optimization.cacheAfter.acmr;
+		}
+		firstLod.push_back(static_cast<uint32>(lods.size()));
+		mCoralVariantTriangles = triangles / variantCount;
+		mCoralVariantMilliseconds = static_cast<float>(milliseconds / variantCount);
+		mCoralOptimizeMilliseconds = static_cast<float>(optimizeMilliseconds / variantCount);
+		mCoralAcmrBefore = static_cast<float>(acmrBefore / variantCount);
+		mCoralAcmrAfter = static_cast<float>(acmrAfter / variantCount);
+		mCoralVertexBytes = static_cast<uint32>(sizeof(VertexQuantization::PackedVertex) * vertices.size());
+		mCoralFloatVertexBytes = static_cast<uint32>(sizeof(CoralMesh::Vertex) * vertices.size());
+
+		D3D11_SUBRESOURCE_DATA vertexBufferData = { vertices.data(), 0, 0 };
+		CD3D11_BUFFER_DESC vertexBufferDesc(mCoralVertexBytes, D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
 		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateBuffer(
-				&indexBufferDesc,
-				&indexBufferData,
-				&mPlantIndexBuffer
-			)
+			m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &mCoralMeshVertexBuffer)
 		);
-	});
 
+		D3D11_SUBRESOURCE_DATA boundsBufferData = { &bounds, 0, 0 };
+		CD3D11_BUFFER_DESC boundsBufferDesc(sizeof(CoralMeshBoundsConstantBuffer), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateBuffer(&boundsBufferDesc, &boundsBufferData, &mCoralMeshBoundsBuffer)
+		);
+
+		//Every coral starts at the full level of detail, UpdateCoralMeshInstances picks its level each frame
+		std::vector<Meshlets::Placement> placements(instances.size());
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			placements[i].position = instances[i].position;
+			placements[i].scale = instances[i].scale;
+			placements[i].angle = instances[i].angle;
+			placements[i].mesh = firstLod[instances[i].variant];
+		}
+
+		//The instances never move, the cluster indices are rewritten each frame with room for every coral at full detail
+		if (!instances.empty())
+		{
+			D3D11_SUBRESOURCE_DATA instanceBufferData = { instances.data(), 0, 0 };
+			CD3D11_BUFFER_DESC instanceBufferDesc(static_cast<UINT>(sizeof(CoralMesh::Instance) * instances.size()), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+			DX::ThrowIfFailed(
+				m_deviceResources->GetD3DDevice()->CreateBuffer(&instanceBufferDesc, &instanceBufferData, &mCoralMeshInstanceBuffer)
+			);
+
+			size_t clusterIndexCount = Meshlets::MaxIndexCount(meshlets, placements.data(), placements.size());
+			CD3D11_BUFFER_DESC clusterIndexBufferDesc(static_cast<UINT>(sizeof(uint16_t) * clusterIndexCount), D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+			DX::ThrowIfFailed(
+				m_deviceResources->GetD3DDevice()->CreateBuffer(&clusterIndexBufferDesc, nullptr, &mCoralMeshClusterIndexBuffer)
+			);
+		}
 
+		mCoralMeshRanges.resize(instances.size());
+		mCoralMeshInstances = instances;
+		mCoralMeshPlacements = placements;
+		mCoralMeshLods = lods;
+		mCoralMeshlets = meshlets;
+		mCoralMeshFirstLod = firstLod;
+	});
 
 	//Once all vertices are loaded, set buffers and set loading complete to true
-	auto complete = (createCubeTask && createPlantsTask ).then([this]() {
-		SetBuffers();
+	auto complete = (createCubeTask && createPlantsTask && createPlantTextureTask && createCoralMeshTask).then([this]() {
 		m_loadingComplete = true;
 	});
 }
@@ -1363,8 +2254,34 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 void Sample3DSceneRenderer::ReleaseDeviceDependentResources()
 {
 	m_loadingComplete = false;
+	mFrameGraph.ReleaseTextures(mFrameGraphBackend);
+	mStateCache.Clear();
+	for (StateFilter::FilteredContext<ID3D11DeviceContext3>& states : mPassStates)
+	{
+		states.SetContext(nullptr);
+	}
+	mRecorder.ReleaseContexts();
+	mGpuTimer.ReleaseQueries();
+	{
+		std::lock_guard<std::mutex> lock(mCoralImpostorLock);
+		mDeviceGeneration++;
+		mCoralImpostorReady.store(false);
+		mCoralImpostorTexture.Reset();
+	}
+	mCoralMeshCullStats = Meshlets::CullStats();
+	mCoralMeshLods.clear();
+	mCoralMeshFirstLod.clear();
+	mCoralMeshlets.clear();
+	mCoralMeshInstances.clear();
+	mCoralMeshPlacements.clear();
+	mCoralMeshRanges.clear();
+	mCoralMeshVertexBuffer.Reset();
+	mCoralMeshClusterIndexBuffer.Reset();
+	mCoralMeshInstanceBuffer.Reset();
+	mCoralMeshBoundsBuffer.Reset();
+	mCoralMeshInputLayout.Reset();
 	m_inputLayout.Reset();
-	m_constantBufferCamera.Reset();
+	mConstants.ReleaseBuffer();
 	m_vertexBuffer.Reset();
 	m_indexBuffer.Reset();
 }
\ No newline at end of file
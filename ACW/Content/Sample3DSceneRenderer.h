@@ -3,11 +3,78 @@
 #include "..\Common\DeviceResources.h"
 #include "ShaderStructures.h"
 #include "..\Common\StepTimer.h"
+#include <atomic>
+#include <mutex>
 #include <vector>
 #include "DDSTextureLoader.h"
+#include "PlantCulling.h"
+#include "PlantSorting.h"
+#include "CoralMesh.h"
+#include "Meshlets.h"
+#include "FrameGraphD3D11.h"
+#include "StateFilter.h"
+#include "StateCacheD3D11.h"
+#include "ConstantRingD3D11.h"
+#include "CommandRecordingD3D11.h"
+#include "ProfilerD3D11.h"
 
 namespace ACW
 {
+	// Resolution the raymarched bubbles and coral are rendered at, as a divisor of the back buffer size.
+	enum class RaymarchResolution
+	{
+		Full = 1,
+		Half = 2,
+		Quarter = 4
+	};
+
+	// Rate the implicit coral is lit at, as a divisor of the resolution it is marched at.
+	enum class CoralShadingRate
+	{
+		Full = 1,
+		Half = 2,
+		Quarter = 4
+	};
+
+	// GPU time of each implicit coral pass, in milliseconds, from a few frames ago.
+	struct CoralPassTimings
+	{
+		float prepassMilliseconds;
+		float marchMilliseconds;
+		float shadeMilliseconds;
+		float resolveMilliseconds;
+		// The single impostor draw, on frames the coral is far enough away for it.
+		float impostorMilliseconds;
+	};
+
+	// Plants scattered, those drawn this frame, the points the height and slope rules dropped at load, and the time
+	// taken at load to build the plant texture array, mips included.
+	struct PlantStats
+	{
+		uint32 instanceCount;
+		uint32 visibleCount;
+		uint32 culledCount;
+		float atlasMilliseconds;
+	};
+
+	// Coral mesh variants grown at load, their mean triangle count and generation time, and the corals placed from them.
+	// The mean post transform cache misses per triangle before and after MeshOptimizer and the time it took per variant,
+	// the size of the packed vertex buffer and what it would be with float positions and normals, and the triangles
+	// drawn this frame at the levels of detail chosen.
+	struct CoralMeshStats
+	{
+		uint32 variantCount;
+		uint32 variantTriangles;
+		float variantMilliseconds;
+		uint32 instanceCount;
+		float acmrBefore;
+		float acmrAfter;
+		float optimizeMilliseconds;
+		uint32 vertexBytes;
+		uint32 floatVertexBytes;
+		uint32 trianglesDrawn;
+	};
+
 	// This sample renderer instantiates a basic rendering pipeline.
 	class Sample3DSceneRenderer
 	{
@@ -19,18 +86,95 @@ namespace ACW
 		void Update(DX::StepTimer const& timer, const std::vector<bool>& pInput);
 		void Render();
 
+		void SetRaymarchResolution(RaymarchResolution resolution);
+		RaymarchResolution GetRaymarchResolution() const { return mRaymarchResolution; }
+
+		void SetCoralShadingRate(CoralShadingRate rate);
+		CoralShadingRate GetCoralShadingRate() const { return mCoralShadingRate; }
+
+		// Whether the passes are recorded into command lists on worker threads rather than drawn on the immediate context.
+		void SetRecordDeferred(bool deferred) { mRecordDeferred = deferred; }
+		bool IsRecordingDeferred() const { return mRecordDeferred; }
+
+		const CoralPassTimings& GetCoralPassTimings() const { return mCoralPassTimings; }
+
+		PlantStats GetPlantStats() const;
+		CoralMeshStats GetCoralMeshStats() const;
+
+		// Clusters of the coral meshes at the levels of detail chosen this frame, those outside the view and
+		// facing away from the eye, and the time taken to cull them and write the rest's indices.
+		const Meshlets::CullStats& GetCoralClusterStats() const { return mCoralMeshCullStats; }
+		float GetCoralClusterCullMilliseconds() const { return mCoralClusterCullMilliseconds; }
+
+		// Whether the coral was last drawn as its impostor, and the time taken to bake it, 0 when a saved pack was loaded.
+		bool IsDrawingCoralImpostor() const { return mDrawingCoralImpostor; }
+		float GetCoralImpostorBakeMilliseconds() const { return mCoralImpostorBakeMilliseconds.load(); }
+
+		// Passes of the last frame graph compiled, those culled and the textures its targets shared, and the binds it ran with.
+		const FrameGraph::CompileStats& GetFrameGraphStats() const { return mFrameGraph.GetCompileStats(); }
+		const FrameGraph::ExecuteStats& GetFrameGraphExecuteStats() const { return mExecuteStats; }
+
+		// Shader and state binds of the last frame passed on to the device contexts and dropped as redundant.
+		StateFilter::BindStats GetStateBindStats() const;
+
+		// Passes recorded on worker threads in the last frame, the threads that took them and the time to record and run
+		// the command lists, all 0 when drawing on the immediate context, and whether the driver records them itself.
+		const CommandRecording::RecordStats& GetRecordStats() const { return mRecordStats; }
+		bool HasDriverCommandLists() const { return mRecorder.DriverCommandLists(); }
+
+		// Blend, depth stencil, rasteriser and sampler states made on the device, and the requests that found one already made.
+		const StateCache::CacheStats& GetStateCacheStats() const { return mStateCache.GetStats(); }
+
+		// Constant bytes and blocks written in the last frame, of those there are.
+		const ConstantRing::FrameStats& GetConstantStats() const { return mConstants.GetStats(); }
+
 	private:
+		//Where a pass draws, the immediate context or a deferred one, and the filter in front of it
+		struct DrawContext
+		{
+			ID3D11DeviceContext3* context;
+			StateFilter::FilteredContext<ID3D11DeviceContext3>& states;
+		};
 		
 		//Constant buffers data
 		ModelViewProjectionConstantBuffer	m_constantBufferDataCamera;
 		LightConstantBuffer mConstantBufferDataLight;
 		TimeConstantBuffer mConstantBufferDataTime;
+		UpsampleConstantBuffer mConstantBufferDataUpsample;
 
 		//Variables
 		uint32	m_indexCount;
-		uint32 mPlantIndex;
+		uint32 mPlantInstanceCount;
+		uint32 mPlantVisibleCount;
+		uint32 mPlantCulledCount;
+		float mPlantAtlasMilliseconds;
+		uint32 mCoralVariantTriangles;
+		float mCoralVariantMilliseconds;
+		uint32 mCoralMeshInstanceCount;
+		float mCoralAcmrBefore;
+		float mCoralAcmrAfter;
+		float mCoralOptimizeMilliseconds;
+		float mCoralClusterCullMilliseconds;
+		uint32 mCoralVertexBytes;
+		uint32 mCoralFloatVertexBytes;
+		//Set by the load task once the impostor texture is made, and read by the render thread before it uses it
+		std::atomic<bool> mCoralImpostorReady;
+		bool mDrawingCoralImpostor;
+		std::atomic<float> mCoralImpostorBakeMilliseconds;
+		//Counts the times the device resources were released, so an impostor still loading for a lost device is not
+		//published after them. Written under mCoralImpostorLock, as is mCoralImpostorTexture until it is ready
+		uint32 mDeviceGeneration;
+		std::mutex mCoralImpostorLock;
 		uint32 mSnakeIndex;
 		bool	m_loadingComplete;
+		bool mCameraDirty;
+		RaymarchResolution mRaymarchResolution;
+		bool mRaymarchResolutionKeyDown;
+		CoralShadingRate mCoralShadingRate;
+		bool mCoralShadingRateKeyDown;
+		bool mRecordDeferred;
+		bool mRecordDeferredKeyDown;
+		ID3D11DepthStencilState* mUnderwaterDepthState;
 		DirectX::XMVECTOR eye = { 0, 5, -10, 1 };
 		DirectX::XMVECTOR at = { 0.0f, 5.0f, 1.0f, 0.0f };
 		DirectX::XMVECTOR up = { 0.0f, 1.0f, 0.0f, 0.0f };
@@ -40,7 +184,36 @@ namespace ACW
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext3> mContext;
 
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mUnderwaterTexture;
+		//Shaders, samplers and pipeline states are bound through this, which drops binds of what is already bound
+		StateFilter::FilteredContext<ID3D11DeviceContext3> mStates;
+
+		//Passes of the frame, declared each frame, and the backend making the raymarch targets they share
+		FrameGraph::Graph mFrameGraph;
+		FrameGraph::D3D11Backend mFrameGraphBackend;
+
+		//Pipeline states, each made once for its descriptor and shared
+		StateCache::D3D11StateCache mStateCache;
+
+		//Constant buffers, written into one dynamic buffer only when their data changes
+		static const uint32 ConstantRingBytes = 64 * 1024;
+		ConstantRing::D3D11Ring mConstants;
+
+		//Threads the culling, sorting and pass recording are split over every frame, started with the renderer and
+		//woken for each job
+		WorkerThreads::Pool mWorkers;
+
+		//Deferred contexts the passes are recorded on, one per worker thread, each with its own filter, and what
+		//the passes recorded on each bound
+		static const int RecordingThreads = 4;
+		CommandRecording::D3D11Recorder mRecorder;
+		StateFilter::FilteredContext<ID3D11DeviceContext3> mPassStates[RecordingThreads];
+		FrameGraph::ExecuteStats mPassExecuteStats[RecordingThreads];
+		FrameGraph::ExecuteStats mExecuteStats;
+		CommandRecording::RecordStats mRecordStats;
+
+		//GPU time of each Draw pass, for the profiler's trace
+		Profiler::D3D11GpuTimer mGpuTimer;
+
 
 		//Input layout for vertex data
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>	m_inputLayout;
@@ -53,18 +226,68 @@ namespace ACW
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_fullScreenQuadVertexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_fullScreenQuadIndexBuffer;
 
-		//Plant vertices/indices
-		Microsoft::WRL::ComPtr<ID3D11Buffer> mPlantVertexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer> mPlantIndexBuffer;
+		//Plant instances, one position per billboard, refilled each frame with the ones in view furthest first
+		Microsoft::WRL::ComPtr<ID3D11Buffer> mPlantInstanceBuffer;
+		PlantCulling::InstancePositions mPlantPositions;
+		PlantCulling::CullScratch mPlantCullScratch;
+		std::vector<PlantInstances::PlantInstance> mPlantVisible;
+		PlantSorting::SortScratch mPlantSortScratch;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> mPlantInputLayout;
 
 		//Implicit primitives shaders
 		Microsoft::WRL::ComPtr<ID3D11VertexShader>	m_vertexShaderImplicitCoral;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>	m_pixelShaderImplicitCoral;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>	mPixelShaderConePrepass;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>	mPixelShaderCoralMarch;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>	mPixelShaderCoralResolve;
 
-		//Implicit primitives shaders
+		//Octahedral impostor drawn in place of the coral passes when it is far away
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>	mVertexShaderCoralImpostor;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>	mPixelShaderCoralImpostor;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mCoralImpostorTexture;
+
+		//Viewports of the low resolution start distances for the implicit coral march, and of the colour of each
+		//block when shading at a reduced rate
+		D3D11_VIEWPORT mConePrepassViewport;
+		D3D11_VIEWPORT mCoralShadedViewport;
+
+		//The coral passes' GPU times, taken from mGpuTimer each time it reads back a frame
+		CoralPassTimings mCoralPassTimings;
+		uint32_t mCoralTimingsRead;
+
+		//Viewport of the reduced resolution colour and depth targets for the raymarched passes
+		D3D11_VIEWPORT mRaymarchViewport;
+
+		//Depth-aware upsample shader
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> mPixelShaderUpsample;
+
+		//Coral mesh shaders
 		Microsoft::WRL::ComPtr<ID3D11VertexShader>	m_vertexShaderVertexCoral;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>	m_pixelShaderVertexCoral;
 
+		//Every level of detail of every coral mesh variant in one vertex buffer, with the vertices packed by
+		//VertexQuantization, and split into Meshlets clusters. A variant's levels run from mCoralMeshFirstLod[variant]
+		//up to the next variant's. Each frame every coral picks a level, the clusters of it in view and facing the
+		//eye are written to the cluster index buffer, and each coral is drawn from its range of it.
+		struct CoralMeshLod
+		{
+			int32 baseVertex;
+			float error;
+		};
+		Microsoft::WRL::ComPtr<ID3D11Buffer> mCoralMeshVertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> mCoralMeshClusterIndexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> mCoralMeshInstanceBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> mCoralMeshBoundsBuffer;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> mCoralMeshInputLayout;
+		std::vector<CoralMeshLod> mCoralMeshLods;
+		std::vector<uint32> mCoralMeshFirstLod;
+		std::vector<Meshlets::MeshletMesh> mCoralMeshlets;
+		std::vector<CoralMesh::Instance> mCoralMeshInstances;
+		std::vector<Meshlets::Placement> mCoralMeshPlacements;
+		std::vector<Meshlets::DrawRange> mCoralMeshRanges;
+		Meshlets::CullScratch mCoralMeshCullScratch;
+		Meshlets::CullStats mCoralMeshCullStats;
+
 		//Terrain shaders
 		Microsoft::WRL::ComPtr<ID3D11VertexShader> mVertexShaderTerrain;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader> mPixelShaderTerrain;
@@ -78,7 +301,6 @@ namespace ACW
 		//Plant shaders
 		Microsoft::WRL::ComPtr<ID3D11VertexShader> mVertexShaderPlants;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader> mPixelShaderPlants;
-		Microsoft::WRL::ComPtr<ID3D11GeometryShader> mGeometryShaderPlants;
 
 		//Underwater shaders
 		Microsoft::WRL::ComPtr<ID3D11VertexShader> mVertexShaderUnderwater;
@@ -106,29 +328,48 @@ namespace ACW
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> mDepthLessThanEqual;
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilState> mDepthLessThanEqualAll;
 
-		//Constant buffers pointers
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_constantBufferCamera;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		mConstantBufferLight;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		mConstantBufferTime;
+		//Constant buffer blocks in the ring
+		int mCameraBlock;
+		int mLightBlock;
+		int mTimeBlock;
+		int mUpsampleBlock;
+
+
+		void DeclareFrame();
+
+		void BindPassState(DrawContext& draw);
+		DrawContext PassDrawContext(int thread);
+		DrawContext BeginPass(int thread);
 
+		void DrawReflectiveBubbles(DrawContext& draw);
+		void DrawVertexCoral(DrawContext& draw);
+		void DrawConePrepass(DrawContext& draw);
+		void DrawCoralMarch(DrawContext& draw, ID3D11ShaderResourceView* startDistances);
+		void DrawCoralShade(DrawContext& draw, ID3D11ShaderResourceView* hits);
+		void DrawCoralResolve(DrawContext& draw, ID3D11ShaderResourceView* hits, ID3D11ShaderResourceView* shaded);
+		void DrawCoralImpostor(DrawContext& draw);
+		void DrawTerrain(DrawContext& draw);
+		void UpdateDerivedMatrices();
+		void UpdatePlantInstances();
+		void UpdateCoralMeshInstances();
+		void DrawGeometryCorals(DrawContext& draw);
+		void DrawWater(DrawContext& draw);
+		void DrawUnderWaterEffect(DrawContext& draw);
+		void DrawRaymarchUpsample(DrawContext& draw, ID3D11ShaderResourceView* colour, ID3D11ShaderResourceView* depth);
 
-		void DrawReflectiveBubbles();
-		void DrawVertexCoral();
-		void DrawImplicitCoral();
-		void DrawTerrain();
-		void DrawGeometryCorals();
-		void DrawWater();
-		void DrawUnderWaterEffect();
+		void ReadCoralPassTimings();
 
 		void CreateBuffers();
-		void SetBuffers();
 		void UpdateBuffers();
 
 		void CreateBlendStates();
 		void CreateDepthStencils();
+		ID3D11DepthStencilState* UnderwaterDepthState();
 		void CreateRasteriserStates();
 		void CreateSamplerState();
 		void CreateUnderwaterRenderTarget();
+		void UpdateRaymarchViewports();
+		void CreateRecordingContexts();
 
 		
 	};
@@ -43,13 +43,17 @@ SampleFpsTextRenderer::SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceRes
 	CreateDeviceDependentResources();
 }
 
-// Updates the text to be displayed.
-void SampleFpsTextRenderer::Update(DX::StepTimer const& timer)
+// Updates the text to be displayed, detail goes on the lines under the frame rate.
+void SampleFpsTextRenderer::Update(DX::StepTimer const& timer, const std::wstring& detail)
 {
 	// Update display text.
 	uint32 fps = timer.GetFramesPerSecond();
 
 	m_text = (fps > 0) ? std::to_wstring(fps) + L" FPS" : L" - FPS";
+	if (!detail.empty())
+	{
+		m_text += L"\n" + detail;
+	}
 
 	ComPtr<IDWriteTextLayout> textLayout;
 	DX::ThrowIfFailed(
@@ -57,8 +61,8 @@ void SampleFpsTextRenderer::Update(DX::StepTimer const& timer)
 			m_text.c_str(),
 			(uint32) m_text.length(),
 			m_textFormat.Get(),
-			240.0f, // Max width of the input text.
-			50.0f, // Max height of the input text.
+			960.0f, // Max width of the input text.
+			460.0f, // Max height of the input text.
 			&textLayout
 			)
 		);
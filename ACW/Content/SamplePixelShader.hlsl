@@ -5,8 +5,8 @@ struct VertexOutput
     float3 cameraPosition : TEXCOORD0;
 };
 
-// Texture sampler for the underwater texture
-Texture2D underwaterTexture : register(t0);
+// Texture sampler for the underwater texture, the grass layer of the plant texture array
+Texture2DArray underwaterTexture : register(t0);
 SamplerState txSampler : register(s0);
 
 // The underwater color and density
@@ -29,7 +29,7 @@ float4 main(VertexOutput input) : SV_TARGET
     float4 underwaterSceneColor = lerp(sceneColor, float4(0, 0.4, 0.6, 1), fogFactor);
 
     // Apply texture mapping for additional underwater effect
-    float4 textureColor = underwaterTexture.Sample(txSampler, input.position.xy);
+    float4 textureColor = underwaterTexture.Sample(txSampler, float3(input.position.xy, 0));
 
 
     return lerp(underwaterSceneColor, textureColor, 0.5f);
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include "SdfExpression.h"
+
+namespace ACW
+{
+	namespace Sdf
+	{
+		// Forward mode dual number: a value and its gradient with respect to the evaluated point.
+		// Evaluating a scene on Vec3<Dual> gives the distance and the surface normal in one pass,
+		// matching mapDual() in SdfDual.hlsli.
+		struct Dual
+		{
+			float value;
+			Vec3<float> gradient;
+
+			Dual() {}
+			Dual(float v) : value(v), gradient(0.0f, 0.0f, 0.0f) {}
+			Dual(float v, const Vec3<float>& g) : value(v), gradient(g) {}
+		};
+
+		// The point to differentiate at, each component seeded with its own axis.
+		inline Vec3<Dual> MakeDualPoint(float x, float y, float z)
+		{
+			return Vec3<Dual>(Dual(x, Vec3<float>(1.0f, 0.0f, 0.0f)), Dual(y, Vec3<float>(0.0f, 1.0f, 0.0f)), Dual(z, Vec3<float>(0.0f, 0.0f, 1.0f)));
+		}
+
+		inline Vec3<float> ScaleGradient(const Vec3<float>& g, float s) { return Vec3<float>(g.x * s, g.y * s, g.z * s); }
+		inline Vec3<float> AddGradient(const Vec3<float>& a, const Vec3<float>& b) { return Vec3<float>(a.x + b.x, a.y + b.y, a.z + b.z); }
+
+		inline Dual operator+(const Dual& a, const Dual& b) { return Dual(a.value + b.value, AddGradient(a.gradient, b.gradient)); }
+		inline Dual operator-(const Dual& a, const Dual& b) { return Dual(a.value - b.value, AddGradient(a.gradient, ScaleGradient(b.gradient, -1.0f))); }
+		inline Dual operator*(const Dual& a, const Dual& b) { return Dual(a.value * b.value, AddGradient(ScaleGradient(a.gradient, b.value), ScaleGradient(b.gradient, a.value))); }
+		inline Dual operator/(const Dual& a, const Dual& b) { return Dual(a.value / b.value, ScaleGradient(AddGradient(ScaleGradient(a.gradient, b.value), ScaleGradient(b.gradient, -a.value)), 1.0f / (b.value * b.value))); }
+		inline Dual operator-(const Dual& a) { return Dual(-a.value, ScaleGradient(a.gradient, -1.0f)); }
+
+		// Constants carry no gradient, so the common mixed cases skip the multiply by zero.
+		inline Dual operator+(const Dual& a, float s) { return Dual(a.value + s, a.gradient); }
+		inline Dual operator-(const Dual& a, float s) { return Dual(a.value - s, a.gradient); }
+		inline Dual operator*(const Dual& a, float s) { return Dual(a.value * s, ScaleGradient(a.gradient, s)); }
+		inline Dual operator*(float s, const Dual& a) { return Dual(a.value * s, ScaleGradient(a.gradient, s)); }
+		inline Dual operator+(float s, const Dual& a) { return Dual(s + a.value, a.gradient); }
+		inline Dual operator-(float s, const Dual& a) { return Dual(s - a.value, ScaleGradient(a.gradient, -1.0f)); }
+
+		inline Dual Sqrt(const Dual& v) { float r = std::sqrt(v.value); return Dual(r, ScaleGradient(v.gradient, r > 0.0f ? 0.5f / r : 0.0f)); }
+		inline Dual Sin(const Dual& v) { return Dual(std::sin(v.value), ScaleGradient(v.gradient, std::cos(v.value))); }
+		inline Dual Abs(const Dual& v) { return v.value < 0.0f ? -v : v; }
+		inline Dual Min(const Dual& a, const Dual& b) { return a.value < b.value ? a : b; }
+		inline Dual Max(const Dual& a, const Dual& b) { return a.value > b.value ? a : b; }
+		inline Dual Round(const Dual& v) { return Dual(std::floor(v.value + 0.5f)); }
+		inline Dual Saturate(const Dual& v) { return v.value < 0.0f ? Dual(0.0f) : (v.value > 1.0f ? Dual(1.0f) : v); }
+		inline Dual SelectLess(const Dual& a, const Dual& b, const Dual& x, const Dual& y) { return a.value < b.value ? x : y; }
+
+		// Length keeps the chain rule to one division instead of going through Sqrt of a sum.
+		inline Dual Length(const Vec3<Dual>& v)
+		{
+			float length = std::sqrt(v.x.value * v.x.value + v.y.value * v.y.value + v.z.value * v.z.value);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+			Vec3<float> g = AddGradient(AddGradient(ScaleGradient(v.x.gradient, v.x.value), ScaleGradient(v.y.gradient, v.y.value)), ScaleGradient(v.z.gradient, v.z.value));
+			return Dual(length, ScaleGradient(g, scale));
+		}
+	}
+}
@@ -0,0 +1,111 @@
+// Forward mode dual numbers for the generated mapDual(), matching Sdf::Dual in SdfDual.h.
+// Every value carries its gradient with respect to the point map is evaluated at, so one
+// evaluation gives both the distance and the surface normal.
+
+struct Dual
+{
+	float v;
+	float3 g;
+};
+
+Dual dual(float v, float3 g)
+{
+	Dual r;
+	r.v = v;
+	r.g = g;
+	return r;
+}
+
+Dual dualConstant(float v)
+{
+	return dual(v, float3(0.0, 0.0, 0.0));
+}
+
+Dual dualAdd(Dual a, Dual b)
+{
+	return dual(a.v + b.v, a.g + b.g);
+}
+
+Dual dualSub(Dual a, Dual b)
+{
+	return dual(a.v - b.v, a.g - b.g);
+}
+
+Dual dualMul(Dual a, Dual b)
+{
+	return dual(a.v * b.v, a.g * b.v + b.g * a.v);
+}
+
+Dual dualNeg(Dual a)
+{
+	return dual(-a.v, -a.g);
+}
+
+// a + s and a * s for a constant s
+Dual dualOffset(Dual a, float s)
+{
+	return dual(a.v + s, a.g);
+}
+
+Dual dualScale(Dual a, float s)
+{
+	return dual(a.v * s, a.g * s);
+}
+
+Dual dualSin(Dual a)
+{
+	return dual(sin(a.v), a.g * cos(a.v));
+}
+
+// The conditional operator does not take structs, hence the branches below.
+Dual dualAbs(Dual a)
+{
+	if (a.v < 0.0)
+	{
+		return dualNeg(a);
+	}
+	return a;
+}
+
+Dual dualMin(Dual a, Dual b)
+{
+	if (a.v < b.v)
+	{
+		return a;
+	}
+	return b;
+}
+
+Dual dualMax(Dual a, Dual b)
+{
+	if (a.v > b.v)
+	{
+		return a;
+	}
+	return b;
+}
+
+Dual dualSaturate(Dual a)
+{
+	if (a.v < 0.0)
+	{
+		return dualConstant(0.0);
+	}
+	if (a.v > 1.0)
+	{
+		return dualConstant(1.0);
+	}
+	return a;
+}
+
+Dual dualLength(Dual x, Dual y)
+{
+	float l = length(float2(x.v, y.v));
+	return dual(l, (x.g * x.v + y.g * y.v) / max(l, 1e-20));
+}
+
+Dual dualLength(Dual x, Dual y, Dual z)
+{
+	float l = length(float3(x.v, y.v, z.v));
+	return dual(l, (x.g * x.v + y.g * y.v + z.g * z.v) / max(l, 1e-20));
+}
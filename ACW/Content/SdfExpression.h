@@ -0,0 +1,421 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// ARM builds take the plain lane loops
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define SDF_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ACW
+{
+	// Expression templates for signed distance scenes. Tools/SdfCompiler.py turns a .sdf description
+	// into a nested expression of these nodes, which the compiler then inlines into one specialised
+	// function. Every node evaluates either a single point (float) or a FloatBatch of points.
+	namespace Sdf
+	{
+		// Number of points evaluated together by the batched evaluator.
+		static const int BatchSize = 8;
+
+		// Distance returned by empty parts of a scene.
+		static const float FarDistance = 1e10f;
+
+		// A batch of points' worth of floats. On x86 and x64 the operations are SSE2, four lanes at a time, and
+		// elsewhere plain loops over the lanes.
+		struct FloatBatch
+		{
+			alignas(16) float lane[BatchSize];
+
+			FloatBatch() {}
+			FloatBatch(float s) { for (int i = 0; i < BatchSize; i++) lane[i] = s; }
+		};
+
+		// Sine by reducing v to within pi / 2 of a multiple of pi and a polynomial on what is left, with no call
+		// per lane. Within 3 ulp of std::sin for |v| up to 10^5, far past any argument the scenes use.
+		namespace SinPolynomial
+		{
+			static const float InversePi = 0.318309886183790671538f;
+
+			// pi in parts short enough that their products with the multiple taken off stay exact
+			static const float PiA = 3.140625f;
+			static const float PiB = 0.0009670257568359375f;
+			static const float PiC = 6.2771141529083251953e-7f;
+			static const float PiD = 1.2154201256553420762e-10f;
+
+			static const float S1 = -0.166666597127914428710938f;
+			static const float S2 = 0.00833307858556509017944336f;
+			static const float S3 = -0.000198106907191686332225799f;
+			static const float S4 = 2.6083159809786593541503e-06f;
+
+			inline float Lane(float v)
+			{
+				float k = std::floor(v * InversePi + 0.5f);
+				float r = v - k * PiA - k * PiB - k * PiC - k * PiD;
+				float r2 = r * r;
+				float sine = r + r * r2 * (S1 + r2 * (S2 + r2 * (S3 + r2 * S4)));
+				return static_cast<int32_t>(k) & 1 ? -sine : sine;
+			}
+		}
+
+#if defined(SDF_BATCH_SSE2)
+		template <class Op>
+		inline FloatBatch EachQuad(const FloatBatch& a, const Op& op)
+		{
+			FloatBatch r;
+			for (int i = 0; i < BatchSize; i += 4)
+			{
+				_mm_store_ps(r.lane + i, op(_mm_load_ps(a.lane + i)));
+			}
+			return r;
+		}
+
+		template <class Op>
+		inline FloatBatch EachQuad(const FloatBatch& a, const FloatBatch& b, const Op& op)
+		{
+			FloatBatch r;
+			for (int i = 0; i < BatchSize; i += 4)
+			{
+				_mm_store_ps(r.lane + i, op(_mm_load_ps(a.lane + i), _mm_load_ps(b.lane + i)));
+			}
+			return r;
+		}
+
+		// floor(v + 0.5), exact while |v| is below 2^31
+		inline __m128 RoundQuad(const __m128& v)
+		{
+			__m128 shifted = _mm_add_ps(v, _mm_set1_ps(0.5f));
+			__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(shifted));
+			return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, shifted), _mm_set1_ps(1.0f)));
+		}
+
+		inline __m128 SinQuad(const __m128& v)
+		{
+			using namespace SinPolynomial;
+			__m128 k = RoundQuad(_mm_mul_ps(v, _mm_set1_ps(InversePi)));
+			__m128 r = _mm_sub_ps(v, _mm_mul_ps(k, _mm_set1_ps(PiA)));
+			r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PiB)));
+			r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PiC)));
+			r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PiD)));
+
+			__m128 r2 = _mm_mul_ps(r, r);
+			__m128 poly = _mm_add_ps(_mm_set1_ps(S3), _mm_mul_ps(r2, _mm_set1_ps(S4)));
+			poly = _mm_add_ps(_mm_set1_ps(S2), _mm_mul_ps(r2, poly));
+			poly = _mm_add_ps(_mm_set1_ps(S1), _mm_mul_ps(r2, poly));
+			__m128 sine = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), poly));
+
+			// Odd multiples of pi flip the sign
+			__m128i odd = _mm_slli_epi32(_mm_cvtps_epi32(k), 31);
+			return _mm_xor_ps(sine, _mm_castsi128_ps(odd));
+		}
+
+		inline FloatBatch operator+(const FloatBatch& a, const FloatBatch& b) { return EachQuad(a, b, [](const __m128& x, const __m128& y) { return _mm_add_ps(x, y); }); }
+		inline FloatBatch operator-(const FloatBatch& a, const FloatBatch& b) { return EachQuad(a, b, [](const __m128& x, const __m128& y) { return _mm_sub_ps(x, y); }); }
+		inline FloatBatch operator*(const FloatBatch& a, const FloatBatch& b) { return EachQuad(a, b, [](const __m128& x, const __m128& y) { return _mm_mul_ps(x, y); }); }
+		inline FloatBatch operator/(const FloatBatch& a, const FloatBatch& b) { return EachQuad(a, b, [](const __m128& x, const __m128& y) { return _mm_div_ps(x, y); }); }
+		inline FloatBatch operator-(const FloatBatch& a) { return EachQuad(a, [](const __m128& x) { return _mm_xor_ps(x, _mm_set1_ps(-0.0f)); }); }
+#else
+		inline FloatBatch operator+(const FloatBatch& a, const FloatBatch& b) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] + b.lane[i]; return r; }
+		inline FloatBatch operator-(const FloatBatch& a, const FloatBatch& b) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] - b.lane[i]; return r; }
+		inline FloatBatch operator*(const FloatBatch& a, const FloatBatch& b) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] * b.lane[i]; return r; }
+		inline FloatBatch operator/(const FloatBatch& a, const FloatBatch& b) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] / b.lane[i]; return r; }
+		inline FloatBatch operator-(const FloatBatch& a) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = -a.lane[i]; return r; }
+#endif
+
+		// Scalar and batched intrinsics share names so the node templates can use either.
+		inline float Sqrt(float v) { return std::sqrt(v); }
+		inline float Sin(float v) { return std::sin(v); }
+		inline float Abs(float v) { return std::fabs(v); }
+		inline float Min(float a, float b) { return std::min(a, b); }
+		inline float Max(float a, float b) { return std::max(a, b); }
+		inline float Round(float v) { return std::floor(v + 0.5f); }
+		inline float Saturate(float v) { return std::min(std::max(v, 0.0f), 1.0f); }
+		inline float SelectLess(float a, float b, float x, float y) { return a < b ? x : y; }
+
+		// Double precision, for accuracy references.
+		inline double Sqrt(double v) { return std::sqrt(v); }
+		inline double Sin(double v) { return std::sin(v); }
+		inline double Abs(double v) { return std::fabs(v); }
+		inline double Min(double a, double b) { return std::min(a, b); }
+		inline double Max(double a, double b) { return std::max(a, b); }
+		inline double Round(double v) { return std::floor(v + 0.5); }
+		inline double Saturate(double v) { return std::min(std::max(v, 0.0), 1.0); }
+		inline double SelectLess(double a, double b, double x, double y) { return a < b ? x : y; }
+
+#if defined(SDF_BATCH_SSE2)
+		inline FloatBatch Sqrt(const FloatBatch& v) { return EachQuad(v, [](const __m128& x) { return _mm_sqrt_ps(x); }); }
+		inline FloatBatch Sin(const FloatBatch& v) { return EachQuad(v, [](const __m128& x) { return SinQuad(x); }); }
+		inline FloatBatch Abs(const FloatBatch& v) { return EachQuad(v, [](const __m128& x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }); }
+		inline FloatBatch Min(const FloatBatch& a, const FloatBatch& b) { return EachQuad(a, b, [](const __m128& x, const __m128& y) { return _mm_min_ps(x, y); }); }
+		inline FloatBatch Max(const FloatBatch& a, const FloatBatch& b) { return EachQuad(a, b, [](const __m128& x, const __m128& y) { return _mm_max_ps(x, y); }); }
+		inline FloatBatch Round(const FloatBatch& v) { return EachQuad(v, [](const __m128& x) { return RoundQuad(x); }); }
+		inline FloatBatch SelectLess(const FloatBatch& a, const FloatBatch& b, const FloatBatch& x, const FloatBatch& y)
+		{
+			FloatBatch r;
+			for (int i = 0; i < BatchSize; i += 4)
+			{
+				__m128 less = _mm_cmplt_ps(_mm_load_ps(a.lane + i), _mm_load_ps(b.lane + i));
+				_mm_store_ps(r.lane + i, _mm_or_ps(_mm_and_ps(less, _mm_load_ps(x.lane + i)), _mm_andnot_ps(less, _mm_load_ps(y.lane + i))));
+			}
+			return r;
+		}
+#else
+		inline FloatBatch Sqrt(const FloatBatch& v) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = std::sqrt(v.lane[i]); return r; }
+		inline FloatBatch Sin(const FloatBatch& v) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = SinPolynomial::Lane(v.lane[i]); return r; }
+		inline FloatBatch Abs(const FloatBatch& v) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = std::fabs(v.lane[i]); return r; }
+		inline FloatBatch Min(const FloatBatch& a, const FloatBatch& b) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] < b.lane[i] ? a.lane[i] : b.lane[i]; return r; }
+		inline FloatBatch Max(const FloatBatch& a, const FloatBatch& b) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] > b.lane[i] ? a.lane[i] : b.lane[i]; return r; }
+		inline FloatBatch Round(const FloatBatch& v) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = std::floor(v.lane[i] + 0.5f); return r; }
+		inline FloatBatch SelectLess(const FloatBatch& a, const FloatBatch& b, const FloatBatch& x, const FloatBatch& y) { FloatBatch r; for (int i = 0; i < BatchSize; i++) r.lane[i] = a.lane[i] < b.lane[i] ? x.lane[i] : y.lane[i]; return r; }
+#endif
+		inline FloatBatch Saturate(const FloatBatch& v) { return Min(Max(v, 0.0f), 1.0f); }
+
+		template <class T>
+		struct Vec3
+		{
+			T x, y, z;
+
+			Vec3() {}
+			constexpr Vec3(const T& px, const T& py, const T& pz) : x(px), y(py), z(pz) {}
+		};
+
+		template <class T> inline Vec3<T> operator-(const Vec3<T>& a, const Vec3<float>& b) { return Vec3<T>(a.x - b.x, a.y - b.y, a.z - b.z); }
+		template <class T> inline Vec3<T> operator*(const Vec3<T>& a, float s) { return Vec3<T>(a.x * s, a.y * s, a.z * s); }
+		template <class T> inline T Length(const Vec3<T>& v) { return Sqrt(v.x * v.x + v.y * v.y + v.z * v.z); }
+
+		// Primitives. Leaves report material 0.
+
+		struct Sphere
+		{
+			float radius;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const { d = Length(p) - radius; m = T(0.0f); }
+		};
+
+		struct Box
+		{
+			Vec3<float> halfSize;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T qx = Abs(p.x) - halfSize.x;
+				T qy = Abs(p.y) - halfSize.y;
+				T qz = Abs(p.z) - halfSize.z;
+				Vec3<T> outside(Max(qx, T(0.0f)), Max(qy, T(0.0f)), Max(qz, T(0.0f)));
+				d = Length(outside) + Min(Max(qx, Max(qy, qz)), T(0.0f));
+				m = T(0.0f);
+			}
+		};
+
+		struct Torus
+		{
+			float majorRadius;
+			float minorRadius;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T ring = Sqrt(p.x * p.x + p.z * p.z) - majorRadius;
+				d = Sqrt(ring * ring + p.y * p.y) - minorRadius;
+				m = T(0.0f);
+			}
+		};
+
+		struct Plane
+		{
+			Vec3<float> normal;
+			float offset;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const { d = p.x * normal.x + p.y * normal.y + p.z * normal.z + offset; m = T(0.0f); }
+		};
+
+		// amplitude * sin(f x) sin(f y) sin(f z), used to roughen a surface through Add.
+		struct SinLattice
+		{
+			float frequency;
+			float amplitude;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				d = amplitude * (Sin(frequency * p.x) * Sin(frequency * p.y) * Sin(frequency * p.z));
+				m = T(0.0f);
+			}
+		};
+
+		// Domain operators
+
+		template <class C>
+		struct Translate
+		{
+			Vec3<float> offset;
+			C child;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const { child.Evaluate(p - offset, d, m); }
+		};
+
+		// Uniform scale, the distance is rescaled so it stays a distance.
+		template <class C>
+		struct Scale
+		{
+			float scale;
+			C child;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const { child.Evaluate(p * (1.0f / scale), d, m); d = d * scale; }
+		};
+
+		template <class C>
+		struct RotateY
+		{
+			float cosine;
+			float sine;
+			C child;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				child.Evaluate(Vec3<T>(cosine * p.x + sine * p.z, p.y, cosine * p.z - sine * p.x), d, m);
+			}
+		};
+
+		// Infinite repetition along the axes with a non-zero period.
+		template <class C>
+		struct Repeat
+		{
+			Vec3<float> period;
+			C child;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				Vec3<T> q = p;
+				if (period.x != 0.0f) q.x = p.x - period.x * Round(p.x * (1.0f / period.x));
+				if (period.y != 0.0f) q.y = p.y - period.y * Round(p.y * (1.0f / period.y));
+				if (period.z != 0.0f) q.z = p.z - period.z * Round(p.z * (1.0f / period.z));
+				child.Evaluate(q, d, m);
+			}
+		};
+
+		// Distance operators
+
+		template <class C>
+		struct DistanceScale
+		{
+			float factor;
+			C child;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const { child.Evaluate(p, d, m); d = factor * d; }
+		};
+
+		template <class C>
+		struct Material
+		{
+			float id;
+			C child;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const { child.Evaluate(p, d, m); m = T(id); }
+		};
+
+		// Sum of two distances, keeping the material of the first.
+		template <class A, class B>
+		struct Add
+		{
+			A first;
+			B second;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T d2, m2;
+				first.Evaluate(p, d, m);
+				second.Evaluate(p, d2, m2);
+				d = d + d2;
+			}
+		};
+
+		template <class A, class B>
+		struct Union
+		{
+			A first;
+			B second;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T d1, m1, d2, m2;
+				first.Evaluate(p, d1, m1);
+				second.Evaluate(p, d2, m2);
+				d = Min(d1, d2);
+				m = SelectLess(d1, d2, m1, m2);
+			}
+		};
+
+		template <class A, class B>
+		struct Intersect
+		{
+			A first;
+			B second;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T d1, m1, d2, m2;
+				first.Evaluate(p, d1, m1);
+				second.Evaluate(p, d2, m2);
+				d = Max(d1, d2);
+				m = SelectLess(d1, d2, m2, m1);
+			}
+		};
+
+		// First minus second, keeping the material of the first.
+		template <class A, class B>
+		struct Subtract
+		{
+			A first;
+			B second;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T d2, m2;
+				first.Evaluate(p, d, m);
+				second.Evaluate(p, d2, m2);
+				d = Max(d, -d2);
+			}
+		};
+
+		// Polynomial smooth minimum with blend radius k.
+		template <class A, class B>
+		struct SmoothUnion
+		{
+			float k;
+			A first;
+			B second;
+
+			template <class T> void Evaluate(const Vec3<T>& p, T& d, T& m) const
+			{
+				T d1, m1, d2, m2;
+				first.Evaluate(p, d1, m1);
+				second.Evaluate(p, d2, m2);
+				T h = Saturate(0.5f + (0.5f / k) * (d2 - d1));
+				d = d2 + (d1 - d2) * h - k * h * (1.0f - h);
+				m = SelectLess(d1, d2, m1, m2);
+			}
+		};
+
+		// Factories used by the generated scene headers.
+
+		inline constexpr Sphere MakeSphere(float radius) { return Sphere{ radius }; }
+		inline constexpr Box MakeBox(float x, float y, float z) { return Box{ Vec3<float>(x, y, z) }; }
+		inline constexpr Torus MakeTorus(float majorRadius, float minorRadius) { return Torus{ majorRadius, minorRadius }; }
+		inline constexpr Plane MakePlane(float x, float y, float z, float offset) { return Plane{ Vec3<float>(x, y, z), offset }; }
+		inline constexpr SinLattice MakeSinLattice(float frequency, float amplitude) { return SinLattice{ frequency, amplitude }; }
+
+		template <class C> inline constexpr Translate<C> MakeTranslate(float x, float y, float z, const C& child) { return Translate<C>{ Vec3<float>(x, y, z), child }; }
+		template <class C> inline constexpr Scale<C> MakeScale(float scale, const C& child) { return Scale<C>{ scale, child }; }
+		template <class C> inline constexpr RotateY<C> MakeRotateY(float cosine, float sine, const C& child) { return RotateY<C>{ cosine, sine, child }; }
+		template <class C> inline constexpr Repeat<C> MakeRepeat(float x, float y, float z, const C& child) { return Repeat<C>{ Vec3<float>(x, y, z), child }; }
+		template <class C> inline constexpr DistanceScale<C> MakeDistanceScale(float factor, const C& child) { return DistanceScale<C>{ factor, child }; }
+		template <class C> inline constexpr Material<C> MakeMaterial(float id, const C& child) { return Material<C>{ id, child }; }
+
+		template <class A, class B> inline constexpr Add<A, B> MakeAdd(const A& first, const B& second) { return Add<A, B>{ first, second }; }
+		template <class A, class B> inline constexpr Union<A, B> MakeUnion(const A& first, const B& second) { return Union<A, B>{ first, second }; }
+		template <class A, class B> inline constexpr Intersect<A, B> MakeIntersect(const A& first, const B& second) { return Intersect<A, B>{ first, second }; }
+		template <class A, class B> inline constexpr Subtract<A, B> MakeSubtract(const A& first, const B& second) { return Subtract<A, B>{ first, second }; }
+		template <class A, class B> inline constexpr SmoothUnion<A, B> MakeSmoothUnion(float k, const A& first, const B& second) { return SmoothUnion<A, B>{ k, first, second }; }
+	}
+}
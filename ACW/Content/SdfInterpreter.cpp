@@ -0,0 +1,311 @@
+﻿#include "pch.h"
+#include "SdfInterpreter.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace ACW;
+using namespace ACW::Sdf;
+using namespace ACW::SdfInterpreter;
+
+namespace
+{
+	const float DegreesToRadians = 3.14159265358979f / 180.0f;
+
+	struct OperationInfo
+	{
+		const char* name;
+		Operation operation;
+		int argCount;
+		int minChildren;
+		int maxChildren;
+	};
+
+	// Same table as OPS in Tools/SdfCompiler.py, -1 means any number of children
+	const OperationInfo Operations[] =
+	{
+		{ "none", Operation::None, 0, 0, 0 },
+		{ "sphere", Operation::Sphere, 1, 0, 0 },
+		{ "box", Operation::Box, 3, 0, 0 },
+		{ "torus", Operation::Torus, 2, 0, 0 },
+		{ "plane", Operation::Plane, 4, 0, 0 },
+		{ "sin-lattice", Operation::SinLattice, 2, 0, 0 },
+		{ "translate", Operation::Translate, 3, 1, 1 },
+		{ "scale", Operation::Scale, 1, 1, 1 },
+		{ "rotate-y", Operation::RotateY, 1, 1, 1 },
+		{ "repeat", Operation::Repeat, 3, 1, 1 },
+		{ "distance-scale", Operation::DistanceScale, 1, 1, 1 },
+		{ "material", Operation::Material, 1, 1, 1 },
+		{ "add", Operation::Add, 0, 1, -1 },
+		{ "union", Operation::Union, 0, 1, -1 },
+		{ "intersect", Operation::Intersect, 0, 1, -1 },
+		{ "subtract", Operation::Subtract, 0, 2, 2 },
+		{ "smooth-union", Operation::SmoothUnion, 1, 1, -1 },
+	};
+
+	class Parser
+	{
+	public:
+		Parser(const std::string& source, Scene& scene) : mSource(source), mScene(scene), mPosition(0), mLine(1) {}
+
+		int ParseNode()
+		{
+			SkipSpace();
+			Expect('(');
+			std::string name = ReadToken();
+			const OperationInfo* info = nullptr;
+			for (const OperationInfo& candidate : Operations)
+			{
+				if (name == candidate.name)
+				{
+					info = &candidate;
+				}
+			}
+			if (!info)
+			{
+				Fail("unknown operation '" + name + "'");
+			}
+
+			Node node = {};
+			node.operation = info->operation;
+			int argCount = 0;
+
+			for (;;)
+			{
+				SkipSpace();
+				if (mPosition >= mSource.size())
+				{
+					Fail("unterminated (" + name);
+				}
+
+				char c = mSource[mPosition];
+				if (c == ')')
+				{
+					mPosition++;
+					break;
+				}
+				if (c == '(')
+				{
+					node.children.push_back(ParseNode());
+					continue;
+				}
+
+				std::string token = ReadToken();
+				if (!node.children.empty())
+				{
+					Fail("(" + name + ") arguments must come before its children");
+				}
+				if (argCount == info->argCount)
+				{
+					Fail("(" + name + ") has too many arguments");
+				}
+
+				char* end = nullptr;
+				float value = std::strtof(token.c_str(), &end);
+				if (token.empty() || *end != '\0')
+				{
+					Fail("'" + token + "' is not a number");
+				}
+				node.args[argCount++] = value;
+			}
+
+			int childCount = static_cast<int>(node.children.size());
+			if (argCount != info->argCount)
+			{
+				Fail("(" + name + ") has too few arguments");
+			}
+			if (childCount < info->minChildren || (info->maxChildren >= 0 && childCount > info->maxChildren))
+			{
+				Fail("(" + name + ") has the wrong number of children");
+			}
+
+			mScene.nodes.push_back(node);
+			return static_cast<int>(mScene.nodes.size()) - 1;
+		}
+
+		void ExpectEnd()
+		{
+			SkipSpace();
+			if (mPosition != mSource.size())
+			{
+				Fail("unexpected text after the scene");
+			}
+		}
+
+	private:
+		void SkipSpace()
+		{
+			while (mPosition < mSource.size())
+			{
+				char c = mSource[mPosition];
+				if (c == ';')
+				{
+					while (mPosition < mSource.size() && mSource[mPosition] != '\n')
+					{
+						mPosition++;
+					}
+				}
+				else if (std::isspace(static_cast<unsigned char>(c)))
+				{
+					if (c == '\n')
+					{
+						mLine++;
+					}
+					mPosition++;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+
+		std::string ReadToken()
+		{
+			SkipSpace();
+			size_t start = mPosition;
+			while (mPosition < mSource.size())
+			{
+				char c = mSource[mPosition];
+				if (c == '(' || c == ')' || c == ';' || std::isspace(static_cast<unsigned char>(c)))
+				{
+					break;
+				}
+				mPosition++;
+			}
+			return mSource.substr(start, mPosition - start);
+		}
+
+		void Expect(char c)
+		{
+			if (mPosition >= mSource.size() || mSource[mPosition] != c)
+			{
+				Fail(std::string("expected '") + c + "'");
+			}
+			mPosition++;
+		}
+
+		void Fail(const std::string& message)
+		{
+			throw std::invalid_argument("line " + std::to_string(mLine) + ": " + message);
+		}
+
+		const std::string& mSource;
+		Scene& mScene;
+		size_t mPosition;
+		int mLine;
+	};
+
+	void EvaluateNode(const Scene& scene, int index, const Vec3<float>& p, float& d, float& m)
+	{
+		const Node& node = scene.nodes[index];
+		const float* a = node.args;
+
+		switch (node.operation)
+		{
+		case Operation::None:
+			d = FarDistance;
+			m = 0.0f;
+			break;
+		case Operation::Sphere:
+			MakeSphere(a[0]).Evaluate(p, d, m);
+			break;
+		case Operation::Box:
+			MakeBox(a[0], a[1], a[2]).Evaluate(p, d, m);
+			break;
+		case Operation::Torus:
+			MakeTorus(a[0], a[1]).Evaluate(p, d, m);
+			break;
+		case Operation::Plane:
+			MakePlane(a[0], a[1], a[2], a[3]).Evaluate(p, d, m);
+			break;
+		case Operation::SinLattice:
+			MakeSinLattice(a[0], a[1]).Evaluate(p, d, m);
+			break;
+		case Operation::Translate:
+			EvaluateNode(scene, node.children[0], p - Vec3<float>(a[0], a[1], a[2]), d, m);
+			break;
+		case Operation::Scale:
+			EvaluateNode(scene, node.children[0], p * (1.0f / a[0]), d, m);
+			d = d * a[0];
+			break;
+		case Operation::RotateY:
+		{
+			float c = std::cos(a[0] * DegreesToRadians);
+			float s = std::sin(a[0] * DegreesToRadians);
+			EvaluateNode(scene, node.children[0], Vec3<float>(c * p.x + s * p.z, p.y, c * p.z - s * p.x), d, m);
+			break;
+		}
+		case Operation::Repeat:
+		{
+			Vec3<float> q = p;
+			if (a[0] != 0.0f) q.x = p.x - a[0] * Round(p.x * (1.0f / a[0]));
+			if (a[1] != 0.0f) q.y = p.y - a[1] * Round(p.y * (1.0f / a[1]));
+			if (a[2] != 0.0f) q.z = p.z - a[2] * Round(p.z * (1.0f / a[2]));
+			EvaluateNode(scene, node.children[0], q, d, m);
+			break;
+		}
+		case Operation::DistanceScale:
+			EvaluateNode(scene, node.children[0], p, d, m);
+			d = a[0] * d;
+			break;
+		case Operation::Material:
+			EvaluateNode(scene, node.children[0], p, d, m);
+			m = a[0];
+			break;
+		default:
+		{
+			// N-ary operations fold their children left to right, like the generated chains
+			EvaluateNode(scene, node.children[0], p, d, m);
+			for (size_t i = 1; i < node.children.size(); i++)
+			{
+				float d2, m2;
+				EvaluateNode(scene, node.children[i], p, d2, m2);
+
+				switch (node.operation)
+				{
+				case Operation::Add:
+					d = d + d2;
+					break;
+				case Operation::Union:
+					m = SelectLess(d, d2, m, m2);
+					d = Min(d, d2);
+					break;
+				case Operation::Intersect:
+					m = SelectLess(d, d2, m2, m);
+					d = Max(d, d2);
+					break;
+				case Operation::Subtract:
+					d = Max(d, -d2);
+					break;
+				case Operation::SmoothUnion:
+				{
+					float h = Saturate(0.5f + (0.5f / a[0]) * (d2 - d));
+					m = SelectLess(d, d2, m, m2);
+					d = d2 + (d - d2) * h - a[0] * h * (1.0f - h);
+					break;
+				}
+				default:
+					break;
+				}
+			}
+			break;
+		}
+		}
+	}
+}
+
+Scene SdfInterpreter::Parse(const std::string& source)
+{
+	Scene scene;
+	Parser parser(source, scene);
+	scene.root = parser.ParseNode();
+	parser.ExpectEnd();
+	return scene;
+}
+
+void SdfInterpreter::Evaluate(const Scene& scene, const Vec3<float>& p, float& distance, float& material)
+{
+	EvaluateNode(scene, scene.root, p, distance, material);
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "SdfExpression.h"
+#include <string>
+#include <vector>
+
+namespace ACW
+{
+	// Runtime reader of the .sdf scene format understood by Tools/SdfCompiler.py. Nothing is folded,
+	// so evaluating a scene walks every node as written. Used to check the generated code against
+	// the description and to measure what compiling the scene saves.
+	namespace SdfInterpreter
+	{
+		enum class Operation
+		{
+			None,
+			Sphere,
+			Box,
+			Torus,
+			Plane,
+			SinLattice,
+			Translate,
+			Scale,
+			RotateY,
+			Repeat,
+			DistanceScale,
+			Material,
+			Add,
+			Union,
+			Intersect,
+			Subtract,
+			SmoothUnion
+		};
+
+		struct Node
+		{
+			Operation operation;
+			float args[4];
+			std::vector<int> children;
+		};
+
+		// Nodes of a parsed scene, children are indices into nodes.
+		struct Scene
+		{
+			std::vector<Node> nodes;
+			int root;
+		};
+
+		// Throws std::invalid_argument describing the first error in source.
+		Scene Parse(const std::string& source);
+
+		void Evaluate(const Scene& scene, const Sdf::Vec3<float>& p, float& distance, float& material);
+	}
+}
@@ -0,0 +1,191 @@
+﻿#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// ARM builds, and x86 ones built without /arch:AVX2, take the plain lane loops
+#if defined(__AVX2__)
+#define SHADER_BATCH_AVX2
+#include <immintrin.h>
+#endif
+
+namespace ACW
+{
+	// The lane types the kernels Tools/HlslTranslator.py writes are built from. A kernel runs a shader for Lanes
+	// pixels or vertices at once, each value of the shader becoming a Float of one value per lane. Branches and
+	// loops run every lane through both sides with a Mask of the lanes taking each, and assignments only reach
+	// the lanes in the mask, as a GPU runs a wave. HLSL ints are carried in Floats as whole numbers, exact up to
+	// 2^24, which covers the loop counters and indices the shaders use them for. With AVX2 a Float or Mask is an
+	// __m256 the operators work on directly, so the temporaries of a kernel stay in registers rather than going
+	// through memory at every operation.
+	namespace ShaderBatch
+	{
+		static const int Lanes = 8;
+
+#if defined(SHADER_BATCH_AVX2)
+		struct Float
+		{
+			union
+			{
+				__m256 v;
+				float lane[Lanes];
+			};
+
+			Float() {}
+			Float(float s) : v(_mm256_set1_ps(s)) {}
+			Float(__m256 v) : v(v) {}
+		};
+
+		// All bits set in the lanes that are on, as the AVX compares leave them.
+		struct Mask
+		{
+			union
+			{
+				__m256 v;
+				int32_t lane[Lanes];
+			};
+
+			Mask() {}
+			Mask(__m256 v) : v(v) {}
+
+			static Mask All() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+			static Mask None() { return _mm256_setzero_ps(); }
+
+			// The lanes whose bits are set in bits, lane 0 the lowest.
+			static Mask FromBits(uint32_t bits)
+			{
+				__m256i lanes = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128));
+				return _mm256_castsi256_ps(_mm256_cmpgt_epi32(lanes, _mm256_setzero_si256()));
+			}
+			uint32_t Bits() const { return static_cast<uint32_t>(_mm256_movemask_ps(v)); }
+		};
+#else
+		struct Float
+		{
+			alignas(32) float lane[Lanes];
+
+			Float() {}
+			Float(float s) { for (int i = 0; i < Lanes; i++) lane[i] = s; }
+		};
+
+		// All bits set in the lanes that are on, as the AVX compares leave them.
+		struct Mask
+		{
+			alignas(32) int32_t lane[Lanes];
+
+			static Mask All() { Mask m; for (int i = 0; i < Lanes; i++) m.lane[i] = -1; return m; }
+			static Mask None() { Mask m; for (int i = 0; i < Lanes; i++) m.lane[i] = 0; return m; }
+
+			// The lanes whose bits are set in bits, lane 0 the lowest.
+			static Mask FromBits(uint32_t bits) { Mask m; for (int i = 0; i < Lanes; i++) m.lane[i] = (bits >> i) & 1 ? -1 : 0; return m; }
+			uint32_t Bits() const { uint32_t bits = 0; for (int i = 0; i < Lanes; i++) bits |= (lane[i] ? 1u : 0u) << i; return bits; }
+		};
+#endif
+
+		template <class Op>
+		inline Float EachLane(const Float& a, const Op& op) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = op(a.lane[i]); return r; }
+
+		template <class Op>
+		inline Float EachLane(const Float& a, const Float& b, const Op& op) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = op(a.lane[i], b.lane[i]); return r; }
+
+		template <class Op>
+		inline Mask CompareLanes(const Float& a, const Float& b, const Op& op) { Mask r; for (int i = 0; i < Lanes; i++) r.lane[i] = op(a.lane[i], b.lane[i]) ? -1 : 0; return r; }
+
+#if defined(SHADER_BATCH_AVX2)
+		inline Float operator+(const Float& a, const Float& b) { return _mm256_add_ps(a.v, b.v); }
+		inline Float operator-(const Float& a, const Float& b) { return _mm256_sub_ps(a.v, b.v); }
+		inline Float operator*(const Float& a, const Float& b) { return _mm256_mul_ps(a.v, b.v); }
+		inline Float operator/(const Float& a, const Float& b) { return _mm256_div_ps(a.v, b.v); }
+		inline Float operator-(const Float& a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+		inline Mask operator<(const Float& a, const Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+		inline Mask operator<=(const Float& a, const Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+		inline Mask operator>(const Float& a, const Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+		inline Mask operator>=(const Float& a, const Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+		inline Mask operator==(const Float& a, const Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+		inline Mask operator!=(const Float& a, const Float& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+
+		inline Mask operator&(const Mask& a, const Mask& b) { return _mm256_and_ps(a.v, b.v); }
+		inline Mask operator|(const Mask& a, const Mask& b) { return _mm256_or_ps(a.v, b.v); }
+		inline Mask operator!(const Mask& a) { return _mm256_xor_ps(a.v, Mask::All().v); }
+		inline Mask AndNot(const Mask& a, const Mask& b) { return _mm256_andnot_ps(b.v, a.v); }
+		inline bool Any(const Mask& a) { return _mm256_movemask_ps(a.v) != 0; }
+
+		// a in the lanes of mask, b in the rest.
+		inline Float Select(const Mask& mask, const Float& a, const Float& b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+		inline Mask Select(const Mask& mask, const Mask& a, const Mask& b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+		inline Float Min(const Float& a, const Float& b) { return _mm256_min_ps(a.v, b.v); }
+		inline Float Max(const Float& a, const Float& b) { return _mm256_max_ps(a.v, b.v); }
+		inline Float Sqrt(const Float& a) { return _mm256_sqrt_ps(a.v); }
+		inline Float Floor(const Float& a) { return _mm256_floor_ps(a.v); }
+		inline Float Ceil(const Float& a) { return _mm256_ceil_ps(a.v); }
+		inline Float Trunc(const Float& a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+		inline Float Round(const Float& a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+		inline Float Abs(const Float& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+#else
+		inline Float operator+(const Float& a, const Float& b) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] + b.lane[i]; return r; }
+		inline Float operator-(const Float& a, const Float& b) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] - b.lane[i]; return r; }
+		inline Float operator*(const Float& a, const Float& b) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] * b.lane[i]; return r; }
+		inline Float operator/(const Float& a, const Float& b) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] / b.lane[i]; return r; }
+		inline Float operator-(const Float& a) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = -a.lane[i]; return r; }
+
+		inline Mask operator<(const Float& a, const Float& b) { return CompareLanes(a, b, [](float x, float y) { return x < y; }); }
+		inline Mask operator<=(const Float& a, const Float& b) { return CompareLanes(a, b, [](float x, float y) { return x <= y; }); }
+		inline Mask operator>(const Float& a, const Float& b) { return CompareLanes(a, b, [](float x, float y) { return x > y; }); }
+		inline Mask operator>=(const Float& a, const Float& b) { return CompareLanes(a, b, [](float x, float y) { return x >= y; }); }
+		inline Mask operator==(const Float& a, const Float& b) { return CompareLanes(a, b, [](float x, float y) { return x == y; }); }
+		inline Mask operator!=(const Float& a, const Float& b) { return CompareLanes(a, b, [](float x, float y) { return x != y; }); }
+
+		inline Mask operator&(const Mask& a, const Mask& b) { Mask r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] & b.lane[i]; return r; }
+		inline Mask operator|(const Mask& a, const Mask& b) { Mask r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] | b.lane[i]; return r; }
+		inline Mask operator!(const Mask& a) { Mask r; for (int i = 0; i < Lanes; i++) r.lane[i] = ~a.lane[i]; return r; }
+		inline Mask AndNot(const Mask& a, const Mask& b) { Mask r; for (int i = 0; i < Lanes; i++) r.lane[i] = a.lane[i] & ~b.lane[i]; return r; }
+		inline bool Any(const Mask& a) { int32_t any = 0; for (int i = 0; i < Lanes; i++) any |= a.lane[i]; return any != 0; }
+
+		// a in the lanes of mask, b in the rest.
+		inline Float Select(const Mask& mask, const Float& a, const Float& b) { Float r; for (int i = 0; i < Lanes; i++) r.lane[i] = mask.lane[i] ? a.lane[i] : b.lane[i]; return r; }
+		inline Mask Select(const Mask& mask, const Mask& a, const Mask& b) { Mask r; for (int i = 0; i < Lanes; i++) r.lane[i] = mask.lane[i] ? a.lane[i] : b.lane[i]; return r; }
+
+		// As minps and maxps, b when either is NaN.
+		inline Float Min(const Float& a, const Float& b) { return EachLane(a, b, [](float x, float y) { return x < y ? x : y; }); }
+		inline Float Max(const Float& a, const Float& b) { return EachLane(a, b, [](float x, float y) { return x > y ? x : y; }); }
+		inline Float Sqrt(const Float& a) { return EachLane(a, [](float x) { return std::sqrt(x); }); }
+		inline Float Floor(const Float& a) { return EachLane(a, [](float x) { return std::floor(x); }); }
+		inline Float Ceil(const Float& a) { return EachLane(a, [](float x) { return std::ceil(x); }); }
+		inline Float Trunc(const Float& a) { return EachLane(a, [](float x) { return std::trunc(x); }); }
+		inline Float Round(const Float& a) { return EachLane(a, [](float x) { return std::nearbyint(x); }); }
+		inline Float Abs(const Float& a) { return EachLane(a, [](float x) { return std::fabs(x); }); }
+#endif
+
+		inline Float ToFloat(const Mask& a) { return Select(a, Float(1.0f), Float(0.0f)); }
+		inline Mask ToMask(const Float& a) { return a != Float(0.0f); }
+
+		// HLSL intrinsics without an instruction of their own, a lane at a time.
+		inline Float Frac(const Float& a) { return a - Floor(a); }
+		inline Float Rsqrt(const Float& a) { return Float(1.0f) / Sqrt(a); }
+		inline Float Saturate(const Float& a) { return Min(Max(a, Float(0.0f)), Float(1.0f)); }
+		inline Float Sign(const Float& a) { return ToFloat(a > Float(0.0f)) - ToFloat(a < Float(0.0f)); }
+		inline Float Sin(const Float& a) { return EachLane(a, [](float x) { return std::sin(x); }); }
+		inline Float Cos(const Float& a) { return EachLane(a, [](float x) { return std::cos(x); }); }
+		inline Float Tan(const Float& a) { return EachLane(a, [](float x) { return std::tan(x); }); }
+		inline Float Exp(const Float& a) { return EachLane(a, [](float x) { return std::exp(x); }); }
+		inline Float Exp2(const Float& a) { return EachLane(a, [](float x) { return std::exp2(x); }); }
+		inline Float Log(const Float& a) { return EachLane(a, [](float x) { return std::log(x); }); }
+		inline Float Log2(const Float& a) { return EachLane(a, [](float x) { return std::log2(x); }); }
+		inline Float Pow(const Float& a, const Float& b) { return EachLane(a, b, [](float x, float y) { return std::pow(x, y); }); }
+		inline Float Fmod(const Float& a, const Float& b) { return EachLane(a, b, [](float x, float y) { return std::fmod(x, y); }); }
+
+		// table[index * stride] in each lane, 0 where index is outside the count entries of the table.
+		inline Float Gather(const float* table, int stride, int count, const Float& index)
+		{
+			Float r;
+			for (int i = 0; i < Lanes; i++)
+			{
+				int entry = static_cast<int>(index.lane[i]);
+				r.lane[i] = entry >= 0 && entry < count ? table[entry * stride] : 0.0f;
+			}
+			return r;
+		}
+	}
+}
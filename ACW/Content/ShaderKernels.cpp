@@ -0,0 +1,360 @@
+﻿#include "pch.h"
+#include "ShaderKernels.h"
+#include "StateCache.h"
+#include "TranslatedShaders.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+using namespace ACW;
+using namespace ACW::ShaderKernels;
+using namespace ACW::SoftwareRasterizer;
+using ShaderBatch::Float;
+using ShaderBatch::Mask;
+using TranslatedShaders::KernelInfo;
+using TranslatedShaders::MaxKernelFloats;
+
+namespace
+{
+	// Distinct input batches the benchmark cycles through, so it does not time one batch's branches alone.
+	const int BenchmarkBatches = 64;
+
+	// Where each Float of a pixel kernel's input comes from in a PixelBatch: a varying by index, or one of these.
+	const int SourceX = -1;
+	const int SourceY = -2;
+	const int SourceDepth = -3;
+	const int SourceW = -4;
+
+	typedef std::array<int, MaxKernelFloats> InputSources;
+
+	const KernelInfo& Info(int kernel)
+	{
+		return TranslatedShaders::Kernels[kernel];
+	}
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	uint32_t Hash(uint32_t seed, uint32_t n)
+	{
+		uint32_t h = seed ^ (n * 0x9e3779b9u);
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// From -1 to 1.
+	float HashedValue(uint32_t seed, uint32_t n)
+	{
+		return static_cast<float>(Hash(seed, n) & 0xffffff) / 8388608.0f - 1.0f;
+	}
+
+	uint32_t CountBits(uint32_t bits)
+	{
+		uint32_t count = 0;
+		for (; bits; bits &= bits - 1)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	InputSources MakeSources(const KernelInfo& info)
+	{
+		InputSources sources;
+		sources.fill(0);
+		int position = info.positionInput >= 0 ? info.inputs[info.positionInput].first : -1;
+		int varying = 0;
+		for (int i = 0; i < info.inputCount; i++)
+		{
+			if (position >= 0 && i >= position && i < position + 4)
+			{
+				sources[i] = SourceX - (i - position);
+			}
+			else
+			{
+				sources[i] = varying++;
+			}
+		}
+		return sources;
+	}
+
+	const float* BatchValues(const PixelBatch& batch, int source)
+	{
+		switch (source)
+		{
+		case SourceX:
+			return batch.x;
+		case SourceY:
+			return batch.y;
+		case SourceDepth:
+			return batch.depth;
+		case SourceW:
+			return batch.w;
+		default:
+			return batch.varyings[source];
+		}
+	}
+
+	// Runs the kernel for the batch's pixels in lanes, writing their colours, and returns those it kept.
+	uint32_t ShadeLanes(const KernelInfo& info, const void* constants, const InputSources& sources, const PixelBatch& batch, float4* colours, uint32_t lanes)
+	{
+		Float input[MaxKernelFloats];
+		Float output[MaxKernelFloats];
+		for (int i = 0; i < info.inputCount; i++)
+		{
+			std::memcpy(input[i].lane, BatchValues(batch, sources[i]), sizeof(input[i].lane));
+		}
+
+		uint32_t kept = info.run(constants, input, output, Mask::FromBits(lanes)).Bits() & lanes;
+
+		const TranslatedShaders::Element& target = info.outputs[info.mainOutput];
+		for (int l = 0; l < batch.count; l++)
+		{
+			if (!(kept & (1u << l)))
+			{
+				continue;
+			}
+			float colour[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			for (int c = 0; c < std::min(target.count, 4); c++)
+			{
+				colour[c] = output[target.first + c].lane[l];
+			}
+			colours[l] = float4(colour[0], colour[1], colour[2], colour[3]);
+		}
+		return kept;
+	}
+
+	// The kernel called once for each pixel of a batch, to measure what running eight at a time gains.
+	BatchPixelShader SingleLaneShader(int kernel, const void* constants)
+	{
+		const KernelInfo* info = &Info(kernel);
+		InputSources sources = MakeSources(*info);
+		return [info, constants, sources](const PixelBatch& batch, float4* colours)
+		{
+			uint32_t kept = 0;
+			for (int l = 0; l < batch.count; l++)
+			{
+				kept |= ShadeLanes(*info, constants, sources, batch, colours, 1u << l);
+			}
+			return kept;
+		};
+	}
+
+	double DrawQuad(const DrawState& state, int width, int height, int threadCount, int varyingCount, Target& target, RasterStats& stats)
+	{
+		target.Resize(width, height, true, false);
+		target.ClearColour(float4(0.0f, 0.0f, 0.0f, 0.0f));
+
+		Rasterizer rasterizer;
+		rasterizer.SetThreadCount(threadCount);
+		rasterizer.SetTargets(&target, nullptr);
+		rasterizer.SetViewport(static_cast<float>(width), static_cast<float>(height));
+
+		static const uint32_t indices[] = { 0, 1, 2, 2, 1, 3 };
+		auto start = std::chrono::steady_clock::now();
+		rasterizer.DrawIndexed(state, indices, 6, 4, [varyingCount](uint32_t index, Vertex& vertex)
+		{
+			vertex.position = float4(index & 1 ? 1.0f : -1.0f, index & 2 ? -1.0f : 1.0f, 0.5f, 1.0f);
+			for (int v = 0; v < varyingCount; v++)
+			{
+				vertex.varyings[v] = HashedValue(index, v);
+			}
+		});
+		rasterizer.Flush();
+		stats = rasterizer.GetStats();
+		return MillisecondsSince(start);
+	}
+}
+
+int ShaderKernels::KernelCount()
+{
+	return TranslatedShaders::KernelCount;
+}
+
+int ShaderKernels::FindKernel(const char* name)
+{
+	for (int kernel = 0; kernel < TranslatedShaders::KernelCount; kernel++)
+	{
+		if (std::strcmp(Info(kernel).name, name) == 0)
+		{
+			return kernel;
+		}
+	}
+	return -1;
+}
+
+const char* ShaderKernels::KernelName(int kernel)
+{
+	return Info(kernel).name;
+}
+
+bool ShaderKernels::IsPixelKernel(int kernel)
+{
+	return Info(kernel).stage == TranslatedShaders::KernelStage::Pixel;
+}
+
+int ShaderKernels::InputCount(int kernel)
+{
+	return Info(kernel).inputCount;
+}
+
+int ShaderKernels::OutputCount(int kernel)
+{
+	return Info(kernel).outputCount;
+}
+
+size_t ShaderKernels::ConstantsSize(int kernel)
+{
+	return Info(kernel).constantsSize;
+}
+
+int ShaderKernels::VaryingCount(int kernel)
+{
+	const KernelInfo& info = Info(kernel);
+	return info.positionInput >= 0 ? info.inputCount - info.inputs[info.positionInput].count : info.inputCount;
+}
+
+BatchPixelShader ShaderKernels::PixelShader(int kernel, const void* constants)
+{
+	const KernelInfo* info = &Info(kernel);
+	InputSources sources = MakeSources(*info);
+	return [info, constants, sources](const PixelBatch& batch, float4* colours)
+	{
+		return ShadeLanes(*info, constants, sources, batch, colours, (1u << batch.count) - 1);
+	};
+}
+
+void ShaderKernels::RunKernel(int kernel, const void* constants, const float* inputs, uint32_t count, float* outputs, uint8_t* kept)
+{
+	const KernelInfo& info = Info(kernel);
+	Float input[MaxKernelFloats];
+	Float output[MaxKernelFloats];
+	for (uint32_t first = 0; first < count; first += ShaderBatch::Lanes)
+	{
+		uint32_t lanes = std::min<uint32_t>(count - first, ShaderBatch::Lanes);
+		for (int i = 0; i < info.inputCount; i++)
+		{
+			for (uint32_t l = 0; l < ShaderBatch::Lanes; l++)
+			{
+				input[i].lane[l] = l < lanes ? inputs[(first + l) * info.inputCount + i] : 0.0f;
+			}
+		}
+
+		uint32_t bits = info.run(constants, input, output, Mask::FromBits((1u << lanes) - 1)).Bits();
+
+		for (uint32_t l = 0; l < lanes; l++)
+		{
+			for (int o = 0; o < info.outputCount; o++)
+			{
+				outputs[(first + l) * info.outputCount + o] = output[o].lane[l];
+			}
+			if (kept)
+			{
+				kept[first + l] = (bits >> l) & 1;
+			}
+		}
+	}
+}
+
+std::vector<KernelBenchmark> ShaderKernels::RunKernelBenchmarks(uint32_t invocations, int width, int height, int threadCount)
+{
+	std::vector<KernelBenchmark> results;
+	uint32_t calls = std::max<uint32_t>(invocations / ShaderBatch::Lanes, 1);
+	width = std::max(width, 1);
+	height = std::max(height, 1);
+
+	for (int kernel = 0; kernel < TranslatedShaders::KernelCount; kernel++)
+	{
+		const KernelInfo& info = Info(kernel);
+		KernelBenchmark result = {};
+		result.name = info.name;
+		result.pixelShader = IsPixelKernel(kernel);
+		result.inputCount = info.inputCount;
+		result.outputCount = info.outputCount;
+		result.invocations = calls * ShaderBatch::Lanes;
+
+		std::vector<float> constants((info.constantsSize + sizeof(float) - 1) / sizeof(float) + 1);
+		for (size_t i = 0; i < constants.size(); i++)
+		{
+			constants[i] = HashedValue(0x5eed0000u + kernel, static_cast<uint32_t>(i));
+		}
+
+		std::vector<float> inputs(BenchmarkBatches * ShaderBatch::Lanes * info.inputCount);
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			inputs[i] = HashedValue(kernel, static_cast<uint32_t>(i));
+		}
+
+		Float batches[BenchmarkBatches][MaxKernelFloats];
+		for (int b = 0; b < BenchmarkBatches; b++)
+		{
+			for (int i = 0; i < info.inputCount; i++)
+			{
+				for (int l = 0; l < ShaderBatch::Lanes; l++)
+				{
+					batches[b][i].lane[l] = inputs[(b * ShaderBatch::Lanes + l) * info.inputCount + i];
+				}
+			}
+		}
+
+		Float output[MaxKernelFloats];
+		Mask all = Mask::All();
+		uint32_t discarded = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t call = 0; call < calls; call++)
+		{
+			discarded += ShaderBatch::Lanes - CountBits(info.run(constants.data(), batches[call % BenchmarkBatches], output, all).Bits());
+		}
+		result.milliseconds = MillisecondsSince(start);
+		result.discarded = discarded;
+		result.invocationsPerSecond = result.milliseconds > 0.0 ? result.invocations / (result.milliseconds / 1000.0) : 0.0;
+
+		uint32_t hashed = BenchmarkBatches * ShaderBatch::Lanes;
+		std::vector<float> outputs(hashed * info.outputCount, 0.0f);
+		std::vector<uint8_t> keptFlags(hashed);
+		RunKernel(kernel, constants.data(), inputs.data(), hashed, outputs.data(), keptFlags.data());
+		for (uint32_t i = 0; i < hashed; i++)
+		{
+			if (!keptFlags[i])
+			{
+				std::fill(outputs.begin() + i * info.outputCount, outputs.begin() + (i + 1) * info.outputCount, 0.0f);
+			}
+		}
+		result.outputHash = StateCache::HashBytes(outputs.data(), outputs.size() * sizeof(float)) ^ StateCache::HashBytes(keptFlags.data(), keptFlags.size());
+
+		if (result.pixelShader && VaryingCount(kernel) <= MaxVaryings)
+		{
+			DrawState state;
+			state.depthEnable = false;
+			state.depthWrite = false;
+			state.varyingCount = VaryingCount(kernel);
+
+			Target batched;
+			Target single;
+			RasterStats stats;
+			state.batchPixelShader = PixelShader(kernel, constants.data());
+			result.rasterMilliseconds = DrawQuad(state, width, height, threadCount, state.varyingCount, batched, stats);
+			state.batchPixelShader = SingleLaneShader(kernel, constants.data());
+			result.rasterSingleMilliseconds = DrawQuad(state, width, height, threadCount, state.varyingCount, single, stats);
+
+			for (size_t i = 0; i < batched.colour.size(); i++)
+			{
+				if (std::memcmp(&batched.colour[i], &single.colour[i], sizeof(float4)) != 0)
+				{
+					result.rasterMismatches++;
+				}
+			}
+		}
+
+		results.push_back(result);
+	}
+	return results;
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "SoftwareRasterizer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ACW
+{
+	// Runs the kernels Tools/HlslTranslator.py makes from the shaders in TranslatedShaders.txt, eight invocations at a
+	// time. A kernel is known by the index of its shader in the list. Pixel kernels draw through the software
+	// rasterizer as batch pixel shaders, and vertex kernels transform a draw's vertices before it is made. The
+	// benchmarks run whatever the list holds, so a shader added to it is measured with nothing more to write.
+	namespace ShaderKernels
+	{
+		int KernelCount();
+
+		// Index of the kernel made from the named shader, its file name without .hlsl, or -1.
+		int FindKernel(const char* name);
+
+		const char* KernelName(int kernel);
+		bool IsPixelKernel(int kernel);
+
+		// Floats a kernel reads and writes for each invocation, its inputs and outputs in the order they are declared.
+		int InputCount(int kernel);
+		int OutputCount(int kernel);
+
+		// Bytes of the kernel's constant buffers laid out one after another as HLSL packs them, in register order.
+		size_t ConstantsSize(int kernel);
+
+		// Inputs of a pixel kernel besides SV_Position, which the rasterizer interpolates as varyings.
+		int VaryingCount(int kernel);
+
+		// A batch pixel shader running a pixel kernel. SV_Position gets the pixel centre, depth and w, the other
+		// inputs the draw's varyings in order, and the first SV_Target becomes the colour. constants must outlive it.
+		SoftwareRasterizer::BatchPixelShader PixelShader(int kernel, const void* constants);
+
+		// Runs the kernel for count invocations, InputCount floats each from inputs and OutputCount floats each to
+		// outputs. kept, when not null, gets 1 for each invocation a pixel kernel did not discard.
+		void RunKernel(int kernel, const void* constants, const float* inputs, uint32_t count, float* outputs, uint8_t* kept);
+
+		struct KernelBenchmark
+		{
+			std::string name;
+			bool pixelShader;
+			int inputCount;
+			int outputCount;
+
+			// The kernel run on its own for invocations of hashed inputs and constants, and the ones it discarded.
+			uint32_t invocations;
+			uint32_t discarded;
+			double milliseconds;
+			double invocationsPerSecond;
+
+			// A pixel kernel drawing a full screen quad through the rasterizer, eight pixels to a call and one, with the
+			// pixels whose colour differs between the two, which should be none. Left at 0 for vertex kernels.
+			double rasterMilliseconds;
+			double rasterSingleMilliseconds;
+			uint32_t rasterMismatches;
+
+			// Hash of the outputs of the first invocations, for comparing the builds with and without AVX2.
+			uint64_t outputHash;
+		};
+
+		// Every kernel of the list, in its order.
+		std::vector<KernelBenchmark> RunKernelBenchmarks(uint32_t invocations, int width, int height, int threadCount);
+	}
+}
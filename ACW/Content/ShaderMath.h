@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+namespace ACW
+{
+	// Minimal HLSL-style vector types and intrinsics so that CPU reference ports of the
+	// Content shaders can be written (and diffed) line for line against the .hlsl sources.
+	namespace ShaderMath
+	{
+		struct float2
+		{
+			float x, y;
+
+			float2() : x(0.0f), y(0.0f) {}
+			explicit float2(float s) : x(s), y(s) {}
+			float2(float px, float py) : x(px), y(py) {}
+
+			float2& operator+=(const float2& o) { x += o.x; y += o.y; return *this; }
+			float2& operator-=(const float2& o) { x -= o.x; y -= o.y; return *this; }
+			float2& operator*=(float s) { x *= s; y *= s; return *this; }
+		};
+
+		struct float3
+		{
+			float x, y, z;
+
+			float3() : x(0.0f), y(0.0f), z(0.0f) {}
+			explicit float3(float s) : x(s), y(s), z(s) {}
+			float3(float px, float py, float pz) : x(px), y(py), z(pz) {}
+
+			float2 xy() const { return float2(x, y); }
+			float2 xz() const { return float2(x, z); }
+
+			float3& operator+=(const float3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+			float3& operator-=(const float3& o) { x -= o.x; y -= o.y; z -= o.z; return *this; }
+			float3& operator*=(float s) { x *= s; y *= s; z *= s; return *this; }
+		};
+
+		struct float4
+		{
+			float x, y, z, w;
+
+			float4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+			float4(float px, float py, float pz, float pw) : x(px), y(py), z(pz), w(pw) {}
+			float4(const float3& v, float pw) : x(v.x), y(v.y), z(v.z), w(pw) {}
+
+			float3 xyz() const { return float3(x, y, z); }
+		};
+
+		// float2 operators
+		inline float2 operator+(const float2& a, const float2& b) { return float2(a.x + b.x, a.y + b.y); }
+		inline float2 operator-(const float2& a, const float2& b) { return float2(a.x - b.x, a.y - b.y); }
+		inline float2 operator*(const float2& a, const float2& b) { return float2(a.x * b.x, a.y * b.y); }
+		inline float2 operator*(const float2& a, float s) { return float2(a.x * s, a.y * s); }
+		inline float2 operator*(float s, const float2& a) { return float2(a.x * s, a.y * s); }
+		inline float2 operator/(const float2& a, float s) { return float2(a.x / s, a.y / s); }
+		inline float2 operator-(const float2& a) { return float2(-a.x, -a.y); }
+
+		// float3 operators
+		inline float3 operator+(const float3& a, const float3& b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+		inline float3 operator-(const float3& a, const float3& b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+		inline float3 operator*(const float3& a, const float3& b) { return float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+		inline float3 operator/(const float3& a, const float3& b) { return float3(a.x / b.x, a.y / b.y, a.z / b.z); }
+		inline float3 operator+(const float3& a, float s) { return float3(a.x + s, a.y + s, a.z + s); }
+		inline float3 operator+(float s, const float3& a) { return float3(a.x + s, a.y + s, a.z + s); }
+		inline float3 operator-(const float3& a, float s) { return float3(a.x - s, a.y - s, a.z - s); }
+		inline float3 operator*(const float3& a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+		inline float3 operator*(float s, const float3& a) { return float3(a.x * s, a.y * s, a.z * s); }
+		inline float3 operator/(const float3& a, float s) { return float3(a.x / s, a.y / s, a.z / s); }
+		inline float3 operator/(float s, const float3& a) { return float3(s / a.x, s / a.y, s / a.z); }
+		inline float3 operator-(const float3& a) { return float3(-a.x, -a.y, -a.z); }
+
+		// Intrinsics
+		inline float dot(const float2& a, const float2& b) { return a.x * b.x + a.y * b.y; }
+		inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline float length(const float2& v) { return std::sqrt(dot(v, v)); }
+		inline float length(const float3& v) { return std::sqrt(dot(v, v)); }
+		inline float3 normalize(const float3& v) { return v / length(v); }
+		inline float3 cross(const float3& a, const float3& b) { return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+		inline float3 reflect(const float3& i, const float3& n) { return i - 2.0f * dot(n, i) * n; }
+
+		inline float clamp(float v, float lo, float hi) { return std::min(std::max(v, lo), hi); }
+		inline float saturate(float v) { return clamp(v, 0.0f, 1.0f); }
+		inline float lerp(float a, float b, float s) { return a + (b - a) * s; }
+		inline float frac(float v) { return v - std::floor(v); }
+		inline float sign(float v) { return v > 0.0f ? 1.0f : (v < 0.0f ? -1.0f : 0.0f); }
+		inline float smoothstep(float a, float b, float v) { float t = saturate((v - a) / (b - a)); return t * t * (3.0f - 2.0f * t); }
+
+		inline float2 floor(const float2& v) { return float2(std::floor(v.x), std::floor(v.y)); }
+		inline float2 frac(const float2& v) { return float2(frac(v.x), frac(v.y)); }
+		inline float2 lerp(const float2& a, const float2& b, float s) { return a + (b - a) * s; }
+
+		inline float3 abs(const float3& v) { return float3(std::fabs(v.x), std::fabs(v.y), std::fabs(v.z)); }
+		inline float3 min(const float3& a, const float3& b) { return float3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+		inline float3 max(const float3& a, const float3& b) { return float3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+		inline float3 sin(const float3& v) { return float3(std::sin(v.x), std::sin(v.y), std::sin(v.z)); }
+		inline float3 clamp(const float3& v, float lo, float hi) { return float3(clamp(v.x, lo, hi), clamp(v.y, lo, hi), clamp(v.z, lo, hi)); }
+		inline float3 saturate(const float3& v) { return clamp(v, 0.0f, 1.0f); }
+		inline float3 lerp(const float3& a, const float3& b, float s) { return a + (b - a) * s; }
+	}
+}
@@ -11,6 +11,11 @@ namespace ACW
 		DirectX::XMFLOAT4 eye;
 		DirectX::XMFLOAT4 lookAt;
 		DirectX::XMFLOAT4 upDir;
+
+		// Derived from the matrices above in Sample3DSceneRenderer::UpdateDerivedMatrices when the camera moves.
+		DirectX::XMFLOAT4X4 viewProjection;
+		DirectX::XMFLOAT4X4 inverseViewProjection;
+		DirectX::XMFLOAT4X4 inverseModel;
 	};
 
 	struct LightConstantBuffer
@@ -25,6 +30,24 @@ namespace ACW
 		DirectX::XMFLOAT3 padding;
 	};
 
+	// Constant buffer used by the upsample of the reduced resolution raymarch targets and the coral shade passes.
+	struct UpsampleConstantBuffer
+	{
+		float resolutionScale;
+		float shadingRate;
+		DirectX::XMFLOAT2 padding;
+	};
+
+	// Must match CoralMeshMaxVariants in CoralVertexShader.hlsl.
+	static const int CoralMeshMaxVariants = 16;
+
+	// Bounding box of each coral mesh variant, that VertexQuantization normalised its positions within.
+	struct CoralMeshBoundsConstantBuffer
+	{
+		DirectX::XMFLOAT4 minimum[CoralMeshMaxVariants];
+		DirectX::XMFLOAT4 extent[CoralMeshMaxVariants];
+	};
+
 	// Used to send per-vertex data to the vertex shader.
 	struct Vertex
 	{
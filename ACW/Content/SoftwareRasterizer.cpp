@@ -0,0 +1,1063 @@
+﻿#include "pch.h"
+#include "SoftwareRasterizer.h"
+#include "PlantInstances.h"
+#include "StateCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+// ARM builds walk the edges one pixel at a time
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define SOFTWARE_RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::SoftwareRasterizer;
+
+namespace
+{
+	const int SubpixelScale = 1 << SubpixelBits;
+	const int HalfPixel = SubpixelScale / 2;
+
+	// Near, far, and the four sides of the guard band.
+	const int ClipPlanes = 6;
+	// A triangle gains at most a vertex from each plane it is clipped against.
+	const int MaxClipVertices = 3 + ClipPlanes;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	int FloorDiv(int32_t value, int divisor)
+	{
+		return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+
+	float PlaneDistance(int plane, const float4& p, float guardX, float guardY)
+	{
+		switch (plane)
+		{
+		case 0:
+			return p.z;
+		case 1:
+			return p.w - p.z;
+		case 2:
+			return p.x + guardX * p.w;
+		case 3:
+			return guardX * p.w - p.x;
+		case 4:
+			return p.y + guardY * p.w;
+		default:
+			return guardY * p.w - p.y;
+		}
+	}
+
+	Vertex LerpVertex(const Vertex& a, const Vertex& b, float t, int varyingCount)
+	{
+		Vertex v;
+		v.position = float4(lerp(a.position.x, b.position.x, t), lerp(a.position.y, b.position.y, t), lerp(a.position.z, b.position.z, t), lerp(a.position.w, b.position.w, t));
+		for (int i = 0; i < varyingCount; i++)
+		{
+			v.varyings[i] = lerp(a.varyings[i], b.varyings[i], t);
+		}
+		return v;
+	}
+}
+
+void Target::Resize(int targetWidth, int targetHeight, bool hasColour, bool hasDepth)
+{
+	width = targetWidth;
+	height = targetHeight;
+	size_t pixels = static_cast<size_t>(width) * height;
+	colour.assign(hasColour ? pixels : 0, float4());
+	depth.assign(hasDepth ? pixels : 0, 1.0f);
+}
+
+void Target::ClearColour(const float4& value)
+{
+	std::fill(colour.begin(), colour.end(), value);
+}
+
+void Target::ClearDepth(float value)
+{
+	std::fill(depth.begin(), depth.end(), value);
+}
+
+Rasterizer::Rasterizer() :
+	mThreadCount(0),
+	mColour(nullptr),
+	mDepth(nullptr),
+	mViewportWidth(0.0f),
+	mViewportHeight(0.0f),
+	mTilesX(0),
+	mTilesY(0),
+	mStats()
+{
+}
+
+void Rasterizer::SetTargets(Target* colour, Target* depth)
+{
+	Flush();
+	mColour = colour;
+	mDepth = depth;
+}
+
+void Rasterizer::SetViewport(float width, float height)
+{
+	mViewportWidth = width;
+	mViewportHeight = height;
+}
+
+void Rasterizer::ResetStats()
+{
+	mStats = RasterStats();
+}
+
+uint32_t Rasterizer::AddDraw(const DrawState& state)
+{
+	mDraws.push_back(state);
+	DrawState& draw = mDraws.back();
+	draw.varyingCount = std::min(std::max(draw.varyingCount, 0), MaxVaryings);
+	mStats.draws++;
+	return static_cast<uint32_t>(mDraws.size() - 1);
+}
+
+void Rasterizer::DrawIndexed(const DrawState& state, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, const std::function<void(uint32_t, Vertex&)>& vertex)
+{
+	auto start = std::chrono::steady_clock::now();
+	uint32_t draw = AddDraw(state);
+
+	// Each vertex shaded once, however many triangles share it
+	mVertices.resize(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		vertex(i, mVertices[i]);
+	}
+	AddTriangles(draw, indices, indexCount);
+	mStats.setupMilliseconds += MillisecondsSince(start);
+}
+
+void Rasterizer::DrawQuadPatch(const DrawState& state, int tessFactor, const std::function<void(const float2&, Vertex&)>& domain)
+{
+	auto start = std::chrono::steady_clock::now();
+	uint32_t draw = AddDraw(state);
+
+	int cells = std::max(tessFactor, 1);
+	int row = cells + 1;
+	mVertices.resize(static_cast<size_t>(row) * row);
+	for (int v = 0; v <= cells; v++)
+	{
+		for (int u = 0; u <= cells; u++)
+		{
+			domain(float2(static_cast<float>(u) / cells, static_cast<float>(v) / cells), mVertices[v * row + u]);
+		}
+	}
+
+	mIndices.clear();
+	for (int v = 0; v < cells; v++)
+	{
+		for (int u = 0; u < cells; u++)
+		{
+			uint32_t corner = static_cast<uint32_t>(v * row + u);
+			uint32_t quad[6] = { corner, corner + 1, corner + row, corner + row, corner + 1, corner + row + 1 };
+			mIndices.insert(mIndices.end(), quad, quad + 6);
+		}
+	}
+	AddTriangles(draw, mIndices.data(), static_cast<uint32_t>(mIndices.size()));
+	mStats.setupMilliseconds += MillisecondsSince(start);
+}
+
+void Rasterizer::DrawPoints(const DrawState& state, uint32_t pointCount, const std::function<void(uint32_t, Point&)>& point)
+{
+	auto start = std::chrono::steady_clock::now();
+	uint32_t draw = AddDraw(state);
+	int ownVaryings = std::max(mDraws[draw].varyingCount - 2, 0);
+
+	// Corners top left, top right, bottom left and bottom right, as the plant geometry shader emitted its strip
+	static const float cornerX[4] = { -1.0f, 1.0f, -1.0f, 1.0f };
+	static const float cornerY[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+
+	mVertices.resize(static_cast<size_t>(pointCount) * 4);
+	mIndices.clear();
+	Point p;
+	for (uint32_t i = 0; i < pointCount; i++)
+	{
+		point(i, p);
+		for (int c = 0; c < 4; c++)
+		{
+			Vertex& corner = mVertices[i * 4 + c];
+			corner.position = float4(p.position.x + cornerX[c] * p.halfSize.x, p.position.y + cornerY[c] * p.halfSize.y, p.position.z, p.position.w);
+			std::memcpy(corner.varyings, p.varyings, ownVaryings * sizeof(float));
+			corner.varyings[ownVaryings] = 0.5f + 0.5f * cornerX[c];
+			corner.varyings[ownVaryings + 1] = 0.5f - 0.5f * cornerY[c];
+		}
+
+		uint32_t first = i * 4;
+		uint32_t quad[6] = { first, first + 1, first + 2, first + 2, first + 1, first + 3 };
+		mIndices.insert(mIndices.end(), quad, quad + 6);
+	}
+	AddTriangles(draw, mIndices.data(), static_cast<uint32_t>(mIndices.size()));
+	mStats.setupMilliseconds += MillisecondsSince(start);
+}
+
+void Rasterizer::AddTriangles(uint32_t draw, const uint32_t* indices, uint32_t indexCount)
+{
+	uint32_t vertexCount = static_cast<uint32_t>(mVertices.size());
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		mStats.triangles++;
+		if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+		{
+			mStats.culledTriangles++;
+			continue;
+		}
+
+		const Vertex* corners[3] = { &mVertices[indices[i]], &mVertices[indices[i + 1]], &mVertices[indices[i + 2]] };
+		ClipAndSetUp(draw, corners);
+	}
+}
+
+void Rasterizer::ClipAndSetUp(uint32_t draw, const Vertex* corners[3])
+{
+	// The guard band in clip space, wide enough that snapped positions stay far from overflowing the edge walk
+	float guardX = mViewportWidth > 0.0f ? 1.0f + 2.0f * GuardBandPixels / mViewportWidth : 1.0f;
+	float guardY = mViewportHeight > 0.0f ? 1.0f + 2.0f * GuardBandPixels / mViewportHeight : 1.0f;
+
+	int outside[3] = { 0, 0, 0 };
+	for (int c = 0; c < 3; c++)
+	{
+		for (int plane = 0; plane < ClipPlanes; plane++)
+		{
+			if (PlaneDistance(plane, corners[c]->position, guardX, guardY) < 0.0f)
+			{
+				outside[c] |= 1 << plane;
+			}
+		}
+	}
+
+	if ((outside[0] | outside[1] | outside[2]) == 0)
+	{
+		SetUp(draw, *corners[0], *corners[1], *corners[2]);
+		return;
+	}
+	if ((outside[0] & outside[1] & outside[2]) != 0)
+	{
+		mStats.culledTriangles++;
+		return;
+	}
+
+	int varyingCount = mDraws[draw].varyingCount;
+	Vertex polygons[2][MaxClipVertices];
+	int count = 3;
+	for (int c = 0; c < 3; c++)
+	{
+		polygons[0][c] = *corners[c];
+	}
+
+	int current = 0;
+	for (int plane = 0; plane < ClipPlanes && count >= 3; plane++)
+	{
+		if (((outside[0] | outside[1] | outside[2]) & (1 << plane)) == 0)
+		{
+			continue;
+		}
+
+		const Vertex* in = polygons[current];
+		Vertex* out = polygons[1 - current];
+		int outCount = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const Vertex& a = in[i];
+			const Vertex& b = in[(i + 1) % count];
+			float da = PlaneDistance(plane, a.position, guardX, guardY);
+			float db = PlaneDistance(plane, b.position, guardX, guardY);
+			if (da >= 0.0f)
+			{
+				out[outCount++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				out[outCount++] = LerpVertex(a, b, da / (da - db), varyingCount);
+			}
+		}
+		count = outCount;
+		current = 1 - current;
+	}
+
+	if (count < 3)
+	{
+		mStats.culledTriangles++;
+		return;
+	}
+
+	const Vertex* polygon = polygons[current];
+	for (int i = 1; i + 1 < count; i++)
+	{
+		mStats.clippedTriangles++;
+		SetUp(draw, polygon[0], polygon[i], polygon[i + 1]);
+	}
+}
+
+void Rasterizer::SetUp(uint32_t draw, const Vertex& a, const Vertex& b, const Vertex& c)
+{
+	const DrawState& state = mDraws[draw];
+	Target* size = mColour ? mColour : mDepth;
+	if (!size)
+	{
+		mStats.culledTriangles++;
+		return;
+	}
+
+	Triangle triangle;
+	triangle.draw = draw;
+	const Vertex* corners[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; i++)
+	{
+		const float4& p = corners[i]->position;
+		ScreenVertex& v = triangle.v[i];
+		if (p.w <= 0.0f)
+		{
+			mStats.culledTriangles++;
+			return;
+		}
+
+		v.invW = 1.0f / p.w;
+		float screenX = (p.x * v.invW * 0.5f + 0.5f) * mViewportWidth;
+		float screenY = (0.5f - p.y * v.invW * 0.5f) * mViewportHeight;
+		v.x = static_cast<int32_t>(std::lround(screenX * SubpixelScale));
+		v.y = static_cast<int32_t>(std::lround(screenY * SubpixelScale));
+		v.z = saturate(p.z * v.invW);
+		for (int k = 0; k < state.varyingCount; k++)
+		{
+			v.varyings[k] = corners[i]->varyings[k] * v.invW;
+		}
+	}
+
+	// Twice the area in subpixels squared, positive when the triangle winds clockwise on screen
+	const ScreenVertex* v = triangle.v;
+	int64_t area = static_cast<int64_t>(v[2].x - v[1].x) * (v[0].y - v[1].y) - static_cast<int64_t>(v[2].y - v[1].y) * (v[0].x - v[1].x);
+	if (area < 0)
+	{
+		if (state.cull == CullMode::Back)
+		{
+			mStats.culledTriangles++;
+			return;
+		}
+		std::swap(triangle.v[1], triangle.v[2]);
+		area = -area;
+	}
+	if (area == 0)
+	{
+		mStats.culledTriangles++;
+		return;
+	}
+	triangle.area = area;
+	triangle.invArea = static_cast<float>(1.0 / static_cast<double>(area));
+
+	// Pixels whose centres could fall inside, within the viewport and the target
+	int right = std::min(size->width, static_cast<int>(std::ceil(mViewportWidth))) - 1;
+	int bottom = std::min(size->height, static_cast<int>(std::ceil(mViewportHeight))) - 1;
+	triangle.minX = std::max(FloorDiv(std::min(std::min(v[0].x, v[1].x), v[2].x), SubpixelScale), 0);
+	triangle.minY = std::max(FloorDiv(std::min(std::min(v[0].y, v[1].y), v[2].y), SubpixelScale), 0);
+	triangle.maxX = std::min(FloorDiv(std::max(std::max(v[0].x, v[1].x), v[2].x), SubpixelScale), right);
+	triangle.maxY = std::min(FloorDiv(std::max(std::max(v[0].y, v[1].y), v[2].y), SubpixelScale), bottom);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		mStats.culledTriangles++;
+		return;
+	}
+
+	mStats.setupTriangles++;
+	mTriangles.push_back(triangle);
+}
+
+void Rasterizer::Flush()
+{
+	Target* size = mColour ? mColour : mDepth;
+	if (mTriangles.empty() || !size)
+	{
+		mTriangles.clear();
+		mDraws.clear();
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	mTilesX = (size->width + TileSize - 1) / TileSize;
+	mTilesY = (size->height + TileSize - 1) / TileSize;
+	Bin();
+	mStats.binMilliseconds += MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<int> tiles;
+	for (int tile = 0; tile < static_cast<int>(mBins.size()); tile++)
+	{
+		if (!mBins[tile].empty())
+		{
+			tiles.push_back(tile);
+		}
+	}
+
+	// Starting threads for each flush, several times a frame, cost more than the tiles gained from them
+	int poolThreads = WorkerThreads::Resolve(mThreadCount);
+	if (!mWorkers || mWorkers->ThreadCount() != poolThreads)
+	{
+		mWorkers.reset(new WorkerThreads::Pool(poolThreads));
+	}
+
+	int threadCount = static_cast<int>(std::min<size_t>(poolThreads, tiles.size()));
+	std::vector<TileStats> threadStats(threadCount, TileStats());
+	std::atomic<size_t> next(0);
+	mWorkers->Run(threadCount, [&](int thread)
+	{
+		for (size_t i = next++; i < tiles.size(); i = next++)
+		{
+			RasteriseTile(tiles[i], threadStats[thread]);
+		}
+	});
+
+	for (const TileStats& stats : threadStats)
+	{
+		mStats.pixelsCovered += stats.pixelsCovered;
+		mStats.pixelsShaded += stats.pixelsShaded;
+		mStats.pixelsWritten += stats.pixelsWritten;
+	}
+	mStats.tiles += static_cast<uint32_t>(tiles.size());
+	mStats.threads = std::max(mStats.threads, threadCount);
+	mStats.rasterMilliseconds += MillisecondsSince(start);
+
+	mTriangles.clear();
+	mDraws.clear();
+}
+
+void Rasterizer::Bin()
+{
+	mBins.resize(static_cast<size_t>(mTilesX) * mTilesY);
+	for (std::vector<uint32_t>& bin : mBins)
+	{
+		bin.clear();
+	}
+
+	// In the order they were drawn, so every bin keeps it
+	for (uint32_t t = 0; t < mTriangles.size(); t++)
+	{
+		const Triangle& triangle = mTriangles[t];
+		for (int ty = triangle.minY / TileSize; ty <= triangle.maxY / TileSize; ty++)
+		{
+			for (int tx = triangle.minX / TileSize; tx <= triangle.maxX / TileSize; tx++)
+			{
+				mBins[ty * mTilesX + tx].push_back(t);
+				mStats.binnedTriangles++;
+			}
+		}
+	}
+}
+
+void Rasterizer::RasteriseTile(int tile, TileStats& stats) const
+{
+	int tileX = (tile % mTilesX) * TileSize;
+	int tileY = (tile / mTilesX) * TileSize;
+	for (uint32_t t : mBins[tile])
+	{
+		const Triangle& triangle = mTriangles[t];
+		int x0 = std::max(tileX, triangle.minX);
+		int y0 = std::max(tileY, triangle.minY);
+		int x1 = std::min(tileX + TileSize - 1, triangle.maxX);
+		int y1 = std::min(tileY + TileSize - 1, triangle.maxY);
+		RasteriseTriangle(triangle, x0, y0, x1, y1, stats);
+	}
+}
+
+void Rasterizer::RasteriseTriangle(const Triangle& triangle, int x0, int y0, int x1, int y1, TileStats& stats) const
+{
+	// Edge e is opposite vertex e and positive inside. Its value at the first pixel is found exactly in 64 bits,
+	// and across the tile only the change from it is walked, which fits in 32 bits within the guard band.
+	int64_t origin[3];
+	int32_t threshold[3];
+	int32_t stepX[3];
+	int32_t stepY[3];
+	for (int e = 0; e < 3; e++)
+	{
+		const ScreenVertex& a = triangle.v[(e + 1) % 3];
+		const ScreenVertex& b = triangle.v[(e + 2) % 3];
+		int32_t dx = a.y - b.y;
+		int32_t dy = b.x - a.x;
+
+		// Pixels on an edge belong to the triangle it is a top or left edge of, so none is drawn twice
+		bool topLeft = dx > 0 || (dx == 0 && dy > 0);
+		int64_t px = static_cast<int64_t>(x0) * SubpixelScale + HalfPixel;
+		int64_t py = static_cast<int64_t>(y0) * SubpixelScale + HalfPixel;
+		origin[e] = dx * (px - a.x) + dy * (py - a.y);
+		stepX[e] = dx * SubpixelScale;
+		stepY[e] = dy * SubpixelScale;
+
+		// Covered where origin + change > -1 or, off a top left edge, > 0. Tiles wholly to one side clamp to always or never
+		int64_t highest = origin[e] + std::max<int64_t>(static_cast<int64_t>(stepX[e]) * (x1 - x0), 0) + std::max<int64_t>(static_cast<int64_t>(stepY[e]) * (y1 - y0), 0);
+		if (highest < (topLeft ? 0 : 1))
+		{
+			return;
+		}
+		int64_t limit = -origin[e] - (topLeft ? 1 : 0);
+		threshold[e] = static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(limit, INT32_MIN), INT32_MAX));
+	}
+
+	PixelQueue queue;
+	queue.batch.count = 0;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		int32_t row[3];
+		for (int e = 0; e < 3; e++)
+		{
+			row[e] = stepY[e] * (y - y0);
+		}
+
+#if defined(SOFTWARE_RASTERIZER_SSE2)
+		__m128i change[3];
+		__m128i step[3];
+		__m128i limit[3];
+		for (int e = 0; e < 3; e++)
+		{
+			change[e] = _mm_add_epi32(_mm_set1_epi32(row[e]), _mm_setr_epi32(0, stepX[e], 2 * stepX[e], 3 * stepX[e]));
+			step[e] = _mm_set1_epi32(4 * stepX[e]);
+			limit[e] = _mm_set1_epi32(threshold[e]);
+		}
+
+		for (int x = x0; x <= x1; x += 4)
+		{
+			__m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(change[0], limit[0]), _mm_cmpgt_epi32(change[1], limit[1])), _mm_cmpgt_epi32(change[2], limit[2]));
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(inside));
+			if (x1 - x < 3)
+			{
+				mask &= (1 << (x1 - x + 1)) - 1;
+			}
+			for (int lane = 0; mask != 0; lane++, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					int32_t offset = x - x0 + lane;
+					ShadePixel(triangle, x + lane, y, origin[1] + row[1] + stepX[1] * offset, origin[2] + row[2] + stepX[2] * offset, queue, stats);
+				}
+			}
+
+			for (int e = 0; e < 3; e++)
+			{
+				change[e] = _mm_add_epi32(change[e], step[e]);
+			}
+		}
+#else
+		for (int x = x0; x <= x1; x++)
+		{
+			int32_t offset = x - x0;
+			bool inside = true;
+			for (int e = 0; e < 3; e++)
+			{
+				inside = inside && row[e] + stepX[e] * offset > threshold[e];
+			}
+			if (inside)
+			{
+				ShadePixel(triangle, x, y, origin[1] + row[1] + stepX[1] * offset, origin[2] + row[2] + stepX[2] * offset, queue, stats);
+			}
+		}
+#endif
+	}
+
+	if (queue.batch.count > 0)
+	{
+		ShadeBatch(triangle, queue, stats);
+	}
+}
+
+void Rasterizer::ShadePixel(const Triangle& triangle, int x, int y, int64_t e1, int64_t e2, PixelQueue& queue, TileStats& stats) const
+{
+	const DrawState& state = mDraws[triangle.draw];
+	const ScreenVertex* v = triangle.v;
+	size_t pixel = static_cast<size_t>(y) * (mColour ? mColour->width : mDepth->width) + x;
+	stats.pixelsCovered++;
+
+	// Screen space weights, depth interpolates linearly in them
+	float b1 = static_cast<float>(e1) * triangle.invArea;
+	float b2 = static_cast<float>(e2) * triangle.invArea;
+	float z = v[0].z + b1 * (v[1].z - v[0].z) + b2 * (v[2].z - v[0].z);
+
+	if (state.depthEnable && mDepth)
+	{
+		float stored = mDepth->depth[pixel];
+		if (state.depthFunc == DepthFunc::Less ? !(z < stored) : !(z <= stored))
+		{
+			return;
+		}
+	}
+
+	if (state.batchPixelShader)
+	{
+		// A triangle covers each pixel once, so its depth tests do not depend on the writes still queued
+		PixelBatch& batch = queue.batch;
+		int lane = batch.count++;
+		batch.x[lane] = x + 0.5f;
+		batch.y[lane] = y + 0.5f;
+		batch.depth[lane] = z;
+		batch.w[lane] = Interpolate(triangle, b1, b2, &batch.varyings[0][lane], PixelBatchSize);
+		queue.pixels[lane] = pixel;
+		if (batch.count == PixelBatchSize)
+		{
+			ShadeBatch(triangle, queue, stats);
+		}
+		return;
+	}
+
+	float varyings[MaxVaryings];
+	Interpolate(triangle, b1, b2, varyings, 1);
+
+	PixelInput input;
+	input.position = float2(x + 0.5f, y + 0.5f);
+	input.depth = z;
+	input.varyings = varyings;
+
+	float4 colour;
+	if (state.pixelShader)
+	{
+		stats.pixelsShaded++;
+		if (!state.pixelShader(input, colour))
+		{
+			return;
+		}
+	}
+	stats.pixelsWritten++;
+	WritePixel(state, pixel, z, state.pixelShader ? &colour : nullptr);
+}
+
+void Rasterizer::ShadeBatch(const Triangle& triangle, PixelQueue& queue, TileStats& stats) const
+{
+	const DrawState& state = mDraws[triangle.draw];
+	int count = queue.batch.count;
+	stats.pixelsShaded += count;
+
+	float4 colours[PixelBatchSize];
+	uint32_t kept = state.batchPixelShader(queue.batch, colours);
+	for (int i = 0; i < count; i++)
+	{
+		if (kept & (1u << i))
+		{
+			stats.pixelsWritten++;
+			WritePixel(state, queue.pixels[i], queue.batch.depth[i], &colours[i]);
+		}
+	}
+	queue.batch.count = 0;
+}
+
+float Rasterizer::Interpolate(const Triangle& triangle, float b1, float b2, float* varyings, int stride) const
+{
+	// Varyings were divided by w at set up, so dividing by the interpolated 1 / w makes them perspective correct
+	const ScreenVertex* v = triangle.v;
+	float invW = v[0].invW + b1 * (v[1].invW - v[0].invW) + b2 * (v[2].invW - v[0].invW);
+	float w = 1.0f / invW;
+	int varyingCount = mDraws[triangle.draw].varyingCount;
+	for (int k = 0; k < varyingCount; k++)
+	{
+		varyings[k * stride] = (v[0].varyings[k] + b1 * (v[1].varyings[k] - v[0].varyings[k]) + b2 * (v[2].varyings[k] - v[0].varyings[k])) * w;
+	}
+	return w;
+}
+
+void Rasterizer::WritePixel(const DrawState& state, size_t pixel, float z, const float4* colour) const
+{
+	if (state.depthEnable && mDepth && state.depthWrite)
+	{
+		mDepth->depth[pixel] = z;
+	}
+
+	if (!mColour || !colour)
+	{
+		return;
+	}
+
+	float4& target = mColour->colour[pixel];
+	if (state.blend == BlendMode::Alpha)
+	{
+		float a = colour->w;
+		target = float4(colour->x * a + target.x * (1.0f - a), colour->y * a + target.y * (1.0f - a), colour->z * a + target.z * (1.0f - a), a);
+	}
+	else
+	{
+		target = *colour;
+	}
+}
+
+void SoftwareBackend::CreateTexture(uint32_t texture, const FrameGraph::TextureDesc& desc)
+{
+	if (texture >= mTextures.size())
+	{
+		mTextures.resize(texture + 1);
+	}
+
+	bool depth = desc.format == FrameGraph::Format::Depth32Float;
+	mTextures[texture].Resize(static_cast<int>(desc.width), static_cast<int>(desc.height), !depth, depth);
+}
+
+void SoftwareBackend::ReleaseTexture(uint32_t texture)
+{
+	mTextures[texture] = Target();
+}
+
+Target& SoftwareBackend::Imported(uint32_t number)
+{
+	if (number >= mImported.size())
+	{
+		mImported.resize(number + 1);
+	}
+	return mImported[number];
+}
+
+Target* SoftwareBackend::Find(uint32_t texture)
+{
+	if (texture == FrameGraph::NoTexture)
+	{
+		return nullptr;
+	}
+	if (texture & FrameGraph::ImportedTexture)
+	{
+		return &Imported(texture & ~FrameGraph::ImportedTexture);
+	}
+	return &mTextures[texture];
+}
+
+void SoftwareBackend::SetTargets(const uint32_t* colour, int colourCount, uint32_t depth)
+{
+	mRasterizer.SetTargets(colourCount > 0 ? Find(colour[0]) : nullptr, Find(depth));
+}
+
+void SoftwareBackend::SetViewport(const FrameGraph::Viewport& viewport)
+{
+	mRasterizer.SetViewport(viewport.width, viewport.height);
+}
+
+void SoftwareBackend::ClearColour(uint32_t texture, const float colour[4])
+{
+	mRasterizer.Flush();
+	Find(texture)->ClearColour(float4(colour[0], colour[1], colour[2], colour[3]));
+}
+
+void SoftwareBackend::ClearDepth(uint32_t texture, float depth)
+{
+	mRasterizer.Flush();
+	Find(texture)->ClearDepth(depth);
+}
+
+void SoftwareBackend::EndPass()
+{
+	mRasterizer.Flush();
+}
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// Row major look at and perspective matrices matching XMMatrixLookAtLH and XMMatrixPerspectiveFovLH
+	void LookAtPerspective(const float3& eye, const float3& at, float fovAngleY, float aspectRatio, float nearZ, float farZ, float result[16])
+	{
+		float3 zAxis = normalize(at - eye);
+		float3 xAxis = normalize(cross(float3(0.0f, 1.0f, 0.0f), zAxis));
+		float3 yAxis = cross(zAxis, xAxis);
+
+		float view[16] =
+		{
+			xAxis.x, yAxis.x, zAxis.x, 0.0f,
+			xAxis.y, yAxis.y, zAxis.y, 0.0f,
+			xAxis.z, yAxis.z, zAxis.z, 0.0f,
+			-dot(xAxis, eye), -dot(yAxis, eye), -dot(zAxis, eye), 1.0f,
+		};
+
+		float yScale = 1.0f / std::tan(0.5f * fovAngleY);
+		float range = farZ / (farZ - nearZ);
+		float projection[16] =
+		{
+			yScale / aspectRatio, 0.0f, 0.0f, 0.0f,
+			0.0f, yScale, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * nearZ, 0.0f,
+		};
+
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += view[row * 4 + k] * projection[k * 4 + column];
+				}
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	// mul(float4(p, 1), m) for a row major m
+	float4 Transform(const float3& p, const float m[16])
+	{
+		return float4(
+			p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12],
+			p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13],
+			p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14],
+			p.x * m[3] + p.y * m[7] + p.z * m[11] + m[15]);
+	}
+
+	struct BenchmarkScene
+	{
+		int width;
+		int height;
+		float viewProjection[16];
+		// Clip space size of a unit across at a depth of 1, to grow billboards by.
+		float2 clipScale;
+		float3 light;
+
+		std::vector<float3> sphereNormals;
+		std::vector<uint32_t> sphereIndices;
+		std::vector<float3> sphereCentres;
+		std::vector<PlantInstances::PlantInstance> plants;
+	};
+
+	BenchmarkScene MakeScene(int width, int height)
+	{
+		BenchmarkScene scene;
+		scene.width = width;
+		scene.height = height;
+		float aspectRatio = static_cast<float>(width) / height;
+		float fovAngleY = 70.0f * Pi / 180.0f;
+		LookAtPerspective(float3(0.0f, 6.0f, -30.0f), float3(0.0f, 0.0f, 5.0f), fovAngleY, aspectRatio, 0.01f, 1000.0f, scene.viewProjection);
+		float yScale = 1.0f / std::tan(0.5f * fovAngleY);
+		scene.clipScale = float2(yScale / aspectRatio, yScale);
+		scene.light = normalize(float3(0.3f, 1.0f, -0.4f));
+
+		// A unit sphere of 16 rings by 24 segments, its normals doubling as positions
+		const int rings = 16;
+		const int segments = 24;
+		for (int r = 0; r <= rings; r++)
+		{
+			float theta = Pi * r / rings;
+			for (int s = 0; s <= segments; s++)
+			{
+				float phi = 2.0f * Pi * s / segments;
+				scene.sphereNormals.push_back(float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+			}
+		}
+		for (int r = 0; r < rings; r++)
+		{
+			for (int s = 0; s < segments; s++)
+			{
+				uint32_t a = r * (segments + 1) + s;
+				uint32_t b = a + segments + 1;
+				uint32_t quad[6] = { a, a + 1, b, b, a + 1, b + 1 };
+				scene.sphereIndices.insert(scene.sphereIndices.end(), quad, quad + 6);
+			}
+		}
+		for (int z = 0; z < 3; z++)
+		{
+			for (int x = -2; x <= 2; x++)
+			{
+				scene.sphereCentres.push_back(float3(x * 6.0f, 2.5f, z * 8.0f));
+			}
+		}
+
+		unsigned int seed = 1;
+		auto random = [&seed](float lo, float hi)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return lo + (hi - lo) * static_cast<float>(seed >> 8) / 16777216.0f;
+		};
+		for (int i = 0; i < 4000; i++)
+		{
+			float x = random(-50.0f, 50.0f);
+			float z = random(-30.0f, 50.0f);
+			PlantInstances::PlantInstance plant;
+			plant.position = float3(x, PlantInstances::PlantHeight(x, z), z);
+			plant.species = PlantInstances::SpeciesAt(x, z);
+			scene.plants.push_back(plant);
+		}
+		return scene;
+	}
+
+	void DrawTerrain(Rasterizer& rasterizer, const BenchmarkScene& scene)
+	{
+		DrawState state;
+		state.varyingCount = 6;
+		state.pixelShader = [&scene](const PixelInput& input, float4& colour)
+		{
+			float3 normal = normalize(float3(input.varyings[0], input.varyings[1], input.varyings[2]));
+			float height = input.varyings[4];
+			float3 sand = lerp(float3(0.55f, 0.5f, 0.35f), float3(0.8f, 0.75f, 0.55f), saturate(height));
+			float diffuse = saturate(std::fabs(dot(normal, scene.light)));
+			colour = float4(sand * (0.2f + 0.8f * diffuse), 1.0f);
+			return true;
+		};
+
+		// TerrainDomain.hlsl at the factor of 20 TerrainHull.hlsl asks for
+		rasterizer.DrawQuadPatch(state, 20, [&scene](const float2& uv, Vertex& output)
+		{
+			float3 vPos1 = lerp(float3(-50.0f, 0.0f, 50.0f), float3(-50.0f, 0.0f, -50.0f), uv.y);
+			float3 vPos2 = lerp(float3(50.0f, 0.0f, 50.0f), float3(50.0f, 0.0f, -50.0f), uv.y);
+			float3 uvPos = lerp(vPos1, vPos2, uv.x);
+			uvPos.y = PlantInstances::FractalNoise(uvPos.xz());
+
+			float3 dY = float3(PlantInstances::FractalNoise(uvPos.xz() + float2(0.1f, 0.0f)), 0.2f, PlantInstances::FractalNoise(uvPos.xz() + float2(0.0f, 0.1f)));
+			float3 normal = normalize(uvPos - dY);
+
+			output.position = Transform(uvPos, scene.viewProjection);
+			output.varyings[0] = normal.x;
+			output.varyings[1] = normal.y;
+			output.varyings[2] = normal.z;
+			output.varyings[3] = uvPos.x;
+			output.varyings[4] = uvPos.y;
+			output.varyings[5] = uvPos.z;
+		});
+	}
+
+	void DrawSpheres(Rasterizer& rasterizer, const BenchmarkScene& scene)
+	{
+		DrawState state;
+		state.cull = CullMode::Back;
+		state.varyingCount = 3;
+		state.pixelShader = [&scene](const PixelInput& input, float4& colour)
+		{
+			float3 normal = normalize(float3(input.varyings[0], input.varyings[1], input.varyings[2]));
+			float diffuse = saturate(dot(normal, scene.light));
+			colour = float4(float3(0.9f, 0.35f, 0.3f) * (0.15f + 0.85f * diffuse), 1.0f);
+			return true;
+		};
+
+		for (const float3& centre : scene.sphereCentres)
+		{
+			rasterizer.DrawIndexed(state, scene.sphereIndices.data(), static_cast<uint32_t>(scene.sphereIndices.size()), static_cast<uint32_t>(scene.sphereNormals.size()), [&](uint32_t index, Vertex& output)
+			{
+				const float3& normal = scene.sphereNormals[index];
+				output.position = Transform(centre + normal * 2.0f, scene.viewProjection);
+				output.varyings[0] = normal.x;
+				output.varyings[1] = normal.y;
+				output.varyings[2] = normal.z;
+			});
+		}
+	}
+
+	void DrawPlants(Rasterizer& rasterizer, const BenchmarkScene& scene)
+	{
+		// Tested against the scene but not written, as the renderer draws its alpha blended plants
+		DrawState state;
+		state.depthWrite = false;
+		state.depthFunc = DepthFunc::LessEqual;
+		state.blend = BlendMode::Alpha;
+		state.varyingCount = 3;
+		state.pixelShader = [](const PixelInput& input, float4& colour)
+		{
+			static const float3 species[PlantInstances::SpeciesCount] =
+			{
+				float3(0.2f, 0.6f, 0.3f), float3(0.7f, 0.3f, 0.5f), float3(0.3f, 0.5f, 0.7f), float3(0.8f, 0.6f, 0.2f)
+			};
+
+			float2 centre = float2(input.varyings[1] - 0.5f, input.varyings[2] - 0.5f) * 2.0f;
+			float radius = dot(centre, centre);
+			if (radius > 1.0f)
+			{
+				return false;
+			}
+			colour = float4(species[static_cast<int>(input.varyings[0]) % PlantInstances::SpeciesCount], 1.0f - radius);
+			return true;
+		};
+
+		rasterizer.DrawPoints(state, static_cast<uint32_t>(scene.plants.size()), [&scene](uint32_t index, Point& output)
+		{
+			const PlantInstances::PlantInstance& plant = scene.plants[index];
+			output.position = Transform(plant.position + float3(0.0f, PlantInstances::HeightOffset, 0.0f), scene.viewProjection);
+			output.halfSize = scene.clipScale * 0.5f;
+			output.varyings[0] = static_cast<float>(plant.species);
+		});
+	}
+
+	RasterStats DrawFrame(FrameGraph::Graph& graph, SoftwareBackend& backend, Rasterizer& rasterizer, const BenchmarkScene& scene)
+	{
+		using namespace FrameGraph;
+
+		const float water[4] = { 0.05f, 0.2f, 0.35f, 1.0f };
+		uint32_t width = static_cast<uint32_t>(scene.width);
+		uint32_t height = static_cast<uint32_t>(scene.height);
+
+		rasterizer.ResetStats();
+		graph.Reset();
+		Resource backBuffer = graph.Import("Back buffer", { width, height, Format::Rgba8Unorm }, 0);
+		Resource depth = graph.Import("Depth", { width, height, Format::Depth32Float }, 1);
+		graph.AddPass("Terrain", [&](PassBuilder& pass) { pass.Clear(backBuffer, water); pass.ClearDepth(depth, 1.0f); }, [&](const PassContext&) { DrawTerrain(rasterizer, scene); });
+		graph.AddPass("Spheres", [&](PassBuilder& pass) { pass.Write(backBuffer); pass.WriteDepth(depth); }, [&](const PassContext&) { DrawSpheres(rasterizer, scene); });
+		graph.AddPass("Plants", [&](PassBuilder& pass) { pass.Write(backBuffer); pass.WriteDepth(depth); }, [&](const PassContext&) { DrawPlants(rasterizer, scene); });
+		graph.Compile(backend);
+		graph.Execute(backend);
+		return rasterizer.GetStats();
+	}
+
+	// A rasterizer drawing the benchmark frame on threadCount threads into targets of its own.
+	struct FrameDrawer
+	{
+		Rasterizer rasterizer;
+		SoftwareBackend backend;
+		FrameGraph::Graph graph;
+		double milliseconds;
+
+		FrameDrawer(const BenchmarkScene& scene, int threadCount) : backend(rasterizer), milliseconds(0.0)
+		{
+			backend.Imported(0).Resize(scene.width, scene.height, true, false);
+			backend.Imported(1).Resize(scene.width, scene.height, false, true);
+			rasterizer.SetThreadCount(threadCount);
+		}
+
+		// Draws the frame, adding the time it took.
+		RasterStats Draw(const BenchmarkScene& scene)
+		{
+			auto start = std::chrono::steady_clock::now();
+			RasterStats stats = DrawFrame(graph, backend, rasterizer, scene);
+			milliseconds += MillisecondsSince(start);
+			return stats;
+		}
+	};
+}
+
+RasterBenchmark SoftwareRasterizer::RunRasterBenchmark(int width, int height, int threadCount, int frames)
+{
+	RasterBenchmark result = {};
+	result.width = std::max(width, 1);
+	result.height = std::max(height, 1);
+	result.frames = std::max(frames, 1);
+
+	BenchmarkScene scene = MakeScene(result.width, result.height);
+
+	FrameDrawer serial(scene, 1);
+	FrameDrawer threaded(scene, threadCount);
+
+	// Once first so the bins and the pool are warm, then taking turns so both see the machine in the same state
+	serial.Draw(scene);
+	threaded.Draw(scene);
+	serial.milliseconds = 0.0;
+	threaded.milliseconds = 0.0;
+	for (int i = 0; i < result.frames; i++)
+	{
+		serial.Draw(scene);
+		result.stats = threaded.Draw(scene);
+	}
+	result.serialMilliseconds = serial.milliseconds / result.frames;
+	result.threadedMilliseconds = threaded.milliseconds / result.frames;
+	result.threads = result.stats.threads;
+
+	const Target& serialColour = serial.backend.Imported(0);
+	const Target& threadedColour = threaded.backend.Imported(0);
+	const Target& serialDepth = serial.backend.Imported(1);
+	const Target& threadedDepth = threaded.backend.Imported(1);
+	for (size_t i = 0; i < serialColour.colour.size(); i++)
+	{
+		if (std::memcmp(&serialColour.colour[i], &threadedColour.colour[i], sizeof(float4)) != 0 || serialDepth.depth[i] != threadedDepth.depth[i])
+		{
+			result.mismatches++;
+		}
+	}
+	result.imageHash = StateCache::HashBytes(threadedColour.colour.data(), threadedColour.colour.size() * sizeof(float4));
+	return result;
+}
@@ -0,0 +1,309 @@
+﻿#pragma once
+
+#include "FrameGraph.h"
+#include "ShaderMath.h"
+#include "WorkerThreads.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ACW
+{
+	// Draws on the CPU the part of the Direct3D pipeline the renderer uses: indexed triangle lists, quad patches
+	// tessellated by a domain callback, points grown into quads where the plants used a geometry shader, depth
+	// testing and writing, alpha blending and pixel shaders written as C++ callbacks. Draws are shaded, clipped
+	// and set up as they are made, then binned into tiles of TileSize pixels when flushed, and each tile is
+	// rasterised by whichever thread of the rasterizer's pool takes it, four pixels at a time. A tile is only
+	// ever touched by one thread and draws its triangles in the order they were drawn, so the image is the same
+	// whatever the number of threads. A batch pixel shader is given a triangle's pixels eight at a time once
+	// they pass the depth test. With SoftwareBackend a frame graph's passes can be run without a GPU.
+	namespace SoftwareRasterizer
+	{
+		using ShaderMath::float2;
+		using ShaderMath::float4;
+
+		static const int TileSize = 64;
+
+		// Values interpolated from the vertices to each pixel, perspective correct.
+		static const int MaxVaryings = 12;
+
+		// Screen positions are snapped to 1 / 16 of a pixel, as edges are walked in fixed point.
+		static const int SubpixelBits = 4;
+
+		// How far off screen a triangle may reach before it is clipped, rather than only at the near and far planes.
+		static const int GuardBandPixels = 2048;
+
+		// What a vertex or domain callback returns: a clip space position, z from 0 to w as in Direct3D.
+		struct Vertex
+		{
+			float4 position;
+			float varyings[MaxVaryings];
+		};
+
+		// A point grown into a view facing quad halfSize across either way, in clip space units so it shrinks
+		// with distance. The quad's corners get the point's varyings followed by their uv, 0, 0 at the top left.
+		struct Point
+		{
+			float4 position;
+			float2 halfSize;
+			float varyings[MaxVaryings];
+		};
+
+		struct PixelInput
+		{
+			// Pixel centre, and depth after interpolation.
+			float2 position;
+			float depth;
+			const float* varyings;
+		};
+
+		// Writes the pixel's colour, or returns false to discard it as clip() does. Called from the worker threads at
+		// once, so it must not change anything shared.
+		typedef std::function<bool(const PixelInput& input, float4& colour)> PixelShader;
+
+		static const int PixelBatchSize = 8;
+
+		// Pixels of one triangle shaded together, each value an array with an entry per pixel, as the kernels of
+		// Tools/HlslTranslator.py take them.
+		struct PixelBatch
+		{
+			int count;
+			alignas(32) float x[PixelBatchSize];
+			alignas(32) float y[PixelBatchSize];
+			alignas(32) float depth[PixelBatchSize];
+			alignas(32) float w[PixelBatchSize];
+			alignas(32) float varyings[MaxVaryings][PixelBatchSize];
+		};
+
+		// Writes the colours of the batch's count pixels and returns a bit for each pixel to keep, the first pixel
+		// lowest, a clear bit discarding it. Called from the worker threads at once, as a PixelShader is.
+		typedef std::function<uint32_t(const PixelBatch& batch, float4* colours)> BatchPixelShader;
+
+		// Front faces wind clockwise on screen, as Direct3D's default.
+		enum class CullMode
+		{
+			None,
+			Back
+		};
+
+		enum class DepthFunc
+		{
+			Less,
+			LessEqual
+		};
+
+		// Alpha is the renderer's alpha blend state, colour by source alpha and alpha replaced.
+		enum class BlendMode
+		{
+			Opaque,
+			Alpha
+		};
+
+		struct DrawState
+		{
+			// A draw without depth neither tests nor writes it, as with DepthEnable off.
+			bool depthEnable;
+			bool depthWrite;
+			DepthFunc depthFunc;
+			BlendMode blend;
+			CullMode cull;
+			int varyingCount;
+			PixelShader pixelShader;
+			// Shades in place of pixelShader when set.
+			BatchPixelShader batchPixelShader;
+
+			DrawState() : depthEnable(true), depthWrite(true), depthFunc(DepthFunc::Less), blend(BlendMode::Opaque), cull(CullMode::None), varyingCount(0) {}
+		};
+
+		// A colour target, a depth target or both. Colour is kept as floats whatever the format it stands in for.
+		struct Target
+		{
+			int width;
+			int height;
+			std::vector<float4> colour;
+			std::vector<float> depth;
+
+			Target() : width(0), height(0) {}
+
+			void Resize(int targetWidth, int targetHeight, bool hasColour, bool hasDepth);
+			void ClearColour(const float4& value);
+			void ClearDepth(float value);
+		};
+
+		struct RasterStats
+		{
+			uint32_t draws;
+			uint32_t triangles;
+			// Triangles made by clipping in place of those crossing a plane, and those found outside the view, facing away or
+			// too thin to cover a pixel.
+			uint32_t clippedTriangles;
+			uint32_t culledTriangles;
+			// Triangles set up, and the tiles they were binned into counted once for each.
+			uint32_t setupTriangles;
+			uint32_t binnedTriangles;
+			uint32_t tiles;
+
+			// Pixels inside a triangle, those passing the depth test and shaded, and those the shader did not discard.
+			uint64_t pixelsCovered;
+			uint64_t pixelsShaded;
+			uint64_t pixelsWritten;
+
+			int threads;
+			double setupMilliseconds;
+			double binMilliseconds;
+			double rasterMilliseconds;
+		};
+
+		class Rasterizer
+		{
+		public:
+			Rasterizer();
+
+			Rasterizer(const Rasterizer&) = delete;
+			Rasterizer& operator=(const Rasterizer&) = delete;
+
+			// Threads tiles are rasterised on, one per hardware thread when it is 0. The threads are started by the
+			// first flush that needs them and kept for the ones after.
+			void SetThreadCount(int threadCount) { mThreadCount = threadCount; }
+
+			// Either may be null. Draws made so far are flushed to the targets they were made for first.
+			void SetTargets(Target* colour, Target* depth);
+			void SetViewport(float width, float height);
+
+			// vertex(index, output) is called once for each of the vertexCount vertices the indices refer to.
+			void DrawIndexed(const DrawState& state, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, const std::function<void(uint32_t, Vertex&)>& vertex);
+
+			// A quad patch cut into tessFactor by tessFactor cells, as the integer and even fractional partitionings cut
+			// it at a whole factor, with domain(uv, output) called once at each corner of the cells.
+			void DrawQuadPatch(const DrawState& state, int tessFactor, const std::function<void(const float2&, Vertex&)>& domain);
+
+			// Two triangles for each point, state.varyingCount counting the two uv varyings added after the point's own.
+			void DrawPoints(const DrawState& state, uint32_t pointCount, const std::function<void(uint32_t, Point&)>& point);
+
+			// Bins and rasterises the draws made since the last flush.
+			void Flush();
+
+			// Counts since the last ResetStats, across every flush.
+			const RasterStats& GetStats() const { return mStats; }
+			void ResetStats();
+
+		private:
+			struct ScreenVertex
+			{
+				int32_t x;
+				int32_t y;
+				float z;
+				float invW;
+				// Varyings divided by w.
+				float varyings[MaxVaryings];
+			};
+
+			struct Triangle
+			{
+				ScreenVertex v[3];
+				int64_t area;
+				float invArea;
+				int minX;
+				int minY;
+				int maxX;
+				int maxY;
+				uint32_t draw;
+			};
+
+			// Pixels of the triangle being rasterised that passed the depth test, waiting for a batch pixel shader.
+			struct PixelQueue
+			{
+				PixelBatch batch;
+				size_t pixels[PixelBatchSize];
+			};
+
+			// Per thread counts, added to mStats after each flush.
+			struct TileStats
+			{
+				uint64_t pixelsCovered;
+				uint64_t pixelsShaded;
+				uint64_t pixelsWritten;
+			};
+
+			uint32_t AddDraw(const DrawState& state);
+			void AddTriangles(uint32_t draw, const uint32_t* indices, uint32_t indexCount);
+			void ClipAndSetUp(uint32_t draw, const Vertex* corners[3]);
+			void SetUp(uint32_t draw, const Vertex& a, const Vertex& b, const Vertex& c);
+			void Bin();
+			void RasteriseTile(int tile, TileStats& stats) const;
+			void RasteriseTriangle(const Triangle& triangle, int x0, int y0, int x1, int y1, TileStats& stats) const;
+			void ShadePixel(const Triangle& triangle, int x, int y, int64_t e1, int64_t e2, PixelQueue& queue, TileStats& stats) const;
+			void ShadeBatch(const Triangle& triangle, PixelQueue& queue, TileStats& stats) const;
+			float Interpolate(const Triangle& triangle, float b1, float b2, float* varyings, int stride) const;
+			void WritePixel(const DrawState& state, size_t pixel, float z, const float4* colour) const;
+
+			int mThreadCount;
+			std::unique_ptr<WorkerThreads::Pool> mWorkers;
+			Target* mColour;
+			Target* mDepth;
+			float mViewportWidth;
+			float mViewportHeight;
+
+			std::vector<DrawState> mDraws;
+			std::vector<Triangle> mTriangles;
+			std::vector<std::vector<uint32_t>> mBins;
+			std::vector<Vertex> mVertices;
+			std::vector<uint32_t> mIndices;
+			int mTilesX;
+			int mTilesY;
+			RasterStats mStats;
+		};
+
+		// Makes the graph's textures as Targets and binds them to a Rasterizer, flushing it after each pass. Only a
+		// pass's first colour target is drawn to. Imported textures are found by number in targets the caller sizes.
+		class SoftwareBackend : public FrameGraph::Backend
+		{
+		public:
+			explicit SoftwareBackend(Rasterizer& rasterizer) : mRasterizer(rasterizer) {}
+
+			void CreateTexture(uint32_t texture, const FrameGraph::TextureDesc& desc) override;
+			void ReleaseTexture(uint32_t texture) override;
+			void SetTargets(const uint32_t* colour, int colourCount, uint32_t depth) override;
+			void SetViewport(const FrameGraph::Viewport& viewport) override;
+			void ClearColour(uint32_t texture, const float colour[4]) override;
+			void ClearDepth(uint32_t texture, float depth) override;
+			void EndPass() override;
+
+			Target& Imported(uint32_t number);
+			Target* Find(uint32_t texture);
+
+		private:
+			Rasterizer& mRasterizer;
+			std::vector<Target> mTextures;
+			std::vector<Target> mImported;
+		};
+
+		struct RasterBenchmark
+		{
+			int width;
+			int height;
+			int threads;
+			int frames;
+
+			// Counts for one frame, drawn on threads threads.
+			RasterStats stats;
+
+			// A frame drawn on one thread, and on threads threads.
+			double serialMilliseconds;
+			double threadedMilliseconds;
+
+			// Pixels whose colour or depth differ between the two, which should be none, and a hash of the colour
+			// for image tests to compare against a frame known to be right on the same platform.
+			uint32_t mismatches;
+			uint64_t imageHash;
+		};
+
+		// A stand in for the renderer's frame run through a frame graph and SoftwareBackend. It has three of the
+		// renderer's kinds of draw: the tessellated terrain patch, indexed meshes as a grid of spheres, and the alpha
+		// blended plant billboards grown from points. They are lit by C++ ports of their pixel shaders. The coral
+		// meshes, bubbles, water and underwater passes are left out, and so are the raymarched coral passes and
+		// their upsample, which are compute and fullscreen work rather than rasterised geometry.
+		RasterBenchmark RunRasterBenchmark(int width, int height, int threadCount, int frames);
+	}
+}
@@ -0,0 +1,188 @@
+﻿#include "pch.h"
+#include "StateCache.h"
+
+#include <chrono>
+
+using namespace ACW;
+using namespace ACW::StateCache;
+
+namespace
+{
+	double NanosecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+uint64_t StateCache::HashBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+void* Cache::Find(Kind kind, uint64_t hash, const void* desc, size_t size) const
+{
+	auto range = mIndex.equal_range(hash);
+	for (auto i = range.first; i != range.second; ++i)
+	{
+		const Entry& entry = mEntries[i->second];
+		if (entry.kind == kind && entry.desc.size() == size && std::memcmp(entry.desc.data(), desc, size) == 0)
+		{
+			return entry.object;
+		}
+	}
+	return nullptr;
+}
+
+void Cache::Add(Kind kind, uint64_t hash, const void* desc, size_t size, void* object, void (*release)(void*))
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(desc);
+	mIndex.emplace(hash, mEntries.size());
+	mEntries.push_back({ kind, std::vector<uint8_t>(bytes, bytes + size), object, release });
+	mStats.objects = static_cast<uint32_t>(mEntries.size());
+}
+
+void Cache::Clear()
+{
+	for (Entry& entry : mEntries)
+	{
+		entry.release(entry.object);
+	}
+	mEntries.clear();
+	mIndex.clear();
+	mStats.objects = 0;
+}
+
+namespace
+{
+	// Stand ins for the Direct3D descriptors, laid out as plain words as they are
+	struct StandInBlendDesc
+	{
+		uint32_t alphaToCoverage;
+		uint32_t independentBlend;
+		uint32_t renderTargets[8][8];
+	};
+
+	struct StandInDepthStencilDesc
+	{
+		uint32_t depthEnable;
+		uint32_t depthWriteMask;
+		uint32_t depthFunc;
+		uint32_t stencil[11];
+	};
+
+	struct StandInRasteriserDesc
+	{
+		uint32_t fillMode;
+		uint32_t cullMode;
+		uint32_t rest[8];
+	};
+
+	struct StandInSamplerDesc
+	{
+		uint32_t filter;
+		uint32_t address[3];
+		float rest[9];
+	};
+
+	struct StandInState
+	{
+		int* live;
+
+		void Release()
+		{
+			(*live)--;
+			delete this;
+		}
+	};
+
+	struct StandInDevice
+	{
+		int live;
+		uint32_t creates;
+
+		int Create(StandInState** state)
+		{
+			*state = new StandInState{ &live };
+			live++;
+			creates++;
+			return 0;
+		}
+	};
+
+	// The states Sample3DSceneRenderer makes at load, with every other field zeroed as it does
+	template <class Desc>
+	Desc Zeroed()
+	{
+		Desc desc;
+		std::memset(&desc, 0, sizeof(desc));
+		return desc;
+	}
+
+	void RequestLoadStates(Cache& cache, StandInDevice& device)
+	{
+		auto create = [&device](StandInState** state) { return device.Create(state); };
+
+		StandInBlendDesc blend = Zeroed<StandInBlendDesc>();
+		blend.renderTargets[0][0] = 1;
+		cache.Get<StandInState>(Blend, blend, create);
+		blend.renderTargets[0][0] = 0;
+		cache.Get<StandInState>(Blend, blend, create);
+
+		StandInDepthStencilDesc depth = Zeroed<StandInDepthStencilDesc>();
+		depth.depthEnable = 1;
+		depth.depthFunc = 4;
+		cache.Get<StandInState>(DepthStencil, depth, create);
+		depth.depthWriteMask = 1;
+		cache.Get<StandInState>(DepthStencil, depth, create);
+
+		StandInRasteriserDesc rasteriser = Zeroed<StandInRasteriserDesc>();
+		rasteriser.fillMode = 2;
+		rasteriser.cullMode = 1;
+		cache.Get<StandInState>(Rasteriser, rasteriser, create);
+		rasteriser.fillMode = 3;
+		cache.Get<StandInState>(Rasteriser, rasteriser, create);
+
+		StandInSamplerDesc sampler = Zeroed<StandInSamplerDesc>();
+		sampler.filter = 0x15;
+		sampler.address[0] = sampler.address[1] = sampler.address[2] = 1;
+		cache.Get<StandInState>(Sampler, sampler, create);
+	}
+
+	StandInState* RequestUnderwaterState(Cache& cache, StandInDevice& device)
+	{
+		StandInDepthStencilDesc depth = Zeroed<StandInDepthStencilDesc>();
+		depth.depthFunc = 2;
+		return cache.Get<StandInState>(DepthStencil, depth, [&device](StandInState** state) { return device.Create(state); });
+	}
+}
+
+CacheBenchmark StateCache::RunCacheBenchmark(int frames)
+{
+	CacheBenchmark result = {};
+	result.frames = frames > 0 ? frames : 1;
+
+	StandInDevice device = {};
+	{
+		Cache cache;
+		RequestLoadStates(cache, device);
+		RequestUnderwaterState(cache, device);
+		result.loadCreates = device.creates;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < result.frames; frame++)
+		{
+			RequestUnderwaterState(cache, device);
+		}
+		result.lookupNanoseconds = NanosecondsSince(start) / result.frames;
+		result.frameCreates = device.creates - result.loadCreates;
+		result.stats = cache.GetStats();
+	}
+	result.leaked = device.live;
+	return result;
+}
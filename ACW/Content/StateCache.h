@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace ACW
+{
+	// Blend, depth stencil, rasteriser and sampler states made once for each descriptor and shared by everything
+	// asking for the same one after. Descriptors are found by a hash of their bytes and then compared whole, so
+	// they should be zeroed before they are filled in, as with ZeroMemory or = {}, or padding left over may make
+	// two equal descriptors miss each other. The cache holds a reference to each object until Clear.
+	namespace StateCache
+	{
+		enum Kind
+		{
+			Blend,
+			DepthStencil,
+			Rasteriser,
+			Sampler,
+			KindCount
+		};
+
+		struct CacheStats
+		{
+			// Requests found in the cache, and those that made a new object.
+			uint32_t hits[KindCount];
+			uint32_t misses[KindCount];
+			uint32_t objects;
+
+			uint32_t Hits() const { return hits[Blend] + hits[DepthStencil] + hits[Rasteriser] + hits[Sampler]; }
+			uint32_t Misses() const { return misses[Blend] + misses[DepthStencil] + misses[Rasteriser] + misses[Sampler]; }
+		};
+
+		// 64 bit FNV-1a.
+		uint64_t HashBytes(const void* data, size_t size);
+
+		class Cache
+		{
+		public:
+			Cache() : mStats() {}
+			~Cache() { Clear(); }
+
+			Cache(const Cache&) = delete;
+			Cache& operator=(const Cache&) = delete;
+
+			// The object made for desc, calling create(State**) to make it the first time desc is asked for.
+			// create returns a negative value when it fails, and nothing is cached. State is released with Release().
+			template <class State, class Desc, class Create>
+			State* Get(Kind kind, const Desc& desc, const Create& create)
+			{
+				uint64_t hash = HashBytes(&desc, sizeof(Desc)) ^ static_cast<uint64_t>(kind);
+				void* found = Find(kind, hash, &desc, sizeof(Desc));
+				if (found)
+				{
+					mStats.hits[kind]++;
+					return static_cast<State*>(found);
+				}
+
+				mStats.misses[kind]++;
+				State* state = nullptr;
+				if (create(&state) < 0 || !state)
+				{
+					return nullptr;
+				}
+
+				Add(kind, hash, &desc, sizeof(Desc), state, [](void* object) { static_cast<State*>(object)->Release(); });
+				return state;
+			}
+
+			// Releases every object, as when the device is lost. The statistics are kept.
+			void Clear();
+
+			const CacheStats& GetStats() const { return mStats; }
+
+		private:
+			struct Entry
+			{
+				Kind kind;
+				std::vector<uint8_t> desc;
+				void* object;
+				void (*release)(void*);
+			};
+
+			void* Find(Kind kind, uint64_t hash, const void* desc, size_t size) const;
+			void Add(Kind kind, uint64_t hash, const void* desc, size_t size, void* object, void (*release)(void*));
+
+			std::unordered_multimap<uint64_t, size_t> mIndex;
+			std::vector<Entry> mEntries;
+			CacheStats mStats;
+		};
+
+		struct CacheBenchmark
+		{
+			int frames;
+
+			// Objects made while loading, and in the frames after, which should be none.
+			uint32_t loadCreates;
+			uint32_t frameCreates;
+			CacheStats stats;
+
+			// Time to find a cached state, and objects still alive after Clear, which should be none.
+			double lookupNanoseconds;
+			int leaked;
+		};
+
+		// The renderer's states asked for at load, then its underwater state asked for again frames times,
+		// made by a stand in device that counts the objects it makes and frees.
+		CacheBenchmark RunCacheBenchmark(int frames);
+	}
+}
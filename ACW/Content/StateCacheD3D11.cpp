@@ -0,0 +1,34 @@
+﻿#include "pch.h"
+#include "StateCacheD3D11.h"
+
+using namespace ACW;
+using namespace ACW::StateCache;
+
+D3D11StateCache::D3D11StateCache(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources)
+{
+}
+
+ID3D11BlendState* D3D11StateCache::GetBlendState(const D3D11_BLEND_DESC& desc)
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+	return mCache.Get<ID3D11BlendState>(Blend, desc, [device, &desc](ID3D11BlendState** state) { return device->CreateBlendState(&desc, state); });
+}
+
+ID3D11DepthStencilState* D3D11StateCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+	return mCache.Get<ID3D11DepthStencilState>(DepthStencil, desc, [device, &desc](ID3D11DepthStencilState** state) { return device->CreateDepthStencilState(&desc, state); });
+}
+
+ID3D11RasterizerState* D3D11StateCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+	return mCache.Get<ID3D11RasterizerState>(Rasteriser, desc, [device, &desc](ID3D11RasterizerState** state) { return device->CreateRasterizerState(&desc, state); });
+}
+
+ID3D11SamplerState* D3D11StateCache::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+	ID3D11Device3* device = m_deviceResources->GetD3DDevice();
+	return mCache.Get<ID3D11SamplerState>(Sampler, desc, [device, &desc](ID3D11SamplerState** state) { return device->CreateSamplerState(&desc, state); });
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "..\Common\DeviceResources.h"
+#include "StateCache.h"
+
+namespace ACW
+{
+	namespace StateCache
+	{
+		// The cache in front of the Direct3D device. States are held by the cache until Clear, so callers
+		// keeping one past then hold their own reference, as a ComPtr does.
+		class D3D11StateCache
+		{
+		public:
+			D3D11StateCache(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+			ID3D11BlendState* GetBlendState(const D3D11_BLEND_DESC& desc);
+			ID3D11DepthStencilState* GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+			ID3D11RasterizerState* GetRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+			ID3D11SamplerState* GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+
+			void Clear() { mCache.Clear(); }
+			const CacheStats& GetStats() const { return mCache.GetStats(); }
+
+		private:
+			std::shared_ptr<DX::DeviceResources> m_deviceResources;
+			Cache mCache;
+		};
+	}
+}
@@ -0,0 +1,251 @@
+﻿#include "pch.h"
+#include "StateFilter.h"
+
+#include <algorithm>
+
+using namespace ACW;
+using namespace ACW::StateFilter;
+
+namespace
+{
+	// Stand ins for the renderer's shaders and states, only their addresses matter
+	enum StandIn
+	{
+		CubeLayout, CoralMeshLayout, PlantLayout,
+		DefaultRasteriser, NoBlend, AlphaBlend, DepthLessThanEqualAll, DepthLessThanEqual, DepthDisabled,
+		SpheresVS, SpheresPS, CoralMeshVS, CoralMeshPS, ImplicitCoralVS, ConePrepassPS, CoralMarchPS, ImplicitCoralPS,
+		TerrainVS, TerrainPS, TerrainHS, TerrainDS, WaterVS, WaterPS, WaterHS, WaterDS, PlantsVS, PlantsPS,
+		UnderwaterVS, UnderwaterPS, LinearSampler, StandInCount
+	};
+
+	enum StandInTopology
+	{
+		TriangleList = 4,
+		TriangleStrip = 5,
+		PatchList = 36
+	};
+
+	char standIns[StandInCount];
+
+	const void* Object(StandIn standIn)
+	{
+		return &standIns[standIn];
+	}
+
+	enum ReplayPass
+	{
+		CoralMeshesPass, BubblesPass, ConePrepassPass, CoralMarchPass, CoralShadePass, TerrainPass, WaterPass, PlantsPass,
+		UnderwaterPass, ReplayPassCount
+	};
+
+	// The state Sample3DSceneRenderer::BindPassState binds at the start of every pass
+	template <class Target>
+	void ReplayPassState(Target& target)
+	{
+		const void* sampler[1] = { Object(LinearSampler) };
+
+		target.IASetPrimitiveTopology(TriangleList);
+		target.IASetInputLayout(Object(CubeLayout));
+		target.RSSetState(Object(DefaultRasteriser));
+		target.OMSetBlendState(Object(NoBlend), nullptr, 0xffffffff);
+		target.OMSetDepthStencilState(Object(DepthLessThanEqualAll), 0);
+		target.GSSetShader(nullptr, nullptr, 0);
+		target.HSSetShader(nullptr, nullptr, 0);
+		target.DSSetShader(nullptr, nullptr, 0);
+		target.PSSetSamplers(0, 1, sampler);
+	}
+
+	// The state calls one pass of Sample3DSceneRenderer::Render makes at full resolution and shading rate. The plants
+	// pass binds nothing of its own when no plants are in view, and is the only one that may then not draw, returning false.
+	template <class Target>
+	bool ReplayPass(Target& target, int pass, bool plantsInView)
+	{
+		const void* sampler[1] = { Object(LinearSampler) };
+
+		ReplayPassState(target);
+		switch (pass)
+		{
+		case CoralMeshesPass:
+			target.IASetInputLayout(Object(CoralMeshLayout));
+			target.VSSetShader(Object(CoralMeshVS), nullptr, 0);
+			target.PSSetShader(Object(CoralMeshPS), nullptr, 0);
+			target.IASetInputLayout(Object(CubeLayout));
+			break;
+
+		case BubblesPass:
+			target.VSSetShader(Object(SpheresVS), nullptr, 0);
+			target.PSSetShader(Object(SpheresPS), nullptr, 0);
+			target.GSSetShader(nullptr, nullptr, 0);
+			break;
+
+		case ConePrepassPass:
+			target.VSSetShader(Object(ImplicitCoralVS), nullptr, 0);
+			target.PSSetShader(Object(ConePrepassPS), nullptr, 0);
+			break;
+
+		case CoralMarchPass:
+			target.VSSetShader(Object(ImplicitCoralVS), nullptr, 0);
+			target.PSSetShader(Object(CoralMarchPS), nullptr, 0);
+			break;
+
+		case CoralShadePass:
+			target.VSSetShader(Object(ImplicitCoralVS), nullptr, 0);
+			target.PSSetShader(Object(ImplicitCoralPS), nullptr, 0);
+			break;
+
+		case TerrainPass:
+			target.IASetPrimitiveTopology(PatchList);
+			target.VSSetShader(Object(TerrainVS), nullptr, 0);
+			target.PSSetShader(Object(TerrainPS), nullptr, 0);
+			target.GSSetShader(nullptr, nullptr, 0);
+			target.DSSetShader(Object(TerrainDS), nullptr, 0);
+			target.HSSetShader(Object(TerrainHS), nullptr, 0);
+			break;
+
+		case WaterPass:
+			target.IASetPrimitiveTopology(PatchList);
+			target.VSSetShader(Object(WaterVS), nullptr, 0);
+			target.PSSetShader(Object(WaterPS), nullptr, 0);
+			target.DSSetShader(Object(WaterDS), nullptr, 0);
+			target.HSSetShader(Object(WaterHS), nullptr, 0);
+			break;
+
+		case PlantsPass:
+			target.IASetPrimitiveTopology(TriangleStrip);
+			if (plantsInView)
+			{
+				target.IASetInputLayout(Object(PlantLayout));
+				target.VSSetShader(Object(PlantsVS), nullptr, 0);
+				target.PSSetShader(Object(PlantsPS), nullptr, 0);
+				target.PSSetSamplers(0, 1, sampler);
+				target.OMSetDepthStencilState(Object(DepthLessThanEqual), 0);
+				target.OMSetBlendState(Object(AlphaBlend), nullptr, 0xffffffff);
+				target.GSSetShader(nullptr, nullptr, 0);
+				target.DSSetShader(nullptr, nullptr, 0);
+				target.HSSetShader(nullptr, nullptr, 0);
+			}
+			break;
+
+		case UnderwaterPass:
+			target.OMSetDepthStencilState(Object(DepthDisabled), 0);
+			target.OMSetBlendState(Object(AlphaBlend), nullptr, 0xffffffff);
+			target.IASetInputLayout(Object(CubeLayout));
+			target.IASetPrimitiveTopology(TriangleList);
+			target.PSSetSamplers(0, 1, sampler);
+			target.VSSetShader(Object(UnderwaterVS), nullptr, 0);
+			target.PSSetShader(Object(UnderwaterPS), nullptr, 0);
+			break;
+		}
+		return pass != PlantsPass || plantsInView;
+	}
+
+	template <class Target>
+	void ReplayFrame(Target& target)
+	{
+		for (int pass = 0; pass < ReplayPassCount; pass++)
+		{
+			ReplayPass(target, pass, true);
+		}
+	}
+
+	// Stands in for a device context, keeping what was last bound to it. A new one has nothing bound, as a deferred
+	// context starts out.
+	struct BoundContext
+	{
+		const void* shaders[PixelShader + 1];
+		const void* samplers[SamplerSlots];
+		const void* inputLayout;
+		int topology;
+		const void* rasteriserState;
+		const void* blendState;
+		const void* depthStencilState;
+
+		BoundContext() : shaders(), samplers(), inputLayout(nullptr), topology(0), rasteriserState(nullptr), blendState(nullptr), depthStencilState(nullptr) {}
+
+		template <class Instances>
+		void VSSetShader(const void* shader, Instances, unsigned int) { shaders[VertexShader] = shader; }
+		template <class Instances>
+		void HSSetShader(const void* shader, Instances, unsigned int) { shaders[HullShader] = shader; }
+		template <class Instances>
+		void DSSetShader(const void* shader, Instances, unsigned int) { shaders[DomainShader] = shader; }
+		template <class Instances>
+		void GSSetShader(const void* shader, Instances, unsigned int) { shaders[GeometryShader] = shader; }
+		template <class Instances>
+		void PSSetShader(const void* shader, Instances, unsigned int) { shaders[PixelShader] = shader; }
+		template <class SamplerState>
+		void PSSetSamplers(unsigned int startSlot, unsigned int samplerCount, SamplerState* const* bound)
+		{
+			for (unsigned int i = 0; i < samplerCount && startSlot + i < SamplerSlots; i++)
+			{
+				samplers[startSlot + i] = bound[i];
+			}
+		}
+		void IASetInputLayout(const void* layout) { inputLayout = layout; }
+		template <class PrimitiveTopology>
+		void IASetPrimitiveTopology(PrimitiveTopology primitiveTopology) { topology = static_cast<int>(primitiveTopology); }
+		void RSSetState(const void* state) { rasteriserState = state; }
+		void OMSetBlendState(const void* state, const float*, unsigned int) { blendState = state; }
+		void OMSetDepthStencilState(const void* state, unsigned int) { depthStencilState = state; }
+
+		bool operator==(const BoundContext& other) const
+		{
+			return std::equal(shaders, shaders + PixelShader + 1, other.shaders) &&
+				std::equal(samplers, samplers + SamplerSlots, other.samplers) &&
+				inputLayout == other.inputLayout && topology == other.topology && rasteriserState == other.rasteriserState &&
+				blendState == other.blendState && depthStencilState == other.depthStencilState;
+		}
+	};
+
+	// Passes drawing with different state when the frame runs on the immediate context, each pass following on
+	// from the one before and the first from the last frame, than when each is recorded on a new deferred context.
+	// Both go through the filter, as the renderer's passes do.
+	uint32_t CountModeMismatches(int frames, bool plantsInView)
+	{
+		uint32_t mismatches = 0;
+		BoundContext immediate;
+		FilteredContext<BoundContext> immediateStates(&immediate);
+		for (int frame = 0; frame < frames; frame++)
+		{
+			immediateStates.BeginFrame();
+			for (int pass = 0; pass < ReplayPassCount; pass++)
+			{
+				bool draws = ReplayPass(immediateStates, pass, plantsInView);
+
+				BoundContext deferred;
+				FilteredContext<BoundContext> deferredStates(&deferred);
+				ReplayPass(deferredStates, pass, plantsInView);
+
+				if (draws && !(immediate == deferred))
+				{
+					mismatches++;
+				}
+			}
+		}
+		return mismatches;
+	}
+}
+
+FilterBenchmark StateFilter::RunFilterBenchmark(int frames)
+{
+	FilterBenchmark result = {};
+	result.frames = frames > 0 ? frames : 1;
+
+	CountingContext direct;
+	ReplayFrame(direct);
+	result.callsPerFrame = direct.Total();
+
+	CountingContext counted;
+	FilteredContext<CountingContext> filtered(&counted);
+	for (int frame = 0; frame < result.frames; frame++)
+	{
+		filtered.BeginFrame();
+		ReplayFrame(filtered);
+	}
+
+	result.stats = filtered.GetStats();
+	result.contextCalls = counted.Total();
+
+	result.passCount = ReplayPassCount * 2;
+	result.modeMismatches = CountModeMismatches(2, true) + CountModeMismatches(2, false);
+	return result;
+}
@@ -0,0 +1,354 @@
+﻿#pragma once
+
+#include <cstdint>
+
+namespace ACW
+{
+	// Sits in front of a device context and drops calls binding shaders, samplers, input layouts, topologies
+	// and rasteriser, blend and depth stencil states that would bind what is already bound, counting the calls
+	// passed on and dropped each frame. It only knows what was bound through it, so Invalidate forgets it all
+	// wherever other code may have bound state of its own, as BeginFrame does. Context is anything with the
+	// methods of ID3D11DeviceContext it passes calls on to, the device context itself or CountingContext.
+	namespace StateFilter
+	{
+		enum Bind
+		{
+			VertexShader,
+			HullShader,
+			DomainShader,
+			GeometryShader,
+			PixelShader,
+			Sampler,
+			InputLayout,
+			Topology,
+			RasteriserState,
+			BlendState,
+			DepthStencilState,
+			BindCount
+		};
+
+		// Pixel shader sampler slots tracked, as many as Direct3D 11 has.
+		static const unsigned int SamplerSlots = 16;
+
+		// Calls of each kind passed on to the context and dropped since BeginFrame.
+		struct BindStats
+		{
+			uint32_t issued[BindCount];
+			uint32_t skipped[BindCount];
+
+			uint32_t Issued() const
+			{
+				uint32_t total = 0;
+				for (int bind = 0; bind < BindCount; bind++)
+				{
+					total += issued[bind];
+				}
+				return total;
+			}
+
+			uint32_t Skipped() const
+			{
+				uint32_t total = 0;
+				for (int bind = 0; bind < BindCount; bind++)
+				{
+					total += skipped[bind];
+				}
+				return total;
+			}
+		};
+
+		template <class Context>
+		class FilteredContext
+		{
+		public:
+			explicit FilteredContext(Context* context = nullptr) :
+				mContext(context),
+				mStats()
+			{
+				Invalidate();
+			}
+
+			void SetContext(Context* context)
+			{
+				mContext = context;
+				Invalidate();
+			}
+
+			// Forgets what is bound and starts counting a new frame.
+			void BeginFrame()
+			{
+				Invalidate();
+				mStats = BindStats();
+			}
+
+			void Invalidate()
+			{
+				for (const void*& shader : mShaders)
+				{
+					shader = Unknown();
+				}
+				for (const void*& sampler : mSamplers)
+				{
+					sampler = Unknown();
+				}
+				mInputLayout = Unknown();
+				mTopology = -1;
+				mRasteriserState = Unknown();
+				mBlendState = Unknown();
+				for (float& factor : mBlendFactor)
+				{
+					factor = 0.0f;
+				}
+				mSampleMask = 0;
+				mDepthStencilState = Unknown();
+				mStencilRef = 0;
+			}
+
+			const BindStats& GetStats() const { return mStats; }
+
+			// Shaders with class instances are always passed on, and leave the stage unknown.
+			template <class Shader, class Instances>
+			void VSSetShader(Shader shader, Instances instances, unsigned int instanceCount)
+			{
+				if (SetShader(VertexShader, shader, instanceCount))
+				{
+					mContext->VSSetShader(shader, instances, instanceCount);
+				}
+			}
+
+			template <class Shader, class Instances>
+			void HSSetShader(Shader shader, Instances instances, unsigned int instanceCount)
+			{
+				if (SetShader(HullShader, shader, instanceCount))
+				{
+					mContext->HSSetShader(shader, instances, instanceCount);
+				}
+			}
+
+			template <class Shader, class Instances>
+			void DSSetShader(Shader shader, Instances instances, unsigned int instanceCount)
+			{
+				if (SetShader(DomainShader, shader, instanceCount))
+				{
+					mContext->DSSetShader(shader, instances, instanceCount);
+				}
+			}
+
+			template <class Shader, class Instances>
+			void GSSetShader(Shader shader, Instances instances, unsigned int instanceCount)
+			{
+				if (SetShader(GeometryShader, shader, instanceCount))
+				{
+					mContext->GSSetShader(shader, instances, instanceCount);
+				}
+			}
+
+			template <class Shader, class Instances>
+			void PSSetShader(Shader shader, Instances instances, unsigned int instanceCount)
+			{
+				if (SetShader(PixelShader, shader, instanceCount))
+				{
+					mContext->PSSetShader(shader, instances, instanceCount);
+				}
+			}
+
+			// Passed on whole when any of the slots would change.
+			template <class SamplerState>
+			void PSSetSamplers(unsigned int startSlot, unsigned int samplerCount, SamplerState* const* samplers)
+			{
+				bool changed = startSlot + samplerCount > SamplerSlots;
+				for (unsigned int i = 0; i < samplerCount && !changed; i++)
+				{
+					changed = mSamplers[startSlot + i] != samplers[i];
+				}
+
+				if (!changed)
+				{
+					mStats.skipped[Sampler]++;
+					return;
+				}
+
+				for (unsigned int i = 0; i < samplerCount && startSlot + i < SamplerSlots; i++)
+				{
+					mSamplers[startSlot + i] = samplers[i];
+				}
+				mStats.issued[Sampler]++;
+				mContext->PSSetSamplers(startSlot, samplerCount, samplers);
+			}
+
+			template <class Layout>
+			void IASetInputLayout(Layout layout)
+			{
+				if (Set(InputLayout, mInputLayout, layout))
+				{
+					mContext->IASetInputLayout(layout);
+				}
+			}
+
+			template <class PrimitiveTopology>
+			void IASetPrimitiveTopology(PrimitiveTopology topology)
+			{
+				if (static_cast<int>(topology) == mTopology)
+				{
+					mStats.skipped[Topology]++;
+					return;
+				}
+
+				mTopology = static_cast<int>(topology);
+				mStats.issued[Topology]++;
+				mContext->IASetPrimitiveTopology(topology);
+			}
+
+			template <class RasteriserStateType>
+			void RSSetState(RasteriserStateType state)
+			{
+				if (Set(RasteriserState, mRasteriserState, state))
+				{
+					mContext->RSSetState(state);
+				}
+			}
+
+			// A null blend factor is the factor of 1 Direct3D uses in its place.
+			template <class BlendStateType>
+			void OMSetBlendState(BlendStateType state, const float blendFactor[4], unsigned int sampleMask)
+			{
+				const float one[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+				const float* factor = blendFactor ? blendFactor : one;
+				bool sameFactor = factor[0] == mBlendFactor[0] && factor[1] == mBlendFactor[1] && factor[2] == mBlendFactor[2] && factor[3] == mBlendFactor[3];
+				if (mBlendState == static_cast<const void*>(state) && sameFactor && mSampleMask == sampleMask)
+				{
+					mStats.skipped[BlendState]++;
+					return;
+				}
+
+				mBlendState = state;
+				for (int i = 0; i < 4; i++)
+				{
+					mBlendFactor[i] = factor[i];
+				}
+				mSampleMask = sampleMask;
+				mStats.issued[BlendState]++;
+				mContext->OMSetBlendState(state, blendFactor, sampleMask);
+			}
+
+			template <class DepthStencilStateType>
+			void OMSetDepthStencilState(DepthStencilStateType state, unsigned int stencilRef)
+			{
+				if (mDepthStencilState == static_cast<const void*>(state) && mStencilRef == stencilRef)
+				{
+					mStats.skipped[DepthStencilState]++;
+					return;
+				}
+
+				mDepthStencilState = state;
+				mStencilRef = stencilRef;
+				mStats.issued[DepthStencilState]++;
+				mContext->OMSetDepthStencilState(state, stencilRef);
+			}
+
+		private:
+			// Bound to nothing a caller could pass, so the first bind after Invalidate is always passed on.
+			static const void* Unknown()
+			{
+				static const char unknown = 0;
+				return &unknown;
+			}
+
+			bool Set(Bind bind, const void*& bound, const void* value)
+			{
+				if (bound == value)
+				{
+					mStats.skipped[bind]++;
+					return false;
+				}
+
+				bound = value;
+				mStats.issued[bind]++;
+				return true;
+			}
+
+			bool SetShader(Bind bind, const void* shader, unsigned int instanceCount)
+			{
+				if (instanceCount == 0)
+				{
+					return Set(bind, mShaders[bind], shader);
+				}
+
+				mShaders[bind] = Unknown();
+				mStats.issued[bind]++;
+				return true;
+			}
+
+			Context* mContext;
+			BindStats mStats;
+
+			const void* mShaders[PixelShader + 1];
+			const void* mSamplers[SamplerSlots];
+			const void* mInputLayout;
+			int mTopology;
+			const void* mRasteriserState;
+			const void* mBlendState;
+			float mBlendFactor[4];
+			unsigned int mSampleMask;
+			const void* mDepthStencilState;
+			unsigned int mStencilRef;
+		};
+
+		// Stands in for a device context, counting the calls that reach it, so the filter can be run without a GPU.
+		struct CountingContext
+		{
+			uint32_t calls[BindCount];
+
+			CountingContext() : calls() {}
+
+			template <class Instances>
+			void VSSetShader(const void*, Instances, unsigned int) { calls[VertexShader]++; }
+			template <class Instances>
+			void HSSetShader(const void*, Instances, unsigned int) { calls[HullShader]++; }
+			template <class Instances>
+			void DSSetShader(const void*, Instances, unsigned int) { calls[DomainShader]++; }
+			template <class Instances>
+			void GSSetShader(const void*, Instances, unsigned int) { calls[GeometryShader]++; }
+			template <class Instances>
+			void PSSetShader(const void*, Instances, unsigned int) { calls[PixelShader]++; }
+			template <class SamplerState>
+			void PSSetSamplers(unsigned int, unsigned int, SamplerState* const*) { calls[Sampler]++; }
+			void IASetInputLayout(const void*) { calls[InputLayout]++; }
+			template <class PrimitiveTopology>
+			void IASetPrimitiveTopology(PrimitiveTopology) { calls[Topology]++; }
+			void RSSetState(const void*) { calls[RasteriserState]++; }
+			void OMSetBlendState(const void*, const float*, unsigned int) { calls[BlendState]++; }
+			void OMSetDepthStencilState(const void*, unsigned int) { calls[DepthStencilState]++; }
+
+			uint32_t Total() const
+			{
+				uint32_t total = 0;
+				for (int bind = 0; bind < BindCount; bind++)
+				{
+					total += calls[bind];
+				}
+				return total;
+			}
+		};
+
+		struct FilterBenchmark
+		{
+			int frames;
+
+			// State calls the renderer makes in a frame at full resolution and shading rate, and those that reach the context.
+			uint32_t callsPerFrame;
+			BindStats stats;
+
+			// Calls that reached CountingContext in total, which should be stats.Issued() every frame.
+			uint32_t contextCalls;
+
+			// Passes of a frame replayed with and without plants in view, and those that drew with different state
+			// on the immediate context than recorded on a deferred context of their own, which should be none.
+			uint32_t passCount;
+			uint32_t modeMismatches;
+		};
+
+		// The state calls of Sample3DSceneRenderer::Render replayed frames times with stand in objects, through the filter.
+		FilterBenchmark RunFilterBenchmark(int frames);
+	}
+}
@@ -7,6 +7,9 @@ cbuffer modelViewProjectionConstantBuffer : register(b0)
 	float4 eye;
 	float4 lookAt;
 	float4 upDir;
+	matrix viewProjection;
+	matrix inverseViewProjection;
+	matrix inverseModel;
 };
 
 struct PixelShaderInput
@@ -93,7 +96,7 @@ PixelShaderInput main(Quad input, float2 UV : SV_DomainLocation, const OutputPat
 
     output.norm = float4(N, 1.0);
     output.posWorld = float4(uvPos, 1);
-    output.position = mul(output.posWorld, mul(view, projection));
+    output.position = mul(output.posWorld, viewProjection);
 
     return output;
 }
@@ -0,0 +1,2425 @@
+﻿#pragma once
+
+// Generated by Tools/HlslTranslator.py from TranslatedShaders.txt. Do not edit.
+
+#include "ShaderBatch.h"
+#include <cstddef>
+#include <limits>
+
+namespace ACW
+{
+	namespace TranslatedShaders
+	{
+		using namespace ShaderBatch;
+
+		enum class KernelStage
+		{
+			Vertex,
+			Pixel
+		};
+
+		// A shader input or output, as the first of the Floats it takes and their count.
+		struct Element
+		{
+			const char* semantic;
+			int first;
+			int count;
+		};
+
+		struct KernelInfo
+		{
+			const char* name;
+			KernelStage stage;
+			int inputCount;
+			int outputCount;
+			// The SV_Position input of a pixel shader, and the SV_Target or SV_Position output, or -1.
+			int positionInput;
+			int mainOutput;
+			const Element* inputs;
+			int inputElementCount;
+			const Element* outputs;
+			int outputElementCount;
+			// The kernel's Constants, each constant buffer under the name of its register.
+			size_t constantsSize;
+			Mask (*run)(const void* constants, const Float* input, Float* output, const Mask& active);
+		};
+
+		// CoralPixelShader.hlsl, pixel shader.
+		namespace CoralPixelShader
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Light
+			{
+				float lightPos[4];
+				float lightColour[4];
+			};
+
+			static_assert(sizeof(Light) == 32, "Light must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+				Light b1;
+			};
+
+			static const Element Inputs[] = { { "SV_POSITION", 0, 4 }, { "NORMAL", 4, 3 }, { "TEXCOORD0", 7, 3 }, { "TEXCOORD1", 10, 1 } };
+			static const Element Outputs[] = { { "SV_Target", 0, 4 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], input[4], input[5], input[6], input[7], input[8], input[9], input[10], output[0], output[1], output[2], output[3]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask&, const Float&, const Float&, const Float&, const Float&, const Float& v_input_normal_x, const Float& v_input_normal_y, const Float& v_input_normal_z, const Float& v_input_posWorld_x, const Float& v_input_posWorld_y, const Float& v_input_posWorld_z, const Float& v_input_height, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					const Float t0 = Saturate(v_input_height);
+					const Float t1 = 0.5f * t0;
+					const Float t2 = 0.45f + t1;
+					const Float t3 = 0.43f * t0;
+					const Float t4 = 0.12f + t3;
+					const Float t5 = 0.3f * t0;
+					const Float t6 = 0.2f + t5;
+					Float v_materialDiffuse_x = t2;
+					Float v_materialDiffuse_y = t4;
+					Float v_materialDiffuse_z = t6;
+					const Float t7 = v_input_normal_x * v_input_normal_x;
+					const Float t8 = v_input_normal_y * v_input_normal_y;
+					const Float t9 = v_input_normal_z * v_input_normal_z;
+					const Float t10 = t7 + t8;
+					const Float t11 = t10 + t9;
+					const Float t12 = Sqrt(t11);
+					const Float t13 = v_input_normal_x / t12;
+					const Float t14 = v_input_normal_y / t12;
+					const Float t15 = v_input_normal_z / t12;
+					Float v_normal_x = t13;
+					Float v_normal_y = t14;
+					Float v_normal_z = t15;
+					const Float t16 = Float(constants.b1.lightPos[0]) - v_input_posWorld_x;
+					const Float t17 = Float(constants.b1.lightPos[1]) - v_input_posWorld_y;
+					const Float t18 = Float(constants.b1.lightPos[2]) - v_input_posWorld_z;
+					const Float t19 = t16 * t16;
+					const Float t20 = t17 * t17;
+					const Float t21 = t18 * t18;
+					const Float t22 = t19 + t20;
+					const Float t23 = t22 + t21;
+					const Float t24 = Sqrt(t23);
+					const Float t25 = t16 / t24;
+					const Float t26 = t17 / t24;
+					const Float t27 = t18 / t24;
+					Float v_lightDir_x = t25;
+					Float v_lightDir_y = t26;
+					Float v_lightDir_z = t27;
+					const Float t28 = Float(constants.b0.eye[0]) - v_input_posWorld_x;
+					const Float t29 = Float(constants.b0.eye[1]) - v_input_posWorld_y;
+					const Float t30 = Float(constants.b0.eye[2]) - v_input_posWorld_z;
+					const Float t31 = t28 * t28;
+					const Float t32 = t29 * t29;
+					const Float t33 = t30 * t30;
+					const Float t34 = t31 + t32;
+					const Float t35 = t34 + t33;
+					const Float t36 = Sqrt(t35);
+					const Float t37 = t28 / t36;
+					const Float t38 = t29 / t36;
+					const Float t39 = t30 / t36;
+					Float v_viewDir_x = t37;
+					Float v_viewDir_y = t38;
+					Float v_viewDir_z = t39;
+					const Float t40 = v_lightDir_x * v_normal_x;
+					const Float t41 = v_lightDir_y * v_normal_y;
+					const Float t42 = v_lightDir_z * v_normal_z;
+					const Float t43 = t40 + t41;
+					const Float t44 = t43 + t42;
+					const Float t45 = Saturate(t44);
+					const Float t46 = v_lightDir_x * v_normal_x;
+					const Float t47 = v_lightDir_y * v_normal_y;
+					const Float t48 = v_lightDir_z * v_normal_z;
+					const Float t49 = t46 + t47;
+					const Float t50 = t49 + t48;
+					const Float t51 = -t50;
+					const Float t52 = Saturate(t51);
+					const Float t53 = 0.25f * t52;
+					const Float t54 = t45 + t53;
+					Float v_diffuseFactor = t54;
+					const Float t55 = -v_lightDir_x;
+					const Float t56 = -v_lightDir_y;
+					const Float t57 = -v_lightDir_z;
+					const Float t58 = v_normal_x * t55;
+					const Float t59 = v_normal_y * t56;
+					const Float t60 = v_normal_z * t57;
+					const Float t61 = t58 + t59;
+					const Float t62 = t61 + t60;
+					const Float t63 = 2.0f * t62;
+					const Float t64 = t63 * v_normal_x;
+					const Float t65 = t55 - t64;
+					const Float t66 = t63 * v_normal_y;
+					const Float t67 = t56 - t66;
+					const Float t68 = t63 * v_normal_z;
+					const Float t69 = t57 - t68;
+					const Float t70 = v_viewDir_x * t65;
+					const Float t71 = v_viewDir_y * t67;
+					const Float t72 = v_viewDir_z * t69;
+					const Float t73 = t70 + t71;
+					const Float t74 = t73 + t72;
+					const Float t75 = Saturate(t74);
+					const Float t76 = Pow(t75, 32.0f);
+					Float v_specularFactor = t76;
+					const Float t77 = v_diffuseFactor * Float(constants.b1.lightColour[0]);
+					const Float t78 = v_diffuseFactor * Float(constants.b1.lightColour[1]);
+					const Float t79 = v_diffuseFactor * Float(constants.b1.lightColour[2]);
+					const Float t80 = 0.15f + t77;
+					const Float t81 = 0.15f + t78;
+					const Float t82 = 0.15f + t79;
+					const Float t83 = v_materialDiffuse_x * t80;
+					const Float t84 = v_materialDiffuse_y * t81;
+					const Float t85 = v_materialDiffuse_z * t82;
+					const Float t86 = 0.2f * v_specularFactor;
+					const Float t87 = t86 * Float(constants.b1.lightColour[0]);
+					const Float t88 = t86 * Float(constants.b1.lightColour[1]);
+					const Float t89 = t86 * Float(constants.b1.lightColour[2]);
+					const Float t90 = t83 + t87;
+					const Float t91 = t84 + t88;
+					const Float t92 = t85 + t89;
+					Float v_colour_x = t90;
+					Float v_colour_y = t91;
+					Float v_colour_z = t92;
+					const Float t93 = Saturate(v_colour_x);
+					const Float t94 = Saturate(v_colour_y);
+					const Float t95 = Saturate(v_colour_z);
+					r_0 = t93;
+					r_1 = t94;
+					r_2 = t95;
+					r_3 = 1.0f;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// CoralVertexShader.hlsl, vertex shader.
+		namespace CoralVertexShader
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+				float viewProjection[4][4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 304, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct coralMeshBoundsConstantBuffer
+			{
+				float boundsMinimum[16][4];
+				float boundsExtent[16][4];
+			};
+
+			static_assert(sizeof(coralMeshBoundsConstantBuffer) == 512, "coralMeshBoundsConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+				coralMeshBoundsConstantBuffer b2;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 4 }, { "NORMAL", 4, 2 }, { "INSTANCEPOSITION", 6, 3 }, { "SCALE", 9, 1 }, { "ANGLE", 10, 1 }, { "VARIANT", 11, 1 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 }, { "NORMAL", 4, 3 }, { "TEXCOORD0", 7, 3 }, { "TEXCOORD1", 10, 1 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], input[4], input[5], input[6], input[7], input[8], input[9], input[10], input[11], output[0], output[1], output[2], output[3], output[4], output[5], output[6], output[7], output[8], output[9], output[10]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_DecodePosition(const Mask&, const Float& v_normalised_x, const Float& v_normalised_y, const Float& v_normalised_z, const Float& v_boundsMinimum_x, const Float& v_boundsMinimum_y, const Float& v_boundsMinimum_z, const Float& v_boundsExtent_x, const Float& v_boundsExtent_y, const Float& v_boundsExtent_z, Float& r_0, Float& r_1, Float& r_2)
+				{
+					const Float t0 = v_normalised_x * v_boundsExtent_x;
+					const Float t1 = v_normalised_y * v_boundsExtent_y;
+					const Float t2 = v_normalised_z * v_boundsExtent_z;
+					const Float t3 = v_boundsMinimum_x + t0;
+					const Float t4 = v_boundsMinimum_y + t1;
+					const Float t5 = v_boundsMinimum_z + t2;
+					r_0 = t3;
+					r_1 = t4;
+					r_2 = t5;
+				}
+
+				void f_OctDecode(const Mask&, const Float& v_e_x, const Float& v_e_y, Float& r_0, Float& r_1, Float& r_2)
+				{
+					const Float t0 = Abs(v_e_x);
+					const Float t1 = 1.0f - t0;
+					const Float t2 = Abs(v_e_y);
+					const Float t3 = t1 - t2;
+					Float v_n_x = v_e_x;
+					Float v_n_y = v_e_y;
+					Float v_n_z = t3;
+					const Float t4 = -v_n_z;
+					const Float t5 = Saturate(t4);
+					Float v_t = t5;
+					const Mask t6 = v_n_x >= 0.0f;
+					const Float t8 = -v_t;
+					const Float t9 = Select(t6, t8, v_t);
+					const Float t10 = v_n_x + t9;
+					const Float t11 = v_n_y + t9;
+					v_n_x = t10;
+					v_n_y = t11;
+					const Float t12 = v_n_x * v_n_x;
+					const Float t13 = v_n_y * v_n_y;
+					const Float t14 = v_n_z * v_n_z;
+					const Float t15 = t12 + t13;
+					const Float t16 = t15 + t14;
+					const Float t17 = Sqrt(t16);
+					const Float t18 = v_n_x / t17;
+					const Float t19 = v_n_y / t17;
+					const Float t20 = v_n_z / t17;
+					r_0 = t18;
+					r_1 = t19;
+					r_2 = t20;
+				}
+
+				void f_main(const Mask& entry, const Float& v_input_position_x, const Float& v_input_position_y, const Float& v_input_position_z, const Float&, const Float& v_input_normal_x, const Float& v_input_normal_y, const Float& v_input_instancePosition_x, const Float& v_input_instancePosition_y, const Float& v_input_instancePosition_z, const Float& v_input_scale, const Float& v_input_angle, const Float& v_input_variant, Float& r_0, Float& r_1, Float& r_2, Float& r_3, Float& r_4, Float& r_5, Float& r_6, Float& r_7, Float& r_8, Float& r_9, Float& r_10)
+				{
+					Mask mask = entry;
+
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					Float v_output_normal_x = 0.0f;
+					Float v_output_normal_y = 0.0f;
+					Float v_output_normal_z = 0.0f;
+					Float v_output_posWorld_x = 0.0f;
+					Float v_output_posWorld_y = 0.0f;
+					Float v_output_posWorld_z = 0.0f;
+					Float v_output_height = 0.0f;
+					const Float t0 = Gather(&constants.b2.boundsMinimum[0][0], 4, 16, v_input_variant);
+					const Float t1 = Gather(&constants.b2.boundsMinimum[0][1], 4, 16, v_input_variant);
+					const Float t2 = Gather(&constants.b2.boundsMinimum[0][2], 4, 16, v_input_variant);
+					const Float t4 = Gather(&constants.b2.boundsExtent[0][0], 4, 16, v_input_variant);
+					const Float t5 = Gather(&constants.b2.boundsExtent[0][1], 4, 16, v_input_variant);
+					const Float t6 = Gather(&constants.b2.boundsExtent[0][2], 4, 16, v_input_variant);
+					Float t8 = 0.0f;
+					Float t9 = 0.0f;
+					Float t10 = 0.0f;
+					f_DecodePosition(mask, v_input_position_x, v_input_position_y, v_input_position_z, t0, t1, t2, t4, t5, t6, t8, t9, t10);
+					Float v_position_x = t8;
+					Float v_position_y = t9;
+					Float v_position_z = t10;
+					Float t11 = 0.0f;
+					Float t12 = 0.0f;
+					Float t13 = 0.0f;
+					f_OctDecode(mask, v_input_normal_x, v_input_normal_y, t11, t12, t13);
+					Float v_unpacked_x = t11;
+					Float v_unpacked_y = t12;
+					Float v_unpacked_z = t13;
+					Float v_s = 0.0f;
+					Float v_c = 0.0f;
+					const Float t14 = Sin(v_input_angle);
+					v_s = t14;
+					const Float t15 = Cos(v_input_angle);
+					v_c = t15;
+					const Float t16 = v_c * v_position_x;
+					const Float t17 = v_s * v_position_z;
+					const Float t18 = t16 + t17;
+					const Float t19 = v_c * v_position_z;
+					const Float t20 = v_s * v_position_x;
+					const Float t21 = t19 - t20;
+					Float v_local_x = t18;
+					Float v_local_y = v_position_y;
+					Float v_local_z = t21;
+					const Float t22 = v_c * v_unpacked_x;
+					const Float t23 = v_s * v_unpacked_z;
+					const Float t24 = t22 + t23;
+					const Float t25 = v_c * v_unpacked_z;
+					const Float t26 = v_s * v_unpacked_x;
+					const Float t27 = t25 - t26;
+					Float v_normal_x = t24;
+					Float v_normal_y = v_unpacked_y;
+					Float v_normal_z = t27;
+					const Float t28 = v_local_x * v_input_scale;
+					const Float t29 = v_local_y * v_input_scale;
+					const Float t30 = v_local_z * v_input_scale;
+					const Float t31 = v_input_instancePosition_x + t28;
+					const Float t32 = v_input_instancePosition_y + t29;
+					const Float t33 = v_input_instancePosition_z + t30;
+					v_output_posWorld_x = t31;
+					v_output_posWorld_y = t32;
+					v_output_posWorld_z = t33;
+					const Float t34 = v_output_posWorld_x * Float(constants.b0.viewProjection[0][0]);
+					const Float t35 = v_output_posWorld_y * Float(constants.b0.viewProjection[0][1]);
+					const Float t36 = v_output_posWorld_z * Float(constants.b0.viewProjection[0][2]);
+					const Float t37 = 1.0f * Float(constants.b0.viewProjection[0][3]);
+					const Float t38 = t34 + t35;
+					const Float t39 = t38 + t36;
+					const Float t40 = t39 + t37;
+					const Float t41 = v_output_posWorld_x * Float(constants.b0.viewProjection[1][0]);
+					const Float t42 = v_output_posWorld_y * Float(constants.b0.viewProjection[1][1]);
+					const Float t43 = v_output_posWorld_z * Float(constants.b0.viewProjection[1][2]);
+					const Float t44 = 1.0f * Float(constants.b0.viewProjection[1][3]);
+					const Float t45 = t41 + t42;
+					const Float t46 = t45 + t43;
+					const Float t47 = t46 + t44;
+					const Float t48 = v_output_posWorld_x * Float(constants.b0.viewProjection[2][0]);
+					const Float t49 = v_output_posWorld_y * Float(constants.b0.viewProjection[2][1]);
+					const Float t50 = v_output_posWorld_z * Float(constants.b0.viewProjection[2][2]);
+					const Float t51 = 1.0f * Float(constants.b0.viewProjection[2][3]);
+					const Float t52 = t48 + t49;
+					const Float t53 = t52 + t50;
+					const Float t54 = t53 + t51;
+					const Float t55 = v_output_posWorld_x * Float(constants.b0.viewProjection[3][0]);
+					const Float t56 = v_output_posWorld_y * Float(constants.b0.viewProjection[3][1]);
+					const Float t57 = v_output_posWorld_z * Float(constants.b0.viewProjection[3][2]);
+					const Float t58 = 1.0f * Float(constants.b0.viewProjection[3][3]);
+					const Float t59 = t55 + t56;
+					const Float t60 = t59 + t57;
+					const Float t61 = t60 + t58;
+					v_output_position_x = t40;
+					v_output_position_y = t47;
+					v_output_position_z = t54;
+					v_output_position_w = t61;
+					v_output_normal_x = v_normal_x;
+					v_output_normal_y = v_normal_y;
+					v_output_normal_z = v_normal_z;
+					v_output_height = v_position_y;
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+					r_4 = v_output_normal_x;
+					r_5 = v_output_normal_y;
+					r_6 = v_output_normal_z;
+					r_7 = v_output_posWorld_x;
+					r_8 = v_output_posWorld_y;
+					r_9 = v_output_posWorld_z;
+					r_10 = v_output_height;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// WaterPixel.hlsl, pixel shader.
+		namespace WaterPixel
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Light
+			{
+				float lightPos[4];
+				float lightColour[4];
+			};
+
+			static_assert(sizeof(Light) == 32, "Light must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+				Light b1;
+			};
+
+			static const Element Inputs[] = { { "SV_POSITION", 0, 4 }, { "NORMAL", 4, 4 }, { "TEXCOORD", 8, 4 } };
+			static const Element Outputs[] = { { "SV_TARGET", 0, 4 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], input[4], input[5], input[6], input[7], input[8], input[9], input[10], input[11], output[0], output[1], output[2], output[3]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask& entry, const Float&, const Float&, const Float&, const Float&, const Float& v_input_norm_x, const Float& v_input_norm_y, const Float& v_input_norm_z, const Float& v_input_norm_w, const Float& v_input_posWorld_x, const Float& v_input_posWorld_y, const Float& v_input_posWorld_z, const Float& v_input_posWorld_w, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					Mask mask = entry;
+
+					Float v_finalColour_x = 0.0f;
+					Float v_finalColour_y = 0.0f;
+					Float v_finalColour_z = 0.0f;
+					Float v_finalColour_w = 0.0f;
+					Float v_diffuseColour_x = 0.0f;
+					Float v_diffuseColour_y = 0.0f;
+					Float v_diffuseColour_z = 0.0f;
+					Float v_diffuseColour_w = 0.0f;
+					Float v_diffuseFactor = 0.0f;
+					Float v_specularColour_x = 0.0f;
+					Float v_specularColour_y = 0.0f;
+					Float v_specularColour_z = 0.0f;
+					Float v_specularColour_w = 0.0f;
+					Float v_specularFactor = 0.0f;
+					Float v_ambientColour_x = 0.2f;
+					Float v_ambientColour_y = 0.2f;
+					Float v_ambientColour_z = 0.3f;
+					Float v_ambientColour_w = 1.0f;
+					Float v_materialDiffuse_x = 0.0f;
+					Float v_materialDiffuse_y = 0.0f;
+					Float v_materialDiffuse_z = 0.0f;
+					Float v_materialDiffuse_w = 0.0f;
+					Float v_materialSpecular_x = 0.0f;
+					Float v_materialSpecular_y = 0.0f;
+					Float v_materialSpecular_z = 0.0f;
+					Float v_materialSpecular_w = 0.0f;
+					Float v_texColour_x = 0.0f;
+					Float v_texColour_y = 0.0f;
+					Float v_texColour_z = 0.0f;
+					Float v_texColour_w = 0.0f;
+					v_materialDiffuse_x = 0.0f;
+					v_materialDiffuse_y = 0.6f;
+					v_materialDiffuse_z = 0.8f;
+					v_materialDiffuse_w = 1.0f;
+					v_materialSpecular_x = 0.0f;
+					v_materialSpecular_y = 0.7f;
+					v_materialSpecular_z = 0.9f;
+					v_materialSpecular_w = 1.0f;
+					v_texColour_x = 0.0f;
+					v_texColour_y = 0.8f;
+					v_texColour_z = 1.0f;
+					v_texColour_w = 1.0f;
+					const Float t0 = Float(constants.b0.eye[0]) - v_input_posWorld_x;
+					const Float t1 = Float(constants.b0.eye[1]) - v_input_posWorld_y;
+					const Float t2 = Float(constants.b0.eye[2]) - v_input_posWorld_z;
+					const Float t3 = Float(constants.b0.eye[3]) - v_input_posWorld_w;
+					const Float t4 = t0 * t0;
+					const Float t5 = t1 * t1;
+					const Float t6 = t2 * t2;
+					const Float t7 = t3 * t3;
+					const Float t8 = t4 + t5;
+					const Float t9 = t8 + t6;
+					const Float t10 = t9 + t7;
+					const Float t11 = Sqrt(t10);
+					const Float t12 = t0 / t11;
+					const Float t13 = t1 / t11;
+					const Float t14 = t2 / t11;
+					const Float t15 = t3 / t11;
+					Float v_viewDir_x = t12;
+					Float v_viewDir_y = t13;
+					Float v_viewDir_z = t14;
+					Float v_viewDir_w = t15;
+					const Float t16 = Float(constants.b1.lightPos[0]) - v_input_posWorld_x;
+					const Float t17 = Float(constants.b1.lightPos[1]) - v_input_posWorld_y;
+					const Float t18 = Float(constants.b1.lightPos[2]) - v_input_posWorld_z;
+					const Float t19 = Float(constants.b1.lightPos[3]) - v_input_posWorld_w;
+					const Float t20 = t16 * t16;
+					const Float t21 = t17 * t17;
+					const Float t22 = t18 * t18;
+					const Float t23 = t19 * t19;
+					const Float t24 = t20 + t21;
+					const Float t25 = t24 + t22;
+					const Float t26 = t25 + t23;
+					const Float t27 = Sqrt(t26);
+					const Float t28 = t16 / t27;
+					const Float t29 = t17 / t27;
+					const Float t30 = t18 / t27;
+					const Float t31 = t19 / t27;
+					Float v_lightDir_x = t28;
+					Float v_lightDir_y = t29;
+					Float v_lightDir_z = t30;
+					Float v_lightDir_w = t31;
+					const Float t32 = -v_lightDir_x;
+					const Float t33 = -v_lightDir_y;
+					const Float t34 = -v_lightDir_z;
+					const Float t35 = -v_lightDir_w;
+					const Float t36 = v_input_norm_x * t32;
+					const Float t37 = v_input_norm_y * t33;
+					const Float t38 = v_input_norm_z * t34;
+					const Float t39 = v_input_norm_w * t35;
+					const Float t40 = t36 + t37;
+					const Float t41 = t40 + t38;
+					const Float t42 = t41 + t39;
+					const Float t43 = 2.0f * t42;
+					const Float t44 = t43 * v_input_norm_x;
+					const Float t45 = t32 - t44;
+					const Float t46 = t43 * v_input_norm_y;
+					const Float t47 = t33 - t46;
+					const Float t48 = t43 * v_input_norm_z;
+					const Float t49 = t34 - t48;
+					const Float t50 = t43 * v_input_norm_w;
+					const Float t51 = t35 - t50;
+					const Float t52 = t45 * t45;
+					const Float t53 = t47 * t47;
+					const Float t54 = t49 * t49;
+					const Float t55 = t51 * t51;
+					const Float t56 = t52 + t53;
+					const Float t57 = t56 + t54;
+					const Float t58 = t57 + t55;
+					const Float t59 = Sqrt(t58);
+					const Float t60 = t45 / t59;
+					const Float t61 = t47 / t59;
+					const Float t62 = t49 / t59;
+					const Float t63 = t51 / t59;
+					Float v_reflection_x = t60;
+					Float v_reflection_y = t61;
+					Float v_reflection_z = t62;
+					Float v_reflection_w = t63;
+					const Float t64 = v_lightDir_x * v_input_norm_x;
+					const Float t65 = v_lightDir_y * v_input_norm_y;
+					const Float t66 = v_lightDir_z * v_input_norm_z;
+					const Float t67 = v_lightDir_w * v_input_norm_w;
+					const Float t68 = t64 + t65;
+					const Float t69 = t68 + t66;
+					const Float t70 = t69 + t67;
+					const Float t71 = Saturate(t70);
+					v_diffuseFactor = t71;
+					const Mask t72 = v_diffuseFactor > 0.0f;
+					{
+						const Mask outer1 = mask;
+						const Mask cond1 = t72;
+						mask = outer1 & cond1;
+						if (Any(mask))
+						{
+							const Float t73 = v_viewDir_x * v_reflection_x;
+							const Float t74 = v_viewDir_y * v_reflection_y;
+							const Float t75 = v_viewDir_z * v_reflection_z;
+							const Float t76 = v_viewDir_w * v_reflection_w;
+							const Float t77 = t73 + t74;
+							const Float t78 = t77 + t75;
+							const Float t79 = t78 + t76;
+							const Float t80 = Saturate(t79);
+							const Float t81 = Pow(t80, 12.8f);
+							v_specularFactor = Select(mask, t81, v_specularFactor);
+						}
+						mask = outer1;
+					}
+					const Float t82 = Float(constants.b1.lightColour[0]) * v_diffuseFactor;
+					const Float t83 = Float(constants.b1.lightColour[1]) * v_diffuseFactor;
+					const Float t84 = Float(constants.b1.lightColour[2]) * v_diffuseFactor;
+					const Float t85 = Float(constants.b1.lightColour[3]) * v_diffuseFactor;
+					v_diffuseColour_x = t82;
+					v_diffuseColour_y = t83;
+					v_diffuseColour_z = t84;
+					v_diffuseColour_w = t85;
+					const Float t86 = Float(constants.b1.lightColour[0]) * v_specularFactor;
+					const Float t87 = Float(constants.b1.lightColour[1]) * v_specularFactor;
+					const Float t88 = Float(constants.b1.lightColour[2]) * v_specularFactor;
+					const Float t89 = Float(constants.b1.lightColour[3]) * v_specularFactor;
+					v_specularColour_x = t86;
+					v_specularColour_y = t87;
+					v_specularColour_z = t88;
+					v_specularColour_w = t89;
+					const Float t90 = v_diffuseColour_x * v_materialDiffuse_x;
+					const Float t91 = v_diffuseColour_y * v_materialDiffuse_y;
+					const Float t92 = v_diffuseColour_z * v_materialDiffuse_z;
+					const Float t93 = v_diffuseColour_w * v_materialDiffuse_w;
+					const Float t94 = v_ambientColour_x + t90;
+					const Float t95 = v_ambientColour_y + t91;
+					const Float t96 = v_ambientColour_z + t92;
+					const Float t97 = v_ambientColour_w + t93;
+					const Float t98 = v_specularColour_x * v_materialSpecular_x;
+					const Float t99 = v_specularColour_y * v_materialSpecular_y;
+					const Float t100 = v_specularColour_z * v_materialSpecular_z;
+					const Float t101 = v_specularColour_w * v_materialSpecular_w;
+					const Float t102 = t94 + t98;
+					const Float t103 = t95 + t99;
+					const Float t104 = t96 + t100;
+					const Float t105 = t97 + t101;
+					const Float t106 = Saturate(t102);
+					const Float t107 = Saturate(t103);
+					const Float t108 = Saturate(t104);
+					const Float t109 = Saturate(t105);
+					v_finalColour_x = t106;
+					v_finalColour_y = t107;
+					v_finalColour_z = t108;
+					v_finalColour_w = t109;
+					Float v_fogColor_x = 1.0f;
+					Float v_fogColor_y = 1.0f;
+					Float v_fogColor_z = 1.0f;
+					Float v_fogColor_w = 1.0f;
+					Float v_fogStartDistance = 5e+01f;
+					Float v_fogEndDistance = 1e+02f;
+					const Float t110 = v_input_posWorld_x * v_input_posWorld_x;
+					const Float t111 = v_input_posWorld_y * v_input_posWorld_y;
+					const Float t112 = v_input_posWorld_z * v_input_posWorld_z;
+					const Float t113 = v_input_posWorld_w * v_input_posWorld_w;
+					const Float t114 = t110 + t111;
+					const Float t115 = t114 + t112;
+					const Float t116 = t115 + t113;
+					const Float t117 = Sqrt(t116);
+					Float v_viewDistance = t117;
+					const Float t118 = v_viewDistance - v_fogStartDistance;
+					const Float t119 = v_fogEndDistance - v_fogStartDistance;
+					const Float t120 = t118 / t119;
+					const Float t121 = Saturate(t120);
+					Float v_fogFactor = t121;
+					const Float t122 = v_finalColour_x * v_texColour_x;
+					const Float t123 = v_finalColour_y * v_texColour_y;
+					const Float t124 = v_finalColour_z * v_texColour_z;
+					const Float t125 = v_finalColour_w * v_texColour_w;
+					const Float t126 = Saturate(t122);
+					const Float t127 = Saturate(t123);
+					const Float t128 = Saturate(t124);
+					const Float t129 = Saturate(t125);
+					v_finalColour_x = t126;
+					v_finalColour_y = t127;
+					v_finalColour_z = t128;
+					v_finalColour_w = t129;
+					const Float t130 = v_fogColor_x - v_finalColour_x;
+					const Float t131 = t130 * v_fogFactor;
+					const Float t132 = v_finalColour_x + t131;
+					const Float t133 = v_fogColor_y - v_finalColour_y;
+					const Float t134 = t133 * v_fogFactor;
+					const Float t135 = v_finalColour_y + t134;
+					const Float t136 = v_fogColor_z - v_finalColour_z;
+					const Float t137 = t136 * v_fogFactor;
+					const Float t138 = v_finalColour_z + t137;
+					const Float t139 = v_fogColor_w - v_finalColour_w;
+					const Float t140 = t139 * v_fogFactor;
+					const Float t141 = v_finalColour_w + t140;
+					Float v_finalColor_x = t132;
+					Float v_finalColor_y = t135;
+					Float v_finalColor_z = t138;
+					Float v_finalColor_w = t141;
+					r_0 = v_finalColor_x;
+					r_1 = v_finalColor_y;
+					r_2 = v_finalColor_z;
+					r_3 = v_finalColor_w;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// TerrainPixel.hlsl, pixel shader.
+		namespace TerrainPixel
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Light
+			{
+				float lightPos[4];
+				float lightColour[4];
+			};
+
+			static_assert(sizeof(Light) == 32, "Light must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+				Light b1;
+			};
+
+			static const Element Inputs[] = { { "SV_POSITION", 0, 4 }, { "NORMAL", 4, 4 }, { "TEXCOORD", 8, 4 } };
+			static const Element Outputs[] = { { "SV_TARGET", 0, 4 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], input[4], input[5], input[6], input[7], input[8], input[9], input[10], input[11], output[0], output[1], output[2], output[3]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_Noise(const Mask&, const Float& v_p_x, const Float& v_p_y, Float& r_0)
+				{
+					const Float t2 = Frac(v_p_x);
+					const Float t3 = Frac(v_p_y);
+					Float v_f_x = t2;
+					Float v_f_y = t3;
+					const Float t4 = v_f_x * v_f_x;
+					const Float t5 = v_f_y * v_f_y;
+					const Float t6 = 2.0f * v_f_x;
+					const Float t7 = 2.0f * v_f_y;
+					const Float t8 = 3.0f - t6;
+					const Float t9 = 3.0f - t7;
+					const Float t10 = t4 * t8;
+					const Float t11 = t5 * t9;
+					Float v_uv_x = t10;
+					Float v_uv_y = t11;
+					Float v_n1 = 0.0f;
+					Float v_n2 = 0.0f;
+					Float v_n3 = 0.0f;
+					Float v_n4 = 0.0f;
+					const Float t19 = v_n2 - v_n1;
+					const Float t20 = t19 * v_uv_x;
+					const Float t21 = v_n1 + t20;
+					v_n1 = t21;
+					const Float t22 = v_n4 - v_n3;
+					const Float t23 = t22 * v_uv_x;
+					const Float t24 = v_n3 + t23;
+					v_n2 = t24;
+					const Float t25 = v_n2 - v_n1;
+					const Float t26 = t25 * v_uv_y;
+					const Float t27 = v_n1 + t26;
+					r_0 = t27;
+				}
+
+				void f_fractalNoise(const Mask& entry, const Float& a_xy_x, const Float& a_xy_y, Float& r_0)
+				{
+					Float v_xy_x = a_xy_x;
+					Float v_xy_y = a_xy_y;
+					Mask mask = entry;
+
+					Float v_w = 0.7f;
+					Float v_f = 0.0f;
+					{
+						Float v_i = 0.0f;
+						const Mask outer1 = mask;
+						Mask loop1 = outer1;
+						for (;;)
+						{
+							mask = loop1;
+							const Mask t0 = v_i < 4.0f;
+							loop1 = loop1 & t0;
+							mask = loop1;
+							if (!Any(mask))
+								break;
+							{
+								Float t1 = 0.0f;
+								f_Noise(mask, v_xy_x, v_xy_y, t1);
+								const Float t2 = t1 * v_w;
+								const Float t3 = v_f + t2;
+								v_f = Select(mask, t3, v_f);
+								const Float t4 = v_w * 0.5f;
+								v_w = Select(mask, t4, v_w);
+								const Float t5 = v_xy_x * 2.7f;
+								const Float t6 = v_xy_y * 2.7f;
+								v_xy_x = Select(mask, t5, v_xy_x);
+								v_xy_y = Select(mask, t6, v_xy_y);
+							}
+							const Float t7 = v_i;
+							const Float t8 = t7 + 1.0f;
+							v_i = Select(mask, t8, v_i);
+						}
+						mask = outer1;
+					}
+					r_0 = v_f;
+				}
+
+				void f_main(const Mask& entry, const Float&, const Float&, const Float&, const Float&, const Float& v_input_norm_x, const Float& v_input_norm_y, const Float& v_input_norm_z, const Float& v_input_norm_w, const Float& v_input_posWorld_x, const Float& v_input_posWorld_y, const Float& v_input_posWorld_z, const Float& v_input_posWorld_w, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					Mask mask = entry;
+
+					Float v_finalColour_x = 0.0f;
+					Float v_finalColour_y = 0.0f;
+					Float v_finalColour_z = 0.0f;
+					Float v_finalColour_w = 0.0f;
+					Float v_diffuseColour_x = 0.0f;
+					Float v_diffuseColour_y = 0.0f;
+					Float v_diffuseColour_z = 0.0f;
+					Float v_diffuseColour_w = 0.0f;
+					Float v_diffuseFactor = 0.0f;
+					Float v_specularColour_x = 0.0f;
+					Float v_specularColour_y = 0.0f;
+					Float v_specularColour_z = 0.0f;
+					Float v_specularColour_w = 0.0f;
+					Float v_specularFactor = 0.0f;
+					Float v_ambientColour_x = 0.1f;
+					Float v_ambientColour_y = 0.1f;
+					Float v_ambientColour_z = 0.1f;
+					Float v_ambientColour_w = 1.0f;
+					Float v_materialDiffuse_x = 0.0f;
+					Float v_materialDiffuse_y = 0.0f;
+					Float v_materialDiffuse_z = 0.0f;
+					Float v_materialDiffuse_w = 0.0f;
+					Float v_materialSpecular_x = 0.0f;
+					Float v_materialSpecular_y = 0.0f;
+					Float v_materialSpecular_z = 0.0f;
+					Float v_materialSpecular_w = 0.0f;
+					Float v_texColour_x = 0.0f;
+					Float v_texColour_y = 0.0f;
+					Float v_texColour_z = 0.0f;
+					Float v_texColour_w = 0.0f;
+					v_materialDiffuse_x = 0.8f;
+					v_materialDiffuse_y = 0.5f;
+					v_materialDiffuse_z = 0.25f;
+					v_materialDiffuse_w = 1.0f;
+					v_materialSpecular_x = 0.3f;
+					v_materialSpecular_y = 0.2f;
+					v_materialSpecular_z = 0.1f;
+					v_materialSpecular_w = 1.0f;
+					Float t0 = 0.0f;
+					f_fractalNoise(mask, v_input_posWorld_x, v_input_posWorld_z, t0);
+					const Float t1 = 1.0f * t0;
+					const Float t2 = 0.7f * t0;
+					const Float t3 = 0.3f * t0;
+					const Float t4 = 1.0f * t0;
+					v_texColour_x = t1;
+					v_texColour_y = t2;
+					v_texColour_z = t3;
+					v_texColour_w = t4;
+					const Float t5 = Float(constants.b0.eye[0]) - v_input_posWorld_x;
+					const Float t6 = Float(constants.b0.eye[1]) - v_input_posWorld_y;
+					const Float t7 = Float(constants.b0.eye[2]) - v_input_posWorld_z;
+					const Float t8 = Float(constants.b0.eye[3]) - v_input_posWorld_w;
+					const Float t9 = t5 * t5;
+					const Float t10 = t6 * t6;
+					const Float t11 = t7 * t7;
+					const Float t12 = t8 * t8;
+					const Float t13 = t9 + t10;
+					const Float t14 = t13 + t11;
+					const Float t15 = t14 + t12;
+					const Float t16 = Sqrt(t15);
+					const Float t17 = t5 / t16;
+					const Float t18 = t6 / t16;
+					const Float t19 = t7 / t16;
+					const Float t20 = t8 / t16;
+					Float v_viewDir_x = t17;
+					Float v_viewDir_y = t18;
+					Float v_viewDir_z = t19;
+					Float v_viewDir_w = t20;
+					const Float t21 = Float(constants.b1.lightPos[0]) - v_input_posWorld_x;
+					const Float t22 = Float(constants.b1.lightPos[1]) - v_input_posWorld_y;
+					const Float t23 = Float(constants.b1.lightPos[2]) - v_input_posWorld_z;
+					const Float t24 = Float(constants.b1.lightPos[3]) - v_input_posWorld_w;
+					const Float t25 = t21 * t21;
+					const Float t26 = t22 * t22;
+					const Float t27 = t23 * t23;
+					const Float t28 = t24 * t24;
+					const Float t29 = t25 + t26;
+					const Float t30 = t29 + t27;
+					const Float t31 = t30 + t28;
+					const Float t32 = Sqrt(t31);
+					const Float t33 = t21 / t32;
+					const Float t34 = t22 / t32;
+					const Float t35 = t23 / t32;
+					const Float t36 = t24 / t32;
+					Float v_lightDir_x = t33;
+					Float v_lightDir_y = t34;
+					Float v_lightDir_z = t35;
+					Float v_lightDir_w = t36;
+					const Float t37 = -v_lightDir_x;
+					const Float t38 = -v_lightDir_y;
+					const Float t39 = -v_lightDir_z;
+					const Float t40 = -v_lightDir_w;
+					const Float t41 = v_input_norm_x * t37;
+					const Float t42 = v_input_norm_y * t38;
+					const Float t43 = v_input_norm_z * t39;
+					const Float t44 = v_input_norm_w * t40;
+					const Float t45 = t41 + t42;
+					const Float t46 = t45 + t43;
+					const Float t47 = t46 + t44;
+					const Float t48 = 2.0f * t47;
+					const Float t49 = t48 * v_input_norm_x;
+					const Float t50 = t37 - t49;
+					const Float t51 = t48 * v_input_norm_y;
+					const Float t52 = t38 - t51;
+					const Float t53 = t48 * v_input_norm_z;
+					const Float t54 = t39 - t53;
+					const Float t55 = t48 * v_input_norm_w;
+					const Float t56 = t40 - t55;
+					const Float t57 = t50 * t50;
+					const Float t58 = t52 * t52;
+					const Float t59 = t54 * t54;
+					const Float t60 = t56 * t56;
+					const Float t61 = t57 + t58;
+					const Float t62 = t61 + t59;
+					const Float t63 = t62 + t60;
+					const Float t64 = Sqrt(t63);
+					const Float t65 = t50 / t64;
+					const Float t66 = t52 / t64;
+					const Float t67 = t54 / t64;
+					const Float t68 = t56 / t64;
+					Float v_reflection_x = t65;
+					Float v_reflection_y = t66;
+					Float v_reflection_z = t67;
+					Float v_reflection_w = t68;
+					const Float t69 = v_lightDir_x * v_input_norm_x;
+					const Float t70 = v_lightDir_y * v_input_norm_y;
+					const Float t71 = v_lightDir_z * v_input_norm_z;
+					const Float t72 = v_lightDir_w * v_input_norm_w;
+					const Float t73 = t69 + t70;
+					const Float t74 = t73 + t71;
+					const Float t75 = t74 + t72;
+					const Float t76 = Saturate(t75);
+					v_diffuseFactor = t76;
+					const Mask t77 = v_diffuseFactor > 0.0f;
+					{
+						const Mask outer1 = mask;
+						const Mask cond1 = t77;
+						mask = outer1 & cond1;
+						if (Any(mask))
+						{
+							const Float t78 = v_viewDir_x * v_reflection_x;
+							const Float t79 = v_viewDir_y * v_reflection_y;
+							const Float t80 = v_viewDir_z * v_reflection_z;
+							const Float t81 = v_viewDir_w * v_reflection_w;
+							const Float t82 = t78 + t79;
+							const Float t83 = t82 + t80;
+							const Float t84 = t83 + t81;
+							const Float t85 = Saturate(t84);
+							const Float t86 = Pow(t85, 102.4f);
+							v_specularFactor = Select(mask, t86, v_specularFactor);
+						}
+						mask = outer1;
+					}
+					const Float t87 = Float(constants.b1.lightColour[0]) * v_diffuseFactor;
+					const Float t88 = Float(constants.b1.lightColour[1]) * v_diffuseFactor;
+					const Float t89 = Float(constants.b1.lightColour[2]) * v_diffuseFactor;
+					const Float t90 = Float(constants.b1.lightColour[3]) * v_diffuseFactor;
+					v_diffuseColour_x = t87;
+					v_diffuseColour_y = t88;
+					v_diffuseColour_z = t89;
+					v_diffuseColour_w = t90;
+					const Float t91 = Float(constants.b1.lightColour[0]) * v_specularFactor;
+					const Float t92 = Float(constants.b1.lightColour[1]) * v_specularFactor;
+					const Float t93 = Float(constants.b1.lightColour[2]) * v_specularFactor;
+					const Float t94 = Float(constants.b1.lightColour[3]) * v_specularFactor;
+					v_specularColour_x = t91;
+					v_specularColour_y = t92;
+					v_specularColour_z = t93;
+					v_specularColour_w = t94;
+					const Float t95 = v_diffuseColour_x * v_materialDiffuse_x;
+					const Float t96 = v_diffuseColour_y * v_materialDiffuse_y;
+					const Float t97 = v_diffuseColour_z * v_materialDiffuse_z;
+					const Float t98 = v_diffuseColour_w * v_materialDiffuse_w;
+					const Float t99 = v_ambientColour_x + t95;
+					const Float t100 = v_ambientColour_y + t96;
+					const Float t101 = v_ambientColour_z + t97;
+					const Float t102 = v_ambientColour_w + t98;
+					const Float t103 = v_specularColour_x * v_materialSpecular_x;
+					const Float t104 = v_specularColour_y * v_materialSpecular_y;
+					const Float t105 = v_specularColour_z * v_materialSpecular_z;
+					const Float t106 = v_specularColour_w * v_materialSpecular_w;
+					const Float t107 = t99 + t103;
+					const Float t108 = t100 + t104;
+					const Float t109 = t101 + t105;
+					const Float t110 = t102 + t106;
+					const Float t111 = Saturate(t107);
+					const Float t112 = Saturate(t108);
+					const Float t113 = Saturate(t109);
+					const Float t114 = Saturate(t110);
+					v_finalColour_x = t111;
+					v_finalColour_y = t112;
+					v_finalColour_z = t113;
+					v_finalColour_w = t114;
+					Float v_fogColor_x = 1.0f;
+					Float v_fogColor_y = 1.0f;
+					Float v_fogColor_z = 1.0f;
+					Float v_fogColor_w = 1.0f;
+					Float v_fogStartDistance = 15.0f;
+					Float v_fogEndDistance = 1e+02f;
+					const Float t115 = v_input_posWorld_x * v_input_posWorld_x;
+					const Float t116 = v_input_posWorld_y * v_input_posWorld_y;
+					const Float t117 = v_input_posWorld_z * v_input_posWorld_z;
+					const Float t118 = v_input_posWorld_w * v_input_posWorld_w;
+					const Float t119 = t115 + t116;
+					const Float t120 = t119 + t117;
+					const Float t121 = t120 + t118;
+					const Float t122 = Sqrt(t121);
+					Float v_viewDistance = t122;
+					const Float t123 = v_viewDistance - v_fogStartDistance;
+					const Float t124 = v_fogEndDistance - v_fogStartDistance;
+					const Float t125 = t123 / t124;
+					const Float t126 = Saturate(t125);
+					Float v_fogFactor = t126;
+					const Float t127 = v_finalColour_x * v_texColour_x;
+					const Float t128 = v_finalColour_y * v_texColour_y;
+					const Float t129 = v_finalColour_z * v_texColour_z;
+					const Float t130 = v_finalColour_w * v_texColour_w;
+					const Float t131 = Saturate(t127);
+					const Float t132 = Saturate(t128);
+					const Float t133 = Saturate(t129);
+					const Float t134 = Saturate(t130);
+					v_finalColour_x = t131;
+					v_finalColour_y = t132;
+					v_finalColour_z = t133;
+					v_finalColour_w = t134;
+					const Float t135 = v_fogColor_x - v_finalColour_x;
+					const Float t136 = t135 * v_fogFactor;
+					const Float t137 = v_finalColour_x + t136;
+					const Float t138 = v_fogColor_y - v_finalColour_y;
+					const Float t139 = t138 * v_fogFactor;
+					const Float t140 = v_finalColour_y + t139;
+					const Float t141 = v_fogColor_z - v_finalColour_z;
+					const Float t142 = t141 * v_fogFactor;
+					const Float t143 = v_finalColour_z + t142;
+					const Float t144 = v_fogColor_w - v_finalColour_w;
+					const Float t145 = t144 * v_fogFactor;
+					const Float t146 = v_finalColour_w + t145;
+					Float v_finalColor_x = t137;
+					Float v_finalColor_y = t140;
+					Float v_finalColor_z = t143;
+					Float v_finalColor_w = t146;
+					r_0 = v_finalColor_x;
+					r_1 = v_finalColor_y;
+					r_2 = v_finalColor_z;
+					r_3 = v_finalColor_w;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// BubblesPixel.hlsl, pixel shader.
+		namespace BubblesPixel
+		{
+			struct ModelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(ModelViewProjectionConstantBuffer) == 240, "ModelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				ModelViewProjectionConstantBuffer b0;
+			};
+
+			static const Element Inputs[] = { { "SV_POSITION", 0, 4 }, { "TEXCOORD0", 4, 2 } };
+			static const Element Outputs[] = { { "SV_TARGET", 0, 4 }, { "SV_DEPTH", 4, 1 } };
+
+			static const float s_spheres_centre_x[3] = { 2.0f, 0.0f, -2.5f };
+			static const float s_spheres_diffuse[3] = { 0.3f, 0.5f, 0.5f };
+			static const float s_spheres_specular[3] = { 0.5f, 0.7f, 0.3f };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					g_output_colour_x = 0.0f;
+					g_output_colour_y = 0.0f;
+					g_output_colour_z = 0.0f;
+					g_output_colour_w = 0.0f;
+					g_output_depth = 0.0f;
+					f_main(active, input[0], input[1], input[2], input[3], input[4], input[5], output[0], output[1], output[2], output[3], output[4]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_SphereIntersect(const Mask& entry, const Float& v_sphere_centre_x, const Float& v_sphere_centre_y, const Float& v_sphere_centre_z, const Float& v_sphere_radiusSqrd, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float& v_ray_origin_x, const Float& v_ray_origin_y, const Float& v_ray_origin_z, const Float& v_ray_direction_x, const Float& v_ray_direction_y, const Float& v_ray_direction_z, Mask& v_hit, Float& r_0)
+				{
+					Mask mask = entry;
+					Mask live = entry;
+
+					const Float t0 = v_sphere_centre_x - v_ray_origin_x;
+					const Float t1 = v_sphere_centre_y - v_ray_origin_y;
+					const Float t2 = v_sphere_centre_z - v_ray_origin_z;
+					Float v_viewDir_x = t0;
+					Float v_viewDir_y = t1;
+					Float v_viewDir_z = t2;
+					const Float t3 = v_viewDir_x * v_ray_direction_x;
+					const Float t4 = v_viewDir_y * v_ray_direction_y;
+					const Float t5 = v_viewDir_z * v_ray_direction_z;
+					const Float t6 = t3 + t4;
+					const Float t7 = t6 + t5;
+					Float v_A = t7;
+					const Float t8 = v_viewDir_x * v_viewDir_x;
+					const Float t9 = v_viewDir_y * v_viewDir_y;
+					const Float t10 = v_viewDir_z * v_viewDir_z;
+					const Float t11 = t8 + t9;
+					const Float t12 = t11 + t10;
+					const Float t13 = v_A * v_A;
+					const Float t14 = t12 - t13;
+					Float v_B = t14;
+					const Float t15 = Sqrt(v_sphere_radiusSqrd);
+					Float v_radius = t15;
+					const Float t16 = v_radius * v_radius;
+					const Float t17 = t16 - v_B;
+					Float v_disc = t17;
+					const Mask t18 = v_disc < 0.0f;
+					{
+						const Mask outer1 = mask;
+						const Mask cond1 = t18;
+						mask = outer1 & cond1;
+						if (Any(mask))
+						{
+							v_hit = Select(mask, Mask::None(), v_hit);
+							r_0 = Select(mask, 1e+03f, r_0);
+							live = AndNot(live, mask);
+							mask = Mask::None();
+						}
+						mask = outer1 & live;
+					}
+					const Float t19 = Sqrt(v_disc);
+					Float v_discSqrt = t19;
+					const Float t20 = v_A - v_discSqrt;
+					Float v_time = t20;
+					const Mask t21 = v_time >= 0.0f;
+					v_hit = Select(mask, t21, v_hit);
+					const Float t22 = Select(v_hit, v_time, 1e+03f);
+					r_0 = Select(mask, t22, r_0);
+				}
+
+				void f_NearestHit(const Mask& entry, const Float& v_ray_origin_x, const Float& v_ray_origin_y, const Float& v_ray_origin_z, const Float& v_ray_direction_x, const Float& v_ray_direction_y, const Float& v_ray_direction_z, Float& v_hitObj, Mask& v_anyHit, Float& r_0, Float& r_1, Float& r_2)
+				{
+					Mask mask = entry;
+
+					Float v_minTime = 1e+03f;
+					v_hitObj = Select(mask, -1.0f, v_hitObj);
+					v_anyHit = Select(mask, Mask::None(), v_anyHit);
+					{
+						Float v_i = 0.0f;
+						const Mask outer1 = mask;
+						Mask loop1 = outer1;
+						for (;;)
+						{
+							mask = loop1;
+							const Mask t0 = v_i < 3.0f;
+							loop1 = loop1 & t0;
+							mask = loop1;
+							if (!Any(mask))
+								break;
+							{
+								Mask v_hit = Mask::None();
+								const Float t1 = Gather(s_spheres_centre_x, 1, 3, v_i);
+								const Float t2 = Gather(s_spheres_diffuse, 1, 3, v_i);
+								const Float t3 = Gather(s_spheres_specular, 1, 3, v_i);
+								Float t4 = 0.0f;
+								f_SphereIntersect(mask, t1, -5.0f, 0.0f, 0.01f, 1.0f, 1.0f, 1.0f, 1.0f, t2, t3, 0.7f, 6e+01f, v_ray_origin_x, v_ray_origin_y, v_ray_origin_z, v_ray_direction_x, v_ray_direction_y, v_ray_direction_z, v_hit, t4);
+								Float v_time = t4;
+								const Mask t5 = v_time < v_minTime;
+								const Mask t6 = v_hit & t5;
+								{
+									const Mask outer2 = mask;
+									const Mask cond2 = t6;
+									mask = outer2 & cond2;
+									if (Any(mask))
+									{
+										v_hitObj = Select(mask, v_i, v_hitObj);
+										v_minTime = Select(mask, v_time, v_minTime);
+										v_anyHit = Select(mask, Mask::All(), v_anyHit);
+									}
+									mask = outer2;
+								}
+							}
+							const Float t7 = v_i;
+							const Float t8 = t7 + 1.0f;
+							v_i = Select(mask, t8, v_i);
+						}
+						mask = outer1;
+					}
+					const Float t9 = v_ray_direction_x * v_minTime;
+					const Float t10 = v_ray_direction_y * v_minTime;
+					const Float t11 = v_ray_direction_z * v_minTime;
+					const Float t12 = v_ray_origin_x + t9;
+					const Float t13 = v_ray_origin_y + t10;
+					const Float t14 = v_ray_origin_z + t11;
+					const Float t15 = Select(v_anyHit, t12, v_ray_origin_x);
+					const Float t16 = Select(v_anyHit, t13, v_ray_origin_y);
+					const Float t17 = Select(v_anyHit, t14, v_ray_origin_z);
+					r_0 = t15;
+					r_1 = t16;
+					r_2 = t17;
+				}
+
+				void f_SphereNormal(const Mask&, const Float& v_sphere_centre_x, const Float& v_sphere_centre_y, const Float& v_sphere_centre_z, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float&, const Float& v_pos_x, const Float& v_pos_y, const Float& v_pos_z, Float& r_0, Float& r_1, Float& r_2)
+				{
+					const Float t0 = v_pos_x - v_sphere_centre_x;
+					const Float t1 = v_pos_y - v_sphere_centre_y;
+					const Float t2 = v_pos_z - v_sphere_centre_z;
+					const Float t3 = t0 * t0;
+					const Float t4 = t1 * t1;
+					const Float t5 = t2 * t2;
+					const Float t6 = t3 + t4;
+					const Float t7 = t6 + t5;
+					const Float t8 = Sqrt(t7);
+					const Float t9 = t0 / t8;
+					const Float t10 = t1 / t8;
+					const Float t11 = t2 / t8;
+					r_0 = t9;
+					r_1 = t10;
+					r_2 = t11;
+				}
+
+				void f_Shadow(const Mask& entry, const Float& v_ray_origin_x, const Float& v_ray_origin_y, const Float& v_ray_origin_z, const Float& v_ray_direction_x, const Float& v_ray_direction_y, const Float& v_ray_direction_z, Mask& r_0)
+				{
+					Mask mask = entry;
+					Mask live = entry;
+
+					{
+						Float v_i = 0.0f;
+						const Mask outer1 = mask;
+						Mask loop1 = outer1;
+						for (;;)
+						{
+							loop1 = loop1 & live;
+							mask = loop1;
+							const Mask t0 = v_i < 3.0f;
+							loop1 = loop1 & t0;
+							mask = loop1;
+							if (!Any(mask))
+								break;
+							{
+								Mask v_hit = Mask::None();
+								const Float t1 = Gather(s_spheres_centre_x, 1, 3, v_i);
+								const Float t2 = Gather(s_spheres_diffuse, 1, 3, v_i);
+								const Float t3 = Gather(s_spheres_specular, 1, 3, v_i);
+								Float t4 = 0.0f;
+								f_SphereIntersect(mask, t1, -5.0f, 0.0f, 0.01f, 1.0f, 1.0f, 1.0f, 1.0f, t2, t3, 0.7f, 6e+01f, v_ray_origin_x, v_ray_origin_y, v_ray_origin_z, v_ray_direction_x, v_ray_direction_y, v_ray_direction_z, v_hit, t4);
+								{
+									const Mask outer2 = mask;
+									const Mask cond2 = v_hit;
+									mask = outer2 & cond2;
+									if (Any(mask))
+									{
+										r_0 = Select(mask, Mask::All(), r_0);
+										live = AndNot(live, mask);
+										mask = Mask::None();
+									}
+									mask = outer2 & live;
+								}
+							}
+							mask = loop1 & live;
+							const Float t5 = v_i;
+							const Float t6 = t5 + 1.0f;
+							v_i = Select(mask, t6, v_i);
+						}
+						mask = outer1 & live;
+					}
+					r_0 = Select(mask, Mask::None(), r_0);
+				}
+
+				void f_Phong(const Mask&, const Float& v_normal_x, const Float& v_normal_y, const Float& v_normal_z, const Float& v_lightDir_x, const Float& v_lightDir_y, const Float& v_lightDir_z, const Float& v_viewDir_x, const Float& v_viewDir_y, const Float& v_viewDir_z, const Float& v_shininess, const Float& v_diffuseColour_x, const Float& v_diffuseColour_y, const Float& v_diffuseColour_z, const Float& v_diffuseColour_w, const Float& v_specularColour_x, const Float& v_specularColour_y, const Float& v_specularColour_z, const Float& v_specularColour_w, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					const Float t0 = v_normal_x * v_lightDir_x;
+					const Float t1 = v_normal_y * v_lightDir_y;
+					const Float t2 = v_normal_z * v_lightDir_z;
+					const Float t3 = t0 + t1;
+					const Float t4 = t3 + t2;
+					Float v_NormalDotLightDir = t4;
+					const Float t5 = Saturate(v_NormalDotLightDir);
+					Float v_diffuse = t5;
+					const Float t6 = v_normal_x * v_lightDir_x;
+					const Float t7 = v_normal_y * v_lightDir_y;
+					const Float t8 = v_normal_z * v_lightDir_z;
+					const Float t9 = t6 + t7;
+					const Float t10 = t9 + t8;
+					const Float t11 = 2.0f * t10;
+					const Float t12 = t11 * v_normal_x;
+					const Float t13 = v_lightDir_x - t12;
+					const Float t14 = t11 * v_normal_y;
+					const Float t15 = v_lightDir_y - t14;
+					const Float t16 = t11 * v_normal_z;
+					const Float t17 = v_lightDir_z - t16;
+					Float v_reflection_x = t13;
+					Float v_reflection_y = t15;
+					Float v_reflection_z = t17;
+					const Float t18 = v_viewDir_x * v_reflection_x;
+					const Float t19 = v_viewDir_y * v_reflection_y;
+					const Float t20 = v_viewDir_z * v_reflection_z;
+					const Float t21 = t18 + t19;
+					const Float t22 = t21 + t20;
+					const Float t23 = Saturate(t22);
+					const Float t24 = Pow(t23, v_shininess);
+					const Mask t25 = v_NormalDotLightDir > 0.0f;
+					const Float t26 = ToFloat(t25);
+					const Float t27 = t24 * t26;
+					Float v_specular = t27;
+					const Float t28 = v_diffuse * v_diffuseColour_x;
+					const Float t29 = v_diffuse * v_diffuseColour_y;
+					const Float t30 = v_diffuse * v_diffuseColour_z;
+					const Float t31 = v_diffuse * v_diffuseColour_w;
+					const Float t32 = v_specular * v_specularColour_x;
+					const Float t33 = v_specular * v_specularColour_y;
+					const Float t34 = v_specular * v_specularColour_z;
+					const Float t35 = v_specular * v_specularColour_w;
+					const Float t36 = t28 + t32;
+					const Float t37 = t29 + t33;
+					const Float t38 = t30 + t34;
+					const Float t39 = t31 + t35;
+					r_0 = t36;
+					r_1 = t37;
+					r_2 = t38;
+					r_3 = t39;
+				}
+
+				void f_Shade(const Mask& entry, const Float& v_hitPos_x, const Float& v_hitPos_y, const Float& v_hitPos_z, const Float& v_normal_x, const Float& v_normal_y, const Float& v_normal_z, const Float& v_viewDir_x, const Float& v_viewDir_y, const Float& v_viewDir_z, const Float& v_hitObj, const Float& v_lightIntensity, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					Mask mask = entry;
+
+					const Float t0 = -1e+01f - v_hitPos_x;
+					const Float t1 = 1e+02f - v_hitPos_y;
+					const Float t2 = -1e+01f - v_hitPos_z;
+					const Float t3 = t0 * t0;
+					const Float t4 = t1 * t1;
+					const Float t5 = t2 * t2;
+					const Float t6 = t3 + t4;
+					const Float t7 = t6 + t5;
+					const Float t8 = Sqrt(t7);
+					const Float t9 = t0 / t8;
+					const Float t10 = t1 / t8;
+					const Float t11 = t2 / t8;
+					Float v_lightDir_x = t9;
+					Float v_lightDir_y = t10;
+					Float v_lightDir_z = t11;
+					const Float t12 = Gather(s_spheres_diffuse, 1, 3, v_hitObj);
+					const Float t13 = 1.0f * t12;
+					const Float t14 = 1.0f * t12;
+					const Float t15 = 1.0f * t12;
+					const Float t16 = 1.0f * t12;
+					Float v_diffuse_x = t13;
+					Float v_diffuse_y = t14;
+					Float v_diffuse_z = t15;
+					Float v_diffuse_w = t16;
+					const Float t17 = Gather(s_spheres_specular, 1, 3, v_hitObj);
+					const Float t18 = 1.0f * t17;
+					const Float t19 = 1.0f * t17;
+					const Float t20 = 1.0f * t17;
+					const Float t21 = 1.0f * t17;
+					Float v_specular_x = t18;
+					Float v_specular_y = t19;
+					Float v_specular_z = t20;
+					Float v_specular_w = t21;
+					Float v_shadowRay_origin_x = 0.0f;
+					Float v_shadowRay_origin_y = 0.0f;
+					Float v_shadowRay_origin_z = 0.0f;
+					Float v_shadowRay_direction_x = 0.0f;
+					Float v_shadowRay_direction_y = 0.0f;
+					Float v_shadowRay_direction_z = 0.0f;
+					v_shadowRay_origin_x = v_hitPos_x;
+					v_shadowRay_origin_y = v_hitPos_y;
+					v_shadowRay_origin_z = v_hitPos_z;
+					v_shadowRay_direction_x = v_lightDir_x;
+					v_shadowRay_direction_y = v_lightDir_y;
+					v_shadowRay_direction_z = v_lightDir_z;
+					Mask t22 = Mask::None();
+					f_Shadow(mask, v_shadowRay_origin_x, v_shadowRay_origin_y, v_shadowRay_origin_z, v_shadowRay_direction_x, v_shadowRay_direction_y, v_shadowRay_direction_z, t22);
+					Mask v_isShadowed = t22;
+					const Mask t23 = !v_isShadowed;
+					const Float t24 = ToFloat(t23);
+					const Float t25 = ToFloat(t23);
+					const Float t26 = ToFloat(t23);
+					const Float t27 = ToFloat(t23);
+					const Float t28 = t24 * 0.2f;
+					const Float t29 = t25 * 0.4f;
+					const Float t30 = t26 * 0.7f;
+					const Float t31 = t27 * 1.0f;
+					const Float t32 = t28 * v_lightIntensity;
+					const Float t33 = t29 * v_lightIntensity;
+					const Float t34 = t30 * v_lightIntensity;
+					const Float t35 = t31 * v_lightIntensity;
+					Float t36 = 0.0f;
+					Float t37 = 0.0f;
+					Float t38 = 0.0f;
+					Float t39 = 0.0f;
+					f_Phong(mask, v_normal_x, v_normal_y, v_normal_z, v_lightDir_x, v_lightDir_y, v_lightDir_z, v_viewDir_x, v_viewDir_y, v_viewDir_z, 6e+01f, v_diffuse_x, v_diffuse_y, v_diffuse_z, v_diffuse_w, v_specular_x, v_specular_y, v_specular_z, v_specular_w, t36, t37, t38, t39);
+					const Float t40 = t32 * t36;
+					const Float t41 = t33 * t37;
+					const Float t42 = t34 * t38;
+					const Float t43 = t35 * t39;
+					r_0 = t40;
+					r_1 = t41;
+					r_2 = t42;
+					r_3 = t43;
+				}
+
+				void f_RayTracing(const Mask& entry, const Float& a_ray_origin_x, const Float& a_ray_origin_y, const Float& a_ray_origin_z, const Float& a_ray_direction_x, const Float& a_ray_direction_y, const Float& a_ray_direction_z, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					Float v_ray_origin_x = a_ray_origin_x;
+					Float v_ray_origin_y = a_ray_origin_y;
+					Float v_ray_origin_z = a_ray_origin_z;
+					Float v_ray_direction_x = a_ray_direction_x;
+					Float v_ray_direction_y = a_ray_direction_y;
+					Float v_ray_direction_z = a_ray_direction_z;
+					Mask mask = entry;
+					Mask live = entry;
+
+					Float v_hitObj = 0.0f;
+					Mask v_hit = Mask::None();
+					Float v_normal_x = 0.0f;
+					Float v_normal_y = 0.0f;
+					Float v_normal_z = 0.0f;
+					Float v_colour_x = 0.0f;
+					Float v_colour_y = 0.0f;
+					Float v_colour_z = 0.0f;
+					Float v_colour_w = 0.0f;
+					Float v_lightIntensity = 1.0f;
+					Float t0 = 0.0f;
+					Float t1 = 0.0f;
+					Float t2 = 0.0f;
+					f_NearestHit(mask, v_ray_origin_x, v_ray_origin_y, v_ray_origin_z, v_ray_direction_x, v_ray_direction_y, v_ray_direction_z, v_hitObj, v_hit, t0, t1, t2);
+					Float v_nearestHit_x = t0;
+					Float v_nearestHit_y = t1;
+					Float v_nearestHit_z = t2;
+					{
+						const Mask outer1 = mask;
+						const Mask cond1 = v_hit;
+						mask = outer1 & cond1;
+						if (Any(mask))
+						{
+							const Float t3 = v_nearestHit_x * Float(constants.b0.view[0][0]);
+							const Float t4 = v_nearestHit_y * Float(constants.b0.view[0][1]);
+							const Float t5 = v_nearestHit_z * Float(constants.b0.view[0][2]);
+							const Float t6 = 1.0f * Float(constants.b0.view[0][3]);
+							const Float t7 = t3 + t4;
+							const Float t8 = t7 + t5;
+							const Float t9 = t8 + t6;
+							const Float t10 = v_nearestHit_x * Float(constants.b0.view[1][0]);
+							const Float t11 = v_nearestHit_y * Float(constants.b0.view[1][1]);
+							const Float t12 = v_nearestHit_z * Float(constants.b0.view[1][2]);
+							const Float t13 = 1.0f * Float(constants.b0.view[1][3]);
+							const Float t14 = t10 + t11;
+							const Float t15 = t14 + t12;
+							const Float t16 = t15 + t13;
+							const Float t17 = v_nearestHit_x * Float(constants.b0.view[2][0]);
+							const Float t18 = v_nearestHit_y * Float(constants.b0.view[2][1]);
+							const Float t19 = v_nearestHit_z * Float(constants.b0.view[2][2]);
+							const Float t20 = 1.0f * Float(constants.b0.view[2][3]);
+							const Float t21 = t17 + t18;
+							const Float t22 = t21 + t19;
+							const Float t23 = t22 + t20;
+							const Float t24 = v_nearestHit_x * Float(constants.b0.view[3][0]);
+							const Float t25 = v_nearestHit_y * Float(constants.b0.view[3][1]);
+							const Float t26 = v_nearestHit_z * Float(constants.b0.view[3][2]);
+							const Float t27 = 1.0f * Float(constants.b0.view[3][3]);
+							const Float t28 = t24 + t25;
+							const Float t29 = t28 + t26;
+							const Float t30 = t29 + t27;
+							const Float t45 = t9 * Float(constants.b0.projection[2][0]);
+							const Float t46 = t16 * Float(constants.b0.projection[2][1]);
+							const Float t47 = t23 * Float(constants.b0.projection[2][2]);
+							const Float t48 = t30 * Float(constants.b0.projection[2][3]);
+							const Float t49 = t45 + t46;
+							const Float t50 = t49 + t47;
+							const Float t51 = t50 + t48;
+							const Float t52 = t9 * Float(constants.b0.projection[3][0]);
+							const Float t53 = t16 * Float(constants.b0.projection[3][1]);
+							const Float t54 = t23 * Float(constants.b0.projection[3][2]);
+							const Float t55 = t30 * Float(constants.b0.projection[3][3]);
+							const Float t56 = t52 + t53;
+							const Float t57 = t56 + t54;
+							const Float t58 = t57 + t55;
+							Float v_depthPos_z = t51;
+							Float v_depthPos_w = t58;
+							const Float t59 = v_depthPos_z / v_depthPos_w;
+							g_output_depth = Select(mask, t59, g_output_depth);
+						}
+						mask = AndNot(outer1, cond1);
+						if (Any(mask))
+						{
+							discarded = discarded | mask;
+							live = AndNot(live, mask);
+							mask = Mask::None();
+						}
+						mask = outer1 & live;
+					}
+					{
+						Float v_depth = 1.0f;
+						const Mask outer2 = mask;
+						Mask loop2 = outer2;
+						for (;;)
+						{
+							mask = loop2;
+							const Mask t60 = v_depth < 5.0f;
+							loop2 = loop2 & t60;
+							mask = loop2;
+							if (!Any(mask))
+								break;
+							{
+								{
+									const Mask outer3 = mask;
+									const Mask cond3 = v_hit;
+									mask = outer3 & cond3;
+									if (Any(mask))
+									{
+										const Float t61 = Gather(s_spheres_centre_x, 1, 3, v_hitObj);
+										const Float t62 = Gather(s_spheres_diffuse, 1, 3, v_hitObj);
+										const Float t63 = Gather(s_spheres_specular, 1, 3, v_hitObj);
+										Float t64 = 0.0f;
+										Float t65 = 0.0f;
+										Float t66 = 0.0f;
+										f_SphereNormal(mask, t61, -5.0f, 0.0f, 0.01f, 1.0f, 1.0f, 1.0f, 1.0f, t62, t63, 0.7f, 6e+01f, v_nearestHit_x, v_nearestHit_y, v_nearestHit_z, t64, t65, t66);
+										v_normal_x = Select(mask, t64, v_normal_x);
+										v_normal_y = Select(mask, t65, v_normal_y);
+										v_normal_z = Select(mask, t66, v_normal_z);
+										Float t67 = 0.0f;
+										Float t68 = 0.0f;
+										Float t69 = 0.0f;
+										Float t70 = 0.0f;
+										f_Shade(mask, v_nearestHit_x, v_nearestHit_y, v_nearestHit_z, v_normal_x, v_normal_y, v_normal_z, v_ray_direction_x, v_ray_direction_y, v_ray_direction_z, v_hitObj, v_lightIntensity, t67, t68, t69, t70);
+										const Float t71 = v_colour_x + t67;
+										const Float t72 = v_colour_y + t68;
+										const Float t73 = v_colour_z + t69;
+										const Float t74 = v_colour_w + t70;
+										v_colour_x = Select(mask, t71, v_colour_x);
+										v_colour_y = Select(mask, t72, v_colour_y);
+										v_colour_z = Select(mask, t73, v_colour_z);
+										v_colour_w = Select(mask, t74, v_colour_w);
+										const Float t75 = v_lightIntensity * 0.7f;
+										v_lightIntensity = Select(mask, t75, v_lightIntensity);
+										v_ray_origin_x = Select(mask, v_nearestHit_x, v_ray_origin_x);
+										v_ray_origin_y = Select(mask, v_nearestHit_y, v_ray_origin_y);
+										v_ray_origin_z = Select(mask, v_nearestHit_z, v_ray_origin_z);
+										const Float t76 = v_normal_x * v_ray_direction_x;
+										const Float t77 = v_normal_y * v_ray_direction_y;
+										const Float t78 = v_normal_z * v_ray_direction_z;
+										const Float t79 = t76 + t77;
+										const Float t80 = t79 + t78;
+										const Float t81 = 2.0f * t80;
+										const Float t82 = t81 * v_normal_x;
+										const Float t83 = v_ray_direction_x - t82;
+										const Float t84 = t81 * v_normal_y;
+										const Float t85 = v_ray_direction_y - t84;
+										const Float t86 = t81 * v_normal_z;
+										const Float t87 = v_ray_direction_z - t86;
+										v_ray_direction_x = Select(mask, t83, v_ray_direction_x);
+										v_ray_direction_y = Select(mask, t85, v_ray_direction_y);
+										v_ray_direction_z = Select(mask, t87, v_ray_direction_z);
+										Float t88 = 0.0f;
+										Float t89 = 0.0f;
+										Float t90 = 0.0f;
+										f_NearestHit(mask, v_ray_origin_x, v_ray_origin_y, v_ray_origin_z, v_ray_direction_x, v_ray_direction_y, v_ray_direction_z, v_hitObj, v_hit, t88, t89, t90);
+										v_nearestHit_x = Select(mask, t88, v_nearestHit_x);
+										v_nearestHit_y = Select(mask, t89, v_nearestHit_y);
+										v_nearestHit_z = Select(mask, t90, v_nearestHit_z);
+									}
+									mask = AndNot(outer3, cond3);
+									if (Any(mask))
+									{
+										const Float t91 = 0.1f / v_depth;
+										const Float t92 = 0.1f / v_depth;
+										const Float t93 = 0.1f / v_depth;
+										const Float t94 = 1.0f / v_depth;
+										const Float t95 = t91 / v_depth;
+										const Float t96 = t92 / v_depth;
+										const Float t97 = t93 / v_depth;
+										const Float t98 = t94 / v_depth;
+										const Float t99 = v_colour_x + t95;
+										const Float t100 = v_colour_y + t96;
+										const Float t101 = v_colour_z + t97;
+										const Float t102 = v_colour_w + t98;
+										v_colour_x = Select(mask, t99, v_colour_x);
+										v_colour_y = Select(mask, t100, v_colour_y);
+										v_colour_z = Select(mask, t101, v_colour_z);
+										v_colour_w = Select(mask, t102, v_colour_w);
+									}
+									mask = outer3;
+								}
+							}
+							const Float t103 = v_depth;
+							const Float t104 = t103 + 1.0f;
+							v_depth = Select(mask, t104, v_depth);
+						}
+						mask = outer2;
+					}
+					r_0 = v_colour_x;
+					r_1 = v_colour_y;
+					r_2 = v_colour_z;
+					r_3 = v_colour_w;
+				}
+
+				void f_main(const Mask& entry, const Float&, const Float&, const Float&, const Float&, const Float& v_input_canvasXY_x, const Float& v_input_canvasXY_y, Float& r_0, Float& r_1, Float& r_2, Float& r_3, Float& r_4)
+				{
+					Mask mask = entry;
+					Mask live = entry;
+
+					Float v_zoom = 5.0f;
+					const Float t0 = v_zoom * v_input_canvasXY_x;
+					const Float t1 = v_zoom * v_input_canvasXY_y;
+					Float v_xy_x = t0;
+					Float v_xy_y = t1;
+					Float v_distEyeToCanvas = 1.0f;
+					Float v_pixelPos_x = v_xy_x;
+					Float v_pixelPos_y = v_xy_y;
+					Float v_pixelPos_z = v_distEyeToCanvas;
+					const Float t2 = Float(constants.b0.eye[0]) - Float(constants.b0.lookAt[0]);
+					const Float t3 = Float(constants.b0.eye[1]) - Float(constants.b0.lookAt[1]);
+					const Float t4 = Float(constants.b0.eye[2]) - Float(constants.b0.lookAt[2]);
+					const Float t5 = t2 * t2;
+					const Float t6 = t3 * t3;
+					const Float t7 = t4 * t4;
+					const Float t8 = t5 + t6;
+					const Float t9 = t8 + t7;
+					const Float t10 = Sqrt(t9);
+					const Float t11 = t2 / t10;
+					const Float t12 = t3 / t10;
+					const Float t13 = t4 / t10;
+					Float v_viewDir_x = t11;
+					Float v_viewDir_y = t12;
+					Float v_viewDir_z = t13;
+					const Float t14 = Float(constants.b0.upDir[1]) * v_viewDir_z;
+					const Float t15 = Float(constants.b0.upDir[2]) * v_viewDir_y;
+					const Float t16 = t14 - t15;
+					const Float t17 = Float(constants.b0.upDir[2]) * v_viewDir_x;
+					const Float t18 = Float(constants.b0.upDir[0]) * v_viewDir_z;
+					const Float t19 = t17 - t18;
+					const Float t20 = Float(constants.b0.upDir[0]) * v_viewDir_y;
+					const Float t21 = Float(constants.b0.upDir[1]) * v_viewDir_x;
+					const Float t22 = t20 - t21;
+					Float v_viewLeft_x = t16;
+					Float v_viewLeft_y = t19;
+					Float v_viewLeft_z = t22;
+					const Float t23 = v_viewDir_y * v_viewLeft_z;
+					const Float t24 = v_viewDir_z * v_viewLeft_y;
+					const Float t25 = t23 - t24;
+					const Float t26 = v_viewDir_z * v_viewLeft_x;
+					const Float t27 = v_viewDir_x * v_viewLeft_z;
+					const Float t28 = t26 - t27;
+					const Float t29 = v_viewDir_x * v_viewLeft_y;
+					const Float t30 = v_viewDir_y * v_viewLeft_x;
+					const Float t31 = t29 - t30;
+					Float v_viewUp_x = t25;
+					Float v_viewUp_y = t28;
+					Float v_viewUp_z = t31;
+					const Float t32 = v_viewLeft_x * v_viewLeft_x;
+					const Float t33 = v_viewLeft_y * v_viewLeft_y;
+					const Float t34 = v_viewLeft_z * v_viewLeft_z;
+					const Float t35 = t32 + t33;
+					const Float t36 = t35 + t34;
+					const Float t37 = Sqrt(t36);
+					const Float t38 = v_viewLeft_x / t37;
+					const Float t39 = v_viewLeft_y / t37;
+					const Float t40 = v_viewLeft_z / t37;
+					v_viewLeft_x = t38;
+					v_viewLeft_y = t39;
+					v_viewLeft_z = t40;
+					const Float t41 = v_viewUp_x * v_viewUp_x;
+					const Float t42 = v_viewUp_y * v_viewUp_y;
+					const Float t43 = v_viewUp_z * v_viewUp_z;
+					const Float t44 = t41 + t42;
+					const Float t45 = t44 + t43;
+					const Float t46 = Sqrt(t45);
+					const Float t47 = v_viewUp_x / t46;
+					const Float t48 = v_viewUp_y / t46;
+					const Float t49 = v_viewUp_z / t46;
+					v_viewUp_x = t47;
+					v_viewUp_y = t48;
+					v_viewUp_z = t49;
+					const Float t50 = v_pixelPos_x * v_viewLeft_x;
+					const Float t51 = v_pixelPos_x * v_viewLeft_y;
+					const Float t52 = v_pixelPos_x * v_viewLeft_z;
+					const Float t53 = v_pixelPos_y * v_viewUp_x;
+					const Float t54 = v_pixelPos_y * v_viewUp_y;
+					const Float t55 = v_pixelPos_y * v_viewUp_z;
+					const Float t56 = t50 + t53;
+					const Float t57 = t51 + t54;
+					const Float t58 = t52 + t55;
+					const Float t59 = v_pixelPos_z * v_viewDir_x;
+					const Float t60 = v_pixelPos_z * v_viewDir_y;
+					const Float t61 = v_pixelPos_z * v_viewDir_z;
+					const Float t62 = t56 + t59;
+					const Float t63 = t57 + t60;
+					const Float t64 = t58 + t61;
+					Float v_pixelWorld_x = t62;
+					Float v_pixelWorld_y = t63;
+					Float v_pixelWorld_z = t64;
+					Float v_eyeRay_origin_x = 0.0f;
+					Float v_eyeRay_origin_y = 0.0f;
+					Float v_eyeRay_origin_z = 0.0f;
+					Float v_eyeRay_direction_x = 0.0f;
+					Float v_eyeRay_direction_y = 0.0f;
+					Float v_eyeRay_direction_z = 0.0f;
+					v_eyeRay_origin_x = Float(constants.b0.eye[0]);
+					v_eyeRay_origin_y = Float(constants.b0.eye[1]);
+					v_eyeRay_origin_z = Float(constants.b0.eye[2]);
+					const Float t65 = v_pixelWorld_x - Float(constants.b0.eye[0]);
+					const Float t66 = v_pixelWorld_y - Float(constants.b0.eye[1]);
+					const Float t67 = v_pixelWorld_z - Float(constants.b0.eye[2]);
+					const Float t68 = t65 * t65;
+					const Float t69 = t66 * t66;
+					const Float t70 = t67 * t67;
+					const Float t71 = t68 + t69;
+					const Float t72 = t71 + t70;
+					const Float t73 = Sqrt(t72);
+					const Float t74 = t65 / t73;
+					const Float t75 = t66 / t73;
+					const Float t76 = t67 / t73;
+					v_eyeRay_direction_x = t74;
+					v_eyeRay_direction_y = t75;
+					v_eyeRay_direction_z = t76;
+					Float t77 = 0.0f;
+					Float t78 = 0.0f;
+					Float t79 = 0.0f;
+					Float t80 = 0.0f;
+					f_RayTracing(mask, v_eyeRay_origin_x, v_eyeRay_origin_y, v_eyeRay_origin_z, v_eyeRay_direction_x, v_eyeRay_direction_y, v_eyeRay_direction_z, t77, t78, t79, t80);
+					live = AndNot(live, discarded);
+					mask = AndNot(mask, discarded);
+					g_output_colour_x = Select(mask, t77, g_output_colour_x);
+					g_output_colour_y = Select(mask, t78, g_output_colour_y);
+					g_output_colour_z = Select(mask, t79, g_output_colour_z);
+					g_output_colour_w = Select(mask, t80, g_output_colour_w);
+					r_0 = g_output_colour_x;
+					r_1 = g_output_colour_y;
+					r_2 = g_output_colour_z;
+					r_3 = g_output_colour_w;
+					r_4 = g_output_depth;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+				Float g_output_colour_x;
+				Float g_output_colour_y;
+				Float g_output_colour_z;
+				Float g_output_colour_w;
+				Float g_output_depth;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// BubblesVertex.hlsl, vertex shader.
+		namespace BubblesVertex
+		{
+			struct ModelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+			};
+
+			static_assert(sizeof(ModelViewProjectionConstantBuffer) == 208, "ModelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct timeConstantBuffer
+			{
+				float time;
+				float padding[3];
+			};
+
+			static_assert(sizeof(timeConstantBuffer) == 16, "timeConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				ModelViewProjectionConstantBuffer b0;
+				timeConstantBuffer b1;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 4 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 }, { "TEXCOORD0", 4, 2 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], output[0], output[1], output[2], output[3], output[4], output[5]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask&, const Float& v_vPos_x, const Float& v_vPos_y, const Float&, const Float&, Float& r_0, Float& r_1, Float& r_2, Float& r_3, Float& r_4, Float& r_5)
+				{
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					Float v_output_canvasXY_x = 0.0f;
+					Float v_output_canvasXY_y = 0.0f;
+					const Float t0 = Sign(v_vPos_x);
+					const Float t1 = Sign(v_vPos_y);
+					v_output_position_x = t0;
+					v_output_position_y = t1;
+					v_output_position_z = 0.0f;
+					v_output_position_w = 1.0f;
+					const Float t2 = Float(constants.b1.time) * 0.1f;
+					const Float t3 = v_output_position_y + t2;
+					v_output_position_y = t3;
+					const Float t4 = Float(constants.b0.projection[1][1]) / Float(constants.b0.projection[0][0]);
+					Float v_aspectRatio = t4;
+					const Float t5 = Sign(v_vPos_x);
+					const Float t6 = Sign(v_vPos_y);
+					const Float t7 = t5 * v_aspectRatio;
+					const Float t8 = t6 * 1.0f;
+					v_output_canvasXY_x = t7;
+					v_output_canvasXY_y = t8;
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+					r_4 = v_output_canvasXY_x;
+					r_5 = v_output_canvasXY_y;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// GeometryCoralVertex.hlsl, vertex shader.
+		namespace GeometryCoralVertex
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct timeConstantBuffer
+			{
+				float time;
+				float padding[3];
+			};
+
+			static_assert(sizeof(timeConstantBuffer) == 16, "timeConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+				timeConstantBuffer b1;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 3 }, { "SPECIES", 3, 1 }, { "SV_VertexID", 4, 1 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 }, { "TEXCOORD0", 4, 2 }, { "TEXCOORD1", 6, 1 } };
+
+			static const float s_QuadPos_x[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+			static const float s_QuadPos_y[4] = { 1.0f, -1.0f, 1.0f, -1.0f };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], input[4], output[0], output[1], output[2], output[3], output[4], output[5], output[6]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask& entry, const Float& v_input_pos_x, const Float& v_input_pos_y, const Float& v_input_pos_z, const Float& v_input_species, const Float& v_input_vertexID, Float& r_0, Float& r_1, Float& r_2, Float& r_3, Float& r_4, Float& r_5, Float& r_6)
+				{
+					Mask mask = entry;
+
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					Float v_output_uv_x = 0.0f;
+					Float v_output_uv_y = 0.0f;
+					Float v_output_species = 0.0f;
+					const Float t0 = Gather(s_QuadPos_x, 1, 4, v_input_vertexID);
+					const Float t1 = Gather(s_QuadPos_y, 1, 4, v_input_vertexID);
+					Float v_corner_x = t0;
+					Float v_corner_y = t1;
+					Float v_corner_z = 0.0f;
+					const Float t2 = v_input_pos_x * Float(constants.b0.view[0][0]);
+					const Float t3 = v_input_pos_y * Float(constants.b0.view[0][1]);
+					const Float t4 = v_input_pos_z * Float(constants.b0.view[0][2]);
+					const Float t5 = 1.0f * Float(constants.b0.view[0][3]);
+					const Float t6 = t2 + t3;
+					const Float t7 = t6 + t4;
+					const Float t8 = t7 + t5;
+					const Float t9 = v_input_pos_x * Float(constants.b0.view[1][0]);
+					const Float t10 = v_input_pos_y * Float(constants.b0.view[1][1]);
+					const Float t11 = v_input_pos_z * Float(constants.b0.view[1][2]);
+					const Float t12 = 1.0f * Float(constants.b0.view[1][3]);
+					const Float t13 = t9 + t10;
+					const Float t14 = t13 + t11;
+					const Float t15 = t14 + t12;
+					const Float t16 = v_input_pos_x * Float(constants.b0.view[2][0]);
+					const Float t17 = v_input_pos_y * Float(constants.b0.view[2][1]);
+					const Float t18 = v_input_pos_z * Float(constants.b0.view[2][2]);
+					const Float t19 = 1.0f * Float(constants.b0.view[2][3]);
+					const Float t20 = t16 + t17;
+					const Float t21 = t20 + t18;
+					const Float t22 = t21 + t19;
+					const Float t23 = v_input_pos_x * Float(constants.b0.view[3][0]);
+					const Float t24 = v_input_pos_y * Float(constants.b0.view[3][1]);
+					const Float t25 = v_input_pos_z * Float(constants.b0.view[3][2]);
+					const Float t26 = 1.0f * Float(constants.b0.view[3][3]);
+					const Float t27 = t23 + t24;
+					const Float t28 = t27 + t25;
+					const Float t29 = t28 + t26;
+					Float v_vPos_x = t8;
+					Float v_vPos_y = t15;
+					Float v_vPos_z = t22;
+					Float v_vPos_w = t29;
+					Float v_quadSize = 0.5f;
+					const Float t30 = v_quadSize * v_corner_x;
+					const Float t31 = v_quadSize * v_corner_y;
+					const Float t32 = v_quadSize * v_corner_z;
+					const Float t33 = v_vPos_x + t30;
+					const Float t34 = v_vPos_y + t31;
+					const Float t35 = v_vPos_z + t32;
+					const Float t36 = v_vPos_w + 0.0f;
+					v_output_position_x = t33;
+					v_output_position_y = t34;
+					v_output_position_z = t35;
+					v_output_position_w = t36;
+					const Mask t37 = v_corner_y > 0.0f;
+					{
+						const Mask outer1 = mask;
+						const Mask cond1 = t37;
+						mask = outer1 & cond1;
+						if (Any(mask))
+						{
+							const Float t38 = Sin(Float(constants.b1.time));
+							const Float t39 = t38 * 0.2f;
+							const Float t40 = v_output_position_z + t39;
+							v_output_position_z = Select(mask, t40, v_output_position_z);
+						}
+						mask = outer1;
+					}
+					const Float t41 = v_output_position_x * Float(constants.b0.projection[0][0]);
+					const Float t42 = v_output_position_y * Float(constants.b0.projection[0][1]);
+					const Float t43 = v_output_position_z * Float(constants.b0.projection[0][2]);
+					const Float t44 = v_output_position_w * Float(constants.b0.projection[0][3]);
+					const Float t45 = t41 + t42;
+					const Float t46 = t45 + t43;
+					const Float t47 = t46 + t44;
+					const Float t48 = v_output_position_x * Float(constants.b0.projection[1][0]);
+					const Float t49 = v_output_position_y * Float(constants.b0.projection[1][1]);
+					const Float t50 = v_output_position_z * Float(constants.b0.projection[1][2]);
+					const Float t51 = v_output_position_w * Float(constants.b0.projection[1][3]);
+					const Float t52 = t48 + t49;
+					const Float t53 = t52 + t50;
+					const Float t54 = t53 + t51;
+					const Float t55 = v_output_position_x * Float(constants.b0.projection[2][0]);
+					const Float t56 = v_output_position_y * Float(constants.b0.projection[2][1]);
+					const Float t57 = v_output_position_z * Float(constants.b0.projection[2][2]);
+					const Float t58 = v_output_position_w * Float(constants.b0.projection[2][3]);
+					const Float t59 = t55 + t56;
+					const Float t60 = t59 + t57;
+					const Float t61 = t60 + t58;
+					const Float t62 = v_output_position_x * Float(constants.b0.projection[3][0]);
+					const Float t63 = v_output_position_y * Float(constants.b0.projection[3][1]);
+					const Float t64 = v_output_position_z * Float(constants.b0.projection[3][2]);
+					const Float t65 = v_output_position_w * Float(constants.b0.projection[3][3]);
+					const Float t66 = t62 + t63;
+					const Float t67 = t66 + t64;
+					const Float t68 = t67 + t65;
+					v_output_position_x = t47;
+					v_output_position_y = t54;
+					v_output_position_z = t61;
+					v_output_position_w = t68;
+					const Float t69 = v_corner_x * -1.0f;
+					const Float t70 = v_corner_y * -1.0f;
+					const Float t71 = t69 + 1.0f;
+					const Float t72 = t70 + 1.0f;
+					const Float t73 = t71 / 2.0f;
+					const Float t74 = t72 / 2.0f;
+					v_output_uv_x = t73;
+					v_output_uv_y = t74;
+					v_output_species = v_input_species;
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+					r_4 = v_output_uv_x;
+					r_5 = v_output_uv_y;
+					r_6 = v_output_species;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// ImplicitCoralVertex.hlsl, vertex shader.
+		namespace ImplicitCoralVertex
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 4 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 }, { "TEXCOORD0", 4, 2 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], input[3], output[0], output[1], output[2], output[3], output[4], output[5]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask&, const Float& v_vPos_x, const Float& v_vPos_y, const Float&, const Float&, Float& r_0, Float& r_1, Float& r_2, Float& r_3, Float& r_4, Float& r_5)
+				{
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					Float v_output_canvasXY_x = 0.0f;
+					Float v_output_canvasXY_y = 0.0f;
+					const Float t0 = Sign(v_vPos_x);
+					const Float t1 = Sign(v_vPos_y);
+					v_output_position_x = t0;
+					v_output_position_y = t1;
+					v_output_position_z = 0.0f;
+					v_output_position_w = 1.0f;
+					const Float t2 = Float(constants.b0.projection[1][1]) / Float(constants.b0.projection[0][0]);
+					Float v_aspectRatio = t2;
+					const Float t3 = Sign(v_vPos_x);
+					const Float t4 = Sign(v_vPos_y);
+					const Float t5 = t3 * v_aspectRatio;
+					const Float t6 = t4 * 1.0f;
+					v_output_canvasXY_x = t5;
+					v_output_canvasXY_y = t6;
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+					r_4 = v_output_canvasXY_x;
+					r_5 = v_output_canvasXY_y;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// SampleVertexShader.hlsl, vertex shader.
+		namespace SampleVertexShader
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 3 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 }, { "TEXCOORD0", 4, 3 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], output[0], output[1], output[2], output[3], output[4], output[5], output[6]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask&, const Float& v_input_pos_x, const Float& v_input_pos_y, const Float& v_input_pos_z, Float& r_0, Float& r_1, Float& r_2, Float& r_3, Float& r_4, Float& r_5, Float& r_6)
+				{
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					Float v_output_cameraPosition_x = 0.0f;
+					Float v_output_cameraPosition_y = 0.0f;
+					Float v_output_cameraPosition_z = 0.0f;
+					v_output_position_x = v_input_pos_x;
+					v_output_position_y = v_input_pos_y;
+					v_output_position_z = v_input_pos_z;
+					v_output_position_w = 1.0f;
+					v_output_cameraPosition_x = Float(constants.b0.eye[0]);
+					v_output_cameraPosition_y = Float(constants.b0.eye[1]);
+					v_output_cameraPosition_z = Float(constants.b0.eye[2]);
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+					r_4 = v_output_cameraPosition_x;
+					r_5 = v_output_cameraPosition_y;
+					r_6 = v_output_cameraPosition_z;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// TerrainVertex.hlsl, vertex shader.
+		namespace TerrainVertex
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 3 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], output[0], output[1], output[2], output[3]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask&, const Float&, const Float&, const Float&, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					v_output_position_x = 0.0f;
+					v_output_position_y = 0.0f;
+					v_output_position_z = 0.0f;
+					v_output_position_w = 1.0f;
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		// WaterVertex.hlsl, vertex shader.
+		namespace WaterVertex
+		{
+			struct modelViewProjectionConstantBuffer
+			{
+				float model[4][4];
+				float view[4][4];
+				float projection[4][4];
+				float eye[4];
+				float lookAt[4];
+				float upDir[4];
+			};
+
+			static_assert(sizeof(modelViewProjectionConstantBuffer) == 240, "modelViewProjectionConstantBuffer must match the HLSL packing");
+
+			struct Constants
+			{
+				modelViewProjectionConstantBuffer b0;
+			};
+
+			static const Element Inputs[] = { { "POSITION", 0, 3 } };
+			static const Element Outputs[] = { { "SV_POSITION", 0, 4 } };
+
+			class Kernel
+			{
+			public:
+				explicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}
+
+				// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and
+				// returns the lanes that were not discarded.
+				Mask Run(const Float* input, Float* output, const Mask& active)
+				{
+					discarded = Mask::None();
+					f_main(active, input[0], input[1], input[2], output[0], output[1], output[2], output[3]);
+					return AndNot(active, discarded);
+				}
+
+			private:
+				void f_main(const Mask&, const Float&, const Float&, const Float&, Float& r_0, Float& r_1, Float& r_2, Float& r_3)
+				{
+					Float v_output_position_x = 0.0f;
+					Float v_output_position_y = 0.0f;
+					Float v_output_position_z = 0.0f;
+					Float v_output_position_w = 0.0f;
+					v_output_position_x = 0.0f;
+					v_output_position_y = 0.0f;
+					v_output_position_z = 0.0f;
+					v_output_position_w = 1.0f;
+					r_0 = v_output_position_x;
+					r_1 = v_output_position_y;
+					r_2 = v_output_position_z;
+					r_3 = v_output_position_w;
+				}
+
+				const Constants& constants;
+				Mask discarded;
+			};
+
+			inline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)
+			{
+				Kernel kernel(*static_cast<const Constants*>(constants));
+				return kernel.Run(input, output, active);
+			}
+		}
+
+		static const KernelInfo Kernels[] =
+		{
+			{ "CoralPixelShader", KernelStage::Pixel, 11, 4, 0, 0, CoralPixelShader::Inputs, 4, CoralPixelShader::Outputs, 1, sizeof(CoralPixelShader::Constants), CoralPixelShader::Run },
+			{ "CoralVertexShader", KernelStage::Vertex, 12, 11, -1, 0, CoralVertexShader::Inputs, 6, CoralVertexShader::Outputs, 4, sizeof(CoralVertexShader::Constants), CoralVertexShader::Run },
+			{ "WaterPixel", KernelStage::Pixel, 12, 4, 0, 0, WaterPixel::Inputs, 3, WaterPixel::Outputs, 1, sizeof(WaterPixel::Constants), WaterPixel::Run },
+			{ "TerrainPixel", KernelStage::Pixel, 12, 4, 0, 0, TerrainPixel::Inputs, 3, TerrainPixel::Outputs, 1, sizeof(TerrainPixel::Constants), TerrainPixel::Run },
+			{ "BubblesPixel", KernelStage::Pixel, 6, 5, 0, 0, BubblesPixel::Inputs, 2, BubblesPixel::Outputs, 2, sizeof(BubblesPixel::Constants), BubblesPixel::Run },
+			{ "BubblesVertex", KernelStage::Vertex, 4, 6, -1, 0, BubblesVertex::Inputs, 1, BubblesVertex::Outputs, 2, sizeof(BubblesVertex::Constants), BubblesVertex::Run },
+			{ "GeometryCoralVertex", KernelStage::Vertex, 5, 7, -1, 0, GeometryCoralVertex::Inputs, 3, GeometryCoralVertex::Outputs, 3, sizeof(GeometryCoralVertex::Constants), GeometryCoralVertex::Run },
+			{ "ImplicitCoralVertex", KernelStage::Vertex, 4, 6, -1, 0, ImplicitCoralVertex::Inputs, 1, ImplicitCoralVertex::Outputs, 2, sizeof(ImplicitCoralVertex::Constants), ImplicitCoralVertex::Run },
+			{ "SampleVertexShader", KernelStage::Vertex, 3, 7, -1, 0, SampleVertexShader::Inputs, 1, SampleVertexShader::Outputs, 2, sizeof(SampleVertexShader::Constants), SampleVertexShader::Run },
+			{ "TerrainVertex", KernelStage::Vertex, 3, 4, -1, 0, TerrainVertex::Inputs, 1, TerrainVertex::Outputs, 1, sizeof(TerrainVertex::Constants), TerrainVertex::Run },
+			{ "WaterVertex", KernelStage::Vertex, 3, 4, -1, 0, WaterVertex::Inputs, 1, WaterVertex::Outputs, 1, sizeof(WaterVertex::Constants), WaterVertex::Run },
+		};
+
+		static const int KernelCount = 11;
+
+		// The most Floats any kernel reads or writes.
+		static const int MaxKernelFloats = 12;
+	}
+}
@@ -0,0 +1,427 @@
+﻿#include "pch.h"
+#include "VertexQuantization.h"
+#include "MeshOptimizer.h"
+
+#include <chrono>
+#include <cstring>
+
+// ARM builds take the portable batch path
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define VERTEX_QUANTIZATION_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace ACW;
+using namespace ACW::ShaderMath;
+using namespace ACW::VertexQuantization;
+
+namespace
+{
+	// Keeps a zero length normal from dividing by zero, it encodes as straight up
+	const float MinNormalLength = 1e-20f;
+
+	const float RadiansToDegrees = 57.2957795131f;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	uint32_t FloatBits(float v)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &v, sizeof(bits));
+		return bits;
+	}
+
+	float BitsFloat(uint32_t bits)
+	{
+		float v;
+		std::memcpy(&v, &bits, sizeof(v));
+		return v;
+	}
+
+	const float3& At(const float3* first, size_t stride, size_t i)
+	{
+		return *reinterpret_cast<const float3*>(reinterpret_cast<const uint8_t*>(first) + stride * i);
+	}
+
+	const float2& At(const float2* first, size_t stride, size_t i)
+	{
+		return *reinterpret_cast<const float2*>(reinterpret_cast<const uint8_t*>(first) + stride * i);
+	}
+
+	float3 InverseExtent(const Bounds& bounds)
+	{
+		return float3(1.0f / bounds.extent.x, 1.0f / bounds.extent.y, 1.0f / bounds.extent.z);
+	}
+
+	// Both paths divide by the extent as a multiply by its inverse, so they round the same
+	uint16_t EncodePosition(float p, float minimum, float inverseExtent)
+	{
+		return EncodeUnorm16((p - minimum) * inverseExtent);
+	}
+
+	// One vertex at a time, with the branches of the functions above
+	void EncodeScalar(const float3* positions, const float3* normals, const float2* uvs, size_t stride, size_t count, const Bounds& bounds, uint8_t* output)
+	{
+		size_t outputStride = uvs ? sizeof(PackedVertexUv) : sizeof(PackedVertex);
+		float3 inverseExtent = InverseExtent(bounds);
+		for (size_t i = 0; i < count; i++)
+		{
+			const float3& p = At(positions, stride, i);
+			float2 e = OctEncode(At(normals, stride, i));
+
+			PackedVertexUv packed;
+			packed.position[0] = EncodePosition(p.x, bounds.minimum.x, inverseExtent.x);
+			packed.position[1] = EncodePosition(p.y, bounds.minimum.y, inverseExtent.y);
+			packed.position[2] = EncodePosition(p.z, bounds.minimum.z, inverseExtent.z);
+			packed.position[3] = 0;
+			packed.normal[0] = EncodeSnorm16(e.x);
+			packed.normal[1] = EncodeSnorm16(e.y);
+			if (uvs)
+			{
+				const float2& uv = At(uvs, stride, i);
+				packed.uv[0] = FloatToHalf(uv.x);
+				packed.uv[1] = FloatToHalf(uv.y);
+			}
+			std::memcpy(output + outputStride * i, &packed, outputStride);
+		}
+	}
+
+	// The lanes of a batch as structures of arrays, zero past the last vertex
+	struct Block
+	{
+		float px[BatchSize], py[BatchSize], pz[BatchSize];
+		float nx[BatchSize], ny[BatchSize], nz[BatchSize];
+		float u[BatchSize], v[BatchSize];
+
+		int32_t qx[BatchSize], qy[BatchSize], qz[BatchSize];
+		int32_t ox[BatchSize], oy[BatchSize];
+		int32_t hu[BatchSize], hv[BatchSize];
+	};
+
+#if defined(VERTEX_QUANTIZATION_SSE2)
+	__m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	__m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	__m128 Clamp(__m128 v, __m128 lo, __m128 hi)
+	{
+		return _mm_min_ps(_mm_max_ps(v, lo), hi);
+	}
+
+	// Snorm rounding as EncodeSnorm16 does it, half away from zero
+	__m128i Snorm16(__m128 v, __m128 signMask)
+	{
+		__m128 half = _mm_or_ps(_mm_and_ps(v, signMask), _mm_set1_ps(0.5f));
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(32767.0f)), half));
+	}
+
+	// FloatToHalf four at a time, SSE2 has no unsigned or 32 bit minimum so the clamp is a compare and select
+	__m128i Half(__m128 v)
+	{
+		const __m128i infinity = _mm_set1_epi32(255 << 23);
+		const __m128i roundMask = _mm_set1_epi32(~0xfff);
+		const __m128i halfInfinity = _mm_set1_epi32(31 << 23);
+
+		__m128i bits = _mm_castps_si128(v);
+		__m128i sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+		bits = _mm_xor_si128(bits, sign);
+
+		__m128i isNan = _mm_cmpgt_epi32(bits, infinity);
+		__m128i isFinite = _mm_cmpgt_epi32(infinity, bits);
+		__m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(isNan, _mm_set1_epi32(0x200)));
+
+		__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_and_si128(bits, roundMask)), _mm_castsi128_ps(_mm_set1_epi32(15 << 23)));
+		__m128i rounded = _mm_sub_epi32(_mm_castps_si128(scaled), roundMask);
+		rounded = Select(_mm_cmpgt_epi32(rounded, halfInfinity), halfInfinity, rounded);
+		__m128i finite = _mm_srli_epi32(rounded, 13);
+
+		return _mm_or_si128(Select(isFinite, finite, special), _mm_srli_epi32(sign, 16));
+	}
+
+	void QuantizeBlock(Block& block, const Bounds& bounds, const float3& inverseExtent, bool hasUvs)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 unormScale = _mm_set1_ps(65535.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+
+		for (int i = 0; i < BatchSize; i += 4)
+		{
+			__m128 x = Clamp(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&block.px[i]), _mm_set1_ps(bounds.minimum.x)), _mm_set1_ps(inverseExtent.x)), zero, one);
+			__m128 y = Clamp(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&block.py[i]), _mm_set1_ps(bounds.minimum.y)), _mm_set1_ps(inverseExtent.y)), zero, one);
+			__m128 z = Clamp(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&block.pz[i]), _mm_set1_ps(bounds.minimum.z)), _mm_set1_ps(inverseExtent.z)), zero, one);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.qx[i]), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, unormScale), half)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.qy[i]), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y, unormScale), half)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.qz[i]), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(z, unormScale), half)));
+
+			__m128 nx = _mm_loadu_ps(&block.nx[i]);
+			__m128 ny = _mm_loadu_ps(&block.ny[i]);
+			__m128 nz = _mm_loadu_ps(&block.nz[i]);
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, nx), _mm_andnot_ps(signMask, ny)), _mm_andnot_ps(signMask, nz));
+			__m128 inverseLength = _mm_div_ps(one, _mm_max_ps(sum, _mm_set1_ps(MinNormalLength)));
+			nx = _mm_mul_ps(nx, inverseLength);
+			ny = _mm_mul_ps(ny, inverseLength);
+			__m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ny)), _mm_or_ps(_mm_and_ps(nx, signMask), one));
+			__m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, nx)), _mm_or_ps(_mm_and_ps(ny, signMask), one));
+			__m128 lower = _mm_cmplt_ps(nz, zero);
+			nx = Clamp(Select(lower, foldedX, nx), minusOne, one);
+			ny = Clamp(Select(lower, foldedY, ny), minusOne, one);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.ox[i]), Snorm16(nx, signMask));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.oy[i]), Snorm16(ny, signMask));
+
+			if (hasUvs)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.hu[i]), Half(_mm_loadu_ps(&block.u[i])));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&block.hv[i]), Half(_mm_loadu_ps(&block.v[i])));
+			}
+		}
+	}
+#else
+	// Without SSE2 the lanes go through the one at a time encoders
+	void QuantizeBlock(Block& block, const Bounds& bounds, const float3& inverseExtent, bool hasUvs)
+	{
+		for (int i = 0; i < BatchSize; i++)
+		{
+			block.qx[i] = EncodePosition(block.px[i], bounds.minimum.x, inverseExtent.x);
+			block.qy[i] = EncodePosition(block.py[i], bounds.minimum.y, inverseExtent.y);
+			block.qz[i] = EncodePosition(block.pz[i], bounds.minimum.z, inverseExtent.z);
+		}
+		for (int i = 0; i < BatchSize; i++)
+		{
+			float2 e = OctEncode(float3(block.nx[i], block.ny[i], block.nz[i]));
+			block.ox[i] = EncodeSnorm16(e.x);
+			block.oy[i] = EncodeSnorm16(e.y);
+		}
+		for (int i = 0; hasUvs && i < BatchSize; i++)
+		{
+			block.hu[i] = FloatToHalf(block.u[i]);
+			block.hv[i] = FloatToHalf(block.v[i]);
+		}
+	}
+#endif
+
+	void EncodeBlock(const float3* positions, const float3* normals, const float2* uvs, size_t stride, size_t first, int count, const Bounds& bounds, const float3& inverseExtent, uint8_t* output)
+	{
+		Block block = {};
+		for (int i = 0; i < count; i++)
+		{
+			const float3& p = At(positions, stride, first + i);
+			const float3& n = At(normals, stride, first + i);
+			block.px[i] = p.x; block.py[i] = p.y; block.pz[i] = p.z;
+			block.nx[i] = n.x; block.ny[i] = n.y; block.nz[i] = n.z;
+			if (uvs)
+			{
+				const float2& uv = At(uvs, stride, first + i);
+				block.u[i] = uv.x;
+				block.v[i] = uv.y;
+			}
+		}
+
+		QuantizeBlock(block, bounds, inverseExtent, uvs != nullptr);
+
+		size_t outputStride = uvs ? sizeof(PackedVertexUv) : sizeof(PackedVertex);
+		for (int i = 0; i < count; i++)
+		{
+			PackedVertexUv packed;
+			packed.position[0] = static_cast<uint16_t>(block.qx[i]);
+			packed.position[1] = static_cast<uint16_t>(block.qy[i]);
+			packed.position[2] = static_cast<uint16_t>(block.qz[i]);
+			packed.position[3] = 0;
+			packed.normal[0] = static_cast<int16_t>(block.ox[i]);
+			packed.normal[1] = static_cast<int16_t>(block.oy[i]);
+			packed.uv[0] = static_cast<uint16_t>(block.hu[i]);
+			packed.uv[1] = static_cast<uint16_t>(block.hv[i]);
+			std::memcpy(output + outputStride * (first + i), &packed, outputStride);
+		}
+	}
+}
+
+Bounds VertexQuantization::ComputeBounds(const float3* positions, size_t stride, size_t count)
+{
+	Bounds bounds;
+	float3 maximum;
+	for (size_t i = 0; i < count; i++)
+	{
+		const float3& p = At(positions, stride, i);
+		bounds.minimum = i == 0 ? p : float3(std::min(bounds.minimum.x, p.x), std::min(bounds.minimum.y, p.y), std::min(bounds.minimum.z, p.z));
+		maximum = i == 0 ? p : float3(std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z));
+	}
+
+	const float minExtent = 1e-6f;
+	bounds.extent = float3(std::max(maximum.x - bounds.minimum.x, minExtent), std::max(maximum.y - bounds.minimum.y, minExtent), std::max(maximum.z - bounds.minimum.z, minExtent));
+	return bounds;
+}
+
+uint16_t VertexQuantization::EncodeUnorm16(float v)
+{
+	v = std::min(std::max(v, 0.0f), 1.0f);
+	return static_cast<uint16_t>(v * 65535.0f + 0.5f);
+}
+
+int16_t VertexQuantization::EncodeSnorm16(float v)
+{
+	v = std::min(std::max(v, -1.0f), 1.0f);
+	return static_cast<int16_t>(v * 32767.0f + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+float VertexQuantization::DecodeUnorm16(uint16_t v)
+{
+	return v / 65535.0f;
+}
+
+float VertexQuantization::DecodeSnorm16(int16_t v)
+{
+	// As D3D does, -32768 and -32767 both give -1
+	return std::max(v / 32767.0f, -1.0f);
+}
+
+uint16_t VertexQuantization::FloatToHalf(float v)
+{
+	uint32_t bits = FloatBits(v);
+	uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32_t half;
+	if (bits >= (255u << 23))
+	{
+		// Infinity stays infinity, NaN becomes a quiet NaN
+		half = bits > (255u << 23) ? 0x7e00u : 0x7c00u;
+	}
+	else
+	{
+		// Dropping the low bits and scaling by 2^-112 moves the exponent to half's bias and lets the multiply
+		// make denormals, adding the dropped bit back rounds, and anything past the largest half is clamped
+		// to infinity
+		uint32_t rounded = FloatBits(BitsFloat(bits & ~0xfffu) * BitsFloat(15u << 23)) - ~0xfffu;
+		half = std::min(rounded, 31u << 23) >> 13;
+	}
+	return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float VertexQuantization::HalfToFloat(uint16_t v)
+{
+	uint32_t sign = static_cast<uint32_t>(v & 0x8000u) << 16;
+	uint32_t exponentMantissa = static_cast<uint32_t>(v & 0x7fffu) << 13;
+
+	// Rebias by scaling, which also turns half denormals into normal floats, then carry infinity and NaN over
+	float magnitude = BitsFloat(exponentMantissa) * BitsFloat(239u << 23);
+	uint32_t bits = FloatBits(magnitude);
+	if (magnitude >= BitsFloat(143u << 23))
+	{
+		bits |= 255u << 23;
+	}
+	return BitsFloat(bits | sign);
+}
+
+float2 VertexQuantization::OctEncode(const float3& n)
+{
+	float inverseLength = 1.0f / std::max(std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z), MinNormalLength);
+	float x = n.x * inverseLength;
+	float y = n.y * inverseLength;
+
+	// The lower half folds out over the corners
+	if (n.z < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * std::copysign(1.0f, x);
+		float foldedY = (1.0f - std::fabs(x)) * std::copysign(1.0f, y);
+		x = foldedX;
+		y = foldedY;
+	}
+	return float2(x, y);
+}
+
+float3 VertexQuantization::OctDecode(const float2& e)
+{
+	float3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+PackedVertex VertexQuantization::Encode(const float3& position, const float3& normal, const Bounds& bounds)
+{
+	PackedVertex packed;
+	EncodeScalar(&position, &normal, nullptr, 0, 1, bounds, reinterpret_cast<uint8_t*>(&packed));
+	return packed;
+}
+
+void VertexQuantization::Decode(const PackedVertex& vertex, const Bounds& bounds, float3& position, float3& normal)
+{
+	position = bounds.minimum + bounds.extent * float3(DecodeUnorm16(vertex.position[0]), DecodeUnorm16(vertex.position[1]), DecodeUnorm16(vertex.position[2]));
+	normal = OctDecode(float2(DecodeSnorm16(vertex.normal[0]), DecodeSnorm16(vertex.normal[1])));
+}
+
+void VertexQuantization::EncodeBatch(const float3* positions, const float3* normals, const float2* uvs, size_t stride, size_t count, const Bounds& bounds, void* output, bool batched)
+{
+	uint8_t* bytes = static_cast<uint8_t*>(output);
+	if (!batched)
+	{
+		EncodeScalar(positions, normals, uvs, stride, count, bounds, bytes);
+		return;
+	}
+
+	float3 inverseExtent = InverseExtent(bounds);
+	for (size_t first = 0; first < count; first += BatchSize)
+	{
+		int blockCount = static_cast<int>(std::min(count - first, static_cast<size_t>(BatchSize)));
+		EncodeBlock(positions, normals, uvs, stride, first, blockCount, bounds, inverseExtent, bytes);
+	}
+}
+
+QuantizationBenchmark VertexQuantization::RunQuantizationBenchmark(const float3* positions, const float3* normals, size_t stride, size_t count, const std::vector<uint32_t>& indices, int iterations)
+{
+	QuantizationBenchmark result = {};
+	result.vertexCount = static_cast<uint32_t>(count);
+	result.floatVertexSize = static_cast<uint32_t>(sizeof(float3) * 2);
+	result.packedVertexSize = static_cast<uint32_t>(sizeof(PackedVertex));
+	result.floatBytes = result.vertexCount * result.floatVertexSize;
+	result.packedBytes = result.vertexCount * result.packedVertexSize;
+	result.floatFetchBytes = MeshOptimizer::SimulateVertexFetch(indices, count, result.floatVertexSize, MeshOptimizer::DefaultCacheSize).bytesFetched;
+	result.packedFetchBytes = MeshOptimizer::SimulateVertexFetch(indices, count, result.packedVertexSize, MeshOptimizer::DefaultCacheSize).bytesFetched;
+
+	Bounds bounds = ComputeBounds(positions, stride, count);
+	std::vector<PackedVertex> scalar(count);
+	std::vector<PackedVertex> batch(count);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		EncodeBatch(positions, normals, nullptr, stride, count, bounds, scalar.data(), false);
+	}
+	result.scalarMilliseconds = MillisecondsSince(start) / iterations;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		EncodeBatch(positions, normals, nullptr, stride, count, bounds, batch.data(), true);
+	}
+	result.batchMilliseconds = MillisecondsSince(start) / iterations;
+	result.batchVerticesPerSecond = result.batchMilliseconds > 0.0 ? count / (result.batchMilliseconds * 1e-3) : 0.0;
+	result.identical = count == 0 || std::memcmp(scalar.data(), batch.data(), sizeof(PackedVertex) * count) == 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float3 position;
+		float3 normal;
+		Decode(batch[i], bounds, position, normal);
+
+		float3 error = position - At(positions, stride, i);
+		result.maxPositionError = std::max(result.maxPositionError, std::max(std::fabs(error.x), std::max(std::fabs(error.y), std::fabs(error.z))));
+
+		float cosine = std::min(std::max(dot(normal, normalize(At(normals, stride, i))), -1.0f), 1.0f);
+		result.maxNormalErrorDegrees = std::max(result.maxNormalErrorDegrees, std::acos(cosine) * RadiansToDegrees);
+	}
+	return result;
+}
@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include "ShaderMath.h"
+#include <cstdint>
+#include <vector>
+
+namespace ACW
+{
+	// Packed vertex formats for meshes built on the CPU. Positions are 16 bit unsigned normalised within
+	// the mesh's bounding box, normals are folded onto an octahedron and stored as two 16 bit signed
+	// normalised values, and texture coordinates are half floats. A float position and normal take 24
+	// bytes, packed they take 12. VertexQuantization.hlsli decodes them in the vertex shader.
+	namespace VertexQuantization
+	{
+		using ShaderMath::float2;
+		using ShaderMath::float3;
+
+		// Vertices handled together by the batch paths, with every lane doing the same work.
+		static const int BatchSize = 16;
+
+		// Box the positions are normalised within. A flat axis keeps a non-zero extent so it still decodes.
+		struct Bounds
+		{
+			float3 minimum;
+			float3 extent;
+		};
+
+		// POSITION as R16G16B16A16_UNORM, w unused, and NORMAL as R16G16_SNORM.
+		struct PackedVertex
+		{
+			uint16_t position[4];
+			int16_t normal[2];
+		};
+
+		// PackedVertex followed by TEXCOORD as R16G16_FLOAT.
+		struct PackedVertexUv
+		{
+			uint16_t position[4];
+			int16_t normal[2];
+			uint16_t uv[2];
+		};
+
+		struct QuantizationBenchmark
+		{
+			uint32_t vertexCount;
+			uint32_t floatVertexSize;
+			uint32_t packedVertexSize;
+
+			// Vertex buffer sizes, and the bytes the vertex fetch simulator reads drawing the indices once.
+			uint32_t floatBytes;
+			uint32_t packedBytes;
+			uint32_t floatFetchBytes;
+			uint32_t packedFetchBytes;
+
+			// Time per pass over every vertex, one vertex at a time and in batches.
+			double scalarMilliseconds;
+			double batchMilliseconds;
+			double batchVerticesPerSecond;
+
+			// Whether both paths wrote the same bytes, and how far the decoded vertices are from the originals.
+			bool identical;
+			float maxPositionError;
+			float maxNormalErrorDegrees;
+		};
+
+		Bounds ComputeBounds(const float3* positions, size_t stride, size_t count);
+
+		uint16_t EncodeUnorm16(float v);
+		int16_t EncodeSnorm16(float v);
+		float DecodeUnorm16(uint16_t v);
+		float DecodeSnorm16(int16_t v);
+
+		// Halves are rounded away from zero, too large values become infinity and NaN stays NaN.
+		uint16_t FloatToHalf(float v);
+		float HalfToFloat(uint16_t v);
+
+		// A unit vector as a point of the octahedron unfolded onto [-1, 1] squared, and back.
+		float2 OctEncode(const float3& n);
+		float3 OctDecode(const float2& e);
+
+		PackedVertex Encode(const float3& position, const float3& normal, const Bounds& bounds);
+		void Decode(const PackedVertex& vertex, const Bounds& bounds, float3& position, float3& normal);
+
+		// Encodes count vertices whose position, normal and, when uvs is not null, texture coordinate are each
+		// read stride bytes after the last, to output as PackedVertex or, with uvs, PackedVertexUv. The batch
+		// path works on BatchSize vertices at a time without branches so that the compiler vectorises it, and
+		// writes the same bytes as encoding one vertex at a time.
+		void EncodeBatch(const float3* positions, const float3* normals, const float2* uvs, size_t stride, size_t count, const Bounds& bounds, void* output, bool batched = true);
+
+		// Encodes the vertices both ways and decodes them again. indices are the mesh's triangles, for the fetch simulator.
+		QuantizationBenchmark RunQuantizationBenchmark(const float3* positions, const float3* normals, size_t stride, size_t count, const std::vector<uint32_t>& indices, int iterations);
+	}
+}
@@ -0,0 +1,15 @@
+// Decoding of the packed vertex formats of VertexQuantization. The UNORM and SNORM formats of the input
+// layout turn the integers back into floats, these undo the bounding box and the octahedron.
+
+float3 DecodePosition(float3 normalised, float3 boundsMinimum, float3 boundsExtent)
+{
+    return boundsMinimum + normalised * boundsExtent;
+}
+
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0 ? -t : t;
+    return normalize(n);
+}
@@ -0,0 +1,180 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ACW
+{
+	// Fork and join for the CPU passes over plant instances and coral, and for recording passes. Work is handed
+	// thread indices 0 to threadCount - 1, with 0 run on the calling thread. Work done every frame goes to a Pool,
+	// whose threads are started once and woken for each job. Run starts threads for the one job and joins them,
+	// which is left to work done once, while loading.
+	namespace WorkerThreads
+	{
+		// threadCount, or one per hardware thread when it is 0
+		inline int Resolve(int threadCount)
+		{
+			int count = threadCount > 0 ? threadCount : static_cast<int>(std::thread::hardware_concurrency());
+			return std::max(count, 1);
+		}
+
+		// Threads worth starting for itemCount items when each should get at least minItemsPerThread
+		inline int CountFor(size_t itemCount, size_t minItemsPerThread, int threadCount)
+		{
+			size_t useful = std::max<size_t>(itemCount / minItemsPerThread, 1);
+			return static_cast<int>(std::min<size_t>(useful, Resolve(threadCount)));
+		}
+
+		// Starts threadCount - 1 threads for work and joins them.
+		template <class Work>
+		void Run(int threadCount, const Work& work)
+		{
+			std::vector<std::thread> threads;
+			for (int thread = 1; thread < threadCount; thread++)
+			{
+				threads.emplace_back(work, thread);
+			}
+			work(0);
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		// Threads kept waiting between jobs. A job asking for more thread indices than the pool has threads hands
+		// each thread every ThreadCount()th index, so work sees the same indices whatever the size of the pool.
+		// Run is called from one thread at a time, and not from inside a job.
+		class Pool
+		{
+		public:
+			// threadCount threads in all, counting the one calling Run, or one per hardware thread when it is 0.
+			explicit Pool(int threadCount = 0) :
+				mJob(),
+				mGeneration(0),
+				mBusy(0),
+				mStopping(false)
+			{
+				int count = Resolve(threadCount);
+				for (int thread = 1; thread < count; thread++)
+				{
+					mThreads.emplace_back(&Pool::Wait, this, thread);
+				}
+			}
+
+			~Pool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mLock);
+					mStopping = true;
+				}
+				mStart.notify_all();
+				for (std::thread& thread : mThreads)
+				{
+					thread.join();
+				}
+			}
+
+			Pool(const Pool&) = delete;
+			Pool& operator=(const Pool&) = delete;
+
+			int ThreadCount() const { return static_cast<int>(mThreads.size()) + 1; }
+
+			// Calls work(thread) for each thread from 0 to threadCount - 1 and returns once all of them have.
+			template <class Work>
+			void Run(int threadCount, const Work& work)
+			{
+				Job job = { &Call<Work>, &work, threadCount };
+				if (threadCount > 1 && !mThreads.empty())
+				{
+					Dispatch(job);
+				}
+				else
+				{
+					RunIndices(job, 0);
+				}
+			}
+
+		private:
+			struct Job
+			{
+				void (*call)(const void* work, int thread);
+				const void* work;
+				int threadCount;
+			};
+
+			template <class Work>
+			static void Call(const void* work, int thread)
+			{
+				(*static_cast<const Work*>(work))(thread);
+			}
+
+			void RunIndices(const Job& job, int first) const
+			{
+				for (int thread = first; thread < job.threadCount; thread += ThreadCount())
+				{
+					job.call(job.work, thread);
+				}
+			}
+
+			// Wakes the threads the job has indices for, runs index 0 and those after it here, and waits for the rest
+			void Dispatch(const Job& job)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mLock);
+					mJob = job;
+					mGeneration++;
+					mBusy = std::min(job.threadCount - 1, static_cast<int>(mThreads.size()));
+				}
+				mStart.notify_all();
+
+				RunIndices(job, 0);
+
+				std::unique_lock<std::mutex> lock(mLock);
+				mDone.wait(lock, [this] { return mBusy == 0; });
+			}
+
+			void Wait(int index)
+			{
+				uint64_t seen = 0;
+				for (;;)
+				{
+					Job job;
+					{
+						std::unique_lock<std::mutex> lock(mLock);
+						mStart.wait(lock, [&] { return mStopping || mGeneration != seen; });
+						if (mStopping)
+						{
+							return;
+						}
+						seen = mGeneration;
+						job = mJob;
+					}
+
+					if (index < job.threadCount)
+					{
+						RunIndices(job, index);
+
+						std::lock_guard<std::mutex> lock(mLock);
+						if (--mBusy == 0)
+						{
+							mDone.notify_one();
+						}
+					}
+				}
+			}
+
+			std::vector<std::thread> mThreads;
+			std::mutex mLock;
+			std::condition_variable mStart;
+			std::condition_variable mDone;
+			Job mJob;
+			uint64_t mGeneration;
+			int mBusy;
+			bool mStopping;
+		};
+	}
+}
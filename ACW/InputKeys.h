@@ -0,0 +1,24 @@
+﻿#pragma once
+
+namespace ACW
+{
+	// The keys App tracks, each an index into the input passed to ACWMain::Update, held down while true.
+	enum InputKey
+	{
+		InputForward, // W
+		InputLeft, // A
+		InputBack, // S
+		InputRight, // D
+		InputUp, // Space
+		InputDown, // Control
+		InputTurnLeft, // Q
+		InputTurnRight, // E
+		InputLeftButton,
+		InputRightButton,
+		InputRaymarchResolution, // R
+		InputCoralShadingRate, // T
+		InputRecordDeferred, // Y
+		InputWriteTrace, // P
+		InputKeyCount
+	};
+}
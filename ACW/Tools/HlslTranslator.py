@@ -0,0 +1,2260 @@
+"""Translates the HLSL the Content shaders are written in into C++ kernels that run a shader for eight pixels
+or vertices at once, one lane each, on the ShaderBatch types.
+
+Usage: HlslTranslator.py <shaders.txt> --cpp <out.h>
+
+<shaders.txt> names one .hlsl file per line, relative to itself. Text after # is a comment.
+
+The subset covers what the vertex and pixel shaders without textures use: #include and object-like #define,
+cbuffers, structs, static globals and their initialisers, float, int, uint and bool scalars, vectors and
+matrices, swizzles, the common intrinsics, user functions with in, out and inout parameters, if, for, while,
+break, continue, return and discard. Every component becomes its own Float, and a bool a Mask. Ints are
+carried as whole numbers in a Float, so they are exact up to 2^24 which the shaders stay well inside.
+
+Control flow runs the way a GPU runs it: both sides of a branch are walked with a mask of the lanes taking
+each, and a side no lane takes is skipped. Writes to variables that might be live in lanes outside the mask
+go through Select. Textures, samplers and hull and domain shaders are not supported, and a shader using them
+is reported rather than half translated.
+"""
+
+import argparse
+import math
+import os
+import re
+import struct
+import sys
+
+
+class HlslError(Exception):
+    pass
+
+
+# Preprocessing and tokens
+
+class Token(object):
+    def __init__(self, kind, text, where):
+        self.kind = kind
+        self.text = text
+        self.where = where
+
+
+TOKEN_PATTERN = re.compile(r'''
+    (?P<space>\s+)
+  | (?P<num>(\d+\.\d*|\.\d+)([eE][+-]?\d+)?[fFhH]?|\d+[eE][+-]?\d+[fFhH]?|0[xX][0-9a-fA-F]+[uU]?|\d+[uU]?)
+  | (?P<id>[A-Za-z_]\w*)
+  | (?P<str>"[^"\n]*")
+  | (?P<op><<=|>>=|\+\+|--|\+=|-=|\*=|/=|%=|&=|\|=|\^=|==|!=|<=|>=|&&|\|\||<<|>>|::|[-+*/%<>=!~&|^?:;,.(){}\[\]#])
+''', re.VERBOSE)
+
+
+def strip_comments(text):
+    # Keeps the newlines of block comments so lines still count from the top of the file
+    def blank(match):
+        return '\n' * match.group(0).count('\n') if match.group(0).startswith('/*') else ''
+    return re.sub(r'/\*.*?\*/|//[^\n]*', blank, text, flags=re.DOTALL)
+
+
+def tokenize_line(line, where):
+    tokens = []
+    position = 0
+    while position < len(line):
+        match = TOKEN_PATTERN.match(line, position)
+        if not match:
+            raise HlslError('%s: unexpected %r' % (where, line[position]))
+        position = match.end()
+        kind = match.lastgroup
+        if kind != 'space':
+            tokens.append(Token(kind, match.group(kind), where))
+    return tokens
+
+
+def preprocess(path, defines, included, depends):
+    # Expands includes and object-like defines into one list of tokens
+    path = os.path.normpath(path)
+    if path in included:
+        return []
+    included.add(path)
+    depends.append(path)
+    try:
+        with open(path, encoding='utf-8-sig') as f:
+            text = strip_comments(f.read().replace('\\\n', ' \n'))
+    except IOError:
+        raise HlslError('cannot read %s' % path)
+
+    tokens = []
+    for line_number, line in enumerate(text.split('\n'), 1):
+        where = '%s(%d)' % (os.path.basename(path), line_number)
+        stripped = line.strip()
+        if stripped.startswith('#'):
+            directive = tokenize_line(stripped[1:], where)
+            if not directive:
+                continue
+            name = directive[0].text
+            if name == 'include':
+                if len(directive) != 2 or directive[1].kind != 'str':
+                    raise HlslError('%s: #include needs a quoted file name' % where)
+                include = os.path.join(os.path.dirname(path), directive[1].text[1:-1])
+                tokens.extend(preprocess(include, defines, included, depends))
+            elif name == 'define':
+                if len(directive) < 2 or directive[1].kind != 'id':
+                    raise HlslError('%s: #define needs a name' % where)
+                if len(directive) > 2 and directive[2].text == '(' and stripped.find('(') == stripped.find(directive[1].text) + len(directive[1].text):
+                    raise HlslError('%s: function-like macros are not supported' % where)
+                defines[directive[1].text] = expand(directive[2:], defines)
+            elif name == 'pragma':
+                continue
+            else:
+                raise HlslError('%s: #%s is not supported' % (where, name))
+            continue
+        tokens.extend(expand(tokenize_line(line, where), defines))
+    return tokens
+
+
+def expand(tokens, defines):
+    result = []
+    for token in tokens:
+        if token.kind == 'id' and token.text in defines:
+            result.extend(Token(t.kind, t.text, token.where) for t in defines[token.text])
+        else:
+            result.append(token)
+    return result
+
+
+# Types
+
+SCALARS = {'float': 'float', 'half': 'float', 'double': 'float', 'min16float': 'float', 'int': 'int',
+           'min16int': 'int', 'uint': 'uint', 'dword': 'uint', 'bool': 'bool'}
+
+UNSUPPORTED_TYPES = re.compile(r'^(Texture\w*|RWTexture\w*|Sampler\w*|(RW)?(Structured|ByteAddress)?Buffer|TextureCube\w*)$')
+
+COMPONENTS = 'xyzw'
+
+
+class Type(object):
+    # kind is 'numeric' (scalar, vector or matrix, rows 0 for scalars and vectors), 'struct' or 'array'
+    def __init__(self, kind, base=None, size=1, rows=0, struct=None, element=None, length=0):
+        self.kind = kind
+        self.base = base
+        self.size = size
+        self.rows = rows
+        self.struct = struct
+        self.element = element
+        self.length = length
+
+    def is_scalar(self):
+        return self.kind == 'numeric' and self.rows == 0 and self.size == 1
+
+    def is_vector(self):
+        return self.kind == 'numeric' and self.rows == 0
+
+    def is_matrix(self):
+        return self.kind == 'numeric' and self.rows > 0
+
+    def count(self):
+        return len(self.leaves())
+
+    def leaves(self):
+        # (name suffix, base) of each component, in memory order of the flattened value
+        if self.kind == 'numeric':
+            if self.rows:
+                return [('m%d%d' % (r, c), self.base) for r in range(self.rows) for c in range(self.size)]
+            if self.size == 1:
+                return [('', self.base)]
+            return [(COMPONENTS[i], self.base) for i in range(self.size)]
+        if self.kind == 'struct':
+            result = []
+            for field_type, field_name, _ in self.struct.fields:
+                for suffix, base in field_type.leaves():
+                    result.append((join(field_name, suffix), base))
+            return result
+        raise HlslError('arrays cannot be used as values')
+
+    def same(self, other):
+        if self.kind != other.kind:
+            return False
+        if self.kind == 'numeric':
+            return (self.base, self.size, self.rows) == (other.base, other.size, other.rows)
+        if self.kind == 'struct':
+            return self.struct is other.struct
+        return self.length == other.length and self.element.same(other.element)
+
+    def name(self):
+        if self.kind == 'struct':
+            return self.struct.name
+        if self.kind == 'array':
+            return '%s[%d]' % (self.element.name(), self.length)
+        if self.rows:
+            return '%s%dx%d' % (self.base, self.rows, self.size)
+        return self.base if self.size == 1 else '%s%d' % (self.base, self.size)
+
+
+def numeric(base, size=1, rows=0):
+    return Type('numeric', base=base, size=size, rows=rows)
+
+
+def join(prefix, suffix):
+    return prefix + '_' + suffix if suffix else prefix
+
+
+class StructDef(object):
+    def __init__(self, name, fields):
+        self.name = name
+        # (type, name, semantic)
+        self.fields = fields
+
+    def field(self, name):
+        offset = 0
+        for field_type, field_name, _ in self.fields:
+            if field_name == name:
+                return field_type, offset
+            offset += field_type.count()
+        return None, 0
+
+
+# Syntax tree
+
+class Node(object):
+    def __init__(self, kind, where, **fields):
+        self.kind = kind
+        self.where = where
+        self.__dict__.update(fields)
+
+
+class Parser(object):
+    MODIFIERS = {'static', 'const', 'uniform', 'extern', 'precise', 'row_major', 'column_major', 'linear',
+                 'nointerpolation', 'noperspective', 'centroid', 'sample', 'in', 'out', 'inout', 'inline'}
+
+    def __init__(self, tokens, path):
+        self.tokens = tokens
+        self.position = 0
+        self.path = path
+        self.structs = {}
+        # cbuffers and static globals in the order they are declared, as each may use the constants before it
+        self.declarations = []
+        self.functions = {}
+
+    # Token access
+
+    def peek(self, offset=0):
+        index = self.position + offset
+        return self.tokens[index] if index < len(self.tokens) else None
+
+    def where(self):
+        token = self.peek() or (self.tokens[-1] if self.tokens else None)
+        return token.where if token else os.path.basename(self.path)
+
+    def error(self, message):
+        return HlslError('%s: %s' % (self.where(), message))
+
+    def at(self, text):
+        token = self.peek()
+        return token is not None and token.text == text and token.kind in ('op', 'id')
+
+    def accept(self, text):
+        if self.at(text):
+            self.position += 1
+            return True
+        return False
+
+    def expect(self, text):
+        if not self.accept(text):
+            token = self.peek()
+            raise self.error('expected %s but found %s' % (text, repr(token.text) if token else 'the end of the file'))
+
+    def identifier(self):
+        token = self.peek()
+        if token is None or token.kind != 'id':
+            raise self.error('expected a name but found %s' % (repr(token.text) if token else 'the end of the file'))
+        self.position += 1
+        return token.text
+
+    # Types
+
+    def is_type(self, offset=0):
+        token = self.peek(offset)
+        if token is None or token.kind != 'id':
+            return False
+        return self.type_of(token.text) is not None or UNSUPPORTED_TYPES.match(token.text) is not None
+
+    def type_of(self, name):
+        if name in self.structs:
+            return Type('struct', struct=self.structs[name])
+        if name == 'void':
+            return numeric('void')
+        if name == 'matrix':
+            return numeric('float', 4, 4)
+        if name == 'vector':
+            return numeric('float', 4)
+        match = re.match(r'^([a-z0-9]+?)([1-4])(x([1-4]))?$', name)
+        if match and match.group(1) in SCALARS:
+            base = SCALARS[match.group(1)]
+            if match.group(3):
+                return numeric(base, int(match.group(4)), int(match.group(2)))
+            return numeric(base, int(match.group(2)))
+        if name in SCALARS:
+            return numeric(SCALARS[name])
+        return None
+
+    def parse_modifiers(self):
+        modifiers = set()
+        while self.peek() is not None and self.peek().kind == 'id' and self.peek().text in self.MODIFIERS:
+            modifiers.add(self.peek().text)
+            self.position += 1
+        return modifiers
+
+    def parse_type(self):
+        name = self.identifier()
+        if UNSUPPORTED_TYPES.match(name):
+            raise HlslError('%s: %s is not supported, shaders that sample textures stay on the GPU' % (self.tokens[self.position - 1].where, name))
+        result = self.type_of(name)
+        if result is None:
+            raise HlslError('%s: unknown type %s' % (self.tokens[self.position - 1].where, name))
+        if self.at('<'):
+            raise self.error('templated types are not supported')
+        return result
+
+    def parse_array_suffix(self):
+        if self.accept('['):
+            length = self.parse_expression()
+            self.expect(']')
+            return length
+        return None
+
+    def parse_semantic(self):
+        if self.accept(':'):
+            if self.accept('register'):
+                self.expect('(')
+                register = self.identifier()
+                self.expect(')')
+                return None, register
+            return self.identifier(), None
+        return None, None
+
+    # Top level
+
+    def parse(self):
+        while self.peek() is not None:
+            if self.accept(';'):
+                continue
+            if self.at('['):
+                raise self.error('attributes are not supported, hull and domain shaders stay on the GPU')
+            if self.accept('cbuffer'):
+                self.parse_cbuffer()
+            elif self.at('struct') and self.peek(2) is not None and self.peek(2).text == '{':
+                self.position += 1
+                self.parse_struct()
+            else:
+                self.parse_declaration()
+        return self
+
+    def parse_cbuffer(self):
+        where = self.where()
+        name = self.identifier()
+        register = None
+        if self.accept(':'):
+            self.expect('register')
+            self.expect('(')
+            register = self.identifier()
+            self.expect(')')
+        if register is None or not re.match(r'^b\d+$', register):
+            raise HlslError('%s: cbuffer %s needs a b register' % (where, name))
+        self.expect('{')
+        members = []
+        while not self.accept('}'):
+            modifiers = self.parse_modifiers()
+            member_type = self.parse_type()
+            while True:
+                member_name = self.identifier()
+                length = self.parse_array_suffix()
+                self.parse_semantic()
+                members.append((member_type, member_name, length, 'row_major' in modifiers))
+                if not self.accept(','):
+                    break
+            self.expect(';')
+        self.accept(';')
+        self.declarations.append(Node('cbuffer', where, name=name, register=int(register[1:]), members=members))
+
+    def parse_struct(self):
+        where = self.where()
+        name = self.identifier()
+        self.expect('{')
+        fields = []
+        while not self.accept('}'):
+            self.parse_modifiers()
+            field_type = self.parse_type()
+            while True:
+                field_name = self.identifier()
+                if self.at('['):
+                    raise self.error('arrays in structs are not supported')
+                semantic, _ = self.parse_semantic()
+                fields.append((field_type, field_name, semantic))
+                if not self.accept(','):
+                    break
+            self.expect(';')
+        self.expect(';')
+        if name in self.structs:
+            raise HlslError('%s: struct %s is defined twice' % (where, name))
+        self.structs[name] = StructDef(name, fields)
+
+    def parse_declaration(self):
+        where = self.where()
+        modifiers = self.parse_modifiers()
+        declared_type = self.parse_type()
+        name = self.identifier()
+        if self.accept('('):
+            self.parse_function(where, declared_type, name)
+            return
+        while True:
+            length = self.parse_array_suffix()
+            self.parse_semantic()
+            initialiser = None
+            if self.accept('='):
+                initialiser = self.parse_initialiser()
+            if 'static' not in modifiers:
+                raise HlslError('%s: global %s would be a constant buffer member, only static globals are supported' % (where, name))
+            self.declarations.append(Node('global', where, type=declared_type, name=name, length=length,
+                                     initialiser=initialiser, const='const' in modifiers))
+            if not self.accept(','):
+                break
+            name = self.identifier()
+        self.expect(';')
+
+    def parse_function(self, where, return_type, name):
+        params = []
+        if not self.accept(')'):
+            while True:
+                modifiers = self.parse_modifiers()
+                param_type = self.parse_type()
+                param_name = self.identifier()
+                if self.at('['):
+                    raise self.error('array parameters are not supported')
+                semantic, _ = self.parse_semantic()
+                if self.at('='):
+                    raise self.error('default parameters are not supported')
+                qualifier = 'inout' if 'inout' in modifiers or {'in', 'out'} <= modifiers else 'out' if 'out' in modifiers else 'in'
+                params.append(Node('param', where, qualifier=qualifier, type=param_type, name=param_name, semantic=semantic))
+                if self.accept(')'):
+                    break
+                self.expect(',')
+        semantic = None
+        if self.accept(':'):
+            semantic = self.identifier()
+        if self.accept(';'):
+            return
+        body = self.parse_block()
+        if name in self.functions:
+            raise HlslError('%s: overloaded functions are not supported (%s)' % (where, name))
+        self.functions[name] = Node('function', where, return_type=return_type, name=name, params=params,
+                                    semantic=semantic, body=body)
+
+    # Statements
+
+    def parse_block(self):
+        where = self.where()
+        self.expect('{')
+        statements = []
+        while not self.accept('}'):
+            if self.peek() is None:
+                raise self.error('unterminated block')
+            statements.append(self.parse_statement())
+        return Node('block', where, statements=statements)
+
+    def parse_statement(self):
+        where = self.where()
+        while self.at('['):
+            # [unroll], [loop], [branch] and [flatten] only advise the compiler
+            while not self.accept(']'):
+                self.position += 1
+        if self.at('{'):
+            return self.parse_block()
+        if self.accept(';'):
+            return Node('block', where, statements=[])
+        if self.accept('if'):
+            self.expect('(')
+            condition = self.parse_expression()
+            self.expect(')')
+            then = self.parse_statement()
+            otherwise = self.parse_statement() if self.accept('else') else None
+            return Node('if', where, condition=condition, then=then, otherwise=otherwise)
+        if self.accept('for'):
+            self.expect('(')
+            init = None
+            if not self.accept(';'):
+                init = self.parse_simple_statement()
+                self.expect(';')
+            condition = None if self.at(';') else self.parse_expression()
+            self.expect(';')
+            step = None if self.at(')') else self.parse_expression()
+            self.expect(')')
+            body = self.parse_statement()
+            return Node('loop', where, init=init, condition=condition, step=step, body=body)
+        if self.accept('while'):
+            self.expect('(')
+            condition = self.parse_expression()
+            self.expect(')')
+            body = self.parse_statement()
+            return Node('loop', where, init=None, condition=condition, step=None, body=body)
+        if self.accept('do'):
+            raise self.error('do loops are not supported')
+        if self.accept('switch'):
+            raise self.error('switch is not supported')
+        if self.accept('return'):
+            value = None if self.at(';') else self.parse_expression()
+            self.expect(';')
+            return Node('return', where, value=value)
+        for jump in ('break', 'continue', 'discard'):
+            if self.accept(jump):
+                self.expect(';')
+                return Node(jump, where)
+        statement = self.parse_simple_statement()
+        self.expect(';')
+        return statement
+
+    def parse_simple_statement(self):
+        where = self.where()
+        offset = 0
+        while self.peek(offset) is not None and self.peek(offset).text in self.MODIFIERS:
+            offset += 1
+        if self.is_type(offset) and self.peek(offset + 1) is not None and self.peek(offset + 1).kind == 'id':
+            modifiers = self.parse_modifiers()
+            if 'static' in modifiers:
+                raise self.error('static locals are not supported')
+            declared_type = self.parse_type()
+            declarations = []
+            while True:
+                name = self.identifier()
+                if self.at('['):
+                    raise self.error('local arrays are not supported')
+                initialiser = self.parse_initialiser() if self.accept('=') else None
+                declarations.append(Node('declare', where, type=declared_type, name=name, initialiser=initialiser))
+                if not self.accept(','):
+                    break
+            return Node('block', where, statements=declarations, scoped=False)
+        return Node('expression', where, value=self.parse_expression())
+
+    def parse_initialiser(self):
+        where = self.where()
+        if self.accept('{'):
+            items = []
+            while not self.accept('}'):
+                items.append(self.parse_initialiser())
+                if not self.accept(','):
+                    self.expect('}')
+                    break
+            return Node('list', where, items=items)
+        return self.parse_assignment()
+
+    # Expressions
+
+    def parse_expression(self):
+        where = self.where()
+        items = [self.parse_assignment()]
+        while self.accept(','):
+            items.append(self.parse_assignment())
+        return items[0] if len(items) == 1 else Node('comma', where, items=items)
+
+    def parse_assignment(self):
+        where = self.where()
+        target = self.parse_ternary()
+        for op in ('=', '+=', '-=', '*=', '/=', '%='):
+            if self.accept(op):
+                value = self.parse_assignment()
+                return Node('assign', where, op=op[:-1], target=target, value=value)
+        for op in ('&=', '|=', '^=', '<<=', '>>='):
+            if self.at(op):
+                raise self.error('%s is not supported' % op)
+        return target
+
+    def parse_ternary(self):
+        where = self.where()
+        condition = self.parse_binary(0)
+        if self.accept('?'):
+            a = self.parse_assignment()
+            self.expect(':')
+            b = self.parse_assignment()
+            return Node('ternary', where, condition=condition, a=a, b=b)
+        return condition
+
+    BINARY = [['||'], ['&&'], ['|'], ['^'], ['&'], ['==', '!='], ['<', '>', '<=', '>='], ['<<', '>>'],
+              ['+', '-'], ['*', '/', '%']]
+
+    def parse_binary(self, level):
+        if level == len(self.BINARY):
+            return self.parse_unary()
+        where = self.where()
+        left = self.parse_binary(level + 1)
+        while True:
+            token = self.peek()
+            if token is None or token.kind != 'op' or token.text not in self.BINARY[level]:
+                return left
+            self.position += 1
+            right = self.parse_binary(level + 1)
+            left = Node('binary', where, op=token.text, a=left, b=right)
+
+    def parse_unary(self):
+        where = self.where()
+        for op in ('-', '+', '!', '~'):
+            if self.accept(op):
+                return Node('unary', where, op=op, value=self.parse_unary())
+        for op in ('++', '--'):
+            if self.accept(op):
+                return Node('increment', where, op=op[0], target=self.parse_unary(), prefix=True)
+        if self.at('(') and self.is_type(1) and self.peek(2) is not None and self.peek(2).text == ')':
+            self.position += 1
+            cast_type = self.parse_type()
+            self.expect(')')
+            return Node('cast', where, type=cast_type, value=self.parse_unary())
+        return self.parse_postfix()
+
+    def parse_postfix(self):
+        value = self.parse_primary()
+        while True:
+            where = self.where()
+            if self.accept('.'):
+                value = Node('member', where, value=value, name=self.identifier())
+            elif self.accept('['):
+                index = self.parse_expression()
+                self.expect(']')
+                value = Node('index', where, value=value, index=index)
+            elif self.at('++') or self.at('--'):
+                op = self.peek().text[0]
+                self.position += 1
+                value = Node('increment', where, op=op, target=value, prefix=False)
+            else:
+                return value
+
+    def parse_primary(self):
+        where = self.where()
+        token = self.peek()
+        if token is None:
+            raise self.error('unexpected end of file')
+        if token.kind == 'num':
+            self.position += 1
+            return Node('number', where, value=parse_number(token.text), integer=is_integer_literal(token.text))
+        if self.accept('('):
+            value = self.parse_expression()
+            self.expect(')')
+            return value
+        if self.accept('true'):
+            return Node('bool', where, value=True)
+        if self.accept('false'):
+            return Node('bool', where, value=False)
+        if token.kind == 'id':
+            if self.type_of(token.text) is not None and self.peek(1) is not None and self.peek(1).text == '(':
+                constructed = self.parse_type()
+                self.expect('(')
+                return Node('construct', where, type=constructed, args=self.parse_arguments())
+            name = self.identifier()
+            if self.accept('('):
+                return Node('call', where, name=name, args=self.parse_arguments())
+            return Node('name', where, name=name)
+        raise self.error('unexpected %r' % token.text)
+
+    def parse_arguments(self):
+        args = []
+        if self.accept(')'):
+            return args
+        while True:
+            args.append(self.parse_assignment())
+            if self.accept(')'):
+                return args
+            self.expect(',')
+
+
+def parse_number(text):
+    if text.lower().startswith('0x'):
+        return float(int(text.rstrip('uU'), 16))
+    return float(text.rstrip('fFhHuU'))
+
+
+def is_integer_literal(text):
+    return not re.search(r'[.eEfFhH]', text) or text.lower().startswith('0x')
+
+
+# Constants
+
+def to_float32(value):
+    try:
+        return struct.unpack('f', struct.pack('f', value))[0]
+    except OverflowError:
+        return math.copysign(float('inf'), value)
+
+
+def cpp_float(value):
+    # Shortest text that reads back as the same 32-bit float
+    target = to_float32(value)
+    if math.isinf(target):
+        return '(%sstd::numeric_limits<float>::infinity())' % ('-' if target < 0 else '')
+    if math.isnan(target):
+        return 'std::numeric_limits<float>::quiet_NaN()'
+    for precision in range(1, 10):
+        text = '%.*g' % (precision, target)
+        if to_float32(float(text)) == target:
+            break
+    if 'e' not in text and '.' not in text:
+        text += '.0'
+    return text + 'f'
+
+
+def literal(value):
+    if isinstance(value, bool):
+        return 'Mask::All()' if value else 'Mask::None()'
+    return cpp_float(value)
+
+
+def is_constant(leaf):
+    return not isinstance(leaf, str)
+
+
+class Value(object):
+    # leaves are Python bools and floats for constants, or the C++ expression of a Float or Mask. targets, when
+    # the value can be assigned to, are the Variable and leaf index each leaf is stored in.
+    def __init__(self, value_type, leaves, targets=None):
+        self.type = value_type
+        self.leaves = list(leaves)
+        self.targets = targets
+
+
+class Variable(object):
+    # region is where the variable was declared, so writes made in the same region need no mask. Out parameters,
+    # results and members can be read by whoever called, so they are always written through the mask.
+    def __init__(self, var_type, names, region, masked):
+        self.type = var_type
+        self.names = names
+        self.region = region
+        self.masked = masked
+
+
+class ArrayElement(object):
+    # An element of a static or constant buffer array, read a leaf at a time so that only what is used is gathered
+    def __init__(self, array, index, element_type, first):
+        self.array = array
+        self.index = index
+        self.type = element_type
+        self.first = first
+
+
+class StaticArray(object):
+    def __init__(self, name, element_type, length, values):
+        self.name = name
+        self.element_type = element_type
+        self.length = length
+        self.values = values
+
+
+class ConstantArray(object):
+    # An array in a constant buffer, each element a 16 byte register
+    def __init__(self, expression, element_type, length):
+        self.expression = expression
+        self.element_type = element_type
+        self.length = length
+
+
+def fold(op, a, b, base):
+    if op == '+':
+        result = a + b
+    elif op == '-':
+        result = a - b
+    elif op == '*':
+        result = a * b
+    elif op in ('/', '%'):
+        if b == 0.0:
+            return None
+        if op == '%':
+            result = math.fmod(a, b)
+        elif base == 'float':
+            result = a / b
+        else:
+            result = float(math.trunc(a / b))
+    elif op == '<':
+        return a < b
+    elif op == '<=':
+        return a <= b
+    elif op == '>':
+        return a > b
+    elif op == '>=':
+        return a >= b
+    elif op == '==':
+        return a == b
+    elif op == '!=':
+        return a != b
+    else:
+        return None
+    return to_float32(result) if base == 'float' else float(result)
+
+
+UNARY_INTRINSICS = {
+    'abs': ('Abs', abs),
+    'floor': ('Floor', math.floor),
+    'ceil': ('Ceil', math.ceil),
+    'round': ('Round', lambda x: float(round(x))),
+    'trunc': ('Trunc', math.trunc),
+    'frac': ('Frac', lambda x: x - math.floor(x)),
+    'sqrt': ('Sqrt', lambda x: math.sqrt(x) if x >= 0 else float('nan')),
+    'rsqrt': ('Rsqrt', lambda x: 1.0 / math.sqrt(x) if x > 0 else float('inf') if x == 0 else float('nan')),
+    'sin': ('Sin', math.sin),
+    'cos': ('Cos', math.cos),
+    'tan': ('Tan', math.tan),
+    'exp': ('Exp', math.exp),
+    'exp2': ('Exp2', lambda x: 2.0 ** x),
+    'log': ('Log', lambda x: math.log(x) if x > 0 else float('-inf')),
+    'log2': ('Log2', lambda x: math.log(x, 2) if x > 0 else float('-inf')),
+    'saturate': ('Saturate', lambda x: min(max(x, 0.0), 1.0)),
+    'sign': ('Sign', lambda x: float((x > 0) - (x < 0))),
+}
+
+BINARY_INTRINSICS = {
+    'min': ('Min', min),
+    'max': ('Max', max),
+    'pow': ('Pow', lambda x, y: x ** y if x > 0 or y == int(y) else float('nan')),
+    'fmod': ('Fmod', lambda x, y: math.fmod(x, y) if y != 0 else float('nan')),
+}
+
+
+# Translation
+
+class Shader(object):
+    def __init__(self, path, name, parser, depends):
+        self.path = path
+        self.name = name
+        self.parser = parser
+        self.depends = depends
+
+
+class Region(object):
+    # A stretch of code every lane enters with the same mask: a function body, a branch or a loop
+    def __init__(self, parent):
+        self.parent = parent
+
+
+class LoopState(object):
+    def __init__(self, number, jumps):
+        self.number = number
+        self.jumps = jumps
+
+
+class FunctionEmitter(object):
+    def __init__(self, translator, function):
+        self.translator = translator
+        self.function = function
+        self.lines = []
+        self.depth = 1
+        self.next_temp = 0
+        self.next_label = 0
+        self.scopes = [{}]
+        self.region = Region(None)
+        self.loops = []
+        self.used = set()
+        self.stored = set()
+        self.uses_mask = False
+        self.uses_live = False
+
+    # Output
+
+    def line(self, text):
+        self.lines.append('\t' * self.depth + text)
+
+    def open(self, header=None):
+        if header is not None:
+            self.line(header)
+        self.line('{')
+        self.depth += 1
+
+    def close(self):
+        self.depth -= 1
+        self.line('}')
+
+    def temp(self, base, expression):
+        name = 't%d' % self.next_temp
+        self.next_temp += 1
+        self.line('const %s %s = %s;' % ('Mask' if base == 'bool' else 'Float', name, expression))
+        return name
+
+    def label(self):
+        self.next_label += 1
+        return self.next_label
+
+    def mask(self):
+        self.uses_mask = True
+        return 'mask'
+
+    def live(self):
+        self.uses_live = True
+        return 'live'
+
+    def use(self, leaf):
+        if isinstance(leaf, str):
+            self.used.update(re.findall(r'\b[vr]_\w+', leaf))
+        return leaf
+
+    def text(self, leaf):
+        return literal(leaf) if is_constant(leaf) else self.use(leaf)
+
+    def error(self, node, message):
+        return HlslError('%s: %s' % (node.where, message))
+
+    # Names
+
+    def lookup(self, name):
+        for scope in reversed(self.scopes):
+            if name in scope:
+                return scope[name]
+        return self.translator.lookup_global(name)
+
+    def declare(self, node, name, var_type, names=None, masked=False):
+        if name in self.scopes[-1]:
+            raise self.error(node, '%s is declared twice' % name)
+        if names is None:
+            names = [join('v_' + name, suffix) for suffix, _ in var_type.leaves()]
+            taken = set(n for scope in self.scopes for variable in scope.values() if isinstance(variable, Variable) for n in variable.names)
+            if any(n in taken for n in names):
+                # A shadowing declaration in a nested block, given a name C++ will not confuse with the outer one
+                names = [join('v_%s%d' % (name, self.label()), suffix) for suffix, _ in var_type.leaves()]
+        variable = Variable(var_type, names, self.region, masked)
+        self.scopes[-1][name] = variable
+        return variable
+
+    # Leaf operations
+
+    def convert(self, leaf, source, target):
+        if source == target or (source != 'bool' and target in ('int', 'uint') and source in ('int', 'uint')):
+            return leaf
+        if target == 'bool':
+            if is_constant(leaf):
+                return leaf != 0.0
+            return self.temp('bool', 'ToMask(%s)' % self.use(leaf))
+        if source == 'bool':
+            if is_constant(leaf):
+                return 1.0 if leaf else 0.0
+            return self.temp('float', 'ToFloat(%s)' % self.use(leaf))
+        if target in ('int', 'uint') and source == 'float':
+            if is_constant(leaf):
+                return float(math.trunc(leaf))
+            return self.temp('float', 'Trunc(%s)' % self.use(leaf))
+        if target == 'uint' and source == 'int' and is_constant(leaf) and leaf < 0:
+            return leaf + 4294967296.0
+        return leaf
+
+    def arithmetic(self, op, a, b, base):
+        if is_constant(a) and is_constant(b):
+            folded = fold(op, a, b, base)
+            if folded is not None:
+                return folded
+        x, y = self.text(a), self.text(b)
+        if op == '%':
+            return self.temp('float', 'Fmod(%s, %s)' % (x, y))
+        if op == '/' and base != 'float':
+            return self.temp('float', 'Trunc(%s / %s)' % (x, y))
+        return self.temp('float', '%s %s %s' % (x, op, y))
+
+    def compare(self, op, a, b):
+        if is_constant(a) and is_constant(b):
+            return fold(op, a, b, 'float')
+        return self.temp('bool', '%s %s %s' % (self.text(a), op, self.text(b)))
+
+    def logical(self, op, a, b):
+        if is_constant(a) and is_constant(b):
+            return (a and b) if op == '&&' else (a or b) if op == '||' else (a == b) if op == '==' else (a != b)
+        if op in ('&&', '||'):
+            if is_constant(a):
+                a, b = b, a
+            if is_constant(b):
+                return (a if b else False) if op == '&&' else (True if b else a)
+            return self.temp('bool', '%s %s %s' % (self.text(a), '&' if op == '&&' else '|', self.text(b)))
+        x, y = self.text(a), self.text(b)
+        differ = '(AndNot(%s, %s) | AndNot(%s, %s))' % (x, y, y, x)
+        return self.temp('bool', differ if op == '!=' else '!' + differ)
+
+    def select(self, condition, a, b, base):
+        if is_constant(condition):
+            return a if condition else b
+        if is_constant(a) and is_constant(b) and a == b and type(a) == type(b):
+            return a
+        return self.temp(base, 'Select(%s, %s, %s)' % (self.use(condition), self.text(a), self.text(b)))
+
+    def call_leaf(self, function, leaves, fold_function, base='float'):
+        if all(is_constant(leaf) for leaf in leaves) and fold_function is not None:
+            try:
+                return to_float32(float(fold_function(*leaves)))
+            except (ValueError, OverflowError, ZeroDivisionError):
+                pass
+        return self.temp(base, '%s(%s)' % (function, ', '.join(self.text(leaf) for leaf in leaves)))
+
+    def add_all(self, leaves):
+        total = leaves[0]
+        for leaf in leaves[1:]:
+            total = self.arithmetic('+', total, leaf, 'float')
+        return total
+
+    # Values
+
+    def materialise(self, value):
+        if isinstance(value, ArrayElement):
+            return self.read_element(value)
+        if isinstance(value, (StaticArray, ConstantArray)):
+            raise HlslError('%s: arrays can only be indexed' % self.function.where)
+        return value
+
+    def read_element(self, element):
+        leaves = []
+        base_leaves = element.type.leaves()
+        for i in range(len(base_leaves)):
+            base = base_leaves[i][1]
+            leaf_index = element.first + i
+            array = element.array
+            index = element.index
+            if isinstance(array, StaticArray):
+                values = [array.values[n][leaf_index] for n in range(array.length)]
+                if is_constant(index):
+                    n = int(index)
+                    leaves.append(values[n] if 0 <= n < array.length else (False if base == 'bool' else 0.0))
+                elif all(v == values[0] for v in values):
+                    leaves.append(values[0])
+                else:
+                    table = self.translator.table(array, leaf_index)
+                    leaves.append(self.temp('float', 'Gather(%s, 1, %d, %s)' % (table, array.length, self.use(index))))
+                    if base == 'bool':
+                        leaves[-1] = self.temp('bool', 'ToMask(%s)' % leaves[-1])
+            else:
+                register, component = divmod(leaf_index, 4)
+                if register:
+                    raise self.error(self.function, 'constant buffer arrays of more than a float4 are not supported')
+                if is_constant(index):
+                    n = int(index)
+                    if 0 <= n < array.length:
+                        leaves.append('Float(%s[%d][%d])' % (array.expression, n, component))
+                    else:
+                        leaves.append(0.0)
+                else:
+                    leaves.append(self.temp('float', 'Gather(&%s[0][%d], 4, %d, %s)' % (array.expression, component, array.length, self.use(index))))
+        return Value(element.type, leaves)
+
+    def cast(self, node, value, target):
+        value = self.materialise(value)
+        if target.kind == 'struct' or value.type.kind == 'struct':
+            if not target.same(value.type):
+                raise self.error(node, 'cannot convert %s to %s' % (value.type.name(), target.name()))
+            return value
+        if value.type.is_matrix() != target.is_matrix() and not value.type.is_scalar():
+            if target.is_scalar():
+                return self.cast(node, Value(numeric(value.type.base), value.leaves[:1]), target)
+            if value.type.count() != target.count():
+                raise self.error(node, 'cannot convert %s to %s' % (value.type.name(), target.name()))
+            leaves = value.leaves
+        elif value.type.is_matrix():
+            if value.type.rows < target.rows or value.type.size < target.size:
+                raise self.error(node, 'cannot convert %s to %s' % (value.type.name(), target.name()))
+            leaves = [value.leaves[r * value.type.size + c] for r in range(target.rows) for c in range(target.size)]
+        elif value.type.is_scalar():
+            leaves = value.leaves * target.count()
+        else:
+            if value.type.size < target.count():
+                raise self.error(node, 'cannot convert %s to %s' % (value.type.name(), target.name()))
+            leaves = value.leaves[:target.count()]
+        return Value(target, [self.convert(leaf, value.type.base, target.base) for leaf in leaves])
+
+    def promote(self, node, a, b, base=None):
+        # The common shape two operands of an operator are widened or truncated to
+        a, b = self.materialise(a), self.materialise(b)
+        for value in (a, b):
+            if value.type.kind != 'numeric':
+                raise self.error(node, '%s cannot be used in an expression' % value.type.name())
+        if base is None:
+            bases = (a.type.base, b.type.base)
+            base = 'float' if 'float' in bases else 'uint' if 'uint' in bases else 'int' if 'int' in bases else 'bool'
+        if a.type.is_matrix() or b.type.is_matrix():
+            shape = a.type if a.type.is_matrix() else b.type
+            if a.type.is_matrix() and b.type.is_matrix() and (a.type.rows, a.type.size) != (b.type.rows, b.type.size):
+                raise self.error(node, 'cannot combine %s and %s' % (a.type.name(), b.type.name()))
+            result = numeric(base, shape.size, shape.rows)
+        elif a.type.is_scalar():
+            result = numeric(base, b.type.size)
+        elif b.type.is_scalar():
+            result = numeric(base, a.type.size)
+        else:
+            result = numeric(base, min(a.type.size, b.type.size))
+        return self.cast(node, a, result), self.cast(node, b, result), result
+
+    # Expressions
+
+    def expression(self, node):
+        handler = getattr(self, 'expression_' + node.kind, None)
+        if handler is None:
+            raise self.error(node, '%s cannot be used here' % node.kind)
+        return handler(node)
+
+    def value(self, node):
+        return self.materialise(self.expression(node))
+
+    def expression_number(self, node):
+        return Value(numeric('int' if node.integer else 'float'), [node.value if node.integer else to_float32(node.value)])
+
+    def expression_bool(self, node):
+        return Value(numeric('bool'), [node.value])
+
+    def expression_name(self, node):
+        variable = self.lookup(node.name)
+        if variable is None:
+            raise self.error(node, 'unknown name %s' % node.name)
+        if isinstance(variable, Value):
+            return variable
+        if isinstance(variable, (StaticArray, ConstantArray)):
+            return variable
+        return Value(variable.type, list(variable.names), [(variable, i) for i in range(len(variable.names))])
+
+    def expression_member(self, node):
+        value = self.expression(node.value)
+        if isinstance(value, ArrayElement):
+            if value.type.kind == 'struct':
+                field_type, offset = value.type.struct.field(node.name)
+                if field_type is None:
+                    raise self.error(node, '%s has no member %s' % (value.type.name(), node.name))
+                return ArrayElement(value.array, value.index, field_type, value.first + offset)
+            value = self.materialise(value)
+        if isinstance(value, (StaticArray, ConstantArray)):
+            raise self.error(node, 'arrays have no members')
+        if value.type.kind == 'struct':
+            field_type, offset = value.type.struct.field(node.name)
+            if field_type is None:
+                raise self.error(node, '%s has no member %s' % (value.type.name(), node.name))
+            count = field_type.count()
+            return Value(field_type, value.leaves[offset:offset + count], value.targets[offset:offset + count] if value.targets else None)
+        if value.type.is_matrix():
+            match = re.match(r'^(_m([0-3])([0-3]))+$', node.name) or re.match(r'^(_([1-4])([1-4]))+$', node.name)
+            if not match:
+                raise self.error(node, 'bad matrix member %s' % node.name)
+            one_based = not node.name.startswith('_m')
+            picks = []
+            for element in re.findall(r'_m?(\d)(\d)', node.name):
+                r, c = int(element[0]) - one_based, int(element[1]) - one_based
+                if r >= value.type.rows or c >= value.type.size:
+                    raise self.error(node, '%s is outside %s' % (node.name, value.type.name()))
+                picks.append(r * value.type.size + c)
+        else:
+            sets = ('xyzw', 'rgba')
+            chosen = [s for s in sets if all(ch in s for ch in node.name)]
+            if not chosen or len(node.name) > 4:
+                raise self.error(node, 'bad swizzle %s' % node.name)
+            picks = [chosen[0].index(ch) for ch in node.name]
+            if any(p >= value.type.size for p in picks):
+                raise self.error(node, '%s is outside %s' % (node.name, value.type.name()))
+        targets = None
+        if value.targets and len(set(picks)) == len(picks):
+            targets = [value.targets[p] for p in picks]
+        return Value(numeric(value.type.base, len(picks)), [value.leaves[p] for p in picks], targets)
+
+    def expression_index(self, node):
+        value = self.expression(node.value)
+        index = self.cast(node, self.value(node.index), numeric('int'))
+        if isinstance(value, (StaticArray, ConstantArray)):
+            element_type = value.element_type
+            return ArrayElement(value, index.leaves[0], element_type, 0)
+        value = self.materialise(value)
+        if value.type.kind != 'numeric' or value.type.is_scalar():
+            raise self.error(node, '%s cannot be indexed' % value.type.name())
+        if not is_constant(index.leaves[0]):
+            raise self.error(node, 'vectors and matrices can only be indexed by constants')
+        n = int(index.leaves[0])
+        if value.type.is_matrix():
+            if not 0 <= n < value.type.rows:
+                raise self.error(node, 'row %d is outside %s' % (n, value.type.name()))
+            picks = [n * value.type.size + c for c in range(value.type.size)]
+        else:
+            if not 0 <= n < value.type.size:
+                raise self.error(node, 'component %d is outside %s' % (n, value.type.name()))
+            picks = [n]
+        targets = [value.targets[p] for p in picks] if value.targets else None
+        return Value(numeric(value.type.base, len(picks)), [value.leaves[p] for p in picks], targets)
+
+    def expression_unary(self, node):
+        value = self.value(node.value)
+        if value.type.kind != 'numeric':
+            raise self.error(node, '%s cannot be negated' % value.type.name())
+        if node.op == '+':
+            return value
+        if node.op == '!':
+            value = self.cast(node, value, numeric('bool', value.type.size, value.type.rows))
+            return Value(value.type, [(not leaf) if is_constant(leaf) else self.temp('bool', '!' + self.use(leaf)) for leaf in value.leaves])
+        if node.op == '-':
+            if value.type.base == 'bool':
+                value = self.cast(node, value, numeric('int', value.type.size, value.type.rows))
+            return Value(value.type, [-leaf if is_constant(leaf) else self.temp('float', '-' + self.use(leaf)) for leaf in value.leaves])
+        raise self.error(node, '~ is not supported')
+
+    def expression_cast(self, node):
+        return self.cast(node, self.value(node.value), node.type)
+
+    def expression_binary(self, node):
+        op = node.op
+        if op in ('&', '|', '^', '<<', '>>'):
+            raise self.error(node, 'bitwise %s is not supported' % op)
+        a, b = self.value(node.a), self.value(node.b)
+        if op in ('&&', '||'):
+            a, b, result = self.promote(node, a, b, 'bool')
+            return Value(result, [self.logical(op, x, y) for x, y in zip(a.leaves, b.leaves)])
+        a, b, result = self.promote(node, a, b)
+        if op in ('<', '<=', '>', '>=', '==', '!='):
+            if result.base == 'bool':
+                if op not in ('==', '!='):
+                    a, b, result = self.promote(node, a, b, 'int')
+                else:
+                    return Value(result, [self.logical(op, x, y) for x, y in zip(a.leaves, b.leaves)])
+            return Value(numeric('bool', result.size, result.rows), [self.compare(op, x, y) for x, y in zip(a.leaves, b.leaves)])
+        if result.base == 'bool':
+            a, b, result = self.promote(node, a, b, 'int')
+        return Value(result, [self.arithmetic(op, x, y, result.base) for x, y in zip(a.leaves, b.leaves)])
+
+    def expression_ternary(self, node):
+        condition = self.value(node.condition)
+        a, b = self.value(node.a), self.value(node.b)
+        if a.type.kind == 'struct':
+            if not a.type.same(b.type):
+                raise self.error(node, 'both sides of ?: must have the same type')
+            result = a.type
+            base_leaves = result.leaves()
+        else:
+            a, b, result = self.promote(node, a, b)
+            base_leaves = result.leaves()
+        if not condition.type.is_scalar():
+            condition = self.cast(node, condition, numeric('bool', result.size, result.rows))
+            conditions = condition.leaves
+        else:
+            conditions = self.cast(node, condition, numeric('bool')).leaves * len(base_leaves)
+        leaves = [self.select(c, x, y, base) for c, x, y, (_, base) in zip(conditions, a.leaves, b.leaves, base_leaves)]
+        return Value(result, leaves)
+
+    def expression_comma(self, node):
+        for item in node.items[:-1]:
+            self.expression(item)
+        return self.expression(node.items[-1])
+
+    def expression_assign(self, node):
+        target = self.materialise(self.expression(node.target))
+        if target.targets is None:
+            raise self.error(node, 'cannot assign to this expression')
+        value = self.value(node.value)
+        if node.op:
+            value = self.binary_value(node, node.op, target, value)
+        value = self.cast(node, value, target.type)
+        self.store(target, value)
+        return Value(target.type, [self.current(t) for t in target.targets], target.targets)
+
+    def binary_value(self, node, op, a, b):
+        return self.expression_binary(Node('binary', node.where, op=op, a=Node('value', node.where, value=a), b=Node('value', node.where, value=b)))
+
+    def expression_value(self, node):
+        return node.value
+
+    def expression_increment(self, node):
+        target = self.materialise(self.expression(node.target))
+        if target.targets is None or target.type.kind != 'numeric':
+            raise self.error(node, 'cannot %s this expression' % ('increment' if node.op == '+' else 'decrement'))
+        old = Value(target.type, list(target.leaves))
+        if not node.prefix:
+            old = Value(target.type, [self.temp(base, self.use(leaf)) for leaf, (_, base) in zip(target.leaves, target.type.leaves())])
+        one = Value(numeric('int'), [1.0])
+        self.store(target, self.cast(node, self.binary_value(node, node.op, old, one), target.type))
+        if node.prefix:
+            return Value(target.type, [self.current(t) for t in target.targets], target.targets)
+        return old
+
+    def current(self, target):
+        variable, leaf = target
+        return variable.names[leaf]
+
+    def store(self, target, value):
+        names = [self.current(t) for t in target.targets]
+        leaves = list(value.leaves)
+        for i, leaf in enumerate(leaves):
+            if isinstance(leaf, str) and any(re.search(r'\b%s\b' % re.escape(name), leaf) for name in names[:i]):
+                # Read before an earlier leaf of the same assignment overwrites it, as in v.xy = v.yx
+                leaves[i] = self.temp(target.type.leaves()[i][1], self.use(leaf))
+        for (variable, _), name, leaf in zip(target.targets, names, leaves):
+            if variable.masked or variable.region is not self.region:
+                self.line('%s = Select(%s, %s, %s);' % (name, self.mask(), self.text(leaf), name))
+            else:
+                self.line('%s = %s;' % (name, self.text(leaf)))
+            self.use(name)
+            self.stored.add(name)
+
+    def expression_construct(self, node):
+        target = node.type
+        if target.kind == 'struct':
+            raise self.error(node, 'structs cannot be constructed')
+        args = [self.value(arg) for arg in node.args]
+        if len(args) == 1 and args[0].type.kind == 'numeric' and (args[0].type.is_scalar() or args[0].type.count() >= target.count()):
+            return self.cast(node, args[0], target)
+        leaves = []
+        for arg in args:
+            if arg.type.kind != 'numeric':
+                raise self.error(node, '%s cannot be used to construct %s' % (arg.type.name(), target.name()))
+            leaves.extend(self.convert(leaf, arg.type.base, target.base) for leaf in arg.leaves)
+        if len(leaves) != target.count():
+            raise self.error(node, '%s needs %d components, not %d' % (target.name(), target.count(), len(leaves)))
+        return Value(target, leaves)
+
+    def expression_list(self, node):
+        raise self.error(node, 'initialiser lists are only supported for static globals')
+
+    # Intrinsics and calls
+
+    def float_args(self, node, count):
+        if len(node.args) != count:
+            raise self.error(node, '%s takes %d arguments' % (node.name, count))
+        args = [self.value(arg) for arg in node.args]
+        for arg in args:
+            if arg.type.kind != 'numeric':
+                raise self.error(node, '%s cannot take %s' % (node.name, arg.type.name()))
+        return args
+
+    def same_shape(self, node, args):
+        # Widens the arguments of a componentwise intrinsic to the largest of them, all as floats
+        shape = max((arg.type for arg in args), key=lambda t: t.count())
+        shape = numeric('float', shape.size, shape.rows)
+        return [self.cast(node, arg, shape) for arg in args], shape
+
+    def vector_arg(self, node, value):
+        if not value.type.is_vector():
+            raise self.error(node, '%s takes vectors' % node.name)
+        return self.cast(node, value, numeric('float', value.type.size))
+
+    def dot(self, a, b):
+        return self.add_all([self.arithmetic('*', x, y, 'float') for x, y in zip(a.leaves, b.leaves)])
+
+    def scale(self, value, factor):
+        return Value(value.type, [self.arithmetic('*', leaf, factor, 'float') for leaf in value.leaves])
+
+    def expression_call(self, node):
+        name = node.name
+        if name in self.translator.functions:
+            return self.call_function(node)
+        if name in UNARY_INTRINSICS:
+            (arg,), shape = self.same_shape(node, self.float_args(node, 1))
+            function, fold_function = UNARY_INTRINSICS[name]
+            return Value(shape, [self.call_leaf(function, [leaf], fold_function) for leaf in arg.leaves])
+        if name in BINARY_INTRINSICS:
+            (a, b), shape = self.same_shape(node, self.float_args(node, 2))
+            function, fold_function = BINARY_INTRINSICS[name]
+            return Value(shape, [self.call_leaf(function, [x, y], fold_function) for x, y in zip(a.leaves, b.leaves)])
+        if name == 'clamp':
+            (x, low, high), shape = self.same_shape(node, self.float_args(node, 3))
+            return Value(shape, [self.call_leaf('Min', [self.call_leaf('Max', [v, l], max), h], min) for v, l, h in zip(x.leaves, low.leaves, high.leaves)])
+        if name == 'lerp':
+            (a, b, t), shape = self.same_shape(node, self.float_args(node, 3))
+            return Value(shape, [self.arithmetic('+', x, self.arithmetic('*', self.arithmetic('-', y, x, 'float'), s, 'float'), 'float')
+                                 for x, y, s in zip(a.leaves, b.leaves, t.leaves)])
+        if name == 'step':
+            (edge, x), shape = self.same_shape(node, self.float_args(node, 2))
+            return Value(shape, [self.convert(self.compare('>=', v, e), 'bool', 'float') for e, v in zip(edge.leaves, x.leaves)])
+        if name == 'smoothstep':
+            (low, high, x), shape = self.same_shape(node, self.float_args(node, 3))
+            leaves = []
+            for l, h, v in zip(low.leaves, high.leaves, x.leaves):
+                t = self.call_leaf('Saturate', [self.arithmetic('/', self.arithmetic('-', v, l, 'float'), self.arithmetic('-', h, l, 'float'), 'float')], UNARY_INTRINSICS['saturate'][1])
+                leaves.append(self.arithmetic('*', self.arithmetic('*', t, t, 'float'), self.arithmetic('-', 3.0, self.arithmetic('*', 2.0, t, 'float'), 'float'), 'float'))
+            return Value(shape, leaves)
+        if name == 'dot':
+            a, b = [self.vector_arg(node, arg) for arg in self.float_args(node, 2)]
+            return Value(numeric('float'), [self.dot(a, b)])
+        if name == 'length':
+            a = self.vector_arg(node, self.float_args(node, 1)[0])
+            return Value(numeric('float'), [self.call_leaf('Sqrt', [self.dot(a, a)], UNARY_INTRINSICS['sqrt'][1])])
+        if name == 'distance':
+            a, b = [self.vector_arg(node, arg) for arg in self.float_args(node, 2)]
+            d = Value(a.type, [self.arithmetic('-', x, y, 'float') for x, y in zip(a.leaves, b.leaves)])
+            return Value(numeric('float'), [self.call_leaf('Sqrt', [self.dot(d, d)], UNARY_INTRINSICS['sqrt'][1])])
+        if name == 'normalize':
+            a = self.vector_arg(node, self.float_args(node, 1)[0])
+            length = self.call_leaf('Sqrt', [self.dot(a, a)], UNARY_INTRINSICS['sqrt'][1])
+            return Value(a.type, [self.arithmetic('/', leaf, length, 'float') for leaf in a.leaves])
+        if name == 'cross':
+            a, b = [self.cast(node, arg, numeric('float', 3)) for arg in self.float_args(node, 2)]
+            x, y = a.leaves, b.leaves
+            return Value(a.type, [self.arithmetic('-', self.arithmetic('*', x[(i + 1) % 3], y[(i + 2) % 3], 'float'),
+                                                  self.arithmetic('*', x[(i + 2) % 3], y[(i + 1) % 3], 'float'), 'float') for i in range(3)])
+        if name == 'reflect':
+            (i, n), shape = self.same_shape(node, self.float_args(node, 2))
+            twice = self.arithmetic('*', 2.0, self.dot(n, i), 'float')
+            return Value(shape, [self.arithmetic('-', x, self.arithmetic('*', twice, y, 'float'), 'float') for x, y in zip(i.leaves, n.leaves)])
+        if name == 'mul':
+            return self.multiply(node, *self.float_args(node, 2))
+        if name in ('any', 'all'):
+            (arg,) = self.float_args(node, 1)
+            arg = self.cast(node, arg, numeric('bool', arg.type.size, arg.type.rows))
+            result = arg.leaves[0]
+            for leaf in arg.leaves[1:]:
+                result = self.logical('||' if name == 'any' else '&&', result, leaf)
+            return Value(numeric('bool'), [result])
+        if name == 'sincos':
+            if len(node.args) != 3:
+                raise self.error(node, 'sincos takes 3 arguments')
+            (x,), shape = self.same_shape(node, [self.value(node.args[0])])
+            for out_arg, (function, fold_function) in zip(node.args[1:], (UNARY_INTRINSICS['sin'], UNARY_INTRINSICS['cos'])):
+                target = self.materialise(self.expression(out_arg))
+                if target.targets is None:
+                    raise self.error(node, 'sincos writes to its last two arguments')
+                result = Value(shape, [self.call_leaf(function, [leaf], fold_function) for leaf in x.leaves])
+                self.store(target, self.cast(node, result, target.type))
+            return Value(numeric('float'), [0.0])
+        if name == 'clip':
+            (arg,) = self.float_args(node, 1)
+            below = self.compare('<', arg.leaves[0], 0.0)
+            for leaf in arg.leaves[1:]:
+                below = self.logical('||', below, self.compare('<', leaf, 0.0))
+            self.discard_lanes(below)
+            return Value(numeric('float'), [0.0])
+        raise self.error(node, 'unknown function %s' % name)
+
+    def multiply(self, node, a, b):
+        if a.type.is_scalar() or b.type.is_scalar():
+            a, b, result = self.promote(node, a, b, 'float')
+            return Value(result, [self.arithmetic('*', x, y, 'float') for x, y in zip(a.leaves, b.leaves)])
+        a = self.cast(node, a, numeric('float', a.type.size, a.type.rows))
+        b = self.cast(node, b, numeric('float', b.type.size, b.type.rows))
+        # Vectors are a row on the left and a column on the right
+        a_rows, a_cols = (a.type.rows, a.type.size) if a.type.is_matrix() else (1, a.type.size)
+        b_rows, b_cols = (b.type.rows, b.type.size) if b.type.is_matrix() else (b.type.size, 1)
+        if a_cols != b_rows:
+            raise self.error(node, 'cannot multiply %s by %s' % (a.type.name(), b.type.name()))
+        leaves = []
+        for r in range(a_rows):
+            for c in range(b_cols):
+                leaves.append(self.add_all([self.arithmetic('*', a.leaves[r * a_cols + k], b.leaves[k * b_cols + c], 'float') for k in range(a_cols)]))
+        if a.type.is_matrix() and b.type.is_matrix():
+            return Value(numeric('float', b_cols, a_rows), leaves)
+        return Value(numeric('float', len(leaves)), leaves)
+
+    def call_function(self, node):
+        callee = self.translator.functions[node.name]
+        if len(node.args) != len(callee.params):
+            raise self.error(node, '%s takes %d arguments' % (node.name, len(callee.params)))
+        if callee is self.function or node.name in self.translator.calling:
+            raise self.error(node, 'recursion is not supported')
+        emitter = self.translator.emit_function(callee)
+        arguments = [self.mask()]
+        inputs = []
+        for param, arg in zip(callee.params, node.args):
+            if param.qualifier == 'in':
+                value = self.cast(node, self.value(arg), param.type)
+                for leaf, (_, base) in zip(value.leaves, param.type.leaves()):
+                    inputs.append((len(arguments), base))
+                    arguments.append(self.text(leaf))
+                continue
+            target = self.materialise(self.expression(arg))
+            if target.targets is None:
+                raise self.error(node, 'argument for %s %s must be assignable' % (param.qualifier, param.name))
+            if not target.type.same(param.type):
+                raise self.error(node, '%s %s needs a %s, not a %s' % (param.qualifier, param.name, param.type.name(), target.type.name()))
+            # The callee writes through its own mask, so any variable is safe to hand it
+            for variable, leaf in target.targets:
+                arguments.append(self.use(variable.names[leaf]))
+                self.stored.add(variable.names[leaf])
+        # In arguments are read by reference, so one the callee could write to through an out parameter or as a
+        # member is copied as HLSL would
+        positions = set(position for position, _ in inputs)
+        written = set(argument for position, argument in enumerate(arguments) if position and position not in positions)
+        for position, base in inputs:
+            if arguments[position] in written or arguments[position].startswith('g_'):
+                arguments[position] = self.temp(base, arguments[position])
+        result = None
+        if not self.translator.is_void(callee.return_type):
+            leaves = []
+            for _, base in callee.return_type.leaves():
+                name = 't%d' % self.next_temp
+                self.next_temp += 1
+                self.line('%s %s = %s;' % ('Mask' if base == 'bool' else 'Float', name, 'Mask::None()' if base == 'bool' else '0.0f'))
+                leaves.append(name)
+            arguments.extend(leaves)
+            result = Value(callee.return_type, leaves)
+        self.line('f_%s(%s);' % (node.name, ', '.join(arguments)))
+        if emitter.may_discard:
+            self.after_discard()
+        return result if result is not None else Value(numeric('float'), [0.0])
+
+    # Discards
+
+    def discard_lanes(self, condition):
+        if is_constant(condition) and not condition:
+            return
+        lanes = self.mask() if is_constant(condition) else '%s & %s' % (self.mask(), self.use(condition))
+        self.line('discarded = discarded | %s;' % lanes)
+        self.translator.current_may_discard = True
+        if is_constant(condition):
+            self.line('live = AndNot(%s, mask);' % self.live())
+            self.line('mask = Mask::None();')
+        else:
+            self.after_discard()
+
+    def after_discard(self):
+        self.line('live = AndNot(live, discarded);')
+        self.line('mask = AndNot(mask, discarded);')
+        self.uses_live = True
+        self.uses_mask = True
+
+    # Statements
+
+    def statement(self, node):
+        # Returns True once no lane can reach the rest of the block
+        handler = getattr(self, 'statement_' + node.kind)
+        return handler(node)
+
+    def statement_block(self, node):
+        scoped = getattr(node, 'scoped', True)
+        if scoped:
+            self.scopes.append({})
+            if node.statements:
+                self.open()
+        done = False
+        for statement in node.statements:
+            if self.statement(statement):
+                done = True
+                break
+        if scoped:
+            if node.statements:
+                self.close()
+            self.scopes.pop()
+        return done
+
+    def statement_declare(self, node):
+        if self.translator.is_void(node.type):
+            raise self.error(node, 'void variables are not allowed')
+        if node.initialiser is not None:
+            if node.initialiser.kind == 'list':
+                raise self.error(node, 'initialiser lists are only supported for static globals')
+            value = self.cast(node, self.value(node.initialiser), node.type)
+        else:
+            value = Value(node.type, [False if base == 'bool' else 0.0 for _, base in node.type.leaves()])
+        variable = self.declare(node, node.name, node.type)
+        for name, leaf, (_, base) in zip(variable.names, value.leaves, node.type.leaves()):
+            self.line('%s %s = %s;' % ('Mask' if base == 'bool' else 'Float', name, self.text(leaf)))
+        return False
+
+    def statement_expression(self, node):
+        self.expression(node.value)
+        return False
+
+    def statement_if(self, node):
+        condition = self.cast(node, self.value(node.condition), numeric('bool'))
+        leaf = condition.leaves[0]
+        if is_constant(leaf):
+            branch = node.then if leaf else node.otherwise
+            if branch is None:
+                return False
+            return self.branch(branch, None)
+        number = self.label()
+        exits = self.translator.exits(node.then) | (self.translator.exits(node.otherwise) if node.otherwise else set())
+        self.open()
+        self.line('const Mask outer%d = %s;' % (number, self.mask()))
+        self.line('const Mask cond%d = %s;' % (number, self.use(leaf)))
+        self.line('mask = outer%d & cond%d;' % (number, number))
+        then_done = self.branch(node.then, 'if (Any(mask))')
+        else_done = False
+        if node.otherwise is not None:
+            self.line('mask = AndNot(outer%d, cond%d);' % (number, number))
+            else_done = self.branch(node.otherwise, 'if (Any(mask))')
+        self.line('mask = %s;' % self.merge('outer%d' % number, exits))
+        self.close()
+        return then_done and else_done
+
+    def branch(self, node, header):
+        region = self.region
+        self.region = Region(region)
+        self.scopes.append({})
+        if header is not None:
+            self.line(header)
+        self.open()
+        statements = node.statements if node.kind == 'block' else [node]
+        done = False
+        for statement in statements:
+            if self.statement(statement):
+                done = True
+                break
+        self.close()
+        self.scopes.pop()
+        self.region = region
+        return done if header is None else False
+
+    def merge(self, outer, exits):
+        terms = [outer]
+        if exits & {'return', 'discard'}:
+            terms.append(self.live())
+        if exits & {'break', 'continue'} and self.loops:
+            terms.append('iter%d' % self.loops[-1].number)
+        return ' & '.join(terms)
+
+    def statement_loop(self, node):
+        number = self.label()
+        exits = self.translator.exits(node.body)
+        jumps = exits & {'break', 'continue'}
+        self.scopes.append({})
+        self.open()
+        if node.init is not None:
+            self.statement(node.init)
+        self.line('const Mask outer%d = %s;' % (number, self.mask()))
+        self.line('Mask loop%d = outer%d;' % (number, number))
+        region = self.region
+        self.region = Region(region)
+        self.loops.append(LoopState(number, jumps))
+        self.line('for (;;)')
+        self.open()
+        if exits & {'return', 'discard'}:
+            self.line('loop%d = loop%d & %s;' % (number, number, self.live()))
+        self.line('mask = loop%d;' % number)
+        if node.condition is not None:
+            condition = self.cast(node, self.value(node.condition), numeric('bool')).leaves[0]
+            if is_constant(condition):
+                if not condition:
+                    self.line('break;')
+            else:
+                self.line('loop%d = loop%d & %s;' % (number, number, self.use(condition)))
+                self.line('mask = loop%d;' % number)
+        self.line('if (!Any(mask))')
+        self.line('\tbreak;')
+        if jumps:
+            self.line('Mask iter%d = loop%d;' % (number, number))
+        self.scopes.append({})
+        self.open()
+        statements = node.body.statements if node.body.kind == 'block' else [node.body]
+        for statement in statements:
+            if self.statement(statement):
+                break
+        self.close()
+        self.scopes.pop()
+        if exits:
+            self.line('mask = loop%d%s;' % (number, ' & live' if exits & {'return', 'discard'} else ''))
+        if node.step is not None:
+            self.expression(node.step)
+        self.close()
+        self.loops.pop()
+        self.region = region
+        self.line('mask = %s;' % self.merge('outer%d' % number, exits - {'break', 'continue'}))
+        self.close()
+        self.scopes.pop()
+        return False
+
+    def statement_break(self, node):
+        return self.jump(node, True)
+
+    def statement_continue(self, node):
+        return self.jump(node, False)
+
+    def jump(self, node, leave):
+        if not self.loops:
+            raise self.error(node, '%s outside a loop' % node.kind)
+        number = self.loops[-1].number
+        if leave:
+            self.line('loop%d = AndNot(loop%d, mask);' % (number, number))
+        self.line('iter%d = AndNot(iter%d, mask);' % (number, number))
+        self.line('mask = Mask::None();')
+        return True
+
+    def statement_discard(self, node):
+        self.discard_lanes(True)
+        return True
+
+    def statement_return(self, node):
+        function = self.function
+        void = self.translator.is_void(function.return_type)
+        if void != (node.value is None):
+            raise self.error(node, 'return needs a value' if not void else '%s returns nothing' % function.name)
+        if not void:
+            value = self.cast(node, self.value(node.value), function.return_type)
+            names = ['r_%d' % i for i in range(len(value.leaves))]
+            simple = self.region.parent is None and not self.returned
+            for name, leaf in zip(names, value.leaves):
+                if simple:
+                    self.line('%s = %s;' % (name, self.text(leaf)))
+                else:
+                    self.line('%s = Select(%s, %s, %s);' % (name, self.mask(), self.text(leaf), name))
+                self.use(name)
+        self.returned = True
+        if self.region.parent is not None:
+            self.line('live = AndNot(%s, %s);' % (self.live(), self.mask()))
+            self.line('mask = Mask::None();')
+        return True
+
+    # Functions
+
+    DECLARATION = re.compile(r'^\s*(?:const )?(?:Float|Mask) (\w+) = .*;$')
+
+    def prune(self):
+        # Drops declarations nothing reads, such as the temps of a struct member that was never used, until
+        # none are left, then works out which parameters are still read
+        while True:
+            text = '\n'.join(self.lines)
+            counts = {}
+            for name in re.findall(r'\b[tv]\w*', text):
+                counts[name] = counts.get(name, 0) + 1
+            kept = []
+            for line in self.lines:
+                match = self.DECLARATION.match(line)
+                if match and counts.get(match.group(1), 0) == 1:
+                    continue
+                kept.append(line)
+            if len(kept) == len(self.lines):
+                break
+            self.lines = kept
+        text = '\n'.join(self.lines)
+        self.used = set(re.findall(r'\b[vr]_\w+', text))
+        self.uses_mask = self.uses_mask and re.search(r'\bmask\b', text) is not None
+        self.uses_live = self.uses_live and re.search(r'\blive\b', text) is not None
+
+    def emit(self):
+        function = self.function
+        self.returned = False
+        self.translator.current_may_discard = False
+        params = []
+        for param in function.params:
+            variable = self.declare(param, param.name, param.type, masked=param.qualifier != 'in')
+            for name, (_, base) in zip(variable.names, param.type.leaves()):
+                params.append((('Mask&' if base == 'bool' else 'Float&') if param.qualifier != 'in' else ('const Mask&' if base == 'bool' else 'const Float&'), name))
+        results = []
+        if not self.translator.is_void(function.return_type):
+            for i, (_, base) in enumerate(function.return_type.leaves()):
+                results.append(('Mask&' if base == 'bool' else 'Float&', 'r_%d' % i))
+        self.statement_block(Node('block', function.where, statements=function.body.statements, scoped=False))
+        self.may_discard = self.translator.current_may_discard
+        self.prune()
+
+        # Everything is passed by reference, as 32-bit x86 cannot pass 32 byte aligned values, so an in parameter the
+        # function writes to is copied first
+        signature = ['const Mask& entry' if self.uses_mask or self.uses_live else 'const Mask&']
+        prologue = []
+        for kind, name in params + results:
+            if name not in self.used:
+                signature.append(kind)
+            elif kind.startswith('const ') and name in self.stored:
+                signature.append('%s a%s' % (kind, name[1:]))
+                prologue.append('\t\t\t\t%s %s = a%s;' % (kind[6:-1], name, name[1:]))
+            else:
+                signature.append('%s %s' % (kind, name))
+        header = ['\t\t\tvoid f_%s(%s)' % (function.name, ', '.join(signature)), '\t\t\t{']
+        if self.uses_mask:
+            prologue.append('\t\t\t\tMask mask = entry;')
+        if self.uses_live:
+            prologue.append('\t\t\t\tMask live = entry;')
+        if prologue and self.lines:
+            prologue.append('')
+        body = ['\t\t\t' + line for line in self.lines]
+        return header + prologue + body + ['\t\t\t}']
+
+
+class Translator(object):
+    def __init__(self, shader):
+        self.shader = shader
+        parser = shader.parser
+        self.functions = parser.functions
+        self.globals = {}
+        self.tables = []
+        self.table_names = {}
+        self.members = []
+        self.emitted = {}
+        self.emit_order = []
+        self.calling = []
+        self.current_may_discard = False
+        self.constant_buffers = []
+
+        if 'main' not in self.functions:
+            raise HlslError('%s: no main function' % shader.name)
+        self.reachable = set()
+        self.find_reachable(self.functions['main'])
+        self.written = self.find_written()
+        registers = set()
+        for node in parser.declarations:
+            if node.kind == 'cbuffer':
+                if node.register in registers:
+                    raise HlslError('%s: register b%d is used twice' % (node.where, node.register))
+                registers.add(node.register)
+                self.lay_out_cbuffer(node)
+            else:
+                self.add_global(node)
+
+    def is_void(self, value_type):
+        return value_type.kind == 'numeric' and value_type.base == 'void'
+
+    def lookup_global(self, name):
+        return self.globals.get(name)
+
+    # Analysis
+
+    def find_reachable(self, function):
+        if function.name in self.reachable:
+            return
+        self.reachable.add(function.name)
+        for node in walk(function.body):
+            if node.kind == 'call' and node.name in self.functions:
+                self.find_reachable(self.functions[node.name])
+
+    def find_written(self):
+        # Globals some reachable function assigns to, which become members of the kernel
+        written = set()
+        for name in self.reachable:
+            function = self.functions[name]
+            local = set(param.name for param in function.params)
+            for node in walk(function.body):
+                if node.kind == 'declare':
+                    local.add(node.name)
+                target = None
+                if node.kind in ('assign', 'increment'):
+                    target = node.target
+                elif node.kind == 'call' and node.name in self.functions:
+                    for param, arg in zip(self.functions[node.name].params, node.args):
+                        if param.qualifier != 'in':
+                            written.update(root_name(arg) - local)
+                elif node.kind == 'call' and node.name == 'sincos':
+                    for arg in node.args[1:]:
+                        written.update(root_name(arg) - local)
+                if target is not None:
+                    written.update(root_name(target) - local)
+        return written
+
+    def exits(self, node):
+        # How lanes can leave partway through node: return, discard, and break or continue of the loop around it
+        found = set()
+        for child in walk(node):
+            if child.kind in ('return', 'discard'):
+                found.add(child.kind)
+            elif child.kind == 'call' and (child.name == 'clip' or (child.name in self.functions and self.can_discard(child.name))):
+                found.add('discard')
+        for child in walk(node, into_loops=False):
+            if child.kind in ('break', 'continue'):
+                found.add(child.kind)
+        return found
+
+    def can_discard(self, name, seen=None):
+        seen = seen or set()
+        if name in seen:
+            return False
+        seen.add(name)
+        for node in walk(self.functions[name].body):
+            if node.kind == 'discard' or (node.kind == 'call' and node.name == 'clip'):
+                return True
+            if node.kind == 'call' and node.name in self.functions and self.can_discard(node.name, seen):
+                return True
+        return False
+
+    # Globals
+
+    def lay_out_cbuffer(self, cbuffer):
+        fields = []
+        offset = 0
+        padding = 0
+        slot = 'b%d' % cbuffer.register
+        for member_type, name, length_node, row_major in cbuffer.members:
+            if member_type.kind != 'numeric':
+                raise HlslError('%s: only scalars, vectors and matrices are supported in constant buffers' % cbuffer.where)
+            if member_type.base == 'bool':
+                raise HlslError('%s: bools in constant buffers are not supported' % cbuffer.where)
+            expression = 'constants.%s.%s' % (slot, name)
+            if length_node is not None:
+                length = int(self.evaluate_constant(length_node, numeric('int'))[0])
+                if member_type.rows or member_type.size > 4:
+                    raise HlslError('%s: arrays of matrices in constant buffers are not supported' % cbuffer.where)
+                offset, padding = pad_to(fields, offset, 16, padding)
+                fields.append('\t\t\t\tfloat %s[%d][4];' % (name, length))
+                # HLSL packs the last element of an array tightly, but the next member starts a new register
+                # whenever it would straddle one, so rounding the array up only moves the padding
+                offset += 16 * length
+                self.globals[name] = ConstantArray(expression, member_type, length)
+                continue
+            if member_type.rows:
+                offset, padding = pad_to(fields, offset, 16, padding)
+                # Column major by default: each column fills a register
+                columns, rows = member_type.size, member_type.rows
+                if row_major:
+                    fields.append('\t\t\t\tfloat %s[%d][4];' % (name, rows))
+                    leaves = ['Float(%s[%d][%d])' % (expression, r, c) for r in range(rows) for c in range(columns)]
+                    offset += 16 * rows
+                else:
+                    fields.append('\t\t\t\tfloat %s[%d][4];' % (name, columns))
+                    leaves = ['Float(%s[%d][%d])' % (expression, c, r) for r in range(rows) for c in range(columns)]
+                    offset += 16 * columns
+                self.globals[name] = Value(member_type, leaves)
+                continue
+            size = 4 * member_type.size
+            if offset // 16 != (offset + size - 1) // 16:
+                offset, padding = pad_to(fields, offset, 16, padding)
+            if member_type.size == 1:
+                fields.append('\t\t\t\tfloat %s;' % name)
+                leaves = ['Float(%s)' % expression]
+            else:
+                fields.append('\t\t\t\tfloat %s[%d];' % (name, member_type.size))
+                leaves = ['Float(%s[%d])' % (expression, i) for i in range(member_type.size)]
+            offset += size
+            self.globals[name] = Value(member_type, leaves)
+        offset, padding = pad_to(fields, offset, 16, padding)
+        self.constant_buffers.append((cbuffer.name, slot, fields, offset))
+
+    def add_global(self, node):
+        name = node.name
+        value_type = node.type
+        if node.length is not None:
+            length = int(self.evaluate_constant(node.length, numeric('int'))[0])
+            if name in self.written:
+                raise HlslError('%s: writing to the static array %s is not supported' % (node.where, name))
+            count = value_type.count()
+            if node.initialiser is None:
+                flat = [0.0] * (count * length)
+            else:
+                flat = self.evaluate_flat(node.initialiser)
+                if len(flat) != count * length:
+                    raise HlslError('%s: %s needs %d values, not %d' % (node.where, name, count * length, len(flat)))
+            values = []
+            for n in range(length):
+                element = flat[n * count:(n + 1) * count]
+                values.append([bool(v) if base == 'bool' else to_float32(float(v)) for v, (_, base) in zip(element, value_type.leaves())])
+            self.globals[name] = StaticArray(name, value_type, length, values)
+            return
+        if node.initialiser is None:
+            leaves = [False if base == 'bool' else 0.0 for _, base in value_type.leaves()]
+        else:
+            leaves = self.evaluate_constant(node.initialiser, value_type)
+        if name in self.written:
+            names = [join('g_' + name, suffix) for suffix, _ in value_type.leaves()]
+            variable = Variable(value_type, names, None, True)
+            self.members.append((variable, leaves))
+            self.globals[name] = variable
+        else:
+            self.globals[name] = Value(value_type, leaves)
+
+    def evaluate_flat(self, node):
+        # The components of a constant initialiser, in order, as the flattening of {} lists reads them
+        if node.kind == 'list':
+            flat = []
+            for item in node.items:
+                flat.extend(self.evaluate_flat(item))
+            return flat
+        if node.kind == 'name':
+            value = self.globals.get(node.name)
+            if isinstance(value, Value) and all(is_constant(leaf) for leaf in value.leaves):
+                return list(value.leaves)
+            raise HlslError('%s: %s is not a constant' % (node.where, node.name))
+        value = self.evaluate(node)
+        return list(value.leaves)
+
+    def evaluate(self, node):
+        # Runs a constant expression through an emitter and insists nothing was left to run time
+        emitter = FunctionEmitter(self, Node('function', node.where, name='', params=[], return_type=numeric('void'), body=None))
+        value = emitter.value(node)
+        if emitter.lines or not all(is_constant(leaf) for leaf in value.leaves):
+            raise HlslError('%s: initialisers of static globals must be constant' % node.where)
+        return value
+
+    def evaluate_constant(self, node, value_type):
+        if node.kind == 'list':
+            flat = self.evaluate_flat(node)
+            if len(flat) != value_type.count():
+                raise HlslError('%s: %s needs %d values, not %d' % (node.where, value_type.name(), value_type.count(), len(flat)))
+            return [bool(v) if base == 'bool' else to_float32(float(v)) for v, (_, base) in zip(flat, value_type.leaves())]
+        emitter = FunctionEmitter(self, Node('function', node.where, name='', params=[], return_type=numeric('void'), body=None))
+        value = emitter.cast(node, emitter.value(node), value_type)
+        if emitter.lines or not all(is_constant(leaf) for leaf in value.leaves):
+            raise HlslError('%s: initialisers of static globals must be constant' % node.where)
+        return value.leaves
+
+    def table(self, array, leaf):
+        key = (array.name, leaf)
+        if key not in self.table_names:
+            suffix = array.element_type.leaves()[leaf][0]
+            name = join('s_' + array.name, suffix)
+            self.table_names[key] = name
+            values = [array.values[n][leaf] for n in range(array.length)]
+            self.tables.append((name, [1.0 if v is True else 0.0 if v is False else v for v in values]))
+        return self.table_names[key]
+
+    # Functions
+
+    def emit_function(self, function):
+        if function.name in self.emitted:
+            return self.emitted[function.name]
+        self.calling.append(function.name)
+        saved = self.current_may_discard
+        emitter = FunctionEmitter(self, function)
+        emitter.code = emitter.emit()
+        self.current_may_discard = saved
+        self.calling.pop()
+        self.emitted[function.name] = emitter
+        self.emit_order.append(emitter)
+        return emitter
+
+    def translate(self):
+        main = self.functions['main']
+        emitter = self.emit_function(main)
+        inputs = []
+        first = 0
+        for param in main.params:
+            if param.qualifier != 'in':
+                raise HlslError('%s: main cannot have out parameters' % main.where)
+            for field_type, semantic in semantics(param.type, param.semantic, param.where):
+                inputs.append((semantic, first, field_type.count()))
+                first += field_type.count()
+        outputs = []
+        first_output = 0
+        if self.is_void(main.return_type):
+            raise HlslError('%s: main must return its outputs' % main.where)
+        for field_type, semantic in semantics(main.return_type, main.semantic, main.where):
+            outputs.append((semantic, first_output, field_type.count()))
+            first_output += field_type.count()
+        for _, base in main.return_type.leaves():
+            if base == 'bool':
+                raise HlslError('%s: bool outputs are not supported' % main.where)
+        for param in main.params:
+            for _, base in param.type.leaves():
+                if base == 'bool':
+                    raise HlslError('%s: bool inputs are not supported' % main.where)
+        names = [semantic.upper() for semantic, _, _ in outputs]
+        if any(name.startswith('SV_TARGET') for name in names):
+            stage = 'Pixel'
+        elif 'SV_POSITION' in names:
+            stage = 'Vertex'
+        else:
+            raise HlslError('%s: main writes neither SV_Target nor SV_Position' % main.where)
+        return self.emit_namespace(emitter, inputs, first, outputs, first_output, stage)
+
+    def emit_namespace(self, main, inputs, input_count, outputs, output_count, stage):
+        shader = self.shader
+        lines = ['\t\t// %s, %s shader.' % (os.path.basename(shader.path), stage.lower()), '\t\tnamespace %s' % shader.name, '\t\t{']
+
+        for name, slot, fields, size in self.constant_buffers:
+            lines += ['\t\t\tstruct %s' % name, '\t\t\t{'] + fields + ['\t\t\t};', '']
+            lines.append('\t\t\tstatic_assert(sizeof(%s) == %d, "%s must match the HLSL packing");' % (name, size, name))
+            lines.append('')
+        lines += ['\t\t\tstruct Constants', '\t\t\t{']
+        for name, slot, _, _ in self.constant_buffers:
+            lines.append('\t\t\t\t%s %s;' % (name, slot))
+        lines += ['\t\t\t};', '']
+
+        lines.append('\t\t\tstatic const Element Inputs[] = { %s };' % ', '.join('{ "%s", %d, %d }' % element for element in inputs)
+                     if inputs else '\t\t\tstatic const Element* const Inputs = nullptr;')
+        lines.append('\t\t\tstatic const Element Outputs[] = { %s };' % ', '.join('{ "%s", %d, %d }' % element for element in outputs))
+        lines.append('')
+
+        for name, values in self.tables:
+            lines.append('\t\t\tstatic const float %s[%d] = { %s };' % (name, len(values), ', '.join(cpp_float(v) for v in values)))
+        if self.tables:
+            lines.append('')
+
+        lines += ['\t\t\tclass Kernel', '\t\t\t{', '\t\t\tpublic:']
+        lines.append('\t\t\t\texplicit Kernel(const Constants& constants) : constants(constants), discarded(Mask::None()) {}')
+        lines.append('')
+        lines.append('\t\t\t\t// Runs the shader for the active lanes of input, InputCount Floats, into output, OutputCount Floats, and')
+        lines.append('\t\t\t\t// returns the lanes that were not discarded.')
+        lines.append('\t\t\t\tMask Run(const Float* input, Float* output, const Mask& active)')
+        lines.append('\t\t\t\t{')
+        lines.append('\t\t\t\t\tdiscarded = Mask::None();')
+        for variable, leaves in self.members:
+            for name, leaf in zip(variable.names, leaves):
+                lines.append('\t\t\t\t\t%s = %s;' % (name, literal(leaf)))
+        arguments = ['active']
+        for i in range(input_count):
+            arguments.append('input[%d]' % i)
+        for i in range(output_count):
+            arguments.append('output[%d]' % i)
+        lines.append('\t\t\t\t\tf_main(%s);' % ', '.join(arguments))
+        lines.append('\t\t\t\t\treturn AndNot(active, discarded);')
+        lines.append('\t\t\t\t}')
+        lines += ['', '\t\t\tprivate:']
+        for emitter in self.emit_order:
+            lines += ['\t' + line if line else line for line in emitter.code]
+            lines.append('')
+        lines.append('\t\t\t\tconst Constants& constants;')
+        lines.append('\t\t\t\tMask discarded;')
+        for variable, _ in self.members:
+            for name, (_, base) in zip(variable.names, variable.type.leaves()):
+                lines.append('\t\t\t\t%s %s;' % ('Mask' if base == 'bool' else 'Float', name))
+        lines.append('\t\t\t};')
+        lines.append('')
+        lines.append('\t\t\tinline Mask Run(const void* constants, const Float* input, Float* output, const Mask& active)')
+        lines.append('\t\t\t{')
+        lines.append('\t\t\t\tKernel kernel(*static_cast<const Constants*>(constants));')
+        lines.append('\t\t\t\treturn kernel.Run(input, output, active);')
+        lines.append('\t\t\t}')
+        lines.append('\t\t}')
+
+        position = -1
+        colour = -1
+        for semantic, first, _ in inputs:
+            if semantic.upper() == 'SV_POSITION' and position < 0:
+                position = first
+        for semantic, first, _ in outputs:
+            if semantic.upper().startswith('SV_TARGET') and colour < 0:
+                colour = first
+            if semantic.upper() == 'SV_POSITION' and stage == 'Vertex' and colour < 0:
+                colour = first
+        info = '{ "%s", KernelStage::%s, %d, %d, %d, %d, %s::Inputs, %d, %s::Outputs, %d, sizeof(%s::Constants), %s::Run }' % (
+            shader.name, stage, input_count, output_count, position, colour, shader.name, len(inputs), shader.name, len(outputs), shader.name, shader.name)
+        return lines, info, (input_count, output_count)
+
+
+def root_name(node):
+    while node.kind in ('member', 'index'):
+        node = node.value
+    return {node.name} if node.kind == 'name' else set()
+
+
+def walk(node, into_loops=True):
+    if node is None:
+        return
+    yield node
+    for key, child in list(node.__dict__.items()):
+        if key in ('where', 'kind', 'type'):
+            continue
+        if node.kind == 'loop' and key == 'body' and not into_loops:
+            continue
+        children = child if isinstance(child, list) else [child]
+        for item in children:
+            if isinstance(item, Node):
+                for sub in walk(item, into_loops):
+                    yield sub
+
+
+def semantics(value_type, semantic, where):
+    if value_type.kind == 'struct':
+        result = []
+        for field_type, field_name, field_semantic in value_type.struct.fields:
+            if field_type.kind == 'struct':
+                raise HlslError('%s: nested structs are not supported as shader inputs or outputs' % where)
+            if field_semantic is None:
+                raise HlslError('%s: %s.%s has no semantic' % (where, value_type.name(), field_name))
+            result.append((field_type, field_semantic))
+        return result
+    if semantic is None:
+        raise HlslError('%s: shader inputs and outputs need a semantic' % where)
+    return [(value_type, semantic)]
+
+
+def pad_to(fields, offset, alignment, padding):
+    if offset % alignment:
+        gap = alignment - offset % alignment
+        fields.append('\t\t\t\tfloat padding%d[%d];' % (padding, gap // 4))
+        return offset + gap, padding + 1
+    return offset, padding
+
+
+# Output
+
+def translate(path):
+    depends = []
+    tokens = preprocess(path, {}, set(), depends)
+    parser = Parser(tokens, path).parse()
+    name = os.path.splitext(os.path.basename(path))[0]
+    if not re.match(r'^[A-Za-z_]\w*$', name):
+        raise HlslError('%s: the file name must be a C++ name' % path)
+    translator = Translator(Shader(path, name, parser, depends))
+    return translator.translate()
+
+
+def read_list(path):
+    shaders = []
+    with open(path) as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if line:
+                shaders.append(os.path.join(os.path.dirname(path), line))
+    if not shaders:
+        raise HlslError('%s lists no shaders' % path)
+    return shaders
+
+
+def emit_cpp(namespaces, infos, largest, list_name):
+    lines = [
+        '#pragma once',
+        '',
+        '// Generated by Tools/HlslTranslator.py from %s. Do not edit.' % list_name,
+        '',
+        '#include "ShaderBatch.h"',
+        '#include <cstddef>',
+        '#include <limits>',
+        '',
+        'namespace ACW',
+        '{',
+        '\tnamespace TranslatedShaders',
+        '\t{',
+        '\t\tusing namespace ShaderBatch;',
+        '',
+        '\t\tenum class KernelStage',
+        '\t\t{',
+        '\t\t\tVertex,',
+        '\t\t\tPixel',
+        '\t\t};',
+        '',
+        '\t\t// A shader input or output, as the first of the Floats it takes and their count.',
+        '\t\tstruct Element',
+        '\t\t{',
+        '\t\t\tconst char* semantic;',
+        '\t\t\tint first;',
+        '\t\t\tint count;',
+        '\t\t};',
+        '',
+        '\t\tstruct KernelInfo',
+        '\t\t{',
+        '\t\t\tconst char* name;',
+        '\t\t\tKernelStage stage;',
+        '\t\t\tint inputCount;',
+        '\t\t\tint outputCount;',
+        '\t\t\t// The SV_Position input of a pixel shader, and the SV_Target or SV_Position output, or -1.',
+        '\t\t\tint positionInput;',
+        '\t\t\tint mainOutput;',
+        '\t\t\tconst Element* inputs;',
+        '\t\t\tint inputElementCount;',
+        '\t\t\tconst Element* outputs;',
+        '\t\t\tint outputElementCount;',
+        '\t\t\t// The kernel\'s Constants, each constant buffer under the name of its register.',
+        '\t\t\tsize_t constantsSize;',
+        '\t\t\tMask (*run)(const void* constants, const Float* input, Float* output, const Mask& active);',
+        '\t\t};',
+        '',
+    ]
+    for namespace in namespaces:
+        lines += namespace
+        lines.append('')
+    lines.append('\t\tstatic const KernelInfo Kernels[] =')
+    lines.append('\t\t{')
+    lines += ['\t\t\t%s,' % info for info in infos]
+    lines.append('\t\t};')
+    lines.append('')
+    lines.append('\t\tstatic const int KernelCount = %d;' % len(infos))
+    lines.append('')
+    lines.append('\t\t// The most Floats any kernel reads or writes.')
+    lines.append('\t\tstatic const int MaxKernelFloats = %d;' % largest)
+    lines += ['\t}', '}']
+    return '\n'.join(lines) + '\n'
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='Translate HLSL shaders into C++ kernels that run eight lanes at once.')
+    parser.add_argument('shaders')
+    parser.add_argument('--cpp', required=True)
+    options = parser.parse_args(argv)
+
+    namespaces = []
+    infos = []
+    largest = 0
+    try:
+        for path in read_list(options.shaders):
+            namespace, info, counts = translate(path)
+            namespaces.append(namespace)
+            infos.append(info)
+            largest = max([largest] + list(counts))
+    except HlslError as error:
+        sys.stderr.write('%s: error: %s\n' % (options.shaders, error))
+        return 1
+
+    write_if_changed(options.cpp, '﻿' + emit_cpp(namespaces, infos, largest, os.path.basename(options.shaders)))
+    print('%s: %d shaders translated' % (os.path.basename(options.shaders), len(infos)))
+    return 0
+
+
+def write_if_changed(path, text):
+    # Leave unchanged outputs alone so MSBuild does not recompile their dependants
+    data = text.encode('utf-8')
+    if os.path.exists(path):
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,640 @@
+"""Compiles a .sdf scene description into a specialised HLSL map() and a C++ expression.
+
+Usage: SdfCompiler.py <scene.sdf> --hlsl <out.hlsli> --cpp <out.h> --namespace <Name>
+
+A scene is one s-expression. Numeric arguments come first, child expressions after them:
+
+    primitives   (sphere r) (box x y z) (torus R r) (plane nx ny nz h) (sin-lattice f a) (none)
+    domain       (translate x y z e) (scale s e) (rotate-y degrees e) (repeat x y z e)
+    distance     (distance-scale f e) (add e...) (material id e)
+    booleans     (union e...) (intersect e...) (subtract a b) (smooth-union k e...)
+
+Before emitting, the tree is folded: identity transforms are dropped, nested transforms are
+merged, constant terms are summed, and branches that can never affect the result (such as
+a union with (none) or a zero amplitude lattice) are removed.
+"""
+
+import argparse
+import math
+import os
+import struct
+import sys
+
+# op name -> (number of numeric arguments, minimum children, maximum children)
+OPS = {
+    'none': (0, 0, 0),
+    'sphere': (1, 0, 0),
+    'box': (3, 0, 0),
+    'torus': (2, 0, 0),
+    'plane': (4, 0, 0),
+    'sin-lattice': (2, 0, 0),
+    'translate': (3, 1, 1),
+    'scale': (1, 1, 1),
+    'rotate-y': (1, 1, 1),
+    'repeat': (3, 1, 1),
+    'distance-scale': (1, 1, 1),
+    'material': (1, 1, 1),
+    'add': (0, 1, None),
+    'union': (0, 1, None),
+    'intersect': (0, 1, None),
+    'subtract': (0, 2, 2),
+    'smooth-union': (1, 1, None),
+}
+
+
+# Keeps the step bounds finite for scenes that are constant or purely perturbation
+MinLipschitz = 1e-6
+
+
+class SdfError(Exception):
+    pass
+
+
+class Node(object):
+    def __init__(self, op, args, children):
+        self.op = op
+        self.args = list(args)
+        self.children = list(children)
+
+
+def constant(value):
+    # Internal node produced by folding, never written in a description
+    return Node('constant', [value], [])
+
+
+# Parsing
+
+def tokenize(text):
+    tokens = []
+    for line_number, line in enumerate(text.splitlines(), 1):
+        line = line.split(';', 1)[0]
+        for token in line.replace('(', ' ( ').replace(')', ' ) ').split():
+            tokens.append((token, line_number))
+    return tokens
+
+
+def parse(text):
+    tokens = tokenize(text)
+    if not tokens:
+        raise SdfError('empty scene')
+    node, position = parse_node(tokens, 0)
+    if position != len(tokens):
+        raise SdfError('line %d: unexpected %r after the scene' % (tokens[position][1], tokens[position][0]))
+    return node
+
+
+def parse_node(tokens, position):
+    token, line = tokens[position]
+    if token != '(':
+        raise SdfError('line %d: expected ( but found %r' % (line, token))
+    if position + 1 >= len(tokens):
+        raise SdfError('line %d: unterminated expression' % line)
+    op, line = tokens[position + 1]
+    if op not in OPS:
+        raise SdfError('line %d: unknown operation %r' % (line, op))
+    arg_count, min_children, max_children = OPS[op]
+    position += 2
+
+    args = []
+    children = []
+    while True:
+        if position >= len(tokens):
+            raise SdfError('line %d: unterminated (%s' % (line, op))
+        token, token_line = tokens[position]
+        if token == ')':
+            position += 1
+            break
+        if token == '(':
+            child, position = parse_node(tokens, position)
+            children.append(child)
+            continue
+        if children:
+            raise SdfError('line %d: (%s) arguments must come before its children' % (token_line, op))
+        try:
+            args.append(float(token))
+        except ValueError:
+            raise SdfError('line %d: %r is not a number' % (token_line, token))
+        position += 1
+
+    if len(args) != arg_count:
+        raise SdfError('line %d: (%s) takes %d arguments, got %d' % (line, op, arg_count, len(args)))
+    if len(children) < min_children or (max_children is not None and len(children) > max_children):
+        raise SdfError('line %d: (%s) has the wrong number of children' % (line, op))
+    return Node(op, args, children), position
+
+
+# Folding
+
+def fold(node):
+    children = [fold(child) for child in node.children]
+    op, args = node.op, node.args
+
+    if op == 'translate':
+        child = children[0]
+        if child.op == 'none':
+            return child
+        if child.op == 'translate':
+            return fold(Node('translate', [a + b for a, b in zip(args, child.args)], child.children))
+        if args == [0.0, 0.0, 0.0]:
+            return child
+    elif op == 'scale':
+        child = children[0]
+        if child.op == 'none':
+            return child
+        if child.op == 'scale':
+            return fold(Node('scale', [args[0] * child.args[0]], child.children))
+        if args[0] == 1.0:
+            return child
+    elif op == 'rotate-y':
+        child = children[0]
+        if child.op == 'none':
+            return child
+        if child.op == 'rotate-y':
+            return fold(Node('rotate-y', [args[0] + child.args[0]], child.children))
+        if math.fmod(args[0], 360.0) == 0.0:
+            return child
+    elif op == 'repeat':
+        child = children[0]
+        if child.op == 'none' or args == [0.0, 0.0, 0.0]:
+            return child
+    elif op == 'distance-scale':
+        child = children[0]
+        if child.op == 'none':
+            return child
+        if child.op == 'constant':
+            return constant(args[0] * child.args[0])
+        if child.op == 'distance-scale':
+            return fold(Node('distance-scale', [args[0] * child.args[0]], child.children))
+        if args[0] == 1.0:
+            return child
+    elif op == 'material':
+        child = children[0]
+        if child.op == 'none':
+            return child
+        if child.op == 'material':
+            # The outer material overrides the inner one
+            children = child.children
+    elif op == 'sin-lattice':
+        if args[1] == 0.0:
+            return constant(0.0)
+    elif op == 'add':
+        if any(child.op == 'none' for child in children):
+            return Node('none', [], [])
+        total = sum(child.args[0] for child in children if child.op == 'constant')
+        children = [child for child in children if child.op != 'constant']
+        if not children:
+            return constant(total)
+        if total != 0.0:
+            children.append(constant(total))
+        if len(children) == 1:
+            return children[0]
+    elif op in ('union', 'smooth-union'):
+        if op == 'smooth-union' and args[0] <= 0.0:
+            op, args = 'union', []
+        flat = []
+        for child in children:
+            if child.op == 'none':
+                continue
+            if op == 'union' and child.op == 'union':
+                flat.extend(child.children)
+            else:
+                flat.append(child)
+        children = flat
+        if not children:
+            return Node('none', [], [])
+        if len(children) == 1:
+            return children[0]
+    elif op == 'intersect':
+        if any(child.op == 'none' for child in children):
+            return Node('none', [], [])
+        flat = []
+        for child in children:
+            flat.extend(child.children if child.op == 'intersect' else [child])
+        children = flat
+        if len(children) == 1:
+            return children[0]
+    elif op == 'subtract':
+        if children[0].op == 'none' or children[1].op == 'none':
+            return children[0]
+
+    return Node(op, args, children)
+
+
+# Lipschitz bounds
+
+def bounds(node):
+    """Returns (smooth, perturbation, lipschitz) for the distance field of node.
+
+    The field is split into a smooth part with Lipschitz constant smooth plus a term bounded by
+    +-perturbation (the sine lattices), and lipschitz bounds the field as a whole. Far from the
+    surface the march can then step by the smooth bound instead of the much steeper whole one.
+    """
+    op, args = node.op, node.args
+    if op in ('none', 'constant'):
+        return 0.0, 0.0, 0.0
+    if op in ('sphere', 'box', 'torus'):
+        return 1.0, 0.0, 1.0
+    if op == 'plane':
+        length = math.sqrt(sum(v * v for v in args[:3]))
+        return length, 0.0, length
+    if op == 'sin-lattice':
+        # |grad| of a sin(fx) sin(fy) sin(fz) peaks at a f on the lattice axes
+        return 0.0, abs(args[1]), abs(args[0] * args[1])
+
+    child_bounds = [bounds(child) for child in node.children]
+    if op in ('translate', 'rotate-y', 'repeat', 'material'):
+        return child_bounds[0]
+    if op == 'scale':
+        smooth, perturbation, lipschitz = child_bounds[0]
+        return smooth, perturbation * abs(args[0]), lipschitz
+    if op == 'distance-scale':
+        return tuple(abs(args[0]) * value for value in child_bounds[0])
+    if op == 'add':
+        return tuple(sum(values) for values in zip(*child_bounds))
+    # min, max and the smooth minimum are all 1-Lipschitz in their arguments
+    return tuple(max(values) for values in zip(*child_bounds))
+
+
+def count_nodes(node):
+    return 1 + sum(count_nodes(child) for child in node.children)
+
+
+# Emission
+
+def to_float32(value):
+    return struct.unpack('f', struct.pack('f', value))[0]
+
+
+def hlsl_float(value):
+    # Shortest text that reads back as the same 32-bit float
+    target = to_float32(value)
+    for precision in range(1, 10):
+        text = '%.*g' % (precision, value)
+        if to_float32(float(text)) == target:
+            break
+    if 'e' not in text and '.' not in text:
+        text += '.0'
+    return text
+
+
+def rotation(degrees):
+    # Snap the rounding noise of right angles so that cos(90) is exactly zero
+    radians = math.radians(degrees)
+    return [0.0 if abs(v) < 1e-7 else v for v in (math.cos(radians), math.sin(radians))]
+
+
+def cpp_float(value):
+    text = hlsl_float(value)
+    return text + 'f'
+
+
+class HlslEmitter(object):
+    def __init__(self):
+        self.lines = []
+        self.next_id = 0
+
+    def temp(self, kind, expression):
+        name = '%s%d' % (kind, self.next_id)
+        self.next_id += 1
+        self.lines.append('\tfloat%s %s = %s;' % ('3' if kind == 'p' else '', name, expression))
+        return name
+
+    # Returns (distance expression, material expression or None)
+    def emit(self, node, p):
+        op, a = node.op, [hlsl_float(v) for v in node.args]
+
+        if op == 'none':
+            return '1e10', None
+        if op == 'constant':
+            return a[0], None
+        if op == 'sphere':
+            return self.temp('d', 'length(%s) - %s' % (p, a[0])), None
+        if op == 'box':
+            q = self.temp('p', 'abs(%s) - float3(%s, %s, %s)' % (p, a[0], a[1], a[2]))
+            return self.temp('d', 'length(max(%s, 0.0)) + min(max(%s.x, max(%s.y, %s.z)), 0.0)' % (q, q, q, q)), None
+        if op == 'torus':
+            return self.temp('d', 'length(float2(length(%s.xz) - %s, %s.y)) - %s' % (p, a[0], p, a[1])), None
+        if op == 'plane':
+            return self.temp('d', 'dot(%s, float3(%s, %s, %s)) + %s' % (p, a[0], a[1], a[2], a[3])), None
+        if op == 'sin-lattice':
+            return self.temp('d', '%s * (sin(%s * %s.x) * sin(%s * %s.y) * sin(%s * %s.z))' % (a[1], a[0], p, a[0], p, a[0], p)), None
+        if op == 'translate':
+            q = self.temp('p', '%s - float3(%s, %s, %s)' % (p, a[0], a[1], a[2]))
+            return self.emit(node.children[0], q)
+        if op == 'scale':
+            q = self.temp('p', '%s * %s' % (p, hlsl_float(1.0 / node.args[0])))
+            d, m = self.emit(node.children[0], q)
+            return self.temp('d', '%s * %s' % (d, a[0])), m
+        if op == 'rotate-y':
+            c, s = [hlsl_float(v) for v in rotation(node.args[0])]
+            q = self.temp('p', 'float3(%s * %s.x + %s * %s.z, %s.y, %s * %s.z - %s * %s.x)' % (c, p, s, p, p, c, p, s, p))
+            return self.emit(node.children[0], q)
+        if op == 'repeat':
+            components = []
+            for axis, period in zip('xyz', node.args):
+                if period == 0.0:
+                    components.append('%s.%s' % (p, axis))
+                else:
+                    components.append('%s.%s - %s * round(%s.%s * %s)' % (p, axis, hlsl_float(period), p, axis, hlsl_float(1.0 / period)))
+            q = self.temp('p', 'float3(%s)' % ', '.join(components))
+            return self.emit(node.children[0], q)
+        if op == 'distance-scale':
+            d, m = self.emit(node.children[0], p)
+            return self.temp('d', '%s * %s' % (a[0], d)), m
+        if op == 'material':
+            d, _ = self.emit(node.children[0], p)
+            return d, a[0]
+        if op == 'add':
+            d, m = self.emit(node.children[0], p)
+            terms = [d]
+            for child in node.children[1:]:
+                terms.append(self.emit(child, p)[0])
+            return self.temp('d', ' + '.join(terms)), m
+        if op in ('union', 'intersect', 'smooth-union'):
+            d, m = self.emit(node.children[0], p)
+            for child in node.children[1:]:
+                d2, m2 = self.emit(child, p)
+                m = self.select(d, d2, m, m2, op == 'intersect')
+                if op == 'union':
+                    d = self.temp('d', 'min(%s, %s)' % (d, d2))
+                elif op == 'intersect':
+                    d = self.temp('d', 'max(%s, %s)' % (d, d2))
+                else:
+                    h = self.temp('d', 'saturate(0.5 + %s * (%s - %s))' % (hlsl_float(0.5 / node.args[0]), d2, d))
+                    d = self.temp('d', 'lerp(%s, %s, %s) - %s * %s * (1.0 - %s)' % (d2, d, h, a[0], h, h))
+            return d, m
+        if op == 'subtract':
+            d, m = self.emit(node.children[0], p)
+            d2, _ = self.emit(node.children[1], p)
+            return self.temp('d', 'max(%s, -%s)' % (d, d2)), m
+        raise SdfError('cannot emit %s' % op)
+
+    def select(self, d1, d2, m1, m2, larger):
+        m1 = m1 or '0.0'
+        m2 = m2 or '0.0'
+        if m1 == m2:
+            return m1
+        if larger:
+            m1, m2 = m2, m1
+        return self.temp('m', '(%s < %s) ? %s : %s' % (d1, d2, m1, m2))
+
+
+class HlslDualEmitter(object):
+    """Emits the forward mode version of map(): every value is a Dual from SdfDual.hlsli, and
+    points are three Duals so that the chain rule runs through the domain transforms."""
+
+    def __init__(self):
+        self.lines = []
+        self.next_id = 0
+
+    def temp(self, expression):
+        name = 'n%d' % self.next_id
+        self.next_id += 1
+        self.lines.append('\tDual %s = %s;' % (name, expression))
+        return name
+
+    def emit(self, node, p):
+        op, a = node.op, [hlsl_float(v) for v in node.args]
+        x, y, z = p
+
+        if op == 'none':
+            return 'dualConstant(1e10)'
+        if op == 'constant':
+            return 'dualConstant(%s)' % a[0]
+        if op == 'sphere':
+            return self.temp('dualOffset(dualLength(%s, %s, %s), -%s)' % (x, y, z, a[0]))
+        if op == 'box':
+            q = [self.temp('dualOffset(dualAbs(%s), -%s)' % (c, h)) for c, h in zip(p, a)]
+            outside = self.temp('dualLength(%s)' % ', '.join('dualMax(%s, dualConstant(0.0))' % c for c in q))
+            inside = self.temp('dualMin(dualMax(%s, dualMax(%s, %s)), dualConstant(0.0))' % tuple(q))
+            return self.temp('dualAdd(%s, %s)' % (outside, inside))
+        if op == 'torus':
+            ring = self.temp('dualOffset(dualLength(%s, %s), -%s)' % (x, z, a[0]))
+            return self.temp('dualOffset(dualLength(%s, %s), -%s)' % (ring, y, a[1]))
+        if op == 'plane':
+            return self.temp('dualOffset(dualAdd(dualAdd(dualScale(%s, %s), dualScale(%s, %s)), dualScale(%s, %s)), %s)' % (x, a[0], y, a[1], z, a[2], a[3]))
+        if op == 'sin-lattice':
+            s = [self.temp('dualSin(dualScale(%s, %s))' % (c, a[0])) for c in p]
+            return self.temp('dualScale(dualMul(dualMul(%s, %s), %s), %s)' % (s[0], s[1], s[2], a[1]))
+        if op == 'translate':
+            q = [self.temp('dualOffset(%s, %s)' % (c, hlsl_float(-v))) if v != 0.0 else c for c, v in zip(p, node.args)]
+            return self.emit(node.children[0], q)
+        if op == 'scale':
+            inverse = hlsl_float(1.0 / node.args[0])
+            d = self.emit(node.children[0], [self.temp('dualScale(%s, %s)' % (c, inverse)) for c in p])
+            return self.temp('dualScale(%s, %s)' % (d, a[0]))
+        if op == 'rotate-y':
+            c, s = [hlsl_float(v) for v in rotation(node.args[0])]
+            q = [self.temp('dualAdd(dualScale(%s, %s), dualScale(%s, %s))' % (x, c, z, s)), y,
+                 self.temp('dualSub(dualScale(%s, %s), dualScale(%s, %s))' % (z, c, x, s))]
+            return self.emit(node.children[0], q)
+        if op == 'repeat':
+            q = []
+            for c, period in zip(p, node.args):
+                if period == 0.0:
+                    q.append(c)
+                else:
+                    # round() is flat almost everywhere, so repetition only shifts the value
+                    q.append(self.temp('dualOffset(%s, -%s * round(%s.v * %s))' % (c, hlsl_float(period), c, hlsl_float(1.0 / period))))
+            return self.emit(node.children[0], q)
+        if op == 'distance-scale':
+            return self.temp('dualScale(%s, %s)' % (self.emit(node.children[0], p), a[0]))
+        if op == 'material':
+            return self.emit(node.children[0], p)
+        if op == 'subtract':
+            d = self.emit(node.children[0], p)
+            d2 = self.emit(node.children[1], p)
+            return self.temp('dualMax(%s, dualNeg(%s))' % (d, d2))
+
+        d = self.emit(node.children[0], p)
+        for child in node.children[1:]:
+            d2 = self.emit(child, p)
+            if op == 'add':
+                d = self.temp('dualAdd(%s, %s)' % (d, d2))
+            elif op == 'union':
+                d = self.temp('dualMin(%s, %s)' % (d, d2))
+            elif op == 'intersect':
+                d = self.temp('dualMax(%s, %s)' % (d, d2))
+            elif op == 'smooth-union':
+                h = self.temp('dualSaturate(dualOffset(dualScale(dualSub(%s, %s), %s), 0.5))' % (d2, d, hlsl_float(0.5 / node.args[0])))
+                blend = self.temp('dualAdd(%s, dualMul(dualSub(%s, %s), %s))' % (d2, d, d2, h))
+                d = self.temp('dualSub(%s, dualScale(dualMul(%s, dualOffset(dualNeg(%s), 1.0)), %s))' % (blend, h, h, a[0]))
+            else:
+                raise SdfError('cannot emit %s' % op)
+        return d
+
+
+def emit_hlsl(tree, source_name):
+    emitter = HlslEmitter()
+    d, m = emitter.emit(tree, 'inPos')
+    dual_emitter = HlslDualEmitter()
+    axes = ['float3(1.0, 0.0, 0.0)', 'float3(0.0, 1.0, 0.0)', 'float3(0.0, 0.0, 1.0)']
+    point = [dual_emitter.temp('dual(inPos.%s, %s)' % (c, axis)) for c, axis in zip('xyz', axes)]
+    dual_distance = dual_emitter.emit(tree, point)
+    smooth, perturbation, lipschitz = bounds(tree)
+    lines = [
+        '// Generated by Tools/SdfCompiler.py from %s. Do not edit.' % source_name,
+        '',
+        '#include "SdfDual.hlsli"',
+        '',
+        '// Lipschitz bound of map(), and of its smooth part once the terms bounded by',
+        '// +-scenePerturbation are taken out.',
+        'static const float sceneLipschitz = %s;' % hlsl_float(max(lipschitz, MinLipschitz)),
+        'static const float sceneSmoothLipschitz = %s;' % hlsl_float(max(smooth, MinLipschitz)),
+        'static const float scenePerturbation = %s;' % hlsl_float(perturbation),
+        '',
+        '// Distance (x) and material (y) of the scene at inPos.',
+        'float2 map(in float3 inPos)',
+        '{',
+    ]
+    lines.extend(emitter.lines)
+    lines.append('\treturn float2(%s, %s);' % (d, m or '0.0'))
+    lines.append('}')
+    lines.extend([
+        '',
+        '// Distance of the scene at inPos with its gradient, from one forward mode evaluation.',
+        'Dual mapDual(in float3 inPos)',
+        '{',
+    ])
+    lines.extend(dual_emitter.lines)
+    lines.append('\treturn %s;' % dual_distance)
+    lines.append('}')
+    return '\n'.join(lines) + '\n'
+
+
+def emit_cpp_expression(node, indent):
+    op, args = node.op, node.args
+    pad = '\t' * indent
+    f = [cpp_float(v) for v in args]
+
+    def call(name, leading, children):
+        parts = [('\t' * (indent + 1)) + value for value in leading]
+        parts += [emit_cpp_expression(child, indent + 1) for child in children]
+        return '%sSdf::%s(\n%s)' % (pad, name, ',\n'.join(parts))
+
+    def chain(name, leading, children):
+        # N-ary nodes become a left leaning chain of binary nodes
+        if len(children) == 1:
+            return emit_cpp_expression(children[0], indent)
+        parts = [('\t' * (indent + 1)) + value for value in leading]
+        parts.append(emit_cpp_expression(Node(op, args, children[:-1]), indent + 1))
+        parts.append(emit_cpp_expression(children[-1], indent + 1))
+        return '%sSdf::%s(\n%s)' % (pad, name, ',\n'.join(parts))
+
+    if op == 'none':
+        return pad + 'Sdf::MakePlane(0.0f, 0.0f, 0.0f, Sdf::FarDistance)'
+    if op == 'constant':
+        return pad + 'Sdf::MakePlane(0.0f, 0.0f, 0.0f, %s)' % f[0]
+    if op == 'sphere':
+        return pad + 'Sdf::MakeSphere(%s)' % f[0]
+    if op == 'box':
+        return pad + 'Sdf::MakeBox(%s)' % ', '.join(f)
+    if op == 'torus':
+        return pad + 'Sdf::MakeTorus(%s)' % ', '.join(f)
+    if op == 'plane':
+        return pad + 'Sdf::MakePlane(%s)' % ', '.join(f)
+    if op == 'sin-lattice':
+        return pad + 'Sdf::MakeSinLattice(%s)' % ', '.join(f)
+    if op == 'translate':
+        return call('MakeTranslate', f, node.children)
+    if op == 'scale':
+        return call('MakeScale', f, node.children)
+    if op == 'rotate-y':
+        return call('MakeRotateY', [cpp_float(v) for v in rotation(args[0])], node.children)
+    if op == 'repeat':
+        return call('MakeRepeat', f, node.children)
+    if op == 'distance-scale':
+        return call('MakeDistanceScale', f, node.children)
+    if op == 'material':
+        return call('MakeMaterial', f, node.children)
+    if op == 'subtract':
+        return call('MakeSubtract', [], node.children)
+    if op == 'add':
+        return chain('MakeAdd', [], node.children)
+    if op == 'union':
+        return chain('MakeUnion', [], node.children)
+    if op == 'intersect':
+        return chain('MakeIntersect', [], node.children)
+    if op == 'smooth-union':
+        return chain('MakeSmoothUnion', f, node.children)
+    raise SdfError('cannot emit %s' % op)
+
+
+def emit_cpp(tree, source_name, namespace):
+    expression = emit_cpp_expression(tree, 3).lstrip('\t')
+    smooth, perturbation, lipschitz = bounds(tree)
+    return '\n'.join([
+        '#pragma once',
+        '',
+        '// Generated by Tools/SdfCompiler.py from %s. Do not edit.' % source_name,
+        '',
+        '#include "SdfExpression.h"',
+        '',
+        'namespace ACW',
+        '{',
+        '\tnamespace %s' % namespace,
+        '\t{',
+        '\t\t// Folded expression for the whole scene.',
+        '\t\tinline constexpr auto CreateExpression()',
+        '\t\t{',
+        '\t\t\treturn %s;' % expression,
+        '\t\t}',
+        '',
+        '\t\ttypedef decltype(CreateExpression()) Expression;',
+        '',
+        '\t\t// Lipschitz bound of Map, and of its smooth part once the terms bounded by',
+        '\t\t// +-Perturbation are taken out.',
+        '\t\tstatic const float Lipschitz = %s;' % cpp_float(max(lipschitz, MinLipschitz)),
+        '\t\tstatic const float SmoothLipschitz = %s;' % cpp_float(max(smooth, MinLipschitz)),
+        '\t\tstatic const float Perturbation = %s;' % cpp_float(perturbation),
+        '',
+        '\t\t// Distance and material at p, for a single point (T = float) or a batch (T = Sdf::FloatBatch).',
+        '\t\ttemplate <class T>',
+        '\t\tinline void Map(const Sdf::Vec3<T>& p, T& distance, T& material)',
+        '\t\t{',
+        '\t\t\tstatic constexpr Expression expression = CreateExpression();',
+        '\t\t\texpression.Evaluate(p, distance, material);',
+        '\t\t}',
+        '\t}',
+        '}',
+    ]) + '\n'
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='Compile a .sdf scene into HLSL and C++.')
+    parser.add_argument('scene')
+    parser.add_argument('--hlsl', required=True)
+    parser.add_argument('--cpp', required=True)
+    parser.add_argument('--namespace', required=True)
+    options = parser.parse_args(argv)
+
+    with open(options.scene) as f:
+        source = f.read()
+
+    source_name = os.path.basename(options.scene)
+    try:
+        tree = parse(source)
+        folded = fold(tree)
+    except SdfError as error:
+        sys.stderr.write('%s: error: %s\n' % (options.scene, error))
+        return 1
+
+    write_if_changed(options.hlsl, emit_hlsl(folded, source_name))
+    write_if_changed(options.cpp, '\ufeff' + emit_cpp(folded, source_name, options.namespace))
+    print('%s: %d nodes folded to %d' % (source_name, count_nodes(tree), count_nodes(folded)))
+    return 0
+
+
+def write_if_changed(path, text):
+    # Leave unchanged outputs alone so MSBuild does not recompile their dependants
+    data = text.encode('utf-8')
+    if os.path.exists(path):
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,390 @@
+﻿#include "pch.h"
+
+#include "CommandRecording.h"
+#include "ConstantRing.h"
+#include "CoralImpostor.h"
+#include "CoralMesh.h"
+#include "FrameGraph.h"
+#include "ImplicitCoralReference.h"
+#include "Meshlets.h"
+#include "PlantAtlas.h"
+#include "PlantCulling.h"
+#include "PlantScatter.h"
+#include "PlantSorting.h"
+#include "ShaderKernels.h"
+#include "SoftwareRasterizer.h"
+#include "StateCache.h"
+#include "StateFilter.h"
+#include "VertexQuantization.h"
+#include <fstream>
+#include <iterator>
+
+using namespace ACW;
+using ShaderMath::float3;
+
+// Runs the CPU benchmarks of the Content modules headless and prints what they measured, checking the results
+// each says should hold. Usage: Benchmarks [ACW project directory] [benchmark name]. Benchmarks that load assets
+// read them from the project directory, ..\ACW when run from the solution's Benchmarks directory. The exit code
+// is the number of failed checks.
+namespace
+{
+	int gFailures = 0;
+
+	void Check(bool passed, const char* what)
+	{
+		if (!passed)
+		{
+			std::printf("  FAILED: %s\n", what);
+			gFailures++;
+		}
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	// The optimised coral variants the renderer loads, for the benchmarks that work on meshes.
+	std::vector<CoralMesh::Variant> CoralVariants()
+	{
+		std::vector<CoralMesh::Variant> variants = CoralMesh::GenerateVariants(CoralMesh::DefaultSettings(), 1, 16, 0);
+		CoralMesh::OptimizeVariants(variants, MeshOptimizer::DefaultSettings(), 0);
+		return variants;
+	}
+
+	void ConeMarch()
+	{
+		ImplicitCoralReference::ConeMarchBenchmark result = ImplicitCoralReference::RunConeMarchBenchmark(ImplicitCoralReference::CoralCamera(640, 360));
+		std::printf("Cone march prepass, %d pixels in %d tiles\n", result.pixelCount, result.tileCount);
+		std::printf("  baseline: %lld steps, at most %d, %d hits, %.2f ms\n", result.baselineSteps, result.baselineMaxSteps, result.baselineHits, result.baselineMilliseconds);
+		std::printf("  prepass: %lld + %lld steps, at most %d, %d hits, %.2f + %.2f ms\n", result.prepassSteps, result.marchSteps, result.marchMaxSteps, result.marchHits, result.prepassMilliseconds, result.marchMilliseconds);
+		std::printf("  mismatched hits %d, largest hit distance error %g\n", result.mismatchedHits, result.maxHitDistanceError);
+		Check(result.prepassSteps + result.marchSteps < result.baselineSteps, "the prepass takes fewer steps in all");
+	}
+
+	void SdfEvaluation(const std::string& directory)
+	{
+		std::vector<uint8_t> source = ReadFile(directory + "/Content/ImplicitCoral.sdf");
+		if (source.empty())
+		{
+			std::printf("SDF evaluation skipped, no Content/ImplicitCoral.sdf under %s\n", directory.c_str());
+			return;
+		}
+
+		ImplicitCoralReference::SdfEvaluationBenchmark result = ImplicitCoralReference::RunSdfEvaluationBenchmark(std::string(source.begin(), source.end()), 100000);
+		std::printf("SDF evaluation, %d nodes, %d points\n", result.nodeCount, result.pointCount);
+		std::printf("  interpreted %.2f ms, compiled %.2f ms, batched %.2f ms\n", result.interpretedMilliseconds, result.compiledMilliseconds, result.batchedMilliseconds);
+		std::printf("  largest error compiled %g, batched %g\n", result.maxCompiledError, result.maxBatchedError);
+		Check(result.maxCompiledError < 1e-4f && result.maxBatchedError < 1e-4f, "the compiled scene matches the interpreter");
+	}
+
+	// Relaxation saves steps on rays that pass the coral by rather than meet it, so fewer steps are checked for
+	// over the renderer's view, and the coral view shows whether the coral's own pixels still hit the same.
+	void RelaxedMarch()
+	{
+		std::printf("Over-relaxed march\n");
+		for (bool framed : { false, true })
+		{
+			ImplicitCoralReference::Camera camera = framed ? ImplicitCoralReference::CoralCamera(640, 360) : ImplicitCoralReference::DefaultCamera(640, 360);
+			ImplicitCoralReference::RelaxedMarchBenchmark result = ImplicitCoralReference::RunRelaxedMarchBenchmark(camera, ImplicitCoralReference::DefaultMarchSettings(), 1e-3f);
+			std::printf("  %s view, %d pixels\n", framed ? "coral" : "default", result.pixelCount);
+			std::printf("    baseline: %lld steps, %d hits\n", result.baselineSteps, result.baselineHits);
+			std::printf("    relaxed: %lld steps, %d hits, %d relaxation failures\n", result.relaxedSteps, result.relaxedHits, result.relaxationFailures);
+			std::printf("    mismatched hits %d, materials %d, largest hit distance error %g\n", result.mismatchedHits, result.mismatchedMaterials, result.maxHitDistanceError);
+			if (!framed)
+			{
+				Check(result.relaxedSteps < result.baselineSteps, "relaxation takes fewer steps");
+			}
+		}
+	}
+
+	void Normals()
+	{
+		ImplicitCoralReference::NormalBenchmark result = ImplicitCoralReference::RunNormalBenchmark(ImplicitCoralReference::CoralCamera(640, 360), 3);
+		std::printf("Normals, %d hits\n", result.hitCount);
+		std::printf("  finite differences: %.2f ms, mean error %g, largest %g\n", result.finiteDifferenceMilliseconds, result.finiteDifferenceMeanError, result.finiteDifferenceMaxError);
+		std::printf("  dual numbers: %.2f ms, mean error %g, largest %g\n", result.dualMilliseconds, result.dualMeanError, result.dualMaxError);
+	}
+
+	void DeferredShading()
+	{
+		std::printf("Deferred coral shading\n");
+		for (int rate : { 1, 2, 4 })
+		{
+			ImplicitCoralReference::DeferredShadingBenchmark result = ImplicitCoralReference::RunDeferredShadingBenchmark(ImplicitCoralReference::CoralCamera(640, 360), rate);
+			std::printf("  rate %d: %d hits, %d shaded, single pass %.2f ms, march %.2f + shade %.2f + resolve %.2f ms\n", rate, result.hitCount, result.shadedCount, result.singlePassMilliseconds, result.marchMilliseconds, result.shadeMilliseconds, result.resolveMilliseconds);
+			std::printf("    mismatched coverage %d, pixels %d, colour error mean %g, largest %g\n", result.mismatchedCoverage, result.mismatchedPixels, result.meanColourError, result.maxColourError);
+			if (rate == 1)
+			{
+				Check(result.mismatchedCoverage == 0, "deferred shading covers what the single pass does");
+				Check(result.mismatchedPixels == 0, "deferred shading at full rate draws the single pass's image");
+			}
+		}
+	}
+
+	void Scatter()
+	{
+		PlantScatter::ScatterBenchmark result = PlantScatter::RunScatterBenchmark(100000, 0);
+		std::printf("Plant scatter, %u of %u instances on %d threads\n", result.instanceCount, result.targetInstances, result.threadCount);
+		std::printf("  %.2f ms, %.2f M instances/s, %u points, radius %g\n", result.milliseconds, result.instancesPerSecond / 1e6, result.pointCount, result.radius);
+		std::printf("  %.1f bytes retained per instance, %.1f at the peak\n", result.retainedBytesPerInstance, result.peakBytesPerInstance);
+	}
+
+	void PlantCull()
+	{
+		std::printf("Plant culling\n");
+		for (uint32_t count : { 100000u, 1000000u, 10000000u })
+		{
+			PlantCulling::CullBenchmark result = PlantCulling::RunCullBenchmark(count, 0, 10);
+			std::printf("  %u instances, %u visible: scalar %.3f ms, blocks %.3f ms, %d threads %.3f ms\n", result.instanceCount, result.visibleCount, result.scalarMilliseconds, result.blockMilliseconds, result.threadCount, result.threadedMilliseconds);
+			Check(result.mismatches == 0, "culling agrees with the scalar loop");
+		}
+	}
+
+	// The sort was asked to order 1M instances in under a millisecond on 8 cores, so it runs on 8 threads whatever
+	// the machine has and reports how far off that is. With fewer hardware threads the 8 share them.
+	void PlantSort()
+	{
+		const int targetThreads = 8;
+		const double targetMilliseconds = 1.0;
+		std::printf("Plant sorting, %d hardware threads\n", WorkerThreads::Resolve(0));
+		for (uint32_t count : { 100000u, 1000000u })
+		{
+			PlantSorting::SortBenchmark result = PlantSorting::RunSortBenchmark(count, targetThreads, 10);
+			std::printf("  %u instances: stable_sort %.3f ms, radix %.3f ms, %d threads %.3f ms\n", result.instanceCount, result.comparisonMilliseconds, result.radixMilliseconds, result.threadCount, result.threadedMilliseconds);
+			Check(result.misordered == 0, "the radix sort orders as the comparison sort does");
+			if (count == 1000000u)
+			{
+				std::printf("  1M on %d threads: %.3f ms against the %.1f ms target, %s\n", result.threadCount, result.threadedMilliseconds, targetMilliseconds, result.threadedMilliseconds < targetMilliseconds ? "met" : "missed");
+			}
+		}
+	}
+
+	void Atlas(const std::string& directory)
+	{
+		std::vector<uint8_t> dds = ReadFile(directory + "/grass.dds");
+		if (dds.empty())
+		{
+			std::printf("Plant atlas skipped, no grass.dds under %s\n", directory.c_str());
+			return;
+		}
+
+		PlantAtlas::AtlasBenchmark result = PlantAtlas::RunAtlasBenchmark(dds.data(), dds.size(), 10);
+		std::printf("Plant atlas, %u layers of %u with %u mips\n", result.layerCount, result.size, result.mipCount);
+		std::printf("  decode %.2f ms, species %.2f ms, mips %.2f ms (scalar %.2f ms), write %.2f ms, %zu bytes\n", result.decodeMilliseconds, result.speciesMilliseconds, result.mipMilliseconds, result.scalarMipMilliseconds, result.writeMilliseconds, result.packBytes);
+		std::printf("  %.2f ns a sample, largest mip difference %d\n", result.nanosecondsPerSample, result.maxMipDifference);
+		Check(result.maxMipDifference <= 2, "the planar mip filter is within 2/255 of the scalar one");
+	}
+
+	// Walks the eye from where the renderer's camera starts towards the coral, forward and then down, a frame of
+	// movement at a time, and checks the impostor is given up where the eye crosses minDistance or the canvas plane
+	// rather than staying with the answer for the starting eye.
+	void ImpostorSwitch()
+	{
+		CoralImpostor::Settings settings = CoralImpostor::DefaultSettings();
+		const float3 start(0.0f, 5.0f, -10.0f);
+		const float step = 1.0f / 60.0f;
+		std::printf("Coral impostor switch, from (%g, %g, %g)\n", start.x, start.y, start.z);
+		Check(CoralImpostor::UseImpostor(settings, start), "the impostor is drawn from the starting eye");
+
+		const float3 directions[] = { float3(0.0f, 0.0f, 1.0f), float3(0.0f, -1.0f, 0.0f) };
+		for (const float3& direction : directions)
+		{
+			float3 eye = start;
+			int frame = 0;
+			while (CoralImpostor::UseImpostor(settings, eye) && frame < 100000)
+			{
+				eye = eye + direction * step;
+				frame++;
+			}
+			float distance = ShaderMath::length(eye - settings.centre);
+			bool crossed = distance <= settings.minDistance || eye.y < settings.centre.y || eye.z >= settings.centre.z - settings.radius;
+			float3 previous = eye - direction * step;
+			bool before = ShaderMath::length(previous - settings.centre) > settings.minDistance && previous.y >= settings.centre.y && previous.z < settings.centre.z - settings.radius;
+			std::printf("  along (%g, %g, %g): marched after %d frames at (%.3f, %.3f, %.3f), %.3f from the centre\n", direction.x, direction.y, direction.z, frame, eye.x, eye.y, eye.z, distance);
+			Check(crossed && before, "the impostor is given up the frame the eye crosses the threshold");
+		}
+	}
+
+	void Impostor()
+	{
+		CoralImpostor::Settings settings = CoralImpostor::DefaultSettings();
+		CoralImpostor::BakeBenchmark bake = CoralImpostor::RunBakeBenchmark(settings, 0);
+		std::printf("Coral impostor, %d frames on %d threads\n", bake.frameCount, bake.threadCount);
+		std::printf("  bake %.1f ms, pack %.2f ms, %zu bytes, %d texels covered\n", bake.bakeMilliseconds, bake.packMilliseconds, bake.packBytes, bake.coveredTexels);
+
+		PlantAtlas::TextureArray atlas = CoralImpostor::Bake(settings, 0);
+		ImplicitCoralReference::Camera camera = ImplicitCoralReference::DefaultCamera(1280, 720);
+		// Distances inside the band the impostor is drawn in, from minDistance out to where the march and the
+		// impostor both give up at 20 units
+		for (float distance : { 8.0f, 12.0f, 18.0f })
+		{
+			CoralImpostor::InstanceBenchmark result = CoralImpostor::RunInstanceBenchmark(settings, atlas, camera, distance);
+			std::printf("  at %.0f: %d pixels, march %d covered in %.0f us, impostor %d in %.0f us, colour error mean %.3f, largest %.3f\n", result.distance, result.pixelCount, result.marchCovered, result.marchMicroseconds, result.impostorCovered, result.impostorMicroseconds, result.meanColourError, result.maxColourError);
+			Check(result.marchCovered > 0 && result.impostorCovered > 0, "the march and the impostor both draw the coral");
+		}
+	}
+
+	void CoralGeneration()
+	{
+		CoralMesh::GenerationBenchmark result = CoralMesh::RunGenerationBenchmark(CoralMesh::DefaultSettings(), 16, 0);
+		std::printf("Coral generation, %d variants on %d threads\n", result.variantCount, result.threadCount);
+		std::printf("  %.1f ms, %.2f ms a variant on average, %.2f at most\n", result.wallMilliseconds, result.meanMilliseconds, result.maxMilliseconds);
+		std::printf("  triangles %d to %d, %.0f on average, %.0f vertices\n", result.minTriangles, result.maxTriangles, result.meanTriangles, result.meanVertices);
+	}
+
+	void Quantization(const std::vector<CoralMesh::Variant>& variants)
+	{
+		std::vector<CoralMesh::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		for (const CoralMesh::Variant& variant : variants)
+		{
+			uint32_t base = static_cast<uint32_t>(vertices.size());
+			vertices.insert(vertices.end(), variant.mesh.vertices.begin(), variant.mesh.vertices.end());
+			for (uint32_t i = 0; i < variant.mesh.lods[0].indexCount; i++)
+			{
+				indices.push_back(base + variant.mesh.indices[i]);
+			}
+		}
+
+		VertexQuantization::QuantizationBenchmark result = VertexQuantization::RunQuantizationBenchmark(&vertices[0].position, &vertices[0].normal, sizeof(CoralMesh::Vertex), vertices.size(), indices, 20);
+		std::printf("Vertex quantisation, %u vertices of %u bytes packed to %u\n", result.vertexCount, result.floatVertexSize, result.packedVertexSize);
+		std::printf("  buffers %u to %u bytes, fetched %u to %u bytes\n", result.floatBytes, result.packedBytes, result.floatFetchBytes, result.packedFetchBytes);
+		std::printf("  scalar %.3f ms, batches %.3f ms, %.1f M vertices/s\n", result.scalarMilliseconds, result.batchMilliseconds, result.batchVerticesPerSecond / 1e6);
+		std::printf("  largest position error %g, normal error %.3f degrees\n", result.maxPositionError, result.maxNormalErrorDegrees);
+		Check(result.identical, "batched and scalar packing write the same bytes");
+	}
+
+	void MeshletCull(const std::vector<CoralMesh::Variant>& variants)
+	{
+		std::vector<std::vector<uint32_t>> indices;
+		std::vector<std::vector<float3>> positions;
+		for (const CoralMesh::Variant& variant : variants)
+		{
+			indices.emplace_back(variant.mesh.indices.begin(), variant.mesh.indices.begin() + variant.mesh.lods[0].indexCount);
+			positions.emplace_back();
+			for (const CoralMesh::Vertex& vertex : variant.mesh.vertices)
+			{
+				positions.back().push_back(vertex.position);
+			}
+		}
+
+		Meshlets::CullBenchmark result = Meshlets::RunCullBenchmark(indices, positions, 1000, 0, 10);
+		std::printf("Coral clusters, %u placements on %d threads\n", result.placementCount, result.threadCount);
+		std::printf("  build %.2f ms a mesh, %.1f triangles and %.1f vertices a cluster\n", result.buildMilliseconds, result.meanTriangles, result.meanVertices);
+		std::printf("  %u clusters, %u frustum and %u backface culled, %u of %u triangles kept\n", result.stats.meshletCount, result.stats.frustumCulled, result.stats.backfaceCulled, result.stats.trianglesKept, result.stats.triangleCount);
+		std::printf("  copy %.3f ms, cull %.3f ms, threaded %.3f ms\n", result.copyMilliseconds, result.cullMilliseconds, result.threadedMilliseconds);
+		Check(result.mismatches == 0, "threaded culling matches one thread");
+	}
+
+	void Graph()
+	{
+		std::printf("Frame graph\n");
+		for (int postPasses : { 0, 8 })
+		{
+			FrameGraph::GraphBenchmark result = FrameGraph::RunGraphBenchmark(postPasses, 1000);
+			std::printf("  %d post passes: %u passes, %u culled, %u transient, %u textures, %u target binds\n", postPasses, result.compile.passCount, result.compile.culledPasses, result.compile.transientResources, result.compile.textures, result.execute.targetBinds);
+			std::printf("    compile %.2f us, execute %.2f us, %d textures live\n", result.compileMicroseconds, result.executeMicroseconds, result.liveTextures);
+			Check(result.liveTextures == static_cast<int>(result.compile.textures), "the pool keeps only the compiled textures");
+		}
+	}
+
+	void Filter()
+	{
+		StateFilter::FilterBenchmark result = StateFilter::RunFilterBenchmark(1000);
+		std::printf("State filter, %d frames\n", result.frames);
+		std::printf("  %u calls a frame, %u issued, %u skipped\n", result.callsPerFrame, result.stats.Issued(), result.stats.Skipped());
+		Check(result.contextCalls == result.stats.Issued() * static_cast<uint32_t>(result.frames), "only issued calls reach the context");
+		std::printf("  %u passes replayed, %u drawing with different state immediate and deferred\n", result.passCount, result.modeMismatches);
+		Check(result.modeMismatches == 0, "every pass draws with the same state whether recorded or not");
+	}
+
+	void Cache()
+	{
+		StateCache::CacheBenchmark result = StateCache::RunCacheBenchmark(1000);
+		std::printf("State cache, %d frames\n", result.frames);
+		std::printf("  %u objects made loading, %u after, %.1f ns a lookup\n", result.loadCreates, result.frameCreates, result.lookupNanoseconds);
+		Check(result.frameCreates == 0, "no objects are made once loaded");
+		Check(result.leaked == 0, "nothing outlives Clear");
+	}
+
+	void Ring()
+	{
+		ConstantRing::RingBenchmark result = ConstantRing::RunRingBenchmark(10000, 65536);
+		std::printf("Constant ring, %d frames\n", result.frames);
+		std::printf("  %u bytes a frame whole, %.1f with the ring, %u discards\n", result.bytesPerFrameBefore, result.bytesPerFrame, result.discards);
+		Check(result.overwrites == 0, "the ring never overwrites bytes in use");
+	}
+
+	void Recording()
+	{
+		CommandRecording::RecordingBenchmark result = CommandRecording::RunRecordingBenchmark(11, 200, std::max(WorkerThreads::Resolve(0), 4), 100);
+		std::printf("Command recording, %d jobs on %d threads\n", result.jobs, result.threads);
+		std::printf("  serial %.3f ms, parallel %.3f ms, execute %.3f ms\n", result.serialMilliseconds, result.parallelMilliseconds, result.executeMilliseconds);
+		std::printf("  %d of %d frames in order, %d shared between threads\n", result.orderedFrames, result.frames, result.sharedFrames);
+		Check(result.orderedFrames == result.frames, "every frame plays back in job order");
+	}
+
+	void Raster()
+	{
+		SoftwareRasterizer::RasterBenchmark result = SoftwareRasterizer::RunRasterBenchmark(640, 360, 0, 20);
+		std::printf("Software rasterizer, %dx%d on %d threads\n", result.width, result.height, result.threads);
+		std::printf("  serial %.2f ms, threaded %.2f ms, image hash %016llx\n", result.serialMilliseconds, result.threadedMilliseconds, static_cast<unsigned long long>(result.imageHash));
+		Check(result.mismatches == 0, "threaded drawing matches one thread");
+	}
+
+	void Kernels()
+	{
+		std::printf("Shader kernels\n");
+		for (const ShaderKernels::KernelBenchmark& result : ShaderKernels::RunKernelBenchmarks(1 << 20, 320, 180, 0))
+		{
+			std::printf("  %-24s %3d in %3d out: %7.1f M invocations/s, %u discarded", result.name.c_str(), result.inputCount, result.outputCount, result.invocationsPerSecond / 1e6, result.discarded);
+			if (result.pixelShader)
+			{
+				std::printf(", quad %.2f ms, single lane %.2f ms", result.rasterMilliseconds, result.rasterSingleMilliseconds);
+			}
+			std::printf(", hash %016llx\n", static_cast<unsigned long long>(result.outputHash));
+			Check(result.rasterMismatches == 0, "batched pixel kernels match single lanes");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string directory = argc > 1 ? argv[1] : "../ACW";
+	std::string only = argc > 2 ? argv[2] : "";
+	auto run = [&only](const char* name) { return only.empty() || only == name; };
+
+	if (run("cone")) ConeMarch();
+	if (run("sdf")) SdfEvaluation(directory);
+	if (run("relax")) RelaxedMarch();
+	if (run("normals")) Normals();
+	if (run("deferred")) DeferredShading();
+	if (run("scatter")) Scatter();
+	if (run("cull")) PlantCull();
+	if (run("sort")) PlantSort();
+	if (run("atlas")) Atlas(directory);
+	if (run("impostor"))
+	{
+		ImpostorSwitch();
+		Impostor();
+	}
+	if (run("coral")) CoralGeneration();
+	if (run("quantization") || run("meshlets"))
+	{
+		std::vector<CoralMesh::Variant> variants = CoralVariants();
+		if (run("quantization")) Quantization(variants);
+		if (run("meshlets")) MeshletCull(variants);
+	}
+	if (run("graph")) Graph();
+	if (run("filter")) Filter();
+	if (run("cache")) Cache();
+	if (run("ring")) Ring();
+	if (run("recording")) Recording();
+	if (run("raster")) Raster();
+	if (run("kernels")) Kernels();
+
+	std::printf("%d failed checks\n", gFailures);
+	return gFailures;
+}